@@ -37,6 +37,7 @@
 #include "debug.h"
 #include "errorchain.h"
 #include "gq-browser-node-dn.h"
+#include "gq-progress.h"
 #include "gq-server-list.h"
 #include "gq-tab-browse.h"
 #include "ldapops.h"
@@ -431,11 +432,14 @@ static void drag_data_get(GtkWidget *ctreeroot,
 }
 
 
+/* of the move_entry going on */
+static GqProgress *moving = NULL;
+
 static void move_progress(const char *from_dn,
 			  const char *to_dn,
 			  const char *new_dn) 
 {
-     statusbar_msg(_("Created %s"), new_dn);
+     gq_progress_add(moving, 1);
 }
 
 static GHashTable *drag_selection_data_unpack(const char *data, int len)
@@ -490,6 +494,9 @@ static void do_move_after_reception(GtkWidget *ctreeroot,
      int context;
 
      context = error_new_context(_("Moving entry"), ctreeroot);
+     if (flags & MOVE_RECURSIVELY) {
+	  error_set_bulk(context, ERROR_BULK_SAMPLES, TRUE);
+     }
 #ifdef DEBUG
      if (debug & GQ_DEBUG_BROWSER_DND) {
 	  printf("do_move_after_reception selhash=%08lx server=%s dn=%s\n",
@@ -534,9 +541,14 @@ static void do_move_after_reception(GtkWidget *ctreeroot,
      }
      
      if (GQ_IS_BROWSER_NODE_DN(target_entry)) {
+	  moving = gq_progress_new(flags & MOVE_DELETE_MOVED ?
+				   _("Moving entries") : _("Copying entries"),
+				   0);
 	  newdn = move_entry(dn, source_server, 
 			     target_entry->dn, target_server,
 			     flags, move_progress, context);
+	  gq_progress_finish(moving);
+	  moving = NULL;
 
 	  /* register that we have to refresh the target node */
 	  dnd_refresh_list =
@@ -29,8 +29,6 @@
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
 #include <string.h>
-#include <errno.h>		/* errno */
-#include <stdio.h>		/* FILE */
 #include <stdlib.h>		/* free - MUST get rid of malloc/free */
 
 #ifdef HAVE_CONFIG_H
@@ -50,14 +48,66 @@
 #include "errorchain.h"
 #include "util.h"
 #include "encode.h"
+#include "input.h"		/* CONTAINER_BORDER_WIDTH */
+#include "state.h"
 
-#include "ldif.h"
+#include "gq-export-file.h"
+#include "gq-export-partition.h"
+#include "gq-export-writer.h"
+#include "gq-progress.h"
 #include "browse-export.h"
 
+/* how many base searches exporting search results keeps in flight
+   on a connection */
+#define EXPORT_PIPELINE_DEPTH	64
+
+/* output gets written to the file in chunks of about this size */
+#define EXPORT_CHUNK		(64 * 1024)
+
+/* where the export dialogs remember their settings */
+static const char *exportoptions = "global.export";
+
+/* the format part of the export dialogs */
+struct format_widgets {
+     GtkWidget *format[GQ_EXPORT_N_FORMATS];
+     GtkWidget *csv_table;
+     GtkWidget *columns;
+     GtkWidget *first_value;
+     GtkWidget *separator;
+     GtkWidget *auto_compression;
+     GtkWidget *compression[GQ_COMPRESS_N];
+};
+
+/* how subtree exports get split up to run in parallel */
+struct partition_widgets {
+     GtkWidget *connections;
+     GtkWidget *split_table;
+     GtkWidget *by_children;
+     GtkWidget *by_prefixes;
+     GtkWidget *attribute;
+     GtkWidget *prefixes;
+};
+
 struct export {
      GList *to_export;
      GtkWidget *filesel;
      GtkWidget *transient_for;
+     struct format_widgets fw;
+     struct partition_widgets pw;
+};
+
+struct result_export {
+     GqResultStore *store;
+     GList *entries;		/* GqResultEntry, belonging to store */
+     GtkWidget *filesel;
+     GtkWidget *transient_for;
+     struct format_widgets fw;
+};
+
+struct pending_fetch {
+     GqResultEntry *entry;
+     int msgid;
+     gdouble start;
 };
 
 static struct export *new_export()
@@ -75,25 +125,550 @@ static void free_export(struct export *ex)
 	  g_free(ex);
      }
 }
-    
-static void dump_subtree_ok_callback(struct export *ex)
+
+static void free_result_export(struct result_export *ex)
+{
+     if (ex) {
+	  g_list_free(ex->entries);
+	  gq_result_store_unref(ex->store);
+	  g_free(ex);
+     }
+}
+
+static void format_toggled(struct format_widgets *fw)
+{
+     gtk_widget_set_sensitive(fw->csv_table,
+			      gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(fw->format[GQ_EXPORT_CSV])));
+}
+
+/* adds the format choice to an export file selection. columns are
+   the CSV columns to suggest, NULL for the ones used last time */
+static void add_format_widgets(GtkWidget *filesel, struct format_widgets *fw,
+			       const gchar *columns)
+{
+     GtkWidget *frame, *vbox, *hbox, *label;
+     GtkTooltips *tips;
+     GSList *group = NULL;
+     int i, format, compression;
+
+     format = state_value_get_int(exportoptions, "format", GQ_EXPORT_LDIF);
+     if (format < 0 || format >= GQ_EXPORT_N_FORMATS) format = GQ_EXPORT_LDIF;
+
+     frame = gtk_frame_new(_("Format"));
+     gtk_widget_show(frame);
+     gtk_box_pack_start(GTK_BOX(GTK_FILE_SELECTION(filesel)->main_vbox),
+			frame, FALSE, TRUE, 5);
+
+     vbox = gtk_vbox_new(FALSE, 0);
+     gtk_container_border_width(GTK_CONTAINER(vbox),
+				CONTAINER_BORDER_WIDTH);
+     gtk_container_add(GTK_CONTAINER(frame), vbox);
+     gtk_widget_show(vbox);
+
+     hbox = gtk_hbox_new(FALSE, 0);
+     gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 3);
+     gtk_widget_show(hbox);
+
+     for (i = 0 ; i < GQ_EXPORT_N_FORMATS ; i++) {
+	  fw->format[i] =
+	       gtk_radio_button_new_with_label(group,
+					       gq_export_format_get_name(i));
+	  group = gtk_radio_button_group(GTK_RADIO_BUTTON(fw->format[i]));
+	  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(fw->format[i]),
+				       i == format);
+	  gtk_box_pack_start(GTK_BOX(hbox), fw->format[i], FALSE, FALSE, 3);
+	  gtk_widget_show(fw->format[i]);
+     }
+
+     /* CSV only */
+     fw->csv_table = gtk_table_new(2, 3, FALSE);
+     gtk_box_pack_start(GTK_BOX(vbox), fw->csv_table, FALSE, FALSE, 3);
+     gtk_widget_show(fw->csv_table);
+
+     label = gq_label_new(_("_Columns:"));
+     gtk_misc_set_alignment(GTK_MISC(label), 0.0, 0.5);
+     gtk_table_attach(GTK_TABLE(fw->csv_table), label, 0, 1, 0, 1,
+		      GTK_FILL, GTK_SHRINK, 2, 2);
+     gtk_widget_show(label);
+
+     fw->columns = gtk_entry_new();
+     gtk_entry_set_text(GTK_ENTRY(fw->columns),
+			columns ? columns :
+			state_value_get_string(exportoptions, "columns",
+					       "dn"));
+     gtk_table_attach(GTK_TABLE(fw->csv_table), fw->columns, 1, 3, 0, 1,
+		      GTK_FILL | GTK_EXPAND, GTK_SHRINK, 2, 2);
+     gtk_label_set_mnemonic_widget(GTK_LABEL(label), fw->columns);
+     gtk_widget_show(fw->columns);
+
+     label = gq_label_new(_("Separate _values by:"));
+     gtk_misc_set_alignment(GTK_MISC(label), 0.0, 0.5);
+     gtk_table_attach(GTK_TABLE(fw->csv_table), label, 0, 1, 1, 2,
+		      GTK_FILL, GTK_SHRINK, 2, 2);
+     gtk_widget_show(label);
+
+     fw->separator = gtk_entry_new();
+     gtk_entry_set_width_chars(GTK_ENTRY(fw->separator), 4);
+     gtk_entry_set_text(GTK_ENTRY(fw->separator),
+			state_value_get_string(exportoptions, "separator",
+					       "|"));
+     gtk_table_attach(GTK_TABLE(fw->csv_table), fw->separator, 1, 2, 1, 2,
+		      GTK_SHRINK, GTK_SHRINK, 2, 2);
+     gtk_label_set_mnemonic_widget(GTK_LABEL(label), fw->separator);
+     gtk_widget_show(fw->separator);
+
+     fw->first_value =
+	  gq_check_button_new_with_label(_("Only the _first value"));
+     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(fw->first_value),
+				  state_value_get_int(exportoptions,
+						      "first-value", 0));
+     gtk_table_attach(GTK_TABLE(fw->csv_table), fw->first_value, 2, 3, 1, 2,
+		      GTK_FILL, GTK_SHRINK, 2, 2);
+     gtk_widget_show(fw->first_value);
+
+     g_signal_connect_swapped(fw->format[GQ_EXPORT_CSV], "toggled",
+			      G_CALLBACK(format_toggled), fw);
+     format_toggled(fw);
+
+     /* -1 picks it by the file name */
+     compression = state_value_get_int(exportoptions, "compression", -1);
+     if (compression >= GQ_COMPRESS_N ||
+	 (compression >= 0 && !gq_compression_is_available(compression))) {
+	  compression = -1;
+     }
+
+     tips = gtk_tooltips_new();
+
+     frame = gtk_frame_new(_("Compression"));
+     gtk_widget_show(frame);
+     gtk_box_pack_start(GTK_BOX(GTK_FILE_SELECTION(filesel)->main_vbox),
+			frame, FALSE, TRUE, 5);
+
+     hbox = gtk_hbox_new(FALSE, 0);
+     gtk_container_border_width(GTK_CONTAINER(hbox),
+				CONTAINER_BORDER_WIDTH);
+     gtk_container_add(GTK_CONTAINER(frame), hbox);
+     gtk_widget_show(hbox);
+
+     fw->auto_compression =
+	  gq_radio_button_new_with_label(NULL, _("By file _name"));
+     group = gtk_radio_button_group(GTK_RADIO_BUTTON(fw->auto_compression));
+     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(fw->auto_compression),
+				  compression < 0);
+     gtk_tooltips_set_tip(tips, fw->auto_compression,
+			  _("Compress files ending in .gz with gzip and files ending in .zst with zstd."),
+			  Q_("tooltip|Compress files ending in .gz with gzip and files ending in .zst with zstd."));
+     gtk_box_pack_start(GTK_BOX(hbox), fw->auto_compression,
+			FALSE, FALSE, 3);
+     gtk_widget_show(fw->auto_compression);
+
+     for (i = 0 ; i < GQ_COMPRESS_N ; i++) {
+	  fw->compression[i] =
+	       gtk_radio_button_new_with_label(group,
+					       gq_compression_get_name(i));
+	  group = gtk_radio_button_group(GTK_RADIO_BUTTON(fw->compression[i]));
+	  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(fw->compression[i]),
+				       i == compression);
+	  gtk_widget_set_sensitive(fw->compression[i],
+				   gq_compression_is_available(i));
+	  gtk_box_pack_start(GTK_BOX(hbox), fw->compression[i],
+			     FALSE, FALSE, 3);
+	  gtk_widget_show(fw->compression[i]);
+     }
+}
+
+/* the compression chosen in the dialog, for filename */
+static GqCompression get_compression(struct format_widgets *fw,
+				     const char *filename)
+{
+     int i, compression = -1;
+
+     for (i = 0 ; i < GQ_COMPRESS_N ; i++) {
+	  if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(fw->compression[i]))) {
+	       compression = i;
+	  }
+     }
+     state_value_set_int(exportoptions, "compression", compression);
+
+     if (compression < 0) return gq_compression_from_filename(filename);
+     return compression;
+}
+
+static void partition_toggled(struct partition_widgets *pw)
 {
+     gboolean prefixes;
 
-     LDAPMessage *res = NULL, *e;
+     gtk_widget_set_sensitive(pw->split_table,
+			      gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(pw->connections)) > 1);
+
+     prefixes = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(pw->by_prefixes));
+     gtk_widget_set_sensitive(pw->attribute, prefixes);
+     gtk_widget_set_sensitive(pw->prefixes, prefixes);
+}
+
+/* adds the choice of exporting subtrees in parallel parts */
+static void add_partition_widgets(GtkWidget *filesel,
+				  struct partition_widgets *pw)
+{
+     GtkWidget *frame, *vbox, *hbox, *label;
+     GtkTooltips *tips;
+     GtkObject *adj;
+     int prefixes;
+
+     tips = gtk_tooltips_new();
+
+     frame = gtk_frame_new(_("Parallel export"));
+     gtk_widget_show(frame);
+     gtk_box_pack_start(GTK_BOX(GTK_FILE_SELECTION(filesel)->main_vbox),
+			frame, FALSE, TRUE, 5);
+
+     vbox = gtk_vbox_new(FALSE, 0);
+     gtk_container_border_width(GTK_CONTAINER(vbox),
+				CONTAINER_BORDER_WIDTH);
+     gtk_container_add(GTK_CONTAINER(frame), vbox);
+     gtk_widget_show(vbox);
+
+     hbox = gtk_hbox_new(FALSE, 0);
+     gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 3);
+     gtk_widget_show(hbox);
+
+     label = gq_label_new(_("_Connections:"));
+     gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 3);
+     gtk_widget_show(label);
+
+     adj = gtk_adjustment_new(state_value_get_int(exportoptions,
+						  "connections", 1),
+			      1.0, 16.0, 1.0, 4.0, 0.0);
+     pw->connections = gtk_spin_button_new(GTK_ADJUSTMENT(adj), 1.0, 0);
+     gtk_label_set_mnemonic_widget(GTK_LABEL(label), pw->connections);
+     gtk_tooltips_set_tip(tips, pw->connections,
+			  _("With more than one connection a subtree gets exported in parts, searched for at the same time. The file comes out the same either way."),
+			  Q_("tooltip|With more than one connection a subtree gets exported in parts, searched for at the same time. The file comes out the same either way."));
+     gtk_box_pack_start(GTK_BOX(hbox), pw->connections, FALSE, FALSE, 3);
+     gtk_widget_show(pw->connections);
+
+     pw->split_table = gtk_table_new(2, 3, FALSE);
+     gtk_box_pack_start(GTK_BOX(vbox), pw->split_table, FALSE, FALSE, 3);
+     gtk_widget_show(pw->split_table);
+
+     prefixes = state_value_get_int(exportoptions, "split-by-values", 0);
+
+     pw->by_children =
+	  gq_radio_button_new_with_label(NULL, _("Split by c_hildren"));
+     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(pw->by_children),
+				  !prefixes);
+     gtk_table_attach(GTK_TABLE(pw->split_table), pw->by_children,
+		      0, 3, 0, 1, GTK_FILL, GTK_SHRINK, 2, 2);
+     gtk_widget_show(pw->by_children);
+
+     pw->by_prefixes =
+	  gq_radio_button_new_with_label(gtk_radio_button_group(GTK_RADIO_BUTTON(pw->by_children)),
+					 _("Split by _values of"));
+     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(pw->by_prefixes),
+				  prefixes);
+     gtk_table_attach(GTK_TABLE(pw->split_table), pw->by_prefixes,
+		      0, 1, 1, 2, GTK_FILL, GTK_SHRINK, 2, 2);
+     gtk_widget_show(pw->by_prefixes);
+
+     pw->attribute = gtk_entry_new();
+     gtk_entry_set_width_chars(GTK_ENTRY(pw->attribute), 12);
+     gtk_entry_set_text(GTK_ENTRY(pw->attribute),
+			state_value_get_string(exportoptions,
+					       "split-attribute", "uid"));
+     gtk_table_attach(GTK_TABLE(pw->split_table), pw->attribute,
+		      1, 2, 1, 2, GTK_SHRINK, GTK_SHRINK, 2, 2);
+     gtk_widget_show(pw->attribute);
+
+     pw->prefixes = gtk_entry_new();
+     gtk_entry_set_text(GTK_ENTRY(pw->prefixes),
+			state_value_get_string(exportoptions,
+					       "split-prefixes",
+					       "a-d e-h i-l m-p q-t u-z 0-9"));
+     gtk_tooltips_set_tip(tips, pw->prefixes,
+			  _("What the values start with, one group per part: ranges of characters such as \"a-f\" or prefixes such as \"smith\". Entries fitting none of them form a part of their own."),
+			  Q_("tooltip|What the values start with, one group per part: ranges of characters such as \"a-f\" or prefixes such as \"smith\". Entries fitting none of them form a part of their own."));
+     gtk_table_attach(GTK_TABLE(pw->split_table), pw->prefixes,
+		      2, 3, 1, 2, GTK_FILL | GTK_EXPAND, GTK_SHRINK, 2, 2);
+     gtk_widget_show(pw->prefixes);
+
+     g_signal_connect_swapped(pw->connections, "value-changed",
+			      G_CALLBACK(partition_toggled), pw);
+     g_signal_connect_swapped(pw->by_prefixes, "toggled",
+			      G_CALLBACK(partition_toggled), pw);
+     partition_toggled(pw);
+}
+
+/* fills in p from the dialog, free its strings with
+   free_partitioning() */
+static void get_partitioning(struct partition_widgets *pw,
+			     GqPartitioning *p)
+{
+     const gchar *attribute, *prefixes;
+     gchar **split, **g;
+     GPtrArray *groups;
+
+     p->connections =
+	  gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(pw->connections));
+     p->mode = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(pw->by_prefixes)) ?
+	  GQ_PARTITION_PREFIXES : GQ_PARTITION_CHILDREN;
+     attribute = gtk_entry_get_text(GTK_ENTRY(pw->attribute));
+     prefixes = gtk_entry_get_text(GTK_ENTRY(pw->prefixes));
+
+     state_value_set_int(exportoptions, "connections", p->connections);
+     state_value_set_int(exportoptions, "split-by-values",
+			 p->mode == GQ_PARTITION_PREFIXES);
+     state_value_set_string(exportoptions, "split-attribute", attribute);
+     state_value_set_string(exportoptions, "split-prefixes", prefixes);
+
+     p->attribute = g_strstrip(g_strdup(attribute));
+
+     /* groups are separated by commas and/or spaces */
+     groups = g_ptr_array_new();
+     split = g_strsplit_set(prefixes, ", \t", -1);
+     for (g = split ; *g ; g++) {
+	  if (**g) g_ptr_array_add(groups, g_strdup(*g));
+     }
+     g_ptr_array_add(groups, NULL);
+     g_strfreev(split);
+
+     p->prefixes = (gchar **) g_ptr_array_free(groups, FALSE);
+}
+
+static void free_partitioning(GqPartitioning *p)
+{
+     g_free(p->attribute);
+     g_strfreev(p->prefixes);
+}
+
+/* the writer chosen in the dialog, NULL (and an error pushed) if the
+   choice is incomplete */
+static GqExportWriter *new_writer(struct format_widgets *fw, int ctx)
+{
+     GqExportWriter *writer;
+     GqExportFormat format = GQ_EXPORT_LDIF;
+     const gchar *columns, *separator;
+     gboolean first;
+     gchar **split, **c;
+     GPtrArray *names;
+     int i;
+
+     for (i = 0 ; i < GQ_EXPORT_N_FORMATS ; i++) {
+	  if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(fw->format[i]))) {
+	       format = i;
+	  }
+     }
+     columns = gtk_entry_get_text(GTK_ENTRY(fw->columns));
+     separator = gtk_entry_get_text(GTK_ENTRY(fw->separator));
+     first = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(fw->first_value));
+
+     state_value_set_int(exportoptions, "format", format);
+     state_value_set_string(exportoptions, "columns", columns);
+     state_value_set_string(exportoptions, "separator", separator);
+     state_value_set_int(exportoptions, "first-value", first);
+
+     writer = gq_export_writer_new(format, ctx);
+     if (format != GQ_EXPORT_CSV) return writer;
+
+     /* columns are separated by commas and/or spaces */
+     names = g_ptr_array_new();
+     split = g_strsplit_set(columns, ", \t", -1);
+     for (c = split ; *c ; c++) {
+	  if (**c) g_ptr_array_add(names, *c);
+     }
+     g_ptr_array_add(names, NULL);
+
+     if (names->len > 1) {
+	  gq_export_writer_set_columns(writer, (gchar **) names->pdata);
+	  gq_export_writer_set_multi_value(writer,
+					   first ? GQ_EXPORT_FIRST_VALUE :
+					   GQ_EXPORT_JOIN_VALUES,
+					   separator);
+     } else {
+	  error_push(ctx, _("Please name the columns to export."));
+	  gq_export_writer_free(writer);
+	  writer = NULL;
+     }
+
+     g_ptr_array_free(names, TRUE);
+     g_strfreev(split);
+
+     return writer;
+}
+
+/* Searches dos and writes the entries as they arrive, so only one of
+   them is in memory at a time. Returns the number of entries written,
+   -1 if exporting has to stop. */
+static int dump_one(int ctx, LDAP *ld, struct dn_on_server *dos,
+		    GqExportWriter *writer, GqExportFile *file, GString *out,
+		    GqProgress *progress)
+{
+     LDAPControl ct;
+     LDAPControl *ctrls[2] = { NULL, NULL } ;
+     char *attrs[] = {
+	  LDAP_ALL_USER_ATTRIBUTES,
+	  "ref",
+	  NULL 
+     };
+     LDAPMessage *res, *e;
+     int scope = dos->flags == LDAP_SCOPE_SUBTREE ?
+	  LDAP_SCOPE_SUBTREE : LDAP_SCOPE_BASE;
+     int rc, err, msgid, n = 0, got;
+     gdouble start;
+
+     ct.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+     ct.ldctl_value.bv_val	= NULL;
+     ct.ldctl_value.bv_len	= 0;
+     ct.ldctl_iscritical	= 1;
+
+     ctrls[0] = &ct;
+
+     statusbar_msg(_("Search on %s"), (char *) dos->dn);
+
+ again:
+     start = gq_server_stats_start();
+     rc = ldap_search_ext(ld, (char *) dos->dn, scope, "(objectClass=*)",
+			  attrs, 0, ctrls, NULL, NULL, LDAP_NO_LIMIT,
+			  &msgid);
+
+     while (rc == LDAP_SUCCESS) {
+	  rc = ldap_result(ld, msgid, LDAP_MSG_ONE, NULL, &res);
+	  if (rc == -1) {
+	       ldap_get_option(ld, LDAP_OPT_ERROR_NUMBER, &rc);
+	       if (rc == LDAP_SUCCESS) rc = LDAP_OTHER;
+	       break;
+	  }
+
+	  if (rc == LDAP_RES_SEARCH_RESULT) {
+	       if (ldap_parse_result(ld, res, &err, NULL, NULL, NULL,
+				     NULL, 1) != LDAP_SUCCESS) {
+		    err = LDAP_OTHER;
+	       }
+	       rc = err;
+	       break;
+	  }
+
+	  /* with ManageDSAit referrals come as entries, without it
+	     references are skipped just like before */
+	  got = 0;
+	  for (e = ldap_first_entry(ld, res) ; e ; e = ldap_next_entry(ld, e)) {
+	       gq_export_writer_message(writer, out, ld, e);
+	       got++;
+	  }
+	  ldap_msgfree(res);
+	  rc = LDAP_SUCCESS;
+	  n += got;
+	  gq_progress_add(progress, got);
+
+	  if (out->len >= EXPORT_CHUNK && !gq_export_file_write(file, out)) {
+	       ldap_abandon(ld, msgid);
+	       return -1;
+	  }
+     }
+
+     if (rc == LDAP_NOT_SUPPORTED && ctrls[0] && n == 0) {
+	  /* the server does not know ManageDSAit */
+	  ctrls[0] = NULL;
+	  goto again;
+     }
+
+     gq_server_stats_stop(dos->server, GQ_STAT_SEARCH, start,
+			  rc == LDAP_SUCCESS);
+     gq_server_stats_entries(dos->server, n);
+
+     if (rc == LDAP_SUCCESS) {
+	  return gq_export_file_write(file, out) ? n : -1;
+     }
+
+     if (rc == LDAP_SERVER_DOWN) {
+	  dos->server->server_down++;
+	  error_push(ctx,
+		     _("Server '%s' down. Export may be incomplete!"),
+		     dos->server->name);
+     } else {
+	  error_push(ctx,
+		     _("LDAP error while searching below '%s'."
+		       " Export may be incomplete!"),
+		     (char *) dos->dn);
+     }
+     push_ldap_addl_error(ld, ctx);
+
+     return -1;
+}
+
+int dump_subtrees(int ctx, GList *to_export,
+		  const GqPartitioning *partitioning,
+		  GqExportWriter *writer, GqExportFile *file)
+{
      LDAP *ld = NULL;
      GList *I;
+     int num_entries = -1, n;
+     GString *out;
+     GqServer *last = NULL;
+     GqProgress *progress = NULL;
+
+     out = g_string_sized_new(EXPORT_CHUNK + 4096);
+
+     gq_export_writer_begin(writer, out, to_export);
+     if (!gq_export_file_write(file, out)) goto fail;
+
+     n = 0;
+     progress = gq_progress_new(_("Exporting entries"), 0);
+     for (I = g_list_first(to_export) ; I ; I = g_list_next(I)) {
+	  struct dn_on_server *dos = I->data;
+	  int m;
+
+	  if (last != dos->server) {
+	       if (last) {
+		    close_connection(last, FALSE);
+		    last = NULL;
+	       }
+
+	       if( (ld = open_connection(ctx, dos->server)) == NULL) {
+		    /* no extra error, open_connection does error
+		       reporting itself... */
+		    goto fail;
+	       }
+
+	       last = dos->server;
+	  }
+
+	  if (dos->flags == LDAP_SCOPE_SUBTREE &&
+	      partitioning->connections > 1) {
+	       m = gq_export_partitioned(ctx, ld, dos, partitioning,
+					 writer, file, out, progress);
+	  } else {
+	       m = dump_one(ctx, ld, dos, writer, file, out, progress);
+	  }
+	  if (m < 0) goto fail;
+	  n += m;
+     }
+
+     gq_export_writer_end(writer, out);
+     if (!gq_export_file_write(file, out)) goto fail;
+
+     num_entries = n;
+
+ fail:		/* labels are only good for cleaning up, really */
+     gq_progress_finish(progress);
+     g_string_free(out, TRUE);
+     if (ld && last) close_connection(last, FALSE);
+
+     return num_entries;
+}
+
+static void dump_subtree_ok_callback(struct export *ex)
+{
      int num_entries;
      const char *filename;
-     FILE *outfile = NULL;
-     GString *out = NULL;
-     GString *gmessage = NULL;
-     size_t written;
+     GqExportFile *file = NULL;
+     GqExportWriter *writer = NULL;
      int ctx;
-     GqServer *last = NULL;
-
-     out = g_string_sized_new(2048);
+     GqPartitioning partitioning;
+     gboolean ok;
 
      ctx = error_new_context(_("Dump subtree"), ex->transient_for);
+     error_set_bulk(ctx, ERROR_BULK_SAMPLES, TRUE);
+     get_partitioning(&ex->pw, &partitioning);
 
      if(g_list_length(ex->to_export) == 0) {
 	  error_push(ctx, _("Nothing to dump!"));
@@ -102,138 +677,235 @@ static void dump_subtree_ok_callback(struct export *ex)
 
      set_busycursor();
 
+     writer = new_writer(&ex->fw, ctx);
+     if (writer == NULL) goto fail;
+
      /* obtain filename and open file for reading */
      filename = gtk_file_selection_get_filename(GTK_FILE_SELECTION(ex->filesel));
 
-     if( (outfile = fopen(filename, "w")) == NULL) {
-	  error_push(ctx, _("Could not open output file '%1$s': %2$s"),
-		     filename, strerror(errno));
+     file = gq_export_file_open(filename,
+				get_compression(&ex->fw, filename), ctx);
+     if (file == NULL) goto fail;
 
-	  goto fail;
-     } else {
-	  /* AFAIK, the UMich LDIF format doesn't take comments or a
-             version string */
-	  if (config->ldifformat != LDIF_UMICH) {
-	       g_string_truncate(out, 0);
-	       
-	       prepend_ldif_header(out, ex->to_export);
-
-	       written = fwrite(out->str, 1, out->len, outfile);
-	       if(written != (size_t) out->len) {
-		    error_push(ctx, 
-			       _("Save to '%3$s' failed: Only %1$d of %2$d bytes written"),
-			       written, out->len, filename);
-		    goto fail; /* sometimes goto is useful */
-	       }
-	  }
-	  
-	  num_entries = 0;
-	  gmessage = g_string_sized_new(256);
-	  for (I = g_list_first(ex->to_export) ; I ; I = g_list_next(I)) {
-	       struct dn_on_server *dos = I->data;
-
-	       LDAPControl ct;
-	       LDAPControl *ctrls[2] = { NULL, NULL } ;
-	       char *attrs[] = {
-		    LDAP_ALL_USER_ATTRIBUTES,
-		    "ref",
-		    NULL 
-	       };
-	       int rc;
-
-	       ct.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
-	       ct.ldctl_value.bv_val	= NULL;
-	       ct.ldctl_value.bv_len	= 0;
-	       ct.ldctl_iscritical	= 1;
-	       
-	       ctrls[0] = &ct;
-	  
-	       statusbar_msg(_("Search on %s"), (char *) dos->dn);
-
-	       if (last != dos->server) {
-		    if (last) {
-			 close_connection(last, FALSE);
-			 last = NULL;
-		    }
+     num_entries = dump_subtrees(ctx, ex->to_export, &partitioning,
+				 writer, file);
+     if (num_entries < 0) goto fail;
 
-		    if( (ld = open_connection(ctx, dos->server)) == NULL) {
-			 /* no extra error, open_connection does error
-			    reporting itself... */
-			 goto fail;
-		    }
+     ok = gq_export_file_close(file);
+     file = NULL;
+     if (ok) {
+	  statusbar_msg(ngettext("%1$d entry exported to %2$s",
+				 "%1$d entries exported to %2$s", num_entries),
+			num_entries, filename);
+     }
 
-		    last = dos->server;
-	       }
+ fail:		/* labels are only good for cleaning up, really */
+     if (file) gq_export_file_close(file);
+     
+     set_normalcursor();
+     gq_export_writer_free(writer);
+     free_partitioning(&partitioning);
 
-	       rc = ldap_search_ext_s(ld, (char *) dos->dn,
-				      dos->flags == LDAP_SCOPE_SUBTREE ? LDAP_SCOPE_SUBTREE : LDAP_SCOPE_BASE, 
-				      "(objectClass=*)", 
-				      attrs,
-				      0, 
-				      ctrls,		/* serverctrls */
-				      NULL,		/* clientctrls */
-				      NULL,		/* timeout */
-				      LDAP_NO_LIMIT,	/* sizelimit */
-				      &res);
-
-	       if(rc == LDAP_NOT_SUPPORTED) {
-		    rc = ldap_search_s(ld, (char *) dos->dn,
-				       dos->flags == LDAP_SCOPE_SUBTREE ? LDAP_SCOPE_SUBTREE : LDAP_SCOPE_BASE,
-				       "(objectClass=*)",
-				       attrs, 0, &res);
-	       }
+     gtk_widget_destroy(ex->filesel);
 
-	       if (rc == LDAP_SUCCESS) {
-		    for(e = ldap_first_entry(ld, res); e; e = ldap_next_entry(ld, e)) {
-			 g_string_truncate(out, 0);
-			 ldif_entry_out(out, ld, e, ctx);
-			 num_entries++;
-			 
-			 written = fwrite(out->str, 1, out->len, outfile);
-			 if(written != (size_t) out->len) {
-			      g_string_sprintf(gmessage,
-					       _("%1$d of %2$d bytes written"),
-					       written, out->len);
-			      error_popup(_("Save failed"), gmessage->str,
-					  ex->transient_for);
-
-			      ldap_msgfree(res);
-			      goto fail;
-			 }
+     error_flush(ctx);
+}
 
+/* Reads entries the search did not get all attributes of again and
+   writes them. The base searches are pipelined: up to
+   EXPORT_PIPELINE_DEPTH of them are on their way while the results
+   get written in the order of entries. Returns the number of entries
+   written, -1 if exporting has to stop. */
+static int fetch_and_write(int ctx, GList *entries, GqExportWriter *writer,
+			   GqExportFile *file, GString *out,
+			   GqProgress *progress)
+{
+     struct pending_fetch pending[EXPORT_PIPELINE_DEPTH], *p;
+     int head = 0, count = 0, num_entries = 0, rc, err;
+     GqServer *server = NULL;
+     LDAP *ld = NULL;
+     LDAPMessage *res, *e;
+     LDAPControl ct;
+     LDAPControl *ctrls[2] = { NULL, NULL } ;
+     char *attrs[] = {
+	  LDAP_ALL_USER_ATTRIBUTES,
+	  "ref",
+	  NULL 
+     };
+     gboolean ok = TRUE;
+
+     /* not critical, so there is no need to retry without it */
+     ct.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+     ct.ldctl_value.bv_val	= NULL;
+     ct.ldctl_value.bv_len	= 0;
+     ct.ldctl_iscritical	= 0;
+
+     ctrls[0] = &ct;
+
+     while (ok && (entries || count > 0)) {
+	  /* send ahead, to one server at a time */
+	  while (entries && count < EXPORT_PIPELINE_DEPTH) {
+	       GqResultEntry *entry = entries->data;
+
+	       if (entry->set.server != server) {
+		    if (count > 0) break;
+
+		    if (server) close_connection(server, FALSE);
+		    server = entry->set.server;
+		    if ((ld = open_connection(ctx, server)) == NULL) {
+			 /* open_connection does error reporting itself */
+			 server = NULL;
+			 ok = FALSE;
+			 break;
 		    }
-		    ldap_msgfree(res);
-	       } else if (rc == LDAP_SERVER_DOWN) {
-		    dos->server->server_down++;
-		    
-		    error_push(ctx,
-			       _("Server '%s' down. Export may be incomplete!"),
-			       dos->server->name);
-		    push_ldap_addl_error(ld, ctx);
-		    goto fail;
-	       } else {
-		    /* report error */
+	       }
+
+	       p = &pending[(head + count) % EXPORT_PIPELINE_DEPTH];
+	       p->entry = entry;
+	       p->start = gq_server_stats_start();
+	       rc = ldap_search_ext(ld, (char *) entry->set.dn,
+				    LDAP_SCOPE_BASE, "(objectClass=*)",
+				    attrs, 0, ctrls, NULL, NULL,
+				    LDAP_NO_LIMIT, &p->msgid);
+	       if (rc != LDAP_SUCCESS) {
+		    if (rc == LDAP_SERVER_DOWN) server->server_down++;
 		    error_push(ctx,
 			       _("LDAP error while searching below '%s'."
 				 " Export may be incomplete!"),
-			       (char *) dos->dn);
+			       entry->set.dn);
 		    push_ldap_addl_error(ld, ctx);
-		    goto fail;
+		    ok = FALSE;
+		    break;
 	       }
+	       count++;
+	       entries = g_list_next(entries);
+	  }
+	  if (!ok || count == 0) break;
+
+	  /* then write the oldest */
+	  p = &pending[head];
+	  rc = ldap_result(ld, p->msgid, LDAP_MSG_ALL, NULL, &res);
+	  if (rc == -1) {
+	       ldap_get_option(ld, LDAP_OPT_ERROR_NUMBER, &rc);
+	       if (rc == LDAP_SERVER_DOWN) server->server_down++;
+	       error_push(ctx,
+			  _("LDAP error while searching below '%s'."
+			    " Export may be incomplete!"),
+			  p->entry->set.dn);
+	       push_ldap_addl_error(ld, ctx);
+	       ok = FALSE;
+	       break;
+	  }
+	  head = (head + 1) % EXPORT_PIPELINE_DEPTH;
+	  count--;
+
+	  for (e = ldap_first_entry(ld, res) ; e ; e = ldap_next_entry(ld, e)) {
+	       gq_export_writer_message(writer, out, ld, e);
+	       num_entries++;
 	  }
+	  gq_progress_add(progress, 1);
+
+	  if (ldap_parse_result(ld, res, &err, NULL, NULL, NULL,
+				NULL, 1) != LDAP_SUCCESS) {
+	       err = LDAP_OTHER;
+	  }
+	  gq_server_stats_stop(server, GQ_STAT_SEARCH, p->start,
+			       err == LDAP_SUCCESS);
+	  if (err == LDAP_SUCCESS) {
+	       gq_server_stats_entries(server, 1);
+	  } else {
+	       /* it may be gone by now, carry on with the others */
+	       error_push_ldap(ctx, _("Reading entries"), err,
+			       _("Could not read '%1$s': %2$s"),
+			       p->entry->set.dn, ldap_err2string(err));
+	  }
+
+	  if (out->len >= EXPORT_CHUNK && !gq_export_file_write(file, out)) {
+	       ok = FALSE;
+	  }
+     }
 
+     /* whatever is still on its way is of no use any longer */
+     for ( ; count > 0 ; count--) {
+	  ldap_abandon(ld, pending[head].msgid);
+	  head = (head + 1) % EXPORT_PIPELINE_DEPTH;
+     }
+     if (server) close_connection(server, FALSE);
+
+     return ok ? num_entries : -1;
+}
+
+static void export_results_ok_callback(struct result_export *ex)
+{
+     const char *filename;
+     GqExportFile *file = NULL;
+     GString *out;
+     GqExportWriter *writer;
+     GList *I, *sets = NULL;
+     GqProgress *progress = NULL;
+     int ctx, num_entries = 0;
+     gboolean ok;
+
+     ctx = error_new_context(_("Exporting search results"),
+			     ex->transient_for);
+     error_set_bulk(ctx, ERROR_BULK_SAMPLES, TRUE);
+
+     out = g_string_sized_new(EXPORT_CHUNK + 4096);
+     set_busycursor();
+
+     writer = new_writer(&ex->fw, ctx);
+     if (writer == NULL) goto fail;
+
+     filename = gtk_file_selection_get_filename(GTK_FILE_SELECTION(ex->filesel));
+
+     file = gq_export_file_open(filename,
+				get_compression(&ex->fw, filename), ctx);
+     if (file == NULL) goto fail;
+
+     for (I = ex->entries ; I ; I = g_list_next(I)) {
+	  sets = g_list_prepend(sets, &GQ_RESULT_ENTRY(I->data)->set);
+     }
+     sets = g_list_reverse(sets);
+     gq_export_writer_begin(writer, out, sets);
+     g_list_free(sets);
+
+     progress = gq_progress_new(_("Exporting entries"),
+				g_list_length(ex->entries));
+     if (gq_result_store_is_complete(ex->store)) {
+	  /* no need to ask the server(s) again */
+	  for (I = ex->entries ; I ; I = g_list_next(I)) {
+	       gq_export_writer_entry(writer, out, I->data);
+	       num_entries++;
+	       gq_progress_add(progress, 1);
+
+	       if (out->len >= EXPORT_CHUNK &&
+		   !gq_export_file_write(file, out)) goto fail;
+	  }
+     } else {
+	  if (!gq_export_file_write(file, out)) goto fail;
+	  num_entries = fetch_and_write(ctx, ex->entries, writer, file, out,
+					progress);
+	  if (num_entries < 0) goto fail;
+     }
+
+     gq_export_writer_end(writer, out);
+     if (!gq_export_file_write(file, out)) goto fail;
+
+     ok = gq_export_file_close(file);
+     file = NULL;
+     if (ok) {
 	  statusbar_msg(ngettext("%1$d entry exported to %2$s",
 				 "%1$d entries exported to %2$s", num_entries),
 			num_entries, filename);
      }
 
- fail:		/* labels are only good for cleaning up, really */
-     if (outfile) fclose(outfile);
-     
+ fail:
+     if (file) gq_export_file_close(file);
+     gq_progress_finish(progress);
+
      set_normalcursor();
-     if (out) g_string_free(out, TRUE);
-     if (gmessage) g_string_free(gmessage, TRUE);
-     if (ld && last) close_connection(last, FALSE);
+     g_string_free(out, TRUE);
+     gq_export_writer_free(writer);
 
      gtk_widget_destroy(ex->filesel);
 
@@ -245,11 +917,14 @@ void export_many(int error_context, GtkWidget *transient_for, GList *to_export)
      GtkWidget *filesel;
      struct export *ex = new_export();
 
-     filesel = gtk_file_selection_new(_("Save LDIF"));
+     filesel = gtk_file_selection_new(_("Export"));
      ex->to_export = to_export;
      ex->filesel = filesel;
      ex->transient_for = transient_for;
 
+     add_format_widgets(filesel, &ex->fw, NULL);
+     add_partition_widgets(filesel, &ex->pw);
+
      gtk_object_set_data_full(GTK_OBJECT(filesel), "export",
 			      ex, (GtkDestroyNotify) free_export);
 
@@ -268,6 +943,47 @@ void export_many(int error_context, GtkWidget *transient_for, GList *to_export)
 
 }
 
+void export_results(int error_context, GtkWidget *transient_for,
+		    GqResultStore *store, GList *entries)
+{
+     GtkWidget *filesel;
+     struct result_export *ex = g_malloc0(sizeof(struct result_export));
+     GString *columns = NULL;
+     gchar **r;
+
+     filesel = gtk_file_selection_new(_("Export"));
+     ex->store = gq_result_store_ref(store);
+     ex->entries = entries;
+     ex->filesel = filesel;
+     ex->transient_for = transient_for;
+
+     /* CSV of what the search asked for suggests itself */
+     if (!gq_result_store_is_complete(store)) {
+	  columns = g_string_new("dn");
+	  for (r = store->requested ; *r ; r++) {
+	       g_string_append_printf(columns, ",%s", *r);
+	  }
+     }
+     add_format_widgets(filesel, &ex->fw, columns ? columns->str : NULL);
+     if (columns) g_string_free(columns, TRUE);
+
+     gtk_object_set_data_full(GTK_OBJECT(filesel), "export",
+			      ex, (GtkDestroyNotify) free_result_export);
+
+     g_signal_connect_swapped(GTK_FILE_SELECTION(filesel)->ok_button,
+			       "clicked",
+			       G_CALLBACK(export_results_ok_callback),
+			       ex);
+     g_signal_connect_swapped(GTK_FILE_SELECTION(filesel)->cancel_button,
+			       "clicked",
+			       G_CALLBACK(gtk_widget_destroy),
+			       GTK_OBJECT(filesel));
+     g_signal_connect_swapped(filesel, "key_press_event",
+			       G_CALLBACK(close_on_esc),
+			       filesel);
+     gtk_widget_show(filesel);
+}
+
 /*
    Local Variables:
    c-basic-offset: 5
@@ -31,11 +31,30 @@
 #include <gtk/gtk.h>		/* GtkWidget */
 
 #include "gq-server.h"		/* GqServer */
+#include "gq-result-store.h"	/* GqResultStore */
+#include "gq-export-file.h"
+#include "gq-export-partition.h"
+#include "gq-export-writer.h"
 
 /* to_export is a GList of dn_on_server objects */
 void export_many(int error_context, GtkWidget *transient_for, 
 		 GList *to_export);
 
+/* writes the dn_on_server objects of to_export (with their subtrees
+   if their flags say LDAP_SCOPE_SUBTREE) to file, splitting up
+   subtrees as partitioning says. No widgets involved, the dialog of
+   export_many ends up here. Returns the number of entries written,
+   -1 (and an error pushed to ctx) if exporting had to stop. */
+int dump_subtrees(int ctx, GList *to_export,
+		  const GqPartitioning *partitioning,
+		  GqExportWriter *writer, GqExportFile *file);
+
+/* entries is a GList of GqResultEntry objects kept in store. Entries
+   are written from memory if the search got all of their attributes,
+   otherwise they are read again. Takes over the list. */
+void export_results(int error_context, GtkWidget *transient_for,
+		    GqResultStore *store, GList *entries);
+
 #endif
 
 
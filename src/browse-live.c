@@ -0,0 +1,723 @@
+/*
+    GQ -- a GTK-based LDAP client
+    Copyright (C) 1998-2003 Bert Vermeulen
+    Copyright (C) 2002-2003 Peter Stamfest
+
+    This program is released under the Gnu General Public License with
+    the additional exemption that compiling, linking, and/or using
+    OpenSSL is allowed.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "browse-live.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+
+#ifdef HAVE_CONFIG_H
+# include  <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <lber.h>
+#include <ldap.h>
+
+#include "common.h"
+#include "gq-browser-node-dn.h"
+#include "gq-tab-browse.h"
+
+#include "errorchain.h"
+#include "input.h"		/* struct inputform */
+#include "util.h"
+
+/* how often (in ms) the open subscriptions get looked at */
+#define LIVE_POLL_INTERVAL	1000
+
+/* every that many polls check for nodes that got collapsed or
+   removed in the meantime */
+#define LIVE_GC_POLLS		10
+
+/* messages handled per subscription and poll, keeps the GUI
+   responsive while a big refresh phase comes in */
+#define LIVE_MAX_MESSAGES	200
+
+/* every subscription is a search kept open on the server, so limit
+   them per server and browse tab */
+#define LIVE_MAX_SUBSCRIPTIONS	64
+
+/* persistent search change types */
+#define PSEARCH_ADD		1
+#define PSEARCH_DELETE		2
+#define PSEARCH_MODIFY		4
+#define PSEARCH_MODDN		8
+
+/* RFC 4533 request mode and entry states */
+#define SYNC_REFRESH_AND_PERSIST 3
+#define SYNC_PRESENT		0
+#define SYNC_ADD		1
+#define SYNC_MODIFY		2
+#define SYNC_DELETE		3
+
+typedef enum {
+     LIVE_NONE,
+     LIVE_ADD,
+     LIVE_DELETE,
+     LIVE_MODIFY,
+     LIVE_MODDN
+} LiveChange;
+
+struct live_subscription {
+     GqServer *server;
+     LDAP *ld;
+     int incarnation;		/* of the connection ld belongs to */
+     int msgid;
+     int method;		/* SERVER_HAS_SYNC or SERVER_HAS_PSEARCH */
+     char *dn;
+
+     /* content synchronisation only: entryUUID -> DN. Renames are
+	reported as a modification of the entry under its new DN,
+	this is how we learn about the old one */
+     GHashTable *uuids;
+     /* content synchronisation only: we did not use a cookie, so the
+	server first sends all children. browse_live_list_children()
+	reads them as the children of the node, otherwise they are
+	known already */
+     gboolean refreshing;
+};
+
+static gboolean live_poll(GqTab *tab);
+
+static void free_subscription(struct live_subscription *sub)
+{
+     GqServer *server = sub->server;
+
+     /* a reconnect or a forced close has freed the handle already,
+	only touch it if it is still the one we searched on */
+     if (server->connection == sub->ld &&
+	 server->incarnation == sub->incarnation) {
+	  ldap_abandon(sub->ld, sub->msgid);
+	  close_connection(server, FALSE);
+     }
+
+     if (sub->uuids) g_hash_table_destroy(sub->uuids);
+     g_free(sub->dn);
+     g_object_unref(server);
+     g_free(sub);
+}
+
+/* FALSE if dn is followed already or server has too many
+   subscriptions */
+static gboolean may_subscribe(GqTabBrowse *browse, GqServer *server,
+			      const char *dn)
+{
+     struct live_subscription *sub;
+     GList *l;
+     int n;
+
+     for (n = 0, l = browse->live ; l ; l = l->next) {
+	  sub = l->data;
+	  if (sub->server != server) continue;
+	  /* still followed from an earlier expansion */
+	  if (strcasecmp(sub->dn, dn) == 0) return FALSE;
+	  n++;
+     }
+     return n < LIVE_MAX_SUBSCRIPTIONS;
+}
+
+/* sends the search of a new subscription, which is not on the list
+   of the tab yet */
+static struct live_subscription *start_subscription(int error_context,
+						   GqServer *server,
+						   LDAP *ld, const char *dn,
+						   int method)
+{
+     struct live_subscription *sub;
+     BerElement *ber;
+     struct berval *bv = NULL;
+     LDAPControl ct, mdsait;
+     LDAPControl *ctrls[3] = { NULL, NULL, NULL };
+     char *dummy[] = { "dummy", NULL };
+     int msgid, rc;
+
+     ber = ber_alloc_t(LBER_USE_DER);
+     if (ber == NULL) return NULL;
+
+     if (method == SERVER_HAS_SYNC) {
+	  ct.ldctl_oid = LDAP_CONTROL_SYNC;
+	  rc = ber_printf(ber, "{e}",
+			  (ber_int_t) SYNC_REFRESH_AND_PERSIST);
+     } else {
+	  /* changesOnly, returnECs */
+	  ct.ldctl_oid = LDAP_CONTROL_PERSIST_REQUEST;
+	  rc = ber_printf(ber, "{ibb}",
+			  (ber_int_t) (PSEARCH_ADD | PSEARCH_DELETE |
+				       PSEARCH_MODIFY | PSEARCH_MODDN),
+			  (ber_int_t) 1, (ber_int_t) 1);
+     }
+     if (rc == -1 || ber_flatten(ber, &bv) == -1) {
+	  ber_free(ber, 1);
+	  return NULL;
+     }
+
+     ct.ldctl_value	= *bv;
+     ct.ldctl_iscritical	= 1;
+
+     mdsait.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+     mdsait.ldctl_value.bv_val	= NULL;
+     mdsait.ldctl_value.bv_len	= 0;
+     mdsait.ldctl_iscritical	= 1;
+
+     ctrls[0] = &ct;
+     ctrls[1] = &mdsait;
+
+     rc = ldap_search_ext(ld, dn, LDAP_SCOPE_ONELEVEL,
+			  "(objectClass=*)", dummy, 1,
+			  ctrls,		/* serverctrls */
+			  NULL,			/* clientctrls */
+			  NULL,			/* timeout */
+			  LDAP_NO_LIMIT,	/* sizelimit */
+			  &msgid);
+
+     ber_bvfree(bv);
+     ber_free(ber, 1);
+
+     if (rc != LDAP_SUCCESS) {
+	  if (rc == LDAP_SERVER_DOWN) {
+	       server->server_down++;
+	  }
+	  statusbar_msg(_("Cannot follow changes below '%1$s': %2$s"),
+			dn, ldap_err2string(rc));
+	  return NULL;
+     }
+
+     /* keep the connection open for as long as the search runs */
+     if (open_connection(error_context, server) != ld) {
+	  ldap_abandon(ld, msgid);
+	  return NULL;
+     }
+
+     sub = g_malloc0(sizeof(struct live_subscription));
+     sub->server = g_object_ref(server);
+     sub->ld = ld;
+     sub->incarnation = server->incarnation;
+     sub->msgid = msgid;
+     sub->method = method;
+     sub->dn = g_strdup(dn);
+     if (method == SERVER_HAS_SYNC) {
+	  sub->uuids = g_hash_table_new_full(g_str_hash, g_str_equal,
+					     g_free, g_free);
+	  sub->refreshing = TRUE;
+     }
+
+     return sub;
+}
+
+static void add_subscription(GqTab *tab, struct live_subscription *sub)
+{
+     GqTabBrowse *browse = GQ_TAB_BROWSE(tab);
+
+     browse->live = g_list_append(browse->live, sub);
+
+     if (browse->live_timer == 0) {
+	  browse->live_timer = gtk_timeout_add(LIVE_POLL_INTERVAL,
+					       (GtkFunction) live_poll,
+					       tab);
+     }
+}
+
+void browse_live_subscribe(int error_context, GqTab *tab,
+			   GqServer *server, LDAP *ld, const char *dn)
+{
+     struct live_subscription *sub;
+     int method;
+
+     if (tab == NULL || !server->live_updates) return;
+     if (!may_subscribe(GQ_TAB_BROWSE(tab), server, dn)) return;
+
+     method = server_live_update_method(server, ld);
+     if (method == 0) return;
+
+     sub = start_subscription(error_context, server, ld, dn, method);
+     if (sub) add_subscription(tab, sub);
+}
+
+void browse_live_unsubscribe_all(GqTab *tab)
+{
+     GqTabBrowse *browse = GQ_TAB_BROWSE(tab);
+
+     if (browse->live_timer) {
+	  gtk_timeout_remove(browse->live_timer);
+	  browse->live_timer = 0;
+     }
+
+     while (browse->live) {
+	  free_subscription(browse->live->data);
+	  browse->live = g_list_delete_link(browse->live, browse->live);
+     }
+}
+
+/* entryUUID values are 16 octets, use them in hex as hash keys */
+static char *uuid_key(const struct berval *bv)
+{
+     GString *key = g_string_sized_new(bv->bv_len * 2 + 1);
+     ber_len_t i;
+
+     for (i = 0 ; i < bv->bv_len ; i++) {
+	  g_string_append_printf(key, "%02x",
+				 (unsigned char) bv->bv_val[i]);
+     }
+     return g_string_free(key, FALSE);
+}
+
+/* Interprets the RFC 4533 sync state control of an entry. Renames
+   are found by comparing the DN with the one last seen for the same
+   entryUUID */
+static LiveChange sync_change(struct live_subscription *sub,
+			      LDAPControl **ctrls, const char *dn,
+			      char **prevdn)
+{
+     LiveChange change = LIVE_NONE;
+     struct berval *uuid = NULL;
+     ber_int_t state;
+     BerElement *ber;
+     const char *old;
+     char *key;
+     int i;
+
+     for (i = 0 ; ctrls && ctrls[i] ; i++) {
+	  if (strcmp(ctrls[i]->ldctl_oid, LDAP_CONTROL_SYNC_STATE) != 0)
+	       continue;
+
+	  ber = ber_init(&ctrls[i]->ldctl_value);
+	  if (ber == NULL) break;
+	  if (ber_scanf(ber, "{eO", &state, &uuid) == LBER_ERROR) {
+	       ber_free(ber, 1);
+	       break;
+	  }
+	  ber_free(ber, 1);
+
+	  key = uuid_key(uuid);
+	  ber_bvfree(uuid);
+
+	  switch (state) {
+	  case SYNC_ADD:
+	  case SYNC_MODIFY:
+	       old = g_hash_table_lookup(sub->uuids, key);
+	       if (old && strcasecmp(old, dn) != 0) {
+		    *prevdn = g_strdup(old);
+		    change = LIVE_MODDN;
+	       } else {
+		    change = state == SYNC_ADD ? LIVE_ADD : LIVE_MODIFY;
+	       }
+	       g_hash_table_replace(sub->uuids, key, g_strdup(dn));
+	       key = NULL;
+	       break;
+	  case SYNC_DELETE:
+	       g_hash_table_remove(sub->uuids, key);
+	       change = LIVE_DELETE;
+	       break;
+	  case SYNC_PRESENT:
+	  default:
+	       break;
+	  }
+	  g_free(key);
+	  break;
+     }
+     return change;
+}
+
+/* Interprets the entry change notification control of a persistent
+   search result */
+static LiveChange psearch_change(LDAPControl **ctrls, char **prevdn)
+{
+     LiveChange change = LIVE_NONE;
+     ber_int_t type;
+     ber_len_t len;
+     BerElement *ber;
+     char *p = NULL;
+     int i;
+
+     for (i = 0 ; ctrls && ctrls[i] ; i++) {
+	  if (strcmp(ctrls[i]->ldctl_oid,
+		     LDAP_CONTROL_PERSIST_ENTRY_CHANGE_NOTICE) != 0)
+	       continue;
+
+	  ber = ber_init(&ctrls[i]->ldctl_value);
+	  if (ber == NULL) break;
+	  if (ber_scanf(ber, "{e", &type) != LBER_ERROR) {
+	       switch (type) {
+	       case PSEARCH_ADD:
+		    change = LIVE_ADD;
+		    break;
+	       case PSEARCH_DELETE:
+		    change = LIVE_DELETE;
+		    break;
+	       case PSEARCH_MODIFY:
+		    change = LIVE_MODIFY;
+		    break;
+	       case PSEARCH_MODDN:
+		    if (ber_peek_tag(ber, &len) == LBER_OCTETSTRING &&
+			ber_scanf(ber, "a", &p) != LBER_ERROR) {
+			 *prevdn = g_strdup(p);
+			 ber_memfree(p);
+			 change = LIVE_MODDN;
+		    } else {
+			 /* no idea where it came from */
+			 change = LIVE_ADD;
+		    }
+		    break;
+	       }
+	  }
+	  ber_free(ber, 1);
+	  break;
+     }
+     return change;
+}
+
+static gboolean form_shows(GqTabBrowse *browse, GqServer *server,
+			   const char *dn)
+{
+     struct inputform *iform = browse->inputform;
+
+     return iform && iform->server == server && iform->olddn &&
+	  strcasecmp(iform->olddn, dn) == 0;
+}
+
+/* TRUE if the user has changed anything in the form */
+static gboolean form_is_edited(struct inputform *iform)
+{
+     LDAPMod **mods;
+     gboolean edited;
+
+     update_formlist(iform);
+     mods = formdiff_to_ldapmod(iform->oldlist, iform->formlist);
+     edited = mods != NULL && mods[0] != NULL;
+     if (mods) ldap_mods_free(mods, 1);
+
+     return edited || strcmp(iform->dn, iform->olddn) != 0;
+}
+
+static void live_entry(GqTabBrowse *browse, struct live_subscription *sub,
+		       GQTreeWidgetNode *parent, LDAPMessage *e,
+		       gboolean *form_changed)
+{
+     GQTreeWidget *ctree = browse->ctreeroot;
+     GQTreeWidgetNode *node;
+     GqBrowserNodeDn *pentry;
+     LDAPControl **ctrls = NULL;
+     LiveChange change;
+     char *dn, *prevdn = NULL;
+
+     dn = ldap_get_dn(sub->ld, e);
+     if (dn == NULL) return;
+
+     if (ldap_get_entry_controls(sub->ld, e, &ctrls) != LDAP_SUCCESS) {
+	  ctrls = NULL;
+     }
+
+     if (sub->method == SERVER_HAS_SYNC) {
+	  change = sync_change(sub, ctrls, dn, &prevdn);
+     } else {
+	  change = psearch_change(ctrls, &prevdn);
+     }
+
+     pentry = GQ_BROWSER_NODE_DN(gq_tree_get_node_data(ctree, parent));
+
+     if (change == LIVE_MODDN) {
+	  node = node_from_dn(ctree, parent, prevdn);
+	  if (node) gq_tree_remove_node(ctree, node);
+
+	  if (form_shows(browse, sub->server, prevdn)) {
+	       if (form_is_edited(browse->inputform)) {
+		    statusbar_msg(_("'%1$s' was renamed to '%2$s' on the server"),
+				  prevdn, dn);
+	       } else {
+		    g_free_and_dup(browse->inputform->olddn, dn);
+		    g_free_and_dup(browse->inputform->dn, dn);
+		    *form_changed = TRUE;
+	       }
+	  }
+	  change = LIVE_ADD;
+     }
+
+     node = node_from_dn(ctree, parent, dn);
+
+     switch (change) {
+     case LIVE_ADD:
+	  if (node == NULL) {
+	       dn_browse_single_add(dn, ctree, parent);
+	       gq_tree_widget_sort_node(GQ_TREE_WIDGET(ctree), parent);
+	       pentry->leaf = FALSE;
+	       break;
+	  }
+	  /* an add for a known entry during the refresh phase is just
+	     the server telling us what we have already */
+	  if (sub->refreshing) break;
+	  /* fall through */
+     case LIVE_MODIFY:
+	  if (form_shows(browse, sub->server, dn)) {
+	       if (form_is_edited(browse->inputform)) {
+		    statusbar_msg(_("'%s' was changed on the server"), dn);
+	       } else {
+		    *form_changed = TRUE;
+	       }
+	  }
+	  break;
+     case LIVE_DELETE:
+	  if (node) gq_tree_remove_node(ctree, node);
+	  break;
+     default:
+	  break;
+     }
+
+     g_free(prevdn);
+     if (ctrls) ldap_controls_free(ctrls);
+     ldap_memfree(dn);
+}
+
+/* Handles what arrived for one subscription. Returns FALSE if the
+   subscription should be dropped. */
+static gboolean poll_subscription(GqTabBrowse *browse,
+				  struct live_subscription *sub,
+				  gboolean gc, gboolean *form_changed)
+{
+     GqServer *server = sub->server;
+     GQTreeWidget *ctree = browse->ctreeroot;
+     GQTreeWidgetNode *parent = NULL;
+     GqBrowserNode *entry;
+     LDAPMessage *res = NULL, *e;
+     struct timeval zero = { 0, 0 };
+     gboolean looked_up = FALSE, keep = TRUE;
+     int rc, err, n;
+
+     if (server->connection != sub->ld ||
+	 server->incarnation != sub->incarnation) {
+	  return FALSE;
+     }
+
+     if (gc) {
+	  parent = tree_node_from_server_dn(ctree, server, sub->dn);
+	  looked_up = TRUE;
+	  if (parent == NULL) return FALSE;
+
+	  if (!gq_tree_is_node_expanded(ctree, parent)) {
+	       /* nobody is looking. The children go stale from now
+		  on, have them read again on the next expansion */
+	       entry = GQ_BROWSER_NODE(gq_tree_get_node_data(ctree, parent));
+	       if (GQ_IS_BROWSER_NODE_DN(entry)) {
+		    GQ_BROWSER_NODE_DN(entry)->seen = FALSE;
+	       }
+	       return FALSE;
+	  }
+     }
+
+     for (n = 0 ; keep && n < LIVE_MAX_MESSAGES ; n++) {
+	  rc = ldap_result(sub->ld, sub->msgid, LDAP_MSG_ONE, &zero, &res);
+	  if (rc == 0) break;
+	  if (rc == -1) {
+	       ldap_get_option(sub->ld, LDAP_OPT_ERROR_NUMBER, &rc);
+	       if (rc == LDAP_SERVER_DOWN) {
+		    server->server_down++;
+	       }
+	       return FALSE;
+	  }
+
+	  switch (rc) {
+	  case LDAP_RES_SEARCH_ENTRY:
+	       if (!looked_up) {
+		    parent = tree_node_from_server_dn(ctree, server, sub->dn);
+		    looked_up = TRUE;
+	       }
+	       entry = parent ?
+		    GQ_BROWSER_NODE(gq_tree_get_node_data(ctree, parent)) :
+		    NULL;
+	       if (!GQ_IS_BROWSER_NODE_DN(entry) ||
+		   !GQ_BROWSER_NODE_DN(entry)->seen) {
+		    keep = FALSE;
+		    break;
+	       }
+
+	       gq_tree_widget_freeze(ctree);
+	       for (e = ldap_first_entry(sub->ld, res) ; e ;
+		    e = ldap_next_entry(sub->ld, e)) {
+		    live_entry(browse, sub, parent, e, form_changed);
+	       }
+	       gq_tree_widget_thaw(ctree);
+	       break;
+#ifdef LDAP_RES_INTERMEDIATE
+	  case LDAP_RES_INTERMEDIATE:
+	       /* the first syncInfo message ends the refresh phase,
+		  later ones only carry cookies we do not use */
+	       sub->refreshing = FALSE;
+	       break;
+#endif
+	  case LDAP_RES_SEARCH_RESULT:
+	       /* the server does not want to keep this up any longer */
+	       if (ldap_parse_result(sub->ld, res, &err, NULL, NULL, NULL,
+				     NULL, 0) == LDAP_SUCCESS) {
+		    statusbar_msg(_("No more live updates below '%1$s': %2$s"),
+				  sub->dn, ldap_err2string(err));
+	       }
+	       keep = FALSE;
+	       break;
+	  default:
+	       break;
+	  }
+
+	  ldap_msgfree(res);
+	  res = NULL;
+     }
+
+     return keep;
+}
+
+#ifdef LDAP_RES_INTERMEDIATE
+/* an entry of the first refresh phase, while listing the children of
+   node. Without a cookie all of them come as adds. TRUE if it got
+   added to the tree. */
+static gboolean refresh_entry(GqTabBrowse *browse,
+			      struct live_subscription *sub,
+			      GQTreeWidgetNode *node, LDAPMessage *e)
+{
+     LDAPControl **ctrls = NULL;
+     LiveChange change;
+     char *dn, *prevdn = NULL;
+
+     dn = ldap_get_dn(sub->ld, e);
+     if (dn == NULL) return FALSE;
+
+     if (ldap_get_entry_controls(sub->ld, e, &ctrls) != LDAP_SUCCESS) {
+	  ctrls = NULL;
+     }
+
+     /* remembers the entryUUID for telling renames later on */
+     change = sync_change(sub, ctrls, dn, &prevdn);
+     if (change == LIVE_ADD || change == LIVE_MODIFY ||
+	 change == LIVE_MODDN) {
+	  /* sorted by the caller once all are there */
+	  dn_browse_single_add(dn, browse->ctreeroot, node);
+     }
+
+     g_free(prevdn);
+     if (ctrls) ldap_controls_free(ctrls);
+     ldap_memfree(dn);
+
+     return change != LIVE_NONE && change != LIVE_DELETE;
+}
+#endif
+
+int browse_live_list_children(int error_context, GqTab *tab,
+			      GqServer *server, LDAP *ld, const char *dn,
+			      GQTreeWidgetNode *node)
+{
+#ifdef LDAP_RES_INTERMEDIATE
+     GqTabBrowse *browse;
+     struct live_subscription *sub;
+     LDAPMessage *res = NULL, *e;
+     int rc, n = 0;
+
+     if (tab == NULL || !server->live_updates) return -1;
+     browse = GQ_TAB_BROWSE(tab);
+     if (!may_subscribe(browse, server, dn)) return -1;
+     if (server_live_update_method(server, ld) != SERVER_HAS_SYNC) {
+	  return -1;
+     }
+
+     sub = start_subscription(error_context, server, ld, dn,
+			      SERVER_HAS_SYNC);
+     if (sub == NULL) return -1;
+
+     /* no progress here: counting lets the main loop run, which may
+	close the tab or drop node while the tree is frozen half-way
+	through the expand. The caller reports the count when done. */
+     while (sub->refreshing) {
+	  rc = ldap_result(ld, sub->msgid, LDAP_MSG_ONE, NULL, &res);
+	  if (rc == LDAP_RES_SEARCH_ENTRY) {
+	       for (e = ldap_first_entry(ld, res) ; e ;
+		    e = ldap_next_entry(ld, e)) {
+		    if (refresh_entry(browse, sub, node, e)) n++;
+	       }
+	  } else if (rc == LDAP_RES_INTERMEDIATE) {
+	       /* syncInfo: the refresh phase is over */
+	       sub->refreshing = FALSE;
+	  } else if (rc != LDAP_RES_SEARCH_REFERENCE) {
+	       /* failed or ended, the caller searches the usual way */
+	       if (rc == -1) {
+		    ldap_get_option(ld, LDAP_OPT_ERROR_NUMBER, &rc);
+		    if (rc == LDAP_SERVER_DOWN) server->server_down++;
+	       }
+	       if (res) ldap_msgfree(res);
+	       gq_tree_remove_children(browse->ctreeroot, node);
+	       free_subscription(sub);
+	       return -1;
+	  }
+	  if (res) ldap_msgfree(res);
+	  res = NULL;
+     }
+
+     add_subscription(tab, sub);
+     return n;
+#else
+     /* without intermediate responses the end of the refresh phase
+	cannot be told */
+     return -1;
+#endif
+}
+
+static gboolean live_poll(GqTab *tab)
+{
+     GqTabBrowse *browse = GQ_TAB_BROWSE(tab);
+     struct live_subscription *sub;
+     struct inputform *iform;
+     gboolean gc, form_changed = FALSE, keep;
+     GList *l, *next;
+
+     /* refreshing the form runs the main loop, which might close the
+	tab */
+     g_object_ref(tab);
+
+     gc = (++browse->live_polls % LIVE_GC_POLLS) == 0;
+
+     for (l = browse->live ; l ; l = next) {
+	  next = l->next;
+	  sub = l->data;
+
+	  if (!poll_subscription(browse, sub, gc, &form_changed)) {
+	       browse->live = g_list_delete_link(browse->live, l);
+	       free_subscription(sub);
+	  }
+     }
+
+     keep = browse->live != NULL;
+     if (!keep) browse->live_timer = 0;
+
+     /* only set if the user had not touched the form */
+     iform = browse->inputform;
+     if (form_changed && iform) {
+	  refresh_inputform(iform);
+     }
+
+     g_object_unref(tab);
+     return keep;
+}
+
+/*
+   Local Variables:
+   c-basic-offset: 5
+   End:
+ */
@@ -0,0 +1,63 @@
+/*
+    GQ -- a GTK-based LDAP client
+    Copyright (C) 1998-2003 Bert Vermeulen
+    Copyright (C) 2002-2003 Peter Stamfest
+
+    This program is released under the Gnu General Public License with
+    the additional exemption that compiling, linking, and/or using
+    OpenSSL is allowed.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef GQ_BROWSE_LIVE_H_INCLUDED
+#define GQ_BROWSE_LIVE_H_INCLUDED
+
+#include <ldap.h>
+
+#include "gq-server.h"		/* GqServer */
+#include "gq-tab.h"		/* GqTab */
+#include "gq-tree-widget.h"	/* GQTreeWidgetNode */
+
+/* Starts following the children of dn in a browse tab. Called once
+   dn got expanded, ld must be the open connection to server. Does
+   nothing unless the server has live updates switched on and
+   supports either RFC 4533 content synchronisation or persistent
+   search. Changes get applied to the tree (and the entry being
+   edited) from a timeout, subscriptions of nodes that got collapsed
+   or removed are dropped again. */
+void browse_live_subscribe(int error_context, GqTab *tab,
+			   GqServer *server, LDAP *ld, const char *dn);
+
+/* For servers doing content synchronisation: subscribes to dn and
+   reads the refresh phase of the subscription as the children of
+   node, which the caller then need not search for (and sort). This
+   way the server sends each child once. Returns the number of
+   children, -1 if the caller has to search the usual way and
+   subscribe afterwards. */
+int browse_live_list_children(int error_context, GqTab *tab,
+			      GqServer *server, LDAP *ld, const char *dn,
+			      GQTreeWidgetNode *node);
+
+/* drops all subscriptions of a browse tab */
+void browse_live_unsubscribe_all(GqTab *tab);
+
+#endif
+
+/* 
+   Local Variables:
+   c-basic-offset: 5
+   End:
+ */
@@ -411,9 +411,17 @@ write_server(GQServerList* list, GqServer* server, gpointer user_data) {
 				 "search-attribute", NULL);
 	  if(server->maxentries != DEFAULT_MAXENTRIES)
 	       config_write_int(wc, server->maxentries, "maxentries", NULL);
+	  if(server->browse_window != DEFAULT_BROWSE_WINDOW)
+	       config_write_int(wc, server->browse_window,
+				"browse-window-size", NULL);
 	  if(server->cacheconn != DEFAULT_CACHECONN)
 	       config_write_bool(wc, server->cacheconn, 
 				 "cache-connection", NULL);
+	  if(server->live_updates != DEFAULT_LIVE_UPDATES)
+	       config_write_bool(wc, server->live_updates,
+				 "live-updates", NULL);
+	  if(server->warmup != DEFAULT_WARMUP)
+	       config_write_bool(wc, server->warmup, "warm-up", NULL);
 	  if(server->enabletls != DEFAULT_ENABLETLS)
 	       config_write_bool(wc, server->enabletls, "enable-tls", NULL);
 	  if(server->local_cache_timeout != DEFAULT_LOCAL_CACHE_TIMEOUT)
@@ -53,10 +53,13 @@
 #define MAX_ENTITY_LEN        64   /* not using XML attributes anyway */
 #define MAX_DATA_LEN         128
 #define DEFAULT_MAXENTRIES   200
+#define DEFAULT_BROWSE_WINDOW 500
 #define DEFAULT_SEARCHATTR   "cn"
 #define DEFAULT_BINDTYPE     BINDTYPE_SIMPLE
 #define DEFAULT_LDIFFORMAT   LDIF_UMICH
 #define DEFAULT_CACHECONN      1
+#define DEFAULT_LIVE_UPDATES   0
+#define DEFAULT_WARMUP         0
 #define DEFAULT_ENABLETLS      0
 #define DEFAULT_LOCAL_CACHE_TIMEOUT -1
 #define DEFAULT_LOCAL_CACHE_SIZE (512*1024)
@@ -58,187 +58,124 @@
 #include "formfill.h"
 #include "dt_cert.h"
 
-static void dt_cert_fill_clist(struct formfill *form,
-			       GtkWidget *hbox,
-			       GtkWidget *data_widget,
-			       GByteArray *internal,
-			       GtkWidget *clist);
+static gboolean dt_cert_summarize(const GByteArray *data,
+				  struct dt_clist_summary *summary);
 
 static void dt_cert_fill_details(struct formfill *form,
 				 GtkWidget *data_widget,
-				 GtkWidget *text,
-				 GByteArray *internal,
-				 GtkWidget *clist);
-
-static void dt_cert_fill_clist(struct formfill *form,
-			       GtkWidget *hbox,
-			       GtkWidget *data_widget,
-			       GByteArray *internal,
-			       GtkWidget *clist)
+				 GtkWidget *vbox, GtkWidget *text,
+				 GByteArray *internal);
+
+/* Parses data as DER, PEM or PKCS12, in this order, straight from the
+   value instead of copying it into a BIO for every try. converted
+   gets set if data was not DER. */
+static X509 *dt_cert_parse(const GByteArray *data, const gchar **converted)
 {
-     if (internal) {
-	  if (internal->len > 0) {
-	       BIO *databio;
-	       X509 *x = NULL;
-	       gboolean changed = FALSE;
-
-	       int rc;
-	       databio = BIO_new(BIO_s_mem());
-
-	       rc = BIO_write(databio, internal->data, internal->len);
-
-	       x = d2i_X509_bio(databio, NULL);
-	       if (!x) {
-		    /* try PEM */
-		    BIO_reset(databio);
-		    rc = BIO_write(databio, internal->data, internal->len);
-
-		    x = PEM_read_bio_X509(databio, NULL, NULL, NULL);
-
-		    if (x) {
-			 single_warning_popup(_("Converted data from PEM to DER encoding"));
-			 changed = TRUE;
-		    }
-	       }
-	       if (!x) {
-		    /* try PKCS12 - but without a password this is not
-                       really useful.... hmmmm*/
-		    PKCS12 *p12 = NULL;
-
-		    BIO_reset(databio);
-		    rc = BIO_write(databio, internal->data, internal->len);
-
-		    p12 = d2i_PKCS12_bio(databio, NULL);
-		    
-		    if (p12) {
-			 PKCS12_parse(p12, NULL, NULL, &x, NULL);
-			 PKCS12_free(p12);
-		    }
-
-		    if (x) {
-			 single_warning_popup(_("Converted data from PKCS12 to DER encoding"));
-			 changed = TRUE;
-		    }
-	       }
-
-	       if (x && changed) {
-		    BIO *bufbio = BIO_new(BIO_s_mem());
-		    BUF_MEM *bm;
-		    GByteArray *gb;
-		    
-		    /* convert data into DER form! */
-		    i2d_X509_bio(bufbio, x);
-		    BIO_get_mem_ptr(bufbio, &bm);
-		    
-		    gb = g_byte_array_new();
-		    g_byte_array_append(gb, (guchar*)bm->data, bm->length);
-		    
-		    gtk_object_set_data_full(GTK_OBJECT(data_widget), "data", 
-					     gb,
-					     (GtkDestroyNotify) free_internal_data);
-
-		    BIO_free(bufbio);
-		    internal = gb;
-	       }
-
-	       if (x) {
-		    X509_NAME *n = X509_get_subject_name(x);
-		    BIO *bufbio = BIO_new(BIO_s_mem());
-		    BUF_MEM *bm;
-		    char *cols[3] = { NULL, NULL, NULL };
-
-		    X509_NAME_print(bufbio, n, 0);
-		    BIO_write(bufbio, "", 1); /* write NUL byte */
-
-		    BIO_get_mem_ptr(bufbio, &bm);
-
-		    cols[0] = _("Subject");
-		    cols[1] = bm->data;
-		    gtk_clist_append(GTK_CLIST(clist), cols);
-
-		    BIO_reset(bufbio);
-		    n = X509_get_issuer_name(x);
-
-		    X509_NAME_print(bufbio, n, 0);
-		    BIO_write(bufbio, "", 1); /* write NUL byte */
-
-		    BIO_get_mem_ptr(bufbio, &bm);
-
-		    cols[0] = _("Issuer");
-		    cols[1] = bm->data;
-		    gtk_clist_append(GTK_CLIST(clist), cols);
-
-		    BIO_reset(bufbio);
-		    ASN1_TIME_print(bufbio, X509_get_notBefore(x));
-		    BIO_get_mem_ptr(bufbio, &bm);
-
-		    cols[0] = _("Not Before");
-		    cols[1] = bm->data;
-		    gtk_clist_append(GTK_CLIST(clist), cols);
-
-		    BIO_reset(bufbio);
-		    ASN1_TIME_print(bufbio, X509_get_notAfter(x));
-		    BIO_get_mem_ptr(bufbio, &bm);
-
-		    cols[0] = _("Not After");
-		    cols[1] = bm->data;
-		    gtk_clist_append(GTK_CLIST(clist), cols);
-
-		    BIO_reset(bufbio);
-		    /* the OpenSSL guys seem to originally have
-		       introduced X509_get_serialNumber in a non
-		       standard way. Then they have deleted it
-		       entirely... so we do it ourselves... */
-		    BIO_printf(bufbio, "%ld", 
-			       ASN1_INTEGER_get(x->cert_info->serialNumber));
-		    BIO_get_mem_ptr(bufbio, &bm);
-
-		    cols[0] = _("Serial#");
-		    cols[1] = bm->data;
-		    gtk_clist_append(GTK_CLIST(clist), cols);
-
-		    /* Version:
-		     * Version 0x00 actually means Version 1 */
-		    BIO_reset(bufbio);
-		    BIO_printf(bufbio, "%ld", X509_get_version(x) + 1);
-		    BIO_get_mem_ptr(bufbio, &bm);
-
-		    cols[0] = _("Version");
-		    cols[1] = bm->data;
-		    gtk_clist_append(GTK_CLIST(clist), cols);
-
-		    gtk_object_set_data_full(GTK_OBJECT(data_widget), "x509", 
-					     x,
-					     (GtkDestroyNotify) X509_free);
-
-		    BIO_free(bufbio);
-	       } else {
-		    BIO *err;
-		    err = BIO_new(BIO_s_mem());
-  		    ERR_print_errors(err);
-
-		    /* FIXME: report error */
-
-		    BIO_free(err);
-	       }
-
-	       BIO_free(databio);
+     const unsigned char *p = data->data;
+     X509 *x;
+
+     x = d2i_X509(NULL, &p, data->len);
+     if (x) return x;
+
+     if (g_strstr_len((const gchar *) data->data, data->len, "-----BEGIN")) {
+	  BIO *databio = BIO_new_mem_buf(data->data, data->len);
+
+	  x = PEM_read_bio_X509(databio, NULL, NULL, NULL);
+	  BIO_free(databio);
+
+	  if (x && converted) {
+	       *converted = _("Converted data from PEM to DER encoding");
+	  }
+     } else {
+	  /* try PKCS12 - but without a password this is not
+	     really useful.... hmmmm*/
+	  PKCS12 *p12;
+
+	  p = data->data;
+	  p12 = d2i_PKCS12(NULL, &p, data->len);
+	  if (p12) {
+	       PKCS12_parse(p12, NULL, NULL, &x, NULL);
+	       PKCS12_free(p12);
 	  }
-  	  if (hbox) gtk_widget_set_usize(GTK_WIDGET(hbox), -1, 60);
+
+	  if (x && converted) {
+	       *converted = _("Converted data from PKCS12 to DER encoding");
+	  }
+     }
+     return x;
+}
+
+static gboolean dt_cert_summarize(const GByteArray *data,
+				  struct dt_clist_summary *summary)
+{
+     X509 *x;
+     BIO *bufbio;
+
+     x = dt_cert_parse(data, &summary->converted);
+     if (x == NULL) return FALSE;
+
+     if (summary->converted) {
+	  /* convert data into DER form! */
+	  int len = i2d_X509(x, NULL);
+	  unsigned char *p;
+
+	  summary->der = g_byte_array_new();
+	  g_byte_array_set_size(summary->der, len);
+	  p = summary->der->data;
+	  i2d_X509(x, &p);
      }
+
+     bufbio = BIO_new(BIO_s_mem());
+
+     X509_NAME_print(bufbio, X509_get_subject_name(x), 0);
+     dt_clist_add_row(summary->rows, _("Subject"), bufbio);
+
+     X509_NAME_print(bufbio, X509_get_issuer_name(x), 0);
+     dt_clist_add_row(summary->rows, _("Issuer"), bufbio);
+
+     ASN1_TIME_print(bufbio, X509_get_notBefore(x));
+     dt_clist_add_row(summary->rows, _("Not Before"), bufbio);
+
+     ASN1_TIME_print(bufbio, X509_get_notAfter(x));
+     dt_clist_add_row(summary->rows, _("Not After"), bufbio);
+
+     /* the OpenSSL guys seem to originally have
+	introduced X509_get_serialNumber in a non
+	standard way. Then they have deleted it
+	entirely... so we do it ourselves... */
+     BIO_printf(bufbio, "%ld",
+		ASN1_INTEGER_get(x->cert_info->serialNumber));
+     dt_clist_add_row(summary->rows, _("Serial#"), bufbio);
+
+     /* Version:
+      * Version 0x00 actually means Version 1 */
+     BIO_printf(bufbio, "%ld", X509_get_version(x) + 1);
+     dt_clist_add_row(summary->rows, _("Version"), bufbio);
+
+     BIO_free(bufbio);
+     X509_free(x);
+
+     return TRUE;
 }
 
+/* only parsed again when asked for, the list itself does not need
+   the certificate */
 static void dt_cert_fill_details(struct formfill *form,
 				 GtkWidget *data_widget,
-				 GtkWidget *text,
-				 GByteArray *internal,
-				 GtkWidget *clist)
+				 GtkWidget *vbox, GtkWidget *text,
+				 GByteArray *internal)
 {
-     X509 *x = gtk_object_get_data(GTK_OBJECT(data_widget), "x509");
+     X509 *x;
      BIO *data;
      BUF_MEM *bm;
 
-     if (x == NULL) return;
+     if (internal == NULL) return;
+
+     x = dt_cert_parse(internal, NULL);
+     if (x == NULL) {
+	  ERR_clear_error();
+	  return;
+     }
 
      data = BIO_new(BIO_s_mem());
      X509_print(data, x);
@@ -248,6 +185,7 @@ static void dt_cert_fill_details(struct formfill *form,
 		     bm->data, bm->length);
 
      BIO_free(data);
+     X509_free(x);
 }
 
 /* GType */
@@ -277,7 +215,7 @@ gq_display_cert_class_init(GQDisplayCertClass* self_class) {
 	gdbg_class->delete_data = dt_clist_delete_data;
 	gdbg_class->show_entries = dt_clist_show_entries;
 
-	gdc_class->fill_clist = dt_cert_fill_clist;
+	gdc_class->summarize = dt_cert_summarize;
 	gdc_class->fill_details = dt_cert_fill_details;
 }
 
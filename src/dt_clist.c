@@ -51,6 +51,8 @@
 #include <openssl/asn1.h>
 #include <openssl/pem.h>
 #include <openssl/pkcs12.h>
+#include <openssl/buffer.h>
+#include <openssl/sha.h>
 
 #include "common.h"
 #include "util.h"
@@ -58,9 +60,217 @@
 #include "formfill.h"
 #include "dt_clist.h"
 
+/* how many summaries to keep */
+#define SUMMARY_CACHE_SIZE	128
+
+/* values are told apart by their display type and content */
+struct summary_key {
+     GType type;
+     guchar digest[SHA_DIGEST_LENGTH];
+};
+
+static GHashTable *summaries = NULL;	/* struct summary_key ->
+					   struct dt_clist_summary */
+static GQueue *summaries_lru = NULL;	/* keys, least recently used first */
+
 static void dt_clist_details_button_clicked(GtkButton* button,
 					   GtkWidget *data_widget);
 
+static guint summary_key_hash(gconstpointer key)
+{
+     const struct summary_key *k = key;
+     guint h;
+
+     memcpy(&h, k->digest, sizeof(h));
+     return h ^ (guint) k->type;
+}
+
+static gboolean summary_key_equal(gconstpointer a, gconstpointer b)
+{
+     const struct summary_key *ka = a, *kb = b;
+     return ka->type == kb->type &&
+	  memcmp(ka->digest, kb->digest, SHA_DIGEST_LENGTH) == 0;
+}
+
+static gint summary_key_compare(gconstpointer a, gconstpointer b)
+{
+     return summary_key_equal(a, b) ? 0 : 1;
+}
+
+static void free_summary(struct dt_clist_summary *summary)
+{
+     g_ptr_array_foreach(summary->rows, (GFunc) g_free, NULL);
+     g_ptr_array_free(summary->rows, TRUE);
+     if (summary->der) g_byte_array_free(summary->der, TRUE);
+     g_free(summary);
+}
+
+static struct dt_clist_summary *lookup_summary(const struct summary_key *key)
+{
+     struct dt_clist_summary *summary;
+     GList *l;
+
+     if (summaries == NULL) return NULL;
+
+     summary = g_hash_table_lookup(summaries, key);
+     if (summary) {
+	  /* now the most recently used */
+	  l = g_queue_find_custom(summaries_lru, key, summary_key_compare);
+	  g_queue_unlink(summaries_lru, l);
+	  g_queue_push_tail_link(summaries_lru, l);
+     }
+     return summary;
+}
+
+static void remember_summary(const struct summary_key *key,
+			     struct dt_clist_summary *summary)
+{
+     struct summary_key *k;
+
+     if (summaries == NULL) {
+	  summaries = g_hash_table_new_full(summary_key_hash,
+					    summary_key_equal,
+					    g_free,
+					    (GDestroyNotify) free_summary);
+	  summaries_lru = g_queue_new();
+     }
+
+     if (g_queue_get_length(summaries_lru) >= SUMMARY_CACHE_SIZE) {
+	  k = g_queue_pop_head(summaries_lru);
+	  g_hash_table_remove(summaries, k);	/* frees k */
+     }
+
+     k = g_memdup(key, sizeof(struct summary_key));
+     g_hash_table_insert(summaries, k, summary);
+     g_queue_push_tail(summaries_lru, k);
+}
+
+static void summary_key_init(struct summary_key *key, GType type,
+			     const GByteArray *data)
+{
+     key->type = type;
+     SHA1(data->data, data->len, key->digest);
+}
+
+/* values that cannot be parsed get an empty summary, so they are not
+   tried again either */
+static struct dt_clist_summary *get_summary(GType type,
+					    const GByteArray *data)
+{
+     struct summary_key key;
+     struct dt_clist_summary *summary;
+     GQTypeDisplayClass *klass;
+
+     summary_key_init(&key, type, data);
+     summary = lookup_summary(&key);
+     if (summary) return summary;
+
+     summary = g_new0(struct dt_clist_summary, 1);
+     summary->rows = g_ptr_array_new();
+
+     klass = g_type_class_ref(type);
+     if (DT_CLIST(klass)->summarize) {
+	  DT_CLIST(klass)->summarize(data, summary);
+     }
+     g_type_class_unref(klass);
+
+     /* failed tries leave their errors, which would only pile up */
+     ERR_clear_error();
+
+     remember_summary(&key, summary);
+     return summary;
+}
+
+void dt_clist_add_row(GPtrArray *rows, const gchar *label, BIO *bio)
+{
+     BUF_MEM *bm;
+
+     BIO_get_mem_ptr(bio, &bm);
+     g_ptr_array_add(rows, g_strdup(label));
+     g_ptr_array_add(rows, g_strndup(bm->data, bm->length));
+     BIO_reset(bio);
+}
+
+static void set_column_widths(GtkCList *clist)
+{
+     int i;
+
+     for ( i = 0 ; i < 2 ; i ++ ) {
+	  gtk_clist_set_column_width(clist, i,
+				     gtk_clist_optimal_column_width(clist, i));
+     }
+}
+
+/* shows the summary of the value of data_widget if that has not
+   happened yet, converting the value to DER if need be */
+static void dt_clist_fill(GtkWidget *data_widget)
+{
+     GtkCList *clist = (GtkCList*) GTK_BIN(data_widget)->child;
+     GByteArray *internal;
+     GType type;
+     struct dt_clist_summary *summary;
+     const gchar *converted = NULL;
+     char *cols[3] = { NULL, NULL, NULL };
+     guint i;
+
+     if (!gtk_object_get_data(GTK_OBJECT(data_widget), "pending")) return;
+     gtk_object_remove_data(GTK_OBJECT(data_widget), "pending");
+
+     internal = gtk_object_get_data(GTK_OBJECT(data_widget), "data");
+     if (internal == NULL || internal->len == 0) return;
+
+     type = GPOINTER_TO_SIZE(gtk_object_get_data(GTK_OBJECT(data_widget),
+						 "dt-type"));
+     summary = get_summary(type, internal);
+
+     if (summary->der) {
+	  GByteArray *gb = g_byte_array_new();
+	  g_byte_array_append(gb, summary->der->data, summary->der->len);
+
+	  gtk_object_set_data_full(GTK_OBJECT(data_widget), "data",
+				   gb,
+				   (GtkDestroyNotify) free_internal_data);
+	  converted = summary->converted;
+     }
+
+     gtk_clist_freeze(clist);
+     for (i = 0 ; i + 1 < summary->rows->len ; i += 2) {
+	  cols[0] = g_ptr_array_index(summary->rows, i);
+	  cols[1] = g_ptr_array_index(summary->rows, i + 1);
+	  gtk_clist_append(clist, cols);
+     }
+     set_column_widths(clist);
+     gtk_clist_thaw(clist);
+
+     /* last, the summary may be gone once the popup is */
+     if (converted) single_warning_popup((char *) converted);
+}
+
+static gboolean dt_clist_fill_idle(GtkWidget *data_widget)
+{
+     gtk_object_remove_data(GTK_OBJECT(data_widget), "fill-scheduled");
+
+     /* unless destroyed in the meantime */
+     if (GTK_BIN(data_widget)->child) dt_clist_fill(data_widget);
+     return FALSE;
+}
+
+/* parsing waits until the list actually gets drawn */
+static gboolean dt_clist_exposed(GtkWidget *clist, GdkEventExpose *event,
+				 GtkWidget *data_widget)
+{
+     if (gtk_object_get_data(GTK_OBJECT(data_widget), "pending") &&
+	 !gtk_object_get_data(GTK_OBJECT(data_widget), "fill-scheduled")) {
+	  gtk_object_set_data(GTK_OBJECT(data_widget), "fill-scheduled",
+			      GINT_TO_POINTER(1));
+	  g_idle_add_full(G_PRIORITY_DEFAULT_IDLE,
+			  (GSourceFunc) dt_clist_fill_idle,
+			  g_object_ref(data_widget),
+			  g_object_unref);
+     }
+     return FALSE;
+}
+
 GtkWidget *dt_clist_get_widget(int error_context,
 			       struct formfill *form,
 			       GByteArray *data,
@@ -115,7 +325,6 @@ GtkWidget *dt_clist_get_data_widget(struct formfill *form,
 {
      GtkWidget *data_widget;
      GtkWidget *clist;
-     int i;
 
      data_widget = gtk_scrolled_window_new(NULL, NULL);
      gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(data_widget),
@@ -123,13 +332,15 @@ GtkWidget *dt_clist_get_data_widget(struct formfill *form,
 				    GTK_POLICY_AUTOMATIC);
      gtk_widget_show(data_widget);
 
+     gtk_object_set_data(GTK_OBJECT(data_widget), "dt-type",
+			 GSIZE_TO_POINTER(form->dt_handler));
+
      clist = gtk_clist_new(2);
      gtk_widget_show(clist);
+     set_column_widths(GTK_CLIST(clist));
 
-     for ( i = 0 ; i < 2 ; i ++ ) {
-	  gtk_clist_set_column_width(GTK_CLIST(clist), i, 
-				     gtk_clist_optimal_column_width(GTK_CLIST(clist), i));
-     }
+     g_signal_connect(clist, "expose_event",
+		      G_CALLBACK(dt_clist_exposed), data_widget);
 
      gtk_container_add(GTK_CONTAINER(data_widget), clist);
 
@@ -145,11 +356,13 @@ static void dt_clist_details_button_clicked(GtkButton* button,
 	  dt_generic_binary_retrieve_data_widget(widget);
      struct formfill *form;
      GQTypeDisplayClass* klass;
-     GtkCList *clist;
-     GByteArray *data = gtk_object_get_data(GTK_OBJECT(data_widget), "data");
+     GByteArray *data;
 
      form = dt_generic_binary_retrieve_formfill(widget);
-     clist = (GtkCList*) GTK_BIN(data_widget)->child;
+
+     /* the value may still have to be converted */
+     dt_clist_fill(data_widget);
+     data = gtk_object_get_data(GTK_OBJECT(data_widget), "data");
 
      klass =  g_type_class_ref(form->dt_handler);
 
@@ -200,9 +413,8 @@ static void dt_clist_details_button_clicked(GtkButton* button,
      gtk_container_add(GTK_CONTAINER(scrwin), text);
 
      if (DT_CLIST(klass)->fill_details) {
-	  DT_CLIST(klass)->fill_details(form,
-						   data_widget, text,
-						   data, GTK_WIDGET(clist));
+	  DT_CLIST(klass)->fill_details(form, data_widget,
+					vbox, text, data);
      }
 
      gtk_widget_show(window);
@@ -219,12 +431,12 @@ void dt_clist_store_data(struct formfill *form,
 			 const GByteArray *data)
 {
      GtkCList *clist = (GtkCList*) GTK_BIN(data_widget)->child;
-     int i;
 
      gtk_clist_freeze(clist);
      gtk_clist_clear(clist);
 
      gtk_object_remove_data(GTK_OBJECT(data_widget), "data"); 
+     gtk_object_remove_data(GTK_OBJECT(data_widget), "pending");
 
      if(data) {
 	  GByteArray *internal = g_byte_array_new();
@@ -234,20 +446,19 @@ void dt_clist_store_data(struct formfill *form,
 				   internal,
 				   (GtkDestroyNotify) free_internal_data);
 	  if (internal->len > 0) {
-	       GQTypeDisplayClass* klass = g_type_class_ref(form->dt_handler);
-	       if (DT_CLIST(klass)->fill_clist) {
-		    DT_CLIST(klass)->fill_clist(form, hbox,
-							   data_widget,
-							   internal, 
-							   GTK_WIDGET(clist));
-	       }
-	       g_type_class_unref(klass);
-	  }
+	       struct summary_key key;
+
+	       gtk_object_set_data(GTK_OBJECT(data_widget), "pending",
+				   GINT_TO_POINTER(1));
 
-	  for ( i = 0 ; i < 2 ; i ++ ) {
-	       gtk_clist_set_column_width(GTK_CLIST(clist), i, 
-					  gtk_clist_optimal_column_width(clist, i));
+	       /* no need to wait for what is known already */
+	       summary_key_init(&key, form->dt_handler, internal);
+	       if (lookup_summary(&key)) dt_clist_fill(data_widget);
+
+	       if (hbox) gtk_widget_set_usize(GTK_WIDGET(hbox), -1, 60);
 	  }
+
+	  set_column_widths(clist);
      }
      gtk_clist_thaw(clist);
 }
@@ -260,6 +471,9 @@ GByteArray *dt_clist_get_data(struct formfill *form, GtkWidget *hbox)
      if(widget) {
 	  GByteArray *internal;
 	  GByteArray *copy = NULL;
+
+	  /* the value may still have to be converted */
+	  dt_clist_fill(data_widget);
 	  internal = (GByteArray *) gtk_object_get_data(GTK_OBJECT(data_widget),
 							"data");
 
@@ -278,19 +492,16 @@ void dt_clist_delete_data(struct formfill *form,
 			  GtkWidget *data_widget)
 {
      GtkCList *clist = (GtkCList*) GTK_BIN(data_widget)->child;
-     int i;
 
      gtk_clist_freeze(clist);
      gtk_clist_clear(clist);
      
      gtk_object_remove_data(GTK_OBJECT(data_widget), "data");
+     gtk_object_remove_data(GTK_OBJECT(data_widget), "pending");
      gtk_widget_set_usize(hbox, -1, DT_CLIST_EMPTY_HEIGHT);
 
-     for ( i = 0 ; i < 2 ; i ++ ) {
-	  gtk_clist_set_column_width(clist, i, 
-				     gtk_clist_optimal_column_width(clist, i));
-     }
-	  
+     set_column_widths(clist);
+
      gtk_clist_thaw(clist);
 }
 
@@ -336,7 +547,7 @@ gq_display_clist_class_init(GQDisplayCListClass* self_class) {
 	gdbg_class->delete_data = dt_clist_delete_data;
 	gdbg_class->show_entries = dt_clist_show_entries;
 
-	self_class->fill_clist = NULL;
+	self_class->summarize = NULL;
 	self_class->fill_details = NULL;
 }
 
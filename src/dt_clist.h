@@ -34,6 +34,8 @@
 #endif /* HAVE_CONFIG_H */
 #ifdef HAVE_LIBCRYPTO
 
+#include <openssl/bio.h>
+
 #include "syntax.h"
 #include "dt_generic_binary.h"
 
@@ -49,17 +51,28 @@ typedef struct _GQDisplayCListClass GQDisplayCListClass;
 
 GType gq_display_clist_get_type(void);
 
+/* What the list shows for a value. Values only get parsed once their
+   list is drawn (or their data is needed), and the summaries are kept
+   by the digest of the value, so showing the same value again does
+   not parse it again. */
+struct dt_clist_summary {
+     GPtrArray *rows;		/* label, value, label, value, ... */
+     GByteArray *der;		/* the value converted to DER, NULL if
+				   it already was */
+     const gchar *converted;	/* what to tell about the conversion */
+};
+
 struct _GQDisplayCListClass {
      GQDisplayBinaryGenericClass dt_generic;
 
-     void (*fill_clist)(struct formfill *form,
-			GtkWidget *hbox, GtkWidget *data_widget,
-			GByteArray *internal,
-			GtkWidget *clist);
+     /* adds the rows for data to summary, FALSE if data cannot be
+	parsed */
+     gboolean (*summarize)(const GByteArray *data,
+			   struct dt_clist_summary *summary);
      void (*fill_details)(struct formfill *form,
-			  GtkWidget *hbox, GtkWidget *data_widget,
-			  GByteArray *internal,
-			  GtkWidget *clist);
+			  GtkWidget *data_widget,
+			  GtkWidget *vbox, GtkWidget *text,
+			  GByteArray *internal);
 };
 
 /* Methods, only to be used by subclasses */
@@ -90,6 +103,9 @@ void dt_clist_show_entries(struct formfill *form,
 
 void free_internal_data(GByteArray *gb);
 
+/* adds a row with what has been printed to bio, and empties bio */
+void dt_clist_add_row(GPtrArray *rows, const gchar *label, BIO *bio);
+
 #endif /* HAVE_LIBCRYPTO */
 
 #endif
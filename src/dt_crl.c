@@ -51,183 +51,409 @@
 #include <openssl/asn1.h>
 #include <openssl/pem.h>
 #include <openssl/buffer.h>
+#include <openssl/x509v3.h>
 
 #include "common.h"
 #include "util.h"
 #include "formfill.h"
+#include "input.h"	/* CONTAINER_BORDER_WIDTH */
 #include "dt_crl.h"
 
-static void dt_crl_fill_clist(struct formfill *form,
-			      GtkWidget *hbox,
-			      GtkWidget *data_widget,
-			      GByteArray *internal,
-			      GtkWidget *clist);
+/* CRLs can revoke a lot of certificates. The list of them in the
+   details is a model over the CRL itself, a row only gets formatted
+   when the view asks for it, and with rows of fixed height the view
+   does not ask for more than it shows. */
+
+enum {
+     REVOKED_COL_SERIAL,	/* gchararray */
+     REVOKED_COL_DATE,		/* gchararray */
+     REVOKED_N_COLUMNS
+};
+
+typedef struct {
+     GObject base_instance;
+
+     gint stamp;
+     X509_CRL *crl;
+     STACK_OF(X509_REVOKED) *revoked;	/* part of crl */
+     gint n;
+} GqRevokedModel;
+typedef GObjectClass GqRevokedModelClass;
+
+static GType gq_revoked_model_get_type(void);
+#define GQ_TYPE_REVOKED_MODEL	(gq_revoked_model_get_type())
+#define GQ_REVOKED_MODEL(i)	(G_TYPE_CHECK_INSTANCE_CAST((i), GQ_TYPE_REVOKED_MODEL, GqRevokedModel))
+
+/* an iter points to the revoked certificate with the index in
+   user_data */
+#define ITER_INDEX(iter)	GPOINTER_TO_INT((iter)->user_data)
+
+static gboolean dt_crl_summarize(const GByteArray *data,
+				 struct dt_clist_summary *summary);
 
 static void dt_crl_fill_details(struct formfill *form,
 				GtkWidget *data_widget,
-				GtkWidget *text,
-				GByteArray *internal,
-				GtkWidget *clist);
-
-static void dt_crl_fill_clist(struct formfill *form,
-			       GtkWidget *hbox,
-			       GtkWidget *data_widget,
-			       GByteArray *internal,
-			       GtkWidget *clist)
+				GtkWidget *vbox, GtkWidget *text,
+				GByteArray *internal);
+
+/* Parses data as DER or PEM, straight from the value. converted gets
+   set if data was not DER. */
+static X509_CRL *dt_crl_parse(const GByteArray *data,
+			      const gchar **converted)
 {
+     const unsigned char *p = data->data;
+     X509_CRL *x;
 
-     if (internal) {
-	  if (internal->len > 0) {
-	       BIO *databio;
-	       X509_CRL *x = NULL;
-	       gboolean changed = FALSE;
-
-	       int rc;
-	       databio = BIO_new(BIO_s_mem());
-
-	       rc = BIO_write(databio, internal->data, internal->len);
-
-	       x = d2i_X509_CRL_bio(databio, NULL);
-	       if (!x) {
-		    /* try PEM */
-		    BIO_reset(databio);
-		    rc = BIO_write(databio, internal->data, internal->len);
-
-		    x = PEM_read_bio_X509_CRL(databio, NULL, NULL, NULL);
-
-		    if (x) {
-			 single_warning_popup(_("Converted data from PEM to DER encoding"));
-			 changed = TRUE;
-		    }
-	       }
-
-	       if (x && changed) {
-		    BIO *bufbio = BIO_new(BIO_s_mem());
-		    BUF_MEM *bm;
-		    GByteArray *gb;
-
-		    /* convert data into DER form! */
-		    i2d_X509_CRL_bio(bufbio, x);
-		    BIO_get_mem_ptr(bufbio, &bm);
-
-		    gb = g_byte_array_new();
-		    g_byte_array_append(gb, (guchar*)bm->data, bm->length);
-
-		    gtk_object_set_data_full(GTK_OBJECT(data_widget), "data",
-					     gb,
-					     (GtkDestroyNotify) free_internal_data);
-
-		    BIO_free(bufbio);
-		    internal = gb;
-	       }
-
-	       if (x) {
-		    X509_NAME *n = X509_CRL_get_issuer(x);
-		    BIO *bufbio = BIO_new(BIO_s_mem());
-		    BUF_MEM *bm;
-		    char *cols[3] = { NULL, NULL, NULL };
-	            STACK_OF(X509_REVOKED) *rev;
-	            /* X509_REVOKED *r;
-		       int i; */
-
-		    X509_NAME_print(bufbio, n, 0);
-		    BIO_write(bufbio, "", 1); /* write NUL byte */
-
-		    BIO_get_mem_ptr(bufbio, &bm);
-
-		    cols[0] = _("Issuer");
-		    cols[1] = bm->data;
-		    gtk_clist_append(GTK_CLIST(clist), cols);
-
-		    BIO_reset(bufbio);
-		    ASN1_TIME_print(bufbio, X509_CRL_get_lastUpdate(x));
-		    BIO_get_mem_ptr(bufbio, &bm);
-
-		    cols[0] = _("Last update");
-		    cols[1] = bm->data;
-		    gtk_clist_append(GTK_CLIST(clist), cols);
-
-		    BIO_reset(bufbio);
-		    ASN1_TIME_print(bufbio, X509_CRL_get_nextUpdate(x));
-		    BIO_get_mem_ptr(bufbio, &bm);
-
-		    cols[0] = _("Next update");
-		    cols[1] = bm->data;
-		    gtk_clist_append(GTK_CLIST(clist), cols);
-
-		    /* list of revoked certs */
-
-		    rev = X509_CRL_get_REVOKED(x);
-		    /* NOTE: we do _not_ have to free rev, it is part
-		       of the CRL itself */
-		    cols[0] = _("Number of revoked certificates");
-
-		    BIO_reset(bufbio);
-		    BIO_printf(bufbio, "%ld", (glong)sk_X509_REVOKED_num(rev));
-		    BIO_get_mem_ptr(bufbio, &bm);
-		    cols[1] = bm->data;
-
-		    /*
-		    for(i = 0 ; i < sk_X509_REVOKED_num(rev) ; i++) {
-		        r = sk_X509_REVOKED_value(rev, i);
-		        BIO_printf(bufbio, "%ld", r->serialNumber);
-		        BIO_get_mem_ptr(bufbio, &bm);
-			cols[1] = bm->data;
-		    }
-		    */
-		    gtk_clist_append(GTK_CLIST(clist), cols);
-
-		    /* Version:
-		     * Version 0x00 actually means Version 1 */
-		    BIO_reset(bufbio);
-		    BIO_printf(bufbio, "%ld", X509_CRL_get_version(x) + 1);
-		    BIO_get_mem_ptr(bufbio, &bm);
-
-		    cols[0] = _("Version");
-		    cols[1] = bm->data;
-		    gtk_clist_append(GTK_CLIST(clist), cols);
-
-		    BIO_free(bufbio);
-
-		    gtk_object_set_data_full(GTK_OBJECT(data_widget),
-					     "x509_crl", x,
-					     (GtkDestroyNotify) X509_CRL_free);
-	       } else {
-		    BIO *err;
-		    err = BIO_new(BIO_s_mem());
-		    ERR_print_errors(err);
-
-		    /* FIXME: report error */
-
-		    BIO_free(err);
-	       }
-
-	       BIO_free(databio);
+     x = d2i_X509_CRL(NULL, &p, data->len);
+     if (x) return x;
+
+     if (g_strstr_len((const gchar *) data->data, data->len, "-----BEGIN")) {
+	  BIO *databio = BIO_new_mem_buf(data->data, data->len);
+
+	  x = PEM_read_bio_X509_CRL(databio, NULL, NULL, NULL);
+	  BIO_free(databio);
+
+	  if (x && converted) {
+	       *converted = _("Converted data from PEM to DER encoding");
 	  }
-	  if (hbox) gtk_widget_set_usize(GTK_WIDGET(hbox), -1, 60);
      }
+     return x;
+}
+
+static gboolean dt_crl_summarize(const GByteArray *data,
+				 struct dt_clist_summary *summary)
+{
+     X509_CRL *x;
+     BIO *bufbio;
+
+     x = dt_crl_parse(data, &summary->converted);
+     if (x == NULL) return FALSE;
+
+     if (summary->converted) {
+	  /* convert data into DER form! */
+	  int len = i2d_X509_CRL(x, NULL);
+	  unsigned char *p;
+
+	  summary->der = g_byte_array_new();
+	  g_byte_array_set_size(summary->der, len);
+	  p = summary->der->data;
+	  i2d_X509_CRL(x, &p);
+     }
+
+     bufbio = BIO_new(BIO_s_mem());
+
+     X509_NAME_print(bufbio, X509_CRL_get_issuer(x), 0);
+     dt_clist_add_row(summary->rows, _("Issuer"), bufbio);
+
+     ASN1_TIME_print(bufbio, X509_CRL_get_lastUpdate(x));
+     dt_clist_add_row(summary->rows, _("Last update"), bufbio);
+
+     /* optional, see print_crl() */
+     if (X509_CRL_get_nextUpdate(x)) {
+	  ASN1_TIME_print(bufbio, X509_CRL_get_nextUpdate(x));
+     } else {
+	  BIO_printf(bufbio, "%s", _("None"));
+     }
+     dt_clist_add_row(summary->rows, _("Next update"), bufbio);
+
+     /* NOTE: we do _not_ have to free the list of revoked
+	certificates, it is part of the CRL itself. The list only
+	gets shown with the details. */
+     BIO_printf(bufbio, "%ld",
+		(glong) sk_X509_REVOKED_num(X509_CRL_get_REVOKED(x)));
+     dt_clist_add_row(summary->rows, _("Number of revoked certificates"),
+		      bufbio);
+
+     /* Version:
+      * Version 0x00 actually means Version 1 */
+     BIO_printf(bufbio, "%ld", X509_CRL_get_version(x) + 1);
+     dt_clist_add_row(summary->rows, _("Version"), bufbio);
+
+     BIO_free(bufbio);
+     X509_CRL_free(x);
+
+     return TRUE;
+}
+
+static void gq_revoked_model_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(GqRevokedModel, gq_revoked_model, G_TYPE_OBJECT,
+			G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL,
+					      gq_revoked_model_tree_model_init));
+
+/* takes over crl */
+static GqRevokedModel *gq_revoked_model_new(X509_CRL *crl)
+{
+     GqRevokedModel *model = g_object_new(GQ_TYPE_REVOKED_MODEL, NULL);
+
+     model->crl = crl;
+     model->revoked = X509_CRL_get_REVOKED(crl);
+     model->n = model->revoked ? sk_X509_REVOKED_num(model->revoked) : 0;
+     return model;
+}
+
+static void set_iter(GqRevokedModel *model, GtkTreeIter *iter, gint index)
+{
+     iter->stamp = model->stamp;
+     iter->user_data = GINT_TO_POINTER(index);
+}
+
+static GtkTreeModelFlags revoked_get_flags(GtkTreeModel *tree_model)
+{
+     return GTK_TREE_MODEL_ITERS_PERSIST | GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint revoked_get_n_columns(GtkTreeModel *tree_model)
+{
+     return REVOKED_N_COLUMNS;
+}
+
+static GType revoked_get_column_type(GtkTreeModel *tree_model, gint column)
+{
+     g_return_val_if_fail(column >= 0 && column < REVOKED_N_COLUMNS,
+			  G_TYPE_INVALID);
+     return G_TYPE_STRING;
+}
+
+static gboolean revoked_get_iter(GtkTreeModel *tree_model, GtkTreeIter *iter,
+				 GtkTreePath *path)
+{
+     GqRevokedModel *model = GQ_REVOKED_MODEL(tree_model);
+     gint index;
+
+     if (gtk_tree_path_get_depth(path) != 1) return FALSE;
+
+     index = gtk_tree_path_get_indices(path)[0];
+     if (index < 0 || index >= model->n) return FALSE;
+
+     set_iter(model, iter, index);
+     return TRUE;
+}
+
+static GtkTreePath *revoked_get_path(GtkTreeModel *tree_model,
+				     GtkTreeIter *iter)
+{
+     g_return_val_if_fail(iter->stamp == GQ_REVOKED_MODEL(tree_model)->stamp,
+			  NULL);
+
+     return gtk_tree_path_new_from_indices(ITER_INDEX(iter), -1);
+}
+
+static void revoked_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter,
+			      gint column, GValue *value)
+{
+     GqRevokedModel *model = GQ_REVOKED_MODEL(tree_model);
+     X509_REVOKED *r;
+     BIO *bufbio;
+     BUF_MEM *bm;
+
+     g_return_if_fail(iter->stamp == model->stamp);
+
+     g_value_init(value, G_TYPE_STRING);
+
+     r = sk_X509_REVOKED_value(model->revoked, ITER_INDEX(iter));
+     bufbio = BIO_new(BIO_s_mem());
+
+     switch (column) {
+     case REVOKED_COL_SERIAL:
+	  i2a_ASN1_INTEGER(bufbio, r->serialNumber);
+	  break;
+     case REVOKED_COL_DATE:
+	  ASN1_TIME_print(bufbio, r->revocationDate);
+	  break;
+     }
+
+     BIO_get_mem_ptr(bufbio, &bm);
+     g_value_take_string(value, g_strndup(bm->data, bm->length));
+     BIO_free(bufbio);
+}
+
+static gboolean revoked_iter_next(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+     GqRevokedModel *model = GQ_REVOKED_MODEL(tree_model);
+
+     g_return_val_if_fail(iter->stamp == model->stamp, FALSE);
+
+     if (ITER_INDEX(iter) + 1 >= model->n) return FALSE;
+
+     set_iter(model, iter, ITER_INDEX(iter) + 1);
+     return TRUE;
+}
+
+static gboolean revoked_iter_nth_child(GtkTreeModel *tree_model,
+				       GtkTreeIter *iter,
+				       GtkTreeIter *parent, gint n)
+{
+     GqRevokedModel *model = GQ_REVOKED_MODEL(tree_model);
+
+     /* a plain list */
+     if (parent != NULL || n < 0 || n >= model->n) return FALSE;
+
+     set_iter(model, iter, n);
+     return TRUE;
+}
+
+static gboolean revoked_iter_children(GtkTreeModel *tree_model,
+				      GtkTreeIter *iter, GtkTreeIter *parent)
+{
+     return revoked_iter_nth_child(tree_model, iter, parent, 0);
+}
+
+static gboolean revoked_iter_has_child(GtkTreeModel *tree_model,
+				       GtkTreeIter *iter)
+{
+     return FALSE;
+}
+
+static gint revoked_iter_n_children(GtkTreeModel *tree_model,
+				    GtkTreeIter *iter)
+{
+     return iter == NULL ? GQ_REVOKED_MODEL(tree_model)->n : 0;
+}
+
+static gboolean revoked_iter_parent(GtkTreeModel *tree_model,
+				    GtkTreeIter *iter, GtkTreeIter *child)
+{
+     return FALSE;
+}
+
+static void gq_revoked_model_tree_model_init(GtkTreeModelIface *iface)
+{
+     iface->get_flags = revoked_get_flags;
+     iface->get_n_columns = revoked_get_n_columns;
+     iface->get_column_type = revoked_get_column_type;
+     iface->get_iter = revoked_get_iter;
+     iface->get_path = revoked_get_path;
+     iface->get_value = revoked_get_value;
+     iface->iter_next = revoked_iter_next;
+     iface->iter_children = revoked_iter_children;
+     iface->iter_has_child = revoked_iter_has_child;
+     iface->iter_n_children = revoked_iter_n_children;
+     iface->iter_nth_child = revoked_iter_nth_child;
+     iface->iter_parent = revoked_iter_parent;
+}
+
+static void gq_revoked_model_init(GqRevokedModel *self)
+{
+     do {
+	  self->stamp = g_random_int();
+     } while (self->stamp == 0);
+}
+
+static void revoked_model_finalize(GObject *object)
+{
+     GqRevokedModel *self = GQ_REVOKED_MODEL(object);
+
+     if (self->crl) X509_CRL_free(self->crl);
+
+     G_OBJECT_CLASS(gq_revoked_model_parent_class)->finalize(object);
+}
+
+static void gq_revoked_model_class_init(GqRevokedModelClass *self_class)
+{
+     G_OBJECT_CLASS(self_class)->finalize = revoked_model_finalize;
+}
+
+/* X509_CRL_print without the revoked certificates, those go to a
+   list of their own */
+static void print_crl(BIO *data, X509_CRL *x)
+{
+     BIO_printf(data, "Certificate Revocation List (CRL):\n");
+     BIO_printf(data, "%8sVersion %ld (0x%lx)\n", "",
+		X509_CRL_get_version(x) + 1, X509_CRL_get_version(x));
+     BIO_printf(data, "%8sSignature Algorithm: ", "");
+     i2a_ASN1_OBJECT(data, x->sig_alg->algorithm);
+     BIO_printf(data, "\n%8sIssuer: ", "");
+     X509_NAME_print(data, X509_CRL_get_issuer(x), 0);
+     BIO_printf(data, "\n%8sLast Update: ", "");
+     ASN1_TIME_print(data, X509_CRL_get_lastUpdate(x));
+     BIO_printf(data, "\n%8sNext Update: ", "");
+     if (X509_CRL_get_nextUpdate(x)) {
+	  ASN1_TIME_print(data, X509_CRL_get_nextUpdate(x));
+     } else {
+	  BIO_printf(data, "NONE");
+     }
+     BIO_printf(data, "\n");
+     X509V3_extensions_print(data, "CRL extensions",
+			     x->crl->extensions, 0, 8);
 }
 
+/* only parsed again when asked for, the list itself does not need
+   the CRL */
 static void dt_crl_fill_details(struct formfill *form,
 				GtkWidget *data_widget,
-				GtkWidget *text,
-				GByteArray *internal,
-				GtkWidget *clist)
+				GtkWidget *vbox, GtkWidget *text,
+				GByteArray *internal)
 {
-     X509_CRL *x = gtk_object_get_data(GTK_OBJECT(data_widget), "x509_crl");
+     X509_CRL *x;
      BIO *data;
      BUF_MEM *bm;
+     GtkWidget *label, *scrwin, *treeview;
+     GtkTreeViewColumn *column;
+     GqRevokedModel *model;
+     gchar *msg;
 
-     if (x == NULL) return;
+     if (internal == NULL) return;
+
+     x = dt_crl_parse(internal, NULL);
+     if (x == NULL) {
+	  ERR_clear_error();
+	  return;
+     }
 
      data = BIO_new(BIO_s_mem());
-     X509_CRL_print(data, x);
+     print_crl(data, x);
      BIO_get_mem_ptr(data, &bm);
 
      gtk_text_insert(GTK_TEXT(text), NULL, NULL, NULL,
 		     bm->data, bm->length);
 
      BIO_free(data);
+
+     /* list of revoked certs */
+     msg = g_strdup_printf(_("Revoked certificates: %ld"),
+			   (glong) sk_X509_REVOKED_num(X509_CRL_get_REVOKED(x)));
+     label = gtk_label_new(msg);
+     g_free(msg);
+     gtk_misc_set_alignment(GTK_MISC(label), 0.0, 0.5);
+     gtk_widget_show(label);
+     gtk_box_pack_start(GTK_BOX(vbox), label, FALSE, FALSE,
+			CONTAINER_BORDER_WIDTH);
+
+     scrwin = gtk_scrolled_window_new(NULL, NULL);
+     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrwin),
+				    GTK_POLICY_AUTOMATIC,
+				    GTK_POLICY_AUTOMATIC);
+     gtk_widget_show(scrwin);
+     gtk_box_pack_start(GTK_BOX(vbox), scrwin, TRUE, TRUE, 0);
+
+     model = gq_revoked_model_new(x);
+     treeview = gtk_tree_view_new_with_model(GTK_TREE_MODEL(model));
+     g_object_unref(model);
+
+     /* every row has the same height, so the view only formats the
+	rows it shows */
+     column = gtk_tree_view_column_new_with_attributes(_("Serial#"),
+						       gtk_cell_renderer_text_new(),
+						       "text", REVOKED_COL_SERIAL,
+						       NULL);
+     gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+     gtk_tree_view_column_set_fixed_width(column, 240);
+     gtk_tree_view_column_set_resizable(column, TRUE);
+     gtk_tree_view_append_column(GTK_TREE_VIEW(treeview), column);
+
+     column = gtk_tree_view_column_new_with_attributes(_("Revocation date"),
+						       gtk_cell_renderer_text_new(),
+						       "text", REVOKED_COL_DATE,
+						       NULL);
+     gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+     gtk_tree_view_column_set_fixed_width(column, 200);
+     gtk_tree_view_column_set_resizable(column, TRUE);
+     gtk_tree_view_append_column(GTK_TREE_VIEW(treeview), column);
+
+     gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(treeview), TRUE);
+     gtk_widget_show(treeview);
+     gtk_container_add(GTK_CONTAINER(scrwin), treeview);
 }
 
 /* GType */
@@ -257,7 +483,7 @@ gq_display_crl_class_init(GQDisplayCRLClass* self_class) {
 	gdbg_class->delete_data = dt_clist_delete_data;
 	gdbg_class->show_entries = dt_clist_show_entries;
 
-	gdc_class->fill_clist = dt_crl_fill_clist;
+	gdc_class->summarize = dt_crl_summarize;
 	gdc_class->fill_details = dt_crl_fill_details;
 }
 
@@ -42,6 +42,7 @@
 #include "formfill.h"
 #include "dtutil.h"
 #include "dt_date.h"
+#include "dt_int.h"
 
 static GtkWidget *dt_date_get_widget(int error_context,
 				     struct formfill *form,
@@ -250,5 +251,6 @@ gq_display_date_class_init(GQDisplayDateClass* self_class) {
 	gtd_class->get_data = dt_date_get_data;
 	gtd_class->set_data = dt_date_set_data;
 	gtd_class->buildLDAPMod = bervalLDAPMod;
+	gtd_class->sort_integer = dt_int_sort_integer;
 };
 
@@ -157,6 +157,27 @@ GtkWidget *dt_int_retrieve_inputbox(GtkWidget *hbox)
      return gtk_object_get_data(GTK_OBJECT(hbox), "inputbox");
 }
 
+gboolean dt_int_sort_integer(const char *value, gint64 *num)
+{
+     const char *c = value, *digits;
+     gint64 n = 0;
+     gboolean negative = FALSE;
+
+     while (*c == ' ') c++;
+     if (*c == '-' || *c == '+') negative = *c++ == '-';
+     for (digits = c ; g_ascii_isdigit(*c) ; c++) {
+	  /* too big even for 64 bits, sort it as text */
+	  if (n > (G_MAXINT64 - (*c - '0')) / 10) return FALSE;
+	  n = n * 10 + (*c - '0');
+     }
+     if (c == digits) return FALSE;
+     while (*c == ' ') c++;
+     if (*c) return FALSE;
+
+     *num = negative ? -n : n;
+     return TRUE;
+}
+
 /* GType */
 G_DEFINE_TYPE(GQDisplayInt, gq_display_int, GQ_TYPE_DISPLAY_ENTRY);
 
@@ -175,6 +196,7 @@ gq_display_int_class_init(GQDisplayIntClass* self_class) {
 	gtd_class->get_data = dt_int_get_data;
 	gtd_class->set_data = dt_int_set_data;
 	gtd_class->buildLDAPMod = bervalLDAPMod;
+	gtd_class->sort_integer = dt_int_sort_integer;
 
 	gde_class->encode = NULL;
 	gde_class->decode = NULL;
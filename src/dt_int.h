@@ -52,6 +52,9 @@ void dt_int_set_data(struct formfill *form, GByteArray *data,
 
 GtkWidget *dt_int_retrieve_inputbox(GtkWidget *hbox);
 
+/* also used for other types holding plain integers */
+gboolean dt_int_sort_integer(const char *value, gint64 *num);
+
 #endif
 
 /* 
@@ -61,18 +61,307 @@ static const char * empty_xpm[] = {
      " "
 };
 
+/* Photos get shown as thumbnails of at most THUMBNAIL_SIZE pixels
+   either way, decoded on a separate thread and kept in a small cache
+   so showing the same entry again (in the browser and in the search
+   results, say) does not decode the photo again. The full size image
+   only gets decoded when asked for. */
+#define THUMBNAIL_SIZE		160
+#define THUMBNAIL_CACHE_SIZE	64
+#define PLACEHOLDER_COLOR	0xe0e0e0ff
+
+/* photos are told apart by their content: the hash only picks the
+   bucket, the bytes decide. Keys in the cache own a copy of them,
+   keys to look things up point to the caller's data. */
+struct thumbnail_key {
+     guint32 hash;
+     gsize len;
+     const guchar *data;
+};
+
+struct decode_job {
+     struct thumbnail_key key;
+     GByteArray *data;
+     GtkWidget *data_widget;	/* referenced */
+     GdkPixbuf *pixbuf;		/* the result */
+};
+
+static GHashTable *thumbnails = NULL;	/* struct thumbnail_key -> GdkPixbuf */
+static GQueue *thumbnails_lru = NULL;	/* keys, least recently used first */
+static GThreadPool *decoder = NULL;
+
+static guint thumbnail_key_hash(gconstpointer key)
+{
+     return ((const struct thumbnail_key *) key)->hash;
+}
+
+static gboolean thumbnail_key_equal(gconstpointer a, gconstpointer b)
+{
+     const struct thumbnail_key *ka = a, *kb = b;
+     return ka->hash == kb->hash && ka->len == kb->len &&
+	  memcmp(ka->data, kb->data, ka->len) == 0;
+}
+
+static void free_thumbnail_key(struct thumbnail_key *key)
+{
+     g_free((guchar *) key->data);
+     g_free(key);
+}
+
+static gint thumbnail_key_compare(gconstpointer a, gconstpointer b)
+{
+     return thumbnail_key_equal(a, b) ? 0 : 1;
+}
+
+/* FNV-1a */
+static void thumbnail_key_init(struct thumbnail_key *key,
+			       const guchar *data, gsize len)
+{
+     guint32 h = 2166136261U;
+     gsize i;
+
+     for (i = 0 ; i < len ; i++) {
+	  h = (h ^ data[i]) * 16777619U;
+     }
+     key->hash = h;
+     key->len = len;
+     key->data = data;
+}
+
+static GdkPixbuf *lookup_thumbnail(const struct thumbnail_key *key)
+{
+     GdkPixbuf *pixbuf;
+     GList *l;
+
+     if (thumbnails == NULL) return NULL;
+
+     pixbuf = g_hash_table_lookup(thumbnails, key);
+     if (pixbuf) {
+	  /* now the most recently used */
+	  l = g_queue_find_custom(thumbnails_lru, key,
+				  thumbnail_key_compare);
+	  g_queue_unlink(thumbnails_lru, l);
+	  g_queue_push_tail_link(thumbnails_lru, l);
+     }
+     return pixbuf;
+}
+
+static void remember_thumbnail(const struct thumbnail_key *key,
+			       GdkPixbuf *pixbuf)
+{
+     struct thumbnail_key *k;
+
+     if (thumbnails == NULL) {
+	  thumbnails = g_hash_table_new_full(thumbnail_key_hash,
+					     thumbnail_key_equal,
+					     (GDestroyNotify) free_thumbnail_key,
+					     g_object_unref);
+	  thumbnails_lru = g_queue_new();
+     }
+     if (g_hash_table_lookup(thumbnails, key)) return;
+
+     if (g_queue_get_length(thumbnails_lru) >= THUMBNAIL_CACHE_SIZE) {
+	  k = g_queue_pop_head(thumbnails_lru);
+	  g_hash_table_remove(thumbnails, k);	/* frees k */
+     }
+
+     k = g_memdup(key, sizeof(struct thumbnail_key));
+     k->data = g_memdup(key->data, key->len);
+     g_hash_table_insert(thumbnails, k, g_object_ref(pixbuf));
+     g_queue_push_tail(thumbnails_lru, k);
+}
+
+static void size_prepared(GdkPixbufLoader *loader, gint width, gint height,
+			  gpointer max)
+{
+     gint m = GPOINTER_TO_INT(max);
+     gdouble scale;
+
+     if (width <= m && height <= m) return;
+
+     scale = MIN((gdouble) m / width, (gdouble) m / height);
+     gdk_pixbuf_loader_set_size(loader,
+				MAX((gint) (width * scale), 1),
+				MAX((gint) (height * scale), 1));
+}
+
+/* max: the size to fit in, 0 for the image as it is. Safe to call
+   from any thread. */
+static GdkPixbuf *decode(const guchar *data, gsize len, gint max)
+{
+     GdkPixbufLoader *loader = gdk_pixbuf_loader_new();
+     GdkPixbuf *pixbuf;
+     GError *error = NULL;
+
+     if (max > 0) {
+	  /* lets the loader scale while decoding, which is much
+	     cheaper than decoding all of it */
+	  g_signal_connect(loader, "size-prepared",
+			   G_CALLBACK(size_prepared), GINT_TO_POINTER(max));
+     }
+
+     gdk_pixbuf_loader_write(loader, data, len, &error);
+     /* always close, even after an error */
+     gdk_pixbuf_loader_close(loader, error ? NULL : &error);
+     if (error) g_error_free(error);
+
+     /* belongs to the loader */
+     pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+     if (pixbuf) g_object_ref(pixbuf);
+     g_object_unref(loader);
+
+     return pixbuf;
+}
+
+static GtkWidget *pixmap_of(GtkWidget *data_widget)
+{
+     /* alignment -> button -> pixmap */
+     return GTK_BIN(GTK_BIN(data_widget)->child)->child;
+}
+
+static void show_pixbuf(GtkWidget *data_widget, GdkPixbuf *pixbuf)
+{
+     GdkPixmap *pixmap;
+     GdkBitmap *mask;
+
+     gdk_pixbuf_render_pixmap_and_mask(pixbuf, &pixmap, &mask, 127);
+     gtk_pixmap_set(GTK_PIXMAP(pixmap_of(data_widget)), pixmap, mask);
+
+     gdk_pixmap_unref(pixmap);
+     if (mask) gdk_bitmap_unref(mask);
+}
+
+static void show_empty(GtkWidget *data_widget)
+{
+     GdkPixbuf *pixbuf = gdk_pixbuf_new_from_xpm_data(empty_xpm);
+
+     if (pixbuf) {
+	  show_pixbuf(data_widget, pixbuf);
+	  gdk_pixbuf_unref(pixbuf);
+     }
+}
+
+static void show_placeholder(GtkWidget *data_widget)
+{
+     GdkPixbuf *pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8,
+					THUMBNAIL_SIZE, THUMBNAIL_SIZE);
+
+     if (pixbuf) {
+	  gdk_pixbuf_fill(pixbuf, PLACEHOLDER_COLOR);
+	  show_pixbuf(data_widget, pixbuf);
+	  gdk_pixbuf_unref(pixbuf);
+     }
+}
+
+static void free_decode_job(struct decode_job *job)
+{
+     g_byte_array_free(job->data, TRUE);
+     g_object_unref(job->data_widget);
+     if (job->pixbuf) g_object_unref(job->pixbuf);
+     g_free(job);
+}
+
+/* back in the main thread */
+static gboolean decode_done(struct decode_job *job)
+{
+     if (job->pixbuf) remember_thumbnail(&job->key, job->pixbuf);
+
+     /* unless the widget shows something else by now, or is gone,
+	see forget_decode_job() */
+     if (gtk_object_get_data(GTK_OBJECT(job->data_widget),
+			     "decode-job") == job) {
+	  gtk_object_remove_data(GTK_OBJECT(job->data_widget), "decode-job");
+	  if (job->pixbuf) {
+	       show_pixbuf(job->data_widget, job->pixbuf);
+	  } else {
+	       show_empty(job->data_widget);
+	  }
+     }
+
+     free_decode_job(job);
+     return FALSE;
+}
+
+/* The job holds a reference, so the widget outlives the form being
+   destroyed while decoding, but not its children. */
+static void forget_decode_job(GtkWidget *data_widget)
+{
+     gtk_object_remove_data(GTK_OBJECT(data_widget), "decode-job");
+}
+
+static void decode_thumbnail(struct decode_job *job, gpointer unused)
+{
+     job->pixbuf = decode(job->data->data, job->data->len, THUMBNAIL_SIZE);
+     g_idle_add((GSourceFunc) decode_done, job);
+}
+
+static void show_full_size(GtkWidget *button, GtkWidget *data_widget)
+{
+     GByteArray *data = gtk_object_get_data(GTK_OBJECT(data_widget), "data");
+     GtkWidget *window, *scrwin, *image;
+     GdkPixbuf *pixbuf;
+     gint width, height;
+
+     if (data == NULL) return;
+
+     set_busycursor();
+     pixbuf = decode(data->data, data->len, 0);
+     set_normalcursor();
+
+     if (pixbuf == NULL) {
+	  statusbar_msg(_("The photo cannot be shown, it is not a valid image"));
+	  return;
+     }
+     width = gdk_pixbuf_get_width(pixbuf);
+     height = gdk_pixbuf_get_height(pixbuf);
+
+     window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+     gtk_window_set_title(GTK_WINDOW(window), _("Photo"));
+     gtk_window_set_default_size(GTK_WINDOW(window),
+				 MIN(width + 2 * CONTAINER_BORDER_WIDTH, 800),
+				 MIN(height + 2 * CONTAINER_BORDER_WIDTH, 600));
+     g_signal_connect_swapped(window, "key_press_event",
+			      G_CALLBACK(close_on_esc),
+			      window);
+
+     scrwin = gtk_scrolled_window_new(NULL, NULL);
+     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrwin),
+				    GTK_POLICY_AUTOMATIC,
+				    GTK_POLICY_AUTOMATIC);
+     gtk_container_add(GTK_CONTAINER(window), scrwin);
+
+     image = gtk_image_new_from_pixbuf(pixbuf);
+     g_object_unref(pixbuf);
+     gtk_scrolled_window_add_with_viewport(GTK_SCROLLED_WINDOW(scrwin), image);
+
+     gtk_widget_show_all(window);
+}
 
 GtkWidget *dt_jpeg_get_data_widget(struct formfill *form,
 				   GCallback *activatefunc,
 				   gpointer funcdata)
 {
-     GtkWidget *alignment, *pixmap_widget = NULL;
+     GtkWidget *alignment, *button, *pixmap_widget = NULL;
+     GtkTooltips *tips;
      GdkPixbuf *pixbuf;
      GdkPixmap *pixmap;
      GdkBitmap *mask;
 
      alignment = gtk_alignment_new(0, 0, 0, 0);
      gtk_widget_show(alignment);
+     g_signal_connect(alignment, "destroy",
+		      G_CALLBACK(forget_decode_job), NULL);
+
+     /* the thumbnail, click for the real thing */
+     button = gtk_button_new();
+     gtk_button_set_relief(GTK_BUTTON(button), GTK_RELIEF_NONE);
+     tips = gtk_tooltips_new();
+     gtk_tooltips_set_tip(tips, button, _("Show the photo in full size"),
+			  Q_("tooltip|Show the photo in full size"));
+     g_signal_connect(button, "clicked",
+		      G_CALLBACK(show_full_size), alignment);
+     gtk_widget_show(button);
+     gtk_container_add(GTK_CONTAINER(alignment), button);
 
      pixbuf = gdk_pixbuf_new_from_xpm_data(empty_xpm);
 
@@ -85,7 +374,7 @@ GtkWidget *dt_jpeg_get_data_widget(struct formfill *form,
 	  gdk_pixmap_unref(pixmap);
 	  if (mask) gdk_bitmap_unref(mask);
 
-	  gtk_container_add(GTK_CONTAINER(alignment), pixmap_widget);
+	  gtk_container_add(GTK_CONTAINER(button), pixmap_widget);
      }
 
      return alignment;
@@ -101,40 +390,47 @@ void dt_jpeg_store_data(struct formfill *form,
 			const GByteArray *data)
 {
      if(data && data_widget) {
-	  GtkWidget *pixmap_widget = GTK_BIN(data_widget)->child;
+	  struct thumbnail_key key;
+	  struct decode_job *job;
 	  GdkPixbuf *pixbuf;
-
-	  GdkPixmap *pixmap;
-	  GdkBitmap *mask;
-
 	  GByteArray *copy;
-	  GdkPixbufLoader* loader = gdk_pixbuf_loader_new();
 
-	  GError *error = NULL;
+	  copy = g_byte_array_new();
+	  g_byte_array_append(copy, data->data, data->len);
 
-	  gdk_pixbuf_loader_write(loader, data->data, data->len, &error); /* FIXME - error handling */
-	  if (!error) gdk_pixbuf_loader_close(loader, &error);
-	  pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+	  gtk_object_set_data_full(GTK_OBJECT(data_widget), "data", copy,
+				   destroy_byte_array);
 
+	  thumbnail_key_init(&key, data->data, data->len);
+	  pixbuf = lookup_thumbnail(&key);
 	  if (pixbuf) {
-	       gdk_pixbuf_render_pixmap_and_mask(pixbuf, &pixmap, &mask, 127);
-	       gdk_pixbuf_unref(pixbuf);
-	       gtk_pixmap_set(GTK_PIXMAP(pixmap_widget), pixmap, mask);
-
-	       gdk_pixmap_unref(pixmap);
-	       if (mask) gdk_bitmap_unref(mask);
+	       gtk_object_remove_data(GTK_OBJECT(data_widget), "decode-job");
+	       show_pixbuf(data_widget, pixbuf);
+	       return;
 	  }
 
-	  copy = g_byte_array_new();
-	  g_byte_array_append(copy, data->data, data->len);
+	  job = g_malloc0(sizeof(struct decode_job));
+	  job->data = g_byte_array_new();
+	  g_byte_array_append(job->data, data->data, data->len);
+	  job->key = key;
+	  job->key.data = job->data->data;
+	  job->data_widget = data_widget;
+	  g_object_ref(data_widget);
+	  gtk_object_set_data(GTK_OBJECT(data_widget), "decode-job", job);
+
+	  if (decoder == NULL && g_thread_supported()) {
+	       decoder = g_thread_pool_new((GFunc) decode_thumbnail, NULL,
+					   1, FALSE, NULL);
+	  }
 
-	  gtk_object_set_data_full(GTK_OBJECT(data_widget), "data", copy,
-				   destroy_byte_array);
-	  /* FIXME: What's wrong with this: Either SHOULD work, shouldn't it?
-	     Currently the app dumps core at random places if either
-	     is in.  peter */
-/*	  gtk_object_destroy(GTK_OBJECT(loader)); */
-/*	  gtk_object_unref(GTK_OBJECT(loader)); */
+	  if (decoder) {
+	       show_placeholder(data_widget);
+	       g_thread_pool_push(decoder, job, NULL);
+	  } else {
+	       job->pixbuf = decode(job->data->data, job->data->len,
+				    THUMBNAIL_SIZE);
+	       decode_done(job);
+	  }
      }
 }
 
@@ -142,21 +438,9 @@ void dt_jpeg_delete_data(struct formfill *form,
 			 GtkWidget *hbox_widget,
 			 GtkWidget *data_widget)
 {
-     GtkWidget *pixmap_widget = GTK_BIN(data_widget)->child;
-     GdkPixbuf *pixbuf;
-     GdkPixmap *pixmap;
-     GdkBitmap *mask;
-
-     pixbuf = gdk_pixbuf_new_from_xpm_data(empty_xpm);
-
-     if (pixbuf) {
-	  gdk_pixbuf_render_pixmap_and_mask(pixbuf, &pixmap, &mask, 127);
-	  gdk_pixbuf_unref(pixbuf);
-	  gtk_pixmap_set(GTK_PIXMAP(pixmap_widget), pixmap, mask);
-
-	  gdk_pixmap_unref(pixmap);
-	  if (mask) gdk_bitmap_unref(mask);
-     }
+     /* a decoding still going on is of no interest any longer */
+     gtk_object_remove_data(GTK_OBJECT(data_widget), "decode-job");
+     show_empty(data_widget);
 
      gtk_object_remove_data(GTK_OBJECT(data_widget), "data");
 }
@@ -139,6 +139,26 @@ GtkWidget *dt_numstr_retrieve_inputbox(GtkWidget *hbox)
      return gtk_object_get_data(GTK_OBJECT(hbox), "inputbox");
 }
 
+/* numeric strings are digits and spaces, the spaces do not count */
+static gboolean dt_numstr_sort_integer(const char *value, gint64 *num)
+{
+     gint64 n = 0;
+     gboolean any = FALSE;
+
+     for ( ; *value ; value++) {
+	  if (g_ascii_isdigit(*value)) {
+	       /* too long for 64 bits, sort it as text */
+	       if (n > (G_MAXINT64 - (*value - '0')) / 10) return FALSE;
+	       n = n * 10 + (*value - '0');
+	       any = TRUE;
+	  } else if (*value != ' ') {
+	       return FALSE;
+	  }
+     }
+     if (any) *num = n;
+     return any;
+}
+
 /* GType */
 G_DEFINE_TYPE(GQDisplayNumstr, gq_display_numstr, GQ_TYPE_DISPLAY_ENTRY);
 
@@ -157,6 +177,7 @@ gq_display_numstr_class_init(GQDisplayNumstrClass* self_class) {
 	gtd_class->get_data = dt_numstr_get_data;
 	gtd_class->set_data = dt_numstr_set_data;
 	gtd_class->buildLDAPMod = bervalLDAPMod;
+	gtd_class->sort_integer = dt_numstr_sort_integer;
 
 	gde_class->encode = NULL;
 	gde_class->decode = NULL;
@@ -140,31 +140,19 @@ static int timeout_oc(struct change_info *ci)
 }
 
 
-static gboolean check_if_any_oc_needs(GList *oclist, LDAPAttributeType *at,
-				      struct server_schema *ss)
+/* the attribute types still allowed by the objectClasses named in
+   oclist, as a set */
+static GHashTable *attrs_needed_by(GList *oclist, struct server_schema *ss)
 {
-     int i;
-     char **atnames;
+     GHashTable *needed = g_hash_table_new(NULL, NULL);
+     GArray *attrs = schema_attrs_by_oclist(ss, oclist);
+     guint i;
 
-     for ( ; oclist ; oclist = g_list_next(oclist)) {
-	  LDAPObjectClass *oc = (LDAPObjectClass *) oclist->data;
-
-	  /* walk all mandatory attributes */
-	  for(i = 0; oc->oc_at_oids_must && oc->oc_at_oids_must[i]; i++) {
-	       for (atnames = at->at_names ; atnames && *atnames ; atnames++) {
-		    if (strcasecmp(oc->oc_at_oids_must[i], *atnames) == 0)
-			 return TRUE;
-	       }
-	  }
-	  /* walk all optional attributes */
-	  for(i = 0; oc->oc_at_oids_may && oc->oc_at_oids_may[i]; i++) {
-	       for (atnames = at->at_names ; atnames && *atnames ; atnames++) {
-		    if (strcasecmp(oc->oc_at_oids_may[i], *atnames) == 0)
-			 return TRUE;
-	       }
-	  }
+     for (i = 0 ; attrs && i < attrs->len ; i++) {
+	  struct schema_attr *attr = &g_array_index(attrs, struct schema_attr, i);
+	  if (attr->at) g_hash_table_insert(needed, attr->at, attr->at);
      }
-     return FALSE;
+     return needed;
 }
 
 static void new_oc(GtkEditable *entry, struct change_info *ci)
@@ -182,6 +170,7 @@ static gboolean do_change(int error_context, struct change_info *ci)
      struct formfill *form;
      GqServer *server;
      GList *formlist, *tmplist = NULL;
+     GHashTable *needed;
      int i, n = 0;
      struct server_schema *ss;
      LDAPObjectClass *oc;
@@ -276,11 +265,10 @@ static gboolean do_change(int error_context, struct change_info *ci)
 			      continue;
 			 }
 
-			 tmplist = g_list_append(tmplist, oc2);
-
-			 g_free(c);
+			 tmplist = g_list_append(tmplist, c);
 		    }
 	       }
+	       needed = attrs_needed_by(tmplist, ss);
 
 	       /* Mark no-longer-needed attributes */
 
@@ -292,7 +280,7 @@ static gboolean do_change(int error_context, struct change_info *ci)
 		    at = find_canonical_at_by_at(ss, oc->oc_at_oids_must[i]);
 		    if (!at) continue;
 
-		    if (!check_if_any_oc_needs(tmplist, at, ss)) {
+		    if (!g_hash_table_lookup(needed, at)) {
 			 form = lookup_attribute_using_schema(formlist,
 							      oc->oc_at_oids_must[i],
 							      ss, NULL);
@@ -311,7 +299,7 @@ static gboolean do_change(int error_context, struct change_info *ci)
 		    at = find_canonical_at_by_at(ss, oc->oc_at_oids_may[i]);
 
 		    if (!at) continue;
-		    if (!check_if_any_oc_needs(tmplist, at, ss)) {
+		    if (!g_hash_table_lookup(needed, at)) {
 			 form = lookup_attribute_using_schema(formlist,
 							      oc->oc_at_oids_may[i],
 							      ss, NULL);
@@ -321,6 +309,10 @@ static gboolean do_change(int error_context, struct change_info *ci)
 			 }
 		    }
 	       }
+	       g_hash_table_destroy(needed);
+	       g_list_foreach(tmplist, (GFunc) g_free, NULL);
+	       g_list_free(tmplist);
+
 	       statusbar_msg(_("Marked %d attribute(s) to be obsolete"), n);
 	  }
      }
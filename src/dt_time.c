@@ -139,6 +139,24 @@ static int parse_time(const char *data, struct tm *tm, int *offset) {
      return n;
 }
 
+/* sorts by the point in time, in seconds UTC */
+static gboolean dt_time_sort_number(const char *value, gdouble *num)
+{
+     struct tm tm;
+     int offset = 0, sign;
+
+     if (parse_time(value, &tm, &offset) < 1) return FALSE;
+
+     sign = offset < 0 ? -1 : 1;
+     offset *= sign;
+
+     *num = days_from_civil(tm.tm_year + 1900, MAX(tm.tm_mon, 0) + 1,
+			    tm.tm_mday ? tm.tm_mday : 1) * 86400.0
+	  + tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec
+	  - sign * ((offset / 100) * 3600 + (offset % 100) * 60);
+     return TRUE;
+}
+
 static void tz_value_changed_callback(GtkAdjustment *adjustment,
 				      GtkSpinButton *spin)
 {
@@ -479,5 +497,6 @@ gq_display_time_class_init(GQDisplayTimeClass* self_class) {
 	gtd_class->get_data = dt_time_get_data;
 	gtd_class->set_data = dt_time_set_data;
 	gtd_class->buildLDAPMod = bervalLDAPMod;
+	gtd_class->sort_number = dt_time_sort_number;
 }
 
@@ -25,6 +25,7 @@
 # include <config.h>
 #endif /* HAVE_CONFIG_H */
 
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -41,38 +42,224 @@
 
 const char *gq_codeset = GQ_CODESET;
 
-const char *decode_string(char *native_string, const gchar *ldap_string,
-			  size_t len)
-{
+/* Most of what gets converted is plain ASCII (filters, DNs, attribute
+   values), which reads the same in every codeset we may run in, so
+   that gets copied right away. Otherwise conversion uses iconv
+   descriptors kept open per thread, opening them is much more
+   expensive than converting a short string. */
+
 #if defined(HAVE_ICONV)
-     char *in;
-     char *out;
-     size_t outlen;
-     iconv_t conv;
-
-     conv = iconv_open(gq_codeset, LDAP_CODESET);
-     if (conv != (iconv_t) -1) {
-	  in = (char *) ldap_string;
-	  out = native_string;
-	  /*       len = strlen(in); */
-	  outlen = len;
-	  
-	  while(len > 0 && outlen > 0) {
-	       if(iconv(conv, &in, &len, &out, &outlen) != 0) {
-		    in++;		/* *** */
+
+static gboolean is_ascii(const gchar *s, size_t len)
+{
+     const guchar *p = (const guchar *) s;
+     const gulong high = ((gulong) -1 / 0xff) * 0x80; /* 0x8080... */
+     gulong word;
+
+     /* a word at a time once aligned */
+     for ( ; len > 0 && ((gsize) p & (sizeof(gulong) - 1)) ; p++, len--) {
+	  if (*p & 0x80) return FALSE;
+     }
+     for ( ; len >= sizeof(gulong) ; p += sizeof(gulong), len -= sizeof(gulong)) {
+	  memcpy(&word, p, sizeof(gulong));
+	  if (word & high) return FALSE;
+     }
+     for ( ; len > 0 ; p++, len--) {
+	  if (*p & 0x80) return FALSE;
+     }
+     return TRUE;
+}
+
+static gboolean is_utf8_codeset(const char *codeset)
+{
+     return g_ascii_strcasecmp(codeset, "UTF-8") == 0
+	  || g_ascii_strcasecmp(codeset, "UTF8") == 0;
+}
+
+struct converters {
+     /* native (as of g_get_charset) -> UTF-8 */
+     iconv_t to_ldap;
+     gboolean native_utf8;
+     gboolean to_ldap_open;
+
+     /* UTF-8 -> gq_codeset */
+     iconv_t from_ldap;
+     const char *from_codeset;	/* gq_codeset it was opened for */
+     gboolean from_utf8;
+};
+
+static GStaticPrivate converters_key = G_STATIC_PRIVATE_INIT;
+
+static void free_converters(gpointer data)
+{
+     struct converters *c = data;
+
+     if (c->to_ldap != (iconv_t) -1) iconv_close(c->to_ldap);
+     if (c->from_ldap != (iconv_t) -1) iconv_close(c->from_ldap);
+     g_free(c);
+}
+
+static struct converters *get_converters(void)
+{
+     struct converters *c = g_static_private_get(&converters_key);
+
+     if (c == NULL) {
+	  c = g_new0(struct converters, 1);
+	  c->to_ldap = c->from_ldap = (iconv_t) -1;
+	  g_static_private_set(&converters_key, c, free_converters);
+     }
+     return c;
+}
+
+/* sets *utf8 if there is nothing to convert, otherwise returns the
+   descriptor to use or NULL if iconv does not know the codeset */
+static iconv_t *get_to_ldap(gboolean *utf8)
+{
+     struct converters *c = get_converters();
+
+     if (!c->to_ldap_open) {
+	  const char *codeset;
+
+	  c->native_utf8 = g_get_charset(&codeset);
+	  if (!c->native_utf8) {
+	       c->to_ldap = iconv_open(LDAP_CODESET, codeset);
+	  }
+	  c->to_ldap_open = TRUE;
+     }
+
+     *utf8 = c->native_utf8;
+     return c->to_ldap != (iconv_t) -1 ? &c->to_ldap : NULL;
+}
+
+static iconv_t *get_from_ldap(gboolean *utf8)
+{
+     struct converters *c = get_converters();
+
+     if (c->from_codeset != gq_codeset) {
+	  if (c->from_ldap != (iconv_t) -1) iconv_close(c->from_ldap);
+	  c->from_ldap = (iconv_t) -1;
+
+	  c->from_codeset = gq_codeset;
+	  c->from_utf8 = is_utf8_codeset(gq_codeset);
+	  if (!c->from_utf8) {
+	       c->from_ldap = iconv_open(gq_codeset, LDAP_CODESET);
+	  }
+     }
+
+     *utf8 = c->from_utf8;
+     return c->from_ldap != (iconv_t) -1 ? &c->from_ldap : NULL;
+}
+
+/* converts len bytes of in to out (room for outsize bytes including
+   the terminating 0), dropping what cannot be converted. Returns the
+   length of the result. */
+static size_t convert(iconv_t conv, gboolean from_utf8,
+		      const gchar *in, size_t len,
+		      gchar *out, size_t outsize)
+{
+     ICONV_CONST char *inp = (ICONV_CONST char *) in;
+     char *outp = out;
+     size_t outlen = outsize - 1;
+
+     /* back to the initial shift state */
+     iconv(conv, NULL, NULL, NULL, NULL);
+
+     while (len > 0) {
+	  if (iconv(conv, &inp, &len, &outp, &outlen) != (size_t) -1) break;
+
+	  if (errno == EILSEQ) {
+	       /* drop the offending byte, for UTF-8 the rest of its
+		  sequence along with it */
+	       do {
+		    inp++;
 		    len--;
-	       }
+	       } while (from_utf8 && len > 0
+			&& (*(guchar *) inp & 0xc0) == 0x80);
+	  } else {
+	       /* out of room (E2BIG) or a truncated sequence at the
+		  end (EINVAL) */
+	       break;
 	  }
-	  iconv_close(conv);
-	  *out = '\0';
-     } else {
-	  strncpy(native_string, ldap_string, len);
-	  *(native_string + len) = 0;
      }
-#else /* HAVE_ICONV */
-     strncpy(native_string, ldap_string, len);
-     *(native_string + len - 1) = 0;
+     *outp = '\0';
+     return outp - out;
+}
+
+/* copies UTF-8, leaving out invalid bytes the way iconv would */
+static size_t copy_utf8(const gchar *in, size_t len,
+			gchar *out, size_t outsize)
+{
+     const gchar *end;
+     size_t done = 0, valid;
+
+     while (len > 0) {
+	  g_utf8_validate(in, len, &end);
+	  valid = MIN((size_t) (end - in), outsize - 1 - done);
+
+	  memcpy(out + done, in, valid);
+	  done += valid;
+	  /* all of it, or out of room */
+	  if (valid == len || valid < (size_t) (end - in)) break;
+
+	  /* skip the invalid byte */
+	  in = end + 1;
+	  len -= valid + 1;
+     }
+     out[done] = '\0';
+     return done;
+}
+
 #endif /* HAVE_ICONV */
+
+/* the fallback for when nothing needs or can be converted */
+static size_t copy(const gchar *in, size_t len, gchar *out, size_t outsize)
+{
+     if (len > outsize - 1) len = outsize - 1;
+     memcpy(out, in, len);
+     out[len] = '\0';
+     return len;
+}
+
+/* worst case growth: every byte turning into a 4 byte UTF-8
+   sequence */
+#define ENCODED_SIZE(len)	(4 * (len) + 1)
+
+static size_t encode_into(gchar *out, size_t outsize,
+			  const gchar *in, size_t len)
+{
+#if defined(HAVE_ICONV)
+     gboolean utf8;
+     iconv_t *conv;
+
+     if (is_ascii(in, len)) return copy(in, len, out, outsize);
+
+     conv = get_to_ldap(&utf8);
+     if (utf8) return copy_utf8(in, len, out, outsize);
+     if (conv) return convert(*conv, FALSE, in, len, out, outsize);
+#endif /* HAVE_ICONV */
+     return copy(in, len, out, outsize);
+}
+
+static size_t decode_into(gchar *out, size_t outsize,
+			  const gchar *in, size_t len)
+{
+#if defined(HAVE_ICONV)
+     gboolean utf8;
+     iconv_t *conv;
+
+     if (is_ascii(in, len)) return copy(in, len, out, outsize);
+
+     conv = get_from_ldap(&utf8);
+     if (utf8) return copy_utf8(in, len, out, outsize);
+     if (conv) return convert(*conv, TRUE, in, len, out, outsize);
+#endif /* HAVE_ICONV */
+     return copy(in, len, out, outsize);
+}
+
+const char *decode_string(char *native_string, const gchar *ldap_string,
+			  size_t len)
+{
+     decode_into(native_string, len + 1, ldap_string, len);
 #ifdef DEBUG
      if (debug & GQ_DEBUG_ENCODE) {
 	  fprintf(stderr, "decode_string \"%s\" (%d) -> \"%s\"\n", 
@@ -85,41 +272,8 @@ const char *decode_string(char *native_string, const gchar *ldap_string,
 const gchar *encode_string(gchar *ldap_string, const gchar *native_string, 
 			   size_t len)
 {
-#if defined(HAVE_ICONV)
-     char *in;
-     char *out;
-     size_t outlen;
-     iconv_t conv;
-     const char *g_codeset;
-
-     in = (char *) native_string;
-     out = ldap_string;
-/*       len = strlen(in); */
-     outlen = len * 2 + 1; /* Worst case */
-
-     g_get_charset(&g_codeset);
-
-     conv = iconv_open(LDAP_CODESET, g_codeset);
-
-     if (conv != (iconv_t) (-1)) {
-	  while(len > 0 && outlen > 0) {
-	       if(iconv(conv, &in, &len, &out, &outlen) != 0) {
-		    in++;		/* *** */
-		    len--;
-	       }
-	  }
-	  iconv_close(conv);
-	  *out = '\0';
-     } else {
- 	  strncpy(ldap_string, native_string, len);
-	  *(ldap_string + len) = 0;
-     }
-#else /* HAVE_ICONV */
-/*       memcpy(ldap_string, native_string, len); */
-     strncpy(ldap_string, native_string, len);
-     *(ldap_string + len) = 0;
-#endif /* HAVE_ICONV */
-  
+     /* callers provide for twice the length */
+     encode_into(ldap_string, 2 * len + 1, native_string, len);
 #ifdef DEBUG
      if (debug & GQ_DEBUG_ENCODE) {
 	  fprintf(stderr, "encode_string \"%s\" -> \"%s\"\n", 
@@ -130,18 +284,90 @@ const gchar *encode_string(gchar *ldap_string, const gchar *native_string,
      return ldap_string;
 }
 
+/* encoded_string and decoded_string return malloc'ed memory, to be
+   free()d */
+
 gchar *encoded_string(const gchar *string)
 {
-     /* FIXME: check whether this code is still used (it might have been dropped out with the GTK+1.2 removal) */
-     char *ldap_string;
+     char *ldap_string, *shrunk;
+     size_t len;
 
      if (!string) return NULL;
 
-     ldap_string = calloc(2 * strlen(string) + 1, sizeof(char));
-  
-     encode_string(ldap_string, string, strlen(string));
+     len = strlen(string);
+     ldap_string = malloc(ENCODED_SIZE(len));
+     if (!ldap_string) return NULL;
 
-     return ldap_string;
+     len = encode_into(ldap_string, ENCODED_SIZE(len), string, len);
+#ifdef DEBUG
+     if (debug & GQ_DEBUG_ENCODE) {
+	  fprintf(stderr, "encoded_string \"%s\" -> \"%s\"\n", 
+		  string, ldap_string);
+     }
+#endif
+
+     /* give back what the worst case did not need */
+     shrunk = realloc(ldap_string, len + 1);
+     return shrunk ? shrunk : ldap_string;
+}
+
+gchar *decoded_string(const gchar *string)
+{
+     char *native_string;
+     size_t len;
+
+     if (!string) return NULL;
+
+     len = strlen(string);
+     native_string = malloc(len + 1);
+     if (!native_string) return NULL;
+
+     decode_into(native_string, len + 1, string, len);
+     return native_string;
+}
+
+/* The same for whole lists of values: NULL terminated arrays in,
+   NULL terminated arrays out, to be freed with g_strfreev. */
+
+gchar **encoded_strv(const gchar * const *strings)
+{
+     gchar **result;
+     size_t i, n, len;
+
+     if (!strings) return NULL;
+
+     for (n = 0 ; strings[n] ; n++) ;
+     result = g_new(gchar *, n + 1);
+
+     for (i = 0 ; i < n ; i++) {
+	  len = strlen(strings[i]);
+	  result[i] = g_malloc(ENCODED_SIZE(len));
+	  len = encode_into(result[i], ENCODED_SIZE(len), strings[i], len);
+	  result[i] = g_realloc(result[i], len + 1);
+     }
+     result[n] = NULL;
+
+     return result;
+}
+
+gchar **decoded_strv(const gchar * const *strings)
+{
+     gchar **result;
+     size_t i, n, len;
+
+     if (!strings) return NULL;
+
+     for (n = 0 ; strings[n] ; n++) ;
+     result = g_new(gchar *, n + 1);
+
+     for (i = 0 ; i < n ; i++) {
+	  len = strlen(strings[i]);
+	  result[i] = g_malloc(len + 1);
+	  decode_into(result[i], len + 1, strings[i], len);
+     }
+     result[n] = NULL;
+
+     return result;
 }
 
 
@@ -56,8 +56,12 @@ const gchar *decode_string(gchar *native_string, const gchar *ldap_string,
 			   size_t len);
 const gchar *encode_string(gchar *ldap_string, const gchar *native_string,
 			   size_t len);
+/* malloc'ed, to be free()d */
 gchar *decoded_string(const gchar *string);
 gchar *encoded_string(const gchar *string);
+/* for NULL terminated lists of values, to be g_strfreev'd */
+gchar **decoded_strv(const gchar * const *strings);
+gchar **encoded_strv(const gchar * const *strings);
 
 #endif
 
@@ -28,6 +28,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>		/* unlink */
 
 #include "errorchain.h"
 #include "common.h"
@@ -51,12 +52,43 @@ static struct errchain *new_errchain()
      return new_chain;
 }
 
+static void free_errgroup(struct errgroup *group)
+{
+     g_free(group->operation);
+     g_free(group->format);
+     g_list_foreach(group->samples, (GFunc) g_free, NULL);
+     g_list_free(group->samples);
+     g_free(group);
+}
+
+/* closes the log file, removing it unless keep */
+static void finish_log(struct errchain *chain, gboolean keep)
+{
+     if (chain->log) {
+	  fclose(chain->log);
+	  chain->log = NULL;
+	  if (!keep) unlink(chain->logfile);
+     }
+     g_free(chain->logfile);
+     chain->logfile = NULL;
+}
+
+static void clear_groups(struct errchain *chain)
+{
+     g_list_foreach(chain->groups, (GFunc) free_errgroup, NULL);
+     g_list_free(chain->groups);
+     chain->groups = NULL;
+     chain->total = 0;
+}
+
 static void free_errchain(struct errchain *chain)
 {
      if (chain) {
 	  g_free(chain->title);
 	  g_list_foreach(chain->messages, (GFunc) g_free, NULL);
 	  g_list_free(chain->messages);
+	  clear_groups(chain);
+	  finish_log(chain, FALSE);
 	  if (chain->transient_for) {
 	       gtk_widget_unref(chain->transient_for);
 	  }
@@ -86,7 +118,97 @@ int error_new_context(const char *title, GtkWidget *modal_for)
 
 
 
-static void error_push_production_v(int context, const char *fmt, va_list ap)
+void error_set_bulk(int context, int samples, gboolean log_all)
+{
+     struct errchain *chain = error_chain_by_context(context);
+     g_assert(chain);
+
+     chain->bulk = TRUE;
+     chain->samples = samples;
+     chain->log_all = log_all;
+}
+
+static struct errgroup *find_group(struct errchain *chain,
+				   const char *operation, int code,
+				   const char *format)
+{
+     GList *I;
+     struct errgroup *group;
+
+     for (I = chain->groups ; I ; I = g_list_next(I)) {
+	  group = I->data;
+	  if (operation) {
+	       if (group->operation && group->code == code &&
+		   strcmp(group->operation, operation) == 0) return group;
+	  } else {
+	       if (!group->operation &&
+		   strcmp(group->format, format) == 0) return group;
+	  }
+     }
+
+     group = g_malloc0(sizeof(struct errgroup));
+     group->operation = g_strdup(operation);
+     group->code = code;
+     group->format = g_strdup(format);
+     chain->groups = g_list_append(chain->groups, group);
+
+     return group;
+}
+
+static void log_message(struct errchain *chain, const char *operation,
+			const char *msg)
+{
+     if (chain->log == NULL) {
+	  int fd = g_file_open_tmp("gq-errors-XXXXXX.txt",
+				   &chain->logfile, NULL);
+	  if (fd >= 0) chain->log = fdopen(fd, "w");
+	  if (chain->log == NULL) {
+	       /* never mind then */
+	       if (fd >= 0) {
+		    close(fd);
+		    unlink(chain->logfile);
+	       }
+	       finish_log(chain, FALSE);
+	       chain->log_all = FALSE;
+	       return;
+	  }
+     }
+
+     if (operation) {
+	  fprintf(chain->log, "%s: %s\n", operation, msg);
+     } else {
+	  fprintf(chain->log, "%s\n", msg);
+     }
+}
+
+/* takes over msg */
+static void chain_push(struct errchain *chain, const char *operation,
+		       int code, const char *format, char *msg)
+{
+     struct errgroup *group;
+
+     if (!chain->bulk) {
+	  chain->messages = g_list_append(chain->messages, msg);
+	  message_log_append(msg);
+	  return;
+     }
+
+     group = find_group(chain, operation, code, format);
+     group->count++;
+     chain->total++;
+
+     if (chain->log_all) log_message(chain, operation, msg);
+
+     if (group->count <= chain->samples) {
+	  group->samples = g_list_append(group->samples, msg);
+	  message_log_append(msg);
+     } else {
+	  g_free(msg);
+     }
+}
+
+static void error_push_v(int context, const char *operation, int code,
+			 const char *fmt, va_list ap)
 {
      struct errchain *chain;
      GString *str;
@@ -115,9 +237,7 @@ static void error_push_production_v(int context, const char *fmt, va_list ap)
 
      /* plug into messagechain */
      chain = error_chain_by_context(context);
-     chain->messages = g_list_append(chain->messages, str->str);
-
-     message_log_append(str->str);
+     chain_push(chain, operation, code, fmt, str->str);
 
      g_string_free(str, FALSE);
 }
@@ -126,7 +246,16 @@ void error_push_production(int context, const char *fmt, ...)
 {
      va_list ap;
      va_start(ap, fmt);
-     error_push_production_v(context, fmt, ap);
+     error_push_v(context, NULL, 0, fmt, ap);
+     va_end(ap);
+}
+
+void error_push_ldap(int context, const char *operation, int code,
+		     const char *fmt, ...)
+{
+     va_list ap;
+     va_start(ap, fmt);
+     error_push_v(context, operation, code, fmt, ap);
      va_end(ap);
 }
 
@@ -147,10 +276,10 @@ void error_push_debug(const char *file, int line,
 	  }
 
 	  /* Is it allowed to change the fmt? */
-	  error_push_production_v(context, s->str, ap);
+	  error_push_v(context, NULL, 0, s->str, ap);
 	  g_string_free(s, TRUE);
      } else {
-	  error_push_production_v(context, fmt, ap);
+	  error_push_v(context, NULL, 0, fmt, ap);
      }
 
      va_end(ap);
@@ -206,6 +335,70 @@ void error_clear(int context)
      g_list_foreach(chain->messages, (GFunc) g_free, NULL);
      g_list_free(chain->messages);
      chain->messages = NULL;
+
+     clear_groups(chain);
+     finish_log(chain, FALSE);
+}
+
+/* turns the groups of a bulk mode chain into messages to show */
+static void summarize_groups(struct errchain *chain)
+{
+     GList *I, *J;
+     struct errgroup *group;
+     GString *s;
+     gboolean incomplete = FALSE;
+     char *msg;
+     int shown;
+
+     if (chain->total == 0) return;
+
+     msg = g_strdup_printf(ngettext("There was one error:",
+				    "There were %d errors:", chain->total),
+			   chain->total);
+     chain->messages = g_list_append(chain->messages, msg);
+
+     for (I = chain->groups ; I ; I = g_list_next(I)) {
+	  group = I->data;
+	  s = g_string_new("");
+
+	  if (group->operation) {
+	       g_string_append_printf(s, ngettext("%1$s - %2$s: once",
+						  "%1$s - %2$s: %3$d times",
+						  group->count),
+				      group->operation,
+				      ldap_err2string(group->code),
+				      group->count);
+	  }
+
+	  shown = 0;
+	  for (J = group->samples ; J ; J = g_list_next(J)) {
+	       if (s->len > 0) g_string_append_c(s, '\n');
+	       g_string_append(s, J->data);
+	       shown++;
+	  }
+
+	  if (group->count > shown) {
+	       g_string_append_c(s, '\n');
+	       g_string_append_printf(s, ngettext("... and one more like this",
+						  "... and %d more like this",
+						  group->count - shown),
+				      group->count - shown);
+	       incomplete = TRUE;
+	  }
+
+	  chain->messages = g_list_append(chain->messages, s->str);
+	  g_string_free(s, FALSE);
+     }
+
+     if (incomplete && chain->log) {
+	  msg = g_strdup_printf(_("All errors are listed in '%s'."),
+				chain->logfile);
+	  chain->messages = g_list_append(chain->messages, msg);
+	  message_log_append(msg);
+     }
+
+     clear_groups(chain);
+     finish_log(chain, incomplete);
 }
 
 void error_flush(int context)
@@ -217,7 +410,17 @@ void error_flush(int context)
      chain = error_chain_by_context(context);
      g_assert(chain);
 
-     if(chain->messages) {
+     summarize_groups(chain);
+
+     if(chain->messages && gdk_display_get_default() == NULL) {
+	  /* no display (batch tools, test drivers): report on stderr */
+	  for(msg = chain->messages ; msg ; msg = g_list_next(msg)) {
+	       fprintf(stderr, "%s: %s\n", chain->title, (char*) msg->data);
+	       g_free(msg->data);
+	  }
+	  g_list_free(chain->messages);
+	  chain->messages = NULL;
+     } else if(chain->messages) {
 	  popupwin = gtk_dialog_new();
 	  if (chain->transient_for &&
 	      GTK_WIDGET_TOPLEVEL(chain->transient_for)) {
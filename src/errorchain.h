@@ -27,6 +27,7 @@
 #ifndef GQ_ERRORCHAIN_H_INCLUDED
 #define GQ_ERRORCHAIN_H_INCLUDED
 
+#include <stdio.h>		/* FILE */
 #include <ldap.h>		/* LDAP */
 #include <glib.h>		/* G_GNUC_PRINTF */
 #include <gtk/gtkwidget.h>
@@ -64,11 +65,49 @@ void error_clear(int context);
 
 void push_ldap_addl_error(LDAP *ld, int context);
 
+/* Bulk operations (deleting, moving or exporting many entries) may
+   run into thousands of errors, too many to show. A context put into
+   bulk mode groups errors by operation and LDAP result code (see
+   error_push_ldap) or else by their message format, and only keeps a
+   count and the first few messages of each group. error_flush then
+   shows a summary.
+
+   With log_all set every message also goes to a temporary file, which
+   is mentioned in the summary if the dialog could not show them
+   all. */
+#define ERROR_BULK_SAMPLES	5
+
+void error_set_bulk(int context, int samples, gboolean log_all);
+
+/* like error_push, for errors of an LDAP operation. operation is a
+   short description like "Deleting entries", code the LDAP result
+   code. */
+void error_push_ldap(int context, const char *operation, int code,
+		     const char *msg, ...)
+     G_GNUC_PRINTF(4, 5);
+
+struct errgroup {
+     char *operation;		/* NULL: grouped by format */
+     int code;
+     char *format;
+     int count;
+     GList *samples;
+};
+
 struct errchain {
      int context;
      char *title;
      GList *messages;
      GtkWidget *transient_for;
+
+     /* bulk mode */
+     gboolean bulk;
+     int samples;		/* per group */
+     GList *groups;
+     int total;
+     gboolean log_all;
+     FILE *log;
+     char *logfile;
 };
 
 #endif
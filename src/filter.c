@@ -198,6 +198,12 @@ void add_filter(GtkWidget *filternamebox)
 	       searchbase_combo = GQ_TAB_SEARCH(tab)->searchbase_combo;
 	       searchbase = gtk_editable_get_chars(GTK_EDITABLE(GTK_COMBO(searchbase_combo)->entry), 0, -1);
 
+	       /* a filter made for all servers belongs to none of them */
+	       if(search_all_servers(tab)) {
+		    g_free(servername);
+		    servername = g_strdup("");
+	       }
+
 	       g_free(filter->servername);
 	       filter->servername = servername;
 
@@ -333,6 +339,7 @@ void filter_selected(struct gq_filter *filter)
 
      /* set server combo to this filter's server */
      if(filter->servername[0]) {
+	  search_set_all_servers(tab, FALSE);
 	  server_combo = GQ_TAB_SEARCH(tab)->serverlist_combo;
 	  gtk_entry_set_text(GTK_ENTRY(GTK_COMBO(server_combo)->entry),
 			     filter->servername);
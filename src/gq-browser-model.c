@@ -23,12 +23,629 @@
 
 #include "gq-browser-model.h"
 
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <string.h>
+
+struct _GqBrowserModelNode {
+	const gchar        *label;	/* interned in the model */
+	gpointer            data;
+	GDestroyNotify      destroy;
+	GqBrowserModelNode *parent;	/* the hidden root for the top level */
+	GPtrArray          *children;	/* NULL while there are none */
+	guint               index;	/* in parent->children */
+	guint               unknown_children : 1;
+	guint               sort_pending : 1;
+};
+
+struct _GqBrowserModel {
+	GObject             base_instance;
+	gint                stamp;
+	GqBrowserModelNode  root;
+	GStringChunk       *labels;
+	gboolean            auto_sort;
+	gint                frozen;
+	GSList             *unsorted;	/* parents to sort when thawed */
+};
+
+static void gq_browser_model_tree_model_init(GtkTreeModelIface *iface);
+
 /* GType */
-G_DEFINE_TYPE(GqBrowserModel, gq_browser_model, G_TYPE_OBJECT);
+G_DEFINE_TYPE_WITH_CODE(GqBrowserModel, gq_browser_model, G_TYPE_OBJECT,
+			G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL,
+					      gq_browser_model_tree_model_init));
+
+#define NODE_COUNT(node)	((node)->children ? (node)->children->len : 0)
+#define NODE_CHILD(node, n)	((GqBrowserModelNode *) g_ptr_array_index((node)->children, (n)))
+#define HAS_CHILD(node)		(NODE_COUNT(node) > 0 || (node)->unknown_children)
+
+static inline GqBrowserModelNode *
+real_parent(GqBrowserModel *self, GqBrowserModelNode *parent)
+{
+	return parent ? parent : &self->root;
+}
+
+static void
+to_iter(GqBrowserModel *self, GqBrowserModelNode *node, GtkTreeIter *iter)
+{
+	iter->stamp = self->stamp;
+	iter->user_data = node;
+	iter->user_data2 = NULL;
+	iter->user_data3 = NULL;
+}
+
+static GtkTreePath *
+node_path(GqBrowserModelNode *node)
+{
+	GtkTreePath *path = gtk_tree_path_new();
+
+	for ( ; node->parent ; node = node->parent) {
+		gtk_tree_path_prepend_index(path, node->index);
+	}
+	return path;
+}
+
+static void
+reindex(GqBrowserModelNode *parent, guint from)
+{
+	guint i;
+
+	for (i = from ; i < NODE_COUNT(parent) ; i++) {
+		NODE_CHILD(parent, i)->index = i;
+	}
+}
+
+static void
+emit_has_child_toggled(GqBrowserModel *self, GqBrowserModelNode *node)
+{
+	GtkTreePath *path;
+	GtkTreeIter  iter;
+
+	if (node->parent == NULL) return;	/* the root */
+
+	path = node_path(node);
+	to_iter(self, node, &iter);
+	gtk_tree_model_row_has_child_toggled(GTK_TREE_MODEL(self), path, &iter);
+	gtk_tree_path_free(path);
+}
+
+/* frees node and everything below, the caller has taken it out of
+   its parent already */
+static void
+free_node(GqBrowserModel *self, GqBrowserModelNode *node)
+{
+	guint i;
+
+	if (node->sort_pending) {
+		self->unsorted = g_slist_remove(self->unsorted, node);
+	}
+	for (i = 0 ; i < NODE_COUNT(node) ; i++) {
+		free_node(self, NODE_CHILD(node, i));
+	}
+	if (node->children) g_ptr_array_free(node->children, TRUE);
+	if (node->destroy) node->destroy(node->data);
+	g_free(node);
+}
+
+static gint
+compare_labels(gconstpointer a, gconstpointer b)
+{
+	const GqBrowserModelNode *na = *(GqBrowserModelNode * const *) a;
+	const GqBrowserModelNode *nb = *(GqBrowserModelNode * const *) b;
+
+	return strcmp(na->label, nb->label);
+}
+
+/* where label goes among the (sorted) children of parent, after
+   those with the same label */
+static guint
+sorted_position(GqBrowserModelNode *parent, const gchar *label)
+{
+	guint lo = 0, hi = NODE_COUNT(parent);
+
+	while (lo < hi) {
+		guint mid = (lo + hi) / 2;
+		if (strcmp(NODE_CHILD(parent, mid)->label, label) <= 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+GqBrowserModelNode *
+gq_browser_model_insert(GqBrowserModel     *self,
+			GqBrowserModelNode *parent,
+			GqBrowserModelNode *sibling,
+			const gchar        *label,
+			gpointer            data,
+			GDestroyNotify      destroy)
+{
+	GqBrowserModelNode *node;
+	GtkTreePath        *path;
+	GtkTreeIter         iter;
+	gboolean            had_child;
+	guint               pos;
+
+	g_return_val_if_fail(GQ_IS_BROWSER_MODEL(self), NULL);
+
+	parent = real_parent(self, parent);
+	g_return_val_if_fail(sibling == NULL || sibling->parent == parent, NULL);
+
+	node = g_new0(GqBrowserModelNode, 1);
+	node->label = g_string_chunk_insert_const(self->labels,
+						  label ? label : "");
+	node->data = data;
+	node->destroy = destroy;
+	node->parent = parent;
+
+	had_child = HAS_CHILD(parent);
+	if (parent->children == NULL) parent->children = g_ptr_array_new();
+
+	if (sibling) {
+		pos = sibling->index;
+	} else if (self->auto_sort && !self->frozen) {
+		pos = sorted_position(parent, node->label);
+	} else {
+		pos = NODE_COUNT(parent);
+	}
+
+	if (self->auto_sort && self->frozen && sibling == NULL &&
+	    !parent->sort_pending) {
+		parent->sort_pending = TRUE;
+		self->unsorted = g_slist_prepend(self->unsorted, parent);
+	}
+
+	g_ptr_array_add(parent->children, node);
+	if (pos < parent->children->len - 1) {
+		memmove(parent->children->pdata + pos + 1,
+			parent->children->pdata + pos,
+			(parent->children->len - 1 - pos) * sizeof(gpointer));
+		parent->children->pdata[pos] = node;
+		reindex(parent, pos);
+	} else {
+		node->index = pos;
+	}
+
+	path = node_path(node);
+	to_iter(self, node, &iter);
+	gtk_tree_model_row_inserted(GTK_TREE_MODEL(self), path, &iter);
+	gtk_tree_path_free(path);
+
+	if (!had_child) emit_has_child_toggled(self, parent);
+
+	return node;
+}
+
+void
+gq_browser_model_remove(GqBrowserModel     *self,
+			GqBrowserModelNode *node)
+{
+	GqBrowserModelNode *parent;
+	GtkTreePath        *path;
+
+	g_return_if_fail(GQ_IS_BROWSER_MODEL(self));
+	g_return_if_fail(node != NULL && node->parent != NULL);
+
+	parent = node->parent;
+	path = node_path(node);
+
+	g_ptr_array_remove_index(parent->children, node->index);
+	reindex(parent, node->index);
+	if (parent->children->len == 0) {
+		g_ptr_array_free(parent->children, TRUE);
+		parent->children = NULL;
+	}
+	free_node(self, node);
+
+	gtk_tree_model_row_deleted(GTK_TREE_MODEL(self), path);
+	gtk_tree_path_free(path);
+
+	if (!HAS_CHILD(parent)) emit_has_child_toggled(self, parent);
+}
+
+void
+gq_browser_model_remove_children(GqBrowserModel     *self,
+				 GqBrowserModelNode *node)
+{
+	gboolean had_child;
+
+	g_return_if_fail(GQ_IS_BROWSER_MODEL(self));
+
+	node = real_parent(self, node);
+	had_child = HAS_CHILD(node);
+
+	/* from the end, nothing needs to move that way */
+	while (NODE_COUNT(node) > 0) {
+		GqBrowserModelNode *child = NODE_CHILD(node, node->children->len - 1);
+		GtkTreePath *path = node_path(child);
+
+		g_ptr_array_remove_index(node->children, child->index);
+		free_node(self, child);
+		gtk_tree_model_row_deleted(GTK_TREE_MODEL(self), path);
+		gtk_tree_path_free(path);
+	}
+	if (node->children) {
+		g_ptr_array_free(node->children, TRUE);
+		node->children = NULL;
+	}
+	node->unknown_children = FALSE;
+
+	if (had_child) emit_has_child_toggled(self, node);
+}
+
+void
+gq_browser_model_set_children_unknown(GqBrowserModel     *self,
+				      GqBrowserModelNode *node)
+{
+	gboolean had_child;
+
+	g_return_if_fail(GQ_IS_BROWSER_MODEL(self));
+	g_return_if_fail(node != NULL);
+
+	had_child = HAS_CHILD(node);
+	node->unknown_children = TRUE;
+	if (!had_child) emit_has_child_toggled(self, node);
+}
+
+const gchar *
+gq_browser_model_get_label(GqBrowserModelNode *node)
+{
+	g_return_val_if_fail(node != NULL, NULL);
+	return node->label;
+}
+
+static void
+emit_changed(GqBrowserModel *self, GqBrowserModelNode *node)
+{
+	GtkTreePath *path = node_path(node);
+	GtkTreeIter  iter;
+
+	to_iter(self, node, &iter);
+	gtk_tree_model_row_changed(GTK_TREE_MODEL(self), path, &iter);
+	gtk_tree_path_free(path);
+}
+
+void
+gq_browser_model_set_label(GqBrowserModel     *self,
+			   GqBrowserModelNode *node,
+			   const gchar        *label)
+{
+	g_return_if_fail(GQ_IS_BROWSER_MODEL(self));
+	g_return_if_fail(node != NULL && node->parent != NULL);
+
+	node->label = g_string_chunk_insert_const(self->labels,
+						  label ? label : "");
+	emit_changed(self, node);
+}
+
+gpointer
+gq_browser_model_get_data(GqBrowserModelNode *node)
+{
+	g_return_val_if_fail(node != NULL, NULL);
+	return node->data;
+}
+
+void
+gq_browser_model_set_data(GqBrowserModel     *self,
+			  GqBrowserModelNode *node,
+			  gpointer            data,
+			  GDestroyNotify      destroy)
+{
+	gpointer       old_data;
+	GDestroyNotify old_destroy;
+
+	g_return_if_fail(GQ_IS_BROWSER_MODEL(self));
+	g_return_if_fail(node != NULL && node->parent != NULL);
+
+	old_data = node->data;
+	old_destroy = node->destroy;
+	node->data = data;
+	node->destroy = destroy;
+	if (old_destroy && old_data != data) old_destroy(old_data);
+
+	emit_changed(self, node);
+}
+
+GqBrowserModelNode *
+gq_browser_model_get_parent(GqBrowserModelNode *node)
+{
+	g_return_val_if_fail(node != NULL, NULL);
+
+	/* only the root has no parent itself */
+	return node->parent && node->parent->parent ? node->parent : NULL;
+}
+
+GqBrowserModelNode *
+gq_browser_model_get_child(GqBrowserModel     *self,
+			   GqBrowserModelNode *parent,
+			   guint               n)
+{
+	g_return_val_if_fail(GQ_IS_BROWSER_MODEL(self), NULL);
+
+	parent = real_parent(self, parent);
+	return n < NODE_COUNT(parent) ? NODE_CHILD(parent, n) : NULL;
+}
+
+GqBrowserModelNode *
+gq_browser_model_get_next(GqBrowserModelNode *node)
+{
+	g_return_val_if_fail(node != NULL && node->parent != NULL, NULL);
+
+	return node->index + 1 < NODE_COUNT(node->parent) ?
+		NODE_CHILD(node->parent, node->index + 1) : NULL;
+}
+
+void
+gq_browser_model_node_to_iter(GqBrowserModel     *self,
+			      GqBrowserModelNode *node,
+			      GtkTreeIter        *iter)
+{
+	g_return_if_fail(GQ_IS_BROWSER_MODEL(self));
+	g_return_if_fail(node != NULL && iter != NULL);
+
+	to_iter(self, node, iter);
+}
+
+GqBrowserModelNode *
+gq_browser_model_iter_to_node(GqBrowserModel *self,
+			      GtkTreeIter    *iter)
+{
+	g_return_val_if_fail(GQ_IS_BROWSER_MODEL(self), NULL);
+	g_return_val_if_fail(iter != NULL && iter->stamp == self->stamp, NULL);
+
+	return iter->user_data;
+}
+
+void
+gq_browser_model_sort(GqBrowserModel     *self,
+		      GqBrowserModelNode *node)
+{
+	GtkTreePath *path;
+	GtkTreeIter  iter;
+	gint        *new_order;
+	guint        i, n;
+
+	g_return_if_fail(GQ_IS_BROWSER_MODEL(self));
+
+	node = real_parent(self, node);
+	n = NODE_COUNT(node);
+	if (n < 2) return;
+
+	/* the children still know where they were */
+	g_ptr_array_sort(node->children, compare_labels);
+
+	new_order = g_new(gint, n);
+	for (i = 0 ; i < n ; i++) {
+		new_order[i] = NODE_CHILD(node, i)->index;
+	}
+	reindex(node, 0);
+
+	path = node_path(node);
+	to_iter(self, node, &iter);
+	gtk_tree_model_rows_reordered(GTK_TREE_MODEL(self), path,
+				      node->parent ? &iter : NULL, new_order);
+	gtk_tree_path_free(path);
+	g_free(new_order);
+}
+
+void
+gq_browser_model_set_auto_sort(GqBrowserModel *self,
+			       gboolean        auto_sort)
+{
+	g_return_if_fail(GQ_IS_BROWSER_MODEL(self));
+
+	self->auto_sort = auto_sort;
+}
+
+void
+gq_browser_model_freeze(GqBrowserModel *self)
+{
+	g_return_if_fail(GQ_IS_BROWSER_MODEL(self));
+
+	self->frozen++;
+}
+
+void
+gq_browser_model_thaw(GqBrowserModel *self)
+{
+	g_return_if_fail(GQ_IS_BROWSER_MODEL(self));
+	g_return_if_fail(self->frozen > 0);
+
+	if (--self->frozen > 0) return;
+
+	while (self->unsorted) {
+		GqBrowserModelNode *node = self->unsorted->data;
+
+		self->unsorted = g_slist_delete_link(self->unsorted,
+						     self->unsorted);
+		node->sort_pending = FALSE;
+		gq_browser_model_sort(self, node);
+	}
+}
+
+GtkTreeModel*
+gq_browser_model_new(void)
+{
+	return g_object_new(GQ_TYPE_BROWSER_MODEL, NULL);
+}
 
 static void
-gq_browser_model_init(GqBrowserModel* self) {}
+gq_browser_model_init(GqBrowserModel* self)
+{
+	do {
+		self->stamp = g_random_int();
+	} while (self->stamp == 0);
+	self->labels = g_string_chunk_new(4096);
+}
+
+static void
+gq_browser_model_finalize(GObject* object)
+{
+	GqBrowserModel *self = GQ_BROWSER_MODEL(object);
+	guint i;
+
+	for (i = 0 ; i < NODE_COUNT(&self->root) ; i++) {
+		free_node(self, NODE_CHILD(&self->root, i));
+	}
+	if (self->root.children) g_ptr_array_free(self->root.children, TRUE);
+	g_slist_free(self->unsorted);
+	g_string_chunk_free(self->labels);
+
+	G_OBJECT_CLASS(gq_browser_model_parent_class)->finalize(object);
+}
+
+static void
+gq_browser_model_class_init(GqBrowserModelClass* self_class)
+{
+	G_OBJECT_CLASS(self_class)->finalize = gq_browser_model_finalize;
+}
+
+/* GtkTreeModel */
+#define ITER_NODE(iter)	((GqBrowserModelNode *) (iter)->user_data)
+
+static GtkTreeModelFlags
+browser_model_get_flags(GtkTreeModel* model)
+{
+	return GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+static gint
+browser_model_get_n_columns(GtkTreeModel* model)
+{
+	return GQ_BROWSER_MODEL_N_COLUMNS;
+}
+
+static GType
+browser_model_get_column_type(GtkTreeModel* model, gint column)
+{
+	switch (column) {
+	case GQ_BROWSER_MODEL_COL_LABEL:
+		return G_TYPE_STRING;
+	case GQ_BROWSER_MODEL_COL_DATA:
+		return G_TYPE_POINTER;
+	default:
+		g_return_val_if_reached(G_TYPE_INVALID);
+	}
+}
+
+static gboolean
+browser_model_get_iter(GtkTreeModel* model, GtkTreeIter* iter, GtkTreePath* path)
+{
+	GqBrowserModel     *self = GQ_BROWSER_MODEL(model);
+	GqBrowserModelNode *node = &self->root;
+	gint               *indices = gtk_tree_path_get_indices(path);
+	gint                i, depth = gtk_tree_path_get_depth(path);
+
+	for (i = 0 ; i < depth ; i++) {
+		if (indices[i] < 0 || (guint) indices[i] >= NODE_COUNT(node)) {
+			return FALSE;
+		}
+		node = NODE_CHILD(node, indices[i]);
+	}
+	if (node == &self->root) return FALSE;
+
+	to_iter(self, node, iter);
+	return TRUE;
+}
+
+static GtkTreePath*
+browser_model_get_path(GtkTreeModel* model, GtkTreeIter* iter)
+{
+	g_return_val_if_fail(iter->stamp == GQ_BROWSER_MODEL(model)->stamp, NULL);
+	return node_path(ITER_NODE(iter));
+}
+
+static void
+browser_model_get_value(GtkTreeModel* model, GtkTreeIter* iter, gint column, GValue* value)
+{
+	GqBrowserModelNode *node = ITER_NODE(iter);
+
+	g_return_if_fail(iter->stamp == GQ_BROWSER_MODEL(model)->stamp);
+
+	switch (column) {
+	case GQ_BROWSER_MODEL_COL_LABEL:
+		g_value_init(value, G_TYPE_STRING);
+		g_value_set_static_string(value, node->label);
+		break;
+	case GQ_BROWSER_MODEL_COL_DATA:
+		g_value_init(value, G_TYPE_POINTER);
+		g_value_set_pointer(value, node->data);
+		break;
+	default:
+		g_return_if_reached();
+	}
+}
+
+static gboolean
+browser_model_iter_next(GtkTreeModel* model, GtkTreeIter* iter)
+{
+	GqBrowserModelNode *next = gq_browser_model_get_next(ITER_NODE(iter));
+
+	if (next == NULL) return FALSE;
+	iter->user_data = next;
+	return TRUE;
+}
+
+static gboolean
+browser_model_iter_nth_child(GtkTreeModel* model, GtkTreeIter* iter, GtkTreeIter* parent, gint n)
+{
+	GqBrowserModel     *self = GQ_BROWSER_MODEL(model);
+	GqBrowserModelNode *node = parent ? ITER_NODE(parent) : &self->root;
+
+	if (n < 0 || (guint) n >= NODE_COUNT(node)) return FALSE;
+
+	to_iter(self, NODE_CHILD(node, n), iter);
+	return TRUE;
+}
+
+static gboolean
+browser_model_iter_children(GtkTreeModel* model, GtkTreeIter* iter, GtkTreeIter* parent)
+{
+	return browser_model_iter_nth_child(model, iter, parent, 0);
+}
+
+static gboolean
+browser_model_iter_has_child(GtkTreeModel* model, GtkTreeIter* iter)
+{
+	return HAS_CHILD(ITER_NODE(iter));
+}
+
+static gint
+browser_model_iter_n_children(GtkTreeModel* model, GtkTreeIter* iter)
+{
+	GqBrowserModel *self = GQ_BROWSER_MODEL(model);
+
+	return NODE_COUNT(iter ? ITER_NODE(iter) : &self->root);
+}
+
+static gboolean
+browser_model_iter_parent(GtkTreeModel* model, GtkTreeIter* iter, GtkTreeIter* child)
+{
+	GqBrowserModelNode *parent = gq_browser_model_get_parent(ITER_NODE(child));
+
+	if (parent == NULL) return FALSE;
+	to_iter(GQ_BROWSER_MODEL(model), parent, iter);
+	return TRUE;
+}
 
 static void
-gq_browser_model_class_init(GqBrowserModelClass* self_class) {}
+gq_browser_model_tree_model_init(GtkTreeModelIface *iface)
+{
+	iface->get_flags       = browser_model_get_flags;
+	iface->get_n_columns   = browser_model_get_n_columns;
+	iface->get_column_type = browser_model_get_column_type;
+	iface->get_iter        = browser_model_get_iter;
+	iface->get_path        = browser_model_get_path;
+	iface->get_value       = browser_model_get_value;
+	iface->iter_next       = browser_model_iter_next;
+	iface->iter_children   = browser_model_iter_children;
+	iface->iter_has_child  = browser_model_iter_has_child;
+	iface->iter_n_children = browser_model_iter_n_children;
+	iface->iter_nth_child  = browser_model_iter_nth_child;
+	iface->iter_parent     = browser_model_iter_parent;
+}
 
@@ -28,14 +28,88 @@
 
 G_BEGIN_DECLS
 
-typedef GObject      GqBrowserModel;
-typedef GObjectClass GqBrowserModelClass;
+/* The rows of the browser tree, for the GtkTreeView implementation
+   of GqTreeWidget.
+
+   A node is a small record: its label (interned, the same RDN shows
+   up under many parents), the row data, its parent and a vector of
+   its children. Rows only exist as iters pointing to these nodes, so
+   nothing gets allocated for rows the view never looks at. Nodes stay
+   where they are until removed, iters to them stay valid as long.
+
+   A node can be marked as having children not fetched yet. It then
+   shows an expander without carrying a dummy row, the children get
+   inserted when it is expanded. */
+
+typedef struct _GqBrowserModel     GqBrowserModel;
+typedef GObjectClass               GqBrowserModelClass;
+typedef struct _GqBrowserModelNode GqBrowserModelNode;
 
 #define GQ_TYPE_BROWSER_MODEL        (gq_browser_model_get_type())
+#define GQ_BROWSER_MODEL(i)          (G_TYPE_CHECK_INSTANCE_CAST((i), GQ_TYPE_BROWSER_MODEL, GqBrowserModel))
+#define GQ_IS_BROWSER_MODEL(i)       (G_TYPE_CHECK_INSTANCE_TYPE((i), GQ_TYPE_BROWSER_MODEL))
+
+enum {
+	GQ_BROWSER_MODEL_COL_LABEL,	/* gchararray */
+	GQ_BROWSER_MODEL_COL_DATA,	/* gpointer, the row data */
+	GQ_BROWSER_MODEL_N_COLUMNS
+};
 
 GType         gq_browser_model_get_type(void);
 GtkTreeModel* gq_browser_model_new(void);
 
+/* parent NULL: at the top level. Inserts before sibling, or at the
+   end, or where the label sorts to with auto sorting. */
+GqBrowserModelNode *gq_browser_model_insert(GqBrowserModel     *self,
+					    GqBrowserModelNode *parent,
+					    GqBrowserModelNode *sibling,
+					    const gchar        *label,
+					    gpointer            data,
+					    GDestroyNotify      destroy);
+/* removes node with everything below it */
+void     gq_browser_model_remove          (GqBrowserModel     *self,
+					   GqBrowserModelNode *node);
+/* removes the children, and the mark of unknown children */
+void     gq_browser_model_remove_children (GqBrowserModel     *self,
+					   GqBrowserModelNode *node);
+void     gq_browser_model_set_children_unknown(GqBrowserModel     *self,
+					       GqBrowserModelNode *node);
+
+const gchar *gq_browser_model_get_label   (GqBrowserModelNode *node);
+void     gq_browser_model_set_label       (GqBrowserModel     *self,
+					   GqBrowserModelNode *node,
+					   const gchar        *label);
+gpointer gq_browser_model_get_data        (GqBrowserModelNode *node);
+/* destroys the old data */
+void     gq_browser_model_set_data        (GqBrowserModel     *self,
+					   GqBrowserModelNode *node,
+					   gpointer            data,
+					   GDestroyNotify      destroy);
+
+/* NULL for top level nodes */
+GqBrowserModelNode *gq_browser_model_get_parent(GqBrowserModelNode *node);
+/* parent NULL: the top level */
+GqBrowserModelNode *gq_browser_model_get_child (GqBrowserModel     *self,
+						GqBrowserModelNode *parent,
+						guint               n);
+GqBrowserModelNode *gq_browser_model_get_next  (GqBrowserModelNode *node);
+
+void     gq_browser_model_node_to_iter    (GqBrowserModel     *self,
+					   GqBrowserModelNode *node,
+					   GtkTreeIter        *iter);
+GqBrowserModelNode *gq_browser_model_iter_to_node(GqBrowserModel *self,
+						  GtkTreeIter    *iter);
+
+/* sorts the children of node (NULL: the top level) by label */
+void     gq_browser_model_sort            (GqBrowserModel     *self,
+					   GqBrowserModelNode *node);
+void     gq_browser_model_set_auto_sort   (GqBrowserModel     *self,
+					   gboolean            auto_sort);
+/* while frozen, auto sorting only appends and sorts every parent
+   touched once when thawing */
+void     gq_browser_model_freeze          (GqBrowserModel     *self);
+void     gq_browser_model_thaw            (GqBrowserModel     *self);
+
 G_END_DECLS
 
 #endif /* !GQ_BROWSER_MODEL_H */
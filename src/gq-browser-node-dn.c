@@ -37,7 +37,9 @@
 #endif /* HAVE_CONFIG_H */
 
 #include "common.h"
+#include "gq-browser-node-range.h"
 #include "gq-browser-node-reference.h"
+#include "gq-compare.h"
 #include "gq-tab-browse.h"
 #include "gq-tab-search.h"
 
@@ -48,6 +50,7 @@
 
 #include "tinput.h"		/* formfill_from_template */
 #include "browse-dnd.h"		/* copy_entry et al */
+#include "ldapops.h"		/* list_children */
 
 #include "configfile.h"		/* config */
 #include "errorchain.h"
@@ -55,6 +58,7 @@
 #include "encode.h"
 
 #include "browse-export.h"
+#include "browse-live.h"
 
 static void tree_row_search_below(GtkMenuItem *menuitem, GqTab *tab)
 {
@@ -208,6 +212,34 @@ static void dump_subtree(GtkWidget *widget, GqTab *tab)
      error_flush(error_context);
 }
 
+static void compare_browse_subtree(GtkWidget *widget, GqTab *tab)
+{
+     GQTreeWidget *ctree;
+     GQTreeWidgetNode *node;
+     GqBrowserNode *e;
+     GqServer *server;
+     int error_context;
+
+     ctree = GQ_TAB_BROWSE(tab)->ctreeroot;
+     node = GQ_TAB_BROWSE(tab)->tree_row_popped_up;
+     e = GQ_BROWSER_NODE(gq_tree_get_node_data (ctree, node));
+
+     g_assert(GQ_IS_BROWSER_NODE_DN(e));
+
+     server = server_from_node(ctree, node);
+
+     if (e == NULL || server == NULL)
+	  return;
+
+     error_context = error_new_context(_("Comparing subtrees"),
+				       tab->win->mainwin);
+
+     compare_subtree(error_context, tab->win->mainwin, server,
+		     GQ_BROWSER_NODE_DN(e)->dn);
+
+     error_flush(error_context);
+}
+
 static void delete_browse_entry(GtkWidget *widget, GqTab *tab)
 {
      GQTreeWidget *ctree;
@@ -228,7 +260,7 @@ static void delete_browse_entry(GtkWidget *widget, GqTab *tab)
 
      do_delete = 0;
 
-     gtk_clist_freeze(GTK_CLIST(ctree));
+     gq_tree_widget_freeze(ctree);
      
      if (!entry->seen) {
 	  gq_tree_fire_expand_callback (ctree, node);
@@ -257,6 +289,7 @@ static void delete_browse_entry(GtkWidget *widget, GqTab *tab)
      if (do_delete) {
 	  int ctx = error_new_context(_("Deleting entry/subtree"),
 				      GTK_WIDGET(ctree));
+	  error_set_bulk(ctx, ERROR_BULK_SAMPLES, TRUE);
 	  if (delete_entry_full(ctx, server, entry->dn, TRUE)) {
 	       GqBrowserNode *p_entry;
 	       GQTreeWidgetNode *parent = gq_tree_get_parent_node (ctree,
@@ -277,7 +310,7 @@ static void delete_browse_entry(GtkWidget *widget, GqTab *tab)
 	  }
 	  error_flush(ctx);
      }
-     gtk_clist_thaw(GTK_CLIST(ctree));
+     gq_tree_widget_thaw(ctree);
 }
 
 
@@ -305,6 +338,94 @@ static void destroy_dn_browse_entry(GqBrowserNode *e)
 }
 
 
+struct expand_info {
+     GqBrowserNodeDn *entry;
+     GQTreeWidget *ctree;
+     GQTreeWidgetNode *node;
+};
+
+static void expand_add_referral(const char *url, struct expand_info *info)
+{
+     info->entry->is_ref = TRUE; /* now we know for sure */
+     ref_browse_single_add(url, info->ctree, info->node);
+}
+
+static void expand_add_child(const char *dn, struct expand_info *info)
+{
+     dn_browse_single_add(dn, info->ctree, info->node);
+}
+
+/* sorts the children listed below node and tells how many there
+   were. err is the result of the listing. */
+static void show_listed_children(GqBrowserNodeDn *entry, GqServer *server,
+				 GQTreeWidget *ctree, GQTreeWidgetNode *node,
+				 int num_children, int err)
+{
+     char message[1024 + 21];
+     gdouble rstart;
+
+     /* tree sorting */
+     rstart = gq_server_stats_start();
+     gq_tree_widget_sort_node(GQ_TREE_WIDGET(ctree), node);
+     gq_server_stats_stop(server, GQ_STAT_RENDER, rstart, TRUE);
+     entry->leaf = (num_children == 0);
+
+     if (err == LDAP_SERVER_DOWN) return;
+
+     g_snprintf(message, sizeof(message),
+		ngettext("One entry found (finished)",
+			 "%d entries found (finished)", num_children),
+		num_children);
+
+     if (err == LDAP_SIZELIMIT_EXCEEDED) {
+	  int l = strlen(message);
+	  g_snprintf(message + l, sizeof(message) - l, 
+		     " - %s", _("size limit exceeded"));
+     } else if (err == LDAP_TIMELIMIT_EXCEEDED) {
+	  int l = strlen(message);
+	  g_snprintf(message + l, sizeof(message) - l, 
+		     " - %s", _("time limit exceeded"));
+     }
+
+     statusbar_msg(message);
+}
+
+void gq_browser_node_dn_set_children(GqBrowserNodeDn *entry,
+				     GqServer *server,
+				     GQTreeWidget *ctree,
+				     GQTreeWidgetNode *node,
+				     GList *refs, GList *children, int err)
+{
+     struct expand_info info;
+     GList *I;
+
+     info.entry = entry;
+     info.ctree = ctree;
+     info.node = node;
+
+     gq_tree_widget_freeze(ctree);
+     gq_tree_remove_children(ctree, node);
+
+     for (I = refs ; I ; I = I->next) {
+	  expand_add_referral(I->data, &info);
+     }
+
+     if (entry->is_ref) {
+	  statusbar_msg(_("Showing referrals"));
+     } else {
+	  for (I = children ; I ; I = I->next) {
+	       expand_add_child(I->data, &info);
+	  }
+	  gq_server_stats_rendered(server, g_list_length(children));
+	  show_listed_children(entry, server, ctree, node,
+			       g_list_length(children), err);
+     }
+
+     gq_tree_widget_thaw(ctree);
+
+     if (err != LDAP_SERVER_DOWN) entry->seen = TRUE;
+}
+
 static void dn_browse_entry_expand(GqBrowserNode *be,
 				   int error_context,
 				   GQTreeWidget *ctree,
@@ -312,17 +433,11 @@ static void dn_browse_entry_expand(GqBrowserNode *be,
 				   GqTab *tab)
 {
      LDAP *ld = NULL;
-     LDAPMessage *res = NULL, *e;
      GqServer *server = NULL;
-     int msg, rc, num_children, update_counter, err;
-     char message[1024 + 21];
-     char *dummy[] = { "dummy", NULL };
-     char *ref[] = { "ref", NULL };
-     char *c, **refs;
+     int num_children, err;
      GqBrowserNodeDn *entry;
-
-     LDAPControl ct;
-     LDAPControl *ctrls[2] = { NULL, NULL } ;
+     gdouble rstart;
+     struct expand_info info;
 
      g_assert(GQ_IS_BROWSER_NODE_DN(be));
      entry = GQ_BROWSER_NODE_DN(be);
@@ -333,12 +448,12 @@ static void dn_browse_entry_expand(GqBrowserNode *be,
 /*  		 server->ldaphost, */
 /*  		 entry->dn); */
 	  
-	  gtk_clist_freeze(GTK_CLIST(ctree));
+	  gq_tree_widget_freeze(ctree);
 
 	  gq_tree_remove_children (ctree, node);
 
 	  if( (ld = open_connection(error_context, server)) == NULL) {
-	       gtk_clist_thaw(GTK_CLIST(ctree));
+	       gq_tree_widget_thaw(ctree);
 	       return;
 	  }
 
@@ -350,179 +465,76 @@ static void dn_browse_entry_expand(GqBrowserNode *be,
 #endif
 
 	  statusbar_msg(_("Onelevel search on %s"), entry->dn);
-	  
-	  ct.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
-	  ct.ldctl_value.bv_val	= NULL;
-	  ct.ldctl_value.bv_len	= 0;
-	  ct.ldctl_iscritical	= 1;
-		    
-	  ctrls[0] = &ct;
-	  
-	  /* check if this is a referral object */
 
-	  rc = ldap_search_ext(ld, entry->dn,
-			       LDAP_SCOPE_BASE, 
-			       "(objectClass=referral)", ref, 0,
-			       ctrls,		/* serverctrls */
-			       NULL,		/* clientctrls */
-			       NULL,		/* timeout */
-			       LDAP_NO_LIMIT,	/* sizelimit */
-			       &msg);
-
-	  /* FIXME: THIS IS NOT CORRECT */
-/* 	  if (rc == -1) { */
-/* 	       statusbar_msg(_("Searching for '%1$s': %2$s"),  */
-/* 			     entry->dn, */
-/* 			     ldap_err2string(msg)); */
-/* 	       close_connection(server, FALSE); */
-/* 	       gtk_clist_thaw(GTK_CLIST(ctree)); */
-	       
-/* 	       error_flush(context); */
-/* 	       return; */
-	       
-/* 	  } */
-
-	  while((rc = ldap_result(ld, msg, 0,
-				  NULL, &res)) == LDAP_RES_SEARCH_ENTRY) {
-	       for(e = ldap_first_entry(ld, res) ; e != NULL ;
-		   e = ldap_next_entry(ld, e)) {
-		    char **vals = ldap_get_values(ld, e, "ref");
-		    int i;
-		    
-		    if (vals == NULL) continue;
-		    
-		    for(i = 0; vals[i]; i++) {
-			 entry->is_ref = TRUE; /* now we know for sure */
-			 ref_browse_single_add(vals[i], ctree, node);
-		    }
-		    
-		    if (vals)  /* redundant, but... */
-			 ldap_value_free(vals);
-	       }
-	       if (res) ldap_msgfree(res);
-	       res = NULL;
-	  }
-	  
-	  if (res) ldap_msgfree(res);
-	  res = NULL;
+	  info.entry = entry;
+	  info.ctree = ctree;
+	  info.node = node;
+
+	  /* check if this is a referral object */
+	  list_referrals(error_context, ld, entry->dn,
+			 (ListFunc) expand_add_referral, &info);
 
 	  if (entry->is_ref) {
 	       entry->seen = TRUE;
 	       statusbar_msg(_("Showing referrals"));
-	       gtk_clist_thaw(GTK_CLIST(ctree));
+	       gq_tree_widget_thaw(ctree);
 	       close_connection(server, FALSE);
 	       return;
 	  }
 
+	  /* huge containers get split into server-sorted windows that
+	     are only fetched when opened */
+	  if (gq_browser_node_range_expand_container(error_context, server,
+						     ld, entry->dn,
+						     ctree, node)) {
+	       entry->seen = TRUE;
+	       entry->leaf = FALSE;
+	       gq_tree_widget_thaw(ctree);
+	       close_connection(server, FALSE);
+	       return;
+	  }
 
+	  /* with content synchronisation the subscription lists the
+	     children, a search before it would get them all twice */
+	  num_children = browse_live_list_children(error_context, tab,
+						   server, ld, entry->dn,
+						   node);
+	  if (num_children >= 0) {
+	       gq_server_stats_rendered(server, num_children);
+	       rstart = gq_server_stats_start();
+	       gq_tree_widget_sort_node(GQ_TREE_WIDGET(ctree), node);
+	       gq_server_stats_stop(server, GQ_STAT_RENDER, rstart, TRUE);
+	       entry->leaf = (num_children == 0);
+	       entry->seen = TRUE;
 
+	       statusbar_msg(ngettext("One entry found (finished)",
+				      "%d entries found (finished)",
+				      num_children),
+			     num_children);
+	       gq_tree_widget_thaw(ctree);
+	       close_connection(server, FALSE);
+	       return;
+	  }
 
+	  num_children = list_children(error_context, server, ld, entry->dn,
+				       (ListFunc) expand_add_child, &info,
+				       &err);
 
-	  rc = ldap_search_ext(ld, entry->dn,
-			       LDAP_SCOPE_ONELEVEL, 
-			       "(objectClass=*)", dummy, 1,
-			       ctrls,		/* serverctrls */
-			       NULL,		/* clientctrls */
-			       NULL,		/* timeout */
-			       LDAP_NO_LIMIT,	/* sizelimit */
-			       &msg);
-
-	  /* FIXME */
-/* 	  if(rc != LDAP_SUCCESS) { */
-/* 	       statusbar_msg(_("Error while searching below '%1$s': %2$s"), */
-/* 			     entry->dn, */
-/* 			     ldap_err2string(msg)); */
-/* 	       close_connection(server, FALSE); */
-/* 	       gtk_clist_thaw(GTK_CLIST(ctree)); */
+	  show_listed_children(entry, server, ctree, node,
+			       num_children, err);
 
-/* 	       error_flush(context); */
-/* 	       return; */
-/* 	  } */
-	  
-	  num_children = update_counter = 0;
-
-	  while( (rc = ldap_result(ld, msg, 0,
-				   NULL, &res)) == LDAP_RES_SEARCH_ENTRY) {
-	       for(e = ldap_first_entry(ld, res) ; e != NULL ;
-		   e = ldap_next_entry(ld, e)) {
-
-		    char *dn = ldap_get_dn(ld, e);
-		    dn_browse_single_add(dn, ctree, node);
-		    if (dn) ldap_memfree(dn);
-
-		    num_children++;
-		    update_counter++;
-		    if(update_counter >= 100) {
-			 statusbar_msg(ngettext("One entry found (running)",
-						"%d entries found (running)",
-						num_children), num_children);
-
-			 update_counter = 0;
-		    }
-	       }
-	       ldap_msgfree(res);
-	  }
-	  /* tree sorting */
-	  gtk_clist_set_sort_type(GTK_CLIST(ctree), GTK_SORT_ASCENDING);
-	  gtk_clist_set_sort_column(GTK_CLIST(ctree), 0);
-	  gtk_clist_set_compare_func(GTK_CLIST(ctree), (GtkCListCompareFunc)NULL);
-	  gq_tree_widget_sort_node(GQ_TREE_WIDGET(ctree), node);
-	  entry->leaf = (num_children == 0);
-
-	  g_snprintf(message, sizeof(message),
-		   ngettext("One entry found (finished)",
-			    "%d entries found (finished)", num_children),
-		   num_children);
-
-	  ldap_get_option(ld, LDAP_OPT_ERROR_NUMBER, &rc);
-
-	  if (rc == LDAP_SERVER_DOWN) {
-	       server->server_down++;
-	       gtk_clist_thaw(GTK_CLIST(ctree));
+	  if (err == LDAP_SERVER_DOWN) {
+	       gq_tree_widget_thaw(ctree);
 	       goto done;
 	  }
 
-	  if (res) {
-	       rc = ldap_parse_result(ld, res,
-				      &err, &c, NULL, &refs, NULL, 0);
-	  }
-
-	  if (rc != LDAP_SUCCESS) {	
-	       /* FIXME: better error message (but what is the exact cause?)*/
-	       error_push(error_context, ldap_err2string(rc));
-	       push_ldap_addl_error(ld, error_context);
-
-	       if (rc == LDAP_SERVER_DOWN) {
-		    server->server_down++;
-	       }
-	  } else {
-	       if (err == LDAP_SIZELIMIT_EXCEEDED) {
-		    int l = strlen(message);
-		    g_snprintf(message + l, sizeof(message) - l, 
-			     " - %s", _("size limit exceeded"));
-	       } else if (err == LDAP_TIMELIMIT_EXCEEDED) {
-		    int l = strlen(message);
-		    g_snprintf(message + l, sizeof(message) - l, 
-			     " - %s", _("time limit exceeded"));
-	       } else if (err != LDAP_SUCCESS) {
-		    error_push(error_context, ldap_err2string(err));
-		    push_ldap_addl_error(ld, error_context);
-		    if (c && strlen(c)) {
-			 error_push(error_context, _("Matched DN: %s"), c);
-		    }
-		    if (refs) {
-			 int i;
-			 for (i = 0 ; refs[i] ; i++) {
-			      error_push(error_context,
-					 _("Referral to: %s"), refs[i]);
-			 }
-		    }
-	       }
+	  /* from now on follow changes instead of searching again */
+	  if (err == LDAP_SUCCESS && server->live_updates) {
+	       browse_live_subscribe(error_context, tab,
+				     server, ld, entry->dn);
 	  }
 
-	  statusbar_msg(message);
-
-	  gtk_clist_thaw(GTK_CLIST(ctree));
+	  gq_tree_widget_thaw(ctree);
 
 	  entry->seen = TRUE;
      }
@@ -541,7 +553,6 @@ static void dn_browse_entry_expand(GqBrowserNode *be,
      */
 
  done:
-     if (res) ldap_msgfree(res);
      if (server && ld) close_connection(server, FALSE);
 }
 
@@ -721,6 +732,14 @@ static void dn_browse_entry_popup(GqBrowserNode *entry, GtkWidget *menu,
 			tab);
      gtk_widget_show(menu_item);
 
+     /* Compare subtree */
+     menu_item = gtk_menu_item_new_with_label(_("Compare subtree..."));
+     gtk_menu_append(GTK_MENU(menu), menu_item);
+     g_signal_connect(menu_item, "activate",
+			G_CALLBACK(compare_browse_subtree),
+			tab);
+     gtk_widget_show(menu_item);
+
      menu_item = gtk_menu_item_new();
      gtk_menu_append(GTK_MENU(menu), menu_item);
      gtk_widget_show(menu_item);
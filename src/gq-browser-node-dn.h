@@ -57,6 +57,16 @@ struct _GqBrowserNodeDn {
 
 GqBrowserNode *gq_browser_node_dn_new(const char *dn);
 
+/* Fills node with the result of a onelevel listing of entry done by
+   someone else (restoring a browse path does it from the main loop):
+   refs are the referral URLs if entry is a referral object, children
+   the DNs below it and err the result code of the listing. */
+void gq_browser_node_dn_set_children(GqBrowserNodeDn *entry,
+				     GqServer *server,
+				     GQTreeWidget *ctree,
+				     GQTreeWidgetNode *node,
+				     GList *refs, GList *children, int err);
+
 G_END_DECLS
 
 #endif
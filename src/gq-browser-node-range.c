@@ -0,0 +1,366 @@
+/*
+    GQ -- a GTK-based LDAP client
+    Copyright (C) 1998-2003 Bert Vermeulen
+    Copyright (C) 2002-2003 Peter Stamfest
+
+    This program is released under the Gnu General Public License with
+    the additional exemption that compiling, linking, and/or using
+    OpenSSL is allowed.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "gq-browser-node-range.h"
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+
+#ifdef HAVE_CONFIG_H
+# include  <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "common.h"
+#include "gq-tab-browse.h"
+
+#include "errorchain.h"
+#include "util.h"
+
+#if defined(HAVE_LDAP_CREATE_VLV_CONTROL) && defined(LDAP_CONTROL_VLVREQUEST)
+
+/* Sorted ONELEVEL search below dn for the children at the positions
+   offset to offset + after. If ctree is given the children get added
+   below node. The server's estimate of the total number of children
+   is stored in *content_count. */
+static int vlv_search(int error_context, GqServer *server, LDAP *ld,
+		      const char *dn, gulong offset, gulong after,
+		      GQTreeWidget *ctree, GQTreeWidgetNode *node,
+		      gulong *content_count)
+{
+     LDAPSortKey **keys = NULL;
+     LDAPControl *sortctrl = NULL, *vlvctrl = NULL;
+     LDAPControl ct;
+     LDAPControl *ctrls[4] = { NULL, NULL, NULL, NULL };
+     LDAPControl **resctrls = NULL, *vlvres;
+     LDAPVLVInfo vlvinfo;
+     LDAPMessage *res = NULL, *e;
+     char *dummy[] = { "dummy", NULL };
+     ber_int_t target, count, vlverr;
+     int rc, err = LDAP_SUCCESS;
+     gulong n = 0;
+     gdouble start, rstart;
+
+     *content_count = 0;
+
+     rc = ldap_create_sort_keylist(&keys, server->searchattr);
+     if (rc != LDAP_SUCCESS) goto done;
+
+     rc = ldap_create_sort_control(ld, keys, 1, &sortctrl);
+     if (rc != LDAP_SUCCESS) goto done;
+
+     vlvinfo.ldvlv_version	= 1;
+     vlvinfo.ldvlv_before_count	= 0;
+     vlvinfo.ldvlv_after_count	= after;
+     vlvinfo.ldvlv_offset	= offset;
+     vlvinfo.ldvlv_count	= 0;	/* offset is an absolute position */
+     vlvinfo.ldvlv_attrvalue	= NULL;
+     vlvinfo.ldvlv_context	= NULL;
+     vlvinfo.ldvlv_extradata	= NULL;
+
+     rc = ldap_create_vlv_control(ld, &vlvinfo, &vlvctrl);
+     if (rc != LDAP_SUCCESS) goto done;
+
+     ct.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+     ct.ldctl_value.bv_val	= NULL;
+     ct.ldctl_value.bv_len	= 0;
+     ct.ldctl_iscritical	= 1;
+
+     ctrls[0] = &ct;
+     ctrls[1] = sortctrl;
+     ctrls[2] = vlvctrl;
+
+     start = gq_server_stats_start();
+     rc = ldap_search_ext_s(ld, dn,
+			    LDAP_SCOPE_ONELEVEL,
+			    "(objectClass=*)", dummy, 1,
+			    ctrls,		/* serverctrls */
+			    NULL,		/* clientctrls */
+			    NULL,		/* timeout */
+			    LDAP_NO_LIMIT,	/* sizelimit */
+			    &res);
+     gq_server_stats_stop(server, GQ_STAT_SEARCH, start, rc == LDAP_SUCCESS);
+
+     if (rc == LDAP_SERVER_DOWN) {
+	  server->server_down++;
+	  goto done;
+     }
+     if (res == NULL) goto done;
+
+     if (ctree) {
+	  for (e = ldap_first_entry(ld, res) ; e ;
+	       e = ldap_next_entry(ld, e)) {
+	       char *cdn = ldap_get_dn(ld, e);
+
+	       rstart = gq_server_stats_start();
+	       dn_browse_single_add(cdn, ctree, node);
+	       gq_server_stats_stop(server, GQ_STAT_RENDER, rstart, TRUE);
+
+	       if (cdn) ldap_memfree(cdn);
+	       n++;
+	  }
+	  gq_server_stats_entries(server, n);
+	  gq_server_stats_rendered(server, n);
+     }
+
+     rc = ldap_parse_result(ld, res, &err, NULL, NULL, NULL, &resctrls, 0);
+     if (rc == LDAP_SUCCESS) rc = err;
+
+     if (resctrls) {
+	  vlvres = ldap_control_find(LDAP_CONTROL_VLVRESPONSE, resctrls, NULL);
+	  if (vlvres &&
+	      ldap_parse_vlvresponse_control(ld, vlvres, &target, &count,
+					     NULL, &vlverr) == LDAP_SUCCESS) {
+	       if (vlverr != LDAP_SUCCESS) rc = vlverr;
+	       else if (count > 0) *content_count = count;
+	  }
+	  ldap_controls_free(resctrls);
+     }
+
+ done:
+     if (rc != LDAP_SUCCESS && ctree) {
+	  error_push(error_context,
+		     _("Error searching below '%1$s': %2$s"),
+		     dn, ldap_err2string(rc));
+	  push_ldap_addl_error(ld, error_context);
+     }
+
+     if (res) ldap_msgfree(res);
+     if (vlvctrl) ldap_control_free(vlvctrl);
+     if (sortctrl) ldap_control_free(sortctrl);
+     if (keys) ldap_free_sort_keylist(keys);
+
+     return rc;
+}
+
+#endif /* HAVE_LDAP_CREATE_VLV_CONTROL */
+
+/* adds range nodes for the positions first to first + total - 1
+   below node. If this would give more than window nodes each of
+   them covers a multiple of window children, so they nest */
+static void insert_ranges(GQTreeWidget *ctree, GQTreeWidgetNode *node,
+			  const char *dn, gulong first, gulong total,
+			  gulong window)
+{
+     gulong step = window, pos;
+
+     while (total > step * window) {
+	  step *= window;
+     }
+
+     for (pos = first ; pos < first + total ; pos += step) {
+	  gulong n = MIN(step, first + total - pos);
+	  GqBrowserNode *r = gq_browser_node_range_new(dn, pos, n);
+	  gchar *label = GQ_BROWSER_NODE_GET_CLASS(r)->get_name(r, FALSE);
+	  GQTreeWidgetNode *added;
+
+	  added = gq_tree_insert_node(ctree, node, NULL, label,
+				      r, g_object_unref);
+	  gq_tree_insert_dummy_node(ctree, added);
+
+	  g_free(label);
+     }
+}
+
+gboolean gq_browser_node_range_expand_container(int error_context,
+						GqServer *server,
+						LDAP *ld,
+						const char *dn,
+						GQTreeWidget *ctree,
+						GQTreeWidgetNode *node)
+{
+#if defined(HAVE_LDAP_CREATE_VLV_CONTROL) && defined(LDAP_CONTROL_VLVREQUEST)
+     gulong total = 0;
+
+     if (server->browse_window <= 0) return FALSE;
+     if (!server_supports_vlv(server, ld)) return FALSE;
+
+     /* only the first child, we are after the content count. Errors
+	(eg. no VLV index for this container) let the caller fall
+	back to a plain search */
+     if (vlv_search(error_context, server, ld, dn, 1, 0,
+		    NULL, NULL, &total) != LDAP_SUCCESS) {
+	  return FALSE;
+     }
+
+     if (total <= (gulong) server->browse_window) return FALSE;
+
+     insert_ranges(ctree, node, dn, 1, total, server->browse_window);
+
+     statusbar_msg(ngettext("%1$lu entry below %2$s",
+			    "%1$lu entries below %2$s", total),
+		   total, dn);
+     return TRUE;
+#else
+     return FALSE;
+#endif
+}
+
+/*
+ * Destructor for GqBrowserNodeRange objects
+ */
+static void destroy_range_browse_entry(GqBrowserNode *e)
+{
+     GqBrowserNodeRange *entry;
+
+     if (!e) return;
+     g_assert(GQ_IS_BROWSER_NODE_RANGE(e));
+     entry = GQ_BROWSER_NODE_RANGE(e);
+
+     g_free(entry->dn);
+     entry->dn = NULL;
+}
+
+static void range_browse_entry_expand(GqBrowserNode *be,
+				      int error_context,
+				      GQTreeWidget *ctree,
+				      GQTreeWidgetNode *node,
+				      GqTab *tab)
+{
+     GqBrowserNodeRange *entry;
+     GqServer *server;
+
+     g_assert(GQ_IS_BROWSER_NODE_RANGE(be));
+     entry = GQ_BROWSER_NODE_RANGE(be);
+
+     if (entry->seen) return;
+
+     server = server_from_node(ctree, node);
+     if (server == NULL) return;
+
+     gq_tree_widget_freeze(ctree);
+     gq_tree_remove_children(ctree, node);
+
+     if (server->browse_window > 0 &&
+	 entry->count > (gulong) server->browse_window) {
+	  /* still too many, just split this range further */
+	  insert_ranges(ctree, node, entry->dn,
+			entry->offset, entry->count, server->browse_window);
+	  entry->seen = TRUE;
+     } else {
+#if defined(HAVE_LDAP_CREATE_VLV_CONTROL) && defined(LDAP_CONTROL_VLVREQUEST)
+	  LDAP *ld;
+	  gulong total;
+
+	  if ((ld = open_connection(error_context, server)) != NULL) {
+	       statusbar_msg(_("Fetching entries %1$lu to %2$lu below %3$s"),
+			     entry->offset,
+			     entry->offset + entry->count - 1,
+			     entry->dn);
+
+	       if (vlv_search(error_context, server, ld, entry->dn,
+			      entry->offset, entry->count - 1,
+			      ctree, node, &total) == LDAP_SUCCESS) {
+		    entry->seen = TRUE;
+		    statusbar_msg(_("Entries %1$lu to %2$lu of about %3$lu"),
+				  entry->offset,
+				  entry->offset + entry->count - 1,
+				  total);
+	       }
+	       close_connection(server, FALSE);
+	  }
+#endif
+     }
+
+     gq_tree_widget_thaw(ctree);
+}
+
+static void range_browse_entry_refresh(GqBrowserNode *entry,
+				       int error_context,
+				       GQTreeWidget *ctree,
+				       GQTreeWidgetNode *node,
+				       GqTab *tab)
+{
+     g_assert(GQ_IS_BROWSER_NODE_RANGE(entry));
+
+     GQ_BROWSER_NODE_RANGE(entry)->seen = FALSE;
+
+     gq_tree_widget_freeze(ctree);
+     gq_tree_fire_expand_callback(ctree, node);
+     gq_tree_widget_thaw(ctree);
+}
+
+static char* range_browse_entry_get_name(GqBrowserNode *entry,
+					 gboolean long_form)
+{
+     GqBrowserNodeRange *r;
+
+     g_assert(GQ_IS_BROWSER_NODE_RANGE(entry));
+     r = GQ_BROWSER_NODE_RANGE(entry);
+
+     if (long_form) {
+	  return g_strdup_printf("%s[%lu-%lu]", r->dn,
+				 r->offset, r->offset + r->count - 1);
+     }
+     return g_strdup_printf(_("[Entries %1$lu to %2$lu]"),
+			    r->offset, r->offset + r->count - 1);
+}
+
+/*
+ * Constructor for GqBrowserNodeRange objects
+ */
+GqBrowserNode*
+gq_browser_node_range_new(const char *dn, gulong offset, gulong count)
+{
+	GqBrowserNodeRange *e = g_object_new(GQ_TYPE_BROWSER_NODE_RANGE, NULL);
+
+	e->dn = g_strdup(dn);
+	e->offset = offset;
+	e->count = count;
+
+	return GQ_BROWSER_NODE(e);
+}
+
+/* GType */
+G_DEFINE_TYPE(GqBrowserNodeRange, gq_browser_node_range, GQ_TYPE_BROWSER_NODE);
+
+static void
+gq_browser_node_range_init(GqBrowserNodeRange* self) {}
+
+static void
+range_finalize(GObject* object)
+{
+	destroy_range_browse_entry(GQ_BROWSER_NODE(object));
+
+	G_OBJECT_CLASS(gq_browser_node_range_parent_class)->finalize(object);
+}
+
+static void
+gq_browser_node_range_class_init(GqBrowserNodeRangeClass* self_class) {
+	GObjectClass* object_class = G_OBJECT_CLASS(self_class);
+	GqBrowserNodeClass* node_class = GQ_BROWSER_NODE_CLASS(self_class);
+
+	object_class->finalize = range_finalize;
+
+	node_class->destroy  = destroy_range_browse_entry;
+	node_class->expand   = range_browse_entry_expand;
+	node_class->refresh  = range_browse_entry_refresh;
+	node_class->get_name = range_browse_entry_get_name;
+}
+
+/*
+   Local Variables:
+   c-basic-offset: 5
+   End:
+ */
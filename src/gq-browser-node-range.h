@@ -0,0 +1,83 @@
+/*
+    GQ -- a GTK-based LDAP client
+    Copyright (C) 1998-2003 Bert Vermeulen
+    Copyright (C) 2002-2003 Peter Stamfest
+
+    This program is released under the Gnu General Public License with
+    the additional exemption that compiling, linking, and/or using
+    OpenSSL is allowed.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef GQ_RANGE_BROWSE_H_INCLUDED
+#define GQ_RANGE_BROWSE_H_INCLUDED
+
+#include "gq-browser-node.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GqBrowserNodeRange   GqBrowserNodeRange;
+typedef GqBrowserNodeClass           GqBrowserNodeRangeClass;
+
+#define GQ_TYPE_BROWSER_NODE_RANGE         (gq_browser_node_range_get_type())
+#define GQ_BROWSER_NODE_RANGE(i)           (G_TYPE_CHECK_INSTANCE_CAST((i), GQ_TYPE_BROWSER_NODE_RANGE, GqBrowserNodeRange))
+#define GQ_BROWSER_NODE_RANGE_CLASS(c)     (G_TYPE_CHECK_CLASS_CAST((c), GQ_TYPE_BROWSER_NODE_RANGE, GqBrowserNodeRangeClass))
+#define GQ_IS_BROWSER_NODE_RANGE(i)        (G_TYPE_CHECK_INSTANCE_TYPE((i), GQ_TYPE_BROWSER_NODE_RANGE))
+#define GQ_IS_BROWSER_NODE_RANGE_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE((c), GQ_TYPE_BROWSER_NODE_RANGE))
+#define GQ_BROWSER_NODE_RANGE_GET_CLASS(i) (G_TYPE_INSTANCE_GET_CLASS((i), GQ_TYPE_BROWSER_NODE_RANGE, GqBrowserNodeRangeClass))
+
+GType gq_browser_node_range_get_type(void);
+
+/* A window onto the children of a large container. The children are
+   sorted by the server (on the search attribute of the server) and
+   a range node stands for the ones at the positions offset to
+   offset + count - 1. They get fetched using the virtual list view
+   control only when the node gets expanded. */
+struct _GqBrowserNodeRange {
+	GqBrowserNode base_instance;
+
+	/* specific */
+	char *dn;		/* the container */
+	gulong offset;		/* VLV position of the first child, 1-based */
+	gulong count;
+	gboolean seen;
+};
+
+GqBrowserNode *gq_browser_node_range_new(const char *dn,
+					 gulong offset, gulong count);
+
+/* Called when expanding the DN node of a container: if the server
+   supports sorting and VLV and the container has more children than
+   the configured window size, range nodes get added below node and
+   TRUE is returned. Otherwise nothing is done and the caller should
+   list the children itself. */
+gboolean gq_browser_node_range_expand_container(int error_context,
+						GqServer *server,
+						LDAP *ld,
+						const char *dn,
+						GQTreeWidget *ctree,
+						GQTreeWidgetNode *node);
+
+G_END_DECLS
+
+#endif
+
+
+/*
+   Local Variables:
+   c-basic-offset: 5
+   End:
+ */
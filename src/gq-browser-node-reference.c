@@ -39,6 +39,7 @@
 
 #include "common.h"
 #include "gq-browser-node-dn.h"
+#include "gq-browser-node-range.h"
 #include "gq-browser-node-server.h"
 
 #include "gq-server-list.h"
@@ -164,16 +165,15 @@ static void ref_browse_entry_expand(GqBrowserNode *be,
 
 
 	       /* find parent server */
-	       GQTreeWidgetRow *row = NULL;
 	       GQTreeWidgetNode *n;
 	       GqBrowserNode *e;
 
-	       n = GQ_TREE_WIDGET_ROW(node)->parent;
-	       for ( ; n ; n = row->parent ) {
-		    row = GQ_TREE_WIDGET_ROW(n);
+	       n = gq_tree_get_parent_node(ctree, node);
+	       for ( ; n ; n = gq_tree_get_parent_node(ctree, n) ) {
 		    e = GQ_BROWSER_NODE(gq_tree_get_node_data (ctree, n));
 
-		    if(!GQ_IS_BROWSER_NODE_DN(e)) {
+		    if(!GQ_IS_BROWSER_NODE_DN(e) &&
+		       !GQ_IS_BROWSER_NODE_RANGE(e)) {
 			    parent = gq_browser_node_get_server(e);
 			    break;
 		    }
@@ -195,7 +195,7 @@ static void ref_browse_entry_expand(GqBrowserNode *be,
 
 	       entry->expanded = TRUE;
 
-	       gtk_clist_freeze(GTK_CLIST(ctree));
+	       gq_tree_widget_freeze(ctree);
 
 	       new_entry = gq_browser_node_dn_new(desc->lud_dn);
 
@@ -213,7 +213,7 @@ static void ref_browse_entry_expand(GqBrowserNode *be,
 	       gq_tree_insert_dummy_node (ctree,
 					  added);
 
-	       gtk_clist_thaw(GTK_CLIST(ctree));
+	       gq_tree_widget_thaw(ctree);
 
 	       ldap_free_urldesc(desc);
 	  }
@@ -241,7 +241,7 @@ static void ref_browse_entry_refresh(GqBrowserNode *entry,
 
      GQ_BROWSER_NODE_REFERENCE(entry)->expanded = 0;
 
-     gtk_clist_freeze(GTK_CLIST(ctree));
+     gq_tree_widget_freeze(ctree);
 
      ref_browse_entry_selected(entry, error_context, ctree, node, tab);
 
@@ -249,7 +249,7 @@ static void ref_browse_entry_refresh(GqBrowserNode *entry,
 
 /*       server_browse_entry_expand(entry, ctree, node, tab); */
 
-     gtk_clist_thaw(GTK_CLIST(ctree));
+     gq_tree_widget_thaw(ctree);
 
 }
 
@@ -97,9 +97,12 @@ static void server_browse_entry_expand(GqBrowserNode *e,
 	  gq_tree_remove_children (ctree, node);
 	  entry->once_expanded = 1;
 
+	  /* drop an "unreachable" mark left by restoring the tabs */
+	  gq_tree_set_node_text(ctree, node, entry->server->name);
+
 	  suffixes = get_suffixes(error_context, entry->server);
 
-	  gtk_clist_freeze(GTK_CLIST(ctree));
+	  gq_tree_widget_freeze(ctree);
 
 	  for (next = suffixes ; next ; next = g_list_next(next) ) {
 	       add_suffix(entry, ctree, node, next->data);
@@ -107,7 +110,7 @@ static void server_browse_entry_expand(GqBrowserNode *e,
 	       next->data = NULL;
 	  }
 
-	  gtk_clist_thaw(GTK_CLIST(ctree));
+	  gq_tree_widget_thaw(ctree);
 
 	  g_list_free(suffixes);
      }
@@ -485,7 +488,7 @@ static void server_browse_entry_refresh(GqBrowserNode *e,
 
      entry->once_expanded = 0;
 
-     gtk_clist_freeze(GTK_CLIST(ctree));
+     gq_tree_widget_freeze(ctree);
 
      server_browse_entry_selected(e, error_context, ctree, node, tab);
 
@@ -493,7 +496,7 @@ static void server_browse_entry_refresh(GqBrowserNode *e,
 
 /*       server_browse_entry_expand(entry, ctree, node, tab); */
 
-     gtk_clist_thaw(GTK_CLIST(ctree));
+     gq_tree_widget_thaw(ctree);
 
 }
 
@@ -0,0 +1,1477 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gq-compare.h"
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+
+#include "errorchain.h"
+#include "formfill.h"		/* isInternalAttr */
+#include "gq-progress.h"
+#include "gq-server-list.h"
+#include "gq-server-stats.h"
+#include "input.h"		/* CONTAINER_BORDER_WIDTH */
+#include "ldif.h"
+#include "util.h"
+
+/* the records of a side are kept in memory up to about this size,
+   then they get sorted and written to a temporary file as a run */
+#define RUN_SIZE		(16 * 1024 * 1024)
+
+/* LDIF gets written to the file in chunks of about this size */
+#define WRITE_CHUNK		(64 * 1024)
+
+/* how long (in ms) to wait for answers before looking again */
+#define POLL_INTERVAL		1000
+
+/* how many messages to take from a search before looking at the
+   other one */
+#define MESSAGES_PER_TURN	64
+
+/* how many differences the dialog shows, and how long a value may be
+   to get shown as it is */
+#define COMPARE_VIEW_LIMIT	2000
+#define VIEW_VALUE_MAX		200
+
+/* ends every RDN of a key. Sorting below anything an RDN may contain
+   (the string form escapes control characters), it puts the subtree
+   of an entry right after it. */
+#define KEY_SEPARATOR		'\001'
+
+/* A record is an entry in a single block of memory, the same in
+   memory and in the runs:
+
+	guint32 size		of the whole record
+	key			NUL-terminated
+	rel			the DN relative to the base, NUL-terminated
+	guint32 n_attrs
+	n_attrs times:
+	  name			NUL-terminated
+	  guint32 n_values
+	  n_values times:
+	    guint32 length
+	    value
+
+   The key is the relative DN with its RDNs reversed and case folded.
+   Attributes are sorted by name, case-insensitively, the values of
+   each one bytewise. Numbers are in host byte order, runs never leave
+   this machine. */
+
+typedef struct {
+	const gchar *name;
+	guint32 n_values;
+	const guchar *values;	/* the length of the first one */
+} AttrView;
+
+struct cursor {
+	FILE *fp;
+	guchar *record;		/* the next one of the run */
+};
+
+struct side {
+	GqServer *server;
+	const gchar *base;
+	int base_rdns;
+	LDAP *ld;
+	int msgid;		/* of the search, -1 when it is over */
+	gdouble start;
+	int n_entries;
+
+	GPtrArray *records;	/* not in a run yet */
+	gsize size;		/* what they take */
+	GPtrArray *runs;	/* FILE *, each one sorted */
+
+	/* reading them back in order */
+	guint next;		/* in records, if there are no runs */
+	struct cursor *heap;
+	guint heap_len;
+};
+
+struct compare {
+	int ctx;
+	gboolean ok;
+	GHashTable *ignore;	/* lower case names */
+	struct side a, b;
+	GqProgress *progress;
+
+	GString *rec;		/* the record being built */
+	GArray *attrs;		/* and its attributes */
+	GString *dn;
+	GString *mods;		/* the differences of one entry */
+
+	GqExportFile *file;
+	GString *out;		/* on its way to file */
+	FILE *deletes;		/* DNs, each followed by its length */
+
+	GString *view;
+	gint view_limit;
+	gint shown;
+
+	GqCompareCount *count;
+};
+
+struct build_attr {
+	char *name;
+	struct berval **vals;
+	guint32 n_values;
+};
+
+static guint32
+get_u32(const guchar *p)
+{
+	guint32 v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static void
+put_u32(GString *s, guint32 v)
+{
+	g_string_append_len(s, (const gchar *) &v, sizeof(v));
+}
+
+static const gchar *
+record_key(const guchar *r)
+{
+	return (const gchar *) r + sizeof(guint32);
+}
+
+static const gchar *
+record_rel(const guchar *r)
+{
+	const gchar *key = record_key(r);
+	return key + strlen(key) + 1;
+}
+
+/* the first attribute */
+static const guchar *
+record_attrs(const guchar *r, guint32 *n_attrs)
+{
+	const gchar *rel = record_rel(r);
+	const guchar *p = (const guchar *) rel + strlen(rel) + 1;
+
+	*n_attrs = get_u32(p);
+	return p + sizeof(guint32);
+}
+
+/* fills in a from the attribute at p, returns the one after it */
+static const guchar *
+read_attr(const guchar *p, AttrView *a)
+{
+	guint32 i;
+
+	a->name = (const gchar *) p;
+	p += strlen(a->name) + 1;
+	a->n_values = get_u32(p);
+	p += sizeof(guint32);
+	a->values = p;
+	for (i = 0 ; i < a->n_values ; i++) {
+		p += sizeof(guint32) + get_u32(p);
+	}
+	return p;
+}
+
+static int
+compare_bytes(const guchar *a, guint32 la, const guchar *b, guint32 lb)
+{
+	int c = memcmp(a, b, MIN(la, lb));
+
+	if (c != 0) return c;
+	return la < lb ? -1 : la > lb;
+}
+
+static int
+compare_records(gconstpointer a, gconstpointer b)
+{
+	return strcmp(record_key(*(guchar * const *) a),
+		      record_key(*(guchar * const *) b));
+}
+
+static int
+compare_build_attrs(const void *a, const void *b)
+{
+	return g_ascii_strcasecmp(((const struct build_attr *) a)->name,
+				  ((const struct build_attr *) b)->name);
+}
+
+static int
+compare_bervals(const void *a, const void *b)
+{
+	const struct berval *x = *(struct berval * const *) a;
+	const struct berval *y = *(struct berval * const *) b;
+
+	return compare_bytes((const guchar *) x->bv_val, x->bv_len,
+			     (const guchar *) y->bv_val, y->bv_len);
+}
+
+static void
+temp_file_failed(struct compare *cmp)
+{
+	if (cmp->ok) {
+		error_push(cmp->ctx,
+			   _("Could not use a temporary file: %s"),
+			   strerror(errno));
+	}
+	cmp->ok = FALSE;
+}
+
+/* Searching */
+
+static void
+search_failed(struct compare *cmp, struct side *side, int rc)
+{
+	GqServer *server = side->server;
+
+	if (rc == LDAP_SERVER_DOWN) {
+		server->server_down++;
+		error_push(cmp->ctx,
+			   _("Server '%s' down. Nothing was compared."),
+			   server->name);
+	} else {
+		error_push(cmp->ctx,
+			   _("LDAP error while searching below '%1$s' on '%2$s'."
+			     " Nothing was compared."),
+			   side->base, server->name);
+	}
+	push_ldap_addl_error(side->ld, cmp->ctx);
+	cmp->ok = FALSE;
+}
+
+static gboolean
+send_search(struct compare *cmp, struct side *side)
+{
+	LDAPControl ct;
+	LDAPControl *ctrls[2] = { NULL, NULL };
+	char *attrs[] = {
+		LDAP_ALL_USER_ATTRIBUTES,
+		"ref",
+		NULL
+	};
+	int rc;
+
+	/* referrals get compared as the entries they are */
+	ct.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+	ct.ldctl_value.bv_val	= NULL;
+	ct.ldctl_value.bv_len	= 0;
+	ct.ldctl_iscritical	= 0;
+	ctrls[0] = &ct;
+
+	side->start = gq_server_stats_start();
+	rc = ldap_search_ext(side->ld, side->base, LDAP_SCOPE_SUBTREE,
+			     "(objectClass=*)", attrs, 0, ctrls, NULL, NULL,
+			     LDAP_NO_LIMIT, &side->msgid);
+	if (rc != LDAP_SUCCESS) {
+		side->msgid = -1;
+		search_failed(cmp, side, rc);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* appends the key and the relative DN of dn to the record. FALSE if
+   dn is not below the base of side. */
+static gboolean
+add_key(struct compare *cmp, struct side *side, const char *dn)
+{
+	char **rdns = gq_ldap_explode_dn(dn, 0);
+	int n, i;
+
+	if (rdns == NULL) return FALSE;
+
+	for (n = 0 ; rdns[n] ; n++)
+		;
+	n -= side->base_rdns;
+	if (n < 0) {
+		gq_exploded_free(rdns);
+		return FALSE;
+	}
+
+	for (i = n - 1 ; i >= 0 ; i--) {
+		gchar *folded = g_utf8_validate(rdns[i], -1, NULL) ?
+			g_utf8_casefold(rdns[i], -1) :
+			g_ascii_strdown(rdns[i], -1);
+		g_string_append(cmp->rec, folded);
+		g_string_append_c(cmp->rec, KEY_SEPARATOR);
+		g_free(folded);
+	}
+	g_string_append_c(cmp->rec, '\0');
+
+	for (i = 0 ; i < n ; i++) {
+		if (i > 0) g_string_append_c(cmp->rec, ',');
+		g_string_append(cmp->rec, rdns[i]);
+	}
+	g_string_append_c(cmp->rec, '\0');
+
+	gq_exploded_free(rdns);
+	return TRUE;
+}
+
+static gboolean
+ignored(struct compare *cmp, const char *attr)
+{
+	gchar *name;
+	gboolean found;
+
+	if (isInternalAttr(attr)) return TRUE;
+	if (g_hash_table_size(cmp->ignore) == 0) return FALSE;
+
+	/* without options */
+	name = g_ascii_strdown(attr, strcspn(attr, ";"));
+	found = g_hash_table_lookup(cmp->ignore, name) != NULL;
+	g_free(name);
+
+	return found;
+}
+
+/* sorts the records of side and writes them to a new run */
+static gboolean
+write_run(struct compare *cmp, struct side *side)
+{
+	FILE *fp;
+	guint i;
+
+	g_ptr_array_sort(side->records, compare_records);
+
+	fp = tmpfile();
+	if (fp == NULL) {
+		temp_file_failed(cmp);
+		return FALSE;
+	}
+	g_ptr_array_add(side->runs, fp);
+
+	for (i = 0 ; i < side->records->len ; i++) {
+		guchar *r = g_ptr_array_index(side->records, i);
+		if (cmp->ok && fwrite(r, get_u32(r), 1, fp) != 1) {
+			temp_file_failed(cmp);
+		}
+		g_free(r);
+	}
+	g_ptr_array_set_size(side->records, 0);
+	side->size = 0;
+
+	if (cmp->ok && fflush(fp) != 0) temp_file_failed(cmp);
+	return cmp->ok;
+}
+
+static gboolean
+take_entry(struct compare *cmp, struct side *side, LDAPMessage *e)
+{
+	GString *rec = cmp->rec;
+	BerElement *ber = NULL;
+	struct build_attr *a;
+	char *dn, *attr;
+	guint32 i, size;
+
+	dn = ldap_get_dn(side->ld, e);
+	if (dn == NULL) {
+		error_push(cmp->ctx, _("Cannot retrieve DN of entry."));
+		push_ldap_addl_error(side->ld, cmp->ctx);
+		cmp->ok = FALSE;
+		return FALSE;
+	}
+
+	g_string_truncate(rec, 0);
+	put_u32(rec, 0);
+	if (!add_key(cmp, side, dn)) {
+		/* cannot be matched up, and should not be there anyway */
+		ldap_memfree(dn);
+		return TRUE;
+	}
+	ldap_memfree(dn);
+
+	g_array_set_size(cmp->attrs, 0);
+	for (attr = ldap_first_attribute(side->ld, e, &ber) ; attr != NULL ;
+	     attr = ldap_next_attribute(side->ld, e, ber)) {
+		struct build_attr b;
+
+		b.vals = ignored(cmp, attr) ? NULL :
+			ldap_get_values_len(side->ld, e, attr);
+		if (b.vals == NULL || b.vals[0] == NULL) {
+			if (b.vals) ldap_value_free_len(b.vals);
+			ldap_memfree(attr);
+			continue;
+		}
+		b.name = attr;
+		for (b.n_values = 0 ; b.vals[b.n_values] ; b.n_values++)
+			;
+		g_array_append_val(cmp->attrs, b);
+	}
+#ifndef HAVE_OPENLDAP12
+	if (ber) ber_free(ber, 0);
+#endif
+
+	qsort(cmp->attrs->data, cmp->attrs->len, sizeof(struct build_attr),
+	      compare_build_attrs);
+
+	put_u32(rec, cmp->attrs->len);
+	for (a = (struct build_attr *) cmp->attrs->data ;
+	     a < (struct build_attr *) cmp->attrs->data + cmp->attrs->len ;
+	     a++) {
+		g_string_append_len(rec, a->name, strlen(a->name) + 1);
+		put_u32(rec, a->n_values);
+
+		qsort(a->vals, a->n_values, sizeof(struct berval *),
+		      compare_bervals);
+		for (i = 0 ; i < a->n_values ; i++) {
+			put_u32(rec, a->vals[i]->bv_len);
+			g_string_append_len(rec, a->vals[i]->bv_val,
+					    a->vals[i]->bv_len);
+		}
+
+		ldap_value_free_len(a->vals);
+		ldap_memfree(a->name);
+	}
+
+	size = rec->len;
+	memcpy(rec->str, &size, sizeof(size));
+	g_ptr_array_add(side->records, g_memdup(rec->str, rec->len));
+	side->size += rec->len + sizeof(gpointer);
+	side->n_entries++;
+
+	if (side->size >= RUN_SIZE) return write_run(cmp, side);
+	return TRUE;
+}
+
+/* takes what has arrived for the search of side */
+static gboolean
+poll_side(struct compare *cmp, struct side *side, gboolean *progress)
+{
+	struct timeval nowait = { 0, 0 };
+	LDAPMessage *res, *e;
+	int i, n, rc, err;
+
+	for (i = 0 ; i < MESSAGES_PER_TURN ; i++) {
+		res = NULL;
+		rc = ldap_result(side->ld, side->msgid, LDAP_MSG_ONE,
+				 &nowait, &res);
+		if (rc == 0) break;
+
+		*progress = TRUE;
+
+		if (rc == -1) {
+			ldap_get_option(side->ld, LDAP_OPT_ERROR_NUMBER, &rc);
+			if (rc == LDAP_SUCCESS) rc = LDAP_OTHER;
+			side->msgid = -1;
+			gq_server_stats_stop(side->server, GQ_STAT_SEARCH,
+					     side->start, FALSE);
+			search_failed(cmp, side, rc);
+			return FALSE;
+		}
+
+		if (rc == LDAP_RES_SEARCH_RESULT) {
+			if (ldap_parse_result(side->ld, res, &err, NULL, NULL,
+					      NULL, NULL, 1) != LDAP_SUCCESS) {
+				err = LDAP_OTHER;
+			}
+			side->msgid = -1;
+			gq_server_stats_stop(side->server, GQ_STAT_SEARCH,
+					     side->start, err == LDAP_SUCCESS);
+			gq_server_stats_entries(side->server, side->n_entries);
+
+			/* a partial subtree would make up differences,
+			   size limits included */
+			if (err != LDAP_SUCCESS) {
+				search_failed(cmp, side, err);
+				return FALSE;
+			}
+			return TRUE;
+		}
+
+		/* references get skipped, with ManageDSAit there should
+		   not be any */
+		n = 0;
+		for (e = ldap_first_entry(side->ld, res) ; e ;
+		     e = ldap_next_entry(side->ld, e)) {
+			if (!take_entry(cmp, side, e)) break;
+			n++;
+		}
+		ldap_msgfree(res);
+		gq_progress_add(cmp->progress, n);
+
+		if (!cmp->ok) return FALSE;
+	}
+	return TRUE;
+}
+
+/* sleeps until one of the searches has something to read */
+static void
+wait_for_answers(struct compare *cmp)
+{
+	struct side *sides[2];
+	struct pollfd fds[2];
+	int i, nfds = 0;
+
+	sides[0] = &cmp->a;
+	sides[1] = &cmp->b;
+
+	for (i = 0 ; i < 2 ; i++) {
+		if (sides[i]->msgid < 0) continue;
+		if (ldap_get_option(sides[i]->ld, LDAP_OPT_DESC,
+				    &fds[nfds].fd) != LDAP_OPT_SUCCESS) {
+			continue;
+		}
+		fds[nfds].events = POLLIN;
+		fds[nfds].revents = 0;
+		nfds++;
+	}
+	if (nfds > 0) poll(fds, nfds, POLL_INTERVAL);
+}
+
+/* Reading the sides back in order */
+
+/* the next record of a run, NULL at its end */
+static guchar *
+read_record(struct compare *cmp, FILE *fp)
+{
+	guint32 size;
+	guchar *r;
+
+	if (fread(&size, sizeof(size), 1, fp) != 1) {
+		if (ferror(fp)) temp_file_failed(cmp);
+		return NULL;
+	}
+	if (size <= sizeof(size)) {
+		errno = EINVAL;
+		temp_file_failed(cmp);
+		return NULL;
+	}
+
+	r = g_malloc(size);
+	memcpy(r, &size, sizeof(size));
+	if (fread(r + sizeof(size), size - sizeof(size), 1, fp) != 1) {
+		if (!ferror(fp)) errno = EINVAL;
+		temp_file_failed(cmp);
+		g_free(r);
+		return NULL;
+	}
+	return r;
+}
+
+static void
+sift_down(struct cursor *heap, guint n, guint i)
+{
+	struct cursor c = heap[i];
+	guint child;
+
+	while ((child = 2 * i + 1) < n) {
+		if (child + 1 < n &&
+		    strcmp(record_key(heap[child + 1].record),
+			   record_key(heap[child].record)) < 0) {
+			child++;
+		}
+		if (strcmp(record_key(heap[child].record),
+			   record_key(c.record)) >= 0) {
+			break;
+		}
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = c;
+}
+
+static gboolean
+start_reading(struct compare *cmp, struct side *side)
+{
+	guint i;
+
+	if (side->runs->len == 0) {
+		g_ptr_array_sort(side->records, compare_records);
+		side->next = 0;
+		return TRUE;
+	}
+
+	if (side->records->len > 0 && !write_run(cmp, side)) return FALSE;
+
+	side->heap = g_new(struct cursor, side->runs->len);
+	for (i = 0 ; i < side->runs->len ; i++) {
+		FILE *fp = g_ptr_array_index(side->runs, i);
+
+		rewind(fp);
+		side->heap[side->heap_len].fp = fp;
+		side->heap[side->heap_len].record = read_record(cmp, fp);
+		if (side->heap[side->heap_len].record) side->heap_len++;
+	}
+	for (i = side->heap_len / 2 ; i > 0 ; i--) {
+		sift_down(side->heap, side->heap_len, i - 1);
+	}
+	return cmp->ok;
+}
+
+/* the next record of side in key order (to be g_free'd), NULL at the
+   end */
+static guchar *
+next_record(struct compare *cmp, struct side *side)
+{
+	guchar *r;
+
+	if (side->heap == NULL) {
+		if (side->next >= side->records->len) return NULL;
+		r = g_ptr_array_index(side->records, side->next);
+		g_ptr_array_index(side->records, side->next) = NULL;
+		side->next++;
+		return r;
+	}
+
+	if (side->heap_len == 0) return NULL;
+
+	r = side->heap[0].record;
+	side->heap[0].record = read_record(cmp, side->heap[0].fp);
+	if (side->heap[0].record == NULL) {
+		side->heap[0] = side->heap[--side->heap_len];
+	}
+	if (side->heap_len > 0) sift_down(side->heap, side->heap_len, 0);
+
+	return r;
+}
+
+static void
+free_side(struct side *side)
+{
+	guint i;
+
+	if (side->records) {
+		g_ptr_array_foreach(side->records, (GFunc) g_free, NULL);
+		g_ptr_array_free(side->records, TRUE);
+	}
+	if (side->runs) {
+		g_ptr_array_foreach(side->runs, (GFunc) fclose, NULL);
+		g_ptr_array_free(side->runs, TRUE);
+	}
+	for (i = 0 ; i < side->heap_len ; i++) {
+		g_free(side->heap[i].record);
+	}
+	g_free(side->heap);
+}
+
+/* Differences */
+
+/* whether there is room in the view for another difference */
+static gboolean
+to_view(struct compare *cmp)
+{
+	if (cmp->shown >= cmp->view_limit) return FALSE;
+	cmp->shown++;
+	return TRUE;
+}
+
+/* the DN of r on this side */
+static void
+make_dn(struct compare *cmp, const guchar *r)
+{
+	const gchar *rel = record_rel(r);
+
+	g_string_assign(cmp->dn, rel);
+	if (*rel && *cmp->a.base) g_string_append_c(cmp->dn, ',');
+	g_string_append(cmp->dn, cmp->a.base);
+}
+
+static void
+dn_out(struct compare *cmp, const gchar *changetype)
+{
+	ldif_line_out(cmp->out, "dn", cmp->dn->str, cmp->dn->len, cmp->ctx);
+	g_string_append_printf(cmp->out, "\nchangetype: %s\n", changetype);
+}
+
+/* one value, as LDIF or a line of the view */
+static void
+value_out(struct compare *cmp, GString *to, const gchar *sign,
+	  const gchar *name, const guchar *data, guint32 len)
+{
+	if (cmp->file) {
+		ldif_line_out(to, (char *) name, (char *) data, len, cmp->ctx);
+		g_string_append_c(to, '\n');
+		return;
+	}
+
+	g_string_append_printf(to, "    %s %s: ", sign, name);
+	if (len <= VIEW_VALUE_MAX &&
+	    g_utf8_validate((const gchar *) data, len, NULL) &&
+	    memchr(data, '\n', len) == NULL) {
+		g_string_append_len(to, (const gchar *) data, len);
+	} else {
+		g_string_append_printf(to, ngettext("(%d byte)",
+						    "(%d bytes)", len),
+				       (int) len);
+	}
+	g_string_append_c(to, '\n');
+}
+
+static void
+all_values_out(struct compare *cmp, GString *to, const gchar *sign,
+	       const AttrView *a)
+{
+	const guchar *p = a->values;
+	guint32 i, len;
+
+	for (i = 0 ; i < a->n_values ; i++) {
+		len = get_u32(p);
+		value_out(cmp, to, sign, a->name, p + sizeof(guint32), len);
+		p += sizeof(guint32) + len;
+	}
+}
+
+/* walks the sorted values of x and y side by side, counting the ones
+   only in x (deleted) and only in y (added), writing them to to if
+   asked to */
+static void
+diff_values(struct compare *cmp, GString *to,
+	    const AttrView *x, const AttrView *y,
+	    guint *n_deleted, guint *n_added,
+	    gboolean show_deleted, gboolean show_added)
+{
+	const guchar *p = x->values, *q = y->values;
+	guint32 i = 0, j = 0, lp = 0, lq = 0;
+	int c;
+
+	*n_deleted = *n_added = 0;
+
+	while (i < x->n_values || j < y->n_values) {
+		if (i < x->n_values) lp = get_u32(p);
+		if (j < y->n_values) lq = get_u32(q);
+
+		if (i >= x->n_values) {
+			c = 1;
+		} else if (j >= y->n_values) {
+			c = -1;
+		} else {
+			c = compare_bytes(p + sizeof(guint32), lp,
+					  q + sizeof(guint32), lq);
+		}
+
+		if (c < 0) {
+			(*n_deleted)++;
+			if (show_deleted) {
+				value_out(cmp, to, "-", x->name,
+					  p + sizeof(guint32), lp);
+			}
+		} else if (c > 0) {
+			(*n_added)++;
+			if (show_added) {
+				value_out(cmp, to, "+", y->name,
+					  q + sizeof(guint32), lq);
+			}
+		}
+
+		if (c <= 0) {
+			p += sizeof(guint32) + lp;
+			i++;
+		}
+		if (c >= 0) {
+			q += sizeof(guint32) + lq;
+			j++;
+		}
+	}
+}
+
+/* the rules of formdiff_to_ldapmod(): values both deleted and added
+   make a replace, otherwise the ones deleted or added get deleted or
+   added */
+static void
+attr_changed(struct compare *cmp, const AttrView *x, const AttrView *y)
+{
+	GString *to = cmp->mods;
+	guint deleted, added;
+
+	diff_values(cmp, NULL, x, y, &deleted, &added, FALSE, FALSE);
+	if (deleted == 0 && added == 0) return;
+
+	if (cmp->file == NULL) {
+		diff_values(cmp, to, x, y, &deleted, &added, TRUE, TRUE);
+		return;
+	}
+
+	if (deleted && added) {
+		g_string_append_printf(to, "replace: %s\n", y->name);
+		all_values_out(cmp, to, "+", y);
+	} else if (deleted) {
+		g_string_append_printf(to, "delete: %s\n", x->name);
+		diff_values(cmp, to, x, y, &deleted, &added, TRUE, FALSE);
+	} else {
+		g_string_append_printf(to, "add: %s\n", y->name);
+		diff_values(cmp, to, x, y, &deleted, &added, FALSE, TRUE);
+	}
+	g_string_append(to, "-\n");
+}
+
+static void
+attr_deleted(struct compare *cmp, const AttrView *x)
+{
+	if (cmp->file) {
+		g_string_append_printf(cmp->mods, "delete: %s\n-\n", x->name);
+	} else {
+		all_values_out(cmp, cmp->mods, "-", x);
+	}
+}
+
+static void
+attr_added(struct compare *cmp, const AttrView *y)
+{
+	if (cmp->file) {
+		g_string_append_printf(cmp->mods, "add: %s\n", y->name);
+		all_values_out(cmp, cmp->mods, "+", y);
+		g_string_append(cmp->mods, "-\n");
+	} else {
+		all_values_out(cmp, cmp->mods, "+", y);
+	}
+}
+
+/* an entry in both subtrees */
+static void
+entry_in_both(struct compare *cmp, const guchar *ra, const guchar *rb)
+{
+	const guchar *p, *q, *next_p = NULL, *next_q = NULL;
+	guint32 na, nb, i = 0, j = 0;
+	AttrView x, y;
+	int c;
+
+	g_string_truncate(cmp->mods, 0);
+
+	p = record_attrs(ra, &na);
+	q = record_attrs(rb, &nb);
+	if (na > 0) next_p = read_attr(p, &x);
+	if (nb > 0) next_q = read_attr(q, &y);
+
+	while (i < na || j < nb) {
+		if (i >= na) {
+			c = 1;
+		} else if (j >= nb) {
+			c = -1;
+		} else {
+			c = g_ascii_strcasecmp(x.name, y.name);
+		}
+
+		if (c < 0) {
+			attr_deleted(cmp, &x);
+		} else if (c > 0) {
+			attr_added(cmp, &y);
+		} else {
+			attr_changed(cmp, &x, &y);
+		}
+
+		if (c <= 0 && ++i < na) next_p = read_attr(next_p, &x);
+		if (c >= 0 && ++j < nb) next_q = read_attr(next_q, &y);
+	}
+
+	if (cmp->mods->len == 0) {
+		cmp->count->same++;
+		return;
+	}
+	cmp->count->changed++;
+
+	make_dn(cmp, ra);
+	if (cmp->file) {
+		dn_out(cmp, "modify");
+		g_string_append_len(cmp->out, cmp->mods->str, cmp->mods->len);
+		g_string_append_c(cmp->out, '\n');
+	} else if (to_view(cmp)) {
+		g_string_append_printf(cmp->view, "~ %s\n", cmp->dn->str);
+		g_string_append_len(cmp->view, cmp->mods->str, cmp->mods->len);
+	}
+}
+
+/* an entry only in the other subtree */
+static void
+entry_added(struct compare *cmp, const guchar *rb)
+{
+	const guchar *p;
+	guint32 n, i;
+	AttrView y;
+
+	cmp->count->added++;
+
+	make_dn(cmp, rb);
+	if (cmp->file) {
+		dn_out(cmp, "add");
+		p = record_attrs(rb, &n);
+		for (i = 0 ; i < n ; i++) {
+			p = read_attr(p, &y);
+			all_values_out(cmp, cmp->out, "+", &y);
+		}
+		g_string_append_c(cmp->out, '\n');
+	} else if (to_view(cmp)) {
+		g_string_append_printf(cmp->view, "+ %s\n", cmp->dn->str);
+	}
+}
+
+/* an entry only in this subtree. Deleting has to wait until the end,
+   when its children are gone. */
+static void
+entry_missing(struct compare *cmp, const guchar *ra)
+{
+	guint32 len;
+
+	cmp->count->missing++;
+
+	make_dn(cmp, ra);
+	if (cmp->file) {
+		if (cmp->deletes == NULL && (cmp->deletes = tmpfile()) == NULL) {
+			temp_file_failed(cmp);
+			return;
+		}
+		len = cmp->dn->len;
+		if (fwrite(cmp->dn->str, 1, len, cmp->deletes) != len ||
+		    fwrite(&len, sizeof(len), 1, cmp->deletes) != 1) {
+			temp_file_failed(cmp);
+		}
+	} else if (to_view(cmp)) {
+		g_string_append_printf(cmp->view, "- %s\n", cmp->dn->str);
+	}
+}
+
+static gboolean
+flush_out(struct compare *cmp, gsize at_least)
+{
+	if (cmp->out->len >= at_least &&
+	    !gq_export_file_write(cmp->file, cmp->out)) {
+		cmp->ok = FALSE;
+	}
+	return cmp->ok;
+}
+
+/* the deletes, read back to front: children first */
+static void
+deletes_out(struct compare *cmp)
+{
+	FILE *fp = cmp->deletes;
+	guint32 len;
+	off_t pos;
+
+	if (fseeko(fp, 0, SEEK_END) != 0 || (pos = ftello(fp)) < 0) {
+		temp_file_failed(cmp);
+		return;
+	}
+
+	while (cmp->ok && pos > 0) {
+		if (pos < (off_t) sizeof(len) ||
+		    fseeko(fp, pos - sizeof(len), SEEK_SET) != 0 ||
+		    fread(&len, sizeof(len), 1, fp) != 1 ||
+		    (pos -= sizeof(len) + len) < 0 ||
+		    fseeko(fp, pos, SEEK_SET) != 0) {
+			temp_file_failed(cmp);
+			return;
+		}
+
+		g_string_set_size(cmp->dn, len);
+		if (len > 0 && fread(cmp->dn->str, len, 1, fp) != 1) {
+			temp_file_failed(cmp);
+			return;
+		}
+
+		dn_out(cmp, "delete");
+		g_string_append_c(cmp->out, '\n');
+		flush_out(cmp, WRITE_CHUNK);
+	}
+}
+
+static void
+merge_diff(struct compare *cmp)
+{
+	guchar *ra, *rb;
+	int c;
+
+	ra = next_record(cmp, &cmp->a);
+	rb = next_record(cmp, &cmp->b);
+
+	while (cmp->ok && (ra || rb)) {
+		if (ra == NULL) {
+			c = 1;
+		} else if (rb == NULL) {
+			c = -1;
+		} else {
+			c = strcmp(record_key(ra), record_key(rb));
+		}
+
+		if (c < 0) {
+			entry_missing(cmp, ra);
+		} else if (c > 0) {
+			entry_added(cmp, rb);
+		} else {
+			entry_in_both(cmp, ra, rb);
+		}
+
+		if (c <= 0) {
+			g_free(ra);
+			ra = next_record(cmp, &cmp->a);
+		}
+		if (c >= 0) {
+			g_free(rb);
+			rb = next_record(cmp, &cmp->b);
+		}
+
+		if (cmp->file) flush_out(cmp, WRITE_CHUNK);
+	}
+	g_free(ra);
+	g_free(rb);
+
+	if (cmp->ok && cmp->deletes) deletes_out(cmp);
+	if (cmp->ok && cmp->file) flush_out(cmp, 0);
+}
+
+static void
+init_side(struct side *side, GqServer *server, const gchar *base)
+{
+	char **rdns;
+
+	side->server = server;
+	side->base = base;
+	side->msgid = -1;
+	side->records = g_ptr_array_new();
+	side->runs = g_ptr_array_new();
+
+	/* NULL for the empty DN */
+	rdns = gq_ldap_explode_dn(base, 0);
+	for (side->base_rdns = 0 ; rdns && rdns[side->base_rdns] ;
+	     side->base_rdns++)
+		;
+	if (rdns) gq_exploded_free(rdns);
+}
+
+gboolean
+gq_compare_subtrees(int error_context,
+		    GqServer *server, const gchar *base,
+		    GqServer *other_server, const gchar *other_base,
+		    gchar **ignore,
+		    GqExportFile *file, GString *view, gint view_limit,
+		    GqCompareCount *count)
+{
+	struct compare cmp;
+	gboolean opened_a = FALSE, opened_b = FALSE;
+	gchar **i;
+
+	g_return_val_if_fail(server != NULL, FALSE);
+	g_return_val_if_fail(base != NULL, FALSE);
+	g_return_val_if_fail(other_server != NULL, FALSE);
+	g_return_val_if_fail(other_base != NULL, FALSE);
+	g_return_val_if_fail(file != NULL || view != NULL, FALSE);
+	g_return_val_if_fail(count != NULL, FALSE);
+
+	memset(count, 0, sizeof(*count));
+
+	memset(&cmp, 0, sizeof(cmp));
+	cmp.ctx = error_context;
+	cmp.ok = TRUE;
+	cmp.ignore = g_hash_table_new_full(g_str_hash, g_str_equal,
+					   g_free, NULL);
+	for (i = ignore ; i && *i ; i++) {
+		gchar *name;
+
+		if (**i == 0) continue;
+		name = g_ascii_strdown(*i, strcspn(*i, ";"));
+		g_hash_table_insert(cmp.ignore, name, name);
+	}
+	cmp.rec = g_string_sized_new(4096);
+	cmp.attrs = g_array_new(FALSE, FALSE, sizeof(struct build_attr));
+	cmp.dn = g_string_new(NULL);
+	cmp.mods = g_string_new(NULL);
+	cmp.file = file;
+	cmp.view = file ? NULL : view;
+	cmp.view_limit = view_limit;
+	cmp.count = count;
+
+	init_side(&cmp.a, server, base);
+	init_side(&cmp.b, other_server, other_base);
+
+	/* on the same server both searches share its connection */
+	if ((cmp.a.ld = open_connection(error_context, server)) == NULL) {
+		cmp.ok = FALSE;
+		goto done;
+	}
+	opened_a = TRUE;
+	if ((cmp.b.ld = open_connection(error_context, other_server)) == NULL) {
+		cmp.ok = FALSE;
+		goto done;
+	}
+	opened_b = TRUE;
+
+	statusbar_msg(_("Comparing %1$s on %2$s with %3$s on %4$s"),
+		      base, server->name, other_base, other_server->name);
+	cmp.progress = gq_progress_new(_("Comparing subtrees"), 0);
+
+	if (!send_search(&cmp, &cmp.a) || !send_search(&cmp, &cmp.b)) {
+		goto done;
+	}
+
+	while (cmp.ok && (cmp.a.msgid >= 0 || cmp.b.msgid >= 0)) {
+		gboolean progress = FALSE;
+
+		if (cmp.a.msgid >= 0) poll_side(&cmp, &cmp.a, &progress);
+		if (cmp.ok && cmp.b.msgid >= 0) {
+			poll_side(&cmp, &cmp.b, &progress);
+		}
+		if (cmp.ok && !progress) wait_for_answers(&cmp);
+	}
+	if (!cmp.ok) goto done;
+
+	if (!start_reading(&cmp, &cmp.a) || !start_reading(&cmp, &cmp.b)) {
+		goto done;
+	}
+
+	if (file) {
+		GList *header = NULL;
+		struct dn_on_server *dos;
+
+		cmp.out = g_string_sized_new(WRITE_CHUNK + 4096);
+
+		dos = new_dn_on_server(base, server);
+		dos->flags = LDAP_SCOPE_SUBTREE;
+		header = g_list_append(header, dos);
+		dos = new_dn_on_server(other_base, other_server);
+		dos->flags = LDAP_SCOPE_SUBTREE;
+		header = g_list_append(header, dos);
+
+		prepend_ldif_header(cmp.out, header);
+		g_list_foreach(header, (GFunc) free_dn_on_server, NULL);
+		g_list_free(header);
+	}
+
+	merge_diff(&cmp);
+
+ done:
+	if (cmp.a.msgid >= 0) ldap_abandon(cmp.a.ld, cmp.a.msgid);
+	if (cmp.b.msgid >= 0) ldap_abandon(cmp.b.ld, cmp.b.msgid);
+	if (opened_b) close_connection(other_server, FALSE);
+	if (opened_a) close_connection(server, FALSE);
+
+	gq_progress_finish(cmp.progress);
+
+	free_side(&cmp.a);
+	free_side(&cmp.b);
+	if (cmp.deletes) fclose(cmp.deletes);
+	if (cmp.out) g_string_free(cmp.out, TRUE);
+	g_string_free(cmp.mods, TRUE);
+	g_string_free(cmp.dn, TRUE);
+	g_array_free(cmp.attrs, TRUE);
+	g_string_free(cmp.rec, TRUE);
+	g_hash_table_destroy(cmp.ignore);
+
+	return cmp.ok;
+}
+
+/* The dialog */
+
+static gchar *last_ignore = NULL;
+static gchar *last_filename = NULL;
+
+static void
+add_server_name(GQServerList *list, GqServer *server, gpointer data)
+{
+	gtk_combo_box_append_text(GTK_COMBO_BOX(data), server->name);
+}
+
+static void
+to_file_toggled(GtkToggleButton *button, GtkWidget *filename)
+{
+	gtk_widget_set_sensitive(filename, gtk_toggle_button_get_active(button));
+}
+
+static void
+show_differences(GtkWidget *transient_for, const gchar *title,
+		 GString *view, const GqCompareCount *count)
+{
+	GtkWidget *window, *vbox, *label, *scrwin, *text;
+	GtkTextBuffer *buffer;
+	GtkTextIter iter;
+	PangoFontDescription *font;
+	const gchar *line, *end, *tag;
+	gchar *msg;
+	int differences = count->added + count->missing + count->changed;
+
+	window = gtk_dialog_new_with_buttons(title,
+					     transient_for && GTK_IS_WINDOW(transient_for) ?
+					     GTK_WINDOW(transient_for) : NULL,
+					     GTK_DIALOG_DESTROY_WITH_PARENT,
+					     GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE,
+					     NULL);
+	gtk_window_set_default_size(GTK_WINDOW(window), 600, 420);
+	g_signal_connect(window, "response",
+			 G_CALLBACK(gtk_widget_destroy), NULL);
+
+	vbox = gtk_vbox_new(FALSE, CONTAINER_BORDER_WIDTH);
+	gtk_container_set_border_width(GTK_CONTAINER(vbox),
+				       CONTAINER_BORDER_WIDTH);
+	gtk_box_pack_start(GTK_BOX(GTK_DIALOG(window)->vbox), vbox,
+			   TRUE, TRUE, 0);
+
+	if (differences == 0) {
+		msg = g_strdup_printf(ngettext("No differences, %d entry is the same.",
+					       "No differences, all %d entries are the same.",
+					       count->same),
+				      count->same);
+	} else if (differences > COMPARE_VIEW_LIMIT) {
+		msg = g_strdup_printf(_("%1$d added, %2$d missing, %3$d changed, %4$d the same. Only the first %5$d differences are shown."),
+				      count->added, count->missing,
+				      count->changed, count->same,
+				      COMPARE_VIEW_LIMIT);
+	} else {
+		msg = g_strdup_printf(_("%1$d added, %2$d missing, %3$d changed, %4$d the same."),
+				      count->added, count->missing,
+				      count->changed, count->same);
+	}
+	label = gtk_label_new(msg);
+	g_free(msg);
+	gtk_label_set_line_wrap(GTK_LABEL(label), TRUE);
+	gtk_misc_set_alignment(GTK_MISC(label), 0, 0.5);
+	gtk_box_pack_start(GTK_BOX(vbox), label, FALSE, FALSE, 0);
+
+	scrwin = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrwin),
+				       GTK_POLICY_AUTOMATIC,
+				       GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scrwin),
+					    GTK_SHADOW_IN);
+	gtk_box_pack_start(GTK_BOX(vbox), scrwin, TRUE, TRUE, 0);
+
+	text = gtk_text_view_new();
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(text), FALSE);
+	font = pango_font_description_from_string("Monospace");
+	gtk_widget_modify_font(text, font);
+	pango_font_description_free(font);
+	gtk_container_add(GTK_CONTAINER(scrwin), text);
+
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(text));
+	gtk_text_buffer_create_tag(buffer, "added",
+				   "foreground", "dark green", NULL);
+	gtk_text_buffer_create_tag(buffer, "missing",
+				   "foreground", "red3", NULL);
+	gtk_text_buffer_create_tag(buffer, "changed",
+				   "weight", PANGO_WEIGHT_BOLD, NULL);
+
+	/* "+ dn", "- dn" and "~ dn" for entries, indented "+ attr: value"
+	   and "- attr: value" for the values of changed ones */
+	gtk_text_buffer_get_end_iter(buffer, &iter);
+	for (line = view->str ; *line ; line = end) {
+		const gchar *sign = line + strspn(line, " ");
+
+		end = strchr(line, '\n');
+		end = end ? end + 1 : line + strlen(line);
+
+		tag = *sign == '+' ? "added" :
+			*sign == '-' ? "missing" : "changed";
+		gtk_text_buffer_insert_with_tags_by_name(buffer, &iter, line,
+							 end - line, tag,
+							 NULL);
+	}
+
+	gtk_widget_show_all(window);
+}
+
+void
+compare_subtree(int error_context, GtkWidget *transient_for,
+		GqServer *server, const gchar *base)
+{
+	GtkWidget *dialog, *vbox, *table, *label, *servers, *other_base;
+	GtkWidget *ignore, *to_view_button, *to_file, *filename;
+	GQServerList *list = gq_server_list_get();
+	GqCompareCount count;
+	gchar *msg, *own_base;
+	guint i;
+
+	/* the dialog and the progress run the main loop: the browser
+	   node base may belong to, or the server, can go away meanwhile */
+	base = own_base = g_strdup(base);
+	g_object_ref(server);
+
+	dialog = gtk_dialog_new_with_buttons(_("Compare subtree"),
+					     transient_for && GTK_IS_WINDOW(transient_for) ?
+					     GTK_WINDOW(transient_for) : NULL,
+					     GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+					     GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+					     _("C_ompare"), GTK_RESPONSE_OK,
+					     NULL);
+	gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_OK);
+
+	vbox = gtk_vbox_new(FALSE, CONTAINER_BORDER_WIDTH);
+	gtk_container_set_border_width(GTK_CONTAINER(vbox),
+				       CONTAINER_BORDER_WIDTH);
+	gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), vbox,
+			   TRUE, TRUE, 0);
+
+	msg = g_strdup_printf(_("Compare '%1$s' on %2$s with"),
+			      base, server->name);
+	label = gtk_label_new(msg);
+	g_free(msg);
+	gtk_misc_set_alignment(GTK_MISC(label), 0, 0.5);
+	gtk_box_pack_start(GTK_BOX(vbox), label, FALSE, FALSE, 0);
+
+	table = gtk_table_new(3, 2, FALSE);
+	gtk_table_set_row_spacings(GTK_TABLE(table), 2);
+	gtk_table_set_col_spacings(GTK_TABLE(table), CONTAINER_BORDER_WIDTH);
+	gtk_box_pack_start(GTK_BOX(vbox), table, FALSE, FALSE, 0);
+
+	label = gq_label_new(_("_Server:"));
+	gtk_misc_set_alignment(GTK_MISC(label), 0, 0.5);
+	gtk_table_attach(GTK_TABLE(table), label, 0, 1, 0, 1,
+			 GTK_FILL, GTK_FILL, 0, 0);
+	servers = gtk_combo_box_new_text();
+	gq_server_list_foreach(list, add_server_name, servers);
+	for (i = 0 ; i < gq_server_list_n_servers(list) ; i++) {
+		if (gq_server_list_get_server(list, i) == server) {
+			gtk_combo_box_set_active(GTK_COMBO_BOX(servers), i);
+		}
+	}
+	gtk_label_set_mnemonic_widget(GTK_LABEL(label), servers);
+	gtk_table_attach(GTK_TABLE(table), servers, 1, 2, 0, 1,
+			 GTK_EXPAND | GTK_FILL, GTK_FILL, 0, 0);
+
+	label = gq_label_new(_("_Base DN:"));
+	gtk_misc_set_alignment(GTK_MISC(label), 0, 0.5);
+	gtk_table_attach(GTK_TABLE(table), label, 0, 1, 1, 2,
+			 GTK_FILL, GTK_FILL, 0, 0);
+	other_base = gtk_entry_new();
+	gtk_entry_set_text(GTK_ENTRY(other_base), base);
+	gtk_entry_set_width_chars(GTK_ENTRY(other_base), 40);
+	gtk_label_set_mnemonic_widget(GTK_LABEL(label), other_base);
+	gtk_table_attach(GTK_TABLE(table), other_base, 1, 2, 1, 2,
+			 GTK_EXPAND | GTK_FILL, GTK_FILL, 0, 0);
+
+	label = gq_label_new(_("_Ignore attributes:"));
+	gtk_misc_set_alignment(GTK_MISC(label), 0, 0.5);
+	gtk_table_attach(GTK_TABLE(table), label, 0, 1, 2, 3,
+			 GTK_FILL, GTK_FILL, 0, 0);
+	ignore = gtk_entry_new();
+	if (last_ignore) gtk_entry_set_text(GTK_ENTRY(ignore), last_ignore);
+	gtk_label_set_mnemonic_widget(GTK_LABEL(label), ignore);
+	gtk_table_attach(GTK_TABLE(table), ignore, 1, 2, 2, 3,
+			 GTK_EXPAND | GTK_FILL, GTK_FILL, 0, 0);
+
+	to_view_button = gtk_radio_button_new_with_mnemonic(NULL,
+							    _("Show the _differences"));
+	gtk_box_pack_start(GTK_BOX(vbox), to_view_button, FALSE, FALSE, 0);
+
+	to_file = gtk_radio_button_new_with_mnemonic_from_widget(GTK_RADIO_BUTTON(to_view_button),
+								 _("Write LDIF change records to this _file:"));
+	gtk_box_pack_start(GTK_BOX(vbox), to_file, FALSE, FALSE, 0);
+
+	filename = gtk_entry_new();
+	if (last_filename) gtk_entry_set_text(GTK_ENTRY(filename), last_filename);
+	gtk_widget_set_sensitive(filename, FALSE);
+	gtk_box_pack_start(GTK_BOX(vbox), filename, FALSE, FALSE, 0);
+	g_signal_connect(to_file, "toggled",
+			 G_CALLBACK(to_file_toggled), filename);
+
+	label = gtk_label_new(_("Change records turn this subtree into the other one. Names ending in .gz or .zst get compressed."));
+	gtk_label_set_line_wrap(GTK_LABEL(label), TRUE);
+	gtk_misc_set_alignment(GTK_MISC(label), 0, 0.5);
+	gtk_box_pack_start(GTK_BOX(vbox), label, FALSE, FALSE, 0);
+
+	gtk_widget_show_all(dialog);
+
+	while (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_OK) {
+		GqServer *other_server;
+		GqExportFile *file = NULL;
+		GString *view = NULL;
+		gchar *name, *other, *title, **ignored_attrs, *partial = NULL;
+		gboolean ok;
+
+		name = gtk_combo_box_get_active_text(GTK_COMBO_BOX(servers));
+		other_server = name ?
+			gq_server_list_get_by_name(list, name) : NULL;
+		g_free(name);
+		if (other_server == NULL) continue;
+		g_object_ref(other_server);
+
+		g_free(last_ignore);
+		last_ignore = g_strdup(gtk_entry_get_text(GTK_ENTRY(ignore)));
+		g_free(last_filename);
+		last_filename = g_strdup(gtk_entry_get_text(GTK_ENTRY(filename)));
+
+		if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(to_file))) {
+			if (*last_filename == 0) {
+				g_object_unref(other_server);
+				continue;
+			}
+			/* written next to it and renamed once complete, a
+			   failed comparison leaves no truncated LDIF behind */
+			partial = g_strconcat(last_filename, ".part", NULL);
+			file = gq_export_file_open(partial,
+						   gq_compression_from_filename(last_filename),
+						   error_context);
+			if (file == NULL) {
+				g_free(partial);
+				g_object_unref(other_server);
+				break;
+			}
+		} else {
+			view = g_string_sized_new(4096);
+		}
+
+		other = g_strdup(gtk_entry_get_text(GTK_ENTRY(other_base)));
+		ignored_attrs = g_strsplit_set(last_ignore, " ,;", -1);
+
+		gtk_widget_hide(dialog);
+		set_busycursor();
+
+		ok = gq_compare_subtrees(error_context, server, base,
+					 other_server, other, ignored_attrs,
+					 file, view, COMPARE_VIEW_LIMIT,
+					 &count);
+
+		if (file && !gq_export_file_close(file)) ok = FALSE;
+		if (partial) {
+			if (ok && rename(partial, last_filename) != 0) {
+				error_push(error_context,
+					   _("Could not rename '%1$s' to '%2$s': %3$s"),
+					   partial, last_filename,
+					   g_strerror(errno));
+				ok = FALSE;
+			}
+			if (!ok) unlink(partial);
+			g_free(partial);
+		}
+
+		set_normalcursor();
+
+		if (ok && view) {
+			title = g_strdup_printf(_("%1$s on %2$s compared with %3$s on %4$s"),
+						base, server->name,
+						other, other_server->name);
+			show_differences(transient_for, title, view, &count);
+			g_free(title);
+		} else if (ok) {
+			statusbar_msg(_("%1$d added, %2$d missing, %3$d changed: change records written to '%4$s'"),
+				      count.added, count.missing,
+				      count.changed, last_filename);
+		}
+
+		if (view) g_string_free(view, TRUE);
+		g_strfreev(ignored_attrs);
+		g_free(other);
+		g_object_unref(other_server);
+		break;
+	}
+
+	gtk_widget_destroy(dialog);
+	g_object_unref(server);
+	g_free(own_base);
+}
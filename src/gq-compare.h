@@ -0,0 +1,83 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GQ_COMPARE_H
+#define GQ_COMPARE_H
+
+#include <glib.h>
+#include <gtk/gtkwidget.h>
+
+#include "gq-export-file.h"
+#include "gq-server.h"
+
+G_BEGIN_DECLS
+
+/* Comparing a subtree with another one, on the same or another server,
+   below the same or another base. Think of a replica and its master,
+   or a staging copy and production.
+
+   Both subtrees get searched at the same time. Entries are matched up
+   by their DN relative to the base, compared case-insensitively RDN
+   by RDN. As no server can be asked to sort by DN, each side gets
+   sorted here: entries are kept in memory in a compact form up to a
+   limit, sorted, and written to a temporary file as a run; the runs
+   then get merged. Parents sort before their children. Memory use
+   does not depend on the size of the subtrees.
+
+   Walking both sorted sides together yields the differences: entries
+   only in the other subtree (added), entries only in this one
+   (missing) and entries in both that differ (changed). Attributes get
+   compared value by value, bytewise, the way the entry form finds its
+   changes; operational attributes and the ones asked to be ignored
+   do not count.
+
+   The differences can be shown as a diff or written as LDIF change
+   records that turn this subtree into the other one. Those use the
+   DNs of this side; deletes come last, children first. */
+
+typedef struct {
+	gint added;		/* only in the other subtree */
+	gint missing;		/* only in this one */
+	gint changed;
+	gint same;
+} GqCompareCount;
+
+/* compares base on server with other_base on other_server, ignoring
+   the attributes in ignore (NULL-terminated, may be NULL). With a
+   file the differences get written to it as LDIF, otherwise a
+   readable diff gets appended to view, the first view_limit
+   differences of it. FALSE (and an error pushed) if a search
+   failed. */
+gboolean gq_compare_subtrees(int error_context,
+			     GqServer *server, const gchar *base,
+			     GqServer *other_server, const gchar *other_base,
+			     gchar **ignore,
+			     GqExportFile *file, GString *view, gint view_limit,
+			     GqCompareCount *count);
+
+/* asks what to compare base on server with, and shows or saves the
+   differences */
+void compare_subtree(int error_context, GtkWidget *transient_for,
+		     GqServer *server, const gchar *base);
+
+G_END_DECLS
+
+#endif /* !GQ_COMPARE_H */
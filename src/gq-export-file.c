@@ -0,0 +1,435 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gq-export-file.h"
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+
+#ifdef HAVE_ZLIB
+# include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+# include <zstd.h>
+#endif
+
+#include "errorchain.h"
+
+/* how many buffers may be on their way to the writing thread */
+#define EXPORT_FILE_BUFFERS	4
+
+/* zstd's own default, fast and still much better than gzip */
+#define ZSTD_LEVEL		3
+
+struct _GqExportFile {
+	gchar *filename;
+	GqCompression compression;
+	int error_context;
+
+	FILE *fp;			/* uncompressed and zstd */
+#ifdef HAVE_ZLIB
+	gzFile gz;
+#endif
+#ifdef HAVE_ZSTD
+	ZSTD_CStream *zs;
+	ZSTD_outBuffer zout;
+#endif
+
+	/* NULL when writing happens right away */
+	GThread *thread;
+	GAsyncQueue *full;		/* GStrings to write, then the file
+					   itself to stop */
+	GAsyncQueue *empty;		/* GStrings to reuse */
+
+	GMutex *lock;			/* for error */
+	gchar *error;			/* the first thing that went wrong */
+	gboolean reported;
+};
+
+const gchar *
+gq_compression_get_name(GqCompression compression)
+{
+	switch (compression) {
+	case GQ_COMPRESS_NONE:
+		return _("None");
+	case GQ_COMPRESS_GZIP:
+		return "gzip";
+	case GQ_COMPRESS_ZSTD:
+		return "zstd";
+	default:
+		g_return_val_if_reached(NULL);
+	}
+}
+
+gboolean
+gq_compression_is_available(GqCompression compression)
+{
+	switch (compression) {
+	case GQ_COMPRESS_NONE:
+		return TRUE;
+#ifdef HAVE_ZLIB
+	case GQ_COMPRESS_GZIP:
+		return TRUE;
+#endif
+#ifdef HAVE_ZSTD
+	case GQ_COMPRESS_ZSTD:
+		return TRUE;
+#endif
+	default:
+		return FALSE;
+	}
+}
+
+static gboolean
+has_suffix(const gchar *filename, const gchar *suffix)
+{
+	gsize l = strlen(filename), s = strlen(suffix);
+	return l > s && g_ascii_strcasecmp(filename + l - s, suffix) == 0;
+}
+
+GqCompression
+gq_compression_from_filename(const gchar *filename)
+{
+	g_return_val_if_fail(filename != NULL, GQ_COMPRESS_NONE);
+
+	if (has_suffix(filename, ".gz")) return GQ_COMPRESS_GZIP;
+	if (has_suffix(filename, ".zst")) return GQ_COMPRESS_ZSTD;
+	return GQ_COMPRESS_NONE;
+}
+
+/* keeps the first error, takes ownership of error */
+static void
+set_error(GqExportFile *file, gchar *error)
+{
+	if (error == NULL) return;
+
+	if (file->lock) g_mutex_lock(file->lock);
+	if (file->error == NULL) {
+		file->error = error;
+	} else {
+		g_free(error);
+	}
+	if (file->lock) g_mutex_unlock(file->lock);
+}
+
+/* pushes an error of the writing thread, once. FALSE if there was
+   one. */
+static gboolean
+check_error(GqExportFile *file)
+{
+	gboolean ok;
+
+	if (file->lock) g_mutex_lock(file->lock);
+	ok = file->error == NULL;
+	if (!ok && !file->reported) {
+		error_push(file->error_context,
+			   _("Save to '%1$s' failed: %2$s"),
+			   file->filename, file->error);
+		file->reported = TRUE;
+	}
+	if (file->lock) g_mutex_unlock(file->lock);
+
+	return ok;
+}
+
+static gchar *
+write_plain(FILE *fp, const gchar *data, gsize len)
+{
+	size_t written = fwrite(data, 1, len, fp);
+
+	if (written != len) {
+		return g_strdup_printf(_("Only %1$d of %2$d bytes written"),
+				       (int) written, (int) len);
+	}
+	return NULL;
+}
+
+/* compresses and writes one chunk, returns an error message (to be
+   g_free'd) or NULL */
+static gchar *
+write_chunk(GqExportFile *file, const gchar *data, gsize len)
+{
+	switch (file->compression) {
+#ifdef HAVE_ZLIB
+	case GQ_COMPRESS_GZIP:
+		if (gzwrite(file->gz, data, len) != (int) len) {
+			int err;
+			const char *msg = gzerror(file->gz, &err);
+			return g_strdup(err == Z_ERRNO ? strerror(errno) : msg);
+		}
+		return NULL;
+#endif
+#ifdef HAVE_ZSTD
+	case GQ_COMPRESS_ZSTD: {
+		ZSTD_inBuffer in;
+		size_t r;
+		gchar *error;
+
+		in.src = data;
+		in.size = len;
+		in.pos = 0;
+		while (in.pos < in.size) {
+			file->zout.pos = 0;
+			r = ZSTD_compressStream(file->zs, &file->zout, &in);
+			if (ZSTD_isError(r)) {
+				return g_strdup(ZSTD_getErrorName(r));
+			}
+			error = write_plain(file->fp, file->zout.dst,
+					    file->zout.pos);
+			if (error) return error;
+		}
+		return NULL;
+	}
+#endif
+	default:
+		return write_plain(file->fp, data, len);
+	}
+}
+
+/* finishes the compressed stream and closes the file, whatever
+   happened before */
+static gchar *
+close_output(GqExportFile *file)
+{
+	gchar *error = NULL;
+
+	switch (file->compression) {
+#ifdef HAVE_ZLIB
+	case GQ_COMPRESS_GZIP: {
+		int err = gzclose(file->gz);
+		if (err == Z_ERRNO) {
+			error = g_strdup(strerror(errno));
+		} else if (err != Z_OK) {
+			error = g_strdup(_("Could not finish compressing"));
+		}
+		return error;
+	}
+#endif
+#ifdef HAVE_ZSTD
+	case GQ_COMPRESS_ZSTD: {
+		size_t r;
+
+		do {
+			file->zout.pos = 0;
+			r = ZSTD_endStream(file->zs, &file->zout);
+			if (ZSTD_isError(r)) {
+				error = g_strdup(ZSTD_getErrorName(r));
+				break;
+			}
+			error = write_plain(file->fp, file->zout.dst,
+					    file->zout.pos);
+		} while (r > 0 && error == NULL);
+
+		ZSTD_freeCStream(file->zs);
+		g_free(file->zout.dst);
+		break;
+	}
+#endif
+	default:
+		break;
+	}
+
+	if (fclose(file->fp) != 0 && error == NULL) {
+		error = g_strdup(strerror(errno));
+	}
+	return error;
+}
+
+static gboolean
+open_output(GqExportFile *file)
+{
+#ifdef HAVE_ZLIB
+	if (file->compression == GQ_COMPRESS_GZIP) {
+		file->gz = gzopen(file->filename, "wb");
+		return file->gz != NULL;
+	}
+#endif
+
+	file->fp = fopen(file->filename, "wb");
+	if (file->fp == NULL) return FALSE;
+
+#ifdef HAVE_ZSTD
+	if (file->compression == GQ_COMPRESS_ZSTD) {
+		file->zs = ZSTD_createCStream();
+		if (file->zs == NULL ||
+		    ZSTD_isError(ZSTD_initCStream(file->zs, ZSTD_LEVEL))) {
+			ZSTD_freeCStream(file->zs);
+			fclose(file->fp);
+			errno = ENOMEM;
+			return FALSE;
+		}
+		file->zout.size = ZSTD_CStreamOutSize();
+		file->zout.dst = g_malloc(file->zout.size);
+	}
+#endif
+	return TRUE;
+}
+
+static gpointer
+writer_thread(gpointer data)
+{
+	GqExportFile *file = data;
+	GString *buf;
+	gboolean ok = TRUE;
+
+	while ((buf = g_async_queue_pop(file->full)) != data) {
+		/* after an error the rest only gets thrown away */
+		if (ok) {
+			gchar *error = write_chunk(file, buf->str, buf->len);
+			if (error) {
+				set_error(file, error);
+				ok = FALSE;
+			}
+		}
+		g_string_truncate(buf, 0);
+		g_async_queue_push(file->empty, buf);
+	}
+	return NULL;
+}
+
+static void
+start_thread(GqExportFile *file)
+{
+	int i;
+
+	if (!g_thread_supported()) return;
+
+	file->full = g_async_queue_new();
+	file->empty = g_async_queue_new();
+	for (i = 0 ; i < EXPORT_FILE_BUFFERS ; i++) {
+		g_async_queue_push(file->empty, g_string_new(NULL));
+	}
+	file->lock = g_mutex_new();
+
+	file->thread = g_thread_create(writer_thread, file, TRUE, NULL);
+	if (file->thread == NULL) {
+		/* write in this thread then */
+		GString *buf;
+		while ((buf = g_async_queue_try_pop(file->empty)) != NULL) {
+			g_string_free(buf, TRUE);
+		}
+		g_async_queue_unref(file->full);
+		g_async_queue_unref(file->empty);
+		g_mutex_free(file->lock);
+		file->full = file->empty = NULL;
+		file->lock = NULL;
+	}
+}
+
+GqExportFile *
+gq_export_file_open(const gchar *filename, GqCompression compression,
+		    int error_context)
+{
+	GqExportFile *file;
+
+	g_return_val_if_fail(filename != NULL, NULL);
+	g_return_val_if_fail(compression < GQ_COMPRESS_N, NULL);
+
+	if (!gq_compression_is_available(compression)) {
+		error_push(error_context,
+			   _("This version of GQ cannot write %s compressed files."),
+			   gq_compression_get_name(compression));
+		return NULL;
+	}
+
+	file = g_new0(GqExportFile, 1);
+	file->filename = g_strdup(filename);
+	file->compression = compression;
+	file->error_context = error_context;
+
+	if (!open_output(file)) {
+		error_push(error_context,
+			   _("Could not open output file '%1$s': %2$s"),
+			   filename, strerror(errno));
+		g_free(file->filename);
+		g_free(file);
+		return NULL;
+	}
+
+	start_thread(file);
+	return file;
+}
+
+gboolean
+gq_export_file_write(GqExportFile *file, GString *out)
+{
+	GString *buf, swap;
+
+	g_return_val_if_fail(file != NULL, FALSE);
+	g_return_val_if_fail(out != NULL, FALSE);
+
+	if (!check_error(file)) return FALSE;
+	if (out->len == 0) return TRUE;
+
+	if (file->thread == NULL) {
+		set_error(file, write_chunk(file, out->str, out->len));
+		g_string_truncate(out, 0);
+		return check_error(file);
+	}
+
+	/* waits while all buffers are with the thread, then trades the
+	   text for an empty one instead of copying it */
+	buf = g_async_queue_pop(file->empty);
+	swap = *buf;
+	*buf = *out;
+	*out = swap;
+	g_async_queue_push(file->full, buf);
+
+	return TRUE;
+}
+
+gboolean
+gq_export_file_close(GqExportFile *file)
+{
+	GString *buf;
+	gboolean ok;
+
+	g_return_val_if_fail(file != NULL, FALSE);
+
+	if (file->thread) {
+		g_async_queue_push(file->full, file);
+		g_thread_join(file->thread);
+
+		while ((buf = g_async_queue_try_pop(file->empty)) != NULL) {
+			g_string_free(buf, TRUE);
+		}
+		g_async_queue_unref(file->full);
+		g_async_queue_unref(file->empty);
+		g_mutex_free(file->lock);
+		file->lock = NULL;
+	}
+
+	set_error(file, close_output(file));
+	ok = check_error(file);
+
+	g_free(file->error);
+	g_free(file->filename);
+	g_free(file);
+
+	return ok;
+}
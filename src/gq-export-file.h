@@ -0,0 +1,66 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GQ_EXPORT_FILE_H
+#define GQ_EXPORT_FILE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The file an export goes to, optionally gzip or zstd compressed.
+
+   Writing hands the text over to a thread that does the compressing
+   and the file I/O, so both overlap with reading the next entries
+   from the server. Only a few buffers are in flight at any time:
+   when the thread falls behind, writing waits for it.
+
+   Errors of the thread get pushed to the error context with the next
+   write or when closing. */
+
+typedef enum {
+	GQ_COMPRESS_NONE,
+	GQ_COMPRESS_GZIP,
+	GQ_COMPRESS_ZSTD,
+	GQ_COMPRESS_N
+} GqCompression;
+
+typedef struct _GqExportFile GqExportFile;
+
+const gchar  *gq_compression_get_name(GqCompression compression);
+/* whether this build can write it */
+gboolean      gq_compression_is_available(GqCompression compression);
+/* by the extension of filename, ".gz" or ".zst" */
+GqCompression gq_compression_from_filename(const gchar *filename);
+
+/* NULL (and an error pushed) if the file cannot be created */
+GqExportFile *gq_export_file_open(const gchar *filename,
+				  GqCompression compression,
+				  int error_context);
+/* takes what is in out, leaving it empty. FALSE if writing failed,
+   the file needs to be closed anyway. */
+gboolean      gq_export_file_write(GqExportFile *file, GString *out);
+/* flushes, closes and frees file. FALSE if anything went wrong. */
+gboolean      gq_export_file_close(GqExportFile *file);
+
+G_END_DECLS
+
+#endif /* !GQ_EXPORT_FILE_H */
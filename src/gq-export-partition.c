@@ -0,0 +1,642 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gq-export-partition.h"
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+
+#include "errorchain.h"
+#include "gq-server-stats.h"
+#include "util.h"
+
+/* output gets written to the file in chunks of about this size */
+#define WRITE_CHUNK		(64 * 1024)
+
+/* what a part that cannot be written yet has is kept in memory up
+   to this size, the rest goes to a temporary file */
+#define SPILL_SIZE		(1024 * 1024)
+
+/* how many parts per connection may be searched ahead of the one
+   being written */
+#define PARTS_AHEAD		4
+
+#define MAX_CONNECTIONS		16
+
+/* how long (in ms) to wait for answers before looking again */
+#define POLL_INTERVAL		1000
+
+/* how many messages to take from a connection before looking at the
+   others */
+#define MESSAGES_PER_TURN	64
+
+struct part {
+	gchar *base;
+	int scope;
+	gchar *filter;
+	GString *buf;		/* output waiting for the parts before */
+	FILE *spill;		/* more of it */
+	gboolean writing;	/* output goes straight to the file */
+	gboolean done;
+	int n_entries;
+};
+
+struct slot {
+	LDAP *ld;
+	struct part *part;	/* being searched */
+	int msgid;
+	gdouble start;
+};
+
+struct run {
+	int ctx;
+	struct dn_on_server *dos;
+	GqExportWriter *writer;
+	GqExportFile *file;
+	GString *out;
+	GqProgress *progress;
+	GPtrArray *parts;
+	guint next_start;
+	guint next_write;
+	int n_entries;
+};
+
+static void
+add_part(struct run *run, const gchar *base, int scope, const gchar *filter)
+{
+	struct part *part = g_new0(struct part, 1);
+
+	part->base = g_strdup(base);
+	part->scope = scope;
+	part->filter = g_strdup(filter);
+	g_ptr_array_add(run->parts, part);
+}
+
+static void
+free_part(struct part *part)
+{
+	g_free(part->base);
+	g_free(part->filter);
+	if (part->buf) g_string_free(part->buf, TRUE);
+	if (part->spill) fclose(part->spill);
+	g_free(part);
+}
+
+static void
+search_failed(struct run *run, LDAP *ld, const gchar *base, int rc)
+{
+	GqServer *server = run->dos->server;
+
+	if (rc == LDAP_SERVER_DOWN) {
+		server->server_down++;
+		error_push(run->ctx,
+			   _("Server '%s' down. Export may be incomplete!"),
+			   server->name);
+	} else {
+		error_push(run->ctx,
+			   _("LDAP error while searching below '%s'."
+			     " Export may be incomplete!"),
+			   base);
+	}
+	push_ldap_addl_error(ld, run->ctx);
+}
+
+static int
+compare_dns(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(const gchar **) a, *(const gchar **) b);
+}
+
+/* the base entry, then the subtrees of its children by DN */
+static gboolean
+children_parts(struct run *run, LDAP *ld)
+{
+	struct dn_on_server *dos = run->dos;
+	LDAPControl ct;
+	LDAPControl *ctrls[2] = { NULL, NULL };
+	char *attrs[] = { LDAP_NO_ATTRS, NULL };
+	LDAPMessage *res = NULL, *e;
+	GPtrArray *children;
+	gdouble start;
+	guint i;
+	int rc;
+
+	/* referrals among the children get exported as entries */
+	ct.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+	ct.ldctl_value.bv_val	= NULL;
+	ct.ldctl_value.bv_len	= 0;
+	ct.ldctl_iscritical	= 0;
+	ctrls[0] = &ct;
+
+	statusbar_msg(_("Listing the children of %s"), dos->dn);
+
+	start = gq_server_stats_start();
+	rc = ldap_search_ext_s(ld, dos->dn, LDAP_SCOPE_ONELEVEL,
+			       "(objectClass=*)", attrs, 0, ctrls, NULL,
+			       NULL, LDAP_NO_LIMIT, &res);
+	gq_server_stats_stop(dos->server, GQ_STAT_SEARCH, start,
+			     rc == LDAP_SUCCESS);
+
+	if (rc == LDAP_SIZELIMIT_EXCEEDED) {
+		error_push(run->ctx,
+			   _("The server did not list all children of '%s'. Try splitting the export by the values of an attribute."),
+			   dos->dn);
+	} else if (rc != LDAP_SUCCESS) {
+		search_failed(run, ld, dos->dn, rc);
+	}
+	if (rc != LDAP_SUCCESS) {
+		if (res) ldap_msgfree(res);
+		return FALSE;
+	}
+
+	children = g_ptr_array_new();
+	for (e = ldap_first_entry(ld, res) ; e ; e = ldap_next_entry(ld, e)) {
+		char *dn = ldap_get_dn(ld, e);
+		if (dn == NULL) continue;
+		g_ptr_array_add(children, g_strdup(dn));
+		ldap_memfree(dn);
+	}
+	ldap_msgfree(res);
+	gq_server_stats_entries(dos->server, children->len);
+
+	/* the order the server lists them in need not be stable */
+	g_ptr_array_sort(children, compare_dns);
+
+	add_part(run, dos->dn, LDAP_SCOPE_BASE, "(objectClass=*)");
+	for (i = 0 ; i < children->len ; i++) {
+		add_part(run, g_ptr_array_index(children, i),
+			 LDAP_SCOPE_SUBTREE, "(objectClass=*)");
+		g_free(g_ptr_array_index(children, i));
+	}
+	g_ptr_array_free(children, TRUE);
+
+	return TRUE;
+}
+
+/* the value of a filter assertion (RFC 4515) */
+static void
+append_escaped(GString *f, const gchar *value)
+{
+	for ( ; *value ; value++) {
+		switch (*value) {
+		case '*':
+		case '(':
+		case ')':
+		case '\\':
+			g_string_append_printf(f, "\\%02x", (guchar) *value);
+			break;
+		default:
+			g_string_append_c(f, *value);
+		}
+	}
+}
+
+static void
+append_prefix(GString *f, const gchar *attr, const gchar *prefix)
+{
+	g_string_append_printf(f, "(%s=", attr);
+	append_escaped(f, prefix);
+	g_string_append(f, "*)");
+}
+
+/* the substring assertions of a group, "a-f" being six of them */
+static void
+append_group(GString *f, const gchar *attr, const gchar *group)
+{
+	if (strlen(group) == 3 && group[1] == '-' &&
+	    (guchar) group[0] < 0x80 && (guchar) group[2] < 0x80 &&
+	    group[0] <= group[2]) {
+		gchar c[2] = { 0, 0 };
+		int i;
+
+		for (i = group[0] ; i <= group[2] ; i++) {
+			c[0] = i;
+			append_prefix(f, attr, c);
+		}
+	} else {
+		append_prefix(f, attr, group);
+	}
+}
+
+#ifdef HAVE_LDAP_STR2OBJECTCLASS
+/* without a substring rule the filters would leave entries out */
+static gboolean
+has_substring_rule(struct server_schema *ss, const gchar *attr)
+{
+	LDAPAttributeType *at = find_canonical_at_by_at(ss, attr);
+	int depth;
+
+	/* unknown, hope for the best */
+	if (at == NULL) return TRUE;
+
+	for (depth = 0 ; at && depth < 16 ; depth++) {
+		if (at->at_substr_oid) return TRUE;
+		at = at->at_sup_oid ?
+			find_canonical_at_by_at(ss, at->at_sup_oid) : NULL;
+	}
+	return FALSE;
+}
+#endif /* HAVE_LDAP_STR2OBJECTCLASS */
+
+/* Entries fitting no group first, then one part per group, each
+   without the entries of the groups before it. This way every entry
+   goes into exactly one part, even with several values. */
+static gboolean
+prefix_parts(struct run *run, const GqPartitioning *partitioning)
+{
+	const gchar *attr = partitioning->attribute;
+	GString *filter, *before;
+	gchar **g;
+
+	if (attr == NULL || attr[0] == 0 ||
+	    partitioning->prefixes == NULL ||
+	    partitioning->prefixes[0] == NULL) {
+		error_push(run->ctx,
+			   _("Please name the attribute and the groups of initial characters to split the export by."));
+		return FALSE;
+	}
+
+#ifdef HAVE_LDAP_STR2OBJECTCLASS
+	if (run->dos->server->ss &&
+	    !has_substring_rule(run->dos->server->ss, attr)) {
+		error_push(run->ctx,
+			   _("The export cannot be split up by '%s', it has no substring matching rule."),
+			   attr);
+		return FALSE;
+	}
+#endif /* HAVE_LDAP_STR2OBJECTCLASS */
+
+	filter = g_string_new("(!(|");
+	for (g = partitioning->prefixes ; *g ; g++) {
+		append_group(filter, attr, *g);
+	}
+	g_string_append(filter, "))");
+	add_part(run, run->dos->dn, LDAP_SCOPE_SUBTREE, filter->str);
+
+	before = g_string_new(NULL);
+	for (g = partitioning->prefixes ; *g ; g++) {
+		g_string_assign(filter, "(|");
+		append_group(filter, attr, *g);
+		g_string_append(filter, ")");
+		if (before->len) {
+			g_string_prepend(filter, "(&");
+			g_string_append_printf(filter, "(!(|%s)))", before->str);
+		}
+		add_part(run, run->dos->dn, LDAP_SCOPE_SUBTREE, filter->str);
+
+		append_group(before, attr, *g);
+	}
+
+	g_string_free(before, TRUE);
+	g_string_free(filter, TRUE);
+
+	return TRUE;
+}
+
+static gboolean
+send_part(struct run *run, struct slot *slot, struct part *part)
+{
+	LDAPControl ct;
+	LDAPControl *ctrls[2] = { NULL, NULL };
+	char *attrs[] = {
+		LDAP_ALL_USER_ATTRIBUTES,
+		"ref",
+		NULL
+	};
+	int rc;
+
+	/* not critical, so there is no need to retry without it */
+	ct.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+	ct.ldctl_value.bv_val	= NULL;
+	ct.ldctl_value.bv_len	= 0;
+	ct.ldctl_iscritical	= 0;
+	ctrls[0] = &ct;
+
+	slot->start = gq_server_stats_start();
+	rc = ldap_search_ext(slot->ld, part->base, part->scope, part->filter,
+			     attrs, 0, ctrls, NULL, NULL, LDAP_NO_LIMIT,
+			     &slot->msgid);
+	if (rc != LDAP_SUCCESS) {
+		slot->msgid = -1;
+		search_failed(run, slot->ld, part->base, rc);
+		return FALSE;
+	}
+
+	slot->part = part;
+	return TRUE;
+}
+
+static gboolean
+spill(struct run *run, struct part *part)
+{
+	if (part->spill == NULL) {
+		part->spill = tmpfile();
+		/* no temporary file, then memory has to do */
+		if (part->spill == NULL) return TRUE;
+	}
+
+	if (fwrite(part->buf->str, 1, part->buf->len, part->spill) !=
+	    part->buf->len) {
+		error_push(run->ctx,
+			   _("Could not write to a temporary file: %s"),
+			   strerror(errno));
+		return FALSE;
+	}
+	g_string_truncate(part->buf, 0);
+	return TRUE;
+}
+
+/* the part is next, writes what it has so far */
+static gboolean
+start_writing(struct run *run, struct part *part)
+{
+	GString *out = run->out;
+
+	if (part->spill) {
+		size_t n;
+
+		rewind(part->spill);
+		do {
+			gsize len = out->len;
+
+			g_string_set_size(out, len + WRITE_CHUNK);
+			n = fread(out->str + len, 1, WRITE_CHUNK, part->spill);
+			g_string_set_size(out, len + n);
+
+			if (out->len >= WRITE_CHUNK &&
+			    !gq_export_file_write(run->file, out)) {
+				return FALSE;
+			}
+		} while (n > 0);
+
+		if (ferror(part->spill)) {
+			error_push(run->ctx,
+				   _("Could not read a temporary file: %s"),
+				   strerror(errno));
+			return FALSE;
+		}
+		fclose(part->spill);
+		part->spill = NULL;
+	}
+
+	if (part->buf) {
+		g_string_append_len(out, part->buf->str, part->buf->len);
+		g_string_free(part->buf, TRUE);
+		part->buf = NULL;
+	}
+
+	part->writing = TRUE;
+	return TRUE;
+}
+
+/* writes out the parts in order as far as they are done */
+static gboolean
+advance(struct run *run)
+{
+	while (run->next_write < run->parts->len) {
+		struct part *part = g_ptr_array_index(run->parts,
+						      run->next_write);
+
+		if (!part->writing && !start_writing(run, part)) return FALSE;
+		if (!part->done) break;
+
+		run->n_entries += part->n_entries;
+		run->next_write++;
+	}
+
+	if (run->out->len >= WRITE_CHUNK) {
+		return gq_export_file_write(run->file, run->out);
+	}
+	return TRUE;
+}
+
+static gboolean
+take_entries(struct run *run, struct slot *slot, LDAPMessage *res)
+{
+	struct part *part = slot->part;
+	LDAPMessage *e;
+	GString *to;
+	int n = 0;
+
+	if (!part->writing && part->buf == NULL) {
+		part->buf = g_string_sized_new(4096);
+	}
+	to = part->writing ? run->out : part->buf;
+
+	/* references get skipped, like in a plain export */
+	for (e = ldap_first_entry(slot->ld, res) ; e ;
+	     e = ldap_next_entry(slot->ld, e)) {
+		gq_export_writer_message(run->writer, to, slot->ld, e);
+		n++;
+	}
+	part->n_entries += n;
+	gq_progress_add(run->progress, n);
+
+	if (part->writing) {
+		if (to->len >= WRITE_CHUNK) {
+			return gq_export_file_write(run->file, to);
+		}
+	} else if (to->len >= SPILL_SIZE) {
+		return spill(run, part);
+	}
+	return TRUE;
+}
+
+/* takes what has arrived on the connection of slot */
+static gboolean
+poll_slot(struct run *run, struct slot *slot, gboolean *progress)
+{
+	struct timeval nowait = { 0, 0 };
+	struct part *part = slot->part;
+	GqServer *server = run->dos->server;
+	LDAPMessage *res;
+	int i, rc, err;
+
+	for (i = 0 ; i < MESSAGES_PER_TURN ; i++) {
+		res = NULL;
+		rc = ldap_result(slot->ld, slot->msgid, LDAP_MSG_ONE,
+				 &nowait, &res);
+		if (rc == 0) break;
+
+		*progress = TRUE;
+
+		if (rc == -1) {
+			ldap_get_option(slot->ld, LDAP_OPT_ERROR_NUMBER, &rc);
+			if (rc == LDAP_SUCCESS) rc = LDAP_OTHER;
+			slot->msgid = -1;
+			gq_server_stats_stop(server, GQ_STAT_SEARCH,
+					     slot->start, FALSE);
+			search_failed(run, slot->ld, part->base, rc);
+			return FALSE;
+		}
+
+		if (rc == LDAP_RES_SEARCH_RESULT) {
+			if (ldap_parse_result(slot->ld, res, &err, NULL, NULL,
+					      NULL, NULL, 1) != LDAP_SUCCESS) {
+				err = LDAP_OTHER;
+			}
+			slot->msgid = -1;
+			gq_server_stats_stop(server, GQ_STAT_SEARCH,
+					     slot->start, err == LDAP_SUCCESS);
+			gq_server_stats_entries(server, part->n_entries);
+
+			if (err != LDAP_SUCCESS) {
+				search_failed(run, slot->ld, part->base, err);
+				return FALSE;
+			}
+
+			part->done = TRUE;
+			slot->part = NULL;
+			return advance(run);
+		}
+
+		rc = take_entries(run, slot, res);
+		ldap_msgfree(res);
+		if (!rc) return FALSE;
+	}
+	return TRUE;
+}
+
+/* sleeps until one of the busy connections has something to read */
+static void
+wait_for_answers(struct slot *slots, int n_slots)
+{
+	struct pollfd fds[MAX_CONNECTIONS];
+	int i, nfds = 0;
+
+	for (i = 0 ; i < n_slots ; i++) {
+		if (slots[i].part == NULL) continue;
+		if (ldap_get_option(slots[i].ld, LDAP_OPT_DESC,
+				    &fds[nfds].fd) != LDAP_OPT_SUCCESS) {
+			continue;
+		}
+		fds[nfds].events = POLLIN;
+		fds[nfds].revents = 0;
+		nfds++;
+	}
+	if (nfds > 0) poll(fds, nfds, POLL_INTERVAL);
+}
+
+int
+gq_export_partitioned(int error_context, LDAP *ld, struct dn_on_server *dos,
+		      const GqPartitioning *partitioning,
+		      GqExportWriter *writer, GqExportFile *file, GString *out,
+		      GqProgress *progress)
+{
+	struct slot slots[MAX_CONNECTIONS];
+	struct run run;
+	int i, n_slots = 0, open_context;
+	gboolean ok;
+
+	g_return_val_if_fail(ld != NULL, -1);
+	g_return_val_if_fail(dos != NULL, -1);
+	g_return_val_if_fail(partitioning != NULL, -1);
+
+	memset(&run, 0, sizeof(run));
+	run.ctx = error_context;
+	run.dos = dos;
+	run.writer = writer;
+	run.file = file;
+	run.out = out;
+	run.progress = progress;
+	run.parts = g_ptr_array_new();
+
+	if (partitioning->mode == GQ_PARTITION_CHILDREN) {
+		ok = children_parts(&run, ld);
+	} else {
+		ok = prefix_parts(&run, partitioning);
+	}
+	if (!ok) goto done;
+
+	/* the cached connection and as many more as the server lets
+	   us have, up to the number asked for */
+	memset(slots, 0, sizeof(slots));
+	slots[0].ld = ld;
+	n_slots = 1;
+
+	open_context = error_new_context(_("Opening more connections"), NULL);
+	while (n_slots < CLAMP(partitioning->connections, 1, MAX_CONNECTIONS) &&
+	       n_slots < (int) run.parts->len) {
+		slots[n_slots].ld = open_pooled_connection(open_context,
+							   dos->server);
+		if (slots[n_slots].ld == NULL) break;
+		n_slots++;
+	}
+	error_clear(open_context);
+	error_flush(open_context);
+
+	for (i = 0 ; i < n_slots ; i++) {
+		slots[i].msgid = -1;
+	}
+
+	statusbar_msg(ngettext("Exporting %1$s in %2$d parts over %3$d connection",
+			       "Exporting %1$s in %2$d parts over %3$d connections",
+			       n_slots),
+		      dos->dn, (int) run.parts->len, n_slots);
+
+	ok = advance(&run);
+	while (ok && run.next_write < run.parts->len) {
+		gboolean progress = FALSE;
+
+		/* keep the connections busy, but do not run too far
+		   ahead of what can be written */
+		for (i = 0 ; ok && i < n_slots ; i++) {
+			if (slots[i].part == NULL &&
+			    run.next_start < run.parts->len &&
+			    run.next_start < run.next_write + n_slots * PARTS_AHEAD) {
+				ok = send_part(&run, &slots[i],
+					       g_ptr_array_index(run.parts,
+								 run.next_start++));
+			}
+		}
+
+		for (i = 0 ; ok && i < n_slots ; i++) {
+			if (slots[i].part) {
+				ok = poll_slot(&run, &slots[i], &progress);
+			}
+		}
+
+		if (ok && !progress) wait_for_answers(slots, n_slots);
+	}
+
+	/* whatever is still running is of no use any longer */
+	for (i = 0 ; i < n_slots ; i++) {
+		if (slots[i].msgid >= 0) ldap_abandon(slots[i].ld, slots[i].msgid);
+	}
+	for (i = 1 ; i < n_slots ; i++) {
+		release_pooled_connection(dos->server, slots[i].ld);
+	}
+
+ done:
+	g_ptr_array_foreach(run.parts, (GFunc) free_part, NULL);
+	g_ptr_array_free(run.parts, TRUE);
+
+	return ok ? run.n_entries : -1;
+}
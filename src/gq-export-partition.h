@@ -0,0 +1,75 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GQ_EXPORT_PARTITION_H
+#define GQ_EXPORT_PARTITION_H
+
+#include <glib.h>
+#include <ldap.h>
+
+#include "common.h"
+#include "gq-export-file.h"
+#include "gq-export-writer.h"
+#include "gq-progress.h"
+
+G_BEGIN_DECLS
+
+/* Exporting a large subtree as several searches running at the same
+   time, each on a connection of its own, so the server can work on
+   them in parallel.
+
+   The subtree gets split up either by the immediate children of its
+   base (the base entry, then the subtree of every child, ordered by
+   DN) or by the first characters of the values of an attribute. For
+   the latter each group is a prefix ("smith") or a range of single
+   characters ("a-f"); an entry goes with the first group one of its
+   values starts with, entries that fit none (or lack the attribute)
+   go first. Ranges keep a flat container before its entries, but
+   unlike the children they do not generally put parents first.
+
+   However the searches finish, the output is written in the order of
+   the parts, so the same tree always exports the same way. */
+
+typedef enum {
+	GQ_PARTITION_CHILDREN,
+	GQ_PARTITION_PREFIXES
+} GqPartitionMode;
+
+typedef struct {
+	GqPartitionMode mode;
+	gint connections;
+	gchar *attribute;	/* GQ_PARTITION_PREFIXES */
+	gchar **prefixes;	/* the groups, in the order to write them */
+} GqPartitioning;
+
+/* exports the subtree dos->dn, ld being the cached connection to
+   dos->server, counting entries as they arrive in progress. Returns
+   the number of entries written, -1 (and an error pushed) if the
+   export had to stop. */
+int gq_export_partitioned(int error_context, LDAP *ld,
+			  struct dn_on_server *dos,
+			  const GqPartitioning *partitioning,
+			  GqExportWriter *writer, GqExportFile *file,
+			  GString *out, GqProgress *progress);
+
+G_END_DECLS
+
+#endif /* !GQ_EXPORT_PARTITION_H */
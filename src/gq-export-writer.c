@@ -0,0 +1,577 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gq-export-writer.h"
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+
+#include "common.h"
+#include "configfile.h"
+#include "errorchain.h"
+#include "formfill.h"		/* isInternalAttr() */
+#include "ldif.h"
+#include "util.h"
+
+struct export_format {
+	const gchar *name;
+	const gchar *extension;
+	void (*begin)(GqExportWriter *writer, GString *out, GList *to_export);
+	void (*entry)(GqExportWriter *writer, GString *out, const gchar *dn,
+		      const GqResultAttr *attrs, guint n_attrs);
+	void (*end)(GqExportWriter *writer, GString *out);
+};
+
+struct _GqExportWriter {
+	const struct export_format *format;
+	int error_context;
+
+	gchar **columns;
+	GqExportMultiValue multi_value;
+	gchar *separator;
+
+	GString *cell;
+	/* scratch space for entries read from LDAP messages, reused */
+	GArray *attrs;			/* GqResultAttr */
+	GArray *values;			/* struct berval */
+	GPtrArray *to_free;		/* struct berval ** */
+	GPtrArray *names;		/* attribute names, ldap_memfree */
+};
+
+/* not something a text format can take as it is */
+static gboolean
+is_binary(const struct berval *v)
+{
+	return !g_utf8_validate(v->bv_val, v->bv_len, NULL);
+}
+
+/* LDIF */
+
+static void
+ldif_begin(GqExportWriter *writer, GString *out, GList *to_export)
+{
+	GString *header;
+
+	/* AFAIK, the UMich LDIF format doesn't take comments or a
+	   version string */
+	if (config->ldifformat == LDIF_UMICH) return;
+
+	header = g_string_sized_new(1024);
+	prepend_ldif_header(header, to_export);
+	g_string_append_len(out, header->str, header->len);
+	g_string_free(header, TRUE);
+}
+
+static void
+ldif_entry(GqExportWriter *writer, GString *out, const gchar *dn,
+	   const GqResultAttr *attrs, guint n_attrs)
+{
+	const GqResultAttr *a;
+	guint i;
+
+	ldif_line_out(out, "dn", (char *) dn, strlen(dn),
+		      writer->error_context);
+	g_string_append_c(out, '\n');
+
+	for (a = attrs ; a < attrs + n_attrs ; a++) {
+		if (isInternalAttr(a->name)) continue;
+
+		for (i = 0 ; i < a->n_values ; i++) {
+			ldif_line_out(out, (char *) a->name,
+				      a->values[i].bv_val, a->values[i].bv_len,
+				      writer->error_context);
+			g_string_append_c(out, '\n');
+		}
+	}
+	g_string_append_c(out, '\n');
+}
+
+/* CSV, RFC 4180 */
+
+static void
+csv_field(GString *out, const gchar *text, gsize len)
+{
+	gsize i;
+
+	if (strcspn(text, ",\"\r\n") >= len &&
+	    (len == 0 || (text[0] != ' ' && text[len - 1] != ' '))) {
+		g_string_append_len(out, text, len);
+		return;
+	}
+
+	g_string_append_c(out, '"');
+	for (i = 0 ; i < len ; i++) {
+		if (text[i] == '"') g_string_append_c(out, '"');
+		g_string_append_c(out, text[i]);
+	}
+	g_string_append_c(out, '"');
+}
+
+static void
+csv_begin(GqExportWriter *writer, GString *out, GList *to_export)
+{
+	gchar **c;
+
+	for (c = writer->columns ; c && *c ; c++) {
+		if (c != writer->columns) g_string_append_c(out, ',');
+		csv_field(out, *c, strlen(*c));
+	}
+	g_string_append(out, "\r\n");
+}
+
+/* the attribute a column shows, an exact match of the description
+   wins over one with different options */
+static const GqResultAttr *
+csv_column_attr(const gchar *column, const GqResultAttr *attrs,
+		guint n_attrs)
+{
+	const GqResultAttr *a, *found = NULL;
+	gsize l = strcspn(column, ";");
+
+	for (a = attrs ; a < attrs + n_attrs ; a++) {
+		if (g_ascii_strcasecmp(a->name, column) == 0) return a;
+		if (found == NULL &&
+		    g_ascii_strncasecmp(a->name, column, l) == 0 &&
+		    (a->name[l] == 0 || a->name[l] == ';')) {
+			found = a;
+		}
+	}
+	return found;
+}
+
+static void
+csv_entry(GqExportWriter *writer, GString *out, const gchar *dn,
+	  const GqResultAttr *attrs, guint n_attrs)
+{
+	GString *cell = writer->cell;
+	const GqResultAttr *a;
+	gchar **c;
+	guint i, n;
+
+	for (c = writer->columns ; c && *c ; c++) {
+		if (c != writer->columns) g_string_append_c(out, ',');
+
+		if (g_ascii_strcasecmp(*c, "dn") == 0) {
+			csv_field(out, dn, strlen(dn));
+			continue;
+		}
+
+		a = csv_column_attr(*c, attrs, n_attrs);
+		if (a == NULL) continue;
+
+		n = writer->multi_value == GQ_EXPORT_FIRST_VALUE ?
+			MIN(a->n_values, 1) : a->n_values;
+
+		g_string_truncate(cell, 0);
+		for (i = 0 ; i < n ; i++) {
+			if (i > 0) g_string_append(cell, writer->separator);
+			if (is_binary(&a->values[i])) {
+				b64_encode(cell, a->values[i].bv_val,
+					   a->values[i].bv_len);
+			} else {
+				g_string_append_len(cell, a->values[i].bv_val,
+						    a->values[i].bv_len);
+			}
+		}
+		csv_field(out, cell->str, cell->len);
+	}
+	g_string_append(out, "\r\n");
+}
+
+/* JSON Lines */
+
+static void
+json_string(GString *out, const gchar *text, gsize len)
+{
+	gsize i;
+
+	g_string_append_c(out, '"');
+	for (i = 0 ; i < len ; i++) {
+		guchar c = text[i];
+
+		switch (c) {
+		case '"':	g_string_append(out, "\\\""); break;
+		case '\\':	g_string_append(out, "\\\\"); break;
+		case '\n':	g_string_append(out, "\\n"); break;
+		case '\r':	g_string_append(out, "\\r"); break;
+		case '\t':	g_string_append(out, "\\t"); break;
+		default:
+			if (c < 0x20) {
+				g_string_append_printf(out, "\\u%04x", c);
+			} else {
+				g_string_append_c(out, c);
+			}
+		}
+	}
+	g_string_append_c(out, '"');
+}
+
+/* writes the text or the binary values of attrs as a JSON object */
+static void
+json_attrs(GString *out, const GqResultAttr *attrs, guint n_attrs,
+	   gboolean binary)
+{
+	const GqResultAttr *a;
+	gboolean first_attr = TRUE, first;
+	guint i;
+
+	g_string_append_c(out, '{');
+	for (a = attrs ; a < attrs + n_attrs ; a++) {
+		if (isInternalAttr(a->name)) continue;
+
+		first = TRUE;
+		for (i = 0 ; i < a->n_values ; i++) {
+			if (is_binary(&a->values[i]) != binary) continue;
+
+			if (first) {
+				if (!first_attr) g_string_append_c(out, ',');
+				json_string(out, a->name, strlen(a->name));
+				g_string_append(out, ":[");
+				first_attr = FALSE;
+			} else {
+				g_string_append_c(out, ',');
+			}
+			first = FALSE;
+
+			if (binary) {
+				g_string_append_c(out, '"');
+				b64_encode(out, a->values[i].bv_val,
+					   a->values[i].bv_len);
+				g_string_append_c(out, '"');
+			} else {
+				json_string(out, a->values[i].bv_val,
+					    a->values[i].bv_len);
+			}
+		}
+		if (!first) g_string_append_c(out, ']');
+	}
+	g_string_append_c(out, '}');
+}
+
+static void
+jsonl_entry(GqExportWriter *writer, GString *out, const gchar *dn,
+	    const GqResultAttr *attrs, guint n_attrs)
+{
+	const GqResultAttr *a;
+	gboolean binary = FALSE;
+	guint i;
+
+	for (a = attrs ; a < attrs + n_attrs && !binary ; a++) {
+		if (isInternalAttr(a->name)) continue;
+		for (i = 0 ; i < a->n_values && !binary ; i++) {
+			binary = is_binary(&a->values[i]);
+		}
+	}
+
+	g_string_append(out, "{\"dn\":");
+	json_string(out, dn, strlen(dn));
+	g_string_append(out, ",\"attributes\":");
+	json_attrs(out, attrs, n_attrs, FALSE);
+	if (binary) {
+		g_string_append(out, ",\"binary\":");
+		json_attrs(out, attrs, n_attrs, TRUE);
+	}
+	g_string_append(out, "}\n");
+}
+
+/* DSMLv2 */
+
+/* TRUE if the value can be written as XML 1.0 character data */
+static gboolean
+xml_safe(const struct berval *v)
+{
+	gsize i;
+
+	if (is_binary(v)) return FALSE;
+	for (i = 0 ; i < v->bv_len ; i++) {
+		guchar c = v->bv_val[i];
+		if (c < 0x20 && c != '\t' && c != '\n' && c != '\r') {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static void
+xml_text(GString *out, const gchar *text, gsize len)
+{
+	gsize i;
+
+	for (i = 0 ; i < len ; i++) {
+		switch (text[i]) {
+		case '&':	g_string_append(out, "&amp;"); break;
+		case '<':	g_string_append(out, "&lt;"); break;
+		case '>':	g_string_append(out, "&gt;"); break;
+		case '"':	g_string_append(out, "&quot;"); break;
+		case '\r':	g_string_append(out, "&#13;"); break;
+		default:	g_string_append_c(out, text[i]);
+		}
+	}
+}
+
+static void
+dsml_begin(GqExportWriter *writer, GString *out, GList *to_export)
+{
+	g_string_append(out,
+			"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<batchResponse"
+			" xmlns=\"urn:oasis:names:tc:DSML:2:0:core\""
+			" xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\""
+			" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">\n"
+			" <searchResponse>\n");
+}
+
+static void
+dsml_entry(GqExportWriter *writer, GString *out, const gchar *dn,
+	   const GqResultAttr *attrs, guint n_attrs)
+{
+	const GqResultAttr *a;
+	guint i;
+
+	g_string_append(out, "  <searchResultEntry dn=\"");
+	xml_text(out, dn, strlen(dn));
+	g_string_append(out, "\">\n");
+
+	for (a = attrs ; a < attrs + n_attrs ; a++) {
+		if (isInternalAttr(a->name)) continue;
+
+		g_string_append(out, "   <attr name=\"");
+		xml_text(out, a->name, strlen(a->name));
+		g_string_append(out, "\">\n");
+
+		for (i = 0 ; i < a->n_values ; i++) {
+			if (xml_safe(&a->values[i])) {
+				g_string_append(out, "    <value>");
+				xml_text(out, a->values[i].bv_val,
+					 a->values[i].bv_len);
+			} else {
+				g_string_append(out, "    <value xsi:type=\"xsd:base64Binary\">");
+				b64_encode(out, a->values[i].bv_val,
+					   a->values[i].bv_len);
+			}
+			g_string_append(out, "</value>\n");
+		}
+		g_string_append(out, "   </attr>\n");
+	}
+	g_string_append(out, "  </searchResultEntry>\n");
+}
+
+static void
+dsml_end(GqExportWriter *writer, GString *out)
+{
+	g_string_append(out,
+			"  <searchResultDone>\n"
+			"   <resultCode code=\"0\"/>\n"
+			"  </searchResultDone>\n"
+			" </searchResponse>\n"
+			"</batchResponse>\n");
+}
+
+static const struct export_format formats[GQ_EXPORT_N_FORMATS] = {
+	{ N_("LDIF"),		"ldif",	 ldif_begin, ldif_entry,  NULL },
+	{ N_("CSV"),		"csv",	 csv_begin,  csv_entry,   NULL },
+	{ N_("JSON Lines"),	"jsonl", NULL,	     jsonl_entry, NULL },
+	{ N_("DSMLv2"),		"xml",	 dsml_begin, dsml_entry,  dsml_end },
+};
+
+const gchar *
+gq_export_format_get_name(GqExportFormat format)
+{
+	g_return_val_if_fail(format < GQ_EXPORT_N_FORMATS, NULL);
+
+	return _(formats[format].name);
+}
+
+const gchar *
+gq_export_format_get_extension(GqExportFormat format)
+{
+	g_return_val_if_fail(format < GQ_EXPORT_N_FORMATS, NULL);
+
+	return formats[format].extension;
+}
+
+GqExportWriter *
+gq_export_writer_new(GqExportFormat format, int error_context)
+{
+	GqExportWriter *writer;
+
+	g_return_val_if_fail(format < GQ_EXPORT_N_FORMATS, NULL);
+
+	writer = g_new0(GqExportWriter, 1);
+	writer->format = &formats[format];
+	writer->error_context = error_context;
+	writer->multi_value = GQ_EXPORT_JOIN_VALUES;
+	writer->separator = g_strdup("|");
+	writer->cell = g_string_sized_new(256);
+	writer->attrs = g_array_new(FALSE, FALSE, sizeof(GqResultAttr));
+	writer->values = g_array_new(FALSE, FALSE, sizeof(struct berval));
+	writer->to_free = g_ptr_array_new();
+	writer->names = g_ptr_array_new();
+
+	return writer;
+}
+
+void
+gq_export_writer_free(GqExportWriter *writer)
+{
+	if (writer == NULL) return;
+
+	g_strfreev(writer->columns);
+	g_free(writer->separator);
+	g_string_free(writer->cell, TRUE);
+	g_array_free(writer->attrs, TRUE);
+	g_array_free(writer->values, TRUE);
+	g_ptr_array_free(writer->to_free, TRUE);
+	g_ptr_array_free(writer->names, TRUE);
+	g_free(writer);
+}
+
+void
+gq_export_writer_set_columns(GqExportWriter *writer, gchar **columns)
+{
+	g_return_if_fail(writer != NULL);
+
+	g_strfreev(writer->columns);
+	writer->columns = g_strdupv(columns);
+}
+
+void
+gq_export_writer_set_multi_value(GqExportWriter *writer,
+				 GqExportMultiValue policy,
+				 const gchar *separator)
+{
+	g_return_if_fail(writer != NULL);
+
+	writer->multi_value = policy;
+	g_free(writer->separator);
+	writer->separator = g_strdup(separator ? separator : "");
+}
+
+void
+gq_export_writer_begin(GqExportWriter *writer, GString *out,
+		       GList *to_export)
+{
+	g_return_if_fail(writer != NULL);
+
+	if (writer->format->begin) {
+		writer->format->begin(writer, out, to_export);
+	}
+}
+
+void
+gq_export_writer_entry(GqExportWriter *writer, GString *out,
+		       const GqResultEntry *entry)
+{
+	g_return_if_fail(writer != NULL);
+	g_return_if_fail(entry != NULL);
+
+	writer->format->entry(writer, out, entry->set.dn,
+			      entry->attrs, entry->n_attrs);
+}
+
+gboolean
+gq_export_writer_message(GqExportWriter *writer, GString *out,
+			 LDAP *ld, LDAPMessage *e)
+{
+	BerElement *ber = NULL;
+	struct berval **vals, *bv;
+	char *dn, *attr;
+	guint i, n = 0;
+
+	g_return_val_if_fail(writer != NULL, FALSE);
+
+	dn = ldap_get_dn(ld, e);
+	if (dn == NULL) {
+		error_push(writer->error_context,
+			   _("Cannot retrieve DN of entry."));
+		push_ldap_addl_error(ld, writer->error_context);
+		return FALSE;
+	}
+
+	g_array_set_size(writer->attrs, 0);
+	g_array_set_size(writer->values, 0);
+
+	for (attr = ldap_first_attribute(ld, e, &ber) ; attr != NULL ;
+	     attr = ldap_next_attribute(ld, e, ber)) {
+		GqResultAttr a;
+
+		a.name = attr;
+		a.n_values = 0;
+		a.values = NULL;
+		g_ptr_array_add(writer->names, attr);
+
+		vals = ldap_get_values_len(ld, e, attr);
+		for (i = 0 ; vals && vals[i] ; i++) {
+			g_array_append_val(writer->values, *vals[i]);
+			a.n_values++;
+		}
+		if (vals) g_ptr_array_add(writer->to_free, vals);
+
+		g_array_append_val(writer->attrs, a);
+	}
+#ifndef HAVE_OPENLDAP12
+	if (ber) ber_free(ber, 0);
+#endif
+
+	/* the values array is complete now, point into it */
+	bv = (struct berval *) writer->values->data;
+	for (i = 0 ; i < writer->attrs->len ; i++) {
+		GqResultAttr *a = &g_array_index(writer->attrs, GqResultAttr, i);
+		a->values = bv + n;
+		n += a->n_values;
+	}
+
+	writer->format->entry(writer, out, dn,
+			      (GqResultAttr *) writer->attrs->data,
+			      writer->attrs->len);
+
+	for (i = 0 ; i < writer->to_free->len ; i++) {
+		ldap_value_free_len(g_ptr_array_index(writer->to_free, i));
+	}
+	g_ptr_array_set_size(writer->to_free, 0);
+	for (i = 0 ; i < writer->names->len ; i++) {
+		ldap_memfree(g_ptr_array_index(writer->names, i));
+	}
+	g_ptr_array_set_size(writer->names, 0);
+#if defined(HAVE_LDAP_MEMFREE)
+	ldap_memfree(dn);
+#else
+	free(dn);
+#endif
+
+	return TRUE;
+}
+
+void
+gq_export_writer_end(GqExportWriter *writer, GString *out)
+{
+	g_return_if_fail(writer != NULL);
+
+	if (writer->format->end) {
+		writer->format->end(writer, out);
+	}
+}
@@ -0,0 +1,87 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GQ_EXPORT_WRITER_H
+#define GQ_EXPORT_WRITER_H
+
+#include <glib.h>
+#include <ldap.h>
+
+#include "gq-result-store.h"
+
+G_BEGIN_DECLS
+
+/* Writers for the formats entries can be exported in. A writer turns
+   one entry at a time into text appended to a GString, so exports
+   stream with constant memory no matter how many entries there are.
+
+   CSV writes one row per entry with a fixed set of columns, "dn"
+   being the DN. DSMLv2 writes a batchResponse with one
+   searchResponse. JSON Lines writes one object per entry:
+     {"dn": "...", "attributes": {"cn": ["..."]},
+      "binary": {"jpegPhoto": ["<base64>"]}}
+   Values that are not UTF-8 go to "binary", in CSV they are written
+   base64 encoded. */
+
+typedef enum {
+	GQ_EXPORT_LDIF,
+	GQ_EXPORT_CSV,
+	GQ_EXPORT_JSONL,
+	GQ_EXPORT_DSML,
+	GQ_EXPORT_N_FORMATS
+} GqExportFormat;
+
+/* what CSV does with several values in one cell */
+typedef enum {
+	GQ_EXPORT_JOIN_VALUES,
+	GQ_EXPORT_FIRST_VALUE
+} GqExportMultiValue;
+
+typedef struct _GqExportWriter GqExportWriter;
+
+const gchar    *gq_export_format_get_name(GqExportFormat format);
+/* the usual file name extension, without the dot */
+const gchar    *gq_export_format_get_extension(GqExportFormat format);
+
+GqExportWriter *gq_export_writer_new(GqExportFormat format,
+				     int error_context);
+void            gq_export_writer_free(GqExportWriter *writer);
+
+/* CSV only: the columns, and how to put several values into one */
+void            gq_export_writer_set_columns(GqExportWriter *writer,
+					     gchar **columns);
+void            gq_export_writer_set_multi_value(GqExportWriter *writer,
+						 GqExportMultiValue policy,
+						 const gchar *separator);
+
+/* to_export is a GList of dn_on_server objects, for the header */
+void            gq_export_writer_begin(GqExportWriter *writer, GString *out,
+				       GList *to_export);
+void            gq_export_writer_entry(GqExportWriter *writer, GString *out,
+				       const GqResultEntry *entry);
+gboolean        gq_export_writer_message(GqExportWriter *writer,
+					 GString *out,
+					 LDAP *ld, LDAPMessage *e);
+void            gq_export_writer_end(GqExportWriter *writer, GString *out);
+
+G_END_DECLS
+
+#endif /* !GQ_EXPORT_WRITER_H */
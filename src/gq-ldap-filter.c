@@ -0,0 +1,1206 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gq-ldap-filter.h"
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <string.h>
+
+#include <glib/gi18n.h>
+
+#include "schema.h"
+#include "util.h"
+
+typedef enum {
+	FILTER_AND,
+	FILTER_OR,
+	FILTER_NOT,
+	FILTER_EQUALITY,
+	FILTER_SUBSTRINGS,
+	FILTER_GREATER,
+	FILTER_LESS,
+	FILTER_PRESENT,
+	FILTER_APPROX,
+	FILTER_EXTENSIBLE
+} FilterType;
+
+/* how values get prepared and compared */
+typedef enum {
+	MATCH_CASE_IGNORE,
+	MATCH_CASE_EXACT,
+	MATCH_NUMERIC,		/* spaces are insignificant */
+	MATCH_TELEPHONE,	/* spaces and hyphens too, case ignored */
+	MATCH_INTEGER,
+	MATCH_TIME,		/* GeneralizedTime, compared in UTC */
+	MATCH_DN,
+	MATCH_OCTET
+} MatchKind;
+
+/* RFC 4511 filters are three-valued */
+typedef enum {
+	EVAL_FALSE,
+	EVAL_TRUE,
+	EVAL_UNDEFINED
+} EvalResult;
+
+typedef struct _FilterNode FilterNode;
+
+struct _FilterNode {
+	FilterType type;
+	FilterNode *children;		/* AND, OR, NOT */
+	FilterNode *next;
+
+	gchar *attr;			/* may be NULL for extensible */
+	gchar *rule;			/* extensible only */
+	gboolean dn_attrs;		/* extensible ":dn" */
+
+	/* unescaped assertion; substrings use initial/any/final */
+	GString *value;
+	GString *initial;
+	GPtrArray *any;			/* GString* */
+	GString *final;
+
+	/* set up by gq_filter_bind() */
+	gchar **names;			/* attribute, aliases, subtypes */
+	const gchar *options;		/* points into attr, or NULL */
+	MatchKind kind;
+	gboolean valid;			/* assertion fits kind */
+	GString *norm_value;
+	GString *norm_initial;
+	GPtrArray *norm_any;
+	GString *norm_final;
+};
+
+struct _GqFilter {
+	FilterNode *root;
+	GString *scratch;
+};
+
+static const struct {
+	const char *name;
+	const char *oid;
+	MatchKind kind;
+} matching_rules[] = {
+	{ "objectIdentifierMatch",	     "2.5.13.0",  MATCH_CASE_IGNORE },
+	{ "distinguishedNameMatch",	     "2.5.13.1",  MATCH_DN },
+	{ "caseIgnoreMatch",		     "2.5.13.2",  MATCH_CASE_IGNORE },
+	{ "caseIgnoreOrderingMatch",	     "2.5.13.3",  MATCH_CASE_IGNORE },
+	{ "caseIgnoreSubstringsMatch",	     "2.5.13.4",  MATCH_CASE_IGNORE },
+	{ "caseExactMatch",		     "2.5.13.5",  MATCH_CASE_EXACT },
+	{ "caseExactOrderingMatch",	     "2.5.13.6",  MATCH_CASE_EXACT },
+	{ "caseExactSubstringsMatch",	     "2.5.13.7",  MATCH_CASE_EXACT },
+	{ "numericStringMatch",		     "2.5.13.8",  MATCH_NUMERIC },
+	{ "numericStringOrderingMatch",	     "2.5.13.9",  MATCH_NUMERIC },
+	{ "numericStringSubstringsMatch",    "2.5.13.10", MATCH_NUMERIC },
+	{ "caseIgnoreListMatch",	     "2.5.13.11", MATCH_CASE_IGNORE },
+	{ "caseIgnoreListSubstringsMatch",   "2.5.13.12", MATCH_CASE_IGNORE },
+	{ "booleanMatch",		     "2.5.13.13", MATCH_CASE_IGNORE },
+	{ "integerMatch",		     "2.5.13.14", MATCH_INTEGER },
+	{ "integerOrderingMatch",	     "2.5.13.15", MATCH_INTEGER },
+	{ "bitStringMatch",		     "2.5.13.16", MATCH_OCTET },
+	{ "octetStringMatch",		     "2.5.13.17", MATCH_OCTET },
+	{ "octetStringOrderingMatch",	     "2.5.13.18", MATCH_OCTET },
+	{ "octetStringSubstringsMatch",	     "2.5.13.19", MATCH_OCTET },
+	{ "telephoneNumberMatch",	     "2.5.13.20", MATCH_TELEPHONE },
+	{ "telephoneNumberSubstringsMatch",  "2.5.13.21", MATCH_TELEPHONE },
+	{ "uniqueMemberMatch",		     "2.5.13.23", MATCH_DN },
+	{ "generalizedTimeMatch",	     "2.5.13.27", MATCH_TIME },
+	{ "generalizedTimeOrderingMatch",    "2.5.13.28", MATCH_TIME },
+	{ "integerFirstComponentMatch",	     "2.5.13.29", MATCH_INTEGER },
+	{ "objectIdentifierFirstComponentMatch", "2.5.13.30", MATCH_CASE_IGNORE },
+	{ "caseExactIA5Match",		     "1.3.6.1.4.1.1466.109.114.1", MATCH_CASE_EXACT },
+	{ "caseIgnoreIA5Match",		     "1.3.6.1.4.1.1466.109.114.2", MATCH_CASE_IGNORE },
+	{ "caseIgnoreIA5SubstringsMatch",    "1.3.6.1.4.1.1466.109.114.3", MATCH_CASE_IGNORE },
+	{ "caseExactIA5SubstringsMatch",     "1.3.6.1.4.1.4203.1.2.1", MATCH_CASE_EXACT },
+	{ NULL, NULL, MATCH_CASE_IGNORE }
+};
+
+static gboolean
+lookup_rule(const gchar *rule, MatchKind *kind)
+{
+	int i;
+
+	if (rule == NULL) return FALSE;
+	for (i = 0 ; matching_rules[i].name ; i++) {
+		if (g_ascii_strcasecmp(rule, matching_rules[i].name) == 0 ||
+		    strcmp(rule, matching_rules[i].oid) == 0) {
+			*kind = matching_rules[i].kind;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+
+/* parsing */
+
+typedef struct {
+	const gchar *text;
+	const gchar *p;
+	gchar *error;
+} Parser;
+
+static void
+parse_error(Parser *parser, const gchar *msg)
+{
+	if (parser->error) return;
+	parser->error = g_strdup_printf(_("%1$s at position %2$d"), msg,
+					(int) (parser->p - parser->text) + 1);
+}
+
+static void
+skip_space(Parser *parser)
+{
+	while (*parser->p == ' ') parser->p++;
+}
+
+static void
+free_node(FilterNode *node)
+{
+	FilterNode *c, *next;
+	guint i;
+
+	if (node == NULL) return;
+
+	for (c = node->children ; c ; c = next) {
+		next = c->next;
+		free_node(c);
+	}
+	g_free(node->attr);
+	g_free(node->rule);
+	if (node->value) g_string_free(node->value, TRUE);
+	if (node->initial) g_string_free(node->initial, TRUE);
+	if (node->final) g_string_free(node->final, TRUE);
+	if (node->any) {
+		for (i = 0 ; i < node->any->len ; i++) {
+			g_string_free(g_ptr_array_index(node->any, i), TRUE);
+		}
+		g_ptr_array_free(node->any, TRUE);
+	}
+	g_strfreev(node->names);
+	if (node->norm_value) g_string_free(node->norm_value, TRUE);
+	if (node->norm_initial) g_string_free(node->norm_initial, TRUE);
+	if (node->norm_final) g_string_free(node->norm_final, TRUE);
+	if (node->norm_any) {
+		for (i = 0 ; i < node->norm_any->len ; i++) {
+			g_string_free(g_ptr_array_index(node->norm_any, i), TRUE);
+		}
+		g_ptr_array_free(node->norm_any, TRUE);
+	}
+	g_free(node);
+}
+
+static gboolean
+is_descr_char(gchar c)
+{
+	return g_ascii_isalnum(c) || c == '-' || c == '.' || c == ';' ||
+		c == '_';
+}
+
+static gchar *
+parse_descr(Parser *parser)
+{
+	const gchar *start = parser->p;
+
+	while (is_descr_char(*parser->p)) parser->p++;
+	return g_strndup(start, parser->p - start);
+}
+
+static int
+hexval(gchar c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+/* reads an assertion value up to the closing parenthesis. With
+   stars != NULL unescaped '*' split the value into the pieces
+   collected there, otherwise they are taken literally. */
+static GString *
+parse_value(Parser *parser, GPtrArray *stars)
+{
+	GString *v = g_string_new("");
+
+	for (;;) {
+		gchar c = *parser->p;
+
+		if (c == 0) {
+			parse_error(parser, _("Missing ')'"));
+			break;
+		}
+		if (c == ')') break;
+		if (c == '(') {
+			parse_error(parser, _("Unescaped '(' in assertion value"));
+			break;
+		}
+		if (c == '*' && stars) {
+			g_ptr_array_add(stars, v);
+			v = g_string_new("");
+			parser->p++;
+			continue;
+		}
+		if (c == '\\') {
+			int h = hexval(parser->p[1]);
+			int l = h >= 0 ? hexval(parser->p[2]) : -1;
+
+			if (h >= 0 && l >= 0) {
+				g_string_append_c(v, (gchar) (h * 16 + l));
+				parser->p += 3;
+				continue;
+			}
+			/* RFC 1960 style escapes */
+			if (parser->p[1] == '*' || parser->p[1] == '(' ||
+			    parser->p[1] == ')' || parser->p[1] == '\\') {
+				g_string_append_c(v, parser->p[1]);
+				parser->p += 2;
+				continue;
+			}
+			parse_error(parser, _("Invalid escape sequence"));
+			break;
+		}
+		g_string_append_c(v, c);
+		parser->p++;
+	}
+
+	return v;
+}
+
+static FilterNode *parse_filter(Parser *parser);
+
+static FilterNode *
+parse_item(Parser *parser)
+{
+	FilterNode *node = g_new0(FilterNode, 1);
+	GPtrArray *pieces;
+	GString *last;
+	guint i;
+
+	node->attr = parse_descr(parser);
+
+	if (*parser->p == ':') {
+		node->type = FILTER_EXTENSIBLE;
+		if (g_ascii_strncasecmp(parser->p, ":dn", 3) == 0 &&
+		    (parser->p[3] == ':')) {
+			node->dn_attrs = TRUE;
+			parser->p += 3;
+		}
+		if (parser->p[0] == ':' && parser->p[1] != '=') {
+			parser->p++;
+			node->rule = parse_descr(parser);
+			if (node->rule[0] == 0) {
+				parse_error(parser, _("Missing matching rule"));
+				return node;
+			}
+		}
+		if (strncmp(parser->p, ":=", 2) != 0) {
+			parse_error(parser, _("Expected ':='"));
+			return node;
+		}
+		parser->p += 2;
+		if (node->attr[0] == 0) {
+			g_free(node->attr);
+			node->attr = NULL;
+			if (node->rule == NULL) {
+				parse_error(parser, _("Extensible match without attribute or matching rule"));
+				return node;
+			}
+		}
+		node->value = parse_value(parser, NULL);
+		return node;
+	}
+
+	if (node->attr[0] == 0) {
+		parse_error(parser, _("Missing attribute description"));
+		return node;
+	}
+
+	switch (*parser->p) {
+	case '~':
+		node->type = FILTER_APPROX;
+		parser->p++;
+		break;
+	case '>':
+		node->type = FILTER_GREATER;
+		parser->p++;
+		break;
+	case '<':
+		node->type = FILTER_LESS;
+		parser->p++;
+		break;
+	case '=':
+		node->type = FILTER_EQUALITY;
+		break;
+	default:
+		parse_error(parser, _("Invalid character in attribute description"));
+		return node;
+	}
+	if (*parser->p != '=') {
+		parse_error(parser, _("Expected '='"));
+		return node;
+	}
+	parser->p++;
+
+	if (node->type != FILTER_EQUALITY) {
+		node->value = parse_value(parser, NULL);
+		return node;
+	}
+
+	pieces = g_ptr_array_new();
+	last = parse_value(parser, pieces);
+
+	if (pieces->len == 0) {
+		node->value = last;
+	} else if (pieces->len == 1 && last->len == 0 &&
+		   ((GString *) g_ptr_array_index(pieces, 0))->len == 0) {
+		node->type = FILTER_PRESENT;
+		g_string_free(g_ptr_array_index(pieces, 0), TRUE);
+		g_string_free(last, TRUE);
+	} else {
+		node->type = FILTER_SUBSTRINGS;
+		node->any = g_ptr_array_new();
+		for (i = 0 ; i < pieces->len ; i++) {
+			GString *s = g_ptr_array_index(pieces, i);
+			if (i == 0) {
+				node->initial = s;
+			} else if (s->len == 0) {
+				parse_error(parser, _("Empty substring"));
+				g_string_free(s, TRUE);
+			} else {
+				g_ptr_array_add(node->any, s);
+			}
+		}
+		node->final = last;
+	}
+	g_ptr_array_free(pieces, TRUE);
+
+	return node;
+}
+
+static FilterNode *
+parse_list(Parser *parser, FilterType type)
+{
+	FilterNode *node = g_new0(FilterNode, 1), **tail = &node->children;
+
+	node->type = type;
+	skip_space(parser);
+	while (*parser->p == '(' && parser->error == NULL) {
+		*tail = parse_filter(parser);
+		tail = &(*tail)->next;
+		skip_space(parser);
+	}
+	if (type == FILTER_NOT && (node->children == NULL ||
+				   node->children->next != NULL)) {
+		parse_error(parser, _("'!' takes exactly one filter"));
+	}
+	return node;
+}
+
+static FilterNode *
+parse_filter(Parser *parser)
+{
+	FilterNode *node;
+
+	skip_space(parser);
+	if (*parser->p != '(') {
+		parse_error(parser, _("Expected '('"));
+		return g_new0(FilterNode, 1);
+	}
+	parser->p++;
+	skip_space(parser);
+
+	switch (*parser->p) {
+	case '&':
+		parser->p++;
+		node = parse_list(parser, FILTER_AND);
+		break;
+	case '|':
+		parser->p++;
+		node = parse_list(parser, FILTER_OR);
+		break;
+	case '!':
+		parser->p++;
+		node = parse_list(parser, FILTER_NOT);
+		break;
+	default:
+		node = parse_item(parser);
+		break;
+	}
+
+	if (parser->error == NULL) {
+		skip_space(parser);
+		if (*parser->p != ')') {
+			parse_error(parser, _("Missing ')'"));
+		} else {
+			parser->p++;
+		}
+	}
+	return node;
+}
+
+GqFilter *
+gq_filter_compile(const gchar *text, gchar **error)
+{
+	Parser parser;
+	FilterNode *root;
+	GqFilter *filter;
+
+	g_return_val_if_fail(text != NULL, NULL);
+
+	parser.text = parser.p = text;
+	parser.error = NULL;
+
+	root = parse_filter(&parser);
+	if (parser.error == NULL) {
+		skip_space(&parser);
+		if (*parser.p) {
+			parse_error(&parser, _("Unexpected text after the filter"));
+		}
+	}
+
+	if (parser.error) {
+		free_node(root);
+		if (error) {
+			*error = parser.error;
+		} else {
+			g_free(parser.error);
+		}
+		return NULL;
+	}
+
+	filter = g_new0(GqFilter, 1);
+	filter->root = root;
+	filter->scratch = g_string_sized_new(256);
+	return filter;
+}
+
+void
+gq_filter_free(GqFilter *filter)
+{
+	if (filter == NULL) return;
+	free_node(filter->root);
+	g_string_free(filter->scratch, TRUE);
+	g_free(filter);
+}
+
+static void
+collect_attributes(FilterNode *node, GList **list)
+{
+	FilterNode *c;
+
+	if (node->attr) *list = g_list_append(*list, node->attr);
+	for (c = node->children ; c ; c = c->next) {
+		collect_attributes(c, list);
+	}
+}
+
+GList *
+gq_filter_get_attributes(GqFilter *filter)
+{
+	GList *list = NULL;
+
+	g_return_val_if_fail(filter != NULL, NULL);
+	collect_attributes(filter->root, &list);
+	return list;
+}
+
+
+/* value preparation, see RFC 4518 for the real thing */
+
+/* collapses runs of spaces into one and drops leading and trailing
+   ones */
+static void
+squeeze_spaces(GString *s)
+{
+	gsize i, o = 0;
+	gboolean space = TRUE;
+
+	for (i = 0 ; i < s->len ; i++) {
+		if (s->str[i] == ' ') {
+			if (!space) s->str[o++] = ' ';
+			space = TRUE;
+		} else {
+			s->str[o++] = s->str[i];
+			space = FALSE;
+		}
+	}
+	if (o > 0 && s->str[o - 1] == ' ') o--;
+	g_string_truncate(s, o);
+}
+
+static gboolean
+fold_case(const gchar *in, gsize len, GString *out)
+{
+	gsize i;
+	gchar *folded;
+
+	for (i = 0 ; i < len ; i++) {
+		if ((guchar) in[i] >= 0x80) break;
+	}
+	if (i == len) {
+		/* plain ASCII, the common case */
+		g_string_set_size(out, len);
+		for (i = 0 ; i < len ; i++) {
+			out->str[i] = g_ascii_tolower(in[i]);
+		}
+		return TRUE;
+	}
+
+	if (!g_utf8_validate(in, len, NULL)) return FALSE;
+	folded = g_utf8_casefold(in, len);
+	g_string_assign(out, folded);
+	g_free(folded);
+	return TRUE;
+}
+
+static void
+strip_chars(GString *s, const gchar *chars)
+{
+	gsize i, o = 0;
+
+	for (i = 0 ; i < s->len ; i++) {
+		if (strchr(chars, s->str[i]) == NULL) s->str[o++] = s->str[i];
+	}
+	g_string_truncate(s, o);
+}
+
+static gboolean
+normalize_integer(GString *s)
+{
+	gsize i = 0, start;
+	gboolean neg = FALSE;
+
+	squeeze_spaces(s);
+	if (s->len > 0 && s->str[0] == '-') {
+		neg = TRUE;
+		i = 1;
+	}
+	if (i == s->len) return FALSE;
+	for (start = i ; i < s->len ; i++) {
+		if (!g_ascii_isdigit(s->str[i])) return FALSE;
+	}
+	while (start < s->len - 1 && s->str[start] == '0') start++;
+	g_string_erase(s, 0, start);
+	if (neg && strcmp(s->str, "0") != 0) g_string_prepend_c(s, '-');
+	return TRUE;
+}
+
+static int
+digits(const gchar **p, int n)
+{
+	int v = 0;
+
+	while (n--) {
+		if (!g_ascii_isdigit(**p)) return -1;
+		v = v * 10 + (*(*p)++ - '0');
+	}
+	return v;
+}
+
+/* turns a GeneralizedTime into YYYYMMDDHHMMSS[.fraction] UTC */
+static gboolean
+normalize_time(GString *s)
+{
+	const gchar *p = s->str;
+	int year, mon, day, hour, min = 0, sec = 0, offset = 0;
+	int unit = 3600;	/* seconds the fraction is a part of */
+	GString *frac = g_string_new("");
+	gint64 t;
+
+	year = digits(&p, 4);
+	mon = digits(&p, 2);
+	day = digits(&p, 2);
+	hour = digits(&p, 2);
+	if (year < 0 || mon < 1 || mon > 12 || day < 1 || day > 31 ||
+	    hour < 0 || hour > 23) goto bad;
+	if (g_ascii_isdigit(*p)) {
+		if ((min = digits(&p, 2)) < 0) goto bad;
+		unit = 60;
+		if (g_ascii_isdigit(*p)) {
+			if ((sec = digits(&p, 2)) < 0) goto bad;
+			unit = 1;
+		}
+	}
+	if (*p == '.' || *p == ',') {
+		int i, carry = 0;
+
+		for (p++ ; g_ascii_isdigit(*p) ; p++) {
+			g_string_append_c(frac, *p);
+		}
+		/* a fraction of an hour or minute: scale it to seconds,
+		   digit by digit so nothing gets rounded */
+		for (i = frac->len - 1 ; i >= 0 ; i--) {
+			int v = (frac->str[i] - '0') * unit + carry;
+			frac->str[i] = '0' + v % 10;
+			carry = v / 10;
+		}
+		sec += carry;
+		while (frac->len && frac->str[frac->len - 1] == '0') {
+			g_string_truncate(frac, frac->len - 1);
+		}
+	}
+	if (*p == 'Z') {
+		p++;
+	} else if (*p == '+' || *p == '-') {
+		int sign = *p++ == '-' ? -1 : 1;
+		int oh = digits(&p, 2), om = 0;
+		if (oh < 0) goto bad;
+		if (g_ascii_isdigit(*p) && (om = digits(&p, 2)) < 0) goto bad;
+		offset = sign * (oh * 60 + om) * 60;
+	} else {
+		goto bad;		/* local time cannot be compared */
+	}
+	if (*p) goto bad;
+
+	t = days_from_civil(year, mon, day) * 86400 +
+		hour * 3600 + min * 60 + sec - offset;
+	{
+		gint64 days = t >= 0 ? t / 86400 : (t - 86399) / 86400;
+		gint64 rest = t - days * 86400;
+		/* back to a civil date */
+		gint64 z = days + 719468;
+		gint64 era = (z >= 0 ? z : z - 146096) / 146097;
+		gint64 doe = z - era * 146097;
+		gint64 yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+		gint64 doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+		gint64 mp = (5 * doy + 2) / 153;
+		int d = doy - (153 * mp + 2) / 5 + 1;
+		int m = mp < 10 ? mp + 3 : mp - 9;
+		gint64 y = yoe + era * 400 + (m <= 2);
+
+		g_string_printf(s, "%04d%02d%02d%02d%02d%02d",
+				(int) y, m, d, (int) (rest / 3600),
+				(int) (rest / 60 % 60), (int) (rest % 60));
+	}
+	if (frac->len) {
+		g_string_append_c(s, '.');
+		g_string_append(s, frac->str);
+	}
+	g_string_free(frac, TRUE);
+	return TRUE;
+
+ bad:
+	g_string_free(frac, TRUE);
+	return FALSE;
+}
+
+/* removes the spaces around the separators of a DN */
+static void
+normalize_dn(GString *s)
+{
+	gsize i, o = 0;
+
+	for (i = 0 ; i < s->len ; i++) {
+		gchar c = s->str[i];
+		if (c == ' ') {
+			gsize j = i;
+			while (j < s->len && s->str[j] == ' ') j++;
+			if (o == 0 || j == s->len ||
+			    strchr(",+=", s->str[o - 1]) ||
+			    strchr(",+=", s->str[j])) {
+				i = j - 1;
+				continue;
+			}
+		}
+		s->str[o++] = c;
+	}
+	g_string_truncate(s, o);
+}
+
+/* prepares a value for comparison, FALSE if it does not fit the
+   syntax kind stands for */
+static gboolean
+normalize(MatchKind kind, const gchar *in, gsize len, GString *out)
+{
+	switch (kind) {
+	case MATCH_OCTET:
+		g_string_truncate(out, 0);
+		g_string_append_len(out, in, len);
+		return TRUE;
+	case MATCH_CASE_EXACT:
+		g_string_truncate(out, 0);
+		g_string_append_len(out, in, len);
+		squeeze_spaces(out);
+		return TRUE;
+	case MATCH_NUMERIC:
+		g_string_truncate(out, 0);
+		g_string_append_len(out, in, len);
+		strip_chars(out, " ");
+		return TRUE;
+	case MATCH_TELEPHONE:
+		if (!fold_case(in, len, out)) return FALSE;
+		strip_chars(out, " -");
+		return TRUE;
+	case MATCH_INTEGER:
+		g_string_truncate(out, 0);
+		g_string_append_len(out, in, len);
+		return normalize_integer(out);
+	case MATCH_TIME:
+		g_string_truncate(out, 0);
+		g_string_append_len(out, in, len);
+		return normalize_time(out);
+	case MATCH_DN:
+		if (!fold_case(in, len, out)) return FALSE;
+		normalize_dn(out);
+		return TRUE;
+	case MATCH_CASE_IGNORE:
+	default:
+		if (!fold_case(in, len, out)) return FALSE;
+		squeeze_spaces(out);
+		return TRUE;
+	}
+}
+
+static int
+compare_values(MatchKind kind, const GString *a, const GString *b)
+{
+	if (kind == MATCH_INTEGER) {
+		gboolean na = a->str[0] == '-', nb = b->str[0] == '-';
+		int c;
+
+		if (na != nb) return na ? -1 : 1;
+		if (a->len != b->len) {
+			c = a->len < b->len ? -1 : 1;
+		} else {
+			c = memcmp(a->str, b->str, a->len);
+		}
+		return na ? -c : c;
+	} else {
+		gsize l = MIN(a->len, b->len);
+		int c = memcmp(a->str, b->str, l);
+
+		if (c) return c;
+		return a->len == b->len ? 0 : (a->len < b->len ? -1 : 1);
+	}
+}
+
+
+/* binding to a schema */
+
+#ifdef HAVE_LDAP_STR2OBJECTCLASS
+
+/* index is the at_by_name of the schema: names and OIDs, any case */
+static LDAPAttributeType *
+lookup_at(GHashTable *index, const gchar *name)
+{
+	return g_hash_table_lookup(index, name);
+}
+
+/* the matching rule of at for the type of assertion, inherited from
+   the supertypes if need be */
+static gboolean
+schema_rule(GHashTable *index, LDAPAttributeType *at, FilterType type,
+	    MatchKind *kind)
+{
+	int depth;
+
+	for (depth = 0 ; at && depth < 16 ; depth++) {
+		const char *rule = NULL;
+
+		switch (type) {
+		case FILTER_SUBSTRINGS:
+			rule = at->at_substr_oid;
+			break;
+		case FILTER_GREATER:
+		case FILTER_LESS:
+			rule = at->at_ordering_oid;
+			break;
+		default:
+			break;
+		}
+		/* no ordering/substring rule: equality is the best
+		   guess we have */
+		if (rule == NULL) rule = at->at_equality_oid;
+		if (lookup_rule(rule, kind)) return TRUE;
+		if (rule) return FALSE;	/* a rule we cannot do */
+
+		at = at->at_sup_oid ? lookup_at(index, at->at_sup_oid) : NULL;
+	}
+	return FALSE;
+}
+
+static gboolean
+is_subtype(GHashTable *index, LDAPAttributeType *at, LDAPAttributeType *of)
+{
+	int depth;
+
+	for (depth = 0 ; at && depth < 16 ; depth++) {
+		if (at == of) return TRUE;
+		at = at->at_sup_oid ? lookup_at(index, at->at_sup_oid) : NULL;
+	}
+	return FALSE;
+}
+
+/* all names of at and its subtypes */
+static gchar **
+schema_names(struct server_schema *ss, GHashTable *index,
+	     LDAPAttributeType *of)
+{
+	GPtrArray *names = g_ptr_array_new();
+	GList *I;
+	char **n;
+
+	for (I = ss->at ; I ; I = g_list_next(I)) {
+		LDAPAttributeType *at = I->data;
+
+		if (at == NULL || !is_subtype(index, at, of)) continue;
+		if (at->at_oid) g_ptr_array_add(names, g_strdup(at->at_oid));
+		for (n = at->at_names ; n && *n ; n++) {
+			g_ptr_array_add(names, g_strdup(*n));
+		}
+	}
+	g_ptr_array_add(names, NULL);
+	return (gchar **) g_ptr_array_free(names, FALSE);
+}
+
+#endif /* HAVE_LDAP_STR2OBJECTCLASS */
+
+static GString *
+normalized(MatchKind kind, const GString *in, gboolean *valid)
+{
+	GString *out = g_string_new("");
+
+	if (!normalize(kind, in->str, in->len, out)) *valid = FALSE;
+	return out;
+}
+
+static gboolean
+bind_node(FilterNode *node, struct server_schema *ss, GHashTable *index,
+	  gchar **error)
+{
+	FilterNode *c;
+	gchar *base = NULL;
+	gboolean have_rule = FALSE;
+	guint i;
+
+	for (c = node->children ; c ; c = c->next) {
+		if (!bind_node(c, ss, index, error)) return FALSE;
+	}
+	if (node->type == FILTER_AND || node->type == FILTER_OR ||
+	    node->type == FILTER_NOT) {
+		return TRUE;
+	}
+
+	/* forget an earlier binding */
+	g_strfreev(node->names);
+	node->names = NULL;
+	if (node->norm_value) g_string_free(node->norm_value, TRUE);
+	if (node->norm_initial) g_string_free(node->norm_initial, TRUE);
+	if (node->norm_final) g_string_free(node->norm_final, TRUE);
+	node->norm_value = node->norm_initial = node->norm_final = NULL;
+	if (node->norm_any) {
+		for (i = 0 ; i < node->norm_any->len ; i++) {
+			g_string_free(g_ptr_array_index(node->norm_any, i), TRUE);
+		}
+		g_ptr_array_free(node->norm_any, TRUE);
+		node->norm_any = NULL;
+	}
+
+	node->kind = MATCH_CASE_IGNORE;
+	node->options = NULL;
+
+	if (node->rule) {
+		if (!lookup_rule(node->rule, &node->kind)) {
+			if (error) {
+				*error = g_strdup_printf(_("Matching rule '%s' cannot be evaluated locally"),
+							 node->rule);
+			}
+			return FALSE;
+		}
+		have_rule = TRUE;
+	}
+
+	if (node->attr) {
+		gsize l = strcspn(node->attr, ";");
+
+		base = g_strndup(node->attr, l);
+		if (node->attr[l]) node->options = node->attr + l;
+#ifdef HAVE_LDAP_STR2OBJECTCLASS
+		if (index) {
+			LDAPAttributeType *at = lookup_at(index, base);
+			if (at) {
+				if (!have_rule) {
+					schema_rule(index, at, node->type,
+						    &node->kind);
+				}
+				node->names = schema_names(ss, index, at);
+			}
+		}
+#endif /* HAVE_LDAP_STR2OBJECTCLASS */
+		if (node->names == NULL) {
+			node->names = g_new0(gchar *, 2);
+			node->names[0] = base;
+			base = NULL;
+		}
+		g_free(base);
+	}
+
+	/* integers and times have no substrings */
+	if (node->type == FILTER_SUBSTRINGS &&
+	    (node->kind == MATCH_INTEGER || node->kind == MATCH_TIME)) {
+		node->kind = MATCH_CASE_IGNORE;
+	}
+	if (node->type == FILTER_APPROX &&
+	    (node->kind == MATCH_CASE_EXACT || node->kind == MATCH_OCTET)) {
+		node->kind = MATCH_CASE_IGNORE;
+	}
+
+	node->valid = TRUE;
+	if (node->value) {
+		node->norm_value = normalized(node->kind, node->value,
+					      &node->valid);
+	}
+	if (node->type == FILTER_SUBSTRINGS) {
+		/* the pieces are not values on their own, only fold them */
+		MatchKind k = node->kind;
+		if (k == MATCH_DN) k = MATCH_CASE_IGNORE;
+
+		node->norm_initial = normalized(k, node->initial, &node->valid);
+		node->norm_final = normalized(k, node->final, &node->valid);
+		node->norm_any = g_ptr_array_new();
+		for (i = 0 ; i < node->any->len ; i++) {
+			g_ptr_array_add(node->norm_any,
+					normalized(k, g_ptr_array_index(node->any, i),
+						   &node->valid));
+		}
+	}
+	return TRUE;
+}
+
+gboolean
+gq_filter_bind(GqFilter *filter, struct server_schema *ss, gchar **error)
+{
+	GHashTable *index = NULL;
+	gboolean ok;
+
+	g_return_val_if_fail(filter != NULL, FALSE);
+
+#ifdef HAVE_LDAP_STR2OBJECTCLASS
+	if (ss) index = ss->at_by_name;
+#endif /* HAVE_LDAP_STR2OBJECTCLASS */
+
+	ok = bind_node(filter->root, ss, index, error);
+
+	return ok;
+}
+
+
+/* evaluation */
+
+/* does the attribute description of an entry fall under node? */
+static gboolean
+attr_applies(const FilterNode *node, const gchar *desc)
+{
+	gsize l = strcspn(desc, ";");
+	gchar **n;
+
+	if (node->options) {
+		/* only exactly these options, good enough */
+		if (g_ascii_strcasecmp(desc + l, node->options) != 0) {
+			return FALSE;
+		}
+	}
+	for (n = node->names ; n && *n ; n++) {
+		if (g_ascii_strncasecmp(*n, desc, l) == 0 && (*n)[l] == 0) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static gboolean
+find_piece(const GString *hay, gsize *pos, const GString *needle,
+	   gsize limit)
+{
+	gsize i;
+
+	if (needle->len == 0) return TRUE;
+	for (i = *pos ; i + needle->len <= limit ; i++) {
+		if (memcmp(hay->str + i, needle->str, needle->len) == 0) {
+			*pos = i + needle->len;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static EvalResult
+match_value(GqFilter *filter, const FilterNode *node,
+	    const gchar *val, gsize len)
+{
+	GString *v = filter->scratch;
+	gsize pos = 0, limit;
+	guint i;
+	MatchKind k = node->kind;
+
+	if (node->type == FILTER_SUBSTRINGS && k == MATCH_DN) {
+		k = MATCH_CASE_IGNORE;
+	}
+	if (!normalize(k, val, len, v)) return EVAL_UNDEFINED;
+
+	switch (node->type) {
+	case FILTER_EQUALITY:
+	case FILTER_APPROX:
+	case FILTER_EXTENSIBLE:
+		return compare_values(k, v, node->norm_value) == 0 ?
+			EVAL_TRUE : EVAL_FALSE;
+	case FILTER_GREATER:
+		return compare_values(k, v, node->norm_value) >= 0 ?
+			EVAL_TRUE : EVAL_FALSE;
+	case FILTER_LESS:
+		return compare_values(k, v, node->norm_value) <= 0 ?
+			EVAL_TRUE : EVAL_FALSE;
+	case FILTER_SUBSTRINGS:
+		if (v->len < node->norm_initial->len + node->norm_final->len) {
+			return EVAL_FALSE;
+		}
+		if (memcmp(v->str, node->norm_initial->str,
+			   node->norm_initial->len) != 0) {
+			return EVAL_FALSE;
+		}
+		limit = v->len - node->norm_final->len;
+		if (memcmp(v->str + limit, node->norm_final->str,
+			   node->norm_final->len) != 0) {
+			return EVAL_FALSE;
+		}
+		pos = node->norm_initial->len;
+		for (i = 0 ; i < node->norm_any->len ; i++) {
+			if (!find_piece(v, &pos, g_ptr_array_index(node->norm_any, i),
+					limit)) {
+				return EVAL_FALSE;
+			}
+		}
+		return EVAL_TRUE;
+	default:
+		return EVAL_UNDEFINED;
+	}
+}
+
+/* extensible matches with ":dn" also look at the RDNs of the DN */
+static EvalResult
+match_dn_attrs(GqFilter *filter, const FilterNode *node, const gchar *dn)
+{
+	EvalResult r = EVAL_FALSE;
+	char **rdns = gq_ldap_explode_dn(dn, FALSE);
+	int i;
+
+	for (i = 0 ; rdns && rdns[i] && r != EVAL_TRUE ; i++) {
+		gchar **avas = g_strsplit(rdns[i], "+", -1);
+		int j;
+
+		for (j = 0 ; avas[j] && r != EVAL_TRUE ; j++) {
+			gchar *eq = strchr(avas[j], '=');
+			gchar *type;
+
+			if (eq == NULL) continue;
+			type = g_strstrip(g_strndup(avas[j], eq - avas[j]));
+			if (node->names == NULL || attr_applies(node, type)) {
+				EvalResult m = match_value(filter, node, eq + 1,
+							   strlen(eq + 1));
+				if (m == EVAL_TRUE || r == EVAL_FALSE) r = m;
+			}
+			g_free(type);
+		}
+		g_strfreev(avas);
+	}
+	if (rdns) gq_exploded_free(rdns);
+	return r;
+}
+
+static EvalResult
+eval_node(GqFilter *filter, const FilterNode *node, const GqResultEntry *entry)
+{
+	const FilterNode *c;
+	EvalResult r = EVAL_FALSE, m;
+	guint i, j;
+
+	switch (node->type) {
+	case FILTER_AND:
+		r = EVAL_TRUE;
+		for (c = node->children ; c ; c = c->next) {
+			m = eval_node(filter, c, entry);
+			if (m == EVAL_FALSE) return EVAL_FALSE;
+			if (m == EVAL_UNDEFINED) r = EVAL_UNDEFINED;
+		}
+		return r;
+	case FILTER_OR:
+		for (c = node->children ; c ; c = c->next) {
+			m = eval_node(filter, c, entry);
+			if (m == EVAL_TRUE) return EVAL_TRUE;
+			if (m == EVAL_UNDEFINED) r = EVAL_UNDEFINED;
+		}
+		return r;
+	case FILTER_NOT:
+		m = eval_node(filter, node->children, entry);
+		if (m == EVAL_UNDEFINED) return m;
+		return m == EVAL_TRUE ? EVAL_FALSE : EVAL_TRUE;
+	case FILTER_PRESENT:
+		/* every entry has an objectClass, whether we asked for
+		   it or not */
+		if (g_ascii_strcasecmp(node->attr, "objectClass") == 0) {
+			return EVAL_TRUE;
+		}
+		for (i = 0 ; i < entry->n_attrs ; i++) {
+			if (attr_applies(node, entry->attrs[i].name)) {
+				return EVAL_TRUE;
+			}
+		}
+		return EVAL_FALSE;
+	default:
+		break;
+	}
+
+	if (!node->valid) return EVAL_UNDEFINED;
+
+	for (i = 0 ; i < entry->n_attrs ; i++) {
+		const GqResultAttr *a = &entry->attrs[i];
+
+		if (node->names && !attr_applies(node, a->name)) continue;
+
+		for (j = 0 ; j < a->n_values ; j++) {
+			m = match_value(filter, node, a->values[j].bv_val,
+					a->values[j].bv_len);
+			if (m == EVAL_TRUE) return EVAL_TRUE;
+			if (m == EVAL_UNDEFINED) r = EVAL_UNDEFINED;
+		}
+	}
+
+	if (node->type == FILTER_EXTENSIBLE && node->dn_attrs) {
+		m = match_dn_attrs(filter, node, entry->set.dn);
+		if (m == EVAL_TRUE) return EVAL_TRUE;
+		if (m == EVAL_UNDEFINED) r = EVAL_UNDEFINED;
+	}
+
+	return r;
+}
+
+gboolean
+gq_filter_matches(GqFilter *filter, const GqResultEntry *entry)
+{
+	g_return_val_if_fail(filter != NULL, FALSE);
+	g_return_val_if_fail(entry != NULL, FALSE);
+
+	return eval_node(filter, filter->root, entry) == EVAL_TRUE;
+}
@@ -0,0 +1,61 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GQ_LDAP_FILTER_H
+#define GQ_LDAP_FILTER_H
+
+#include <glib.h>
+
+#include "gq-result-store.h"
+
+G_BEGIN_DECLS
+
+/* A search filter (RFC 4515) compiled into a predicate tree that
+   can be evaluated against the entries of a GqResultStore.
+
+   Compiling only checks the syntax, so it doubles as a validator for
+   filters about to be sent. Before evaluating, the filter has to be
+   bound to the schema of the server the entries came from: this
+   picks the matching rules of the attributes involved, attributes
+   the schema does not know (or no schema at all) get case-ignore
+   matching. Approximate matches are done as case-ignore equality. */
+
+typedef struct _GqFilter GqFilter;
+
+/* returns NULL and sets *error (to be g_free'd) if text is not a
+   valid filter */
+GqFilter *gq_filter_compile(const gchar *text, gchar **error);
+void      gq_filter_free(GqFilter *filter);
+
+/* ss may be NULL. Fails for extensible matches using a matching
+   rule that cannot be evaluated locally. */
+gboolean  gq_filter_bind(GqFilter *filter, struct server_schema *ss,
+			 gchar **error);
+
+gboolean  gq_filter_matches(GqFilter *filter, const GqResultEntry *entry);
+
+/* the attribute descriptions used in the filter, the strings belong
+   to the filter, the list to the caller */
+GList    *gq_filter_get_attributes(GqFilter *filter);
+
+G_END_DECLS
+
+#endif /* !GQ_LDAP_FILTER_H */
@@ -0,0 +1,723 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+
+#include "gq-mass-modify.h"
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+
+#include "errorchain.h"
+#include "gq-progress.h"
+#include "gq-server-stats.h"
+#include "input.h"		/* CONTAINER_BORDER_WIDTH */
+#include "util.h"
+
+/* number of modify requests kept outstanding per connection */
+#define MODIFY_WINDOW		32
+
+#define RESPONSE_DRY_RUN	1
+
+typedef struct {
+	int        op;		/* LDAP_MOD_ADD, _REPLACE or _DELETE */
+	gchar     *attribute;
+	GPtrArray *values;	/* value templates */
+} ModTemplate;
+
+struct _GqMassModify {
+	GPtrArray *mods;	/* ModTemplate */
+};
+
+struct pending_modify {
+	GqResultEntry *entry;
+	LDAPMod **mods;
+	int msgid;
+	gdouble start;
+};
+
+/* the text of the last modifications, for the next time */
+static gchar *last_mods = NULL;
+
+void
+gq_mass_modify_free(GqMassModify *mm)
+{
+	guint i;
+
+	if (mm == NULL) return;
+
+	for (i = 0 ; i < mm->mods->len ; i++) {
+		ModTemplate *mt = g_ptr_array_index(mm->mods, i);
+		g_ptr_array_foreach(mt->values, (GFunc) g_free, NULL);
+		g_ptr_array_free(mt->values, TRUE);
+		g_free(mt->attribute);
+		g_free(mt);
+	}
+	g_ptr_array_free(mm->mods, TRUE);
+	g_free(mm);
+}
+
+/* FALSE (and an error pushed) for a % not followed by %, or by
+   {attr} */
+static gboolean
+check_template(int error_context, int line, const gchar *template)
+{
+	const gchar *p;
+
+	for (p = strchr(template, '%') ; p ; p = strchr(p + 1, '%')) {
+		if (p[1] == '%') {
+			p++;
+		} else if (p[1] != '{' || strchr(p + 2, '}') == NULL ||
+			   strchr(p + 2, '}') == p + 2) {
+			error_push(error_context,
+				   _("Line %1$d: '%%' has to be followed by '%%' or by an attribute in braces, like %%{uid}"),
+				   line);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/* "name: value" with name matching attribute (ignoring case), NULL
+   otherwise */
+static const gchar *
+value_of(const gchar *line, const gchar *attribute)
+{
+	gsize l = strlen(attribute);
+
+	if (g_ascii_strncasecmp(line, attribute, l) != 0 || line[l] != ':') {
+		return NULL;
+	}
+	for (line += l + 1 ; *line == ' ' ; line++) ;
+	return line;
+}
+
+GqMassModify *
+gq_mass_modify_parse(int error_context, const gchar *text)
+{
+	static const struct {
+		const gchar *keyword;
+		int op;
+	} ops[] = {
+		{ "add",     LDAP_MOD_ADD },
+		{ "replace", LDAP_MOD_REPLACE },
+		{ "delete",  LDAP_MOD_DELETE },
+	};
+	GqMassModify *mm;
+	ModTemplate *mt = NULL;
+	gchar **lines;
+	gboolean ok = TRUE;
+	int i;
+
+	g_return_val_if_fail(text != NULL, NULL);
+
+	mm = g_new0(GqMassModify, 1);
+	mm->mods = g_ptr_array_new();
+
+	lines = g_strsplit(text, "\n", -1);
+	for (i = 0 ; ok && lines[i] ; i++) {
+		gchar *line = lines[i];
+		gsize l = strlen(line);
+		const gchar *value;
+		guint j;
+
+		if (l > 0 && line[l - 1] == '\r') line[--l] = '\0';
+		if (l == 0 || line[0] == '#') continue;
+
+		/* LDIF folding: a line starting with a space continues the
+		   value before */
+		if (line[0] == ' ' && mt && mt->values->len > 0) {
+			gchar **last = (gchar **) &g_ptr_array_index(mt->values,
+								     mt->values->len - 1);
+			gchar *joined = g_strconcat(*last, line + 1, NULL);
+			g_free(*last);
+			*last = joined;
+			ok = check_template(error_context, i + 1, joined);
+			continue;
+		}
+
+		if (strcmp(line, "-") == 0) {
+			if (mt && mt->op == LDAP_MOD_ADD && mt->values->len == 0) {
+				error_push(error_context,
+					   _("Line %1$d: adding to '%2$s' needs at least one value"),
+					   i + 1, mt->attribute);
+				ok = FALSE;
+			}
+			mt = NULL;
+			continue;
+		}
+
+		if (mt == NULL) {
+			for (j = 0 ; j < G_N_ELEMENTS(ops) ; j++) {
+				value = value_of(line, ops[j].keyword);
+				if (value && *value) {
+					mt = g_new0(ModTemplate, 1);
+					mt->op = ops[j].op;
+					mt->attribute = g_strstrip(g_strdup(value));
+					mt->values = g_ptr_array_new();
+					g_ptr_array_add(mm->mods, mt);
+					break;
+				}
+			}
+			if (mt == NULL) {
+				error_push(error_context,
+					   _("Line %1$d: expected 'add:', 'replace:' or 'delete:' and an attribute"),
+					   i + 1);
+				ok = FALSE;
+			}
+			continue;
+		}
+
+		value = value_of(line, mt->attribute);
+		if (value == NULL) {
+			error_push(error_context,
+				   _("Line %1$d: expected '%2$s: value' or '-'"),
+				   i + 1, mt->attribute);
+			ok = FALSE;
+			continue;
+		}
+		ok = check_template(error_context, i + 1, value);
+		g_ptr_array_add(mt->values, g_strdup(value));
+	}
+	g_strfreev(lines);
+
+	if (ok && mt && mt->op == LDAP_MOD_ADD && mt->values->len == 0) {
+		error_push(error_context,
+			   _("Adding to '%s' needs at least one value"),
+			   mt->attribute);
+		ok = FALSE;
+	}
+	if (ok && mm->mods->len == 0) {
+		error_push(error_context, _("No modifications given"));
+		ok = FALSE;
+	}
+
+	if (!ok) {
+		gq_mass_modify_free(mm);
+		return NULL;
+	}
+	return mm;
+}
+
+static struct berval *
+new_berval(const gchar *val, gsize len)
+{
+	struct berval *bv = g_malloc(sizeof(struct berval));
+
+	bv->bv_val = g_malloc(len + 1);
+	memcpy(bv->bv_val, val, len);
+	bv->bv_val[len] = '\0';
+	bv->bv_len = len;
+	return bv;
+}
+
+/* appends the value name stands for in entry to s, FALSE if it has
+   none */
+static gboolean
+append_first(GString *s, const GqResultEntry *entry, const gchar *name)
+{
+	const GqResultAttr *attr;
+
+	if (g_ascii_strcasecmp(name, "dn") == 0) {
+		g_string_append(s, entry->set.dn);
+		return TRUE;
+	}
+	if (g_ascii_strcasecmp(name, "rdn") == 0) {
+		char **rdns = gq_ldap_explode_dn(entry->set.dn, FALSE);
+		const char *eq = rdns && rdns[0] ? strchr(rdns[0], '=') : NULL;
+
+		if (eq) g_string_append(s, eq + 1);
+		if (rdns) gq_exploded_free(rdns);
+		return eq != NULL;
+	}
+
+	attr = gq_result_entry_get_attr(entry, name);
+	if (attr == NULL || attr->n_values == 0) return FALSE;
+
+	g_string_append_len(s, attr->values[0].bv_val, attr->values[0].bv_len);
+	return TRUE;
+}
+
+/* fills in template for entry, adding the value(s) to out. FALSE if
+   an attribute has no value, its name is then in missing. */
+static gboolean
+expand_template(const gchar *template, const GqResultEntry *entry,
+		GPtrArray *out, GString *missing)
+{
+	const gchar *p, *end;
+	GString *s;
+	gchar *name;
+
+	/* nothing but %{attr}: all of its values */
+	if (template[0] == '%' && template[1] == '{' &&
+	    (end = strchr(template + 2, '}')) != NULL && end[1] == '\0') {
+		const GqResultAttr *attr;
+		guint i;
+
+		name = g_strndup(template + 2, end - template - 2);
+		attr = gq_result_entry_get_attr(entry, name);
+		if (attr && attr->n_values > 0) {
+			for (i = 0 ; i < attr->n_values ; i++) {
+				g_ptr_array_add(out,
+						new_berval(attr->values[i].bv_val,
+							   attr->values[i].bv_len));
+			}
+			g_free(name);
+			return TRUE;
+		}
+		/* %{dn} and %{rdn} */
+		g_free(name);
+	}
+
+	s = g_string_new(NULL);
+	for (p = template ; *p ; p++) {
+		if (*p != '%') {
+			g_string_append_c(s, *p);
+			continue;
+		}
+		if (p[1] == '%') {
+			g_string_append_c(s, '%');
+			p++;
+			continue;
+		}
+		/* checked when parsing */
+		end = strchr(p + 2, '}');
+		name = g_strndup(p + 2, end - p - 2);
+		if (!append_first(s, entry, name)) {
+			g_string_assign(missing, name);
+			g_free(name);
+			g_string_free(s, TRUE);
+			return FALSE;
+		}
+		g_free(name);
+		p = end;
+	}
+
+	g_ptr_array_add(out, new_berval(s->str, s->len));
+	g_string_free(s, TRUE);
+	return TRUE;
+}
+
+static void
+free_bervals(GPtrArray *values)
+{
+	guint i;
+
+	for (i = 0 ; i < values->len ; i++) {
+		struct berval *bv = g_ptr_array_index(values, i);
+		g_free(bv->bv_val);
+		g_free(bv);
+	}
+	g_ptr_array_free(values, TRUE);
+}
+
+/* the modifications for entry, NULL if a template could not be
+   filled in (naming the attribute in missing). Free with
+   gq_mass_modify_free_mods(). */
+static LDAPMod **
+expand_mods(const GqMassModify *mm, const GqResultEntry *entry,
+	    GString *missing)
+{
+	LDAPMod **mods;
+	guint i, j;
+
+	mods = g_malloc0((mm->mods->len + 1) * sizeof(LDAPMod *));
+
+	for (i = 0 ; i < mm->mods->len ; i++) {
+		ModTemplate *mt = g_ptr_array_index(mm->mods, i);
+		GPtrArray *values = g_ptr_array_new();
+
+		for (j = 0 ; j < mt->values->len ; j++) {
+			if (!expand_template(g_ptr_array_index(mt->values, j),
+					     entry, values, missing)) {
+				free_bervals(values);
+				gq_mass_modify_free_mods(mods);
+				return NULL;
+			}
+		}
+
+		mods[i] = g_malloc0(sizeof(LDAPMod));
+		mods[i]->mod_op = mt->op | LDAP_MOD_BVALUES;
+		mods[i]->mod_type = g_strdup(mt->attribute);
+		if (values->len > 0) {
+			g_ptr_array_add(values, NULL);
+			mods[i]->mod_bvalues = (struct berval **)
+				g_ptr_array_free(values, FALSE);
+		} else {
+			/* delete or replace without values: the whole
+			   attribute goes */
+			g_ptr_array_free(values, TRUE);
+		}
+	}
+	return mods;
+}
+
+LDAPMod **
+gq_mass_modify_expand(const GqMassModify *mm, const GqResultEntry *entry)
+{
+	GString *missing;
+	LDAPMod **mods;
+
+	g_return_val_if_fail(mm != NULL, NULL);
+	g_return_val_if_fail(entry != NULL, NULL);
+
+	missing = g_string_new(NULL);
+	mods = expand_mods(mm, entry, missing);
+	g_string_free(missing, TRUE);
+	return mods;
+}
+
+/* everything in there comes from GLib, ldap_mods_free() would free
+   it with the wrong allocator */
+void
+gq_mass_modify_free_mods(LDAPMod **mods)
+{
+	guint i, j;
+
+	if (mods == NULL) return;
+
+	for (i = 0 ; mods[i] ; i++) {
+		if (mods[i]->mod_bvalues) {
+			for (j = 0 ; mods[i]->mod_bvalues[j] ; j++) {
+				g_free(mods[i]->mod_bvalues[j]->bv_val);
+				g_free(mods[i]->mod_bvalues[j]);
+			}
+			g_free(mods[i]->mod_bvalues);
+		}
+		g_free(mods[i]->mod_type);
+		g_free(mods[i]);
+	}
+	g_free(mods);
+}
+
+static void
+modify_failed(int error_context, GqResultEntry *entry, int err)
+{
+	error_push_ldap(error_context, _("Modifying entries"), err,
+			_("Error modifying DN '%1$s' on '%2$s': %3$s"),
+			entry->set.dn, entry->set.server->name,
+			ldap_err2string(err));
+}
+
+/* the entries of one server, the window of modify requests kept
+   full on one connection */
+static void
+modify_on_server(int error_context, GqServer *server,
+		 const GqMassModify *mm, GList *entries,
+		 GqProgress *progress, GqMassModifyCount *count)
+{
+	LDAP *ld;
+	LDAPControl c;
+	LDAPControl *ctrls[2] = { NULL, NULL } ;
+	LDAPMessage *res = NULL;
+	GString *missing = g_string_new(NULL);
+	GQueue *pending;
+	GList *next;
+	struct pending_modify *pm;
+	int rc, err;
+
+	c.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+	c.ldctl_value.bv_val	= NULL;
+	c.ldctl_value.bv_len	= 0;
+	c.ldctl_iscritical	= 1;
+
+	ctrls[0] = &c;
+
+	if ((ld = open_connection(error_context, server)) == NULL) {
+		count->failed += g_list_length(entries);
+		gq_progress_add(progress, g_list_length(entries));
+		g_string_free(missing, TRUE);
+		return;
+	}
+
+	pending = g_queue_new();
+
+	for (next = entries ; next || !g_queue_is_empty(pending) ; ) {
+		/* keep the window full */
+		while (next && g_queue_get_length(pending) < MODIFY_WINDOW) {
+			GqResultEntry *entry = next->data;
+			LDAPMod **mods;
+
+			next = next->next;
+
+			mods = expand_mods(mm, entry, missing);
+			if (mods == NULL) {
+				error_push(error_context,
+					   _("Skipped '%1$s': it has no %2$s"),
+					   entry->set.dn, missing->str);
+				count->skipped++;
+				gq_progress_add(progress, 1);
+				continue;
+			}
+
+			pm = g_new0(struct pending_modify, 1);
+			pm->entry = entry;
+			pm->mods = mods;
+			pm->start = gq_server_stats_start();
+			rc = ldap_modify_ext(ld, entry->set.dn, mods, ctrls,
+					     NULL, &pm->msgid);
+			if (rc != LDAP_SUCCESS) {
+				gq_server_stats_stop(server, GQ_STAT_MODIFY,
+						     pm->start, FALSE);
+				modify_failed(error_context, entry, rc);
+				count->failed++;
+				gq_progress_add(progress, 1);
+				gq_mass_modify_free_mods(pm->mods);
+				g_free(pm);
+				if (rc == LDAP_SERVER_DOWN) {
+					server->server_down++;
+					/* no point in sending the rest */
+					for ( ; next ; next = next->next) {
+						modify_failed(error_context,
+							      next->data, rc);
+						count->failed++;
+						gq_progress_add(progress, 1);
+					}
+				}
+				continue;
+			}
+			g_queue_push_tail(pending, pm);
+		}
+
+		if (g_queue_is_empty(pending)) continue;
+
+		/* in send order, answers to other requests on the shared
+		   connection stay with the library */
+		pm = g_queue_pop_head(pending);
+		rc = ldap_result(ld, pm->msgid, LDAP_MSG_ALL, NULL, &res);
+		if (rc == -1 || rc == 0) {
+			ldap_get_option(ld, LDAP_OPT_ERROR_NUMBER, &err);
+			if (err == LDAP_SERVER_DOWN) {
+				server->server_down++;
+			}
+		} else {
+			err = ldap_result2error(ld, res, 1);
+			res = NULL;
+		}
+
+		if (err == LDAP_NOT_SUPPORTED) {
+			/* no ManageDSAit, do it the old way */
+			err = ldap_modify_ext_s(ld, pm->entry->set.dn,
+						pm->mods, NULL, NULL);
+		}
+		gq_server_stats_stop(server, GQ_STAT_MODIFY, pm->start,
+				     err == LDAP_SUCCESS);
+
+#if HAVE_LDAP_CLIENT_CACHE
+		ldap_uncache_entry(ld, pm->entry->set.dn);
+#endif
+
+		gq_progress_add(progress, 1);
+		if (err == LDAP_SUCCESS) {
+			count->modified++;
+		} else {
+			modify_failed(error_context, pm->entry, err);
+			count->failed++;
+		}
+		gq_mass_modify_free_mods(pm->mods);
+		g_free(pm);
+	}
+
+	g_queue_free(pending);
+	g_string_free(missing, TRUE);
+	close_connection(server, FALSE);
+}
+
+void
+gq_mass_modify_apply(int error_context, const GqMassModify *mm,
+		     GList *entries, gboolean dry_run,
+		     GqMassModifyCount *count)
+{
+	GHashTable *by_server;
+	GList *servers = NULL, *I;
+	GqProgress *progress;
+
+	g_return_if_fail(mm != NULL);
+	g_return_if_fail(count != NULL);
+
+	memset(count, 0, sizeof(GqMassModifyCount));
+	error_set_bulk(error_context, ERROR_BULK_SAMPLES, !dry_run);
+
+	if (dry_run) {
+		GString *missing = g_string_new(NULL);
+
+		for (I = entries ; I ; I = g_list_next(I)) {
+			GqResultEntry *entry = I->data;
+			LDAPMod **mods = expand_mods(mm, entry, missing);
+
+			if (mods) {
+				count->modified++;
+				gq_mass_modify_free_mods(mods);
+			} else {
+				error_push(error_context,
+					   _("Skipped '%1$s': it has no %2$s"),
+					   entry->set.dn, missing->str);
+				count->skipped++;
+			}
+		}
+		g_string_free(missing, TRUE);
+		return;
+	}
+
+	/* one batch per server, in the order given */
+	by_server = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (I = entries ; I ; I = g_list_next(I)) {
+		GqResultEntry *entry = I->data;
+		GList *l = g_hash_table_lookup(by_server, entry->set.server);
+
+		if (l == NULL) {
+			servers = g_list_append(servers, entry->set.server);
+		}
+		g_hash_table_insert(by_server, entry->set.server,
+				    g_list_prepend(l, entry));
+	}
+
+	set_busycursor();
+	progress = gq_progress_new(_("Modifying entries"),
+				   g_list_length(entries));
+
+	for (I = servers ; I ; I = g_list_next(I)) {
+		GList *l = g_list_reverse(g_hash_table_lookup(by_server,
+							      I->data));
+		modify_on_server(error_context, I->data, mm, l,
+				 progress, count);
+		g_list_free(l);
+	}
+
+	gq_progress_finish(progress);
+	set_normalcursor();
+
+	g_hash_table_destroy(by_server);
+	g_list_free(servers);
+}
+
+void
+mass_modify_results(int error_context, GtkWidget *transient_for,
+		    GList *entries)
+{
+	GtkWidget *dialog, *vbox, *label, *scrwin, *text, *result;
+	GtkTextBuffer *buffer;
+	GtkTextIter start, end;
+	GqMassModifyCount count;
+	gchar *msg;
+	int n = g_list_length(entries);
+	int response;
+
+	dialog = gtk_dialog_new_with_buttons(_("Modify selected entries"),
+					     transient_for && GTK_IS_WINDOW(transient_for) ?
+					     GTK_WINDOW(transient_for) : NULL,
+					     GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+					     _("_Dry run"), RESPONSE_DRY_RUN,
+					     GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+					     GTK_STOCK_APPLY, GTK_RESPONSE_APPLY,
+					     NULL);
+	gtk_window_set_default_size(GTK_WINDOW(dialog), 500, 360);
+
+	vbox = gtk_vbox_new(FALSE, CONTAINER_BORDER_WIDTH);
+	gtk_container_set_border_width(GTK_CONTAINER(vbox),
+				       CONTAINER_BORDER_WIDTH);
+	gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), vbox,
+			   TRUE, TRUE, 0);
+
+	msg = g_strdup_printf(ngettext("Modifications for the selected entry, as in LDIF:",
+				       "Modifications for the %d selected entries, as in LDIF:",
+				       n), n);
+	label = gtk_label_new(msg);
+	g_free(msg);
+	gtk_misc_set_alignment(GTK_MISC(label), 0, 0.5);
+	gtk_box_pack_start(GTK_BOX(vbox), label, FALSE, FALSE, 0);
+
+	scrwin = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrwin),
+				       GTK_POLICY_AUTOMATIC,
+				       GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scrwin),
+					    GTK_SHADOW_IN);
+	gtk_box_pack_start(GTK_BOX(vbox), scrwin, TRUE, TRUE, 0);
+
+	text = gtk_text_view_new();
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(text));
+	gtk_text_buffer_set_text(buffer,
+				 last_mods ? last_mods : "replace: \n-\n", -1);
+	gtk_container_add(GTK_CONTAINER(scrwin), text);
+
+	label = gtk_label_new(_("In values %{attr} stands for the first value of attr, %{dn} and %{rdn} for the DN and the value of its first RDN, %% for a %. A value of only %{attr} takes all values of attr."));
+	gtk_label_set_line_wrap(GTK_LABEL(label), TRUE);
+	gtk_misc_set_alignment(GTK_MISC(label), 0, 0.5);
+	gtk_box_pack_start(GTK_BOX(vbox), label, FALSE, FALSE, 0);
+
+	result = gtk_label_new("");
+	gtk_misc_set_alignment(GTK_MISC(result), 0, 0.5);
+	gtk_box_pack_start(GTK_BOX(vbox), result, FALSE, FALSE, 0);
+
+	gtk_widget_show_all(dialog);
+	gtk_widget_grab_focus(text);
+
+	while ((response = gtk_dialog_run(GTK_DIALOG(dialog))) == RESPONSE_DRY_RUN ||
+	       response == GTK_RESPONSE_APPLY) {
+		GqMassModify *mm;
+		gboolean dry_run = response == RESPONSE_DRY_RUN;
+		/* problems with the text get shown over the dialog */
+		int ctx = error_new_context(_("Checking the modifications"),
+					    dialog);
+
+		gtk_text_buffer_get_bounds(buffer, &start, &end);
+		g_free(last_mods);
+		last_mods = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
+
+		mm = gq_mass_modify_parse(ctx, last_mods);
+		if (mm == NULL) {
+			error_flush(ctx);
+			continue;
+		}
+
+		if (dry_run) {
+			gq_mass_modify_apply(ctx, mm, entries, TRUE, &count);
+			msg = g_strdup_printf(ngettext("%1$d entry would be modified, %2$d skipped",
+						       "%1$d entries would be modified, %2$d skipped",
+						       count.modified),
+					      count.modified, count.skipped);
+			gtk_label_set_text(GTK_LABEL(result), msg);
+			g_free(msg);
+			gq_mass_modify_free(mm);
+			error_flush(ctx);
+			continue;
+		}
+		error_flush(ctx);
+
+		gtk_widget_hide(dialog);
+		gq_mass_modify_apply(error_context, mm, entries, FALSE, &count);
+		gq_mass_modify_free(mm);
+
+		statusbar_msg(ngettext("Modified %1$d entry, %2$d skipped, %3$d failed",
+				       "Modified %1$d entries, %2$d skipped, %3$d failed",
+				       count.modified),
+			      count.modified, count.skipped, count.failed);
+		break;
+	}
+
+	gtk_widget_destroy(dialog);
+}
@@ -0,0 +1,89 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+
+#ifndef GQ_MASS_MODIFY_H
+#define GQ_MASS_MODIFY_H
+
+#include <glib.h>
+#include <ldap.h>
+#include <gtk/gtkwidget.h>
+
+#include "gq-result-store.h"
+
+G_BEGIN_DECLS
+
+/* One set of modifications applied to many search results at once.
+
+   The modifications are written the way LDIF writes the body of a
+   "changetype: modify" record:
+
+	replace: l
+	l: Berlin
+	-
+	add: mail
+	mail: %{uid}@example.com
+	-
+	delete: description
+
+   Values are templates: %{attr} stands for the first value of attr
+   in the entry, %{dn} for its DN and %{rdn} for the value of its
+   first RDN, %% for a single %. A value consisting of nothing but
+   %{attr} takes all values of attr. Entries lacking an attribute a
+   template needs get skipped, as do results whose search did not
+   ask for it.
+
+   Each server gets its entries as asynchronous modify requests on
+   one connection, a window of them outstanding at a time. */
+
+typedef struct _GqMassModify GqMassModify;
+
+typedef struct {
+	gint modified;		/* or would be, in a dry run */
+	gint skipped;		/* templates that could not be filled in */
+	gint failed;
+} GqMassModifyCount;
+
+/* NULL (and an error pushed) if text does not parse */
+GqMassModify *gq_mass_modify_parse(int error_context, const gchar *text);
+void          gq_mass_modify_free(GqMassModify *mm);
+
+/* the modifications for entry, NULL if a template could not be
+   filled in. Free with gq_mass_modify_free_mods(), not with
+   ldap_mods_free(). */
+LDAPMod     **gq_mass_modify_expand(const GqMassModify *mm,
+				    const GqResultEntry *entry);
+void          gq_mass_modify_free_mods(LDAPMod **mods);
+
+/* applies mm to entries (GqResultEntry, on any servers). A dry run
+   only fills in the templates and counts. Puts error_context into
+   bulk mode. */
+void          gq_mass_modify_apply(int error_context, const GqMassModify *mm,
+				   GList *entries, gboolean dry_run,
+				   GqMassModifyCount *count);
+
+/* asks for the modifications and applies them to entries */
+void          mass_modify_results(int error_context, GtkWidget *transient_for,
+				  GList *entries);
+
+G_END_DECLS
+
+#endif /* !GQ_MASS_MODIFY_H */
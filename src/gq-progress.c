@@ -0,0 +1,233 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gq-progress.h"
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+
+#include "mainwin.h"
+
+/* weight of the latest throughput measurement against the ones
+   before */
+#define RATE_SMOOTHING	0.3
+
+struct _GqProgress {
+	gchar *what;
+	volatile gint done;
+	volatile gint total;
+
+	/* main thread only */
+	gdouble last_time;
+	gint last_done;
+	gdouble rate;		/* per second */
+};
+
+static GList *active = NULL;	/* newest last */
+static GThread *main_thread = NULL;
+static GTimer *timer = NULL;
+static gdouble next_redraw = 0;
+static guint source = 0;
+static guint context_id = 0;
+static gboolean shown = FALSE;
+
+static void
+update_rate(GqProgress *progress, gdouble now)
+{
+	gint done = g_atomic_int_get(&progress->done);
+	gdouble dt = now - progress->last_time, rate;
+
+	/* too short to say much */
+	if (dt < 0.5 / GQ_PROGRESS_REDRAWS) return;
+
+	rate = (done - progress->last_done) / dt;
+	if (progress->rate == 0) {
+		progress->rate = rate;
+	} else {
+		progress->rate = RATE_SMOOTHING * rate
+			+ (1 - RATE_SMOOTHING) * progress->rate;
+	}
+	progress->last_time = now;
+	progress->last_done = done;
+}
+
+/* h:mm:ss or m:ss */
+static gchar *
+format_duration(gdouble seconds)
+{
+	gulong s = (gulong) (seconds + 0.5);
+
+	if (s >= 3600) {
+		return g_strdup_printf("%lu:%02lu:%02lu",
+				       s / 3600, (s / 60) % 60, s % 60);
+	}
+	return g_strdup_printf("%lu:%02lu", s / 60, s % 60);
+}
+
+static gchar *
+format_progress(GqProgress *progress)
+{
+	gint done = g_atomic_int_get(&progress->done);
+	gint total = g_atomic_int_get(&progress->total);
+	gchar *msg, *left;
+
+	if (total > 0 && progress->rate > 0) {
+		left = format_duration(MAX(total - done, 0) / progress->rate);
+		msg = g_strdup_printf(_("%1$s: %2$d of %3$d, %4$.0f per second, %5$s left"),
+				      progress->what, done, total,
+				      progress->rate, left);
+		g_free(left);
+	} else if (total > 0) {
+		msg = g_strdup_printf(_("%1$s: %2$d of %3$d"),
+				      progress->what, done, total);
+	} else if (progress->rate > 0) {
+		msg = g_strdup_printf(_("%1$s: %2$d, %3$.0f per second"),
+				      progress->what, done, progress->rate);
+	} else {
+		msg = g_strdup_printf(_("%1$s: %2$d"), progress->what, done);
+	}
+	return msg;
+}
+
+static void
+clear_statusbar(void)
+{
+	if (shown) {
+		gtk_statusbar_pop(GTK_STATUSBAR(mainwin.statusbar),
+				  context_id);
+		shown = FALSE;
+	}
+}
+
+/* shows the newest one */
+static void
+redraw(void)
+{
+	GqProgress *progress;
+	gdouble now = g_timer_elapsed(timer, NULL);
+	GList *I;
+	gchar *msg;
+
+	next_redraw = now + 1.0 / GQ_PROGRESS_REDRAWS;
+
+	for (I = active ; I ; I = g_list_next(I)) {
+		update_rate(I->data, now);
+	}
+
+	if (active == NULL || mainwin.statusbar == NULL) return;
+	progress = g_list_last(active)->data;
+
+	if (context_id == 0) {
+		context_id =
+			gtk_statusbar_get_context_id(GTK_STATUSBAR(mainwin.statusbar),
+						     "progress");
+	}
+
+	msg = format_progress(progress);
+	clear_statusbar();
+	gtk_statusbar_push(GTK_STATUSBAR(mainwin.statusbar), context_id, msg);
+	shown = TRUE;
+	g_free(msg);
+}
+
+static gboolean
+tick(gpointer data)
+{
+	if (g_timer_elapsed(timer, NULL) >= next_redraw) redraw();
+	return TRUE;
+}
+
+GqProgress *
+gq_progress_new(const gchar *what, gint total)
+{
+	GqProgress *progress;
+
+	g_return_val_if_fail(what != NULL, NULL);
+
+	if (timer == NULL) {
+		timer = g_timer_new();
+		main_thread = g_thread_self();
+	}
+
+	progress = g_new0(GqProgress, 1);
+	progress->what = g_strdup(what);
+	progress->total = total;
+	progress->last_time = g_timer_elapsed(timer, NULL);
+
+	active = g_list_append(active, progress);
+
+	/* for counting from other threads */
+	if (source == 0) {
+		source = g_timeout_add(1000 / GQ_PROGRESS_REDRAWS, tick, NULL);
+	}
+
+	return progress;
+}
+
+void
+gq_progress_set_total(GqProgress *progress, gint total)
+{
+	if (progress == NULL) return;
+
+	/* an aligned int gets written in one go */
+	progress->total = total;
+}
+
+void
+gq_progress_add(GqProgress *progress, gint n)
+{
+	if (progress == NULL) return;
+
+	g_atomic_int_add(&progress->done, n);
+
+	/* nothing else gets the status bar redrawn while the main
+	   thread is busy counting */
+	if (g_thread_self() == main_thread &&
+	    g_timer_elapsed(timer, NULL) >= next_redraw) {
+		redraw();
+		while (gtk_events_pending()) {
+			gtk_main_iteration();
+		}
+	}
+}
+
+void
+gq_progress_finish(GqProgress *progress)
+{
+	if (progress == NULL) return;
+
+	active = g_list_remove(active, progress);
+	g_free(progress->what);
+	g_free(progress);
+
+	if (active) {
+		/* back to the one before, right away */
+		next_redraw = 0;
+	} else {
+		clear_statusbar();
+		g_source_remove(source);
+		source = 0;
+	}
+}
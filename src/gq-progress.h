@@ -0,0 +1,56 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GQ_PROGRESS_H
+#define GQ_PROGRESS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Progress of long running operations (searching, expanding,
+   exporting, moving, deleting), shown in the status bar.
+
+   Counting is cheap and may happen from any thread: it only adds to
+   an atomic counter. The status bar gets redrawn from the main
+   thread at most GQ_PROGRESS_REDRAWS times a second, with the
+   throughput and, if the total is known, the time left. For
+   operations running in the main thread counting also takes care of
+   redrawing, as the main loop does not get to run then.
+
+   Progress objects get created and finished in the main thread. The
+   functions taking one accept NULL, for callers that have nothing to
+   show. */
+
+#define GQ_PROGRESS_REDRAWS	4
+
+typedef struct _GqProgress GqProgress;
+
+/* what: "Deleting entries" and the like. total: 0 if not known. */
+GqProgress *gq_progress_new(const gchar *what, gint total);
+void        gq_progress_set_total(GqProgress *progress, gint total);
+void        gq_progress_add(GqProgress *progress, gint n);
+/* removes it from the status bar and frees it */
+void        gq_progress_finish(GqProgress *progress);
+
+G_END_DECLS
+
+#endif /* !GQ_PROGRESS_H */
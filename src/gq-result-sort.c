@@ -0,0 +1,394 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gq-result-sort.h"
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gq-result-store.h"
+
+/* below this many rows sorting in one thread is quick enough */
+#define PARALLEL_SORT_MIN	50000
+#define MAX_SORT_THREADS	8
+
+/* what an empty cell, a number and text sort as, in this order. A
+   column has either integers or other numbers, never both. */
+enum {
+	RANK_EMPTY,
+	RANK_INTEGER,
+	RANK_NUMBER,
+	RANK_TEXT
+};
+
+struct sort_key {
+	union {
+		gint64 integer;
+		gdouble num;
+	} v;
+	const gchar *text;
+	gint rank;
+};
+
+struct column_keys {
+	GqSortNumberFunc number;
+	GqSortIntegerFunc integer;
+	GArray *keys;			/* struct sort_key, by row id */
+};
+
+struct _GqResultSort {
+	GStringChunk *chunk;
+	struct column_keys *columns;
+	gint n_columns;
+};
+
+/* the key with the row it belongs to, what actually gets sorted */
+struct sort_item {
+	struct sort_key key;
+	guint pos;			/* keeps the sort stable */
+	GList *link;			/* in clist->row_list */
+};
+
+GqResultSort *
+gq_result_sort_new(void)
+{
+	GqResultSort *sort = g_new0(GqResultSort, 1);
+	sort->chunk = g_string_chunk_new(64 * 1024);
+	return sort;
+}
+
+void
+gq_result_sort_free(GqResultSort *sort)
+{
+	gint i;
+
+	if (sort == NULL) return;
+
+	for (i = 0 ; i < sort->n_columns ; i++) {
+		if (sort->columns[i].keys) {
+			g_array_free(sort->columns[i].keys, TRUE);
+		}
+	}
+	g_free(sort->columns);
+	g_string_chunk_free(sort->chunk);
+	g_free(sort);
+}
+
+static struct column_keys *
+get_column(GqResultSort *sort, gint column)
+{
+	if (column >= sort->n_columns) {
+		sort->columns = g_renew(struct column_keys, sort->columns,
+					column + 1);
+		memset(sort->columns + sort->n_columns, 0,
+		       (column + 1 - sort->n_columns) * sizeof(struct column_keys));
+		sort->n_columns = column + 1;
+	}
+	return &sort->columns[column];
+}
+
+void
+gq_result_sort_set_column(GqResultSort *sort, gint column,
+			  GqSortNumberFunc number, GqSortIntegerFunc integer)
+{
+	struct column_keys *col;
+
+	g_return_if_fail(sort != NULL);
+	g_return_if_fail(column >= 0);
+
+	col = get_column(sort, column);
+	col->number = number;
+	col->integer = integer;
+}
+
+/* case folded copy of text, kept in the chunk */
+static const gchar *
+fold_text(GqResultSort *sort, const gchar *text)
+{
+	const gchar *c;
+	gchar *folded, *f;
+	const gchar *r;
+
+	for (c = text ; *c ; c++) {
+		if ((guchar) *c >= 0x80) break;
+	}
+	if (*c == 0) {
+		/* plain ASCII, the common case */
+		r = g_string_chunk_insert(sort->chunk, text);
+		for (f = (gchar *) r ; *f ; f++) {
+			*f = g_ascii_tolower(*f);
+		}
+		return r;
+	}
+
+	folded = g_utf8_casefold(text, -1);
+	r = g_string_chunk_insert(sort->chunk, folded);
+	g_free(folded);
+	return r;
+}
+
+void
+gq_result_sort_add(GqResultSort *sort, guint id, gint column,
+		   const gchar *text, const gchar *value)
+{
+	struct column_keys *col;
+	struct sort_key *key;
+
+	g_return_if_fail(sort != NULL);
+	g_return_if_fail(column >= 0);
+
+	col = get_column(sort, column);
+	if (col->keys == NULL) {
+		col->keys = g_array_new(FALSE, TRUE, sizeof(struct sort_key));
+	}
+	if (id >= col->keys->len) {
+		g_array_set_size(col->keys, id + 1);
+	}
+	key = &g_array_index(col->keys, struct sort_key, id);
+
+	if (col->integer && value && col->integer(value, &key->v.integer)) {
+		key->rank = RANK_INTEGER;
+	} else if (col->number && value && col->number(value, &key->v.num)) {
+		key->rank = RANK_NUMBER;
+	} else if (text && text[0]) {
+		key->text = fold_text(sort, text);
+		key->rank = RANK_TEXT;
+	} else {
+		key->rank = RANK_EMPTY;
+	}
+}
+
+static inline int
+compare_keys(const struct sort_key *a, const struct sort_key *b)
+{
+	if (a->rank != b->rank) return a->rank < b->rank ? -1 : 1;
+
+	switch (a->rank) {
+	case RANK_INTEGER:
+		if (a->v.integer != b->v.integer) {
+			return a->v.integer < b->v.integer ? -1 : 1;
+		}
+		return 0;
+	case RANK_NUMBER:
+		if (a->v.num != b->v.num) return a->v.num < b->v.num ? -1 : 1;
+		return 0;
+	case RANK_TEXT:
+		return strcmp(a->text, b->text);
+	default:
+		return 0;
+	}
+}
+
+static int
+compare_ascending(const void *p1, const void *p2)
+{
+	const struct sort_item *a = p1, *b = p2;
+	int c = compare_keys(&a->key, &b->key);
+
+	if (c) return c;
+	return a->pos < b->pos ? -1 : (a->pos > b->pos);
+}
+
+static int
+compare_descending(const void *p1, const void *p2)
+{
+	const struct sort_item *a = p1, *b = p2;
+	int c = compare_keys(&b->key, &a->key);
+
+	if (c) return c;
+	return a->pos < b->pos ? -1 : (a->pos > b->pos);
+}
+
+struct sort_run {
+	struct sort_item *items;
+	gsize n;
+	int (*compare)(const void *, const void *);
+};
+
+static gpointer
+sort_run(gpointer data)
+{
+	struct sort_run *run = data;
+	qsort(run->items, run->n, sizeof(struct sort_item), run->compare);
+	return NULL;
+}
+
+static gint
+sort_threads(gsize n)
+{
+	glong cpus = 1;
+
+	if (n < PARALLEL_SORT_MIN || !g_thread_supported()) return 1;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (cpus < 1) cpus = 1;
+	return MIN(cpus, MAX_SORT_THREADS);
+}
+
+/* sorts items, the runs in parallel and then merging them pairwise.
+   Returns either items or a new array holding the result, the other
+   one is gone. */
+static struct sort_item *
+sort_items(struct sort_item *items, gsize n,
+	   int (*compare)(const void *, const void *))
+{
+	struct sort_run runs[MAX_SORT_THREADS];
+	GThread *threads[MAX_SORT_THREADS];
+	struct sort_item *tmp, *swap;
+	gint n_runs = sort_threads(n), i;
+	gsize per_run = (n + n_runs - 1) / n_runs, width;
+
+	if (n_runs == 1) {
+		qsort(items, n, sizeof(struct sort_item), compare);
+		return items;
+	}
+
+	for (i = 0 ; i < n_runs ; i++) {
+		gsize start = MIN(i * per_run, n);
+		runs[i].items = items + start;
+		runs[i].n = MIN(per_run, n - start);
+		runs[i].compare = compare;
+		threads[i] = g_thread_create(sort_run, &runs[i], TRUE, NULL);
+		if (threads[i] == NULL) sort_run(&runs[i]);
+	}
+	for (i = 0 ; i < n_runs ; i++) {
+		if (threads[i]) g_thread_join(threads[i]);
+	}
+
+	/* bottom up merges of the sorted runs */
+	tmp = g_new(struct sort_item, n);
+	for (width = per_run ; width < n ; width *= 2) {
+		gsize lo;
+
+		for (lo = 0 ; lo < n ; lo += 2 * width) {
+			gsize mid = MIN(lo + width, n), hi = MIN(lo + 2 * width, n);
+			gsize a = lo, b = mid, o = lo;
+
+			while (a < mid && b < hi) {
+				if (compare(&items[b], &items[a]) < 0) {
+					tmp[o++] = items[b++];
+				} else {
+					tmp[o++] = items[a++];
+				}
+			}
+			while (a < mid) tmp[o++] = items[a++];
+			while (b < hi) tmp[o++] = items[b++];
+		}
+		swap = items;
+		items = tmp;
+		tmp = swap;
+	}
+	g_free(tmp);
+
+	return items;
+}
+
+/* the clist is in the middle of a drag selection, as in gtkclist.c */
+static gboolean
+clist_has_grab(GtkCList *clist)
+{
+	return GTK_WIDGET_HAS_GRAB(clist) &&
+		gdk_display_pointer_is_grabbed(gtk_widget_get_display(GTK_WIDGET(clist)));
+}
+
+void
+gq_result_sort_clist(GqResultSort *sort, GtkCList *clist,
+		     gint column, GtkSortType type)
+{
+	struct column_keys *col;
+	struct sort_item *items, *sorted;
+	GList *link, *work;
+	guint id;
+	gint i;
+
+	g_return_if_fail(sort != NULL);
+	g_return_if_fail(GTK_IS_CLIST(clist));
+
+	gtk_clist_set_sort_column(clist, column);
+	gtk_clist_set_sort_type(clist, type);
+
+	if (clist->rows <= 1) return;
+	if (clist_has_grab(clist)) return;
+
+	gtk_clist_freeze(clist);
+
+	/* settle a pending extended selection first, the way
+	   gtk_clist_sort() does, its undo lists hold row numbers */
+	if (clist->anchor != -1 &&
+	    clist->selection_mode == GTK_SELECTION_MULTIPLE) {
+		GTK_CLIST_GET_CLASS(clist)->resync_selection(clist, NULL);
+		g_list_free(clist->undo_selection);
+		g_list_free(clist->undo_unselection);
+		clist->undo_selection = NULL;
+		clist->undo_unselection = NULL;
+	}
+
+	col = column < sort->n_columns ? &sort->columns[column] : NULL;
+
+	/* copy the keys next to each other, in list order */
+	items = g_new0(struct sort_item, clist->rows);
+	for (i = 0, link = clist->row_list ; link ; i++, link = link->next) {
+		gpointer data = GTK_CLIST_ROW(link)->data;
+
+		items[i].pos = i;
+		items[i].link = link;
+		if (data == NULL || col == NULL || col->keys == NULL) continue;
+
+		id = GQ_RESULT_ENTRY(data)->index;
+		if (id < col->keys->len) {
+			items[i].key = g_array_index(col->keys, struct sort_key, id);
+		}
+	}
+
+	sorted = sort_items(items, clist->rows,
+			    type == GTK_SORT_ASCENDING ?
+			    compare_ascending : compare_descending);
+
+	/* relink the rows, the way gtk_clist_sort() leaves them */
+	for (i = 0 ; i < clist->rows ; i++) {
+		link = sorted[i].link;
+		link->prev = i > 0 ? sorted[i - 1].link : NULL;
+		link->next = i < clist->rows - 1 ? sorted[i + 1].link : NULL;
+	}
+	clist->row_list = sorted[0].link;
+	clist->row_list_end = sorted[clist->rows - 1].link;
+
+	/* the selection is a list of row numbers */
+	work = clist->selection;
+	for (i = 0, link = clist->row_list ; link && work ;
+	     i++, link = link->next) {
+		if (GTK_CLIST_ROW(link)->state == GTK_STATE_SELECTED) {
+			work->data = GINT_TO_POINTER(i);
+			work = work->next;
+		}
+	}
+
+	gtk_clist_thaw(clist);
+
+	g_free(sorted);
+}
@@ -0,0 +1,60 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GQ_RESULT_SORT_H
+#define GQ_RESULT_SORT_H
+
+#include <gtk/gtk.h>
+
+#include "gq-type-display.h"
+
+G_BEGIN_DECLS
+
+/* Sort keys of a search result list, computed once when the rows
+   get added. Columns with a display type that has a sort_integer
+   (integers, numeric strings) or sort_number (times) function sort
+   numerically, values that do not parse go after the numbers. Everything else sorts as case
+   folded text. Empty cells go first.
+
+   Rows are identified by the index of their GqResultEntry, which is
+   what the rows of the list carry as row data. */
+
+typedef struct _GqResultSort GqResultSort;
+
+GqResultSort *gq_result_sort_new(void);
+void          gq_result_sort_free(GqResultSort *sort);
+
+void          gq_result_sort_set_column(GqResultSort *sort, gint column,
+					GqSortNumberFunc number,
+					GqSortIntegerFunc integer);
+
+/* text is what the cell shows, value the first value of the
+   attribute (the one numeric columns sort by) */
+void          gq_result_sort_add(GqResultSort *sort, guint id, gint column,
+				 const gchar *text, const gchar *value);
+
+/* reorders the rows of clist, in several threads if there are many */
+void          gq_result_sort_clist(GqResultSort *sort, GtkCList *clist,
+				   gint column, GtkSortType type);
+
+G_END_DECLS
+
+#endif /* !GQ_RESULT_SORT_H */
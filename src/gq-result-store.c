@@ -0,0 +1,203 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gq-result-store.h"
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+GqResultStore *
+gq_result_store_new(const char **requested)
+{
+	GqResultStore *store = g_new0(GqResultStore, 1);
+
+	store->refs = 1;
+	store->chunk = g_string_chunk_new(64 * 1024);
+	store->entries = g_ptr_array_sized_new(1024);
+	if (requested) {
+		store->requested = g_strdupv((gchar **) requested);
+	}
+	return store;
+}
+
+GqResultStore *
+gq_result_store_ref(GqResultStore *store)
+{
+	g_return_val_if_fail(store != NULL, NULL);
+
+	store->refs++;
+	return store;
+}
+
+void
+gq_result_store_unref(GqResultStore *store)
+{
+	guint i;
+
+	if (store == NULL) return;
+	if (--store->refs > 0) return;
+
+	for (i = 0 ; i < store->entries->len ; i++) {
+		GqResultEntry *entry = gq_result_store_get(store, i);
+		g_object_unref(entry->set.server);
+		g_free(entry);
+	}
+	g_ptr_array_free(store->entries, TRUE);
+	g_string_chunk_free(store->chunk);
+	g_strfreev(store->requested);
+	g_free(store);
+}
+
+GqResultEntry *
+gq_result_store_add(GqResultStore *store, GqServer *server,
+		    LDAP *ld, LDAPMessage *e)
+{
+	GqResultEntry *entry;
+	GArray *attrs, *values;
+	BerElement *ber = NULL;
+	struct berval **vals, *bv;
+	char *dn, *attr;
+	guint i, n = 0;
+
+	g_return_val_if_fail(store != NULL, NULL);
+
+	attrs = g_array_new(FALSE, FALSE, sizeof(GqResultAttr));
+	values = g_array_new(FALSE, FALSE, sizeof(struct berval));
+
+	for (attr = ldap_first_attribute(ld, e, &ber) ; attr != NULL ;
+	     attr = ldap_next_attribute(ld, e, ber)) {
+		GqResultAttr a;
+
+		a.name = g_string_chunk_insert_const(store->chunk, attr);
+		a.n_values = 0;
+		a.values = NULL;
+
+		vals = ldap_get_values_len(ld, e, attr);
+		for (i = 0 ; vals && vals[i] ; i++) {
+			struct berval v;
+			v.bv_len = vals[i]->bv_len;
+			v.bv_val = g_string_chunk_insert_len(store->chunk,
+							     vals[i]->bv_val,
+							     vals[i]->bv_len);
+			g_array_append_val(values, v);
+			a.n_values++;
+		}
+		if (vals) ldap_value_free_len(vals);
+
+		g_array_append_val(attrs, a);
+		ldap_memfree(attr);
+	}
+#ifndef HAVE_OPENLDAP12
+	if (ber) ber_free(ber, 0);
+#endif
+
+	/* one block: entry, attribute table, value descriptors */
+	entry = g_malloc0(sizeof(GqResultEntry) +
+			  attrs->len * sizeof(GqResultAttr) +
+			  values->len * sizeof(struct berval));
+	entry->n_attrs = attrs->len;
+	entry->attrs = (GqResultAttr *) (entry + 1);
+	bv = (struct berval *) (entry->attrs + attrs->len);
+	memcpy(bv, values->data, values->len * sizeof(struct berval));
+
+	for (i = 0 ; i < attrs->len ; i++) {
+		entry->attrs[i] = g_array_index(attrs, GqResultAttr, i);
+		entry->attrs[i].values = bv + n;
+		n += entry->attrs[i].n_values;
+	}
+
+	g_array_free(attrs, TRUE);
+	g_array_free(values, TRUE);
+
+	dn = ldap_get_dn(ld, e);
+	entry->set.dn = g_string_chunk_insert(store->chunk, dn ? dn : "");
+#if defined(HAVE_LDAP_MEMFREE)
+	ldap_memfree(dn);
+#else
+	free(dn);
+#endif
+	entry->set.server = g_object_ref(server);
+	entry->index = store->entries->len;
+
+	g_ptr_array_add(store->entries, entry);
+	return entry;
+}
+
+gboolean
+gq_result_store_is_complete(const GqResultStore *store)
+{
+	gchar **r;
+
+	g_return_val_if_fail(store != NULL, FALSE);
+
+	if (store->requested == NULL) return TRUE;
+
+	for (r = store->requested ; *r ; r++) {
+		if (strcmp(*r, "*") == 0) return TRUE;
+	}
+	return FALSE;
+}
+
+/* compares attribute descriptions up to their options */
+static gboolean
+same_attribute(const gchar *desc, const gchar *attr)
+{
+	gsize l = strcspn(attr, ";");
+	return g_ascii_strncasecmp(desc, attr, l) == 0 &&
+		(desc[l] == 0 || desc[l] == ';');
+}
+
+gboolean
+gq_result_store_has_attribute(const GqResultStore *store, const gchar *attr,
+			      gboolean operational)
+{
+	gchar **r;
+
+	g_return_val_if_fail(store != NULL, FALSE);
+
+	/* "*" means the user attributes only */
+	if (store->requested == NULL) return !operational;
+
+	for (r = store->requested ; *r ; r++) {
+		if (same_attribute(*r, attr)) return TRUE;
+		if (strcmp(*r, operational ? "+" : "*") == 0) return TRUE;
+	}
+	return FALSE;
+}
+
+const GqResultAttr *
+gq_result_entry_get_attr(const GqResultEntry *entry, const gchar *attr)
+{
+	guint i;
+
+	for (i = 0 ; i < entry->n_attrs ; i++) {
+		if (g_ascii_strcasecmp(entry->attrs[i].name, attr) == 0) {
+			return &entry->attrs[i];
+		}
+	}
+	return NULL;
+}
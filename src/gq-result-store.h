@@ -0,0 +1,90 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GQ_RESULT_STORE_H
+#define GQ_RESULT_STORE_H
+
+#include <glib.h>
+#include <ldap.h>
+
+#include "gq-server.h"
+
+G_BEGIN_DECLS
+
+/* The entries of the last search of a search tab, kept so results
+   can be refined locally instead of asking the server(s) again. All
+   strings live in one string chunk, every entry is a single block
+   holding its attribute table and the value descriptors. */
+
+typedef struct {
+	const gchar   *name;		/* attribute description as returned */
+	guint          n_values;
+	struct berval *values;		/* bv_val is NUL terminated */
+} GqResultAttr;
+
+typedef struct {
+	/* MUST be the first member: this is what the rows of the
+	   result list carry as their row data, see GQ_RESULT_ENTRY() */
+	struct dn_on_server set;
+	guint         index;		/* position in the store */
+	guint         deleted : 1;
+	guint         n_attrs;
+	GqResultAttr *attrs;
+} GqResultEntry;
+
+#define GQ_RESULT_ENTRY(set) ((GqResultEntry *) (set))
+
+typedef struct {
+	guint         refs;
+	GStringChunk *chunk;
+	GPtrArray    *entries;		/* GqResultEntry*, in arrival order */
+	/* the attributes asked for, NULL means all user attributes */
+	gchar       **requested;
+} GqResultStore;
+
+GqResultStore *gq_result_store_new(const char **requested);
+/* exporting keeps the results of a tab around for a while */
+GqResultStore *gq_result_store_ref(GqResultStore *store);
+void           gq_result_store_unref(GqResultStore *store);
+
+GqResultEntry *gq_result_store_add(GqResultStore *store, GqServer *server,
+				   LDAP *ld, LDAPMessage *e);
+
+#define gq_result_store_size(store)  ((store)->entries->len)
+#define gq_result_store_get(store, i) \
+	((GqResultEntry *) g_ptr_array_index((store)->entries, (i)))
+
+/* TRUE if attr (without options) came back with the entries, if it
+   was present at all. Operational attributes (as the schema has it)
+   only come back when asked for by name or with "+". */
+gboolean       gq_result_store_has_attribute(const GqResultStore *store,
+					     const gchar *attr,
+					     gboolean operational);
+/* TRUE if the entries carry all their user attributes, operational
+   ones may still be missing */
+gboolean       gq_result_store_is_complete(const GqResultStore *store);
+
+const GqResultAttr *gq_result_entry_get_attr(const GqResultEntry *entry,
+					     const gchar *attr);
+
+G_END_DECLS
+
+#endif /* !GQ_RESULT_STORE_H */
@@ -0,0 +1,551 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+
+#include "gq-schema-model.h"
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#ifdef HAVE_LDAP_STR2OBJECTCLASS
+
+#include <string.h>
+
+struct row_server {
+	GqServer *server;
+	guint index;			/* position in the model */
+	struct server_schema *ss;	/* NULL until loaded */
+	/* the names to show by type, those of ss or the matches */
+	GPtrArray *names[SCHEMA_TYPES];
+	/* the types with anything to show, in order */
+	gint present[SCHEMA_TYPES];
+	gint n_present;
+};
+
+struct _GqSchemaModel {
+	GObject base_instance;
+
+	gint stamp;
+	GPtrArray *servers;		/* struct row_server* */
+	gchar *text;			/* NULL: not filtered */
+	gboolean anywhere;
+};
+
+/* an iter points to a server, and through user_data2 and user_data3
+   (both counting from 1, 0 meaning none) to one of its categories
+   and a name in there */
+#define ITER_SERVER(iter)	((struct row_server *) (iter)->user_data)
+#define ITER_CATEGORY(iter)	(GPOINTER_TO_INT((iter)->user_data2) - 1)
+#define ITER_NAME(iter)		(GPOINTER_TO_INT((iter)->user_data3) - 1)
+
+static const gchar *category_names[SCHEMA_TYPES] = {
+	"objectClasses",
+	"attributeTypes",
+	"matchingRules",
+	"ldapSyntaxes"
+};
+
+static void gq_schema_model_tree_model_init(GtkTreeModelIface *iface);
+
+/* GType */
+G_DEFINE_TYPE_WITH_CODE(GqSchemaModel, gq_schema_model, G_TYPE_OBJECT,
+			G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL,
+					      gq_schema_model_tree_model_init));
+
+static void
+set_iter(GqSchemaModel *model, GtkTreeIter *iter, struct row_server *rs,
+	 gint category, gint name)
+{
+	iter->stamp = model->stamp;
+	iter->user_data = rs;
+	iter->user_data2 = GINT_TO_POINTER(category + 1);
+	iter->user_data3 = GINT_TO_POINTER(name + 1);
+}
+
+static GPtrArray *
+category_names_of(struct row_server *rs, gint category)
+{
+	return rs->names[rs->present[category]];
+}
+
+static void
+free_names(GqSchemaModel *model, struct row_server *rs)
+{
+	int i;
+
+	for (i = 0; i < SCHEMA_TYPES; i++) {
+		/* only the matches belong to the model */
+		if (model->text && rs->names[i]) {
+			g_ptr_array_free(rs->names[i], TRUE);
+		}
+		rs->names[i] = NULL;
+	}
+	rs->n_present = 0;
+}
+
+/* fills in what rs shows of its schema, narrowing down the rows of
+   within if given */
+static void
+find_names(GqSchemaModel *model, struct row_server *rs,
+	   struct row_server *within)
+{
+	int i;
+
+	rs->n_present = 0;
+	if (rs->ss == NULL) return;
+
+	for (i = 0; i < SCHEMA_TYPES; i++) {
+		if (model->text == NULL) {
+			rs->names[i] = rs->ss->names[i];
+		} else {
+			rs->names[i] = schema_find_names(rs->ss, i,
+							 model->text,
+							 model->anywhere,
+							 within ? within->names[i] : NULL);
+		}
+		if (rs->names[i] && rs->names[i]->len) {
+			rs->present[rs->n_present++] = i;
+		}
+	}
+}
+
+static struct row_server *
+append_server(GqSchemaModel *model, GqServer *server)
+{
+	struct row_server *rs = g_new0(struct row_server, 1);
+
+	rs->server = g_object_ref(server);
+	rs->index = model->servers->len;
+	g_ptr_array_add(model->servers, rs);
+
+	return rs;
+}
+
+GqSchemaModel *
+gq_schema_model_new(void)
+{
+	return g_object_new(GQ_TYPE_SCHEMA_MODEL, NULL);
+}
+
+void
+gq_schema_model_add_server(GqSchemaModel *model, GqServer *server)
+{
+	struct row_server *rs;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+
+	g_return_if_fail(model != NULL);
+	g_return_if_fail(GQ_IS_SERVER(server));
+
+	rs = append_server(model, server);
+
+	set_iter(model, &iter, rs, -1, -1);
+	path = gtk_tree_path_new_from_indices(rs->index, -1);
+	gtk_tree_model_row_inserted(GTK_TREE_MODEL(model), path, &iter);
+	/* not loaded yet, but that only happens when expanding it */
+	gtk_tree_model_row_has_child_toggled(GTK_TREE_MODEL(model), path,
+					     &iter);
+	gtk_tree_path_free(path);
+}
+
+void
+gq_schema_model_set_schema(GqSchemaModel *model, GtkTreeIter *iter,
+			   struct server_schema *ss)
+{
+	struct row_server *rs;
+	GtkTreePath *path;
+	GtkTreeIter child;
+	gint i;
+
+	g_return_if_fail(model != NULL);
+	g_return_if_fail(iter != NULL && iter->stamp == model->stamp);
+	g_return_if_fail(ITER_CATEGORY(iter) < 0);
+
+	rs = ITER_SERVER(iter);
+	path = gtk_tree_path_new_from_indices(rs->index, -1);
+
+	/* the rows go away one by one, the last first */
+	gtk_tree_path_append_index(path, 0);
+	while (rs->n_present > 0) {
+		rs->n_present--;
+		gtk_tree_path_up(path);
+		gtk_tree_path_append_index(path, rs->n_present);
+		gtk_tree_model_row_deleted(GTK_TREE_MODEL(model), path);
+	}
+	free_names(model, rs);
+	rs->ss = ss;
+	find_names(model, rs, NULL);
+
+	for (i = 0; i < rs->n_present; i++) {
+		gtk_tree_path_up(path);
+		gtk_tree_path_append_index(path, i);
+		set_iter(model, &child, rs, i, -1);
+		gtk_tree_model_row_inserted(GTK_TREE_MODEL(model), path,
+					    &child);
+		gtk_tree_model_row_has_child_toggled(GTK_TREE_MODEL(model),
+						     path, &child);
+	}
+
+	/* an empty schema leaves nothing to expand */
+	if (ss && rs->n_present == 0) {
+		gtk_tree_path_up(path);
+		gtk_tree_model_row_has_child_toggled(GTK_TREE_MODEL(model),
+						     path, iter);
+	}
+	gtk_tree_path_free(path);
+}
+
+gboolean
+gq_schema_model_is_loaded(GqSchemaModel *model, GtkTreeIter *iter)
+{
+	g_return_val_if_fail(model != NULL, FALSE);
+	g_return_val_if_fail(iter != NULL && iter->stamp == model->stamp,
+			     FALSE);
+
+	return ITER_SERVER(iter)->ss != NULL;
+}
+
+GqSchemaModel *
+gq_schema_model_filter(GqSchemaModel *model, const gchar *text,
+		       gboolean anywhere)
+{
+	GqSchemaModel *filtered;
+	gboolean narrow;
+	guint i;
+
+	g_return_val_if_fail(model != NULL, NULL);
+
+	filtered = gq_schema_model_new();
+	if (text && *text) {
+		filtered->text = g_strdup(text);
+		filtered->anywhere = anywhere;
+	}
+
+	/* names matching "cn" all contain "c", the same goes for
+	   starting with it */
+	narrow = filtered->text && model->text &&
+		anywhere == model->anywhere &&
+		g_ascii_strncasecmp(filtered->text, model->text,
+				    strlen(model->text)) == 0;
+
+	for (i = 0; i < model->servers->len; i++) {
+		struct row_server *old = g_ptr_array_index(model->servers, i);
+		struct row_server *rs = append_server(filtered, old->server);
+
+		rs->ss = old->ss;
+		find_names(filtered, rs, narrow ? old : NULL);
+	}
+
+	return filtered;
+}
+
+const gchar *
+gq_schema_model_get_text(GqSchemaModel *model)
+{
+	g_return_val_if_fail(model != NULL, NULL);
+
+	return model->text;
+}
+
+/* GtkTreeModel */
+
+static GtkTreeModelFlags
+get_flags(GtkTreeModel *tree_model)
+{
+	return 0;
+}
+
+static gint
+get_n_columns(GtkTreeModel *tree_model)
+{
+	return GQ_SCHEMA_MODEL_N_COLUMNS;
+}
+
+static GType
+get_column_type(GtkTreeModel *tree_model, gint column)
+{
+	switch (column) {
+	case GQ_SCHEMA_MODEL_COL_NAME:
+		return G_TYPE_STRING;
+	case GQ_SCHEMA_MODEL_COL_TYPE:
+		return G_TYPE_INT;
+	case GQ_SCHEMA_MODEL_COL_OBJECT:
+		return G_TYPE_POINTER;
+	case GQ_SCHEMA_MODEL_COL_SERVER:
+		return G_TYPE_OBJECT;
+	default:
+		g_return_val_if_reached(G_TYPE_INVALID);
+	}
+}
+
+static gboolean
+get_iter(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path)
+{
+	GqSchemaModel *model = GQ_SCHEMA_MODEL(tree_model);
+	struct row_server *rs;
+	gint depth = gtk_tree_path_get_depth(path);
+	gint *indices = gtk_tree_path_get_indices(path);
+	gint category = -1, name = -1;
+
+	if (depth < 1 || depth > 3) return FALSE;
+
+	if (indices[0] < 0 || indices[0] >= (gint) model->servers->len)
+		return FALSE;
+	rs = g_ptr_array_index(model->servers, indices[0]);
+
+	if (depth > 1) {
+		category = indices[1];
+		if (category < 0 || category >= rs->n_present) return FALSE;
+	}
+	if (depth > 2) {
+		name = indices[2];
+		if (name < 0 ||
+		    name >= (gint) category_names_of(rs, category)->len)
+			return FALSE;
+	}
+
+	set_iter(model, iter, rs, category, name);
+	return TRUE;
+}
+
+static GtkTreePath *
+get_path(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	GtkTreePath *path;
+
+	g_return_val_if_fail(iter->stamp == GQ_SCHEMA_MODEL(tree_model)->stamp,
+			     NULL);
+
+	path = gtk_tree_path_new_from_indices(ITER_SERVER(iter)->index, -1);
+	if (ITER_CATEGORY(iter) >= 0) {
+		gtk_tree_path_append_index(path, ITER_CATEGORY(iter));
+	}
+	if (ITER_NAME(iter) >= 0) {
+		gtk_tree_path_append_index(path, ITER_NAME(iter));
+	}
+	return path;
+}
+
+static void
+get_value(GtkTreeModel *tree_model, GtkTreeIter *iter, gint column,
+	  GValue *value)
+{
+	struct row_server *rs = ITER_SERVER(iter);
+	gint category = ITER_CATEGORY(iter);
+	struct schema_name *name = NULL;
+
+	g_return_if_fail(iter->stamp == GQ_SCHEMA_MODEL(tree_model)->stamp);
+
+	if (ITER_NAME(iter) >= 0) {
+		name = g_ptr_array_index(category_names_of(rs, category),
+					 ITER_NAME(iter));
+	}
+
+	g_value_init(value, get_column_type(tree_model, column));
+	switch (column) {
+	case GQ_SCHEMA_MODEL_COL_NAME:
+		if (name) {
+			g_value_set_string(value, name->name);
+		} else if (category >= 0) {
+			g_value_set_string(value,
+					   category_names[rs->present[category]]);
+		} else {
+			g_value_set_string(value, rs->server->name);
+		}
+		break;
+	case GQ_SCHEMA_MODEL_COL_TYPE:
+		g_value_set_int(value, category >= 0 ?
+				rs->present[category] : -1);
+		break;
+	case GQ_SCHEMA_MODEL_COL_OBJECT:
+		g_value_set_pointer(value, name ? name->object : NULL);
+		break;
+	case GQ_SCHEMA_MODEL_COL_SERVER:
+		g_value_set_object(value, rs->server);
+		break;
+	}
+}
+
+static gboolean
+iter_nth_child(GtkTreeModel *tree_model, GtkTreeIter *iter,
+	       GtkTreeIter *parent, gint n)
+{
+	GqSchemaModel *model = GQ_SCHEMA_MODEL(tree_model);
+	struct row_server *rs;
+
+	if (n < 0) return FALSE;
+
+	if (parent == NULL) {
+		if (n >= (gint) model->servers->len) return FALSE;
+		set_iter(model, iter, g_ptr_array_index(model->servers, n),
+			 -1, -1);
+		return TRUE;
+	}
+
+	g_return_val_if_fail(parent->stamp == model->stamp, FALSE);
+
+	rs = ITER_SERVER(parent);
+	if (ITER_CATEGORY(parent) < 0) {
+		if (n >= rs->n_present) return FALSE;
+		set_iter(model, iter, rs, n, -1);
+		return TRUE;
+	}
+	if (ITER_NAME(parent) < 0) {
+		if (n >= (gint) category_names_of(rs, ITER_CATEGORY(parent))->len)
+			return FALSE;
+		set_iter(model, iter, rs, ITER_CATEGORY(parent), n);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+static gboolean
+iter_children(GtkTreeModel *tree_model, GtkTreeIter *iter,
+	      GtkTreeIter *parent)
+{
+	return iter_nth_child(tree_model, iter, parent, 0);
+}
+
+static gboolean
+iter_next(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	GqSchemaModel *model = GQ_SCHEMA_MODEL(tree_model);
+	struct row_server *rs = ITER_SERVER(iter);
+	gint category = ITER_CATEGORY(iter);
+	gint name = ITER_NAME(iter);
+
+	g_return_val_if_fail(iter->stamp == model->stamp, FALSE);
+
+	if (name >= 0) {
+		if (name + 1 >= (gint) category_names_of(rs, category)->len)
+			return FALSE;
+		set_iter(model, iter, rs, category, name + 1);
+	} else if (category >= 0) {
+		if (category + 1 >= rs->n_present) return FALSE;
+		set_iter(model, iter, rs, category + 1, -1);
+	} else {
+		if (rs->index + 1 >= model->servers->len) return FALSE;
+		set_iter(model, iter,
+			 g_ptr_array_index(model->servers, rs->index + 1),
+			 -1, -1);
+	}
+	return TRUE;
+}
+
+static gint
+iter_n_children(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	GqSchemaModel *model = GQ_SCHEMA_MODEL(tree_model);
+	struct row_server *rs;
+
+	if (iter == NULL) return model->servers->len;
+
+	g_return_val_if_fail(iter->stamp == model->stamp, 0);
+
+	rs = ITER_SERVER(iter);
+	if (ITER_CATEGORY(iter) < 0) return rs->n_present;
+	if (ITER_NAME(iter) < 0)
+		return category_names_of(rs, ITER_CATEGORY(iter))->len;
+	return 0;
+}
+
+static gboolean
+iter_has_child(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	g_return_val_if_fail(iter->stamp == GQ_SCHEMA_MODEL(tree_model)->stamp,
+			     FALSE);
+
+	/* a server not loaded yet might have something */
+	if (ITER_CATEGORY(iter) < 0) {
+		return ITER_SERVER(iter)->ss == NULL ||
+			ITER_SERVER(iter)->n_present > 0;
+	}
+	/* categories get shown only with something in them */
+	return ITER_NAME(iter) < 0;
+}
+
+static gboolean
+iter_parent(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *child)
+{
+	GqSchemaModel *model = GQ_SCHEMA_MODEL(tree_model);
+
+	g_return_val_if_fail(child->stamp == model->stamp, FALSE);
+
+	if (ITER_CATEGORY(child) < 0) return FALSE;
+
+	set_iter(model, iter, ITER_SERVER(child),
+		 ITER_NAME(child) < 0 ? -1 : ITER_CATEGORY(child), -1);
+	return TRUE;
+}
+
+static void
+gq_schema_model_tree_model_init(GtkTreeModelIface *iface)
+{
+	iface->get_flags = get_flags;
+	iface->get_n_columns = get_n_columns;
+	iface->get_column_type = get_column_type;
+	iface->get_iter = get_iter;
+	iface->get_path = get_path;
+	iface->get_value = get_value;
+	iface->iter_next = iter_next;
+	iface->iter_children = iter_children;
+	iface->iter_has_child = iter_has_child;
+	iface->iter_n_children = iter_n_children;
+	iface->iter_nth_child = iter_nth_child;
+	iface->iter_parent = iter_parent;
+}
+
+static void
+gq_schema_model_init(GqSchemaModel *self)
+{
+	do {
+		self->stamp = g_random_int();
+	} while (self->stamp == 0);
+	self->servers = g_ptr_array_new();
+}
+
+static void
+schema_model_finalize(GObject *object)
+{
+	GqSchemaModel *self = GQ_SCHEMA_MODEL(object);
+	guint i;
+
+	for (i = 0; i < self->servers->len; i++) {
+		struct row_server *rs = g_ptr_array_index(self->servers, i);
+
+		free_names(self, rs);
+		g_object_unref(rs->server);
+		g_free(rs);
+	}
+	g_ptr_array_free(self->servers, TRUE);
+	g_free(self->text);
+
+	G_OBJECT_CLASS(gq_schema_model_parent_class)->finalize(object);
+}
+
+static void
+gq_schema_model_class_init(GqSchemaModelClass *self_class)
+{
+	G_OBJECT_CLASS(self_class)->finalize = schema_model_finalize;
+}
+
+#endif /* HAVE_LDAP_STR2OBJECTCLASS */
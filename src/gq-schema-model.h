@@ -0,0 +1,81 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+
+#ifndef GQ_SCHEMA_MODEL_H
+#define GQ_SCHEMA_MODEL_H
+
+#include <gtk/gtktreemodel.h>
+
+#include "gq-server.h"
+#include "schema.h"
+
+G_BEGIN_DECLS
+
+/* What the schema tab shows: the servers, for every server whose
+   schema got loaded its objectClasses, attribute types, matching
+   rules and syntaxes, and below those every name (or the OID of what
+   has none).
+
+   The rows are never copied out of the schema: they are the sorted
+   name indexes parse_server_schema() builds, so showing a schema
+   costs nothing until rows get looked at. A filtered model shows
+   only the names matching a text, categories without any are left
+   out. */
+
+typedef struct _GqSchemaModel GqSchemaModel;
+typedef GObjectClass          GqSchemaModelClass;
+
+#define GQ_TYPE_SCHEMA_MODEL         (gq_schema_model_get_type())
+#define GQ_SCHEMA_MODEL(i)           (G_TYPE_CHECK_INSTANCE_CAST((i), GQ_TYPE_SCHEMA_MODEL, GqSchemaModel))
+
+enum {
+	GQ_SCHEMA_MODEL_COL_NAME,	/* gchararray */
+	GQ_SCHEMA_MODEL_COL_TYPE,	/* enum schema_detail_type of names
+					   and categories, -1 for servers */
+	GQ_SCHEMA_MODEL_COL_OBJECT,	/* LDAPObjectClass... for names */
+	GQ_SCHEMA_MODEL_COL_SERVER,	/* GqServer */
+	GQ_SCHEMA_MODEL_N_COLUMNS
+};
+
+GType          gq_schema_model_get_type(void);
+GqSchemaModel *gq_schema_model_new(void);
+
+void     gq_schema_model_add_server(GqSchemaModel *model, GqServer *server);
+/* shows ss below the server at iter, NULL takes the schema away
+   again. ss has to stay around as long as the model does. */
+void     gq_schema_model_set_schema(GqSchemaModel *model, GtkTreeIter *iter,
+				    struct server_schema *ss);
+/* whether the schema of the server at iter is shown */
+gboolean gq_schema_model_is_loaded(GqSchemaModel *model, GtkTreeIter *iter);
+
+/* A new model over the same servers and schemas, showing only the
+   names matching text (see schema_find_names()), or everything for
+   an empty text. If text extends the text of model, only its rows
+   get looked through. */
+GqSchemaModel *gq_schema_model_filter(GqSchemaModel *model,
+				      const gchar *text, gboolean anywhere);
+/* the text model shows the matches for, NULL if it is not filtered */
+const gchar   *gq_schema_model_get_text(GqSchemaModel *model);
+
+G_END_DECLS
+
+#endif /* !GQ_SCHEMA_MODEL_H */
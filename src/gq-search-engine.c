@@ -0,0 +1,403 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gq-search-engine.h"
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <poll.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+
+#include "configfile.h"
+#include "errorchain.h"
+#include "gq-server-stats.h"
+#include "util.h"
+
+/* how often (in seconds) the tick function gets called */
+#define TICK_INTERVAL	0.5
+/* longest wait (in ms) for any of the servers to answer */
+#define POLL_INTERVAL	500
+
+/* one search running on one server, several of them run at the same
+   time when searching several servers */
+struct running_search {
+	GqSearchBase *sb;
+	LDAP *ld;
+	int msg;
+	char *filter;
+	gdouble start;
+	gboolean first;
+};
+
+GqSearchBase *
+gq_search_base_new(GqServer *server, const char *base)
+{
+	GqSearchBase *sb = g_malloc0(sizeof(GqSearchBase));
+	sb->base = g_strdup(base);
+	if(server) {
+		sb->server = g_object_ref(server);
+	} else {
+		sb->server = NULL;
+	}
+	return sb;
+}
+
+void
+gq_search_base_free(GqSearchBase *sb)
+{
+	if(sb->server) {
+		g_object_unref(sb->server);
+		sb->server = NULL;
+	}
+	g_free(sb->base);
+	g_free(sb);
+}
+
+char *
+make_filter(GqServer *server, char *querystring)
+{
+	char *filter = NULL;
+	int l = strlen(querystring);
+
+	if(querystring[0] == '(') {  /* UTF-8 OK */
+		filter = g_strdup(querystring);
+	}
+	else if(g_utf8_strchr(querystring, -1, '=')) {
+		l += 3;
+		filter = g_malloc(l);
+		g_snprintf(filter, l, "(%s)", querystring);
+	}
+	else {
+		int sl = strlen(server->searchattr);
+		l += sl + 10;
+		filter = g_malloc(l + 1);
+
+		switch(config->search_argument) {
+		case SEARCHARG_BEGINS_WITH:
+			g_snprintf(filter, l, "(%s=%s*)", server->searchattr, querystring);
+			break;
+		case SEARCHARG_ENDS_WITH:
+			g_snprintf(filter, l, "(%s=*%s)", server->searchattr, querystring);
+			break;
+		case SEARCHARG_CONTAINS:
+			g_snprintf(filter, l, "(%s=*%s*)", server->searchattr, querystring);
+			break;
+		case SEARCHARG_EQUALS:
+			g_snprintf(filter, l, "(%s=%s)", server->searchattr, querystring);
+			break;
+		default:
+			filter[0] = 0;
+			break;
+		};
+	}
+
+	return(filter);
+}
+
+static void
+add_referral(int error_context, GqServer *server, const char *referral,
+	     GList **nextlevel)
+{
+	LDAPURLDesc *desc = NULL;
+
+	if (ldap_url_parse(referral, &desc) == 0) {
+		GqServer *newserver;
+
+		newserver = get_referral_server(error_context, server,
+						referral);
+		newserver->quiet = 1;
+
+		canonicalize_ldapserver(newserver);
+
+		transient_add_server(newserver);
+
+		*nextlevel = g_list_append(*nextlevel,
+					   gq_search_base_new(newserver,
+							      desc->lud_dn));
+
+		ldap_free_urldesc(desc);
+	}
+}
+
+static void
+free_running_search(struct running_search *rs)
+{
+	close_connection(rs->sb->server, FALSE);
+	gq_search_base_free(rs->sb);
+	g_free(rs->filter);
+	g_free(rs);
+}
+
+/* Sends the search for sb. Returns NULL (and takes care of sb) if
+   that did not work out. */
+static struct running_search *
+start_search(int error_context, GqSearchBase *sb, char *querystring,
+	     const GqSearchParams *params, LDAPControl **ctrls)
+{
+	struct running_search *rs;
+	GqServer *server = sb->server;
+	LDAP *ld;
+	int rc;
+
+	if( (ld = open_connection(error_context, server)) == NULL) {
+		gq_search_base_free(sb);
+		return NULL;
+	}
+
+	rs = g_malloc0(sizeof(struct running_search));
+	rs->sb = sb;
+	rs->ld = ld;
+	rs->filter = make_filter(server, querystring);
+	rs->first = TRUE;
+
+	statusbar_msg(_("Searching on server '%1$s' below '%2$s'"),
+		      server->name, sb->base);
+	rs->start = gq_server_stats_start();
+	rc = ldap_search_ext(ld, sb->base,
+			     params->scope,
+			     rs->filter,
+			     (char **)params->attrs,	/* attrs & API bug*/
+			     0,				/* attrsonly */
+			     params->chase_ref ? NULL : ctrls,
+			     /* serverctrls */
+			     NULL,			/* clientctrls */
+			     NULL,			/* timeout */
+			     LDAP_NO_LIMIT,		/* sizelimit */
+			     &rs->msg);
+
+	if(rc != LDAP_SUCCESS) {
+		if (rc == LDAP_SERVER_DOWN) {
+			server->server_down++;
+		}
+		gq_server_stats_stop(server, GQ_STAT_SEARCH, rs->start, FALSE);
+		error_push(error_context,
+			   _("Error searching on server '%1$s' below '%2$s': %3$s"),
+			   server->name, sb->base, ldap_err2string(rc));
+		free_running_search(rs);
+		return NULL;
+	}
+
+	return rs;
+}
+
+/* Picks up what has arrived for rs, waiting at most timeout (NULL
+   blocks). Returns -1 once the search is complete, otherwise the
+   number of messages handled. Entries get counted in found. */
+static int
+poll_search(int error_context, struct running_search *rs,
+	    struct timeval *timeout, const GqSearchParams *params,
+	    GList **nextlevel, int *found)
+{
+	GqServer *server = rs->sb->server;
+	LDAP *ld = rs->ld;
+	LDAPMessage *res = NULL, *e;
+	int rc, i, err, code, n = 0;
+
+	code = ldap_result(ld, rs->msg, 0, timeout, &res);
+	if (code == 0) {
+		return 0;
+	}
+	if (code == -1) {
+		/* error */
+		gq_server_stats_stop(server, GQ_STAT_SEARCH, rs->start, FALSE);
+		error_push(error_context,
+			   _("Unspecified error searching on server '%1$s' below '%2$s'"),
+			   server->name, rs->sb->base);
+		return -1;
+	}
+
+	for( rc = 1, e = ldap_first_message(ld, res) ; e != NULL ;
+	     e = ldap_next_message(ld, e) ) {
+		n++;
+		switch (ldap_msgtype(e)) {
+		case LDAP_RES_SEARCH_ENTRY: {
+			gdouble rstart;
+
+			if (rs->first) {
+				gq_server_stats_stop(server, GQ_STAT_SEARCH_FIRST,
+						     rs->start, TRUE);
+				rs->first = FALSE;
+			}
+			gq_server_stats_entries(server, 1);
+
+			rstart = gq_server_stats_start();
+			params->entry(server, ld, e, params->user_data);
+			gq_server_stats_stop(server, GQ_STAT_RENDER,
+					     rstart, TRUE);
+			gq_server_stats_rendered(server, 1);
+			(*found)++;
+			break; /* OK */
+		}
+		case LDAP_RES_SEARCH_REFERENCE: {
+			char **refs = NULL;
+
+			if (ldap_parse_reference(ld, e, &refs, NULL, 0) == LDAP_SUCCESS) {
+				for (i = 0 ; refs[i] ; i++) {
+					add_referral(error_context, server,
+						     refs[i], nextlevel);
+				}
+			}
+			ldap_value_free(refs);
+			break;
+		}
+		case LDAP_RES_SEARCH_RESULT:
+			err = ldap_result2error(ld, e, 0);
+			gq_server_stats_stop(server, GQ_STAT_SEARCH, rs->start,
+					     err == LDAP_SUCCESS);
+			/* a failing server does not spoil what the others
+			   found, just tell which one it was */
+			if (err != LDAP_SUCCESS &&
+			    err != LDAP_SIZELIMIT_EXCEEDED &&
+			    err != LDAP_TIMELIMIT_EXCEEDED &&
+			    err != LDAP_REFERRAL) {
+				error_push(error_context,
+					   _("Error searching on server '%1$s' below '%2$s': %3$s"),
+					   server->name, rs->sb->base,
+					   ldap_err2string(err));
+				push_ldap_addl_error(ld, error_context);
+				if (err == LDAP_SERVER_DOWN) {
+					server->server_down++;
+				}
+			}
+			rc = 0;
+			break;
+		default:
+			rc = 0;
+			break;
+		}
+	}
+	if (res) ldap_msgfree(res);
+
+	return rc ? n : -1;
+}
+
+/* sleeps until one of the running searches has something to read */
+static void
+wait_for_answers(GList *running)
+{
+	struct pollfd *fds;
+	GList *r;
+	int nfds = 0;
+
+	fds = g_new(struct pollfd, g_list_length(running));
+	for (r = running ; r ; r = r->next) {
+		struct running_search *rs = r->data;
+
+		if (ldap_get_option(rs->ld, LDAP_OPT_DESC,
+				    &fds[nfds].fd) != LDAP_OPT_SUCCESS) {
+			continue;
+		}
+		fds[nfds].events = POLLIN;
+		fds[nfds].revents = 0;
+		nfds++;
+	}
+	if (nfds > 0) poll(fds, nfds, POLL_INTERVAL);
+	g_free(fds);
+}
+
+int
+gq_search_run(int error_context, GList *level, char *querystring,
+	      const GqSearchParams *params)
+{
+	LDAPControl c;
+	LDAPControl *ctrls[2] = { NULL, NULL } ;
+	struct running_search *rs;
+	struct timeval zero = { 0, 0 };
+	GList *nextlevel = NULL, *running = NULL, *r, *next;
+	int depth = 0, found = 0, running_count, got;
+	gdouble last_tick;
+
+	/* prepare ManageDSAit in case we should show referrals */
+	c.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+	c.ldctl_value.bv_val	= NULL;
+	c.ldctl_value.bv_len	= 0;
+	c.ldctl_iscritical	= 1;
+
+	ctrls[0] = &c;
+
+	while (level || nextlevel) {
+		if (level == NULL) {
+			depth++;
+			level = nextlevel;
+			nextlevel = NULL;
+		}
+		if (depth > params->max_depth) {
+			statusbar_msg(_("Reached maximum recursion depth"));
+
+			g_list_foreach(level, (GFunc) gq_search_base_free, NULL);
+			g_list_free(level);
+			break;
+		}
+
+		/* send all searches of this level at once, a slow or
+		   dead server only holds up its own results */
+		while (level) {
+			GqSearchBase *sb = level->data;
+			level = g_list_remove(level, sb);
+
+			rs = start_search(error_context, sb, querystring,
+					  params, ctrls);
+			if (rs) running = g_list_append(running, rs);
+		}
+
+		last_tick = gq_server_stats_start();
+		while (running) {
+			running_count = g_list_length(running);
+			got = 0;
+
+			for (r = running ; r ; r = next) {
+				int n;
+
+				next = r->next;
+				rs = r->data;
+
+				/* with just one search there is nothing
+				   to multiplex, simply wait for it */
+				n = poll_search(error_context, rs,
+						running_count == 1 ? NULL : &zero,
+						params, &nextlevel, &found);
+				if (n < 0) {
+					running = g_list_delete_link(running, r);
+					free_running_search(rs);
+					got++;
+				} else {
+					got += n;
+				}
+			}
+
+			if (running && got == 0) {
+				wait_for_answers(running);
+			}
+
+			if (params->tick && running &&
+			    gq_server_stats_start() - last_tick > TICK_INTERVAL) {
+				params->tick(params->user_data);
+				last_tick = gq_server_stats_start();
+			}
+		}
+	}
+
+	return found;
+}
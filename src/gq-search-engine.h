@@ -0,0 +1,83 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GQ_SEARCH_ENGINE_H
+#define GQ_SEARCH_ENGINE_H
+
+#include <glib.h>
+#include <ldap.h>
+
+#include "gq-server.h"
+
+G_BEGIN_DECLS
+
+/* The searching behind the search tab, without any widgets: sends
+   the search to every base of a level at once, collects what comes
+   back and follows referrals level by level. Whoever runs it gets
+   the entries through a callback, so the search tab fills its list
+   and batch tools just count. */
+
+typedef enum {
+	SEARCHARG_BEGINS_WITH,
+	SEARCHARG_ENDS_WITH,
+	SEARCHARG_CONTAINS,
+	SEARCHARG_EQUALS
+} GqSearchType;
+
+/* one base to search below */
+typedef struct {
+	GqServer *server;
+	char *base;
+} GqSearchBase;
+
+GqSearchBase *gq_search_base_new(GqServer *server, const char *base);
+void          gq_search_base_free(GqSearchBase *sb);
+
+/* e is a LDAP_RES_SEARCH_ENTRY from ld, valid for the duration of
+   the call */
+typedef void (*GqSearchEntryFunc)(GqServer *server, LDAP *ld,
+				  LDAPMessage *e, gpointer user_data);
+/* called about twice a second while searches are running */
+typedef void (*GqSearchTickFunc)(gpointer user_data);
+
+typedef struct {
+	int scope;
+	gboolean chase_ref;	/* else referrals get returned as entries */
+	int max_depth;		/* levels of referrals to follow */
+	const char **attrs;	/* NULL: all */
+	GqSearchEntryFunc entry;
+	GqSearchTickFunc tick;	/* may be NULL */
+	gpointer user_data;
+} GqSearchParams;
+
+/* turns what got typed into the search box into a filter for server,
+   following config->search_argument. g_free the result. */
+char *make_filter(GqServer *server, char *querystring);
+
+/* searches below every GqSearchBase of level (which it takes over)
+   for querystring. Failing servers get their errors pushed, without
+   stopping the others. Returns the number of entries found. */
+int gq_search_run(int error_context, GList *level, char *querystring,
+		  const GqSearchParams *params);
+
+G_END_DECLS
+
+#endif /* !GQ_SEARCH_ENGINE_H */
@@ -0,0 +1,297 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+
+#include "gq-server-probe.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <gtk/gtk.h>
+#include <ldap.h>
+
+struct probe_waiter {
+	GqServerProbeFunc func;
+	gpointer          data;
+};
+
+struct server_probe {
+	GqServer        *server;
+	GList           *waiters;
+	struct addrinfo *addrs;
+	struct addrinfo *cur;	/* the address being tried */
+	int              fd;
+	GIOChannel      *chan;
+	guint            watch;
+	guint            timer;
+	gboolean         reachable;	/* for probe_later() */
+};
+
+typedef enum {
+	PROBE_OK,
+	PROBE_WAIT,
+	PROBE_FAILED
+} ProbeState;
+
+/* GqServer -> struct server_probe */
+static GHashTable *probes = NULL;
+
+static void
+probe_done(struct server_probe *p, gboolean reachable)
+{
+	GList *waiters = p->waiters, *I;
+
+	g_hash_table_remove(probes, p->server);
+
+	if (p->watch) g_source_remove(p->watch);
+	if (p->timer) gtk_timeout_remove(p->timer);
+	if (p->chan)  g_io_channel_unref(p->chan);
+	if (p->fd >= 0) close(p->fd);
+	if (p->addrs) freeaddrinfo(p->addrs);
+
+	/* the callbacks may well start new probes */
+	for (I = waiters ; I ; I = g_list_next(I)) {
+		struct probe_waiter *w = I->data;
+		w->func(p->server, reachable, w->data);
+		g_free(w);
+	}
+	g_list_free(waiters);
+
+	g_object_unref(p->server);
+	g_free(p);
+}
+
+static gboolean probe_ready(GIOChannel *chan, GIOCondition cond,
+			    struct server_probe *p);
+
+/* tries the addresses of the server in turn */
+static ProbeState
+probe_connect(struct server_probe *p)
+{
+	for ( ; p->cur ; p->cur = p->cur->ai_next) {
+		int fd = socket(p->cur->ai_family, p->cur->ai_socktype,
+				p->cur->ai_protocol);
+		if (fd < 0) continue;
+
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+		if (connect(fd, p->cur->ai_addr, p->cur->ai_addrlen) == 0) {
+			close(fd);
+			return PROBE_OK;
+		}
+		if (errno == EINPROGRESS) {
+			p->fd = fd;
+			p->chan = g_io_channel_unix_new(fd);
+			p->watch = g_io_add_watch(p->chan,
+						  G_IO_OUT | G_IO_ERR | G_IO_HUP,
+						  (GIOFunc) probe_ready, p);
+			return PROBE_WAIT;
+		}
+		close(fd);
+	}
+	return PROBE_FAILED;
+}
+
+static gboolean
+probe_ready(GIOChannel *chan, GIOCondition cond, struct server_probe *p)
+{
+	int err = 0;
+	socklen_t len = sizeof(err);
+	ProbeState state;
+
+	if (getsockopt(p->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0) {
+		err = errno;
+	}
+
+	p->watch = 0;
+	g_io_channel_unref(p->chan);
+	p->chan = NULL;
+	close(p->fd);
+	p->fd = -1;
+
+	if (err == 0) {
+		probe_done(p, TRUE);
+		return FALSE;
+	}
+
+	p->cur = p->cur->ai_next;
+	state = probe_connect(p);
+	if (state != PROBE_WAIT) {
+		probe_done(p, state == PROBE_OK);
+	}
+	return FALSE;
+}
+
+static gboolean
+probe_result(struct server_probe *p)
+{
+	p->timer = 0;
+	probe_done(p, p->reachable);
+	return FALSE;
+}
+
+/* callers always get called back from the main loop, even if the
+   answer is known right away */
+static void
+probe_later(struct server_probe *p, gboolean reachable)
+{
+	p->reachable = reachable;
+	p->timer = gtk_timeout_add(0, (GtkFunction) probe_result, p);
+}
+
+/* the host and port libldap will connect to first. Returns FALSE if
+   there is nothing we could check. */
+static gboolean
+probe_address(GqServer *server, gchar **host, int *port)
+{
+	const char *h = server->ldaphost;
+
+	*host = NULL;
+	if (h == NULL || *h == 0) return FALSE;
+
+	if (g_utf8_strchr(h, -1, ':') != NULL) {
+		LDAPURLDesc *desc = NULL;
+
+		if (ldap_url_parse(h, &desc) != 0) return FALSE;
+
+		if (desc->lud_scheme && strcasecmp(desc->lud_scheme, "ldapi") == 0) {
+			ldap_free_urldesc(desc);
+			return FALSE;
+		}
+		if (desc->lud_host && *desc->lud_host) {
+			*host = g_strdup(desc->lud_host);
+		} else {
+			*host = g_strdup("localhost");
+		}
+		*port = desc->lud_port;
+		if (*port == 0) {
+			*port = (desc->lud_scheme &&
+				 strcasecmp(desc->lud_scheme, "ldaps") == 0) ?
+				LDAPS_PORT : LDAP_PORT;
+		}
+		ldap_free_urldesc(desc);
+	} else {
+		/* ldap_init() takes a list of hosts */
+		gchar **hosts = g_strsplit(h, " ", 2);
+		*host = g_strdup(hosts[0]);
+		*port = server->ldapport;
+		g_strfreev(hosts);
+	}
+
+	return *host != NULL;
+}
+
+void
+gq_server_probe(GqServer *server, guint timeout,
+		GqServerProbeFunc func, gpointer data)
+{
+	struct server_probe *p;
+	struct probe_waiter *w;
+	struct addrinfo hints;
+	gchar *host = NULL, *service;
+	int port = 0;
+
+	g_return_if_fail(GQ_IS_SERVER(server));
+	g_return_if_fail(func);
+
+	if (probes == NULL) {
+		probes = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+
+	w = g_new0(struct probe_waiter, 1);
+	w->func = func;
+	w->data = data;
+
+	p = g_hash_table_lookup(probes, server);
+	if (p) {
+		p->waiters = g_list_append(p->waiters, w);
+		return;
+	}
+
+	p = g_new0(struct server_probe, 1);
+	p->server = g_object_ref(server);
+	p->waiters = g_list_append(NULL, w);
+	p->fd = -1;
+	g_hash_table_insert(probes, server, p);
+
+	if ((server->connection && server->server_down == 0) ||
+	    !probe_address(server, &host, &port)) {
+		probe_later(p, TRUE);
+		return;
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	service = g_strdup_printf("%d", port);
+
+	/* NOTE: name resolution itself still blocks */
+	if (getaddrinfo(host, service, &hints, &p->addrs) != 0) {
+		/* unknown host */
+		p->addrs = NULL;
+		probe_later(p, FALSE);
+	} else {
+		p->cur = p->addrs;
+		switch (probe_connect(p)) {
+		case PROBE_WAIT:
+			/* reachable stays FALSE: the timeout means failure */
+			p->timer = gtk_timeout_add(timeout,
+						   (GtkFunction) probe_result,
+						   p);
+			break;
+		case PROBE_OK:
+			probe_later(p, TRUE);
+			break;
+		case PROBE_FAILED:
+			probe_later(p, FALSE);
+			break;
+		}
+	}
+
+	g_free(service);
+	g_free(host);
+}
+
+void
+gq_server_probe_cancel(GqServer *server,
+		       GqServerProbeFunc func, gpointer data)
+{
+	struct server_probe *p;
+	GList *I;
+
+	if (probes == NULL) return;
+	p = g_hash_table_lookup(probes, server);
+	if (p == NULL) return;
+
+	for (I = p->waiters ; I ; I = g_list_next(I)) {
+		struct probe_waiter *w = I->data;
+		if (w->func == func && w->data == data) {
+			p->waiters = g_list_delete_link(p->waiters, I);
+			g_free(w);
+			return;
+		}
+	}
+}
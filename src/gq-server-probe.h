@@ -0,0 +1,55 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+
+#ifndef GQ_SERVER_PROBE_H
+#define GQ_SERVER_PROBE_H
+
+#include <glib.h>
+
+#include "gq-server.h"
+
+G_BEGIN_DECLS
+
+/* called once it is known whether a TCP connection to the server can
+   be made at all */
+typedef void (*GqServerProbeFunc) (GqServer *server,
+				   gboolean  reachable,
+				   gpointer  data);
+
+/* Finds out from the main loop whether server accepts connections,
+   without talking LDAP and without blocking. Servers with an open
+   connection and those whose address cannot be checked (ldapi://)
+   count as reachable. Waiting for the same server again joins the
+   probe already running. Gives up after timeout milliseconds. */
+void gq_server_probe(GqServer         *server,
+		     guint             timeout,
+		     GqServerProbeFunc func,
+		     gpointer          data);
+
+/* stops waiting: func will not be called for data any more */
+void gq_server_probe_cancel(GqServer         *server,
+			    GqServerProbeFunc func,
+			    gpointer          data);
+
+G_END_DECLS
+
+#endif /* !GQ_SERVER_PROBE_H */
@@ -0,0 +1,345 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#include "gq-server-stats.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+
+#include "gq-server.h"
+#include "gq-server-list.h"
+#include "errorchain.h"
+#include "input.h"		/* CONTAINER_BORDER_WIDTH */
+#include "state.h"
+#include "util.h"
+
+static const gchar *op_names[GQ_STAT_LAST] = {
+	N_("connect"),
+	N_("bind"),
+	N_("search (first entry)"),
+	N_("search (complete)"),
+	N_("modify"),
+	N_("add"),
+	N_("delete"),
+	N_("rename"),
+	N_("rendering"),
+};
+
+const gchar *
+gq_stat_op_name(GqStatOp op)
+{
+	g_return_val_if_fail(op < GQ_STAT_LAST, NULL);
+	return _(op_names[op]);
+}
+
+gdouble
+gq_server_stats_start(void)
+{
+	GTimeVal now;
+	g_get_current_time(&now);
+	return now.tv_sec + now.tv_usec / 1e6;
+}
+
+void
+gq_server_stats_stop(GqServer *server, GqStatOp op,
+		     gdouble start, gboolean ok)
+{
+	struct gq_op_stats *s;
+	gdouble elapsed;
+	gint bucket;
+
+	g_return_if_fail(GQ_IS_SERVER(server));
+	g_return_if_fail(op < GQ_STAT_LAST);
+
+	elapsed = gq_server_stats_start() - start;
+	if (elapsed < 0) elapsed = 0;	/* clock went backwards */
+
+	s = &server->stats.ops[op];
+	if (s->count == 0 || elapsed < s->min) s->min = elapsed;
+	if (elapsed > s->max) s->max = elapsed;
+	s->count++;
+	s->total += elapsed;
+	if (!ok) s->errors++;
+
+	for (bucket = 0 ; bucket < GQ_STAT_BUCKETS - 1 ; bucket++) {
+		if (elapsed * 1000.0 < (1 << bucket)) break;
+	}
+	s->histogram[bucket]++;
+}
+
+void
+gq_server_stats_entries(GqServer *server, guint n)
+{
+	g_return_if_fail(GQ_IS_SERVER(server));
+	server->stats.entries += n;
+}
+
+void
+gq_server_stats_rendered(GqServer *server, guint n)
+{
+	g_return_if_fail(GQ_IS_SERVER(server));
+	server->stats.rendered += n;
+}
+
+void
+gq_server_stats_clear(GqServer *server)
+{
+	g_return_if_fail(GQ_IS_SERVER(server));
+	memset(&server->stats, 0, sizeof(server->stats));
+}
+
+static void
+format_one_server(GQServerList *list, GqServer *server, GString *out)
+{
+	GqServerStats *st = &server->stats;
+	gdouble searchtime = st->ops[GQ_STAT_SEARCH].total;
+	gint i, b;
+
+	g_string_append_printf(out, _("Server: %s (%s)\n"),
+			       server->name, server->canon_name ? server->canon_name : server->ldaphost);
+	g_string_append_printf(out, _("  binds: %d, server down: %d, connection %s\n"),
+			       server->incarnation, server->server_down,
+			       server->connection ? _("open") : _("closed"));
+	g_string_append_printf(out,
+			       _("  entries received: %" G_GUINT64_FORMAT
+				 ", rendered: %" G_GUINT64_FORMAT "\n"),
+			       st->entries, st->rendered);
+	if (searchtime > 0) {
+		g_string_append_printf(out, _("  search throughput: %.1f entries/s\n"),
+				       st->entries / searchtime);
+	}
+
+	g_string_append_printf(out, "  %-22s %7s %6s %10s %10s %10s %10s\n",
+			       _("operation"), _("count"), _("errors"),
+			       _("total[s]"), _("avg[ms]"),
+			       _("min[ms]"), _("max[ms]"));
+	for (i = 0 ; i < GQ_STAT_LAST ; i++) {
+		struct gq_op_stats *s = &st->ops[i];
+		if (s->count == 0) continue;
+
+		g_string_append_printf(out, "  %-22s %7u %6u %10.3f %10.2f %10.2f %10.2f\n",
+				       gq_stat_op_name(i), s->count, s->errors,
+				       s->total,
+				       s->total * 1000.0 / s->count,
+				       s->min * 1000.0, s->max * 1000.0);
+
+		/* histogram: only the buckets that got hit */
+		g_string_append(out, "    ");
+		for (b = 0 ; b < GQ_STAT_BUCKETS ; b++) {
+			if (s->histogram[b] == 0) continue;
+			if (b < GQ_STAT_BUCKETS - 1) {
+				g_string_append_printf(out, " <%dms:%u",
+						       1 << b, s->histogram[b]);
+			} else {
+				g_string_append_printf(out, " >=%dms:%u",
+						       1 << (b - 1), s->histogram[b]);
+			}
+		}
+		g_string_append(out, "\n");
+	}
+	g_string_append(out, "\n");
+}
+
+void
+gq_server_stats_format(GString *out)
+{
+	gq_server_list_foreach(gq_server_list_get(),
+			       (GQServerListForeachFunc) format_one_server,
+			       out);
+}
+
+void
+gq_server_stats_dump(FILE *out)
+{
+	GString *str = g_string_sized_new(4096);
+	gq_server_stats_format(str);
+	fwrite(str->str, 1, str->len, out);
+	g_string_free(str, TRUE);
+}
+
+
+/* the statistics window */
+
+static GtkWidget *stats_window = NULL;
+
+static void
+stats_refresh(GtkTextBuffer *buffer)
+{
+	GString *str = g_string_sized_new(4096);
+	gq_server_stats_format(str);
+	gtk_text_buffer_set_text(buffer, str->str, str->len);
+	g_string_free(str, TRUE);
+}
+
+static void
+clear_one_server(GQServerList *list, GqServer *server, gpointer data)
+{
+	gq_server_stats_clear(server);
+}
+
+static void
+stats_clear(GtkTextBuffer *buffer)
+{
+	gq_server_list_foreach(gq_server_list_get(), clear_one_server, NULL);
+	stats_refresh(buffer);
+}
+
+static void
+stats_save_ok(GtkWidget *filesel)
+{
+	const char *filename;
+	FILE *outfile;
+	int ctx;
+
+	filename = gtk_file_selection_get_filename(GTK_FILE_SELECTION(filesel));
+	ctx = error_new_context(_("Saving server statistics"), filesel);
+
+	outfile = fopen(filename, "w");
+	if (outfile == NULL) {
+		error_push(ctx, _("Could not open output file '%1$s': %2$s"),
+			   filename, strerror(errno));
+	} else {
+		gq_server_stats_dump(outfile);
+		if (fclose(outfile) != 0) {
+			error_push(ctx, _("Save to '%1$s' failed: %2$s"),
+				   filename, strerror(errno));
+		} else {
+			statusbar_msg(_("Server statistics saved to %s"), filename);
+		}
+	}
+
+	error_flush(ctx);
+	gtk_widget_destroy(filesel);
+}
+
+static void
+stats_save(GtkWidget *window)
+{
+	GtkWidget *filesel;
+
+	filesel = gtk_file_selection_new(_("Save Server Statistics"));
+	gtk_window_set_transient_for(GTK_WINDOW(filesel), GTK_WINDOW(window));
+
+	g_signal_connect_swapped(GTK_FILE_SELECTION(filesel)->ok_button,
+				 "clicked",
+				 G_CALLBACK(stats_save_ok),
+				 filesel);
+	g_signal_connect_swapped(GTK_FILE_SELECTION(filesel)->cancel_button,
+				 "clicked",
+				 G_CALLBACK(gtk_widget_destroy),
+				 filesel);
+	g_signal_connect_swapped(filesel, "key_press_event",
+				 G_CALLBACK(close_on_esc),
+				 filesel);
+	gtk_widget_show(filesel);
+}
+
+static void
+stats_window_destroyed(GtkWidget *window, gpointer data)
+{
+	stats_window = NULL;
+}
+
+void
+server_stats_window(void)
+{
+	GtkWidget *window, *vbox0, *scrwin, *text, *bbox, *button;
+	GtkTextBuffer *buffer;
+	PangoFontDescription *font;
+
+	if (stats_window) {
+		gtk_window_present(GTK_WINDOW(stats_window));
+		return;
+	}
+
+	window = stateful_gtk_window_new(GTK_WINDOW_TOPLEVEL,
+					 "server-statistics", 600, 400);
+	stats_window = window;
+
+	g_signal_connect(window, "destroy",
+			 G_CALLBACK(stats_window_destroyed), NULL);
+	g_signal_connect(window, "key_press_event",
+			 G_CALLBACK(close_on_esc), window);
+
+	gtk_window_set_title(GTK_WINDOW(window), _("Server Statistics"));
+
+	vbox0 = gtk_vbox_new(FALSE, 0);
+	gtk_container_border_width(GTK_CONTAINER(vbox0),
+				   CONTAINER_BORDER_WIDTH);
+	gtk_widget_show(vbox0);
+	gtk_container_add(GTK_CONTAINER(window), vbox0);
+
+	scrwin = gtk_scrolled_window_new(NULL, NULL);
+	gtk_widget_show(scrwin);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrwin),
+				       GTK_POLICY_AUTOMATIC,
+				       GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scrwin),
+					    GTK_SHADOW_IN);
+	gtk_box_pack_start(GTK_BOX(vbox0), scrwin, TRUE, TRUE, 0);
+
+	text = gtk_text_view_new();
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(text), FALSE);
+	font = pango_font_description_from_string("Monospace");
+	gtk_widget_modify_font(text, font);
+	pango_font_description_free(font);
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(text));
+	gtk_widget_show(text);
+	gtk_container_add(GTK_CONTAINER(scrwin), text);
+
+	stats_refresh(buffer);
+
+	bbox = gtk_hbutton_box_new();
+	gtk_widget_show(bbox);
+	gtk_box_pack_end(GTK_BOX(vbox0), bbox, FALSE, FALSE, 3);
+
+	button = gtk_button_new_from_stock(GTK_STOCK_REFRESH);
+	gtk_widget_show(button);
+	g_signal_connect_swapped(button, "clicked",
+				 G_CALLBACK(stats_refresh), buffer);
+	gtk_box_pack_start(GTK_BOX(bbox), button, FALSE, TRUE, 10);
+
+	button = gtk_button_new_from_stock(GTK_STOCK_CLEAR);
+	gtk_widget_show(button);
+	g_signal_connect_swapped(button, "clicked",
+				 G_CALLBACK(stats_clear), buffer);
+	gtk_box_pack_start(GTK_BOX(bbox), button, FALSE, TRUE, 10);
+
+	button = gtk_button_new_from_stock(GTK_STOCK_SAVE_AS);
+	gtk_widget_show(button);
+	g_signal_connect_swapped(button, "clicked",
+				 G_CALLBACK(stats_save), window);
+	gtk_box_pack_start(GTK_BOX(bbox), button, FALSE, TRUE, 10);
+
+	button = gtk_button_new_from_stock(GTK_STOCK_CLOSE);
+	gtk_widget_show(button);
+	g_signal_connect_swapped(button, "clicked",
+				 G_CALLBACK(gtk_widget_destroy), window);
+	gtk_box_pack_end(GTK_BOX(bbox), button, FALSE, TRUE, 10);
+
+	GTK_WIDGET_SET_FLAGS(button, GTK_CAN_DEFAULT);
+	gtk_widget_grab_default(button);
+
+	gtk_widget_show(window);
+}
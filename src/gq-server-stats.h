@@ -0,0 +1,90 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef GQ_SERVER_STATS_H
+#define GQ_SERVER_STATS_H
+
+#include <stdio.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The operations we keep latency figures for. GQ_STAT_RENDER is not
+   an LDAP operation: it accounts for the time GQ itself spends
+   putting results on screen (search result rows, browse tree
+   nodes), so slow servers can be told apart from a slow client. */
+typedef enum {
+	GQ_STAT_CONNECT,
+	GQ_STAT_BIND,
+	GQ_STAT_SEARCH_FIRST,	/* search start to first entry */
+	GQ_STAT_SEARCH,		/* search start to final result */
+	GQ_STAT_MODIFY,
+	GQ_STAT_ADD,
+	GQ_STAT_DELETE,
+	GQ_STAT_RENAME,
+	GQ_STAT_RENDER,
+	GQ_STAT_LAST
+} GqStatOp;
+
+/* log2 latency buckets: bucket i counts operations that took less
+   than 2^i milliseconds, the last one everything slower */
+#define GQ_STAT_BUCKETS 16
+
+struct gq_op_stats {
+	guint   count;
+	guint   errors;
+	gdouble total;		/* seconds */
+	gdouble min;
+	gdouble max;
+	guint   histogram[GQ_STAT_BUCKETS];
+};
+
+typedef struct {
+	struct gq_op_stats ops[GQ_STAT_LAST];
+	/* entries received by searches and entries rendered, the
+	   former divided by the GQ_STAT_SEARCH total gives the
+	   throughput */
+	guint64 entries;
+	guint64 rendered;
+} GqServerStats;
+
+struct _GqServer;
+
+const gchar *gq_stat_op_name(GqStatOp op);
+
+/* returns a timestamp to be passed to gq_server_stats_stop() */
+gdouble gq_server_stats_start(void);
+void    gq_server_stats_stop(struct _GqServer *server, GqStatOp op,
+			     gdouble start, gboolean ok);
+void    gq_server_stats_entries(struct _GqServer *server, guint n);
+void    gq_server_stats_rendered(struct _GqServer *server, guint n);
+void    gq_server_stats_clear(struct _GqServer *server);
+
+/* the figures of all configured servers as plain text */
+void    gq_server_stats_format(GString *out);
+void    gq_server_stats_dump(FILE *out);
+
+/* the File | Server Statistics window */
+void    server_stats_window(void);
+
+G_END_DECLS
+
+#endif /* !GQ_SERVER_STATS_H */
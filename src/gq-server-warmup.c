@@ -0,0 +1,269 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+
+#include "gq-server-warmup.h"
+
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+#include <ldap.h>
+
+#include "gq-server-list.h"
+#include "gq-server-probe.h"
+#include "gq-server-stats.h"
+#include "errorchain.h"
+#include "schema.h"
+#include "util.h"
+
+/* how long (in ms) to wait for the server to accept a connection */
+#define WARMUP_PROBE_TIMEOUT	5000
+
+/* how often (in ms) to look for the answers */
+#define WARMUP_POLL_INTERVAL	100
+
+typedef enum {
+	WARMUP_ROOT_DSE,
+	WARMUP_SCHEMA
+} WarmupState;
+
+struct warmup {
+	GqServer   *server;
+	LDAP       *ld;
+	int         incarnation;	/* of the connection ld belongs to */
+	int         msgid;
+	WarmupState state;
+	guint       timer;
+	gdouble     start;
+};
+
+static void
+warmup_free(struct warmup *w)
+{
+	GqServer *server = w->server;
+
+	if (w->timer) gtk_timeout_remove(w->timer);
+
+	/* only give back a connection that is still the one we used */
+	if (w->ld && server->connection == w->ld &&
+	    server->incarnation == w->incarnation) {
+		if (w->msgid >= 0) ldap_abandon(w->ld, w->msgid);
+		close_connection(server, FALSE);
+	}
+
+	g_object_unref(server);
+	g_free(w);
+}
+
+static gboolean
+warmup_send(struct warmup *w, const char *base, char **attrs)
+{
+	int rc;
+
+	w->start = gq_server_stats_start();
+	rc = ldap_search_ext(w->ld, base, LDAP_SCOPE_BASE, "(objectClass=*)",
+			     attrs, 0, NULL, NULL, NULL, LDAP_NO_LIMIT,
+			     &w->msgid);
+	if (rc != LDAP_SUCCESS) {
+		if (rc == LDAP_SERVER_DOWN) w->server->server_down++;
+		w->msgid = -1;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* picks the naming contexts and the subschema subentry from the root
+   DSE, returns the latter */
+static char *
+warmup_root_dse(struct warmup *w, LDAPMessage *res)
+{
+	GqServer *server = w->server;
+	LDAPMessage *e = ldap_first_entry(w->ld, res);
+	GList *suffixes = NULL;
+	char *subschema = NULL;
+	char **vals;
+	int i;
+
+	if (e == NULL) return NULL;
+
+	vals = ldap_get_values(w->ld, e, "namingContexts");
+	if (vals) {
+		for (i = 0 ; vals[i] ; i++) {
+			suffixes = g_list_prepend(suffixes, g_strdup(vals[i]));
+		}
+		ldap_value_free(vals);
+	}
+
+	/* servers without namingContexts get the fallbacks of
+	   get_suffixes() when their node is opened */
+	if (suffixes && server->prefetched_suffixes == NULL) {
+		server->prefetched_suffixes = g_list_reverse(suffixes);
+	} else {
+		g_list_foreach(suffixes, (GFunc) g_free, NULL);
+		g_list_free(suffixes);
+	}
+
+	vals = ldap_get_values(w->ld, e, "subschemaSubentry");
+	if (vals) {
+		if (vals[0]) subschema = g_strdup(vals[0]);
+		ldap_value_free(vals);
+	}
+
+	return subschema;
+}
+
+static gboolean
+warmup_poll(struct warmup *w)
+{
+	GqServer *server = w->server;
+	LDAPMessage *res = NULL;
+	struct timeval nowait = { 0, 0 };
+	char *subschema;
+	int rc;
+
+	/* somebody reconnected in the meantime */
+	if (server->connection != w->ld ||
+	    server->incarnation != w->incarnation) {
+		w->timer = 0;
+		w->ld = NULL;
+		warmup_free(w);
+		return FALSE;
+	}
+
+	rc = ldap_result(w->ld, w->msgid, LDAP_MSG_ALL, &nowait, &res);
+	if (rc == 0) return TRUE;	/* not yet */
+
+	w->msgid = -1;
+	gq_server_stats_stop(server, GQ_STAT_SEARCH, w->start, rc > 0);
+
+	if (rc < 0) {
+		int err = LDAP_SUCCESS;
+		ldap_get_option(w->ld, LDAP_OPT_ERROR_NUMBER, &err);
+		if (err == LDAP_SERVER_DOWN) server->server_down++;
+		w->timer = 0;
+		warmup_free(w);
+		return FALSE;
+	}
+
+	switch (w->state) {
+	case WARMUP_ROOT_DSE:
+		subschema = warmup_root_dse(w, res);
+		ldap_msgfree(res);
+
+		if (subschema && server->ss == NULL &&
+		    !(server->flags & SERVER_HAS_NO_SCHEMA)) {
+			char *schema_attrs[] = { "objectClasses",
+						 "attributeTypes",
+						 "matchingRules",
+						 "ldapSyntaxes",
+						 NULL };
+			w->state = WARMUP_SCHEMA;
+			rc = warmup_send(w, subschema, schema_attrs);
+			g_free(subschema);
+			if (rc) return TRUE;
+		} else {
+			g_free(subschema);
+		}
+		break;
+	case WARMUP_SCHEMA:
+		/* get_schema() might have been quicker */
+		if (server->ss == NULL) {
+			server->ss = parse_server_schema(w->ld, res);
+		}
+		ldap_msgfree(res);
+		break;
+	}
+
+	statusbar_msg(_("Connection to server '%s' is ready"), server->name);
+
+	w->timer = 0;
+	warmup_free(w);
+	return FALSE;
+}
+
+static void
+warmup_probed(GqServer *server, gboolean reachable, struct warmup *w)
+{
+	char *root_attrs[] = { "namingContexts", "subschemaSubentry", NULL };
+	int ctx, quiet;
+
+	if (!reachable) {
+		statusbar_msg(_("Server '%s' cannot be reached, not warming up its connection"),
+			      server->name);
+		warmup_free(w);
+		return;
+	}
+
+	/* no password dialogs or error popups out of the blue */
+	ctx = error_new_context(_("Warming up connection"), NULL);
+	quiet = server->quiet;
+	server->quiet = 1;
+	w->ld = open_connection(ctx, server);
+	server->quiet = quiet;
+	error_clear(ctx);
+	error_flush(ctx);
+
+	if (w->ld == NULL) {
+		warmup_free(w);
+		return;
+	}
+	w->incarnation = server->incarnation;
+
+	w->state = WARMUP_ROOT_DSE;
+	if (!warmup_send(w, "", root_attrs)) {
+		warmup_free(w);
+		return;
+	}
+
+	w->timer = gtk_timeout_add(WARMUP_POLL_INTERVAL,
+				   (GtkFunction) warmup_poll, w);
+}
+
+void
+gq_server_warmup(GqServer *server)
+{
+	struct warmup *w;
+
+	g_return_if_fail(GQ_IS_SERVER(server));
+
+	/* a connection that is not cached would be gone right away */
+	if (!server->warmup || !server->cacheconn) return;
+
+	w = g_new0(struct warmup, 1);
+	w->server = g_object_ref(server);
+	w->msgid = -1;
+
+	gq_server_probe(server, WARMUP_PROBE_TIMEOUT,
+			(GqServerProbeFunc) warmup_probed, w);
+}
+
+static void
+warmup_one(GQServerList *list, GqServer *server, gpointer data)
+{
+	gq_server_warmup(server);
+}
+
+void
+gq_server_warmup_all(void)
+{
+	gq_server_list_foreach(gq_server_list_get(), warmup_one, NULL);
+}
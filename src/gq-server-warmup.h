@@ -0,0 +1,44 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+
+#ifndef GQ_SERVER_WARMUP_H
+#define GQ_SERVER_WARMUP_H
+
+#include <glib.h>
+
+#include "gq-server.h"
+
+G_BEGIN_DECLS
+
+/* Opens the cached connections of all servers with the warm-up
+   option set and reads their naming contexts and schema, so the
+   first browse or search finds them ready. Everything happens from
+   the main loop, servers that cannot be reached or would ask for a
+   password are left alone. */
+void gq_server_warmup_all(void);
+
+/* the same for a single server */
+void gq_server_warmup(GqServer *server);
+
+G_END_DECLS
+
+#endif /* !GQ_SERVER_WARMUP_H */
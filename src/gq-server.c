@@ -45,7 +45,10 @@ gq_server_new(void)
      newserver->saslmechanism = g_strdup("");
      newserver->searchattr = g_strdup(DEFAULT_SEARCHATTR);
      newserver->maxentries = DEFAULT_MAXENTRIES;
+     newserver->browse_window = DEFAULT_BROWSE_WINDOW;
      newserver->cacheconn = DEFAULT_CACHECONN;
+     newserver->live_updates = DEFAULT_LIVE_UPDATES;
+     newserver->warmup = DEFAULT_WARMUP;
      newserver->enabletls = DEFAULT_ENABLETLS;
      newserver->local_cache_timeout = DEFAULT_LOCAL_CACHE_TIMEOUT;
      newserver->ask_pw = DEFAULT_ASK_PW;
@@ -61,6 +64,7 @@ gq_server_new(void)
      newserver->incarnation = 0;
      newserver->missing_closes = 0;
      newserver->ss = NULL;
+     newserver->prefetched_suffixes = NULL;
      newserver->flags = 0;
      newserver->version = LDAP_VERSION2;
      newserver->server_down = 0;
@@ -94,7 +98,10 @@ void copy_ldapserver(GqServer *target,
      DEEPCOPY   (target, source, saslmechanism);
      DEEPCOPY   (target, source, searchattr);
      SHALLOWCOPY(target, source, maxentries);
+     SHALLOWCOPY(target, source, browse_window);
      SHALLOWCOPY(target, source, cacheconn);
+     SHALLOWCOPY(target, source, live_updates);
+     SHALLOWCOPY(target, source, warmup);
      SHALLOWCOPY(target, source, enabletls);
      SHALLOWCOPY(target, source, local_cache_timeout);
      SHALLOWCOPY(target, source, ask_pw);
@@ -105,6 +112,13 @@ void copy_ldapserver(GqServer *target,
      SHALLOWCOPY(target, source, is_uri);
 }
 
+static void free_prefetched_suffixes(GqServer *server)
+{
+     g_list_foreach(server->prefetched_suffixes, (GFunc) g_free, NULL);
+     g_list_free(server->prefetched_suffixes);
+     server->prefetched_suffixes = NULL;
+}
+
 /* resets the operational stuff */
 /** NOTE: reset_ldapserver sets the target refcount to 0 */
 void
@@ -117,9 +131,11 @@ reset_ldapserver(GqServer *target)
      target->incarnation = 0;
      target->missing_closes = 0;
      target->ss = NULL;
+     free_prefetched_suffixes(target);
      target->flags = 0;
      target->version = LDAP_VERSION2;
      target->server_down = 0;
+     gq_server_stats_clear(target);
 }
 
 void canonicalize_ldapserver(GqServer *server)
@@ -168,6 +184,8 @@ server_finalize(GObject* object)
 
 	g_free(self->canon_name);
 
+	free_prefetched_suffixes(self);
+
 	G_OBJECT_CLASS(gq_server_parent_class)->finalize(object);
 }
 
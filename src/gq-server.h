@@ -29,6 +29,8 @@
 #include <ldap.h>
 #include <glib-object.h>
 
+#include "gq-server-stats.h"
+
 G_BEGIN_DECLS
 
 typedef struct _GqServer GqServer;
@@ -43,6 +45,21 @@ struct server_schema {
 	GList *at;
 	GList *mr;
 	GList *s;
+
+	/* built by parse_server_schema(), the keys belong to the lists */
+	GHashTable *oc_by_name;	/* first name and OID -> LDAPObjectClass */
+	GHashTable *at_by_name;	/* every name and OID -> LDAPAttributeType */
+	GHashTable *mr_by_name;	/* every name and OID -> LDAPMatchingRule */
+	/* every name (or the OID of what has none) by type, as
+	   struct schema_name sorted by name */
+	GPtrArray *names[4];
+	/* what refers to what, as lists of the names to show */
+	GHashTable *ocs_by_at;	/* LDAPAttributeType -> objectClasses */
+	GHashTable *ats_by_mr;	/* LDAPMatchingRule -> attribute types */
+	GHashTable *ats_by_s;	/* syntax OID -> attribute types */
+	GHashTable *mrs_by_s;	/* syntax OID -> matching rules */
+	/* filled as needed by schema_attrs_by_oclist() */
+	GHashTable *attrsets;	/* objectClass list -> GArray */
 };
 
 GType     gq_server_get_type(void);
@@ -73,7 +90,15 @@ void reset_ldapserver(GqServer *target);
 void canonicalize_ldapserver(GqServer *server);
 
 typedef enum {
-	SERVER_HAS_NO_SCHEMA = 1
+	SERVER_HAS_NO_SCHEMA   = 1,
+	/* set once the supportedControl values of the root DSE have
+	   been looked at, see server_supports_vlv() and
+	   server_live_update_method() */
+	SERVER_CONTROLS_PROBED = 1 << 1,
+	SERVER_HAS_SORT        = 1 << 2,
+	SERVER_HAS_VLV         = 1 << 3,
+	SERVER_HAS_SYNC        = 1 << 4,	/* RFC 4533 */
+	SERVER_HAS_PSEARCH     = 1 << 5	/* persistent search */
 } GqServerFlags;
 
 struct _GqServer {
@@ -94,7 +119,14 @@ struct _GqServer {
      char *saslmechanism;
      char *searchattr;
      int   maxentries;
+     int   browse_window;	/* children per windowed browse node,
+				   0 disables windowed browsing */
      int   cacheconn;
+     int   live_updates;	/* follow changes below expanded browse
+				   nodes, see browse-live.c */
+     int   warmup;		/* connect and fetch the root DSE and
+				   schema after startup, see
+				   gq-server-warmup.c */
      int   enabletls;
      long  local_cache_timeout;
      int   ask_pw;
@@ -123,7 +155,13 @@ struct _GqServer {
 			      decremented on each close,
 			      close_connection really closes only if
 			      this drops to zero */
+     /* connections besides the cached one, kept for reuse, see
+	open_pooled_connection() */
+     GSList *pool;
      struct server_schema *ss;
+     /* the naming contexts read by the warm-up, handed over to the
+	first get_suffixes() call */
+     GList *prefetched_suffixes;
      int   flags;
 
      int   version;
@@ -137,6 +175,10 @@ struct _GqServer {
 	pages mention it though) nor is it actually available through
 	ldap.h */
      int   server_down;
+
+     /* per-operation latency and throughput figures, see
+	gq-server-stats.c */
+     GqServerStats stats;
 };
 
 struct dn_on_server {
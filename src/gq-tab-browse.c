@@ -41,8 +41,11 @@
 
 #include "gq-browser-node-dn.h"
 #include "gq-browser-node-server.h"
+#include "gq-browser-node-range.h"
 #include "gq-browser-node-reference.h"
 #include "gq-server-list.h"
+#include "gq-server-probe.h"
+#include "gq-server-stats.h"
 
 #include "mainwin.h"
 #include "template.h"
@@ -64,6 +67,8 @@
 #include "browse-dnd.h"
 #endif
 
+#include "browse-live.h"
+
 static gboolean button_press_on_tree_item(GtkWidget *tree,
 					  GdkEventButton *event,
 					  GqTab *tab);
@@ -71,13 +76,91 @@ static gboolean button_press_on_tree_item(GtkWidget *tree,
 
 static void tree_row_refresh(GtkMenuItem *menuitem, GqTab *tab);
 
+/*
+ * Restoring the open path of a browse tab
+ *
+ * Walking the path means connecting and searching for every element,
+ * so it is not done while the GUI starts up. Instead every tab checks
+ * whether its server can be reached at all (all of them at the same
+ * time) and then opens one path element per idle call. Unreachable
+ * servers get marked in the tree, their path is kept for the next
+ * start unless the user goes somewhere else.
+ *
+ * The searches opening an element (the root DSE of the server, the
+ * children of every node on the way, entries the listings do not
+ * show) get sent from the main loop and their answers picked up by a
+ * timer, like show_dn() would do it but without waiting for them.
+ * Nodes the plain listing does not do justice to (windowed
+ * containers, live updates, referrals) still get opened by expanding
+ * them.
+ */
+
+/* how long (in ms) to wait for a server to accept a connection */
+#define RESTORE_PROBE_TIMEOUT	5000
+/* how long (in seconds) to wait for the answers of one search */
+#define RESTORE_SEARCH_TIMEOUT	30
+/* how often (in ms) to look for the answers */
+#define RESTORE_POLL_INTERVAL	100
+
+typedef enum {
+     RESTORE_FETCH_NONE,
+     RESTORE_FETCH_ROOT_DSE,	/* naming contexts and controls */
+     RESTORE_FETCH_CHILDREN,	/* referrals and children of node */
+     RESTORE_FETCH_ENTRY	/* an entry the listing did not show */
+} RestoreFetch;
+
+typedef enum {
+     RESTORE_DONE,		/* the element is open */
+     RESTORE_WAIT,		/* waiting for the server */
+     RESTORE_FAILED
+} RestoreState;
+
+struct browse_restore {
+     GqTab *tab;
+     char *state_name;
+     GList *path;		/* the saved path, strings */
+     GList *next;		/* the element to open next */
+     GqServer *server;
+     GQTreeWidgetNode *node;	/* the last node opened */
+     char *node_dn;		/* its DN, "" for the server, to find
+				   it again after waiting */
+
+     /* the DN element being opened */
+     char **dnparts;
+     int part;			/* the RDN to look for next */
+     GString *dn;		/* the DN looked for so far */
+     gboolean found;		/* ... and whether it was there */
+
+     /* what we are waiting for */
+     LDAP *ld;
+     int incarnation;		/* of the connection ld belongs to */
+     RestoreFetch fetch;
+     int msgid[2];
+     LDAPMessage *res[2];	/* the answers that are in already */
+     gdouble sent;
+     guint timer;
+     gboolean root_dse_read;
+
+     guint idle;
+     gboolean busy;		/* expanding a node */
+     gboolean cancelled;	/* ... and the tab went away */
+     gboolean parked;		/* unreachable, the path is only kept
+				   to be saved again */
+};
+
+static void browse_restore_cancel(GqTab *tab);
+
 void record_path(GqTab *tab, GqBrowserNode *entry,
 		 GQTreeWidget *ctreeroot, GQTreeWidgetNode *node)
 {
-     GQTreeWidgetRow *row;
      GqBrowserNode *e;
      GType type = -1;
 
+     /* the user went elsewhere, forget about the unreachable path */
+     if (GQ_TAB_BROWSE(tab)->restore && GQ_TAB_BROWSE(tab)->restore->parked) {
+	  browse_restore_cancel(tab);
+     }
+
      if (GQ_TAB_BROWSE(tab)->cur_path) {
 	  g_list_foreach(GQ_TAB_BROWSE(tab)->cur_path, (GFunc) g_free, NULL);
 	  g_list_free(GQ_TAB_BROWSE(tab)->cur_path);
@@ -85,8 +168,7 @@ void record_path(GqTab *tab, GqBrowserNode *entry,
 
      GQ_TAB_BROWSE(tab)->cur_path = NULL;
 
-     for ( ; node ; node = row->parent ) {
-	  row = GQ_TREE_WIDGET_ROW(node);
+     for ( ; node ; node = gq_tree_get_parent_node(ctreeroot, node) ) {
 	  e = GQ_BROWSER_NODE(gq_tree_get_node_data (ctreeroot, node));
 
 	  /* currently it is sufficient to keep changes in entry types only */
@@ -242,8 +324,10 @@ static void tree_row_selected(GQTreeWidget *ctree, GQTreeWidgetNode *node,
 	gtk_object_set_data/gtk_object_get_data */
 
      if (g_object_get_data(G_OBJECT(ctree), "in-tree_row_selected")) {
+#ifndef USE_TREE_VIEW
 	  g_signal_stop_emission_by_name(GTK_OBJECT(ctree),
 					 "tree-select-row");
+#endif
 	  return;
      }
 
@@ -334,7 +418,15 @@ static void browse_save_snapshot(int error_context,
 				 char *state_name, GqTab *tab)
 {
      char *tmp;
-     state_value_set_list(state_name, "open-path", GQ_TAB_BROWSE(tab)->cur_path);
+
+     /* a path still being restored has not been opened yet */
+     if (GQ_TAB_BROWSE(tab)->restore) {
+	  state_value_set_list(state_name, "open-path",
+			       GQ_TAB_BROWSE(tab)->restore->path);
+     } else {
+	  state_value_set_list(state_name, "open-path",
+			       GQ_TAB_BROWSE(tab)->cur_path);
+     }
 
      if (GQ_TAB_BROWSE(tab)->mainpane)
 	  state_value_set_int(state_name, "gutter-pos", 
@@ -367,77 +459,705 @@ static int cmp_name(GqBrowserNode *entry, const char *name)
      return rc;
 }
 
-static void browse_restore_snapshot(int context,
-				    char *state_name, GqTab *tab,
-				    struct pbar_win *progress)
+static void restore_abandon(struct browse_restore *r)
 {
-     GQTreeWidget *ctree = GQ_TAB_BROWSE(tab)->ctreeroot;
-     int gutter = state_value_get_int(state_name, "gutter-pos", -1);
-     const GList *path = state_value_get_list(state_name, "open-path");
+     int i;
+
+     for (i = 0 ; i < 2 ; i++) {
+	  if (r->msgid[i] >= 0) ldap_abandon(r->ld, r->msgid[i]);
+	  r->msgid[i] = -1;
+	  if (r->res[i]) ldap_msgfree(r->res[i]);
+	  r->res[i] = NULL;
+     }
+     r->fetch = RESTORE_FETCH_NONE;
+     if (r->timer) gtk_timeout_remove(r->timer);
+     r->timer = 0;
+}
+
+/* whether ld is still the connection of the server we started with */
+static gboolean restore_connection_valid(struct browse_restore *r)
+{
+     return r->ld && r->server->connection == r->ld &&
+	  r->server->incarnation == r->incarnation;
+}
+
+static void restore_free(struct browse_restore *r)
+{
+     if (!r->cancelled && GQ_TAB_BROWSE(r->tab)->restore == r) {
+	  GQ_TAB_BROWSE(r->tab)->restore = NULL;
+     }
+     if (r->idle) gtk_idle_remove(r->idle);
+
+     /* only give back a connection that is still the one we used */
+     if (restore_connection_valid(r)) {
+	  restore_abandon(r);
+	  close_connection(r->server, FALSE);
+     } else if (r->timer) {
+	  gtk_timeout_remove(r->timer);
+     }
+     if (r->res[0]) ldap_msgfree(r->res[0]);
+     if (r->res[1]) ldap_msgfree(r->res[1]);
+     if (r->server) g_object_unref(r->server);
+
+     if (r->dnparts) gq_exploded_free(r->dnparts);
+     if (r->dn) g_string_free(r->dn, TRUE);
+     g_free(r->node_dn);
+
+     g_list_foreach(r->path, (GFunc) g_free, NULL);
+     g_list_free(r->path);
+     g_free(r->state_name);
+     g_free(r);
+}
+
+static void restore_finish(struct browse_restore *r)
+{
+     GQTreeWidget *ctree = GQ_TAB_BROWSE(r->tab)->ctreeroot;
      char *tmp;
 
-     GqServer *server = NULL;
+     r->idle = 0;
 
-     GQTreeWidgetNode *node = gq_tree_get_root_node (ctree);
+     /* do not take the selection away from the user */
+     if (r->node && !gq_tree_widget_has_selection(ctree)) {
+	  gq_tree_select_node(ctree, r->node);
+     }
 
-     if (path) {
-	  const GList *I;
-	  for (I = path ; I ; I = g_list_next(I)) {
-	       const char *s = I->data;
-	       const char *c = g_utf8_strchr(s, -1, ':');
-	       char *ep;
-	       GType type = strtoul(s, &ep, 10);
+     if (GQ_TAB_BROWSE(r->tab)->inputform) {
+	  int ctx = error_new_context(_("Restoring browse tab"),
+				      GTK_WIDGET(ctree));
 
-	       if (progress->cancelled) break;
+	  tmp = g_strconcat(r->state_name, ".input", NULL);
+	  restore_input_snapshot(ctx, GQ_TAB_BROWSE(r->tab)->inputform, tmp);
+	  g_free(tmp);
+
+	  error_flush(ctx);
+     }
+
+     restore_free(r);
+}
 
-	       if (progress) {
-		    update_progress(progress, _("Opening %s"), c + 1);
+/* makes node the last one opened */
+static void restore_set_node(struct browse_restore *r, GQTreeWidgetNode *node)
+{
+     GqBrowserNode *e = node ?
+	  GQ_BROWSER_NODE(gq_tree_get_node_data(GQ_TAB_BROWSE(r->tab)->ctreeroot,
+						node)) : NULL;
+
+     r->node = node;
+     g_free(r->node_dn);
+     if (GQ_IS_BROWSER_NODE_SERVER(e)) {
+	  r->node_dn = g_strdup("");
+     } else if (GQ_IS_BROWSER_NODE_DN(e)) {
+	  r->node_dn = g_strdup(GQ_BROWSER_NODE_DN(e)->dn);
+     } else {
+	  /* below a referral DNs are no help to find it again */
+	  r->node_dn = NULL;
+     }
+}
+
+/* sends a search for the restore, with ManageDSAit unless no_ctrls */
+static gboolean restore_send(struct browse_restore *r, int i,
+			     const char *base, int scope, const char *filter,
+			     char **attrs, int attrsonly, gboolean no_ctrls)
+{
+     LDAPControl c;
+     LDAPControl *ctrls[2] = { NULL, NULL } ;
+     struct timeval timeout;
+     int rc;
+
+     c.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+     c.ldctl_value.bv_val	= NULL;
+     c.ldctl_value.bv_len	= 0;
+     c.ldctl_iscritical	= 1;
+
+     ctrls[0] = &c;
+
+     /* the server gives up on its own as well */
+     timeout.tv_sec = RESTORE_SEARCH_TIMEOUT;
+     timeout.tv_usec = 0;
+
+     rc = ldap_search_ext(r->ld, base, scope, filter, attrs, attrsonly,
+			  no_ctrls ? NULL : ctrls,	/* serverctrls */
+			  NULL,				/* clientctrls */
+			  &timeout,
+			  LDAP_NO_LIMIT,		/* sizelimit */
+			  &r->msgid[i]);
+     if (rc != LDAP_SUCCESS) {
+	  if (rc == LDAP_SERVER_DOWN) r->server->server_down++;
+	  r->msgid[i] = -1;
+	  statusbar_msg(_("Error searching below '%1$s': %2$s"),
+			base, ldap_err2string(rc));
+	  return FALSE;
+     }
+     return TRUE;
+}
+
+static gboolean restore_poll(struct browse_restore *r);
+
+/* starts waiting for the answers of what got sent */
+static RestoreState restore_wait(struct browse_restore *r, RestoreFetch fetch)
+{
+     r->fetch = fetch;
+     r->sent = gq_server_stats_start();
+     if (r->timer == 0) {
+	  r->timer = gtk_timeout_add(RESTORE_POLL_INTERVAL,
+				     (GtkFunction) restore_poll, r);
+     }
+     return RESTORE_WAIT;
+}
+
+/* whether listing the children is all that expanding a DN node of
+   server would do */
+static gboolean restore_plain_listing(GqServer *server)
+{
+     if (server->browse_window > 0 &&
+	 (server->flags & SERVER_HAS_SORT) &&
+	 (server->flags & SERVER_HAS_VLV)) {
+	  return FALSE;
+     }
+     if (server->live_updates &&
+	 (server->flags & (SERVER_HAS_SYNC | SERVER_HAS_PSEARCH))) {
+	  return FALSE;
+     }
+     return TRUE;
+}
+
+/* expands node the usual way, which may well search synchronously */
+static RestoreState restore_expand(struct browse_restore *r,
+				   GQTreeWidgetNode *node)
+{
+     r->busy = TRUE;
+     gq_tree_expand_node(GQ_TAB_BROWSE(r->tab)->ctreeroot, node);
+     r->busy = FALSE;
+
+     /* the tab got closed while we were waiting for the server */
+     return r->cancelled ? RESTORE_FAILED : RESTORE_DONE;
+}
+
+/* makes sure the children of the current node are in the tree */
+static RestoreState restore_open_node(struct browse_restore *r)
+{
+     GQTreeWidget *ctree = GQ_TAB_BROWSE(r->tab)->ctreeroot;
+     GqBrowserNode *e = GQ_BROWSER_NODE(gq_tree_get_node_data(ctree, r->node));
+     GqServer *server = r->server;
+
+     if (!r->root_dse_read && !(server->flags & SERVER_CONTROLS_PROBED)) {
+	  char *attrs[] = { "namingContexts", "supportedControl", NULL };
+
+	  if (!restore_send(r, 0, "", LDAP_SCOPE_BASE, "(objectClass=*)",
+			    attrs, 0, TRUE)) {
+	       return RESTORE_FAILED;
+	  }
+	  return restore_wait(r, RESTORE_FETCH_ROOT_DSE);
+     }
+
+     if (GQ_IS_BROWSER_NODE_DN(e) && !GQ_BROWSER_NODE_DN(e)->seen &&
+	 restore_plain_listing(server)) {
+	  char *ref[] = { "ref", NULL };
+	  char *dummy[] = { "dummy", NULL };
+	  const char *dn = GQ_BROWSER_NODE_DN(e)->dn;
+
+	  statusbar_msg(_("Onelevel search on %s"), dn);
+
+	  /* both at once, see dn_browse_entry_expand() */
+	  if (!restore_send(r, 0, dn, LDAP_SCOPE_BASE,
+			    "(objectClass=referral)", ref, 0, FALSE) ||
+	      !restore_send(r, 1, dn, LDAP_SCOPE_ONELEVEL,
+			    "(objectClass=*)", dummy, 1, FALSE)) {
+	       restore_abandon(r);
+	       return RESTORE_FAILED;
+	  }
+	  return restore_wait(r, RESTORE_FETCH_CHILDREN);
+     }
+
+     /* known children (or a server node the root DSE was read for)
+	just get shown */
+     return restore_expand(r, r->node);
+}
+
+/* goes on opening the current DN element the way show_dn() does:
+   open every node on the way and look for the next RDN below it,
+   asking the server for the entries the listings did not show */
+static RestoreState restore_advance(struct browse_restore *r)
+{
+     GQTreeWidget *ctree = GQ_TAB_BROWSE(r->tab)->ctreeroot;
+     GQTreeWidgetNode *found;
+     RestoreState state;
+     char *attrs[] = { LDAP_NO_ATTRS, NULL };
+     char *dn;
+
+     for ( ; r->part >= 0 ; r->part--) {
+	  /* skip empty DN elements */
+	  if (*r->dnparts[r->part] == 0) continue;
+
+	  state = restore_open_node(r);
+	  if (state != RESTORE_DONE) return state;
+
+	  dn = r->dn->len ?
+	       g_strconcat(r->dnparts[r->part], ",", r->dn->str, NULL) :
+	       g_strdup(r->dnparts[r->part]);
+
+	  found = node_from_dn(ctree, r->node, dn);
+	  if (found == NULL) {
+	       /* probably hidden by a size limit, see if it exists */
+	       if (!restore_send(r, 0, dn, LDAP_SCOPE_BASE, "(objectClass=*)",
+				 attrs, 0, FALSE)) {
+		    g_free(dn);
+		    return RESTORE_FAILED;
 	       }
+	       g_free(dn);
+	       return restore_wait(r, RESTORE_FETCH_ENTRY);
+	  }
 
-	       if (c == ep) {
-		    if(type == GQ_TYPE_BROWSER_NODE_DN) {
-			 node = show_dn(context, ctree, node, c + 1, FALSE);
-		    }
-		    else if(type == GQ_TYPE_BROWSER_NODE_REFERENCE) {
-			 gq_tree_expand_node (ctree, node);
-			 node =
-			      gq_tree_widget_find_by_row_data_custom(GQ_TREE_WIDGET(ctree),
-								node,
-								(gpointer)(c + 1),
-								(GCompareFunc) cmp_name);
-		    }
-		    else if(type == GQ_TYPE_BROWSER_NODE_SERVER) {
-			 server = gq_server_list_get_by_name(gq_server_list_get(), c + 1);
-			 if (server != NULL) {
-			      node = tree_node_from_server_dn(ctree, server,
-							      "");
-			 } else {
-			      /* FIXME - popup error? */
-			      node = NULL;
-			 }
-		    }
+	  restore_set_node(r, found);
+	  r->found = TRUE;
+	  g_string_assign(r->dn, dn);
+	  g_free(dn);
+     }
+
+     return r->found ? RESTORE_DONE : RESTORE_FAILED;
+}
+
+/* opens dn below a referral, where the server is another one, the
+   old way */
+static RestoreState restore_show_dn(struct browse_restore *r, const char *dn)
+{
+     GQTreeWidget *ctree = GQ_TAB_BROWSE(r->tab)->ctreeroot;
+     GQTreeWidgetNode *node;
+     int ctx;
+
+     ctx = error_new_context(_("Restoring browse tab"), GTK_WIDGET(ctree));
+     r->busy = TRUE;
+     node = show_dn(ctx, ctree, r->node, dn, FALSE);
+     r->busy = FALSE;
+
+     if (r->cancelled) {
+	  /* the tab got closed while we were waiting for the server */
+	  error_clear(ctx);
+	  error_flush(ctx);
+	  return RESTORE_FAILED;
+     }
+     error_flush(ctx);
+
+     if (node == NULL) return RESTORE_FAILED;
+     restore_set_node(r, node);
+     return RESTORE_DONE;
+}
+
+static gboolean restore_step(struct browse_restore *r);
+
+/* reacts to where opening the current element got */
+static void restore_continue(struct browse_restore *r, RestoreState state)
+{
+     switch (state) {
+     case RESTORE_WAIT:
+	  break;
+     case RESTORE_DONE:
+	  /* one path element per idle call */
+	  r->idle = gtk_idle_add((GtkFunction) restore_step, r);
+	  break;
+     case RESTORE_FAILED:
+	  if (r->cancelled) {
+	       restore_free(r);
+	  } else {
+	       restore_finish(r);
+	  }
+	  break;
+     }
+}
+
+/* opens the next element of the path */
+static gboolean restore_step(struct browse_restore *r)
+{
+     GQTreeWidget *ctree = GQ_TAB_BROWSE(r->tab)->ctreeroot;
+     GQTreeWidgetNode *node;
+     const char *s, *c;
+     char *ep;
+     GType type;
+
+     r->idle = 0;
+
+     /* the user may have refreshed the tree since the last step */
+     if (r->node_dn) {
+	  r->node = tree_node_from_server_dn(ctree, r->server, r->node_dn);
+	  if (r->node == NULL) {
+	       restore_finish(r);
+	       return FALSE;
+	  }
+     }
+     node = r->node;
+
+     if (r->dnparts) {
+	  gq_exploded_free(r->dnparts);
+	  r->dnparts = NULL;
+     }
+
+     if (r->next == NULL) {
+	  restore_finish(r);
+	  return FALSE;
+     }
+
+     s = r->next->data;
+     r->next = g_list_next(r->next);
+
+     c = g_utf8_strchr(s, -1, ':');
+     type = strtoul(s, &ep, 10);
+
+     if (c != ep) {
+	  restore_continue(r, RESTORE_DONE);
+	  return FALSE;
+     }
+
+     statusbar_msg(_("Opening %s"), c + 1);
+
+     if (type == GQ_TYPE_BROWSER_NODE_DN && r->node_dn == NULL) {
+	  restore_continue(r, restore_show_dn(r, c + 1));
+     } else if (type == GQ_TYPE_BROWSER_NODE_DN) {
+	  int i;
+
+	  r->dnparts = gq_ldap_explode_dn(c + 1, 0);
+	  for (i = 0 ; r->dnparts[i] ; i++) ;
+	  r->part = i - 1;
+	  g_string_truncate(r->dn, 0);
+	  r->found = FALSE;
+
+	  restore_continue(r, restore_advance(r));
+     } else if (type == GQ_TYPE_BROWSER_NODE_REFERENCE) {
+	  RestoreState state = restore_expand(r, node);
+
+	  if (state == RESTORE_DONE) {
+	       node = gq_tree_widget_find_by_row_data_custom(GQ_TREE_WIDGET(ctree),
+							     node,
+							     (gpointer)(c + 1),
+							     (GCompareFunc) cmp_name);
+	       if (node == NULL) {
+		    state = RESTORE_FAILED;
+	       } else {
+		    restore_set_node(r, node);
+	       }
+	  }
+	  restore_continue(r, state);
+     } else {
+	  restore_continue(r, RESTORE_DONE);
+     }
+
+     return FALSE;
+}
+
+/* takes in the root DSE: the naming contexts for the server node, the
+   controls to know what expanding a node does */
+static void restore_got_root_dse(struct browse_restore *r, LDAPMessage *res)
+{
+     GqServer *server = r->server;
+     LDAPMessage *e = res ? ldap_first_entry(r->ld, res) : NULL;
+     GList *suffixes = NULL;
+     char **vals;
+     int i;
+
+     r->root_dse_read = TRUE;
+     set_server_controls(server, r->ld, res);
+
+     if (e == NULL) return;
+
+     vals = ldap_get_values(r->ld, e, "namingContexts");
+     if (vals) {
+	  for (i = 0 ; vals[i] ; i++) {
+	       suffixes = g_list_prepend(suffixes, g_strdup(vals[i]));
+	  }
+	  ldap_value_free(vals);
+     }
+
+     /* servers without namingContexts get the fallbacks of
+	get_suffixes() when their node is opened */
+     if (suffixes && server->prefetched_suffixes == NULL) {
+	  server->prefetched_suffixes = g_list_reverse(suffixes);
+     } else {
+	  g_list_foreach(suffixes, (GFunc) g_free, NULL);
+	  g_list_free(suffixes);
+     }
+}
+
+/* collects the values of attr (or the DNs if attr is NULL) of the
+   entries in res */
+static GList *restore_collect(LDAP *ld, LDAPMessage *res, const char *attr)
+{
+     LDAPMessage *e;
+     GList *l = NULL;
+     char **vals, *dn;
+     int i;
+
+     for (e = ldap_first_entry(ld, res) ; e ; e = ldap_next_entry(ld, e)) {
+	  if (attr == NULL) {
+	       dn = ldap_get_dn(ld, e);
+	       if (dn) {
+		    l = g_list_prepend(l, g_strdup(dn));
+		    ldap_memfree(dn);
 	       }
-	       if (node == NULL) break;
+	       continue;
 	  }
-	  if (node) gq_tree_select_node(ctree, node);
+	  vals = ldap_get_values(ld, e, attr);
+	  if (vals == NULL) continue;
+	  for (i = 0 ; vals[i] ; i++) {
+	       l = g_list_prepend(l, g_strdup(vals[i]));
+	  }
+	  ldap_value_free(vals);
+     }
+     return g_list_reverse(l);
+}
+
+static void restore_got_children(struct browse_restore *r, int ctx,
+				 LDAPMessage *refres, LDAPMessage *res)
+{
+     GQTreeWidget *ctree = GQ_TAB_BROWSE(r->tab)->ctreeroot;
+     GqBrowserNode *e = GQ_BROWSER_NODE(gq_tree_get_node_data(ctree, r->node));
+     GList *refs, *children;
+     int err = LDAP_SUCCESS;
+
+     refs = refres ? restore_collect(r->ld, refres, "ref") : NULL;
+     children = restore_collect(r->ld, res, NULL);
+     err = ldap_result2error(r->ld, res, 0);
+
+     gq_server_stats_entries(r->server, g_list_length(children));
+
+     if (err != LDAP_SUCCESS &&
+	 err != LDAP_SIZELIMIT_EXCEEDED &&
+	 err != LDAP_TIMELIMIT_EXCEEDED) {
+	  error_push(ctx, _("Error while searching below '%1$s': %2$s"),
+		     GQ_BROWSER_NODE_DN(e)->dn, ldap_err2string(err));
+	  push_ldap_addl_error(r->ld, ctx);
      }
 
-     if (!progress->cancelled) {
-	  if (gutter > 0) {
-	       gtk_paned_set_position(GTK_PANED(GQ_TAB_BROWSE(tab)->mainpane),
-				      gutter);
+     gq_browser_node_dn_set_children(GQ_BROWSER_NODE_DN(e), r->server,
+				     ctree, r->node, refs, children, err);
+
+     g_list_foreach(refs, (GFunc) g_free, NULL);
+     g_list_free(refs);
+     g_list_foreach(children, (GFunc) g_free, NULL);
+     g_list_free(children);
+}
+
+static void restore_got_entry(struct browse_restore *r, LDAPMessage *res)
+{
+     GQTreeWidget *ctree = GQ_TAB_BROWSE(r->tab)->ctreeroot;
+     LDAPMessage *e = res ? ldap_first_entry(r->ld, res) : NULL;
+     char *dn = r->dn->len ?
+	  g_strconcat(r->dnparts[r->part], ",", r->dn->str, NULL) :
+	  g_strdup(r->dnparts[r->part]);
+
+     r->found = FALSE;
+     if (e) {
+	  /* have it!! */
+	  char *dn2 = ldap_get_dn(r->ld, e);
+	  GQTreeWidgetNode *found = dn_browse_single_add(dn2, ctree, r->node);
+
+	  if (found) {
+	       restore_set_node(r, found);
+	       r->found = TRUE;
 	  }
+	  if (dn2) ldap_memfree(dn2);
+     }
+
+     /* on to the next RDN, whether it was there or not */
+     g_string_assign(r->dn, dn);
+     g_free(dn);
+     r->part--;
+}
+
+/* picks up the answers of the restore's searches */
+static gboolean restore_poll(struct browse_restore *r)
+{
+     GQTreeWidget *ctree = GQ_TAB_BROWSE(r->tab)->ctreeroot;
+     struct timeval nowait = { 0, 0 };
+     RestoreFetch fetch = r->fetch;
+     LDAPMessage *res[2];
+     int i, rc, ctx;
+
+     /* the user may have refreshed the tree meanwhile */
+     r->node = r->node_dn ?
+	  tree_node_from_server_dn(ctree, r->server, r->node_dn) : NULL;
+
+     /* somebody reconnected in the meantime */
+     if (!restore_connection_valid(r)) {
+	  r->timer = 0;
+	  r->ld = NULL;
+	  restore_finish(r);
+	  return FALSE;
+     }
 
-	  tmp = g_malloc(strlen(state_name) + 10);
-	  strcpy(tmp, state_name);
-	  strcat(tmp, ".input");
+     for (i = 0 ; i < 2 ; i++) {
+	  if (r->msgid[i] < 0) continue;
+	  rc = ldap_result(r->ld, r->msgid[i], LDAP_MSG_ALL, &nowait,
+			   &r->res[i]);
+	  if (rc == 0) continue;	/* not yet */
+	  if (rc < 0) {
+	       int err = LDAP_SUCCESS;
+	       ldap_get_option(r->ld, LDAP_OPT_ERROR_NUMBER, &err);
+	       if (err == LDAP_SERVER_DOWN) r->server->server_down++;
+	       r->res[i] = NULL;
+	  }
+	  r->msgid[i] = -1;
+     }
 
-	  if (GQ_TAB_BROWSE(tab)->inputform) {
-	       restore_input_snapshot(context, GQ_TAB_BROWSE(tab)->inputform, tmp);
+     if (r->msgid[0] >= 0 || r->msgid[1] >= 0) {
+	  if (gq_server_stats_start() - r->sent < RESTORE_SEARCH_TIMEOUT) {
+	       return TRUE;
 	  }
+	  statusbar_msg(_("Server '%s' did not answer in time, not restoring the rest of its browse path"),
+			r->server->name);
+	  r->timer = 0;
+	  gq_server_stats_stop(r->server, GQ_STAT_SEARCH, r->sent, FALSE);
+	  restore_finish(r);
+	  return FALSE;
+     }
 
-	  g_free(tmp);
+     r->timer = 0;
+     r->fetch = RESTORE_FETCH_NONE;
+     res[0] = r->res[0];
+     res[1] = r->res[1];
+     r->res[0] = r->res[1] = NULL;
+     gq_server_stats_stop(r->server, GQ_STAT_SEARCH, r->sent,
+			  res[0] != NULL || res[1] != NULL);
+
+     if (r->node == NULL) {
+	  if (res[0]) ldap_msgfree(res[0]);
+	  if (res[1]) ldap_msgfree(res[1]);
+	  restore_finish(r);
+	  return FALSE;
      }
+
+     ctx = error_new_context(_("Restoring browse tab"), GTK_WIDGET(ctree));
+
+     switch (fetch) {
+     case RESTORE_FETCH_ROOT_DSE:
+	  restore_got_root_dse(r, res[0]);
+	  break;
+     case RESTORE_FETCH_CHILDREN:
+	  if (res[1]) {
+	       restore_got_children(r, ctx, res[0], res[1]);
+	  } else {
+	       /* the connection broke */
+	       r->part = -1;
+	       r->found = FALSE;
+	  }
+	  break;
+     case RESTORE_FETCH_ENTRY:
+	  restore_got_entry(r, res[0]);
+	  break;
+     case RESTORE_FETCH_NONE:
+	  break;
+     }
+
+     if (res[0]) ldap_msgfree(res[0]);
+     if (res[1]) ldap_msgfree(res[1]);
+
+     error_flush(ctx);
+
+     restore_continue(r, restore_advance(r));
+     return FALSE;
+}
+
+static void restore_server_probed(GqServer *server, gboolean reachable,
+				  struct browse_restore *r)
+{
+     if (reachable) {
+	  int ctx = error_new_context(_("Restoring browse tab"),
+				      GTK_WIDGET(GQ_TAB_BROWSE(r->tab)->ctreeroot));
+
+	  r->ld = open_connection(ctx, server);
+	  error_flush(ctx);
+	  if (r->ld == NULL) {
+	       restore_finish(r);
+	       return;
+	  }
+	  r->incarnation = server->incarnation;
+
+	  r->idle = gtk_idle_add((GtkFunction) restore_step, r);
+     } else {
+	  GQTreeWidget *ctree = GQ_TAB_BROWSE(r->tab)->ctreeroot;
+	  char *label = g_strdup_printf(_("%s (unreachable)"), server->name);
+
+	  gq_tree_set_node_text(ctree, r->node, label);
+	  g_free(label);
+
+	  statusbar_msg(_("Server '%s' cannot be reached, not restoring its browse path"),
+			server->name);
+
+	  /* keep the path around so it gets saved again */
+	  r->parked = TRUE;
+     }
+}
+
+static void browse_restore_cancel(GqTab *tab)
+{
+     struct browse_restore *r = GQ_TAB_BROWSE(tab)->restore;
+
+     if (r == NULL) return;
+     GQ_TAB_BROWSE(tab)->restore = NULL;
+
+     gq_server_probe_cancel(r->server,
+			    (GqServerProbeFunc) restore_server_probed, r);
+     if (r->busy) {
+	  r->cancelled = TRUE;
+     } else {
+	  restore_free(r);
+     }
+}
+
+static void browse_restore_snapshot(int context,
+				    char *state_name, GqTab *tab,
+				    struct pbar_win *progress)
+{
+     GQTreeWidget *ctree = GQ_TAB_BROWSE(tab)->ctreeroot;
+     int gutter = state_value_get_int(state_name, "gutter-pos", -1);
+     const GList *path = state_value_get_list(state_name, "open-path");
+     const GList *I;
+     struct browse_restore *r;
+     GqServer *server = NULL;
+     int n;
+
+     if (progress->cancelled) return;
+
+     if (gutter > 0) {
+	  gtk_paned_set_position(GTK_PANED(GQ_TAB_BROWSE(tab)->mainpane),
+				 gutter);
+     }
+
+     /* the path starts with the server */
+     for (I = path, n = 0 ; I ; I = g_list_next(I), n++) {
+	  const char *s = I->data;
+	  const char *c = g_utf8_strchr(s, -1, ':');
+	  char *ep;
+	  GType type = strtoul(s, &ep, 10);
+
+	  if (c == ep && type == GQ_TYPE_BROWSER_NODE_SERVER) {
+	       server = gq_server_list_get_by_name(gq_server_list_get(), c + 1);
+	       break;
+	  }
+     }
+     if (server == NULL) return;
+
+     r = g_new0(struct browse_restore, 1);
+     r->tab = tab;
+     r->msgid[0] = r->msgid[1] = -1;
+     r->dn = g_string_new("");
+     r->state_name = g_strdup(state_name);
+     for (I = path ; I ; I = g_list_next(I)) {
+	  r->path = g_list_prepend(r->path, g_strdup(I->data));
+     }
+     r->path = g_list_reverse(r->path);
+     r->next = g_list_nth(r->path, n + 1);
+     r->server = g_object_ref(server);
+     restore_set_node(r, tree_node_from_server_dn(ctree, server, ""));
+
+     if (r->node == NULL) {
+	  restore_free(r);
+	  return;
+     }
+
+     browse_restore_cancel(tab);
+     GQ_TAB_BROWSE(tab)->restore = r;
+
+     gq_server_probe(server, RESTORE_PROBE_TIMEOUT,
+		     (GqServerProbeFunc) restore_server_probed, r);
 }
 
 void set_update_lock(GqTab *tab)
@@ -481,7 +1201,7 @@ GqTab *new_browsemode()
      gq_tree_widget_set_selection_mode(GQ_TREE_WIDGET(ctreeroot), GTK_SELECTION_BROWSE);
      gq_tree_widget_set_column_auto_resize(GQ_TREE_WIDGET(ctreeroot), 0, TRUE);
      if (config->sort_browse) {
-	  gtk_clist_set_auto_sort(GTK_CLIST(ctreeroot), TRUE);
+	  gq_tree_widget_set_auto_sort(GQ_TREE_WIDGET(ctreeroot), TRUE);
      }
 
      gq_tree_widget_set_select_callback(GQ_TREE_WIDGET(ctreeroot),
@@ -542,11 +1262,9 @@ GqTab *new_browsemode()
 GqServer *server_from_node(GQTreeWidget *ctreeroot,
 				    GQTreeWidgetNode *node)
 {
-     GQTreeWidgetRow *row = NULL;
      GqBrowserNode *entry;
 
-     for ( ; node ; node = row->parent ) {
-	  row = GQ_TREE_WIDGET_ROW(node);
+     for ( ; node ; node = gq_tree_get_parent_node(ctreeroot, node) ) {
 	  entry = GQ_BROWSER_NODE(gq_tree_get_node_data (ctreeroot,
 							       node));
 	  if (GQ_IS_BROWSER_NODE_SERVER(entry)) {
@@ -664,13 +1382,13 @@ void refresh_subtree_new_dn(int error_context,
 
 	  /* mark the entry to be uncached before we check for it again */
 	  e->uncache = TRUE;
-	  gtk_clist_freeze(GTK_CLIST(ctree));
+	  gq_tree_widget_freeze(ctree);
 
 	  is_expanded = gq_tree_is_node_expanded (ctree, node);
 
 	  if (newdn) {
-	       parent = GQ_TREE_WIDGET_ROW(node)->parent;
-	       sibling = GQ_TREE_WIDGET_ROW(node)->sibling;
+	       parent = gq_tree_get_parent_node(ctree, node);
+	       sibling = gq_tree_get_next_sibling(ctree, node);
 
 	       /* disconnecting entry from row doesn't work without calling
 		  the destroy notify function - thus copy the entry */
@@ -737,7 +1455,7 @@ void refresh_subtree_new_dn(int error_context,
 			 ctree, server_from_node(ctree, node), e->dn, TRUE);
 
 
-	  gtk_clist_thaw(GTK_CLIST(ctree));
+	  gq_tree_widget_thaw(ctree);
      }
 }
 
@@ -885,6 +1603,483 @@ GQTreeWidgetNode *show_dn(int error_context,
      return NULL;
 }
 
+/*
+ * Showing many DNs at once
+ *
+ * The DNs to show are merged into a trie of all their ancestors, which
+ * is then resolved level by level. Every ancestor gets expanded (and
+ * its children indexed) only once, and the entries the listings do not
+ * show - typically because of a size limit - are looked up with a few
+ * OR-filtered onelevel searches per parent. All searches of a level
+ * are sent before the first result is read.
+ */
+
+/* the number of RDNs ORed together in one lookup */
+#define DN_BATCH_CHUNK	64
+
+struct dn_want {
+     char *dn;
+     char *key;			/* normalized, see dn_key() */
+     struct dn_want *parent;
+     int depth;
+     gboolean requested;	/* part of the set, not just an ancestor */
+     GQTreeWidgetNode *anchor;	/* closest shown ancestor */
+     GQTreeWidgetNode *node;	/* where this DN is shown */
+};
+
+struct dn_batch {
+     int error_context;
+     GQTreeWidget *tree;
+     GqServer *server;
+     LDAP *ld;
+     gboolean failed;
+     GHashTable *wants;		/* key -> struct dn_want */
+     GHashTable *index;		/* key -> GQTreeWidgetNode */
+     GHashTable *opened;	/* GQTreeWidgetNode -> itself */
+     GHashTable *touched;	/* GQTreeWidgetNode -> itself */
+};
+
+/* DNs are compared by their exploded and re-joined form, so different
+   spacing does not matter */
+static char *dn_key(const char *dn)
+{
+     char **parts = gq_ldap_explode_dn(dn, FALSE);
+     GString *s;
+     char *key;
+     int i;
+
+     if (parts == NULL) return g_ascii_strdown(dn, -1);
+
+     s = g_string_new("");
+     for (i = 0 ; parts[i] ; i++) {
+	  if (i > 0) g_string_append_c(s, ',');
+	  g_string_append(s, parts[i]);
+     }
+     gq_exploded_free(parts);
+
+     key = g_ascii_strdown(s->str, s->len);
+     g_string_free(s, TRUE);
+     return key;
+}
+
+static void dn_batch_index_children(struct dn_batch *b,
+				    GQTreeWidgetNode *node)
+{
+     GQTreeWidgetNode *n;
+
+     for (n = gq_tree_get_first_child(b->tree, node) ; n ;
+	  n = gq_tree_get_next_sibling(b->tree, n)) {
+	  GqBrowserNode *e = gq_tree_get_node_data(b->tree, n);
+
+	  if (e == NULL) continue;	/* dummy */
+	  if (GQ_IS_BROWSER_NODE_DN(e)) {
+	       g_hash_table_insert(b->index,
+				   dn_key(GQ_BROWSER_NODE_DN(e)->dn), n);
+	  } else if (GQ_IS_BROWSER_NODE_RANGE(e)) {
+	       /* the children of huge containers live one level
+		  further down */
+	       dn_batch_index_children(b, n);
+	  }
+     }
+}
+
+/* expands a node (listing it if that has not happened yet) and
+   indexes what shows up below it */
+static void dn_batch_open(struct dn_batch *b, GQTreeWidgetNode *node)
+{
+     if (g_hash_table_lookup(b->opened, node)) return;
+     g_hash_table_insert(b->opened, node, node);
+
+     gq_tree_expand_node(b->tree, node);
+     dn_batch_index_children(b, node);
+}
+
+/* appends a filter matching the RDN of dn. Returns FALSE if the RDN
+   cannot be expressed as a filter, the entry has to be read directly
+   then. */
+static gboolean append_rdn_filter(GString *filter, const char *dn)
+{
+#if LDAP_API_VERSION > 2004
+     LDAPDN parts = NULL;
+     LDAPRDN rdn;
+     GString *f;
+     gboolean ok = TRUE;
+     unsigned int j;
+     int i;
+
+     if (ldap_str2dn(dn, &parts, LDAP_DN_FORMAT_LDAPV3) != LDAP_SUCCESS
+	 || parts == NULL) {
+	  return FALSE;
+     }
+     rdn = parts[0];
+     if (rdn == NULL) {
+	  ldap_dnfree(parts);
+	  return FALSE;
+     }
+
+     f = g_string_new(rdn[1] ? "(&" : "");
+     for (i = 0 ; rdn[i] ; i++) {
+	  LDAPAVA *ava = rdn[i];
+
+	  if (ava->la_flags & LDAP_AVA_BINARY) {
+	       ok = FALSE;
+	       break;
+	  }
+
+	  g_string_append_c(f, '(');
+	  g_string_append_len(f, ava->la_attr.bv_val, ava->la_attr.bv_len);
+	  g_string_append_c(f, '=');
+	  for (j = 0 ; j < ava->la_value.bv_len ; j++) {
+	       unsigned char c = ava->la_value.bv_val[j];
+	       if (c == '*' || c == '(' || c == ')' || c == '\\' ||
+		   c < 0x20 || c == 0x7f) {
+		    g_string_append_printf(f, "\\%02x", c);
+	       } else {
+		    g_string_append_c(f, c);
+	       }
+	  }
+	  g_string_append_c(f, ')');
+     }
+     if (rdn[1]) g_string_append_c(f, ')');
+
+     if (ok) g_string_append(filter, f->str);
+
+     g_string_free(f, TRUE);
+     ldap_dnfree(parts);
+     return ok;
+#else
+     return FALSE;
+#endif
+}
+
+static void dn_batch_send(struct dn_batch *b, const char *base, int scope,
+			  const char *filter, GQueue *pending)
+{
+     char *attrs[] = { LDAP_NO_ATTRS, NULL };
+     LDAPControl c;
+     LDAPControl *ctrls[2] = { NULL, NULL } ;
+     int rc, msgid;
+
+     if (b->failed) return;
+
+     c.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+     c.ldctl_value.bv_val	= NULL;
+     c.ldctl_value.bv_len	= 0;
+     c.ldctl_iscritical		= 1;
+
+     ctrls[0] = &c;
+
+     rc = ldap_search_ext(b->ld, base, scope, filter, attrs, 0,
+			  ctrls,		/* serverctrls */
+			  NULL,			/* clientctrls */
+			  NULL,			/* timeout */
+			  LDAP_NO_LIMIT,	/* sizelimit */
+			  &msgid);
+
+     if (rc == LDAP_NOT_SUPPORTED) {
+	  rc = ldap_search_ext(b->ld, base, scope, filter, attrs, 0,
+			       NULL, NULL, NULL, LDAP_NO_LIMIT, &msgid);
+     }
+
+     if (rc == LDAP_SUCCESS) {
+	  g_queue_push_tail(pending, GINT_TO_POINTER(msgid));
+     } else if (rc == LDAP_SERVER_DOWN) {
+	  b->server->server_down++;
+	  b->failed = TRUE;
+     } else {
+	  error_push(b->error_context,
+		     _("Error searching below '%1$s': %2$s"),
+		     base, ldap_err2string(rc));
+     }
+}
+
+static void dn_batch_found(struct dn_batch *b, const char *dn)
+{
+     char *key = dn_key(dn);
+     struct dn_want *w = g_hash_table_lookup(b->wants, key);
+
+     if (w && w->node == NULL) {
+	  w->node = dn_browse_single_add(dn, b->tree, w->anchor);
+	  if (w->node) {
+	       g_hash_table_insert(b->index, g_strdup(key), w->node);
+	       g_hash_table_insert(b->touched, w->anchor, w->anchor);
+	  }
+     }
+     g_free(key);
+}
+
+static void dn_batch_collect(struct dn_batch *b, int msgid)
+{
+     LDAPMessage *res, *e;
+     int rc, err;
+
+     while ((rc = ldap_result(b->ld, msgid, 0, NULL, &res)) > 0) {
+	  if (rc == LDAP_RES_SEARCH_ENTRY) {
+	       for (e = ldap_first_entry(b->ld, res) ; e ;
+		    e = ldap_next_entry(b->ld, e)) {
+		    char *dn = ldap_get_dn(b->ld, e);
+		    if (dn) {
+			 dn_batch_found(b, dn);
+			 ldap_memfree(dn);
+		    }
+	       }
+	  } else if (rc == LDAP_RES_SEARCH_RESULT) {
+	       if (ldap_parse_result(b->ld, res, &err, NULL, NULL,
+				     NULL, NULL, 0) == LDAP_SUCCESS &&
+		   err != LDAP_SUCCESS && err != LDAP_NO_SUCH_OBJECT &&
+		   err != LDAP_SIZELIMIT_EXCEEDED) {
+		    error_push(b->error_context,
+			       _("Error looking up entries to show: %s"),
+			       ldap_err2string(err));
+	       }
+	       ldap_msgfree(res);
+	       return;
+	  }
+	  ldap_msgfree(res);
+     }
+
+     ldap_get_option(b->ld, LDAP_OPT_ERROR_NUMBER, &err);
+     if (err == LDAP_SERVER_DOWN) {
+	  b->server->server_down++;
+	  b->failed = TRUE;
+     }
+}
+
+/* looks up the DNs of one level that are not in the tree. Those whose
+   parent is shown are found with OR-filtered onelevel searches below
+   it, the rest (the first levels, mostly) are read one by one */
+static void dn_batch_fetch(struct dn_batch *b, GList *missing)
+{
+     GHashTable *by_parent = g_hash_table_new(g_direct_hash, g_direct_equal);
+     GList *parents = NULL, *I, *J;
+     GQueue *pending = g_queue_new();
+
+     for (I = missing ; I ; I = g_list_next(I)) {
+	  struct dn_want *w = I->data;
+
+	  if (w->parent && w->parent->node) {
+	       GList *l = g_hash_table_lookup(by_parent, w->parent);
+	       if (l == NULL) parents = g_list_prepend(parents, w->parent);
+	       g_hash_table_insert(by_parent, w->parent,
+				   g_list_prepend(l, w));
+	  } else {
+	       dn_batch_send(b, w->dn, LDAP_SCOPE_BASE, "(objectClass=*)",
+			     pending);
+	  }
+     }
+
+     for (I = parents ; I ; I = g_list_next(I)) {
+	  struct dn_want *parent = I->data;
+	  GList *l = g_hash_table_lookup(by_parent, parent);
+	  GString *filter = g_string_new("");
+	  int n = 0;
+
+	  for (J = l ; J ; J = g_list_next(J)) {
+	       struct dn_want *w = J->data;
+
+	       if (!append_rdn_filter(filter, w->dn)) {
+		    dn_batch_send(b, w->dn, LDAP_SCOPE_BASE,
+				  "(objectClass=*)", pending);
+		    continue;
+	       }
+	       if (++n == DN_BATCH_CHUNK || J->next == NULL) {
+		    g_string_prepend(filter, "(|");
+		    g_string_append_c(filter, ')');
+		    dn_batch_send(b, parent->dn, LDAP_SCOPE_ONELEVEL,
+				  filter->str, pending);
+		    g_string_truncate(filter, 0);
+		    n = 0;
+	       }
+	  }
+	  if (n > 0) {
+	       /* the list ended on an RDN that needed a direct read */
+	       g_string_prepend(filter, "(|");
+	       g_string_append_c(filter, ')');
+	       dn_batch_send(b, parent->dn, LDAP_SCOPE_ONELEVEL,
+			     filter->str, pending);
+	  }
+
+	  g_string_free(filter, TRUE);
+	  g_list_free(l);
+     }
+
+     while (!g_queue_is_empty(pending)) {
+	  int msgid = GPOINTER_TO_INT(g_queue_pop_head(pending));
+	  if (!b->failed) {
+	       dn_batch_collect(b, msgid);
+	  }
+     }
+
+     g_queue_free(pending);
+     g_list_free(parents);
+     g_hash_table_destroy(by_parent);
+}
+
+static gint dn_want_cmp(const struct dn_want *a, const struct dn_want *b)
+{
+     if (a->parent != b->parent) {
+	  if (a->parent == NULL) return -1;
+	  if (b->parent == NULL) return 1;
+	  return strcmp(a->parent->key, b->parent->key);
+     }
+     return strcmp(a->key, b->key);
+}
+
+static void sort_touched_node(GQTreeWidgetNode *node, gpointer value,
+			      GQTreeWidget *tree)
+{
+     gq_tree_widget_sort_node(tree, node);
+}
+
+static void free_dn_want(gpointer key, struct dn_want *w, gpointer data)
+{
+     g_free(w->dn);
+     g_free(w->key);
+     g_free(w);
+}
+
+/*
+ * Shows all DNs in dns (a list of strings) below the node of server,
+ * adding entries hidden by size limits by hand, just like show_dn()
+ * does for a single DN. Returns the number of DNs that could be
+ * shown.
+ */
+int show_server_dns(int error_context, GQTreeWidget *tree,
+		    GqServer *server, GList *dns)
+{
+     struct dn_batch b;
+     GQTreeWidgetNode *top;
+     GPtrArray *levels;
+     GList *I;
+     guint d;
+     int shown = 0;
+
+     if (!tree || !server) return 0;
+
+     top = tree_node_from_server_dn(tree, server, "");
+     if (!top) return 0;
+
+     memset(&b, 0, sizeof(b));
+     b.error_context = error_context;
+     b.tree = tree;
+     b.server = server;
+     b.wants = g_hash_table_new(g_str_hash, g_str_equal);
+     b.index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+     b.opened = g_hash_table_new(g_direct_hash, g_direct_equal);
+     b.touched = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+     /* build the ancestor trie, one list of nodes per depth */
+     levels = g_ptr_array_new();
+     for (I = dns ; I ; I = g_list_next(I)) {
+	  const char *dn = I->data;
+	  struct dn_want *parent = NULL;
+	  char **parts;
+	  GString *s;
+	  int i;
+
+	  parts = gq_ldap_explode_dn(dn, FALSE);
+	  if (parts == NULL) {
+	       error_push(error_context, _("Cannot explode DN '%s'. Maybe problems with quoting or special characters. See RFC 2253 for details of DN syntax."), dn);
+	       continue;
+	  }
+
+	  for (i = 0 ; parts[i] ; i++) ;
+
+	  s = g_string_new("");
+	  for (i-- ; i >= 0 ; i--) {
+	       struct dn_want *w;
+	       char *key;
+
+	       if (*parts[i] == 0) continue;
+	       if (s->len > 0) g_string_prepend_c(s, ',');
+	       g_string_prepend(s, parts[i]);
+
+	       key = g_ascii_strdown(s->str, s->len);
+	       w = g_hash_table_lookup(b.wants, key);
+	       if (w == NULL) {
+		    w = g_new0(struct dn_want, 1);
+		    w->dn = g_strdup(s->str);
+		    w->key = key;
+		    w->parent = parent;
+		    w->depth = parent ? parent->depth + 1 : 0;
+
+		    while (levels->len <= (guint) w->depth) {
+			 g_ptr_array_add(levels, NULL);
+		    }
+		    g_ptr_array_index(levels, w->depth) =
+			 g_list_prepend(g_ptr_array_index(levels, w->depth), w);
+		    g_hash_table_insert(b.wants, key, w);
+	       } else {
+		    g_free(key);
+	       }
+	       parent = w;
+	  }
+	  if (parent) parent->requested = TRUE;
+
+	  g_string_free(s, TRUE);
+	  gq_exploded_free(parts);
+     }
+
+     gq_tree_widget_freeze(tree);
+
+     b.ld = open_connection(error_context, server);
+     if (b.ld == NULL) b.failed = TRUE;
+
+     for (d = 0 ; d < levels->len ; d++) {
+	  GList *level, *missing = NULL;
+
+	  level = g_list_sort(g_ptr_array_index(levels, d),
+			      (GCompareFunc) dn_want_cmp);
+	  g_ptr_array_index(levels, d) = level;
+
+	  for (I = level ; I ; I = g_list_next(I)) {
+	       struct dn_want *w = I->data;
+
+	       if (w->parent == NULL) {
+		    w->anchor = top;
+	       } else {
+		    w->anchor = w->parent->node ?
+			 w->parent->node : w->parent->anchor;
+	       }
+
+	       dn_batch_open(&b, w->anchor);
+	       w->node = g_hash_table_lookup(b.index, w->key);
+
+	       if (w->node == NULL) missing = g_list_prepend(missing, w);
+	  }
+
+	  if (missing && !b.failed) {
+	       missing = g_list_reverse(missing);
+	       dn_batch_fetch(&b, missing);
+	  }
+	  g_list_free(missing);
+     }
+
+     if (b.ld) close_connection(server, FALSE);
+
+     /* entries added by hand go to their proper places */
+     g_hash_table_foreach(b.touched, (GHFunc) sort_touched_node, tree);
+
+     gq_tree_widget_thaw(tree);
+
+     for (d = 0 ; d < levels->len ; d++) {
+	  for (I = g_ptr_array_index(levels, d) ; I ; I = g_list_next(I)) {
+	       struct dn_want *w = I->data;
+	       if (w->requested && w->node) shown++;
+	  }
+	  g_list_free(g_ptr_array_index(levels, d));
+     }
+     g_ptr_array_free(levels, TRUE);
+
+     g_hash_table_foreach(b.wants, (GHFunc) free_dn_want, NULL);
+     g_hash_table_destroy(b.wants);
+     g_hash_table_destroy(b.index);
+     g_hash_table_destroy(b.opened);
+     g_hash_table_destroy(b.touched);
+
+     return shown;
+}
+
 /*
  * Button pressed on a tree item. Button 3 gets intercepted and puts up
  * a popup menu, all other buttons get passed along to the default handler
@@ -901,7 +2096,7 @@ static gboolean button_press_on_tree_item(GtkWidget *tree,
      GqBrowserNodeDn *entry;
 
      if (event->type == GDK_BUTTON_PRESS && event->button == 3
-	 && event->window == GTK_CLIST(tree)->clist_window) {
+	 && event->window == gq_tree_widget_get_bin_window(GQ_TREE_WIDGET(tree))) {
 	  char *name;
 	  ctree_node = gq_tree_get_node_at (GQ_TREE_WIDGET(tree), event->x, event->y);
 
@@ -1049,6 +2244,9 @@ tab_dispose(GObject* object)
 {
 	GqTabBrowse* self = GQ_TAB_BROWSE(object);
 
+	browse_live_unsubscribe_all(GQ_TAB(self));
+	browse_restore_cancel(GQ_TAB(self));
+
 	if(self->inputform) {
 		inputform_free(self->inputform);
 		self = NULL;
@@ -61,6 +61,14 @@ struct _GqTabBrowse {
 
      /* used to store old hide-button state - Hack */
      int hidden;
+
+     /* live update subscriptions of expanded nodes, see browse-live.c */
+     GList *live;
+     guint live_timer;
+     guint live_polls;
+
+     /* the saved open path while it gets restored in the background */
+     struct browse_restore *restore;
 };
 
 
@@ -103,6 +111,11 @@ GQTreeWidgetNode *show_dn(int error_context,
 		      GQTreeWidget *tree, GQTreeWidgetNode *node, const char *dn,
 		      gboolean select_node);
 
+/* shows many DNs (a list of strings) of one server in a single pass */
+int show_server_dns(int error_context,
+		    GQTreeWidget *tree,
+		    GqServer *server, GList *dns);
+
 GQTreeWidgetNode *node_from_dn(GQTreeWidget *ctreeroot,
 			   GQTreeWidgetNode *top,
 			   char *dn);
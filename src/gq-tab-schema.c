@@ -37,14 +37,11 @@
 #include <string.h>
 
 
-#define GTK_ENABLE_BROKEN  /* for the tree widget - should be replaced */
-
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
-#include <gtk/gtktree.h>
-#include <gtk/gtktreeitem.h>
 
+#include "gq-schema-model.h"
 #include "gq-server-list.h"
 #include "mainwin.h"
 #include "configfile.h"
@@ -54,52 +51,60 @@
 #include "debug.h"
 #include "errorchain.h"
 
+/* how long to wait for more typing before searching, in ms */
+#define SCHEMA_SEARCH_DELAY	150
+
 
-static void attach_schema_item(GtkWidget *tree, const char *type,
-			       void *schemaobject, char *itemname);
-static gboolean schema_button_tree(GtkWidget *tree_item, GdkEventButton *event,
-				   GtkWidget *root);
+static gboolean schema_button_press(GtkWidget *treeview,
+				    GdkEventButton *event, GqTab *tab);
+static gboolean schema_expand_row(GtkTreeView *treeview, GtkTreeIter *iter,
+				  GtkTreePath *path, GqTab *tab);
+static void schema_selection_changed(GtkTreeSelection *selection,
+				     GqTab *tab);
+static void schema_search_changed(GtkWidget *widget, GqTab *tab);
+static void schema_tab_destroyed(GtkWidget *widget, GqTab *tab);
 
 
-static void add_single_schema_server(GqTab *tab,
-				     GqServer *server);
 static void add_schema_servers(GqTab *tab);
-static void attach_server_schema(GtkWidget *item, GqTab *tab);
-static void schema_refresh_server(GtkWidget *widget, GtkWidget *item);
+static void attach_server_schema(GqTab *tab, GtkTreeIter *iter,
+				 gboolean refresh);
+static void schema_refresh_server(GtkWidget *menu_item, GqTab *tab);
 
 static void make_detail_notebook(GqTab *tab);
-static void popup_detail_callback(GtkWidget *dummy, GtkWidget *widget);
+static void popup_detail_callback(GtkWidget *menu_item, GqTab *tab);
 static void make_oc_detail(GtkWidget *target_oc_vbox);
-static void fill_oc_detail_rightpane(GtkWidget *treeroot, GtkWidget *tree_item,
-				     GqTab *tab);
+static void fill_oc_detail_rightpane(GqTab *tab, GqServer *server,
+				     LDAPObjectClass *oc);
 static void fill_oc_detail(GtkWidget *target_oc_vbox,
 			   GqServer *server,
 			   LDAPObjectClass *oc);
 
 static void make_at_detail(GtkWidget *target_at_vbox);
-static void fill_at_detail_rightpane(GtkWidget *treeroot,
-				     GtkWidget *tree_item, GqTab *tab);
+static void fill_at_detail_rightpane(GqTab *tab, GqServer *server,
+				     LDAPAttributeType *at);
 static void fill_at_detail(int error_context, GtkWidget *target_vbox,
 			   GqServer *server,
 			   LDAPAttributeType *at);
 
 static void make_mr_detail(GtkWidget *target_mr_vbox);
-static void fill_mr_detail_rightpane(GtkWidget *treeroot, GtkWidget *tree_item,
-				     GqTab *tab);
+static void fill_mr_detail_rightpane(GqTab *tab, GqServer *server,
+				     LDAPMatchingRule *mr);
 static void fill_mr_detail(GtkWidget *target_vbox, GqServer *server,
 			   LDAPMatchingRule *mr);
 
 static void make_s_detail(GtkWidget *target_vbox);
-static void fill_s_detail_rightpane(GtkWidget *treeroot, GtkWidget *tree_item,
-				    GqTab *tab);
+static void fill_s_detail_rightpane(GqTab *tab, GqServer *server,
+				    LDAPSyntax *s);
 static void fill_s_detail(GtkWidget *target_vbox, GqServer *server,
 			  LDAPSyntax *s);
 
 GqTab *new_schemamode()
 {
      GtkWidget *schemamode_vbox, *rightpane_vbox, *spacer;
-     GtkWidget *mainpane, *treeroot;
+     GtkWidget *mainpane, *treeview, *leftpane_vbox, *hbox, *label;
      GtkWidget *leftpane_scrwin, *rightpane_scrwin;
+     GtkTreeViewColumn *column;
+     GqSchemaModel *model;
      GqTabSchema *modeinfo;
 
      GqTab *tab = g_object_new(GQ_TYPE_TAB_SCHEMA, NULL);
@@ -118,9 +123,58 @@ GqTab *new_schemamode()
      gtk_widget_show(mainpane);
      gtk_box_pack_start(GTK_BOX(schemamode_vbox), mainpane, TRUE, TRUE, 0);
 
-     treeroot = gtk_tree_new();
-     modeinfo->treeroot = treeroot;
-     gtk_widget_show(treeroot);
+     leftpane_vbox = gtk_vbox_new(FALSE, 2);
+     gtk_widget_show(leftpane_vbox);
+     gtk_paned_add1(GTK_PANED(mainpane), leftpane_vbox);
+
+     /* searching names and OIDs */
+     hbox = gtk_hbox_new(FALSE, 4);
+     gtk_widget_show(hbox);
+     gtk_box_pack_start(GTK_BOX(leftpane_vbox), hbox, FALSE, FALSE, 0);
+
+     label = gtk_label_new_with_mnemonic(_("_Find:"));
+     gtk_widget_show(label);
+     gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+
+     modeinfo->search_entry = gtk_entry_new();
+     gtk_label_set_mnemonic_widget(GTK_LABEL(label), modeinfo->search_entry);
+     gtk_widget_show(modeinfo->search_entry);
+     gtk_box_pack_start(GTK_BOX(hbox), modeinfo->search_entry, TRUE, TRUE, 0);
+     g_signal_connect(modeinfo->search_entry, "changed",
+		      G_CALLBACK(schema_search_changed), tab);
+
+     modeinfo->anywhere_check =
+	  gtk_check_button_new_with_mnemonic(_("Match _anywhere"));
+     gtk_widget_show(modeinfo->anywhere_check);
+     gtk_box_pack_start(GTK_BOX(hbox), modeinfo->anywhere_check,
+			FALSE, FALSE, 0);
+     g_signal_connect(modeinfo->anywhere_check, "toggled",
+		      G_CALLBACK(schema_search_changed), tab);
+
+     model = gq_schema_model_new();
+     treeview = gtk_tree_view_new_with_model(GTK_TREE_MODEL(model));
+     g_object_unref(model);
+     modeinfo->treeview = treeview;
+     gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(treeview), FALSE);
+
+     /* every row has the same height, so the view does not need to
+	look at the thousands of names to lay them out */
+     column = gtk_tree_view_column_new_with_attributes("",
+						       gtk_cell_renderer_text_new(),
+						       "text", GQ_SCHEMA_MODEL_COL_NAME,
+						       NULL);
+     gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+     gtk_tree_view_column_set_fixed_width(column, 280);
+     gtk_tree_view_append_column(GTK_TREE_VIEW(treeview), column);
+     gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(treeview), TRUE);
+
+     g_signal_connect(treeview, "test-expand-row",
+		      G_CALLBACK(schema_expand_row), tab);
+     g_signal_connect(treeview, "button_press_event",
+		      G_CALLBACK(schema_button_press), tab);
+     g_signal_connect(gtk_tree_view_get_selection(GTK_TREE_VIEW(treeview)),
+		      "changed", G_CALLBACK(schema_selection_changed), tab);
+     gtk_widget_show(treeview);
      add_schema_servers(tab);
 
      leftpane_scrwin = gtk_scrolled_window_new(NULL, NULL);
@@ -130,9 +184,9 @@ GqTab *new_schemamode()
      gtk_widget_show(leftpane_scrwin);
      gtk_paned_set_position(GTK_PANED(mainpane), 300);
 
-     gtk_paned_add1(GTK_PANED(mainpane), leftpane_scrwin);
-     gtk_scrolled_window_add_with_viewport(GTK_SCROLLED_WINDOW(leftpane_scrwin),
-                                           treeroot);
+     gtk_box_pack_start(GTK_BOX(leftpane_vbox), leftpane_scrwin,
+			TRUE, TRUE, 0);
+     gtk_container_add(GTK_CONTAINER(leftpane_scrwin), treeview);
 
      rightpane_scrwin = gtk_scrolled_window_new(NULL, NULL);
      gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(rightpane_scrwin),
@@ -151,6 +205,8 @@ GqTab *new_schemamode()
      gtk_widget_show(schemamode_vbox);
 
 
+     g_signal_connect(schemamode_vbox, "destroy",
+		      G_CALLBACK(schema_tab_destroyed), tab);
      g_signal_connect_swapped(schemamode_vbox, "destroy",
 			      G_CALLBACK(g_object_unref), tab);
 
@@ -159,14 +215,28 @@ GqTab *new_schemamode()
      return tab;
 }
 
+static GqSchemaModel *current_model(GqTab *tab)
+{
+     GtkTreeView *view = GTK_TREE_VIEW(GQ_TAB_SCHEMA(tab)->treeview);
+     return GQ_SCHEMA_MODEL(gtk_tree_view_get_model(view));
+}
+
+static void schema_tab_destroyed(GtkWidget *widget, GqTab *tab)
+{
+     if (GQ_TAB_SCHEMA(tab)->search_timeout) {
+	  gtk_timeout_remove(GQ_TAB_SCHEMA(tab)->search_timeout);
+	  GQ_TAB_SCHEMA(tab)->search_timeout = 0;
+     }
+}
+
 static void
 add_schema_server_and_count(GQServerList* list, GqServer* server, gpointer user_data) {
 	gpointer**tab_and_count = user_data;
 	GqTab* tab = GQ_TAB(tab_and_count[0]);
 	gint* count = (gint*)tab_and_count[1];
 
-	add_single_schema_server(tab, server);
-	*count++;
+	gq_schema_model_add_server(current_model(tab), server);
+	(*count)++;
 }
 
 static void add_schema_servers(GqTab *tab)
@@ -186,238 +256,239 @@ static void add_schema_servers(GqTab *tab)
 }
 
 
-static void add_single_schema_server(GqTab *tab,
-				     GqServer *server)
+/* shows the schema of the server at iter, fetching it if it has not
+   been fetched yet or refresh is set */
+static void attach_server_schema(GqTab *tab, GtkTreeIter *iter,
+				 gboolean refresh)
 {
-     GtkWidget *new_item, *new_subtree;
-
-     if (server) {
-	  new_item = gtk_tree_item_new_with_label(server->name);
-	  GTK_WIDGET_UNSET_FLAGS(new_item, GTK_CAN_FOCUS);
-	  g_signal_connect(new_item, "button_press_event",
-			     G_CALLBACK(schema_button_tree),
-			     GQ_TAB_SCHEMA(tab)->treeroot);
-	  g_signal_connect(new_item, "button_release_event",
-			     G_CALLBACK(schema_button_tree),
-			     GQ_TAB_SCHEMA(tab)->treeroot);
-	  gtk_object_set_data(GTK_OBJECT(new_item), "tab", tab);
-	  gtk_object_set_data_full(GTK_OBJECT(new_item), "server",
-				   g_object_ref(server), g_object_unref);
+     GqSchemaModel *model = current_model(tab);
+     GqServer *server;
+     struct server_schema *ss;
+     int attach_context = error_new_context(_("Expanding server schema entry"),
+					    GQ_TAB_SCHEMA(tab)->treeview);
+
+     gtk_tree_model_get(GTK_TREE_MODEL(model), iter,
+			GQ_SCHEMA_MODEL_COL_SERVER, &server,
+			-1);
 
-	  gtk_tree_append(GTK_TREE(GQ_TAB_SCHEMA(tab)->treeroot), new_item);
-	  new_subtree = gtk_tree_new();
-	  gtk_widget_show(new_subtree);
-	  gtk_tree_item_set_subtree(GTK_TREE_ITEM(new_item), new_subtree);
-	  gtk_widget_show(new_item);
-	  g_signal_connect(new_item, "expand",
-			     G_CALLBACK(attach_server_schema), tab);
+     set_busycursor();
+
+     if (refresh) {
+	  close_connection(server, TRUE);
+	  /* the old details may be gone with the old schema */
+	  GQ_TAB_SCHEMA(tab)->cur_oc = NULL;
+	  GQ_TAB_SCHEMA(tab)->cur_at = NULL;
+	  GQ_TAB_SCHEMA(tab)->cur_mr = NULL;
+	  GQ_TAB_SCHEMA(tab)->cur_s = NULL;
+     }
 
+     ss = server->ss && !refresh ? server->ss
+	  : get_server_schema(attach_context, server);
+     if (ss || refresh) {
+	  gq_schema_model_set_schema(model, iter, ss);
      }
+
+     set_normalcursor();
+
+     g_object_unref(server);
+     error_flush(attach_context);
 }
 
 
-static void attach_server_schema(GtkWidget *item, GqTab *tab)
+static gboolean schema_expand_row(GtkTreeView *treeview, GtkTreeIter *iter,
+				  GtkTreePath *path, GqTab *tab)
 {
-     LDAPObjectClass *oc;
-     LDAPAttributeType *at;
-     LDAPMatchingRule *mr;
-     LDAPSyntax *s;
-     GList *tmp;
-     GtkWidget *new_item, *server_subtree, *new_subtree;
-     GqServer *server;
-     struct server_schema *ss;
-     int i;
-     int attach_context = error_new_context(_("Expanding server schema entry"),
-					    item);
+     if (gtk_tree_path_get_depth(path) == 1 &&
+	 !gq_schema_model_is_loaded(current_model(tab), iter)) {
+	  attach_server_schema(tab, iter, FALSE);
+     }
+     /* go on expanding */
+     return FALSE;
+}
 
-     g_signal_handlers_disconnect_by_func(item,
-				   G_CALLBACK(attach_server_schema), tab);
 
-     if( (server = gtk_object_get_data(GTK_OBJECT(item), "server")) == NULL)
-	  return;
+static void schema_selection_changed(GtkTreeSelection *selection, GqTab *tab)
+{
+     GtkTreeModel *model;
+     GtkTreeIter iter;
+     GqServer *server;
+     gpointer object;
+     gint type;
 
-     set_busycursor();
+     if (!gtk_tree_selection_get_selected(selection, &model, &iter))
+	  return;
 
-     ss = get_server_schema(attach_context, server);
-     if(ss) {
-
-	  server_subtree = GTK_TREE_ITEM_SUBTREE(GTK_TREE_ITEM(item));
-	  if(ss->oc) {
-	       new_item = gtk_tree_item_new_with_label("objectClasses");
-	       GTK_WIDGET_UNSET_FLAGS(new_item, GTK_CAN_FOCUS);
-	       g_signal_connect(new_item, "button_press_event",
-				  G_CALLBACK(schema_button_tree),
-				  GQ_TAB_SCHEMA(tab)->treeroot);
-	       g_signal_connect(new_item, "button_release_event",
-				  G_CALLBACK(schema_button_tree),
-				  GQ_TAB_SCHEMA(tab)->treeroot);
-	       gtk_widget_show(new_item);
-	       gtk_tree_append(GTK_TREE(server_subtree), new_item);
-
-	       new_subtree = gtk_tree_new();
-	       GTK_WIDGET_UNSET_FLAGS(new_subtree, GTK_CAN_FOCUS);
-	       gtk_object_set_data_full(GTK_OBJECT(new_subtree), "server",
-					g_object_ref(server), g_object_unref);
-
-	       gtk_widget_show(new_subtree);
-	       gtk_tree_item_set_subtree(GTK_TREE_ITEM(new_item), new_subtree);
-	       g_signal_connect(new_subtree, "select-child",
-				  G_CALLBACK(fill_oc_detail_rightpane), tab);
-
-	       tmp = ss->oc;
-	       while(tmp) {
-		    oc = (LDAPObjectClass *) tmp->data;
-		    if(oc->oc_names && oc->oc_names[0]) {
-			 for(i = 0; oc->oc_names[i]; i++) {
-			      attach_schema_item(new_subtree, "oc", oc, oc->oc_names[i]);
-			 }
-		    } else {
-			 attach_schema_item(new_subtree, "oc", oc, oc->oc_oid);
-		    }
-		    tmp = tmp->next;
-	       }
+     gtk_tree_model_get(model, &iter,
+			GQ_SCHEMA_MODEL_COL_TYPE, &type,
+			GQ_SCHEMA_MODEL_COL_OBJECT, &object,
+			GQ_SCHEMA_MODEL_COL_SERVER, &server,
+			-1);
+
+     /* servers and categories have nothing to show */
+     if (object) {
+	  switch (type) {
+	  case SCHEMA_TYPE_OC:
+	       fill_oc_detail_rightpane(tab, server, object);
+	       break;
+	  case SCHEMA_TYPE_AT:
+	       fill_at_detail_rightpane(tab, server, object);
+	       break;
+	  case SCHEMA_TYPE_MR:
+	       fill_mr_detail_rightpane(tab, server, object);
+	       break;
+	  case SCHEMA_TYPE_S:
+	       fill_s_detail_rightpane(tab, server, object);
+	       break;
 	  }
+     }
 
-	  if(ss->at) {
-	       new_item = gtk_tree_item_new_with_label("attributeTypes");
-	       GTK_WIDGET_UNSET_FLAGS(new_item, GTK_CAN_FOCUS);
-	       g_signal_connect(new_item, "button_press_event",
-				  G_CALLBACK(schema_button_tree),
-				  GQ_TAB_SCHEMA(tab)->treeroot);
-	       g_signal_connect(new_item, "button_release_event",
-				  G_CALLBACK(schema_button_tree),
-				  GQ_TAB_SCHEMA(tab)->treeroot);
-	       gtk_tree_append(GTK_TREE(server_subtree), new_item);
-	       gtk_widget_show(new_item);
-
-	       new_subtree = gtk_tree_new();
-	       GTK_WIDGET_UNSET_FLAGS(new_subtree, GTK_CAN_FOCUS);
-	       gtk_object_set_data_full(GTK_OBJECT(new_subtree), "server",
-					g_object_ref(server), g_object_unref);
-
-	       gtk_widget_show(new_subtree);
-	       gtk_tree_item_set_subtree(GTK_TREE_ITEM(new_item), new_subtree);
-	       g_signal_connect(new_subtree, "select-child",
-				  G_CALLBACK(fill_at_detail_rightpane), tab);
-
-	       tmp = ss->at;
-	       while(tmp) {
-		    at = (LDAPAttributeType *) tmp->data;
-		    if(at->at_names && at->at_names[0]) {
-			 for(i = 0; at->at_names[i]; i++) {
-			      attach_schema_item(new_subtree, "at", at, at->at_names[i]);
-			 }
-		    } else {
-			 attach_schema_item(new_subtree, "at", at, at->at_oid);
-		    }
-		    tmp = tmp->next;
-	       }
-	  }
+     g_object_unref(server);
+}
 
-	  if(ss->mr) {
-	       new_item = gtk_tree_item_new_with_label("matchingRules");
-	       GTK_WIDGET_UNSET_FLAGS(new_item, GTK_CAN_FOCUS);
-	       g_signal_connect(new_item, "button_press_event",
-				  G_CALLBACK(schema_button_tree),
-				  GQ_TAB_SCHEMA(tab)->treeroot);
-	       g_signal_connect(new_item, "button_release_event",
-				  G_CALLBACK(schema_button_tree),
-				  GQ_TAB_SCHEMA(tab)->treeroot);
-	       gtk_tree_append(GTK_TREE(server_subtree), new_item);
-	       gtk_widget_show(new_item);
-
-	       new_subtree = gtk_tree_new();
-	       GTK_WIDGET_UNSET_FLAGS(new_subtree, GTK_CAN_FOCUS);
-	       gtk_object_set_data_full(GTK_OBJECT(new_subtree), "server",
-					g_object_ref(server), g_object_unref);
-
-	       gtk_widget_show(new_subtree);
-	       gtk_tree_item_set_subtree(GTK_TREE_ITEM(new_item), new_subtree);
-	       g_signal_connect(new_subtree, "select-child",
-				  G_CALLBACK(fill_mr_detail_rightpane), tab);
-
-	       tmp = ss->mr;
-	       while(tmp) {
-		    mr = (LDAPMatchingRule *) tmp->data;
-		    if(mr->mr_names && mr->mr_names[0]) {
-			 for(i = 0; mr->mr_names[i]; i++) {
-			      attach_schema_item(new_subtree, "mr", mr, mr->mr_names[i]);
-			 }
-		    } else {
-			 attach_schema_item(new_subtree, "mr", mr, mr->mr_oid);
-		    }
-		    tmp = tmp->next;
-	       }
-	  }
 
-	  if(ss->s) {
-	       new_item = gtk_tree_item_new_with_label("ldapSyntaxes");
-	       GTK_WIDGET_UNSET_FLAGS(new_item, GTK_CAN_FOCUS);
-	       g_signal_connect(new_item, "button_press_event",
-				  G_CALLBACK(schema_button_tree),
-				  GQ_TAB_SCHEMA(tab)->treeroot);
-	       g_signal_connect(new_item, "button_release_event",
-				  G_CALLBACK(schema_button_tree),
-				  GQ_TAB_SCHEMA(tab)->treeroot);
-	       gtk_tree_append(GTK_TREE(server_subtree), new_item);
-	       gtk_widget_show(new_item);
-
-	       new_subtree = gtk_tree_new();
-	       GTK_WIDGET_UNSET_FLAGS(new_subtree, GTK_CAN_FOCUS);
-	       gtk_object_set_data_full(GTK_OBJECT(new_subtree), "server",
-					g_object_ref(server), g_object_unref);
-
-	       gtk_widget_show(new_subtree);
-	       gtk_tree_item_set_subtree(GTK_TREE_ITEM(new_item), new_subtree);
-	       g_signal_connect(new_subtree, "select-child",
-				  G_CALLBACK(fill_s_detail_rightpane), tab);
-
-	       tmp = ss->s;
-	       while(tmp) {
-		    s = (LDAPSyntax *) tmp->data;
-		    attach_schema_item(new_subtree, "s", s, s->syn_oid);
-		    tmp = tmp->next;
-	       }
-	  }
+struct expanded_row {
+     gint server;
+     gint type;		/* -1 for the server itself */
+};
 
-     }
+static void remember_expanded(GtkTreeView *treeview, GtkTreePath *path,
+			      GArray *expanded)
+{
+     struct expanded_row row;
+     GtkTreeModel *model = gtk_tree_view_get_model(treeview);
+     GtkTreeIter iter;
+
+     gtk_tree_model_get_iter(model, &iter, path);
+     row.server = gtk_tree_path_get_indices(path)[0];
+     gtk_tree_model_get(model, &iter,
+			GQ_SCHEMA_MODEL_COL_TYPE, &row.type,
+			-1);
+     g_array_append_val(expanded, row);
+}
 
-     set_normalcursor();
+static gboolean was_expanded(GArray *expanded, gint server, gint type)
+{
+     guint i;
 
-     error_flush(attach_context);
+     for (i = 0 ; i < expanded->len ; i++) {
+	  struct expanded_row *row = &g_array_index(expanded,
+						    struct expanded_row, i);
+	  if (row->server == server && row->type == type) return TRUE;
+     }
+     return FALSE;
 }
 
+/* Shows the names matching the search text. The servers (and their
+   categories) expanded before stay that way, when searching all those
+   with matches get expanded as well. */
+static gboolean schema_search_timeout(GqTab *tab)
+{
+     GqTabSchema *self = GQ_TAB_SCHEMA(tab);
+     GtkTreeView *view = GTK_TREE_VIEW(self->treeview);
+     GqSchemaModel *model;
+     GtkTreeIter server, category;
+     GtkTreePath *path;
+     GArray *expanded;
+     const gchar *text;
+     gint type;
+
+     self->search_timeout = 0;
+
+     expanded = g_array_new(FALSE, FALSE, sizeof(struct expanded_row));
+     gtk_tree_view_map_expanded_rows(view,
+				     (GtkTreeViewMappingFunc) remember_expanded,
+				     expanded);
+
+     text = gtk_entry_get_text(GTK_ENTRY(self->search_entry));
+     model = gq_schema_model_filter(current_model(tab), text,
+				    gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(self->anywhere_check)));
+     gtk_tree_view_set_model(view, GTK_TREE_MODEL(model));
+     g_object_unref(model);
+
+     if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(model), &server)) {
+	  do {
+	       path = gtk_tree_model_get_path(GTK_TREE_MODEL(model), &server);
+
+	       if (*text && gq_schema_model_is_loaded(model, &server)) {
+		    gtk_tree_view_expand_row(view, path, TRUE);
+	       } else if (was_expanded(expanded,
+				       gtk_tree_path_get_indices(path)[0], -1)) {
+		    gtk_tree_view_expand_row(view, path, FALSE);
+
+		    gtk_tree_path_down(path);
+		    if (gtk_tree_model_iter_children(GTK_TREE_MODEL(model),
+						     &category, &server)) {
+			 do {
+			      gtk_tree_model_get(GTK_TREE_MODEL(model),
+						 &category,
+						 GQ_SCHEMA_MODEL_COL_TYPE, &type,
+						 -1);
+			      if (was_expanded(expanded,
+					       gtk_tree_path_get_indices(path)[0],
+					       type)) {
+				   gtk_tree_view_expand_row(view, path, FALSE);
+			      }
+			      gtk_tree_path_next(path);
+			 } while (gtk_tree_model_iter_next(GTK_TREE_MODEL(model),
+							   &category));
+		    }
+	       }
+
+	       gtk_tree_path_free(path);
+	  } while (gtk_tree_model_iter_next(GTK_TREE_MODEL(model), &server));
+     }
 
-/* more of a macro really, this makes inserting duplicates easier */
-static void attach_schema_item(GtkWidget *tree, const char *type, 
-			       void *schemaobject, char *itemname)
+     g_array_free(expanded, TRUE);
+     return FALSE;
+}
+
+static void schema_search_changed(GtkWidget *widget, GqTab *tab)
 {
-     GtkWidget *new_item;
-
-     new_item = gtk_tree_item_new_with_label(itemname);
-     GTK_WIDGET_UNSET_FLAGS(new_item, GTK_CAN_FOCUS);
-     g_signal_connect(new_item, "button_press_event",
-			G_CALLBACK(schema_button_tree),
-			tree);
-     g_signal_connect(new_item, "button_release_event",
-			G_CALLBACK(schema_button_tree),
-			tree);
-     gtk_object_set_data(GTK_OBJECT(new_item), type, schemaobject);
-     gtk_widget_show(new_item);
-     /* need gtk_tree_insert_sorted() here :-( */
-     gtk_tree_append(GTK_TREE(tree), new_item);
+     GqTabSchema *self = GQ_TAB_SCHEMA(tab);
 
+     /* wait for the next key instead of searching for every one */
+     if (self->search_timeout) {
+	  gtk_timeout_remove(self->search_timeout);
+     }
+     self->search_timeout = gtk_timeout_add(SCHEMA_SEARCH_DELAY,
+					    (GtkFunction) schema_search_timeout,
+					    tab);
 }
 
 
-static gboolean schema_button_tree(GtkWidget *tree_item, GdkEventButton *event,
-				   GtkWidget *root)
+static gboolean schema_button_press(GtkWidget *treeview,
+				    GdkEventButton *event, GqTab *tab)
 {
      GtkWidget *root_menu, *menu, *menu_item;
-
-     if(event->type == GDK_BUTTON_PRESS && event->button == 3) {
-	  g_signal_stop_emission_by_name(tree_item, "button_press_event");
-
+     GtkTreeModel *model;
+     GtkTreePath *path;
+     GtkTreeIter iter;
+     GqServer *server;
+     gpointer object;
+     gint type;
+
+     if (event->type != GDK_BUTTON_PRESS ||
+	 (event->button != 2 && event->button != 3))
+	  return(FALSE);
+
+     if (event->window !=
+	 gtk_tree_view_get_bin_window(GTK_TREE_VIEW(treeview)) ||
+	 !gtk_tree_view_get_path_at_pos(GTK_TREE_VIEW(treeview),
+					event->x, event->y,
+					&path, NULL, NULL, NULL))
+	  return(FALSE);
+
+     model = gtk_tree_view_get_model(GTK_TREE_VIEW(treeview));
+     gtk_tree_model_get_iter(model, &iter, path);
+     gtk_tree_model_get(model, &iter,
+			GQ_SCHEMA_MODEL_COL_TYPE, &type,
+			GQ_SCHEMA_MODEL_COL_OBJECT, &object,
+			GQ_SCHEMA_MODEL_COL_SERVER, &server,
+			-1);
+
+     if (event->button == 2) {
+	  if (object) popup_detail(type, server, object);
+     } else {
 	  root_menu = gtk_menu_item_new_with_label("Root");
 	  gtk_widget_show(root_menu);
 	  menu = gtk_menu_new();
@@ -425,73 +496,54 @@ static gboolean schema_button_tree(GtkWidget *tree_item, GdkEventButton *event,
 
 	  /* Refresh */
 	  menu_item = gtk_menu_item_new_with_label(_("Refresh"));
-	  if(gtk_object_get_data(GTK_OBJECT(tree_item), "server") == NULL)
+	  if (gtk_tree_path_get_depth(path) != 1)
 	       gtk_widget_set_sensitive(menu_item, FALSE);
+	  /* servers are in the same place whatever gets searched for */
+	  gtk_object_set_data_full(GTK_OBJECT(menu_item), "path",
+				   gtk_tree_path_to_string(path), g_free);
 	  gtk_menu_append(GTK_MENU(menu), menu_item);
 	  gtk_widget_show(menu_item);
 	  g_signal_connect(menu_item, "activate",
-			     G_CALLBACK(schema_refresh_server), tree_item);
+			   G_CALLBACK(schema_refresh_server), tab);
 
 	  /* Open in new window */
 	  menu_item = gtk_menu_item_new_with_label(_("Open in new window"));
 	  /* only leaf nodes can have a detail popup */
-	  if(GTK_TREE_ITEM(tree_item)->subtree)
+	  if (object == NULL)
 	       gtk_widget_set_sensitive(menu_item, FALSE);
+	  gtk_object_set_data_full(GTK_OBJECT(menu_item), "server",
+				   g_object_ref(server), g_object_unref);
+	  gtk_object_set_data(GTK_OBJECT(menu_item), "object", object);
+	  gtk_object_set_data(GTK_OBJECT(menu_item), "type",
+			      GINT_TO_POINTER(type));
 	  gtk_menu_append(GTK_MENU(menu), menu_item);
 	  gtk_widget_show(menu_item);
 	  g_signal_connect(menu_item, "activate",
-			     G_CALLBACK(popup_detail_callback), tree_item);
-
+			   G_CALLBACK(popup_detail_callback), tab);
 
 	  gtk_menu_popup(GTK_MENU(menu), NULL, NULL, NULL, NULL,
 			 event->button, event->time);
-
-	  return(TRUE);
-     } else if(event->type == GDK_BUTTON_RELEASE && event->button == 2) {
-	  popup_detail_callback(NULL, tree_item);
-	  return(TRUE);
-	  /* hack, hack, hack */
-     } else if(event->type == GDK_BUTTON_RELEASE && event->button == 1) {
-	  gtk_tree_select_child(GTK_TREE(root), tree_item);
-	  return(TRUE);
      }
 
-     return(FALSE);
+     g_object_unref(server);
+     gtk_tree_path_free(path);
+
+     return(TRUE);
 }
 
 
-static void schema_refresh_server(GtkWidget *widget, GtkWidget *item)
+static void schema_refresh_server(GtkWidget *menu_item, GqTab *tab)
 {
-     GList *sel;
-     GtkTree *tree;
-     GtkWidget *new_subtree;
-     GqServer *server;
-     GqTab *tab;
+     GtkTreeIter iter;
+     const gchar *path;
 
-     if( (server = gtk_object_get_data(GTK_OBJECT(item), "server")) == NULL)
+     path = gtk_object_get_data(GTK_OBJECT(menu_item), "path");
+     if (path == NULL ||
+	 !gtk_tree_model_get_iter_from_string(GTK_TREE_MODEL(current_model(tab)),
+					      &iter, path))
 	  return;
 
-     close_connection(server, TRUE);
-
-     tree = (GtkTree *) GTK_TREE_ITEM(item)->subtree;
-     if(tree) {
-
-	  /* this is a workaround -- lots of GTK warnings if I don't do this :-( */
-	  sel = GTK_TREE_SELECTION_OLD(tree);
-	  while(sel) {
-	       if(sel->data)
-		    gtk_tree_unselect_child(GTK_TREE(tree), sel->data);
-	       sel = sel->next;
-	  }
-
-	  gtk_tree_item_remove_subtree(GTK_TREE_ITEM(item));
-
-	  new_subtree = gtk_tree_new();
-	  gtk_tree_item_set_subtree(GTK_TREE_ITEM(item), new_subtree);
-	  tab = gtk_object_get_data(GTK_OBJECT(item), "tab");
-	  g_signal_connect(item, "expand",
-			     G_CALLBACK(attach_server_schema), tab);
-     }
+     attach_server_schema(tab, &iter, TRUE);
 }
 
 
@@ -560,36 +612,19 @@ static void make_detail_notebook(GqTab *tab)
 }
 
 
-static void popup_detail_callback(GtkWidget *dummy, GtkWidget *widget)
+static void popup_detail_callback(GtkWidget *menu_item, GqTab *tab)
 {
-     LDAPObjectClass *oc;
-     LDAPAttributeType *at;
-     LDAPMatchingRule *mr;
-     LDAPSyntax *s;
      GqServer *server;
+     void *object;
 
-     if( (server = gtk_object_get_data(GTK_OBJECT(widget), "server")) == NULL
-	  && ( (server = gtk_object_get_data(GTK_OBJECT(widget->parent), "server")) == NULL))
-	  return;
-
-     oc = gtk_object_get_data(GTK_OBJECT(widget), "oc");
-     at = gtk_object_get_data(GTK_OBJECT(widget), "at");
-     mr = gtk_object_get_data(GTK_OBJECT(widget), "mr");
-     s = gtk_object_get_data(GTK_OBJECT(widget), "s");
-
-     if(!oc && !at && !mr && !s)
-	  /* how did we get here? */
+     server = gtk_object_get_data(GTK_OBJECT(menu_item), "server");
+     object = gtk_object_get_data(GTK_OBJECT(menu_item), "object");
+     if (server == NULL || object == NULL)
 	  return;
 
-     if(oc)
-	  popup_detail(SCHEMA_TYPE_OC, server, oc);
-     else if(at)
-	  popup_detail(SCHEMA_TYPE_AT, server, at);
-     else if(mr)
-	  popup_detail(SCHEMA_TYPE_MR, server, mr);
-     else if(s)
-	  popup_detail(SCHEMA_TYPE_S, server, s);
-
+     popup_detail(GPOINTER_TO_INT(gtk_object_get_data(GTK_OBJECT(menu_item),
+						      "type")),
+		  server, object);
 }
 
 
@@ -810,17 +845,10 @@ static void make_oc_detail(GtkWidget *target_oc_vbox)
 }
 
 
-static void fill_oc_detail_rightpane(GtkWidget *treeroot, GtkWidget *tree_item, GqTab *tab)
+static void fill_oc_detail_rightpane(GqTab *tab, GqServer *server,
+				     LDAPObjectClass *oc)
 {
      GtkWidget *rightpane_notebook, *oc_vbox;
-     LDAPObjectClass *oc;
-     GqServer *server;
-
-     if( (server = gtk_object_get_data(GTK_OBJECT(treeroot), "server")) == NULL)
-	  return;
-
-     if( (oc = gtk_object_get_data(GTK_OBJECT(tree_item), "oc")) == NULL)
-	  return;
 
      if(GQ_TAB_SCHEMA(tab)->cur_oc == oc)
 	  return;
@@ -1196,20 +1224,12 @@ static void make_at_detail(GtkWidget *target_vbox)
 }
 
 
-static void fill_at_detail_rightpane(GtkWidget *treeroot, GtkWidget *tree_item,
-				     GqTab *tab)
+static void fill_at_detail_rightpane(GqTab *tab, GqServer *server,
+				     LDAPAttributeType *at)
 {
      GtkWidget *rightpane_notebook, *at_vbox;
-     LDAPAttributeType *at;
-     GqServer *server;
      int error_context; 
 
-     if( (server = gtk_object_get_data(GTK_OBJECT(treeroot), "server")) == NULL)
-	  return;
-
-     if( (at = gtk_object_get_data(GTK_OBJECT(tree_item), "at")) == NULL)
-	  return;
-
      if(GQ_TAB_SCHEMA(tab)->cur_at == at)
 	  return;
 
@@ -1342,7 +1362,6 @@ static void fill_at_detail(int error_context, GtkWidget *target_vbox,
 		    list = list->next;
 		    i++;
 	       }
-	       g_list_free(list);
 	  }
      }
      gtk_clist_thaw(GTK_CLIST(clist));
@@ -1478,18 +1497,10 @@ static void make_mr_detail(GtkWidget *target_vbox)
 }
 
 
-static void fill_mr_detail_rightpane(GtkWidget *treeroot, 
-				     GtkWidget *tree_item, GqTab *tab)
+static void fill_mr_detail_rightpane(GqTab *tab, GqServer *server,
+				     LDAPMatchingRule *mr)
 {
      GtkWidget *rightpane_notebook, *mr_vbox;
-     LDAPMatchingRule *mr;
-     GqServer *server;
-
-     if( (server = gtk_object_get_data(GTK_OBJECT(treeroot), "server")) == NULL)
-	  return;
-
-     if( (mr = gtk_object_get_data(GTK_OBJECT(tree_item), "mr")) == NULL)
-	  return;
 
      if(GQ_TAB_SCHEMA(tab)->cur_mr == mr)
 	  return;
@@ -1564,7 +1575,6 @@ static void fill_mr_detail(GtkWidget *target_vbox, GqServer *server,
 	       list = list->next;
 	       i++;
 	  }
-	  g_list_free(list);
      }
 
      gtk_clist_thaw(GTK_CLIST(clist));
@@ -1677,18 +1687,10 @@ static void make_s_detail(GtkWidget *target_vbox)
 }
 
 
-static void fill_s_detail_rightpane(GtkWidget *treeroot, GtkWidget *tree_item,
-				    GqTab *tab)
+static void fill_s_detail_rightpane(GqTab *tab, GqServer *server,
+				    LDAPSyntax *s)
 {
      GtkWidget *rightpane_notebook, *s_vbox;
-     LDAPSyntax *s;
-     GqServer *server;
-
-     if( (server = gtk_object_get_data(GTK_OBJECT(treeroot), "server")) == NULL)
-	  return;
-
-     if( (s = gtk_object_get_data(GTK_OBJECT(tree_item), "s")) == NULL)
-	  return;
 
      if(GQ_TAB_SCHEMA(tab)->cur_s == s)
 	  return;
@@ -1744,7 +1746,6 @@ static void fill_s_detail(GtkWidget *target_vbox, GqServer *server,
 	       i++;
 	       list = list->next;
 	  }
-	  g_list_free(list);
      }
      gtk_clist_thaw(GTK_CLIST(clist));
 
@@ -1766,7 +1767,6 @@ static void fill_s_detail(GtkWidget *target_vbox, GqServer *server,
 	       i++;
 	       list = list->next;
 	  }
-	  g_list_free(list);
      }
      gtk_clist_thaw(GTK_CLIST(clist));
 
@@ -1776,13 +1776,10 @@ static void fill_s_detail(GtkWidget *target_vbox, GqServer *server,
 void select_oc_from_clist(GtkWidget *clist, gint row, gint column,
 			  GdkEventButton *event, gpointer data)
 {
-     GList *list;
      LDAPObjectClass *oc;
      GqServer *server;
      char *ocname;
 
-     oc = NULL;
-
      /* double click or single middle button click */
      if( (event->type == GDK_BUTTON_RELEASE && event->button == 2) ||
 	 (event->type == GDK_2BUTTON_PRESS && event->button == 1)) {
@@ -1790,20 +1787,10 @@ void select_oc_from_clist(GtkWidget *clist, gint row, gint column,
 	  if( (server = gtk_object_get_data(GTK_OBJECT(clist), "server")) == NULL)
 	       return;
 
-	  if(server->ss == NULL || server->ss->oc == NULL)
-	       return;
-
 	  gtk_clist_get_text(GTK_CLIST(clist), row, column, &ocname);
-	  list = server->ss->oc;
-	  while(list) {
-	       oc = list->data;
-	       if(oc && oc->oc_names && oc->oc_names[0] &&
-		  !strcasecmp(oc->oc_names[0], ocname))
-		    break;
-	       list = list->next;
-	  }
+	  oc = find_oc_by_oc_name(server->ss, ocname);
 
-	  if(list && oc)
+	  if(oc)
 	       popup_detail(SCHEMA_TYPE_OC, server, oc);
 
      }
@@ -1814,40 +1801,22 @@ void select_oc_from_clist(GtkWidget *clist, gint row, gint column,
 void select_at_from_clist(GtkWidget *clist, gint row, gint column,
 			  GdkEventButton *event, gpointer data)
 {
-     GList *list;
      LDAPAttributeType *at;
      GqServer *server;
      char *attrname;
 
-     at = NULL;
-
      /* double click or single middle button click */
      if( (event->type == GDK_BUTTON_RELEASE && event->button == 2) ||
 	 (event->type == GDK_2BUTTON_PRESS && event->button == 1)) {
-	  gint i;
 
 	  if( (server = gtk_object_get_data(GTK_OBJECT(clist), "server")) == NULL) {
 	       return;
 	  }
 
-	  if(server->ss == NULL || server->ss->at == NULL) {
-	       return;
-	  }
-
 	  gtk_clist_get_text(GTK_CLIST(clist), row, column, &attrname);
-	  for(list = server->ss->at; list; list = list->next) {
-	       at = list->data;
-	       //g_return_val_if_fail(at && at->at_names); // FIXME: we should require this
-	       for(i=0; at && at->at_names && at->at_names[i]; i++) {
-	            if(!strcasecmp(at->at_names[i], attrname))
-		         break; // the for loop
-	       }
-	       if(at && at->at_names && at->at_names[i]) { // at_names[i] == NULL after the for loop
-		       break; // the while loop
-	       }
-	  }
+	  at = find_canonical_at_by_at(server->ss, attrname);
 
-	  if(list && at)
+	  if(at)
 	       popup_detail(SCHEMA_TYPE_AT, server, at);
 
      }
@@ -1858,13 +1827,10 @@ void select_at_from_clist(GtkWidget *clist, gint row, gint column,
 void select_mr_from_clist(GtkWidget *clist, gint row, gint column,
 			  GdkEventButton *event, gpointer data)
 {
-     GList *list;
      LDAPMatchingRule *mr;
      GqServer *server;
      char *mrname;
 
-     mr = NULL;
-
      /* double click or single middle button click */
      if( (event->type == GDK_BUTTON_RELEASE && event->button == 2) ||
 	 (event->type == GDK_2BUTTON_PRESS && event->button == 1)) {
@@ -1872,20 +1838,10 @@ void select_mr_from_clist(GtkWidget *clist, gint row, gint column,
 	  if( (server = gtk_object_get_data(GTK_OBJECT(clist), "server")) == NULL)
 	       return;
 
-	  if(server->ss == NULL || server->ss->mr == NULL)
-	       return;
-
 	  gtk_clist_get_text(GTK_CLIST(clist), row, column, &mrname);
-	  list = server->ss->mr;
-	  while(list) {
-	       mr = list->data;
-	       if(mr && mr->mr_names && mr->mr_names[0] &&
-		  !strcasecmp(mr->mr_names[0], mrname))
-		    break;
-	       list = list->next;
-	  }
+	  mr = find_mr_by_mr_name(server->ss, mrname);
 
-	  if(list && mr)
+	  if(mr)
 	       popup_detail(SCHEMA_TYPE_MR, server, mr);
 
      }
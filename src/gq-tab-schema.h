@@ -31,6 +31,7 @@
 
 #include "common.h"
 #include "gq-tab.h"  /* GqTab */
+#include "schema.h"  /* enum schema_detail_type */
 
 G_BEGIN_DECLS
 
@@ -45,7 +46,10 @@ GType gq_tab_schema_get_type(void);
 struct _GqTabSchema {
 	GqTab base_instance;
 
-	GtkWidget *treeroot;
+	GtkWidget *treeview;		/* over a GqSchemaModel */
+	GtkWidget *search_entry;
+	GtkWidget *anywhere_check;
+	guint search_timeout;
 	GtkWidget *rightpane_vbox;
 	GtkWidget *rightpane_notebook;
 	GtkWidget *oc_vbox;
@@ -58,13 +62,6 @@ struct _GqTabSchema {
 	LDAPSyntax *cur_s;
 };
 
-enum schema_detail_type {
-     SCHEMA_TYPE_OC,
-     SCHEMA_TYPE_AT,
-     SCHEMA_TYPE_MR,
-     SCHEMA_TYPE_S
-};
-
 
 GqTab *new_schemamode();
 void popup_detail(enum schema_detail_type type, GqServer *server, void *detail);
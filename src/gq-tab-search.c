@@ -39,7 +39,13 @@
 #include "configfile.h"
 #include "errorchain.h"
 #include "gq-constants.h"
+#include "gq-ldap-filter.h"
+#include "gq-mass-modify.h"
+#include "gq-progress.h"
+#include "gq-result-sort.h"
+#include "gq-search-engine.h"
 #include "gq-server-list.h"
+#include "gq-server-probe.h"
 #include "gq-tab-browse.h"
 #include "mainwin.h"
 #include "util.h"
@@ -56,12 +62,17 @@
 
 #define MAX_NUM_ATTRIBUTES		256
 
+/* pseudo attribute holding the server column of searches on all
+   servers, no real attribute name can look like this */
+#define SERVER_COLUMN			"[server]"
+
 static void find_in_browser(GqTab *tab);
 static void add_all_to_browser(GqTab *tab);
 static void add_selected_to_browser(GqTab *tab);
 static void export_search_selected_entry(GqTab *tab);
 static void delete_search_selected(GqTab *tab);
 static void query(GqTab *tab);
+static void refine(GqTab *tab);
 
 static int column_by_attr(struct attrs **attrlist, const char *attribute);
 static int new_attr(struct attrs **attrlist, const char *attr);
@@ -71,12 +82,15 @@ static gint searchbase_button_clicked(GtkWidget *widget,
 				      GdkEventButton *event,
 				      GqTab *tab);
 static void findbutton_clicked_callback(GqTab *tab);
+static void refinebutton_clicked_callback(GqTab *tab);
 
 static gboolean search_button_press_on_tree_item(GtkWidget *clist,
 						 GdkEventButton *event,
 						 GqTab *tab);
 
 static void servername_changed_callback(GqTab *tab);
+static void all_servers_toggled_callback(GqTab *tab);
+static void server_group_clicked_callback(GqTab *tab);
 static int select_entry_callback(GtkWidget *clist, gint row, gint column,
 				 GdkEventButton *event, GqTab *tab);
 static void search_edit_entry_callback(GqTab *tab);
@@ -98,6 +112,7 @@ static void search_save_snapshot(int error_context,
      state_value_set_int(state_name, "chase", GQ_TAB_SEARCH(tab)->chase_ref);
      state_value_set_int(state_name, "max-depth", GQ_TAB_SEARCH(tab)->max_depth);
      state_value_set_int(state_name, "scope", GQ_TAB_SEARCH(tab)->scope);
+     state_value_set_int(state_name, "keep-all", GQ_TAB_SEARCH(tab)->keep_all);
 
      state_value_set_int(state_name, "last-options-tab",
 			 GQ_TAB_SEARCH(tab)->last_options_tab);
@@ -105,6 +120,9 @@ static void search_save_snapshot(int error_context,
      tmp =  gtk_editable_get_chars(GTK_EDITABLE(GTK_COMBO(GQ_TAB_SEARCH(tab)->serverlist_combo)->entry), 0, -1);
      state_value_set_string(state_name, "lastserver", tmp);
      g_free(tmp);
+     state_value_set_int(state_name, "all-servers", search_all_servers(tab));
+     state_value_set_list(state_name, "server-group",
+			  GQ_TAB_SEARCH(tab)->server_group);
 }
 
 static void
@@ -139,6 +157,12 @@ static void search_restore_snapshot(int error_context,
 	  };
 	  gq_server_list_foreach(gq_server_list_get(), search_restore_selection, i_tab_and_servername);
      }
+     GQ_TAB_SEARCH(tab)->server_group =
+	  free_list_of_strings(GQ_TAB_SEARCH(tab)->server_group);
+     GQ_TAB_SEARCH(tab)->server_group =
+	  copy_list_of_strings(state_value_get_list(state_name,
+						    "server-group"));
+     search_set_all_servers(tab, state_value_get_int(state_name, "all-servers", 0));
 
      if (config->restore_search_history) {
 	  const GList *hist = state_value_get_list(state_name, "history");
@@ -163,6 +187,8 @@ static void search_restore_snapshot(int error_context,
 	       state_value_get_int(state_name, "max-depth", 7);
 	  GQ_TAB_SEARCH(tab)->scope = 
 	       state_value_get_int(state_name, "scope", LDAP_SCOPE_SUBTREE);
+	  GQ_TAB_SEARCH(tab)->keep_all = 
+	       state_value_get_int(state_name, "keep-all", 0);
 
 	  GQ_TAB_SEARCH(tab)->attrs = free_list_of_strings(GQ_TAB_SEARCH(tab)->attrs);
 	  GQ_TAB_SEARCH(tab)->attrs = 
@@ -190,6 +216,7 @@ struct so_windata {
      GtkWidget *subtree;
      GtkWidget *max;
      GtkWidget *list;
+     GtkWidget *keep_all;
 
      GqTab *tab;
      GqServer *server;
@@ -227,6 +254,9 @@ static void so_okbutton_clicked(GtkWidget *w, struct so_windata *so)
 	  GQ_TAB_SEARCH(tab)->scope = LDAP_SCOPE_SUBTREE;
      }
 
+     GQ_TAB_SEARCH(tab)->keep_all =
+	  gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(so->keep_all));
+
      GQ_TAB_SEARCH(tab)->attrs = free_list_of_strings(GQ_TAB_SEARCH(tab)->attrs);
 
      for( I = GTK_CLIST(so->list)->selection ; I ; I = g_list_next(I) ) {
@@ -246,6 +276,7 @@ static void so_okbutton_clicked(GtkWidget *w, struct so_windata *so)
      state_value_set_int(lastoptions, "max-depth", GQ_TAB_SEARCH(tab)->max_depth);
      state_value_set_int(lastoptions, "scope", GQ_TAB_SEARCH(tab)->scope);
      state_value_set_list(lastoptions, "attributes", GQ_TAB_SEARCH(tab)->attrs);
+     state_value_set_int(lastoptions, "keep-all", GQ_TAB_SEARCH(tab)->keep_all);
 
      state_value_set_int(lastoptions, "last-options-tab", 
 			 GQ_TAB_SEARCH(tab)->last_options_tab);
@@ -677,10 +708,45 @@ static void create_search_options_window(GqTab *tab)
 		    }
 	       }
 	  }
+
+	  /* keep attributes chosen earlier, maybe from the schema of
+	     another server, as with all servers searched no single
+	     schema lists every one */
+	  {
+	       GList *I;
+	       char *t[2] = { NULL, NULL };
+	       int row, rows = GTK_CLIST(list)->rows;
+
+	       for (I = GQ_TAB_SEARCH(tab)->attrs ; I ; I = g_list_next(I)) {
+		    char *have;
+		    for (row = 0 ; row < rows ; row++) {
+			 gtk_clist_get_text(GTK_CLIST(list), row, 0, &have);
+			 if (strcasecmp(have, I->data) == 0) break;
+		    }
+		    if (row == rows) {
+			 t[0] = I->data;
+			 row = gtk_clist_append(GTK_CLIST(list), t);
+			 gtk_clist_select_row(GTK_CLIST(list), row, 0);
+		    }
+	       }
+	  }
+
 	  opt = gtk_clist_optimal_column_width(GTK_CLIST(list), 0);
 	  gtk_clist_set_column_width(GTK_CLIST(list), 0, opt);
      }
 
+     so->keep_all = w =
+	  gq_check_button_new_with_label(_("_Keep all attributes for exporting"));
+     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(w),
+				  GQ_TAB_SEARCH(tab)->keep_all);
+     gtk_box_pack_start(GTK_BOX(vbox1), w, FALSE, FALSE, 5);
+     gtk_widget_show(w);
+
+     gtk_tooltips_set_tip(tips, w,
+			  _("Fetch all attributes of the entries found, not only the ones to show. Exporting the results then needs no further searches."),
+			  Q_("tooltip|")
+			  );
+
      /* Global Buttons */
 
      bbox = gtk_hbutton_box_new();
@@ -723,7 +789,8 @@ GqTab *new_searchmode()
 {
      GtkWidget *main_clist, *searchmode_vbox, *hbox1, *scrwin;
      GtkWidget *searchcombo, *servcombo, *searchbase_combo;
-     GtkWidget *findbutton, *optbutton;
+     GtkWidget *findbutton, *refinebutton, *optbutton;
+     GtkTooltips *tips;
      GList *searchhist;
      GqTabSearch *modeinfo;
      GqTab *tab = g_object_new(GQ_TYPE_TAB_SEARCH, NULL);
@@ -737,6 +804,7 @@ GqTab *new_searchmode()
 					       LDAP_SCOPE_SUBTREE);
      modeinfo->chase_ref = state_value_get_int(lastoptions, "chase", 1);
      modeinfo->max_depth = state_value_get_int(lastoptions, "max-depth", 7);
+     modeinfo->keep_all  = state_value_get_int(lastoptions, "keep-all", 0);
      modeinfo->last_options_tab =
 	  state_value_get_int(lastoptions, "last-options-tab", 0);
 
@@ -788,6 +856,35 @@ GqTab *new_searchmode()
      gtk_widget_show(servcombo);
      modeinfo->serverlist_combo = servcombo;
 
+     /* several servers, a toggle of its own: server names can be
+	anything */
+     tips = gtk_tooltips_new();
+     modeinfo->all_servers_button =
+	  gq_check_button_new_with_label(_("Se_veral servers"));
+     gtk_box_pack_start(GTK_BOX(hbox1), modeinfo->all_servers_button,
+			FALSE, TRUE, SEARCHBOX_PADDING);
+     g_signal_connect_swapped(modeinfo->all_servers_button, "toggled",
+			      G_CALLBACK(all_servers_toggled_callback),
+			      tab);
+     gtk_tooltips_set_tip(tips, modeinfo->all_servers_button,
+			  _("Search the chosen servers (all configured ones if none were chosen) at once. With an empty search base each one searches below its own base DN."),
+			  Q_("tooltip|")
+			  );
+     gtk_widget_show(modeinfo->all_servers_button);
+
+     modeinfo->server_group_button = gq_button_new_with_label(_("Ser_vers..."));
+     gtk_box_pack_start(GTK_BOX(hbox1), modeinfo->server_group_button,
+			FALSE, TRUE, SEARCHBOX_PADDING);
+     g_signal_connect_swapped(modeinfo->server_group_button, "clicked",
+			      G_CALLBACK(server_group_clicked_callback),
+			      tab);
+     gtk_tooltips_set_tip(tips, modeinfo->server_group_button,
+			  _("Choose the servers to search together"),
+			  Q_("tooltip|")
+			  );
+     gtk_widget_set_sensitive(modeinfo->server_group_button, FALSE);
+     gtk_widget_show(modeinfo->server_group_button);
+
      /* search base combo box */
      searchbase_combo = gtk_combo_new();
 
@@ -820,6 +917,22 @@ GqTab *new_searchmode()
 			       G_CALLBACK(findbutton_clicked_callback),
 			       tab);
 
+     /* refine button */
+     refinebutton = gq_button_new_with_label(_("_Refine"));
+#ifdef OLD_FOCUS_HANDLING
+     GTK_WIDGET_UNSET_FLAGS(refinebutton, GTK_CAN_FOCUS);
+#endif
+     gtk_widget_show(refinebutton);
+     gtk_box_pack_start(GTK_BOX(hbox1), refinebutton, 
+			FALSE, TRUE, SEARCHBOX_PADDING);
+     gtk_container_border_width(GTK_CONTAINER (refinebutton), 0);
+     g_signal_connect_swapped(refinebutton, "clicked",
+			       G_CALLBACK(refinebutton_clicked_callback),
+			       tab);
+     gtk_tooltips_set_tip(tips, refinebutton,
+			  _("Applies the filter to the results of the last search, without asking the server again."),
+			  Q_("tooltip|"));
+
      /* Options button */
      optbutton = gq_button_new_with_label(_("_Options"));
 #ifdef OLD_FOCUS_HANDLING
@@ -869,6 +982,9 @@ static void servername_changed_callback(GqTab *tab)
      GqServer *cur_server;
      char *cur_servername;
 
+     /* the combo is out of play while searching all servers */
+     if (search_all_servers(tab)) return;
+
      servcombo = GQ_TAB_SEARCH(tab)->serverlist_combo;
      cur_servername = gtk_editable_get_chars(GTK_EDITABLE(GTK_COMBO(servcombo)->entry), 0, -1);
      cur_server = gq_server_list_get_by_name(gq_server_list_get(), cur_servername);
@@ -887,6 +1003,147 @@ static void servername_changed_callback(GqTab *tab)
 
 }
 
+gboolean search_all_servers(GqTab *tab)
+{
+     GtkWidget *button = GQ_TAB_SEARCH(tab)->all_servers_button;
+
+     return button &&
+	  gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+}
+
+void search_set_all_servers(GqTab *tab, gboolean all)
+{
+     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(GQ_TAB_SEARCH(tab)->all_servers_button),
+				  all);
+}
+
+static void all_servers_toggled_callback(GqTab *tab)
+{
+     gboolean all = search_all_servers(tab);
+
+     gtk_widget_set_sensitive(GQ_TAB_SEARCH(tab)->serverlist_combo, !all);
+     gtk_widget_set_sensitive(GQ_TAB_SEARCH(tab)->server_group_button, all);
+
+     if (all) {
+	  /* every server searches below its own base DN unless told
+	     otherwise */
+	  GQ_TAB_SEARCH(tab)->populated_searchbase = 0;
+	  gtk_entry_set_text(GTK_ENTRY(GTK_COMBO(GQ_TAB_SEARCH(tab)->searchbase_combo)->entry), "");
+     } else {
+	  servername_changed_callback(tab);
+     }
+}
+
+/* whether server gets searched when searching several servers */
+static gboolean in_server_group(GqTab *tab, GqServer *server)
+{
+     GList *group = GQ_TAB_SEARCH(tab)->server_group;
+
+     return group == NULL ||
+	  g_list_find_custom(group, server->name, (GCompareFunc) strcmp);
+}
+
+static void add_group_server(GQServerList *list, GqServer *server,
+			     gpointer user_data)
+{
+     gpointer *tab_and_servers = user_data;
+     GList **servers = tab_and_servers[1];
+
+     if (in_server_group(tab_and_servers[0], server)) {
+	  *servers = g_list_append(*servers, server);
+     }
+}
+
+/* the configured servers searching several servers goes to, in the
+   order of the server list. g_list_free the result. */
+static GList *group_servers(GqTab *tab)
+{
+     GList *servers = NULL;
+     gpointer tab_and_servers[2] = { tab, &servers };
+
+     gq_server_list_foreach(gq_server_list_get(), add_group_server,
+			    tab_and_servers);
+     return servers;
+}
+
+static void add_group_choice(GQServerList *list, GqServer *server,
+			     gpointer user_data)
+{
+     gpointer *tab_and_box = user_data;
+     GtkWidget *button;
+
+     button = gtk_check_button_new_with_label(server->name);
+     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button),
+				  GQ_TAB_SEARCH(tab_and_box[0])->server_group &&
+				  in_server_group(tab_and_box[0], server));
+     gtk_object_set_data(GTK_OBJECT(button), "server", server);
+     gtk_box_pack_start(GTK_BOX(tab_and_box[1]), button, FALSE, FALSE, 0);
+     gtk_widget_show(button);
+}
+
+/* lets the user pick the servers to search together, none picked
+   means all of them */
+static void server_group_clicked_callback(GqTab *tab)
+{
+     GtkWidget *dialog, *scrwin, *vbox, *label;
+     gpointer tab_and_box[2];
+     GList *children, *I, *group = NULL;
+
+     dialog = gtk_dialog_new_with_buttons(_("Servers to search"),
+					  GTK_WINDOW(tab->win->mainwin),
+					  GTK_DIALOG_MODAL |
+					  GTK_DIALOG_DESTROY_WITH_PARENT,
+					  GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+					  GTK_STOCK_OK, GTK_RESPONSE_OK,
+					  NULL);
+     gtk_window_set_default_size(GTK_WINDOW(dialog), 300, 360);
+
+     label = gtk_label_new(_("Search these servers together. With none chosen, every configured server gets searched."));
+     gtk_label_set_line_wrap(GTK_LABEL(label), TRUE);
+     gtk_misc_set_alignment(GTK_MISC(label), 0, 0.5);
+     gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), label,
+			FALSE, FALSE, CONTAINER_BORDER_WIDTH);
+     gtk_widget_show(label);
+
+     scrwin = gtk_scrolled_window_new(NULL, NULL);
+     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrwin),
+				    GTK_POLICY_AUTOMATIC,
+				    GTK_POLICY_AUTOMATIC);
+     gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), scrwin,
+			TRUE, TRUE, 0);
+     gtk_widget_show(scrwin);
+
+     vbox = gtk_vbox_new(FALSE, 0);
+     gtk_container_set_border_width(GTK_CONTAINER(vbox),
+				    CONTAINER_BORDER_WIDTH);
+     gtk_scrolled_window_add_with_viewport(GTK_SCROLLED_WINDOW(scrwin), vbox);
+     gtk_widget_show(vbox);
+
+     tab_and_box[0] = tab;
+     tab_and_box[1] = vbox;
+     gq_server_list_foreach(gq_server_list_get(), add_group_choice,
+			    tab_and_box);
+
+     /* the dialog runs the main loop */
+     g_object_ref(tab);
+     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_OK) {
+	  children = gtk_container_get_children(GTK_CONTAINER(vbox));
+	  for (I = children ; I ; I = I->next) {
+	       GqServer *server = gtk_object_get_data(GTK_OBJECT(I->data),
+						      "server");
+	       if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(I->data))) {
+		    group = g_list_append(group, g_strdup(server->name));
+	       }
+	  }
+	  g_list_free(children);
+
+	  free_list_of_strings(GQ_TAB_SEARCH(tab)->server_group);
+	  GQ_TAB_SEARCH(tab)->server_group = group;
+     }
+     gtk_widget_destroy(dialog);
+     g_object_unref(tab);
+}
+
 
 static gint searchbase_button_clicked(GtkWidget *widget, 
 				      GdkEventButton *event, GqTab *tab)
@@ -901,6 +1158,9 @@ static gint searchbase_button_clicked(GtkWidget *widget,
 
      found_default_searchbase = 0;
 
+     /* the suffixes of one server are no help for all of them */
+     if (search_all_servers(tab)) return(FALSE);
+
      if (!GQ_TAB_SEARCH(tab)->populated_searchbase && event->button == 1) {
 	  servcombo = GQ_TAB_SEARCH(tab)->serverlist_combo;
 	  cur_servername = gtk_editable_get_chars(GTK_EDITABLE(GTK_COMBO(servcombo)->entry), 0, -1);
@@ -961,6 +1221,17 @@ void findbutton_clicked_callback(GqTab *tab)
 
 }
 
+static void refinebutton_clicked_callback(GqTab *tab)
+{
+     GtkWidget *focusbox;
+
+     refine(tab);
+
+     focusbox = tab->focus;
+     gtk_widget_grab_focus(focusbox);
+     gtk_editable_select_region(GTK_EDITABLE(focusbox), 0, -1);
+}
+
 static int column_by_attr(struct attrs **attrlist, const char *attribute)
 {
      struct attrs *attr;
@@ -1031,47 +1302,6 @@ free_attrlist(struct attrs *attrlist)
 }
 
 
-char *make_filter(GqServer *server, char *querystring)
-{
-     char *filter = NULL;
-     int l = strlen(querystring);
-
-     if(querystring[0] == '(') {  /* UTF-8 OK */
-	  filter = g_strdup(querystring);
-     }
-     else if(g_utf8_strchr(querystring, -1, '=')) {
-	  l += 3;
-	  filter = g_malloc(l);
-	  g_snprintf(filter, l, "(%s)", querystring);
-     }
-     else {
-	  int sl = strlen(server->searchattr);
-	  l += sl + 10;
-	  filter = g_malloc(l + 1);
-
-	  switch(config->search_argument) {
-	  case SEARCHARG_BEGINS_WITH:
-	       g_snprintf(filter, l, "(%s=%s*)", server->searchattr, querystring);
-	       break;
-	  case SEARCHARG_ENDS_WITH:
-	       g_snprintf(filter, l, "(%s=*%s)", server->searchattr, querystring);
-	       break;
-	  case SEARCHARG_CONTAINS:
-	       g_snprintf(filter, l, "(%s=*%s*)", server->searchattr, querystring);
-	       break;
-	  case SEARCHARG_EQUALS:
-	       g_snprintf(filter, l, "(%s=%s)", server->searchattr, querystring);
-	       break;
-	  default:
-	       filter[0] = 0;
-	       break;
-	  };
-     }
-
-     return(filter);
-}
-
-
 static void add_to_search_history(GqTab *tab)
 {
      gchar *searchterm;
@@ -1102,22 +1332,74 @@ static void add_to_search_history(GqTab *tab)
 
 }
 
+/* everything the results of all running searches go to */
+struct query_output {
+     GtkWidget *clist;
+     GString *tolist[MAX_NUM_ATTRIBUTES];
+     int columns_done[MAX_NUM_ATTRIBUTES];
+     struct attrs *attrlist;
+     int server_col;		/* -1 unless searching several servers */
+     int row;
+     GqResultStore *store;
+     GqResultSort *keys;	/* belongs to the clist */
+     gchar **shown;		/* attributes to show, NULL for all */
+     GqProgress *progress;	/* NULL when refining */
+};
+
+/* makes column sort the way the values of attr do, see
+   GqSortNumberFunc */
+static void set_sort_column(GqResultSort *keys, int column,
+			    int query_context, GqServer *server,
+			    const char *attr)
+{
+     GType type = get_dt_handler(get_display_type_of_attr(query_context,
+							  server, attr));
+     GQTypeDisplayClass *klass;
+
+     if (!type || G_TYPE_IS_ABSTRACT(type)) {
+	  gq_result_sort_set_column(keys, column, NULL, NULL);
+	  return;
+     }
+
+     klass = g_type_class_ref(type);
+     gq_result_sort_set_column(keys, column,
+			       klass->sort_number, klass->sort_integer);
+     g_type_class_unref(klass);
+}
+
+/* TRUE if attr, without its options, is one of the shown ones */
+static gboolean is_shown(gchar **shown, const char *attr)
+{
+     size_t l = strcspn(attr, ";");
+
+     if (shown == NULL) return TRUE;
+
+     for ( ; *shown ; shown++) {
+	  if (g_ascii_strncasecmp(*shown, attr, l) == 0 &&
+	      ((*shown)[l] == 0 || (*shown)[l] == ';')) {
+	       return TRUE;
+	  }
+     }
+     return FALSE;
+}
+
+/* puts an entry of the result store into the result list */
 static int fill_one_row(int query_context,
-			GqServer *server,
-			LDAP *ld, LDAPMessage *e,
-			GtkWidget *clist,
-			GString **tolist,
-			int *columns_done,
-			struct attrs *attrlist,
-			GqTab *tab)
+			GqResultEntry *entry,
+			struct query_output *out)
 {
-     BerElement *berptr;
+     GqServer *server = entry->set.server;
+     GtkWidget *clist = out->clist;
+     GString **tolist = out->tolist;
+     int *columns_done = out->columns_done;
+     int server_col = out->server_col;
+     GqResultSort *keys = out->keys;
+     GqResultAttr *a;
      int i;
+     guint j;
      gchar *cl[MAX_NUM_ATTRIBUTES];
      int cur_col;
      int row;
-     char *dn, *attr, **vals;
-     struct dn_on_server *set;
 
      /* not every attribute necessarily comes back for
       * every entry, so clear this every time */
@@ -1126,36 +1408,33 @@ static int fill_one_row(int query_context,
 	  g_string_truncate(tolist[i], 0);
      }
      
-     dn = ldap_get_dn(ld, e);
-     /* store for later reference */
-     set = new_dn_on_server(dn, server);
-
      if(config->showdn) {
-	  g_string_append(tolist[0], dn);
+	  g_string_append(tolist[0], entry->set.dn);
 	  cl[0] = tolist[0]->str;
+	  gq_result_sort_add(keys, entry->index, 0, cl[0], NULL);
+     }
+
+     if(server_col >= 0) {
+	  g_string_assign(tolist[server_col], server->name);
+	  cl[server_col] = tolist[server_col]->str;
+	  gq_result_sort_add(keys, entry->index, server_col,
+			     cl[server_col], NULL);
      }
-#if defined(HAVE_LDAP_MEMFREE)
-     ldap_memfree(dn);
-#else
-     free(dn);
-#endif
      
-     for(attr = ldap_first_attribute(ld, e, &berptr); attr != NULL;
-	 attr = ldap_next_attribute(ld, e, berptr)) {
-	  if (!show_in_search(query_context, server, attr)) {
-	       ldap_memfree(attr);
+     for(a = entry->attrs ; a < entry->attrs + entry->n_attrs ; a++) {
+	  if (!is_shown(out->shown, a->name) ||
+	      !show_in_search(query_context, server, a->name)) {
 	       continue;
 	  }
 	  
 	  /* This should now work for ;binary as well */
-	  cur_col = column_by_attr(&attrlist, attr);
+	  cur_col = column_by_attr(&out->attrlist, a->name);
 	  if(cur_col == MAX_NUM_ATTRIBUTES) {
-	       ldap_memfree(attr);
 	       break;
 	  }
 
 	  if(!columns_done[cur_col]) {
-	       char *c = attr_strip(attr);
+	       char *c = attr_strip(a->name);
 	       gtk_clist_set_column_title(GTK_CLIST(clist), cur_col, c);
 	       /* setting the width somehow causes my gtk2 to not show
 		  the title correctly - BUG */
@@ -1163,33 +1442,30 @@ static int fill_one_row(int query_context,
 	       gtk_clist_set_column_resizeable(GTK_CLIST(clist), cur_col,
 					       TRUE);
 	       if (c) g_free(c);
+	       set_sort_column(keys, cur_col, query_context, server,
+			       a->name);
 	       columns_done[cur_col] = 1;
 	  }
 	  
-	  vals = ldap_get_values(ld, e, attr);
-	  if(vals) {
-	       for(i = 0; vals[i] != NULL; i++) {
-		    if(i == 0) {
-			 g_string_assign(tolist[cur_col], vals[i]);
-		    } else {
+	  if(a->n_values) {
+	       for(j = 0; j < a->n_values; j++) {
+		    if(j > 0) {
 			 g_string_append(tolist[cur_col], " ");
-			 g_string_append(tolist[cur_col], vals[i]);
 		    }
+		    g_string_append_len(tolist[cur_col],
+					a->values[j].bv_val,
+					a->values[j].bv_len);
 	       }
-	       ldap_value_free(vals);
-	       if (g_utf8_validate(tolist[cur_col]->str, -1, NULL)) {
+	       if (g_utf8_validate(tolist[cur_col]->str,
+				   tolist[cur_col]->len, NULL)) {
 		    cl[cur_col] = tolist[cur_col]->str;
 	       } else {
 		    cl[cur_col] = "";
 	       }
+	       gq_result_sort_add(keys, entry->index, cur_col,
+				  cl[cur_col], a->values[0].bv_val);
 	  }
-	  ldap_memfree(attr);
      }
-#ifndef HAVE_OPENLDAP12
-     if(berptr)
-	  ber_free(berptr, 0);
-#endif
-
 
      for(i = MAX_NUM_ATTRIBUTES ; i >= 0 ; i--) {
 	  if (cl[i]) {
@@ -1202,10 +1478,10 @@ static int fill_one_row(int query_context,
 	  }
      }
      
-     /* insert row into result window */
+     /* insert row into result window, the entry belongs to the
+	result store */
      row = gtk_clist_append(GTK_CLIST(clist), cl);
-     gtk_clist_set_row_data_full(GTK_CLIST(clist), row, set, 
-				 (GtkDestroyNotify) free_dn_on_server);
+     gtk_clist_set_row_data(GTK_CLIST(clist), row, &entry->set);
 
      gtk_clist_column_titles_show(GTK_CLIST(clist));
 
@@ -1213,96 +1489,10 @@ static int fill_one_row(int query_context,
 }
 
 
-struct chasing {
-     GqServer *server;
-     char *base;
-};
-
-static struct chasing *new_chasing(GqServer *server,
-				   const char *base)
-{
-	struct chasing *n = g_malloc0(sizeof(struct chasing));
-	n->base = g_strdup(base);
-	if(server) {
-		n->server = g_object_ref(server);
-	} else {
-		n->server = NULL;
-	}
-	return n;
-}
-
-static void
-free_chasing(struct chasing *ch)
-{
-	if(ch->server) {
-		g_object_unref(ch->server);
-		ch->server = NULL;
-	}
-	g_free(ch->base);
-	g_free(ch);
-}
-
-
-static void add_referral(int error_context, 
-			 GqServer *server, 
-			 const char *referral, GList **nextlevel) 
-{
-     LDAPURLDesc *desc = NULL;
-
-     if (ldap_url_parse(referral, &desc) == 0) {
-/* 	  GString *new_uri = g_string_sized_new(strlen(referral)); */
-	  GqServer *newserver;
-
-	  newserver = get_referral_server(error_context, server, referral);
-
-/* 	  g_string_sprintf(new_uri, "%s://%s:%d/",  */
-/* 			   desc->lud_scheme, */
-/* 			   desc->lud_host, */
-/* 			   desc->lud_port); */
-
-/* 	  newserver = new_ldapserver(); */
-
-/* 	  /\* some sensible settings for the "usual" case: */
-/* 	     Anonymous bind. Also show referrals *\/ */
-/* 	  newserver->ask_pw   = 0; */
-/* 	  newserver->show_ref = 1; */
-
-/* #warning "ADD CONFIG FOR EXTENDED REFERENCE CHASING" */
-/* 	  /\* check: do we have this server around already??? *\/ */
-/* 	  s = server_by_canon_name(new_uri->str, TRUE); */
-
-/* 	  if (!s) { */
-/* 	       s = server; */
-/* 	  } */
-					     
-/* 	  if (s) { */
-/* 	       copy_ldapserver(newserver, s); */
-/* 	       statusbar_msg(_("Initialized temporary server-definition '%1$s' from existing server '%2$s'"), new_uri->str, server->name); */
-/* 	  } else { */
-/* 	       statusbar_msg(_("Created temporary server-definition '%1$s' with no pre-set values."), new_uri->str); */
-/* 	  } */
-
-/* 	  g_free_and_dup(newserver->name,     new_uri->str); */
-/* 	  g_free_and_dup(newserver->ldaphost, new_uri->str); */
-/* 	  g_free_and_dup(newserver->basedn,   desc->lud_dn); */
-
-	  newserver->quiet = 1;
-
-	  canonicalize_ldapserver(newserver);
-
-	  transient_add_server(newserver);
-
-	  *nextlevel = g_list_append(*nextlevel, 
-				     new_chasing(newserver, desc->lud_dn));
-
-	  ldap_free_urldesc(desc);
-/* 	  g_string_free(new_uri, TRUE); */
-     }
-}
-
 struct list_click_info {
      int last_col;
      int last_type;
+     GqResultSort *keys;	/* belongs to the clist */
 };
 
 
@@ -1323,7 +1513,6 @@ static void click_column(GtkCList *clist,
 			 gint column,
 			 struct list_click_info *lci)
 {
-     gtk_clist_set_sort_column(clist, column);
      if (lci->last_col != column) {
 	  lci->last_type = GTK_SORT_ASCENDING;
      } else {
@@ -1331,79 +1520,98 @@ static void click_column(GtkCList *clist,
      }
      lci->last_col = column;
 
-     gtk_clist_set_sort_type(clist, lci->last_type);
-     gtk_clist_sort(clist);
+     gq_result_sort_clist(lci->keys, clist, column, lci->last_type);
 
 }
 
-static void query(GqTab *tab)
-{
-     LDAP *ld;
-     LDAPMessage *res, *e;
-     GtkWidget *main_clist, *new_main_clist, *scrwin, *focusbox;
-     GtkWidget *servcombo, *searchbase_combo;
-     GqServer *server;
-     gchar *cur_servername, *cur_searchbase, *enc_searchbase, *querystring;
-     GString *tolist[MAX_NUM_ATTRIBUTES];
-     char *filter, *searchterm;
-     int msg, rc, i, row, l;
-     int oc_col, columns_done[MAX_NUM_ATTRIBUTES];
-     int want_oc = 1;
-     struct attrs *attrlist;
-     LDAPControl c;
-     LDAPControl *ctrls[2] = { NULL, NULL } ;
-     char *base;
-     struct list_click_info *lci;
-     const char **attrs = NULL;
+/* how long (in ms) to wait for a server to accept a connection when
+   searching all servers */
+#define FEDERATED_PROBE_TIMEOUT	5000
 
-     GList *thislevel = NULL, *nextlevel = NULL;
-     int level = 0;
-     struct chasing *ch = NULL;
-     int query_context;
+struct federated_probe {
+     gint pending;
+     GList *unreachable;
+};
 
-     if(GQ_TAB_SEARCH(tab)->search_lock)
-	  return;
+static void federated_server_probed(GqServer *server, gboolean reachable,
+				    struct federated_probe *probe)
+{
+     if (!reachable) {
+	  probe->unreachable = g_list_prepend(probe->unreachable, server);
+     }
+     probe->pending--;
+}
 
-     GQ_TAB_SEARCH(tab)->search_lock = 1;
+/* Checks all servers of level at once and drops those that do not
+   accept connections, so a dead server costs one probe timeout
+   instead of a connect timeout of its own before the others get
+   searched. */
+static GList *drop_unreachable(int error_context, GList *level)
+{
+     struct federated_probe probe = { 0, NULL };
+     GList *I, *next;
+
+     for (I = level ; I ; I = I->next) {
+	  GqSearchBase *sb = I->data;
+	  /* may call back right away */
+	  probe.pending++;
+	  gq_server_probe(sb->server, FEDERATED_PROBE_TIMEOUT,
+			  (GqServerProbeFunc) federated_server_probed,
+			  &probe);
+     }
 
-     query_context = error_new_context(_("Searching"), tab->win->mainwin);
+     while (probe.pending > 0) {
+	  gtk_main_iteration();
+     }
 
-     focusbox = tab->focus;
-     searchterm = gtk_editable_get_chars(GTK_EDITABLE(focusbox), 0, -1);
-     querystring = encoded_string(searchterm);
-     g_free(searchterm);
+     for (I = level ; I ; I = next) {
+	  GqSearchBase *sb = I->data;
+	  next = I->next;
 
-     if(querystring[0] == 0) {
-	  error_push(query_context, _("Please enter a valid search filter"));
-	  goto done;
+	  if (g_list_find(probe.unreachable, sb->server)) {
+	       error_push(error_context,
+			  _("Server '%s' did not answer, it was left out of the search"),
+			  sb->server->name);
+	       level = g_list_delete_link(level, I);
+	       gq_search_base_free(sb);
+	  }
      }
+     g_list_free(probe.unreachable);
 
-     for(i = 0; i < MAX_NUM_ATTRIBUTES; i++)
-	  columns_done[i] = 0;
+     return level;
+}
 
-     servcombo = GQ_TAB_SEARCH(tab)->serverlist_combo;
-     cur_servername =
-	  gtk_editable_get_chars(GTK_EDITABLE(GTK_COMBO(servcombo)->entry),
-				 0, -1);
-     server = gq_server_list_get_by_name(gq_server_list_get(), cur_servername);
-     if(!server) {
-	  error_push(query_context, 
-		     _("Oops! Server '%s' not found!"), cur_servername);
-	  g_free(cur_servername);
-	  goto done;
+/* compiles the filter the search on server would use, so syntax
+   errors show up before anything gets sent */
+static gboolean check_filter(int error_context, GqServer *server,
+			     char *querystring)
+{
+     char *filter = make_filter(server, querystring);
+     gchar *error = NULL;
+     GqFilter *compiled = gq_filter_compile(filter, &error);
+
+     if (compiled == NULL) {
+	  error_push(error_context, _("Invalid search filter '%1$s': %2$s"),
+		     filter, error);
+	  g_free(error);
      }
-     g_free(cur_servername);
-
-     filter = make_filter(server, querystring);
-     free(querystring);
+     gq_filter_free(compiled);
+     g_free(filter);
 
-     statusbar_msg(_("Searching for %s"), filter);
+     return compiled != NULL;
+}
 
-     searchbase_combo = GQ_TAB_SEARCH(tab)->searchbase_combo;
-     cur_searchbase = gtk_editable_get_chars(GTK_EDITABLE(GTK_COMBO(searchbase_combo)->entry), 0, -1);
+/* replaces the result list by a new, empty one and sets up out to
+   fill it */
+static void prepare_output(GqTab *tab, struct query_output *out,
+			   gboolean all_servers, gboolean want_oc)
+{
+     GtkWidget *main_clist, *new_main_clist, *scrwin;
+     struct list_click_info *lci;
+     int i, oc_col;
 
-     enc_searchbase = encoded_string(cur_searchbase);
-     g_free(cur_searchbase);
+     memset(out, 0, sizeof(*out));
+     out->server_col = -1;
 
      /* setup GUI - build new clist */
      new_main_clist = gtk_clist_new(MAX_NUM_ATTRIBUTES);
@@ -1428,8 +1636,13 @@ static void query(GqTab *tab)
 			G_CALLBACK(search_button_press_on_tree_item),
 			tab);
 
+     out->keys = gq_result_sort_new();
+     gtk_object_set_data_full(GTK_OBJECT(new_main_clist), "keys", out->keys,
+			      (GtkDestroyNotify) gq_result_sort_free);
+
      lci = g_malloc0(sizeof(struct list_click_info));
      lci->last_col = -1;
+     lci->keys = out->keys;
 
      gtk_object_set_data_full(GTK_OBJECT(new_main_clist), "lci", lci, g_free);
      g_signal_connect(new_main_clist,
@@ -1444,45 +1657,35 @@ static void query(GqTab *tab)
      GQ_TAB_SEARCH(tab)->main_clist = new_main_clist;
 
      gtk_container_add(GTK_CONTAINER(scrwin), new_main_clist);
+     out->clist = new_main_clist;
 
-     /* prepare attrs list for searches */
-     l = g_list_length(GQ_TAB_SEARCH(tab)->attrs);
-     
-     want_oc = 1;
-     if (l) {
-	  /* fill attrs with pointers belonging to the
-	     list. The attrs[i] MUST NOT be free'd */
-	  const GList *I;
-	  
-	  want_oc = 0;
-	  attrs = g_malloc0(sizeof(const char *) * (l + 1));
-	  for ( i = 0, I = GQ_TAB_SEARCH(tab)->attrs ; 
-		I ; 
-		i++, I = g_list_next(I)) {
-	       attrs[i] = I->data;
-	       if (strcasecmp(attrs[i], "objectclass") == 0) {
-		    want_oc = 1;
-	       }
-	  }
-     }
-
-     attrlist = NULL;
+     out->attrlist = NULL;
 
      /* reserve columns 0 & 1 for DN and objectClass, respectively */
      if(config->showdn) {
-	  column_by_attr(&attrlist, "DN");
+	  column_by_attr(&out->attrlist, "DN");
 	  gtk_clist_set_column_title(GTK_CLIST(new_main_clist), 0, "DN");
 	  gtk_clist_set_column_width(GTK_CLIST(new_main_clist), 0, 260);
 	  gtk_clist_set_column_resizeable(GTK_CLIST(new_main_clist), 0, TRUE);
-	  columns_done[0] = 1;
+	  out->columns_done[0] = 1;
+     }
+
+     /* results from different servers need telling apart */
+     if (all_servers) {
+	  out->server_col = column_by_attr(&out->attrlist, SERVER_COLUMN);
+	  gtk_clist_set_column_title(GTK_CLIST(new_main_clist),
+				     out->server_col, _("Server"));
+	  gtk_clist_set_column_resizeable(GTK_CLIST(new_main_clist),
+					  out->server_col, TRUE);
+	  out->columns_done[out->server_col] = 1;
      }
 
      if (want_oc) {
-	  oc_col = column_by_attr(&attrlist, "objectClass");
+	  oc_col = column_by_attr(&out->attrlist, "objectClass");
 	  gtk_clist_set_column_title(GTK_CLIST(new_main_clist), oc_col,
 				     "objectClass");
 	  gtk_clist_set_column_width(GTK_CLIST(new_main_clist), oc_col, 120);
-	  columns_done[oc_col] = 1;
+	  out->columns_done[oc_col] = 1;
 
 	  gtk_clist_set_column_resizeable(GTK_CLIST(new_main_clist),
 					  oc_col, TRUE);
@@ -1492,177 +1695,446 @@ static void query(GqTab *tab)
      }
 
      for(i = 0; i < MAX_NUM_ATTRIBUTES; i++) {
-	  tolist[i] = g_string_new("");
+	  out->tolist[i] = g_string_new("");
      }
+}
 
-     /* prepare ManageDSAit in case we should show referrals */
-     c.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
-     c.ldctl_value.bv_val	= NULL;
-     c.ldctl_value.bv_len	= 0;
-     c.ldctl_iscritical	= 1;
+/* frees what filling the result list needed */
+static void free_output(struct query_output *out)
+{
+     int i;
 
-     ctrls[0] = &c;
+     for(i = 0; i < MAX_NUM_ATTRIBUTES; i++) {
+	  g_string_free(out->tolist[i], TRUE);
+     }
+     free_attrlist(out->attrlist);
+}
 
-     thislevel = NULL;
-     nextlevel = NULL;
-     level = 0;
+/* makes the filled in result list presentable */
+static void finish_output(struct query_output *out)
+{
+     GtkWidget *new_main_clist = out->clist;
+     int i;
 
-     ch = new_chasing(server, enc_searchbase);
-     thislevel = g_list_append(thislevel, ch);
+/*      gtk_clist_freeze(GTK_CLIST(new_main_clist)); */
+     gtk_clist_column_titles_active(GTK_CLIST(new_main_clist));
 
-     if (enc_searchbase) free(enc_searchbase);
+     for (i = 0 ; gtk_clist_get_column_widget(GTK_CLIST(new_main_clist), i) ;
+	  i++ ) {
+	  int opt = gtk_clist_optimal_column_width(GTK_CLIST(new_main_clist), i);
+	  if (opt < 40) {
+	       opt = 40;
+	  }
+	  if (opt > 150) {
+	       opt = 150;
+	  }
+	  gtk_clist_set_column_width(GTK_CLIST(new_main_clist), i, opt);
+     }
 
-     row = 0;
+     gtk_clist_thaw(GTK_CLIST(new_main_clist));
 
-     gtk_clist_freeze(GTK_CLIST(new_main_clist));
+     free_output(out);
+}
 
-     /* do the searching */
-     set_busycursor();
+struct query_run {
+     GqTab *tab;
+     int query_context;
+     struct query_output *out;
+};
+
+static void query_entry(GqServer *server, LDAP *ld, LDAPMessage *e,
+			struct query_run *run)
+{
+     struct query_output *out = run->out;
+
+     /* the tab got closed while the results were trickling in */
+     if (GQ_TAB_SEARCH(run->tab)->main_clist != out->clist) return;
+
+     fill_one_row(run->query_context,
+		  gq_result_store_add(out->store, server, ld, e),
+		  out);
+     out->row++;
+     gq_progress_add(out->progress, 1);
+}
+
+static void query_tick(struct query_run *run)
+{
+     GtkWidget *clist = run->out->clist;
+
+     if (GQ_TAB_SEARCH(run->tab)->main_clist != clist) return;
+
+     gtk_clist_thaw(GTK_CLIST(clist));
+     while (gtk_events_pending()) {
+	  gtk_main_iteration();
+     }
+     gtk_clist_freeze(GTK_CLIST(clist));
+}
+
+static void query(GqTab *tab)
+{
+     GtkWidget *servcombo, *searchbase_combo;
+     GqServer *server = NULL;
+     gchar *cur_servername, *cur_searchbase, *enc_searchbase, *querystring;
+     char *searchterm;
+     int i, l;
+     int want_oc = 1;
+     gboolean all_servers;
+     const char **attrs = NULL;
+     struct query_output out;
+     struct query_run run;
+     GqSearchParams params;
+     GqResultStore *old_results;
+     gchar **shown = NULL;
 
-     while (thislevel || nextlevel) {
-	  if (thislevel == NULL) {
-	       level++;
-	       thislevel = nextlevel;
-	       nextlevel = NULL;
+     GList *thislevel = NULL;
+     int query_context;
+     gboolean closed;
+
+     if(GQ_TAB_SEARCH(tab)->search_lock)
+	  return;
+
+     /* probing and searching several servers runs the main loop,
+	the tab may get closed meanwhile */
+     g_object_ref(tab);
+     GQ_TAB_SEARCH(tab)->search_lock = 1;
+
+     query_context = error_new_context(_("Searching"), tab->win->mainwin);
+
+     searchterm = gtk_editable_get_chars(GTK_EDITABLE(tab->focus), 0, -1);
+     querystring = encoded_string(searchterm);
+     g_free(searchterm);
+
+     if(querystring[0] == 0) {
+	  error_push(query_context, _("Please enter a valid search filter"));
+	  goto done;
+     }
+
+     all_servers = search_all_servers(tab);
+     if (!all_servers) {
+	  servcombo = GQ_TAB_SEARCH(tab)->serverlist_combo;
+	  cur_servername =
+	       gtk_editable_get_chars(GTK_EDITABLE(GTK_COMBO(servcombo)->entry),
+				      0, -1);
+	  server = gq_server_list_get_by_name(gq_server_list_get(),
+					      cur_servername);
+	  if(!server) {
+	       error_push(query_context, 
+			  _("Oops! Server '%s' not found!"), cur_servername);
+	       g_free(cur_servername);
+	       goto done;
 	  }
-	  if (level > GQ_TAB_SEARCH(tab)->max_depth) {
-	       statusbar_msg(_("Reached maximum recursion depth"));
+	  g_free(cur_servername);
+     }
 
-	       g_list_foreach(thislevel, (GFunc) free_chasing, NULL);
-	       g_list_free(thislevel);
-	       break;
+     /* no point in sending what the servers will reject anyway */
+     if (server) {
+	  if (!check_filter(query_context, server, querystring)) goto done;
+     } else {
+	  GList *servers = group_servers(tab), *I;
+	  gboolean ok = servers != NULL;
+
+	  if (servers == NULL) {
+	       error_push(query_context,
+			  _("None of the chosen servers is configured any longer"));
 	  }
+	  /* one complaint is enough */
+	  for (I = servers ; I && ok ; I = I->next) {
+	       ok = check_filter(query_context, I->data, querystring);
+	  }
+	  g_list_free(servers);
+	  if (!ok) goto done;
+     }
 
-	  ch = thislevel->data;
-	  thislevel = g_list_remove(thislevel, ch);
-
-	  server = ch->server;
-	  base = ch->base;
-
-	  if( (ld = open_connection(query_context, server)) != NULL) {
-	       statusbar_msg(_("Searching on server '%1$s' below '%2$s'"), 
-			     server->name, base);
-	       rc = ldap_search_ext(ld, base, 
-				    GQ_TAB_SEARCH(tab)->scope,
-				    filter,
-				    (char **)attrs,	/* attrs & API bug*/
-				    0,			/* attrsonly */
-				    GQ_TAB_SEARCH(tab)->chase_ref ? NULL : ctrls,
-/* 				    server->show_ref ? ctrls : NULL, */
-				    /* serverctrls */
-				    NULL,		/* clientctrls */
-				    NULL,		/* timeout */
-				    LDAP_NO_LIMIT,	/* sizelimit */
-				    &msg);
-
-	       if(rc == -1) {
-		    server->server_down++;
-		    error_push(query_context,
-			       _("Error searching below '%1$s': %2$s"), 
-			       enc_searchbase, ldap_err2string(rc));
-/* 		    close_connection(server, FALSE); */
-/* 		    GQ_TAB_SEARCH(tab)->search_lock = 0; */
-/* 		    return; */
-		    goto cont;
-	       }
+     if (server) {
+	  char *filter = make_filter(server, querystring);
+	  statusbar_msg(_("Searching for %s"), filter);
+	  g_free(filter);
+     } else if (GQ_TAB_SEARCH(tab)->server_group) {
+	  statusbar_msg(_("Searching the chosen servers for %s"),
+			querystring);
+     } else {
+	  statusbar_msg(_("Searching all servers for %s"), querystring);
+     }
+
+     searchbase_combo = GQ_TAB_SEARCH(tab)->searchbase_combo;
+     cur_searchbase = gtk_editable_get_chars(GTK_EDITABLE(GTK_COMBO(searchbase_combo)->entry), 0, -1);
+
+     enc_searchbase = encoded_string(cur_searchbase);
+     g_free(cur_searchbase);
+
+     /* prepare attrs list for searches */
+     l = g_list_length(GQ_TAB_SEARCH(tab)->attrs);
+     
+     want_oc = 1;
+     if (l) {
+	  /* fill attrs with pointers belonging to the
+	     list. The attrs[i] MUST NOT be free'd */
+	  const GList *I;
 	  
-	       for (rc = 1 ; rc ; ) {
-		    int code = ldap_result(ld, msg, 0, NULL, &res);
-		    if (code == -1) {
-			 /* error */
-			 error_push(query_context,
-				    _("Unspecified error searching below '%1$s'"),
-				    enc_searchbase);
-			 break;
-		    }
-		    for( e = ldap_first_message(ld, res) ; e != NULL ;
-			 e = ldap_next_message(ld, e) ) {
-			 switch (ldap_msgtype(e)) {
-			 case LDAP_RES_SEARCH_ENTRY:
-			      fill_one_row(query_context,
-					   server, ld, e, new_main_clist,
-					   tolist,
-					   columns_done,
-					   attrlist,
-					   tab);
-			      row++;
-
-			      rc = 1;
-			      break; /* OK */
-			 case LDAP_RES_SEARCH_REFERENCE: {
-			      char **refs = NULL;
-			      rc = ldap_parse_reference(ld, e, &refs, NULL, 0);
-
-			      if (rc == LDAP_SUCCESS) {
-				   for (i = 0 ; refs[i] ; i++) {
-					add_referral(query_context,
-						     server,
-						     refs[i], &nextlevel);
-				   }
-				   rc = 1;
-			      }
-			      ldap_value_free(refs);
-			      break;
-			 }
-			 case LDAP_RES_SEARCH_RESULT:
-			      rc = 0;
-			      break;
-			 default:
-			      rc = 0;
-			      break;
-			 }
-		    }
-		    if (res) ldap_msgfree(res);
+	  want_oc = 0;
+	  attrs = g_malloc0(sizeof(const char *) * (l + 2));
+	  for ( i = 0, I = GQ_TAB_SEARCH(tab)->attrs ; 
+		I ; 
+		i++, I = g_list_next(I)) {
+	       attrs[i] = I->data;
+	       if (strcasecmp(attrs[i], "objectclass") == 0) {
+		    want_oc = 1;
 	       }
-	  cont:
-	       close_connection(server, FALSE);
-	  } else {
-	       /* ld == NULL */
 	  }
 
-	  free_chasing(ch);
+	  /* get everything, but still only show these */
+	  if (GQ_TAB_SEARCH(tab)->keep_all) {
+	       shown = g_strdupv((gchar **) attrs);
+	       attrs[l] = "*";
+	  }
+     }
+
+     /* the rows of the old list point into the old results, so
+	these have to go after the list */
+     old_results = GQ_TAB_SEARCH(tab)->results;
+     prepare_output(tab, &out, all_servers, want_oc);
+     gq_result_store_unref(old_results);
+
+     out.store = gq_result_store_new(attrs);
+     GQ_TAB_SEARCH(tab)->results = out.store;
+     GQ_TAB_SEARCH(tab)->results_all_servers = all_servers;
+     GQ_TAB_SEARCH(tab)->results_want_oc = want_oc;
+     g_strfreev(GQ_TAB_SEARCH(tab)->results_shown);
+     GQ_TAB_SEARCH(tab)->results_shown = shown;
+     out.shown = shown;
+
+     /* closing the tab destroys the list and drops the results */
+     g_object_ref(out.clist);
+     gq_result_store_ref(out.store);
+
+     thislevel = NULL;
+
+     if (all_servers) {
+	  GList *servers = group_servers(tab), *I;
+
+	  for (I = servers ; I ; I = I->next) {
+	       GqServer *s = I->data;
+	       /* an empty search base means: each server's own base DN */
+	       const char *base = enc_searchbase && enc_searchbase[0] ?
+		    enc_searchbase : s->basedn;
+
+	       thislevel = g_list_append(thislevel,
+					 gq_search_base_new(s, base));
+	  }
+	  g_list_free(servers);
+     } else {
+	  thislevel = g_list_append(thislevel,
+				    gq_search_base_new(server, enc_searchbase));
+     }
+
+     if (enc_searchbase) free(enc_searchbase);
+
+     gtk_clist_freeze(GTK_CLIST(out.clist));
+
+     /* do the searching */
+     set_busycursor();
+     out.progress = gq_progress_new(!all_servers ? _("Searching") :
+				    GQ_TAB_SEARCH(tab)->server_group ?
+				    _("Searching the chosen servers") :
+				    _("Searching all servers"), 0);
+
+     if (all_servers) {
+	  thislevel = drop_unreachable(query_context, thislevel);
+	  if (GQ_TAB_SEARCH(tab)->main_clist != out.clist) {
+	       g_list_foreach(thislevel, (GFunc) gq_search_base_free, NULL);
+	       g_list_free(thislevel);
+	       thislevel = NULL;
+	  }
      }
 
+     run.tab = tab;
+     run.query_context = query_context;
+     run.out = &out;
+
+     memset(&params, 0, sizeof(params));
+     params.scope = GQ_TAB_SEARCH(tab)->scope;
+     params.chase_ref = GQ_TAB_SEARCH(tab)->chase_ref;
+     params.max_depth = GQ_TAB_SEARCH(tab)->max_depth;
+     params.attrs = attrs;
+     params.entry = (GqSearchEntryFunc) query_entry;
+     /* let the results of several servers trickle in */
+     params.tick = all_servers ? (GqSearchTickFunc) query_tick : NULL;
+     params.user_data = &run;
+
+     gq_search_run(query_context, thislevel, querystring, &params);
+
+     gq_progress_finish(out.progress);
+     out.progress = NULL;
      set_normalcursor();
 
      if (attrs) g_free(attrs);
-     free(filter);
 
-     for(i = 0; i < MAX_NUM_ATTRIBUTES; i++) {
-	  g_string_free(tolist[i], TRUE);
-     }
 /*      gtk_clist_thaw(GTK_CLIST(new_main_clist)); */
 
 
-     if(row > 0) {
+     closed = GQ_TAB_SEARCH(tab)->main_clist != out.clist;
+
+     if(out.row > 0 && !closed) {
 /*	  statusbar_msg("%s", ldap_err2string(msg)); */
 /*      else { */
-	  statusbar_msg(ngettext("One entry found", "%d entries found", row),
-			row);
+	  statusbar_msg(ngettext("One entry found", "%d entries found",
+				 out.row),
+			out.row);
      }
 
-/*      gtk_clist_freeze(GTK_CLIST(new_main_clist)); */
-     gtk_clist_column_titles_active(GTK_CLIST(new_main_clist));
+     if (closed) {
+	  free_output(&out);
+     } else {
+	  finish_output(&out);
+	  add_to_search_history(tab);
+     }
 
-     for (i = 0 ; gtk_clist_get_column_widget(GTK_CLIST(new_main_clist), i) ;
-	  i++ ) {
-	  int opt = gtk_clist_optimal_column_width(GTK_CLIST(new_main_clist), i);
-	  if (opt < 40) {
-	       opt = 40;
+     gq_result_store_unref(out.store);
+     g_object_unref(out.clist);
+
+ done:
+     free(querystring);
+     error_flush(query_context);
+     GQ_TAB_SEARCH(tab)->search_lock = 0;
+     g_object_unref(tab);
+}
+
+/* applies the filter to the results of the last search instead of
+   asking the server(s) again */
+static void refine(GqTab *tab)
+{
+     GqResultStore *store = GQ_TAB_SEARCH(tab)->results;
+     GHashTable *filters;
+     GList *compiled = NULL, *I;
+     gchar *searchterm, *querystring;
+     struct query_output out;
+     GqResultEntry *entry;
+     GqFilter *filter;
+     guint i, total = 0;
+     int ctx;
+
+     if(GQ_TAB_SEARCH(tab)->search_lock)
+	  return;
+
+     ctx = error_new_context(_("Refining search results"),
+			     tab->win->mainwin);
+
+     if (store == NULL || gq_result_store_size(store) == 0) {
+	  error_push(ctx, _("There are no search results to refine"));
+	  error_flush(ctx);
+	  return;
+     }
+
+     searchterm = gtk_editable_get_chars(GTK_EDITABLE(tab->focus), 0, -1);
+     querystring = encoded_string(searchterm);
+     g_free(searchterm);
+
+     if(querystring[0] == 0) {
+	  error_push(ctx, _("Please enter a valid search filter"));
+	  free(querystring);
+	  error_flush(ctx);
+	  return;
+     }
+
+     GQ_TAB_SEARCH(tab)->search_lock = 1;
+
+     /* make_filter depends on the server, so compile the filter for
+	each server the results came from, all of them up front:
+	failing halfway would leave the list half filled */
+     filters = g_hash_table_new(g_direct_hash, g_direct_equal);
+     for (i = 0 ; i < gq_result_store_size(store) ; i++) {
+	  GqServer *server = gq_result_store_get(store, i)->set.server;
+	  struct server_schema *ss;
+	  GList *attrs, *A;
+	  gchar *error = NULL;
+	  char *f;
+
+	  if (g_hash_table_lookup_extended(filters, server, NULL, NULL)) {
+	       continue;
 	  }
-	  if (opt > 150) {
-	       opt = 150;
+
+	  f = make_filter(server, querystring);
+	  filter = gq_filter_compile(f, &error);
+	  if (filter == NULL) {
+	       error_push(ctx, _("Invalid search filter '%1$s': %2$s"),
+			  f, error);
+	       g_free(error);
+	       g_free(f);
+	       goto done;
 	  }
-	  gtk_clist_set_column_width(GTK_CLIST(new_main_clist), i, opt);
+	  compiled = g_list_prepend(compiled, filter);
+	  g_hash_table_insert(filters, server, filter);
+
+	  /* what did not come back cannot be filtered on. Attribute
+	     types the schema does not know might well be operational */
+	  ss = get_schema(ctx, server);
+	  attrs = gq_filter_get_attributes(filter);
+	  for (A = attrs ; A ; A = g_list_next(A)) {
+	       gchar *type = g_strndup(A->data, strcspn(A->data, ";"));
+	       LDAPAttributeType *at = ss && ss->at_by_name ?
+		    g_hash_table_lookup(ss->at_by_name, type) : NULL;
+	       gboolean operational =
+		    at == NULL || at->at_usage != LDAP_SCHEMA_USER_APPLICATIONS;
+
+	       g_free(type);
+
+	       if (!gq_result_store_has_attribute(store, A->data,
+						  operational)) {
+		    error_push(ctx, _("The search results do not contain attribute '%s', search the server instead"),
+			       (gchar *) A->data);
+		    break;
+	       }
+	  }
+	  g_list_free(attrs);
+	  if (A) {
+	       g_free(f);
+	       goto done;
+	  }
+
+	  if (!gq_filter_bind(filter, ss, &error)) {
+	       error_push(ctx, _("Cannot refine using '%1$s': %2$s"),
+			  f, error);
+	       g_free(error);
+	       g_free(f);
+	       goto done;
+	  }
+	  g_free(f);
      }
 
-     gtk_clist_thaw(GTK_CLIST(new_main_clist));
+     prepare_output(tab, &out, GQ_TAB_SEARCH(tab)->results_all_servers,
+		    GQ_TAB_SEARCH(tab)->results_want_oc);
+     out.shown = GQ_TAB_SEARCH(tab)->results_shown;
+     gtk_clist_freeze(GTK_CLIST(out.clist));
+     set_busycursor();
+
+     for (i = 0 ; i < gq_result_store_size(store) ; i++) {
+	  entry = gq_result_store_get(store, i);
+	  if (entry->deleted) continue;
 
-     free_attrlist(attrlist);
+	  total++;
+	  filter = g_hash_table_lookup(filters, entry->set.server);
+	  if (!gq_filter_matches(filter, entry)) continue;
+
+	  fill_one_row(ctx, entry, &out);
+	  out.row++;
+     }
+
+     set_normalcursor();
+     finish_output(&out);
+
+     statusbar_msg(ngettext("%1$d of %2$d entry matches",
+			    "%1$d of %2$d entries match", total),
+		   out.row, total);
      add_to_search_history(tab);
 
  done:
-     error_flush(query_context);
+     g_hash_table_destroy(filters);
+     for (I = compiled ; I ; I = g_list_next(I)) {
+	  gq_filter_free(I->data);
+     }
+     g_list_free(compiled);
+     free(querystring);
+     error_flush(ctx);
      GQ_TAB_SEARCH(tab)->search_lock = 0;
 }
 
@@ -1759,6 +2231,15 @@ static void results_popup_menu(GqTab *tab, GdkEventButton *event,
      gtk_widget_show(menu_item);
      gtk_widget_set_sensitive(menu_item, have_sel);
 
+     /* Modify */
+     menu_item = gtk_menu_item_new_with_label(_("Modify..."));
+     gtk_menu_append(GTK_MENU(submenu), menu_item);
+     g_signal_connect_swapped(menu_item, "activate",
+			       G_CALLBACK(modify_search_selected),
+			       tab);
+     gtk_widget_show(menu_item);
+     gtk_widget_set_sensitive(menu_item, have_sel);
+
      /* separator */
      menu_item = gtk_menu_item_new();
      gtk_menu_append(GTK_MENU(submenu), menu_item);
@@ -1858,108 +2339,199 @@ void find_in_browser(GqTab *tab)
 }
 
 
-void add_all_to_browser(GqTab *tab)
+/* shows the entries of the given rows in the last used browser, in
+   one batch per server */
+static void add_rows_to_browser(GqTab *tab, GList *rows, const char *title)
 {
      GQTreeWidget *ctree;
-     struct dn_on_server *cur_resultset;
+     struct dn_on_server *set;
      GqTab *browsetab;
-     int i;
      GtkWidget *clist = GQ_TAB_SEARCH(tab)->main_clist;
+     GHashTable *by_server;
+     GList *servers = NULL, *I;
+     int ctx, locked, n = 0;
 
      /* find last used browser... */
-     
+
      browsetab = get_last_of_mode(BROWSE_MODE);
-     if(browsetab) {
-	  int ctx;
-	  ctree = GQ_TAB_BROWSE(browsetab)->ctreeroot;
-	  ctx = error_new_context(_("Adding all to browser"), 
-				  GTK_WIDGET(ctree));
+     if (browsetab == NULL) {
+	  single_warning_popup(_("No browser available"));
+	  return;
+     }
 
-	  gtk_clist_freeze(GTK_CLIST(ctree));
-	  for(i = 0 ;
-	      (cur_resultset = gtk_clist_get_row_data(GTK_CLIST(clist), i)) != NULL ;
-	      i++) {
-	       show_server_dn(ctx, ctree, 
-			      cur_resultset->server, cur_resultset->dn, FALSE);
+     ctree = GQ_TAB_BROWSE(browsetab)->ctreeroot;
+     ctx = error_new_context(title, GTK_WIDGET(ctree));
+
+     by_server = g_hash_table_new(g_direct_hash, g_direct_equal);
+     for (I = rows ; I ; I = g_list_next(I)) {
+	  GList *l;
+
+	  set = gtk_clist_get_row_data(GTK_CLIST(clist),
+				       GPOINTER_TO_INT(I->data));
+	  if (set == NULL) continue;
+
+	  l = g_hash_table_lookup(by_server, set->server);
+	  if (l == NULL) {
+	       servers = g_list_prepend(servers, set->server);
 	  }
-	  gtk_clist_thaw(GTK_CLIST(ctree));
-	  go_to_page(browsetab);
+	  g_hash_table_insert(by_server, set->server,
+			      g_list_prepend(l, set->dn));
+     }
+     servers = g_list_reverse(servers);
 
-	  error_flush(ctx);
-     } else {
-	  single_warning_popup(_("No browser available"));
+     /* the rows must stay around until we are done with them */
+     locked = GQ_TAB_SEARCH(tab)->search_lock;
+     GQ_TAB_SEARCH(tab)->search_lock = 1;
+
+     for (I = servers ; I ; I = g_list_next(I)) {
+	  GList *l = g_list_reverse(g_hash_table_lookup(by_server, I->data));
+
+	  n += show_server_dns(ctx, ctree, I->data, l);
+	  g_list_free(l);
      }
+
+     GQ_TAB_SEARCH(tab)->search_lock = locked;
+
+     g_hash_table_destroy(by_server);
+     g_list_free(servers);
+
+     go_to_page(browsetab);
+     statusbar_msg(ngettext("Added one entry to the browser",
+			    "Added %d entries to the browser", n), n);
+
+     error_flush(ctx);
+}
+
+void add_all_to_browser(GqTab *tab)
+{
+     GtkWidget *clist = GQ_TAB_SEARCH(tab)->main_clist;
+     GList *rows = NULL;
+     int i;
+
+     for (i = GTK_CLIST(clist)->rows - 1 ; i >= 0 ; i--) {
+	  rows = g_list_prepend(rows, GINT_TO_POINTER(i));
+     }
+
+     add_rows_to_browser(tab, rows, _("Adding all to browser"));
+     g_list_free(rows);
 }
 
 static void add_selected_to_browser(GqTab *tab)
 {
-     GQTreeWidget *ctree;
-     struct dn_on_server *cur_resultset;
-     GqTab *browsetab;
      GtkWidget *clist = GQ_TAB_SEARCH(tab)->main_clist;
-     GList *sel, *I;
+     GList *rows = g_list_copy(GTK_CLIST(clist)->selection);
 
-     /* find last used browser... */
-     
-     browsetab = get_last_of_mode(BROWSE_MODE);
-     if(browsetab) {
-	  int ctx;
-	  ctree = GQ_TAB_BROWSE(browsetab)->ctreeroot;
-	  ctx = error_new_context(_("Adding selected entries to browser"), GTK_WIDGET(ctree));
+     add_rows_to_browser(tab, rows,
+			 _("Adding selected entries to browser"));
+     g_list_free(rows);
+}
 
-	  gtk_clist_freeze(GTK_CLIST(ctree));
 
-	  sel = GTK_CLIST(clist)->selection;
 
-	  for (I = sel ; I ; I = g_list_next(I)) {
-	       cur_resultset = gtk_clist_get_row_data(GTK_CLIST(clist), GPOINTER_TO_INT(I->data));
-	       show_server_dn(ctx, 
-			      ctree, 
-			      cur_resultset->server, cur_resultset->dn, FALSE);
-	  }
-	  gtk_clist_thaw(GTK_CLIST(ctree));
-	  go_to_page(browsetab);
+static void export_search_selected_entry(GqTab *tab)
+{
+     GtkWidget *clist = GQ_TAB_SEARCH(tab)->main_clist;
+     GList *to_export = NULL, *I;
+     int error_context;
 
-	  error_flush(ctx);
-     } else {
-	  single_warning_popup(_("No browser available"));
+     for (I = GTK_CLIST(clist)->selection ; I ; I = g_list_next(I)) {
+	  struct dn_on_server *set =
+	       gtk_clist_get_row_data(GTK_CLIST(clist),
+				      GPOINTER_TO_INT(I->data));
+	  to_export = g_list_prepend(to_export, GQ_RESULT_ENTRY(set));
      }
-}
+     to_export = g_list_reverse(to_export);
 
+     error_context = error_new_context(_("Exporting selected entries to LDIF"),
+				       tab->win->mainwin);
 
+     /* the entries are there already, no browser needed */
+     export_results(error_context, tab->win->mainwin,
+		    GQ_TAB_SEARCH(tab)->results, to_export);
 
-static void export_search_selected_entry(GqTab *tab)
+     error_flush(error_context);
+}
+
+static void modify_search_selected(GqTab *tab)
 {
-     struct dn_on_server *cur_resultset;
-     GqTab *browsetab;
      GtkWidget *clist = GQ_TAB_SEARCH(tab)->main_clist;
-     GList *sel, *I;
+     GqResultStore *store;
+     GList *to_modify = NULL, *I;
+     int ctx, locked;
+
+     for (I = GTK_CLIST(clist)->selection ; I ; I = g_list_next(I)) {
+	  struct dn_on_server *set =
+	       gtk_clist_get_row_data(GTK_CLIST(clist),
+				      GPOINTER_TO_INT(I->data));
+	  to_modify = g_list_prepend(to_modify, GQ_RESULT_ENTRY(set));
+     }
+     to_modify = g_list_reverse(to_modify);
 
-     /* find last used browser... */
-     
-     browsetab = get_last_of_mode(BROWSE_MODE);
-     if(browsetab) {
-	  GList *to_export = NULL;
-	  struct dn_on_server *dos;
-	  int error_context;
+     ctx = error_new_context(_("Modifying selected entries"),
+			     tab->win->mainwin);
+
+     /* the values filled in come from the results, keep them, even
+	if the tab gets closed while the dialog is up */
+     g_object_ref(tab);
+     store = gq_result_store_ref(GQ_TAB_SEARCH(tab)->results);
+     locked = GQ_TAB_SEARCH(tab)->search_lock;
+     GQ_TAB_SEARCH(tab)->search_lock = 1;
 
-	  sel = GTK_CLIST(clist)->selection;
+     mass_modify_results(ctx, tab->win->mainwin, to_modify);
 
-	  for (I = sel ; I ; I = g_list_next(I)) {
-	       cur_resultset = gtk_clist_get_row_data(GTK_CLIST(clist), GPOINTER_TO_INT(I->data));
+     GQ_TAB_SEARCH(tab)->search_lock = locked;
+     gq_result_store_unref(store);
+     g_object_unref(tab);
 
-	       dos = new_dn_on_server(cur_resultset->dn,
-				      cur_resultset->server);
-	       to_export = g_list_append(to_export, dos);
+     g_list_free(to_modify);
+     error_flush(ctx);
+}
+
+/* rows of deleted entries taken out of the result list at once */
+#define DELETED_ROWS_BATCH	32
+
+struct deleted_rows {
+     GqTab *tab;
+     GtkWidget *clist;
+     GHashTable *gone;		/* row data of the rows to remove */
+};
+
+/* removes the rows collected so far in a single pass over the list */
+static void remove_deleted_rows(struct deleted_rows *dr)
+{
+     GtkCList *clist = GTK_CLIST(dr->clist);
+     GList *I, *prev;
+     int row;
+
+     if (g_hash_table_size(dr->gone) == 0) return;
+     /* the tab got closed meanwhile */
+     if (GQ_TAB_SEARCH(dr->tab)->main_clist != dr->clist) return;
+
+     gtk_clist_freeze(clist);
+     /* bottom up, so the rows still to look at keep their numbers */
+     for (I = clist->row_list_end, row = clist->rows - 1 ; I ;
+	  I = prev, row--) {
+	  prev = g_list_previous(I);
+	  if (g_hash_table_lookup(dr->gone, GTK_CLIST_ROW(I)->data)) {
+	       gtk_clist_remove(clist, row);
 	  }
-	  error_context = error_new_context(_("Exporting selected entries to LDIF"),
-					    tab->win->mainwin);
+     }
+     gtk_clist_thaw(clist);
 
-	  export_many(error_context, tab->win->mainwin, to_export);
+     g_hash_table_destroy(dr->gone);
+     dr->gone = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
 
-	  error_flush(error_context);
-     } else {
-	  single_warning_popup(_("No browser available"));
+/* notes the row of a deleted entry for removal from the result list */
+static void search_row_deleted(struct dn_on_server *set,
+			       struct deleted_rows *dr)
+{
+     /* keep it from coming back when refining */
+     GQ_RESULT_ENTRY(set)->deleted = TRUE;
+
+     g_hash_table_insert(dr->gone, set, set);
+     if (g_hash_table_size(dr->gone) >= DELETED_ROWS_BATCH) {
+	  remove_deleted_rows(dr);
      }
 }
 
@@ -1976,27 +2548,62 @@ static void delete_search_selected(GqTab *tab)
 			      _("Do you really want to delete the selected entries?")
 			      );
 
-	  /* FIXME: sort by ldapserver and keep connection open across
-	     deletions  */
 	  if (answer) {
-	       GList *deld = NULL;
+	       GList *servers = NULL;
+	       GHashTable *by_server;
+	       struct deleted_rows dr;
+	       int n = 0;
 	       int ctx = error_new_context(_("Deleting selected entries"), 
 					   GTK_WIDGET(clist));
 
+	       /* the rows must stay around until we are done with
+		  them, so no searching in the meantime */
+	       GQ_TAB_SEARCH(tab)->search_lock = 1;
+
+	       /* one batch of deletes per server, in list order
+		  (bottom up, as before) */
+	       by_server = g_hash_table_new(g_direct_hash, g_direct_equal);
 	       for (I = g_list_last(sel) ; I ; I = g_list_previous(I)) {
+		    GList *l;
+
 		    set = gtk_clist_get_row_data(GTK_CLIST(clist),
 						 GPOINTER_TO_INT(I->data));
-		    if (delete_entry(ctx, set->server, set->dn)) {
-			 deld = g_list_append(deld, I->data);
+		    l = g_hash_table_lookup(by_server, set->server);
+		    if (l == NULL) {
+			 servers = g_list_append(servers, set->server);
 		    }
+		    g_hash_table_insert(by_server, set->server,
+					g_list_prepend(l, set));
 	       }
-	       gtk_clist_freeze(GTK_CLIST(clist));
-	       for (I = g_list_first(deld) ; I ; I = g_list_next(I)) {
-		    gtk_clist_remove(GTK_CLIST(clist),
-				     GPOINTER_TO_INT(I->data));
+
+	       /* the progress runs the main loop, the tab may get
+		  closed meanwhile */
+	       g_object_ref(tab);
+	       dr.tab = tab;
+	       dr.clist = clist;
+	       dr.gone = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	       for (I = servers ; I ; I = g_list_next(I)) {
+		    GList *l = g_list_reverse(g_hash_table_lookup(by_server,
+								  I->data));
+
+		    n += delete_entries(ctx, I->data, l,
+					(void (*)(struct dn_on_server *, gpointer))
+					search_row_deleted,
+					&dr);
+		    g_list_free(l);
 	       }
-	       g_list_free(deld);
-	       gtk_clist_thaw(GTK_CLIST(clist));
+	       remove_deleted_rows(&dr);
+
+	       g_hash_table_destroy(dr.gone);
+	       g_hash_table_destroy(by_server);
+	       g_list_free(servers);
+
+	       GQ_TAB_SEARCH(tab)->search_lock = 0;
+	       g_object_unref(tab);
+
+	       statusbar_msg(ngettext("Deleted one entry",
+				      "Deleted %d entries", n), n);
 
 	       error_flush(ctx);
 	  }
@@ -2132,6 +2739,12 @@ tab_dispose(GObject* object)
 		self->main_clist = NULL;
 	}
 
+	/* only after the list, its rows point into the results */
+	gq_result_store_unref(self->results);
+	self->results = NULL;
+	g_strfreev(self->results_shown);
+	self->results_shown = NULL;
+
 	G_OBJECT_CLASS(gq_tab_search_parent_class)->dispose(object);
 }
 
@@ -2144,6 +2757,7 @@ tab_finalize(GObject* object)
 		g_free(self->history->data);
 		self->history = g_list_delete_link(self->history, self->history);
 	}
+	self->server_group = free_list_of_strings(self->server_group);
 
 	G_OBJECT_CLASS(gq_tab_search_parent_class)->finalize(object);
 }
@@ -28,6 +28,8 @@
 #define GQ_SEARCH_H_INCLUDED
 
 #include "common.h"
+#include "gq-result-store.h"
+#include "gq-search-engine.h"
 #include "mainwin.h"
 
 G_BEGIN_DECLS
@@ -44,18 +46,18 @@ typedef GqTabClass          GqTabSearchClass;
 
 GType gq_tab_search_get_type(void);
 
-typedef enum {
-	SEARCHARG_BEGINS_WITH,
-	SEARCHARG_ENDS_WITH,
-	SEARCHARG_CONTAINS,
-	SEARCHARG_EQUALS
-} GqSearchType;
-
 struct _GqTabSearch {
 	GqTab base_instance;
 
 	GtkWidget *search_combo;
 	GtkWidget *serverlist_combo;
+	/* when active, searches the servers of server_group at once
+	   instead of the one in serverlist_combo */
+	GtkWidget *all_servers_button;
+	GtkWidget *server_group_button;
+	/* names of the servers to search together, NULL for all of
+	   them */
+	GList *server_group;
 	GtkWidget *searchbase_combo;
 	GtkWidget *main_clist;
 	int populated_searchbase;
@@ -72,6 +74,18 @@ struct _GqTabSearch {
 	int chase_ref;
 	int max_depth;
 	GList *attrs;
+	/* fetch all attributes even if only some are shown, so
+	   exporting the results needs no further searches */
+	int keep_all;
+
+	/* the entries of the last search, the rows of main_clist
+	   point into it. Refining filters these instead of searching
+	   again, results_all_servers and results_want_oc tell how the
+	   list has to look like. */
+	GqResultStore *results;
+	gboolean results_all_servers;
+	gboolean results_want_oc;
+	gchar **results_shown;	/* NULL: all that came back */
 };
 
 struct attrs {
@@ -84,7 +98,10 @@ struct attrs {
 
 GqTab *new_searchmode();
 
-char *make_filter(GqServer *server, char *querystring);
+/* whether tab searches several servers (the server group, all if
+   none was chosen) instead of the selected one */
+gboolean search_all_servers(GqTab *tab);
+void     search_set_all_servers(GqTab *tab, gboolean all);
 
 void fill_out_search(GqTab *tab,
 		     GqServer *server,
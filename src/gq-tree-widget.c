@@ -39,22 +39,45 @@ struct _GqTreeWidgetNode {
 #else
 #include <gtk/gtkcellrenderertext.h>
 #include <gtk/gtktreeselection.h>
-#include <gtk/gtktreestore.h>
-#include <gtk/gtktreeview.h>
+
+/* rows all look the same, so the view may take the height of one for
+   all of them and never measure the others: with a fixed column width
+   this keeps expanding a node with many thousand children cheap */
+#define TREE_COLUMN_WIDTH	600
 
 struct _GqTreeWidget {
-	GtkTreeView   base_instance;
-	GtkTreeModel* model;
+	GtkTreeView     base_instance;
+	GqBrowserModel* model;
+	GCallback       expand_callback;
+	gpointer        expand_data;
 };
 struct _GqTreeWidgetClass {
 	GtkTreeViewClass base_class;
 };
 
-enum {
-	COLUMN_LABEL,
-	COLUMN_DATA,
-	N_COLUMNS
-};
+static GtkTreePath*
+node_path(GqTreeWidget*     self,
+	  GqTreeWidgetNode* node)
+{
+	GtkTreeIter iter;
+
+	gq_browser_model_node_to_iter(self->model, node, &iter);
+	return gtk_tree_model_get_path(GTK_TREE_MODEL(self->model), &iter);
+}
+
+static void
+call_expand_callback(GqTreeWidget*     self,
+		     GqTreeWidgetNode* node)
+{
+	void (*tree_expand) (GqTreeWidget*     self,
+			     GqTreeWidgetNode* node,
+			     gpointer          user_data);
+
+	if (self->expand_callback == NULL) return;
+
+	tree_expand = (gpointer) self->expand_callback;
+	tree_expand(self, node, self->expand_data);
+}
 #endif
 
 /* Refactored tree-widget handling functions: */
@@ -77,12 +100,65 @@ gq_tree_widget_find_by_row_data_custom(GqTreeWidget*     self,
 #ifndef USE_TREE_VIEW
 	return gtk_ctree_find_by_row_data_custom(GTK_CTREE(self), node, data, func);
 #else
-#warning "FIXME: implement gq_tree_widget_find_by_row_data_custom()"
-	g_warning("FIXME: implement gq_tree_widget_find_by_row_data_custom()");
+	GqTreeWidgetNode *found;
+
+	/* like the CTree: node, everything below it and its following
+	   siblings with everything below them */
+	if (node == NULL) node = gq_browser_model_get_child(self->model, NULL, 0);
+	for ( ; node ; node = gq_browser_model_get_next(node)) {
+		if (!func(gq_browser_model_get_data(node), data)) {
+			return node;
+		}
+		found = gq_browser_model_get_child(self->model, node, 0);
+		if (found) {
+			found = gq_tree_widget_find_by_row_data_custom(self, found,
+								       data, func);
+			if (found) return found;
+		}
+	}
 	return NULL;
 #endif
 }
 
+#ifdef USE_TREE_VIEW
+/* func on node, then on its descendants down to depth (top level
+   nodes being at level 1, depth -1 for no limit), in the order the
+   CTree does it: the next node is looked up before going on, so func
+   may remove the node it gets when it has no children */
+static void
+pre_recursive(GqTreeWidget*     self,
+	      GqTreeWidgetNode* node,
+	      gint              level,
+	      gint              depth,
+	      GqTreeWidgetFunc  func,
+	      gpointer          data)
+{
+	GqTreeWidgetNode *work, *next;
+
+	work = gq_browser_model_get_child(self->model, node, 0);
+	if (node) func(self, node, data);
+	/* the level of the children now */
+	level++;
+	if (depth >= 0 && level > depth) return;
+
+	for ( ; work ; work = next) {
+		next = gq_browser_model_get_next(work);
+		pre_recursive(self, work, level, depth, func, data);
+	}
+}
+
+static gint
+node_level(GqTreeWidgetNode* node)
+{
+	gint level = 0;
+
+	for ( ; node ; node = gq_browser_model_get_parent(node)) {
+		level++;
+	}
+	return level;
+}
+#endif
+
 void
 gq_tree_widget_pre_recursive (GqTreeWidget*     self,
 			      GqTreeWidgetNode* node,
@@ -92,8 +168,7 @@ gq_tree_widget_pre_recursive (GqTreeWidget*     self,
 #ifndef USE_TREE_VIEW
 	gtk_ctree_pre_recursive(GTK_CTREE(self), node, func, data);
 #else
-#warning "FIXME: implement gq_tree_widget_pre_recursive()"
-	g_warning("FIXME: implement gq_tree_widget_pre_recursive()");
+	pre_recursive(self, node, node_level(node), -1, func, data);
 #endif
 }
 
@@ -107,8 +182,8 @@ gq_tree_widget_pre_recursive_to_depth (GqTreeWidget*     self,
 #ifndef USE_TREE_VIEW
 	gtk_ctree_pre_recursive_to_depth(GTK_CTREE(self), node, depth, func, data);
 #else
-#warning "FIXME: implement gq_tree_widget_pre_recursive_to_depth()"
-	g_warning("FIXME: implement gq_tree_widget_pre_recursive_to_depth()");
+	if (node && depth >= 0 && node_level(node) > depth) return;
+	pre_recursive(self, node, node_level(node), depth, func, data);
 #endif
 }
 
@@ -122,8 +197,10 @@ gq_tree_widget_scroll_to(GqTreeWidget*     self,
 #ifndef USE_TREE_VIEW
 	gtk_ctree_node_moveto(GTK_CTREE(self), node, column, row_align, col_align);
 #else
-#warning "FIXME: implement gq_tree_widget_scroll_to()"
-	g_warning("FIXME: implement gq_tree_widget_scroll_to()");
+	GtkTreePath *path = node_path(self, node);
+	gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(self), path, NULL,
+				     TRUE, row_align, col_align);
+	gtk_tree_path_free(path);
 #endif
 }
 
@@ -135,8 +212,8 @@ gq_tree_widget_set_column_auto_resize (GqTreeWidget*    self,
 #ifndef USE_TREE_VIEW
 	gtk_clist_set_column_auto_resize(GTK_CLIST(self), column, auto_resize);
 #else
-#warning "FIXME: implement gq_tree_widget_set_column_auto_resize()"
-	//g_warning("FIXME: implement gq_tree_widget_set_column_auto_resize()");
+	/* the column keeps its fixed width, measuring every row to size
+	   it is just what the fixed height mode is there to avoid */
 #endif
 }
 
@@ -149,8 +226,8 @@ gq_tree_widget_set_expand_callback(GqTreeWidget* self,
 	g_signal_connect(self, "tree-expand",
 			 callback, data);
 #else
-#warning "FIXME: implement gq_tree_widget_set_expand_callback()"
-	//g_warning("FIXME: implement gq_tree_widget_set_expand_callback()");
+	self->expand_callback = callback;
+	self->expand_data = data;
 #endif
 }
 
@@ -164,7 +241,8 @@ tree_select_row_wrapper(GtkTreeSelection* ts, gpointer* connection) {
 					 gint              column,
 					 gpointer          user_data);
 		tree_select_row = connection[2];
-		tree_select_row(GQ_TREE_WIDGET(connection[0]), &iter, 0, connection[1]);
+		tree_select_row(GQ_TREE_WIDGET(connection[0]),
+				iter.user_data, 0, connection[1]);
 	}
 }
 #endif
@@ -208,10 +286,12 @@ gq_tree_widget_sort_node(GqTreeWidget*     self,
 			 GqTreeWidgetNode* node)
 {
 #ifndef USE_TREE_VIEW
+	gtk_clist_set_sort_type(GTK_CLIST(self), GTK_SORT_ASCENDING);
+	gtk_clist_set_sort_column(GTK_CLIST(self), 0);
+	gtk_clist_set_compare_func(GTK_CLIST(self), (GtkCListCompareFunc)NULL);
 	gtk_ctree_sort_node(GTK_CTREE(self), node);
 #else
-#warning "FIXME: implement gq_tree_widget_sort_node()"
-	g_warning("FIXME: implement gq_tree_widget_sort_node()");
+	gq_browser_model_sort(self->model, node);
 #endif
 }
 
@@ -222,8 +302,61 @@ gq_tree_widget_unselect(GqTreeWidget*     self,
 #ifndef USE_TREE_VIEW
 	gtk_ctree_unselect(GTK_CTREE(self), node);
 #else
-#warning "FIXME: implement gq_tree_widget_unselect()"
-	g_warning("FIXME: implement gq_tree_widget_unselect()");
+	GtkTreePath *path = node_path(self, node);
+	gtk_tree_selection_unselect_path(gtk_tree_view_get_selection(GTK_TREE_VIEW(self)),
+					 path);
+	gtk_tree_path_free(path);
+#endif
+}
+
+gboolean
+gq_tree_widget_has_selection(GqTreeWidget* self)
+{
+#ifndef USE_TREE_VIEW
+	return GTK_CLIST(self)->selection != NULL;
+#else
+	return gtk_tree_selection_count_selected_rows(gtk_tree_view_get_selection(GTK_TREE_VIEW(self))) > 0;
+#endif
+}
+
+void
+gq_tree_widget_set_auto_sort(GqTreeWidget* self,
+			     gboolean      auto_sort)
+{
+#ifndef USE_TREE_VIEW
+	gtk_clist_set_auto_sort(GTK_CLIST(self), auto_sort);
+#else
+	gq_browser_model_set_auto_sort(self->model, auto_sort);
+#endif
+}
+
+void
+gq_tree_widget_freeze(GqTreeWidget* self)
+{
+#ifndef USE_TREE_VIEW
+	gtk_clist_freeze(GTK_CLIST(self));
+#else
+	gq_browser_model_freeze(self->model);
+#endif
+}
+
+void
+gq_tree_widget_thaw(GqTreeWidget* self)
+{
+#ifndef USE_TREE_VIEW
+	gtk_clist_thaw(GTK_CLIST(self));
+#else
+	gq_browser_model_thaw(self->model);
+#endif
+}
+
+GdkWindow*
+gq_tree_widget_get_bin_window(GqTreeWidget* self)
+{
+#ifndef USE_TREE_VIEW
+	return GTK_CLIST(self)->clist_window;
+#else
+	return gtk_tree_view_get_bin_window(GTK_TREE_VIEW(self));
 #endif
 }
 
@@ -237,8 +370,7 @@ gq_tree_widget_node_set_row_data_full (GqTreeWidget*     self,
 	g_return_if_fail(destroy != g_object_unref);
 	gtk_ctree_node_set_row_data_full(GTK_CTREE(self), node, data, destroy);
 #else
-#warning "FIXME: implement gq_tree_widget_node_set_row_data_full()"
-	g_warning("FIXME: implement gq_tree_widget_node_set_row_data_full()");
+	gq_browser_model_set_data(self->model, node, data, destroy);
 #endif
 }
 
@@ -261,8 +393,11 @@ gq_tree_insert_dummy_node (GQTreeWidget*     tree_widget,
 				       NULL, NULL, NULL, NULL,
 				       TRUE, FALSE);
 #else
-#warning "FIXME: implement gq_tree_insert_dummy_node()"
-     //g_warning("FIXME: implement gq_tree_insert_dummy_node()");
+     g_return_if_fail (tree_widget);
+     g_return_if_fail (parent_node);
+
+     /* no dummy row needed, the model just shows the expander */
+     gq_browser_model_set_children_unknown(tree_widget->model, parent_node);
 #endif
 }
 
@@ -295,27 +430,10 @@ gq_tree_insert_node (GQTreeWidget*     self,
 
      return new_node;
 #else
-	if(!parent_node) {
-		if(!sibling_node) {
-			GtkTreeStore* store;
-			GtkTreeIter   iter;
-			store = GTK_TREE_STORE(self->model);
-			gtk_tree_store_append(store, &iter, NULL);
-			gtk_tree_store_set(store, &iter,
-					   COLUMN_LABEL,   label,
-					   COLUMN_DATA,    data,
-					   COLUMN_DESTROY, destroy_cb,
-					   -1);
-		} else {
-			g_warning("FIXME: implement gq_tree_insert_node() for real sibling");
-		}
-	} else {
-		g_warning("FIXME: implement gq_tree_insert_node() for real parent");
-	}
-	//g_print("gq_tree_insert_node(%p, %p, %p, \"%s\", %p, %p)\n",
-	//	self, parent_node, sibling_node,
-	//	label, data, destroy_cb);
-	return NULL;
+     g_return_val_if_fail (self, NULL);
+
+     return gq_browser_model_insert(self->model, parent_node, sibling_node,
+				    label, data, destroy_cb);
 #endif
 }
 
@@ -329,8 +447,10 @@ gq_tree_remove_node (GQTreeWidget *tree_widget,
 
      gtk_ctree_remove_node (tree_widget, node);
 #else
-#warning "FIXME: implement gq_tree_remove_node()"
-     g_warning("FIXME: implement gq_tree_remove_node()");
+     g_return_if_fail (tree_widget);
+     g_return_if_fail (node);
+
+     gq_browser_model_remove(tree_widget->model, node);
 #endif
 }
 
@@ -346,8 +466,10 @@ gq_tree_remove_children (GQTreeWidget *tree_widget,
 	  gq_tree_remove_node (tree_widget, GTK_CTREE_ROW (parent_node)->children);
      }
 #else
-#warning "FIXME: implement gq_tree_remove_children()"
-     g_warning("FIXME: implement gq_tree_remove_children()");
+     g_return_if_fail (tree_widget);
+     g_return_if_fail (parent_node);
+
+     gq_browser_model_remove_children(tree_widget->model, parent_node);
 #endif
 }
 
@@ -371,9 +493,7 @@ gq_tree_get_node_text (GQTreeWidget *tree_widget,
 			      );
      return currtext;
 #else
-#warning "FIXME: implement gq_tree_get_node_text()"
-     g_warning("FIXME: implement gq_tree_get_node_text()");
-     return NULL;
+     return (char*) gq_browser_model_get_label(node);
 #endif
 }
 
@@ -385,8 +505,7 @@ gq_tree_set_node_text (GQTreeWidget *tree_widget,
 #ifndef USE_TREE_VIEW
      gtk_ctree_node_set_text (tree_widget, node, 0, text);
 #else
-#warning "FIXME: implement gq_tree_set_node_text()"
-     g_warning("FIXME: implement gq_tree_set_node_text()");
+     gq_browser_model_set_label(tree_widget->model, node, text);
 #endif
 }
 
@@ -400,11 +519,10 @@ gq_tree_get_node_data (GQTreeWidget*     self,
 
      return gtk_ctree_node_get_row_data (self, node);
 #else
-     gpointer retval = NULL;
-     gtk_tree_model_get(gtk_tree_view_get_model(GTK_TREE_VIEW(self)), node,
-		        COLUMN_DATA, &retval,
-			-1);
-     return retval;
+     g_return_val_if_fail (self, NULL);
+     g_return_val_if_fail (node, NULL);
+
+     return gq_browser_model_get_data(node);
 #endif
 }
 
@@ -417,9 +535,9 @@ gq_tree_get_root_node (GQTreeWidget *tree_widget)
 
      return gtk_ctree_node_nth (tree_widget, 0);
 #else
-#warning "FIXME: implement gq_tree_get_root_node()"
-     g_warning("FIXME: implement gq_tree_get_root_node()");
-     return NULL;
+     g_return_val_if_fail (tree_widget, NULL);
+
+     return gq_browser_model_get_child(tree_widget->model, NULL, 0);
 #endif
 }
 
@@ -433,8 +551,7 @@ gq_tree_fire_expand_callback (GQTreeWidget *tree_widget,
      gtk_ctree_toggle_expansion (tree_widget, node);
      gtk_ctree_toggle_expansion (tree_widget, node);
 #else
-#warning "FIXME: implement gq_tree_fire_expand_callback()"
-     g_warning("FIXME: implement gq_tree_fire_expand_callback()");
+     call_expand_callback(tree_widget, node);
 #endif
 }
 
@@ -450,9 +567,38 @@ gq_tree_get_parent_node (GQTreeWidget *tree_widget,
 
      return GTK_CTREE_ROW(node)->parent;
 #else
-#warning "FIXME: implement gq_tree_get_parent_node()"
-     g_warning("FIXME: implement gq_tree_get_parent_node()");
-     return NULL;
+     g_return_val_if_fail (tree_widget, NULL);
+     g_return_val_if_fail (node, NULL);
+
+     return gq_browser_model_get_parent(node);
+#endif
+}
+
+GQTreeWidgetNode*
+gq_tree_get_first_child (GQTreeWidget *tree_widget,
+			 GQTreeWidgetNode *node)
+{
+     g_return_val_if_fail (tree_widget, NULL);
+
+#ifndef USE_TREE_VIEW
+     return node ? GTK_CTREE_ROW(node)->children
+	  : gtk_ctree_node_nth(tree_widget, 0);
+#else
+     return gq_browser_model_get_child(tree_widget->model, node, 0);
+#endif
+}
+
+GQTreeWidgetNode*
+gq_tree_get_next_sibling (GQTreeWidget *tree_widget,
+			  GQTreeWidgetNode *node)
+{
+     g_return_val_if_fail (tree_widget, NULL);
+     g_return_val_if_fail (node, NULL);
+
+#ifndef USE_TREE_VIEW
+     return GTK_CTREE_ROW(node)->sibling;
+#else
+     return gq_browser_model_get_next(node);
 #endif
 }
 
@@ -479,9 +625,17 @@ gq_tree_is_node_expanded (GQTreeWidget *tree_widget,
 
      return is_expanded;
 #else
-#warning "FIXME: implement gq_tree_is_node_expanded()"
-     g_warning("FIXME: implement gq_tree_is_node_expanded()");
-     return FALSE;
+     GtkTreePath *path;
+     gboolean is_expanded;
+
+     g_return_val_if_fail (tree_widget, FALSE);
+     g_return_val_if_fail (node, FALSE);
+
+     path = node_path(tree_widget, node);
+     is_expanded = gtk_tree_view_row_expanded(GTK_TREE_VIEW(tree_widget), path);
+     gtk_tree_path_free(path);
+
+     return is_expanded;
 #endif
 }
 
@@ -495,8 +649,14 @@ gq_tree_expand_node (GQTreeWidget *tree_widget,
 
      gtk_ctree_expand (tree_widget, node);
 #else
-#warning "FIXME: implement gq_tree_expand_node()"
-     g_warning("FIXME: implement gq_tree_expand_node()");
+     GtkTreePath *path;
+
+     g_return_if_fail (tree_widget);
+     g_return_if_fail (node);
+
+     path = node_path(tree_widget, node);
+     gtk_tree_view_expand_to_path(GTK_TREE_VIEW(tree_widget), path);
+     gtk_tree_path_free(path);
 #endif
 }
 
@@ -510,8 +670,18 @@ gq_tree_toggle_expansion (GQTreeWidget *tree_widget,
 
      gtk_ctree_toggle_expansion (tree_widget, node);
 #else
-#warning "FIXME: implement gq_tree_toggle_expansion()"
-     g_warning("FIXME: implement gq_tree_toggle_expansion()");
+     GtkTreePath *path;
+
+     g_return_if_fail (tree_widget);
+     g_return_if_fail (node);
+
+     path = node_path(tree_widget, node);
+     if (gtk_tree_view_row_expanded(GTK_TREE_VIEW(tree_widget), path)) {
+	  gtk_tree_view_collapse_row(GTK_TREE_VIEW(tree_widget), path);
+     } else {
+	  gtk_tree_view_expand_row(GTK_TREE_VIEW(tree_widget), path, FALSE);
+     }
+     gtk_tree_path_free(path);
 #endif
 }
 
@@ -525,8 +695,24 @@ gq_tree_select_node (GQTreeWidget *tree_widget,
 
      gtk_ctree_select (tree_widget, node);
 #else
-#warning "FIXME: implement gq_tree_select_node()"
-     g_warning("FIXME: implement gq_tree_select_node()");
+     GqTreeWidgetNode *parent;
+     GtkTreePath *path;
+
+     g_return_if_fail (tree_widget);
+     g_return_if_fail (node);
+
+     /* the view only selects rows it shows */
+     parent = gq_browser_model_get_parent(node);
+     if (parent) {
+	  path = node_path(tree_widget, parent);
+	  gtk_tree_view_expand_to_path(GTK_TREE_VIEW(tree_widget), path);
+	  gtk_tree_path_free(path);
+     }
+
+     path = node_path(tree_widget, node);
+     gtk_tree_selection_select_path(gtk_tree_view_get_selection(GTK_TREE_VIEW(tree_widget)),
+				    path);
+     gtk_tree_path_free(path);
 #endif
 }
 
@@ -546,9 +732,22 @@ gq_tree_get_node_at (GQTreeWidget *tree_widget,
 
      return gtk_ctree_node_nth(GTK_CTREE(tree_widget), row);
 #else
-#warning "FIXME: implement gq_tree_get_node_at()"
-     g_warning("FIXME: implement gq_tree_get_node_at(");
-     return NULL;
+     GtkTreePath *path;
+     GtkTreeIter iter;
+     gboolean found;
+
+     g_return_val_if_fail (tree_widget, NULL);
+
+     if (!gtk_tree_view_get_path_at_pos(GTK_TREE_VIEW(tree_widget), x, y,
+					&path, NULL, NULL, NULL)) {
+	  return NULL;
+     }
+     found = gtk_tree_model_get_iter(GTK_TREE_MODEL(tree_widget->model),
+				     &iter, path);
+     gtk_tree_path_free(path);
+
+     return found ? gq_browser_model_iter_to_node(tree_widget->model, &iter)
+	  : NULL;
 #endif
 }
 
@@ -561,20 +760,46 @@ G_DEFINE_TYPE(GqTreeWidget, gq_tree_widget,
 #endif
 	      );
 
+#ifdef USE_TREE_VIEW
+static gboolean
+tree_test_expand_row(GtkTreeView* view,
+		     GtkTreeIter* iter,
+		     GtkTreePath* path,
+		     gpointer     user_data)
+{
+	GqTreeWidget* self = GQ_TREE_WIDGET(view);
+
+	/* the children get inserted here, before the row opens */
+	call_expand_callback(self, gq_browser_model_iter_to_node(self->model, iter));
+	return FALSE;
+}
+#endif
+
 static void
 gq_tree_widget_init(GqTreeWidget* self) {
 #ifdef USE_TREE_VIEW
-	GtkTreeView* tv = GTK_TREE_VIEW(self);
+	GtkTreeView*       tv = GTK_TREE_VIEW(self);
+	GtkTreeViewColumn* column;
+
 	gtk_tree_view_set_headers_visible(tv, FALSE);
-	self->model = GTK_TREE_MODEL(gtk_tree_store_new(N_COLUMNS, G_TYPE_STRING, G_TYPE_OBJECT));
-	gtk_tree_view_set_model(tv, self->model);
-	gtk_tree_view_insert_column_with_attributes(tv, -1,
-						    NULL, gtk_cell_renderer_text_new(),
-						    "text", COLUMN_LABEL,
-						    NULL);
+	self->model = GQ_BROWSER_MODEL(gq_browser_model_new());
+	gtk_tree_view_set_model(tv, GTK_TREE_MODEL(self->model));
+	/* the view keeps it */
+	g_object_unref(self->model);
+
+	column = gtk_tree_view_column_new_with_attributes(NULL,
+							  gtk_cell_renderer_text_new(),
+							  "text", GQ_BROWSER_MODEL_COL_LABEL,
+							  NULL);
+	gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width(column, TREE_COLUMN_WIDTH);
+	gtk_tree_view_append_column(tv, column);
+	gtk_tree_view_set_fixed_height_mode(tv, TRUE);
+
+	g_signal_connect(self, "test-expand-row",
+			 G_CALLBACK(tree_test_expand_row), NULL);
 #endif
 }
 
 static void
 gq_tree_widget_class_init(GqTreeWidgetClass* self_class) {}
-
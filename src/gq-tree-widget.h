@@ -24,11 +24,14 @@
 #ifndef GQ_TREE_WIDGET_H
 #define GQ_TREE_WIDGET_H
 
-#undef USE_TREE_VIEW
+/* Built with -DUSE_TREE_VIEW (configure --enable-tree-view) the
+   browser tree is a GtkTreeView on a GqBrowserModel, otherwise the
+   GtkCTree it always was. */
 #ifndef USE_TREE_VIEW
 #include <gtk/gtkctree.h>
 #else
-#include <gtk/gtktreemodel.h>
+#include <gtk/gtktreeview.h>
+#include "gq-browser-model.h"
 #endif
 
 G_BEGIN_DECLS
@@ -43,20 +46,19 @@ typedef GtkCTreeFunc GqTreeWidgetFunc;
 #define GQ_TREE_WIDGET_NODE(i) GTK_CTREE_NODE(i)
 #else
 typedef struct _GqTreeWidget      GqTreeWidget;
-typedef GtkTreeIter               GqTreeWidgetNode;
-typedef struct {
-	GqTreeWidgetNode* parent;
-	GqTreeWidgetNode* sibling;
-} GqTreeWidgetRow;
-typedef GCallback                 GqTreeWidgetFunc;
-#define GQ_TREE_WIDGET_ROW(i)       ((GqTreeWidgetRow*)(i))
+typedef GqBrowserModelNode        GqTreeWidgetNode;
+typedef void (*GqTreeWidgetFunc) (GqTreeWidget*     self,
+				  GqTreeWidgetNode* node,
+				  gpointer          data);
 #define GQ_TREE_WIDGET_NODE(i)      ((GqTreeWidgetNode*)(i))
 #endif
 
 /* compatibility for the old definition */
 typedef GqTreeWidget     GQTreeWidget;
 typedef GqTreeWidgetNode GQTreeWidgetNode;
+#ifndef USE_TREE_VIEW
 typedef GqTreeWidgetRow  GQTreeWidgetRow;
+#endif
 typedef GqTreeWidgetFunc GQTreeWidgetFunc;
 
 #define GQ_TYPE_TREE_WIDGET         (gq_tree_widget_get_type())
@@ -98,6 +100,15 @@ void              gq_tree_widget_sort_node              (GqTreeWidget*     self,
 							 GqTreeWidgetNode* node);
 void              gq_tree_widget_unselect               (GqTreeWidget*     self,
 							 GqTreeWidgetNode* node);
+gboolean          gq_tree_widget_has_selection          (GqTreeWidget*     self);
+/* children inserted with auto sorting on go where they sort to */
+void              gq_tree_widget_set_auto_sort          (GqTreeWidget*     self,
+							 gboolean          auto_sort);
+/* brackets larger changes, updating the view only once */
+void              gq_tree_widget_freeze                 (GqTreeWidget*     self);
+void              gq_tree_widget_thaw                   (GqTreeWidget*     self);
+/* the window button events on the rows arrive at */
+GdkWindow*        gq_tree_widget_get_bin_window         (GqTreeWidget*     self);
 
 void              gq_tree_widget_node_set_row_data_full (GqTreeWidget*     self,
 							 GqTreeWidgetNode* node,
@@ -138,6 +149,13 @@ void              gq_tree_fire_expand_callback (GQTreeWidget *tree_widget,
 GQTreeWidgetNode* gq_tree_get_parent_node (GQTreeWidget *tree_widget,
 			 GQTreeWidgetNode *node);
 
+/* node NULL: the first top level node */
+GQTreeWidgetNode* gq_tree_get_first_child (GQTreeWidget *tree_widget,
+			 GQTreeWidgetNode *node);
+
+GQTreeWidgetNode* gq_tree_get_next_sibling (GQTreeWidget *tree_widget,
+			 GQTreeWidgetNode *node);
+
 gboolean          gq_tree_is_node_expanded (GQTreeWidget *tree_widget,
 				GQTreeWidgetNode *node);
 
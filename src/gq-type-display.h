@@ -40,6 +40,12 @@ G_BEGIN_DECLS
 typedef        GObject               GQTypeDisplay;
 typedef struct _type_display_handler GQTypeDisplayClass;
 
+/* turns a value into the number it sorts by, FALSE if it is none */
+typedef gboolean (*GqSortNumberFunc)(const char *value, gdouble *num);
+/* the same for integers, which a gdouble cannot hold exactly beyond
+   2^53 */
+typedef gboolean (*GqSortIntegerFunc)(const char *value, gint64 *num);
+
 GType gq_type_display_get_type(void);
 
 struct _type_display_handler {
@@ -61,6 +67,9 @@ struct _type_display_handler {
 	LDAPMod* (*buildLDAPMod)(struct formfill *form,
 			      int op,
 			      GList *values);
+	/* both NULL for types whose values sort as text */
+	GqSortNumberFunc sort_number;
+	GqSortIntegerFunc sort_integer;
 };
 
 G_END_DECLS
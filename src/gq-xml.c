@@ -446,6 +446,24 @@ static void ldapserver_cache_connectionE(struct parser_context *ctx,
     if (b >= 0) server->cacheconn = b;
 }
 
+static void ldapserver_live_updatesE(struct parser_context *ctx,
+				     struct tagstack_entry *e)
+{
+    GqServer *server = peek_tag(ctx->stack, 1)->data;
+
+    int b = booleanCDATA(ctx, e);
+    if (b >= 0) server->live_updates = b;
+}
+
+static void ldapserver_warm_upE(struct parser_context *ctx,
+				struct tagstack_entry *e)
+{
+    GqServer *server = peek_tag(ctx->stack, 1)->data;
+
+    int b = booleanCDATA(ctx, e);
+    if (b >= 0) server->warmup = b;
+}
+
 static void ldapserver_local_cache_timeoutE(struct parser_context *ctx,
 					    struct tagstack_entry *e)
 {
@@ -464,6 +482,15 @@ static void ldapserver_maxentriesE(struct parser_context *ctx,
     if (l >= 0) server->maxentries = l;
 }
 
+static void ldapserver_browse_window_sizeE(struct parser_context *ctx,
+					   struct tagstack_entry *e)
+{
+    GqServer *server = peek_tag(ctx->stack, 1)->data;
+
+    long l = longCDATA(ctx, e);
+    if (l >= 0) server->browse_window = l;
+}
+
 
 
 
@@ -892,6 +919,21 @@ static struct xml_tag config_tags[] = {
 	NULL, ldapserver_maxentriesE, 
 	{ "ldapserver", NULL },
     },
+    { 
+	"browse-window-size", 0, 
+	NULL, ldapserver_browse_window_sizeE, 
+	{ "ldapserver", NULL },
+    },
+    { 
+	"live-updates", 0, 
+	NULL, ldapserver_live_updatesE, 
+	{ "ldapserver", NULL },
+    },
+    { 
+	"warm-up", 0, 
+	NULL, ldapserver_warm_upE, 
+	{ "ldapserver", NULL },
+    },
 
     /* templates */
     { 
@@ -40,6 +40,7 @@
 #endif /* DEBUG */
 
 #include "gq-server-list.h"
+#include "gq-server-warmup.h"
 #include "mainwin.h"
 #include "configfile.h"
 #include "syntax.h"
@@ -64,6 +65,8 @@ main(int argc, char **argv) {
 
 /*      return main_test(argc, argv); */
 
+     /* sorting large search results uses threads */
+     if (!g_thread_supported()) g_thread_init(NULL);
 
 #if ENABLE_NLS
      setlocale(LC_ALL, "");
@@ -136,6 +139,7 @@ main(int argc, char **argv) {
      }
 
      create_mainwin(&mainwin);
+     gq_server_warmup_all();
 
 #ifdef DEBUG
 #  ifdef HAVE_MALLINFO
@@ -1253,46 +1253,69 @@ void update_formlist(struct inputform *iform)
 	with more authorative (newer) data anyway */
 
      for (fl = formlist ; fl ; fl = fl->next ) {
+	  GQTypeDisplayClass* klass;
+	  GPtrArray *texts;
+	  gchar **plain, **encoded;
+	  int i;
+
 	  ff = (struct formfill *) fl->data;
 	  free_formfill_values(ff);
 
 	  displaytype = ff->displaytype;
+	  if (!displaytype) continue;
 
-	  for (children = ff->widgetList ; children ;
-	       children = children->next) {
-	       child = GTK_WIDGET(children->data);
-
-	       if(ff && displaytype) {
-		    GQTypeDisplayClass* klass = g_type_class_ref(ff->dt_handler);
-		    GByteArray *ndata = NULL;
-		    content = NULL;
-
-		    if (klass && klass->get_data) {
-			 ndata = klass->get_data(ff, child);
-		    } else if (content && strlen(content) > 0) {
-			 int l;
-			 content_enc = encoded_string(content);
-			 g_free(content);
-
-			 l = strlen(content_enc);
-
-			 ndata = g_byte_array_new();
-			 g_byte_array_set_size(ndata, l + 1);
-			 memcpy(ndata->data, content_enc, l);
-			 free(content_enc);
+	  klass = g_type_class_ref(ff->dt_handler);
+	  if (klass && klass->get_data) {
+	       for (children = ff->widgetList ; children ;
+		    children = children->next) {
+		    GByteArray *ndata;
 
-			 /* uuuhhh, so ugly... */
-			 ndata->data[l] = 0;
+		    child = GTK_WIDGET(children->data);
+		    ndata = klass->get_data(ff, child);
 
-			 g_byte_array_set_size(ndata, l);
-		    }
 		    /* don't bother adding in empty fields */
 		    if(ndata) {
 			 ff->values = g_list_append(ff->values, ndata);
 		    }
-		    g_type_class_unref(klass);
+	       }
+	       g_type_class_unref(klass);
+	       continue;
+	  }
+
+	  /* plain text fields: collect all values and convert them in
+	     one go */
+	  texts = g_ptr_array_new();
+	  for (children = ff->widgetList ; children ;
+	       children = children->next) {
+	       child = GTK_WIDGET(children->data);
+	       if (!GTK_IS_EDITABLE(child)) continue;
+
+	       content = gtk_editable_get_chars(GTK_EDITABLE(child), 0, -1);
+	       /* don't bother adding in empty fields */
+	       if (content && strlen(content) > 0) {
+		    g_ptr_array_add(texts, content);
+	       } else {
+		    g_free(content);
 	       }
 	  }
+	  g_ptr_array_add(texts, NULL);
+	  plain = (gchar **) g_ptr_array_free(texts, FALSE);
+
+	  encoded = encoded_strv((const gchar * const *) plain);
+	  for (i = 0 ; encoded[i] ; i++) {
+	       int l = strlen(encoded[i]);
+	       GByteArray *ndata = g_byte_array_new();
+
+	       /* keep a NUL byte after the value */
+	       g_byte_array_append(ndata, (guchar *) encoded[i], l + 1);
+	       g_byte_array_set_size(ndata, l);
+
+	       ff->values = g_list_append(ff->values, ndata);
+	  }
+	  g_strfreev(encoded);
+	  g_strfreev(plain);
+
+	  if (klass) g_type_class_unref(klass);
      }
      /* take care of the dn input widget */
      if(iform->dn_widget) {
@@ -1394,6 +1417,7 @@ static int add_entry_from_formlist_no_close(int add_context,
      char *dn;
      char *parentdn, **rdn;
      LDAPControl c, *ctrls[2] = { NULL, NULL } ;
+     gdouble start;
 
      c.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
      c.ldctl_value.bv_val	= NULL;
@@ -1458,11 +1482,13 @@ static int add_entry_from_formlist_no_close(int add_context,
      }
      mods[cmod] = NULL;
 
+     start = gq_server_stats_start();
      res = ldap_add_ext_s(ld, dn, mods, ctrls, NULL);
 
      if(res == LDAP_NOT_SUPPORTED) {
 	  res = ldap_add_s(ld, dn, mods);
      }
+     gq_server_stats_stop(server, GQ_STAT_ADD, start, res == LDAP_SUCCESS);
 
      ldap_mods_free(mods, 1);
 
@@ -1541,6 +1567,7 @@ void mod_entry_from_formlist(struct inputform *iform)
      GQTreeWidget *ctreeroot = NULL;
      int do_modrdn = 0;
      int error = 0;
+     gdouble start;
 
      update_formlist(iform);
 
@@ -1600,11 +1627,13 @@ void mod_entry_from_formlist(struct inputform *iform)
 
 /*   dump_mods(mods); */
 
+	  start = gq_server_stats_start();
 	  res = ldap_modify_ext_s(ld, dn, mods, ctrls, NULL);
 
 	  if(res == LDAP_NOT_SUPPORTED) {
 	       res = ldap_modify_s(ld, dn, mods);
 	  }
+	  gq_server_stats_stop(server, GQ_STAT_MODIFY, start, res == LDAP_SUCCESS);
 
 	  if (res == LDAP_SERVER_DOWN) {
 	       server->server_down++;
@@ -1659,6 +1688,7 @@ int change_rdn(struct inputform *iform, int context)
      char **oldrdn, **rdn;
      char *noattrs[] = { LDAP_NO_ATTRS, NULL };
      LDAPMessage *res = NULL;
+     gdouble start;
 
 #if defined(HAVE_LDAP_RENAME)
      LDAPControl cc, *ctrls[2] = { NULL, NULL } ;
@@ -1730,6 +1760,7 @@ int change_rdn(struct inputform *iform, int context)
 	  if (res) ldap_msgfree(res);
 /*  	  printf("oldrdn[0]=%s, remove=%d\n", oldrdn[0], remove_flag); */
 
+	  start = gq_server_stats_start();
 #if defined(HAVE_LDAP_RENAME)
 	  /* see draft-ietf-ldapext-ldap-c-api-xx.txt for details */
 	  rc = ldap_rename_s(ld,
@@ -1744,6 +1775,7 @@ int change_rdn(struct inputform *iform, int context)
 #else
 	  rc = ldap_modrdn2_s(ld, olddn, rdn[0], remove_flag);
 #endif
+	  gq_server_stats_stop(server, GQ_STAT_RENAME, start, rc == LDAP_SUCCESS);
 	  if(rc == LDAP_SUCCESS) {
 	       /* get ready for subsequent DN changes */
 	       g_free(olddn);
@@ -36,6 +36,8 @@
 #include "ldapops.h"
 #include "util.h"
 #include "errorchain.h"
+#include "gq-progress.h"
+#include "gq-server-stats.h"
 
 static char * move_entry_internal(LDAPMessage *e,
 				  char *source_dn,
@@ -108,10 +110,9 @@ char * move_entry(char *source_dn, GqServer *source_server,
 	  if (rc == LDAP_SERVER_DOWN) {
 	       source_server->server_down++;
 	  }
-	  error_push(err_ctx, 
-		     _("Error during base search for '%1$s': %2$s"),
-		     source_dn,
-		     ldap_err2string(ldap_result2error(sld, res, 0)));
+	  error_push_ldap(err_ctx, _("Searching"), rc,
+			  _("Error during base search for '%1$s': %2$s"),
+			  source_dn, ldap_err2string(rc));
 	  push_ldap_addl_error(sld, err_ctx); 
 /*  	  ldap_perror(sld, "search"); */
 	  goto fail;
@@ -167,6 +168,7 @@ static char * move_entry_internal(LDAPMessage *e,
 /*      char *dn_only[] = { "dn", NULL }; */
      LDAPControl c;
      LDAPControl *ctrls[2] = { NULL, NULL } ;
+     gdouble start;
 
      c.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
      c.ldctl_value.bv_val	= NULL;
@@ -188,6 +190,7 @@ static char * move_entry_internal(LDAPMessage *e,
 
      if (sld == tld && (flags & MOVE_DELETE_MOVED) && 
 	 source_server->version == LDAP_VERSION3) {
+	  start = gq_server_stats_start();
 	  rc = ldap_rename_s(sld,
 			     source_dn,		/* dn */
 			     sdn[0],		/* newrdn */
@@ -196,6 +199,8 @@ static char * move_entry_internal(LDAPMessage *e,
 			     ctrls,		/* serverctrls */
 			     NULL		/* clientctrls */
 			     );
+	  gq_server_stats_stop(source_server, GQ_STAT_RENAME, start,
+			       rc == LDAP_SUCCESS);
 
 	  if (rc == LDAP_SUCCESS) {
 /*  	       printf("ldap_rename %s -> %s rc=%d\n", */
@@ -204,10 +209,10 @@ static char * move_entry_internal(LDAPMessage *e,
 	       goto done;
 	  } else if (rc == LDAP_SERVER_DOWN) {
 	       source_server->server_down++;
-  	       error_push(error_context, 
-			  _("Error renaming entry '%1$s': %2$s"),
-			  source_dn,
-			  ldap_err2string(rc));
+  	       error_push_ldap(error_context, _("Renaming entries"), rc,
+			       _("Error renaming entry '%1$s': %2$s"),
+			       source_dn,
+			       ldap_err2string(rc));
 	       goto done;
 	  } else {
 	       /* we probably have a subtree - do not indicate an error */
@@ -251,7 +256,10 @@ static char * move_entry_internal(LDAPMessage *e,
      if (berptr) ber_free(berptr, 0);
 #endif
 
+     start = gq_server_stats_start();
      rc = ldap_add_s(tld, newdn, mods);
+     gq_server_stats_stop(target_server, GQ_STAT_ADD, start,
+			  rc == LDAP_SUCCESS);
 /*       printf("ldap_add %s rc=%d\n", newdn, rc); */
      for (i = 0 ; i < n ; i++) {
 	  ldap_memfree(mods[i]->mod_type);
@@ -260,10 +268,10 @@ static char * move_entry_internal(LDAPMessage *e,
      ldap_mods_free(mods, 1);
      
      if (rc != LDAP_SUCCESS) {
-	  error_push(error_context, 
-		     _("Error adding new entry '%1$s': %2$s"),
-		     newdn,
-		     ldap_err2string(rc));
+	  error_push_ldap(error_context, _("Adding entries"), rc,
+			  _("Error adding new entry '%1$s': %2$s"),
+			  newdn,
+			  ldap_err2string(rc));
 	  push_ldap_addl_error(tld, error_context); 
 /*  	  ldap_perror(sld, "ldap_add"); */
 	  goto done;
@@ -352,14 +360,14 @@ static char * move_entry_internal(LDAPMessage *e,
 			 }			      
 		    } else if (rc == LDAP_SERVER_DOWN) {
 			 source_server->server_down++;
-			 error_push(error_context, 
-				    _("Error searching below '%1$s': %2$s"),
-				    source_dn,
-				    ldap_err2string(rc));
+			 error_push_ldap(error_context, _("Searching"), rc,
+					 _("Error searching below '%1$s': %2$s"),
+					 source_dn,
+					 ldap_err2string(rc));
 		    } else {
-			 error_push(error_context, 
-				    _("Error searching below '%1$s': %2$s"),
-				    source_dn, ldap_err2string(rc));
+			 error_push_ldap(error_context, _("Searching"), rc,
+					 _("Error searching below '%1$s': %2$s"),
+					 source_dn, ldap_err2string(rc));
 			 push_ldap_addl_error(sld, error_context); 
 		    }			 
 		    if (res) {
@@ -377,11 +385,14 @@ static char * move_entry_internal(LDAPMessage *e,
 	  */
 	  
 	  if (flags & MOVE_DELETE_MOVED && ok) {
+	       start = gq_server_stats_start();
 	       rc = ldap_delete_ext_s(sld, source_dn, ctrls, NULL);
 
 	       if(rc == LDAP_NOT_SUPPORTED) {
 		    rc = ldap_delete_s(sld, source_dn);
 	       }
+	       gq_server_stats_stop(source_server, GQ_STAT_DELETE, start,
+				    rc == LDAP_SUCCESS);
 
 
 #if HAVE_LDAP_CLIENT_CACHE
@@ -392,9 +403,9 @@ static char * move_entry_internal(LDAPMessage *e,
 		    if (rc == LDAP_SERVER_DOWN) {
 			 source_server->server_down++;
 		    }
-		    error_push(error_context, 
-			       _("Error deleting '%1$s': %2$s"),
-			       source_dn, ldap_err2string(rc));
+		    error_push_ldap(error_context, _("Deleting entries"), rc,
+				    _("Error deleting '%1$s': %2$s"),
+				    source_dn, ldap_err2string(rc));
 		    push_ldap_addl_error(sld, error_context); 
 		    goto done;
 	       }
@@ -416,6 +427,174 @@ static char * move_entry_internal(LDAPMessage *e,
 }
 
 
+int list_referrals(int error_context, LDAP *ld, const char *dn,
+		   ListFunc func, gpointer data)
+{
+     LDAPMessage *res = NULL, *e;
+     LDAPControl ct;
+     LDAPControl *ctrls[2] = { NULL, NULL } ;
+     char *ref[] = { "ref", NULL };
+     int msg, rc, i, n = 0;
+
+     ct.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+     ct.ldctl_value.bv_val	= NULL;
+     ct.ldctl_value.bv_len	= 0;
+     ct.ldctl_iscritical	= 1;
+
+     ctrls[0] = &ct;
+
+     rc = ldap_search_ext(ld, dn,
+			  LDAP_SCOPE_BASE, 
+			  "(objectClass=referral)", ref, 0,
+			  ctrls,		/* serverctrls */
+			  NULL,		/* clientctrls */
+			  NULL,		/* timeout */
+			  LDAP_NO_LIMIT,	/* sizelimit */
+			  &msg);
+     if (rc != LDAP_SUCCESS) return 0;
+
+     while((rc = ldap_result(ld, msg, 0,
+			     NULL, &res)) == LDAP_RES_SEARCH_ENTRY) {
+	  for(e = ldap_first_entry(ld, res) ; e != NULL ;
+	      e = ldap_next_entry(ld, e)) {
+	       char **vals = ldap_get_values(ld, e, "ref");
+
+	       if (vals == NULL) continue;
+
+	       for(i = 0; vals[i]; i++) {
+		    func(vals[i], data);
+		    n++;
+	       }
+	       ldap_value_free(vals);
+	  }
+	  ldap_msgfree(res);
+	  res = NULL;
+     }
+     if (res) ldap_msgfree(res);
+
+     return n;
+}
+
+int list_children(int error_context, GqServer *server, LDAP *ld,
+		  const char *dn, ListFunc func, gpointer data, int *err)
+{
+     LDAPMessage *res = NULL, *e;
+     LDAPControl ct;
+     LDAPControl *ctrls[2] = { NULL, NULL } ;
+     char *dummy[] = { "dummy", NULL };
+     char *matched = NULL, **refs = NULL;
+     int msg, rc, i, num_children = 0;
+     gdouble start, rstart;
+     GqProgress *progress;
+
+     ct.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+     ct.ldctl_value.bv_val	= NULL;
+     ct.ldctl_value.bv_len	= 0;
+     ct.ldctl_iscritical	= 1;
+
+     ctrls[0] = &ct;
+
+     *err = LDAP_SUCCESS;
+
+     start = gq_server_stats_start();
+     rc = ldap_search_ext(ld, dn,
+			  LDAP_SCOPE_ONELEVEL, 
+			  "(objectClass=*)", dummy, 1,
+			  ctrls,		/* serverctrls */
+			  NULL,		/* clientctrls */
+			  NULL,		/* timeout */
+			  LDAP_NO_LIMIT,	/* sizelimit */
+			  &msg);
+     if (rc != LDAP_SUCCESS) {
+	  gq_server_stats_stop(server, GQ_STAT_SEARCH, start, FALSE);
+	  if (rc == LDAP_SERVER_DOWN) {
+	       server->server_down++;
+	  } else {
+	       error_push(error_context,
+			  _("Error while searching below '%1$s': %2$s"),
+			  dn, ldap_err2string(rc));
+	  }
+	  *err = rc;
+	  return 0;
+     }
+
+     progress = gq_progress_new(_("Entries found"), 0);
+
+     while( (rc = ldap_result(ld, msg, 0,
+			      NULL, &res)) == LDAP_RES_SEARCH_ENTRY) {
+	  for(e = ldap_first_entry(ld, res) ; e != NULL ;
+	      e = ldap_next_entry(ld, e)) {
+	       char *child = ldap_get_dn(ld, e);
+
+	       if (num_children == 0) {
+		    gq_server_stats_stop(server, GQ_STAT_SEARCH_FIRST,
+					 start, TRUE);
+	       }
+
+	       rstart = gq_server_stats_start();
+	       func(child, data);
+	       gq_server_stats_stop(server, GQ_STAT_RENDER, rstart, TRUE);
+	       if (child) ldap_memfree(child);
+
+	       num_children++;
+	       gq_progress_add(progress, 1);
+	  }
+	  ldap_msgfree(res);
+	  res = NULL;
+     }
+     gq_progress_finish(progress);
+     gq_server_stats_stop(server, GQ_STAT_SEARCH, start,
+			  rc == LDAP_RES_SEARCH_RESULT);
+     gq_server_stats_entries(server, num_children);
+     gq_server_stats_rendered(server, num_children);
+
+     ldap_get_option(ld, LDAP_OPT_ERROR_NUMBER, &rc);
+
+     if (rc == LDAP_SERVER_DOWN) {
+	  server->server_down++;
+	  *err = rc;
+	  goto done;
+     }
+
+     if (res) {
+	  rc = ldap_parse_result(ld, res,
+				 err, &matched, NULL, &refs, NULL, 0);
+     }
+
+     if (rc != LDAP_SUCCESS) {	
+	  /* FIXME: better error message (but what is the exact cause?)*/
+	  error_push(error_context, ldap_err2string(rc));
+	  push_ldap_addl_error(ld, error_context);
+
+	  if (rc == LDAP_SERVER_DOWN) {
+	       server->server_down++;
+	  }
+	  *err = rc;
+     } else if (*err != LDAP_SUCCESS &&
+		*err != LDAP_SIZELIMIT_EXCEEDED &&
+		*err != LDAP_TIMELIMIT_EXCEEDED) {
+	  error_push(error_context, ldap_err2string(*err));
+	  push_ldap_addl_error(ld, error_context);
+	  if (matched && strlen(matched)) {
+	       error_push(error_context, _("Matched DN: %s"), matched);
+	  }
+	  if (refs) {
+	       for (i = 0 ; refs[i] ; i++) {
+		    error_push(error_context,
+			       _("Referral to: %s"), refs[i]);
+	       }
+	  }
+     }
+
+ done:
+     if (matched) ldap_memfree(matched);
+     if (refs) ldap_value_free(refs);
+     if (res) ldap_msgfree(res);
+
+     return num_children;
+}
+
+
 
 /* 
    Local Variables:
@@ -29,6 +29,7 @@
 
 #include <glib.h>
 #include <gtk/gtk.h>
+#include <ldap.h>
 
 #include "common.h"
 
@@ -44,6 +45,22 @@ char * move_entry(char *source_dn, GqServer *source_server,
 		  MoveProgressFunc progress,
 		  int err_ctx);
 
+/* called with each value found when listing below an entry */
+typedef void (*ListFunc)(const char *value, gpointer data);
+
+/* If dn is a referral object, calls func with each of its referral
+   URLs. Returns how many there were, 0 for an ordinary entry. */
+int list_referrals(int error_context, LDAP *ld, const char *dn,
+		   ListFunc func, gpointer data);
+
+/* Calls func with the DN of every immediate child of dn, in the
+   order the server sends them. Returns the number of children. *err
+   gets the outcome of the search: LDAP_SUCCESS, one of the size and
+   time limits, LDAP_SERVER_DOWN or whatever else went wrong (the
+   latter pushed to error_context). */
+int list_children(int error_context, GqServer *server, LDAP *ld,
+		  const char *dn, ListFunc func, gpointer data, int *err);
+
 #endif
 
 /* 
@@ -37,6 +37,7 @@
 
 #include "common.h"
 #include "gq-server-list.h"
+#include "gq-server-stats.h"
 #include "gq-tab-browse.h"
 #ifdef HAVE_LDAP_STR2OBJECTCLASS
 #    include "gq-tab-schema.h"
@@ -101,7 +102,6 @@ append_name(GQServerList* list, GqServer* server, gpointer data) {
 void fill_serverlist_combo(GtkWidget *combo)
 {
      GList *serverlist = NULL;
-     GqServer *server;
 
      if(combo == NULL)
 	  return;
@@ -600,6 +600,15 @@ void create_mainwin(struct mainwin_data *win)
 			       G_CALLBACK(message_log),
 			       win);
 
+     /* File | Server Statistics */
+
+     menuitem = gq_menu_item_new_with_label(_("Server _Statistics"));
+     gtk_widget_show(menuitem);
+     gtk_container_add(GTK_CONTAINER(menuFile), menuitem);
+     g_signal_connect(menuitem, "activate",
+			G_CALLBACK(server_stats_window),
+			NULL);
+
      /* File | Quit */
      Quit = gq_menu_item_new_with_label(_("_Quit"));
      gtk_widget_show(Quit);
@@ -696,13 +705,15 @@ void create_mainwin(struct mainwin_data *win)
 
      gtk_widget_realize(win->mainwin);
 
+     /* browse tabs restore their paths in the background, the
+	window is usable right away */
+     gtk_widget_show(win->mainwin);
+
      if (! mainwin_restore_snapshot(win)) {
 	  new_modetab(win, SEARCH_MODE);
 	  new_modetab(win, BROWSE_MODE | 32768);
 	  new_modetab(win, SCHEMA_MODE | 32768);
      }
-
-     gtk_widget_show(win->mainwin);
 }
 
 GqTab *mainwin_get_tab_nth(struct mainwin_data *win, int n)
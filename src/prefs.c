@@ -111,10 +111,13 @@ struct server_windata {
      GtkWidget *clear_pw;
      GtkWidget *searchattr;
      GtkWidget *maxentries;
+     GtkWidget *browse_window;
      GtkWidget *localcachetimeout;
      GtkWidget *ask_pw;
      GtkWidget *hide_internal;
      GtkWidget *cacheconn;
+     GtkWidget *live_updates;
+     GtkWidget *warmup;
      GtkWidget *show_ref;
      GtkWidget *enabletls;
 };
@@ -197,9 +200,7 @@ static void server_edit_callback(GtkWidget *this, prefs_callback_data *cb_data)
      int server_name_changed;
      const char *text, *passwdtext;
      char *ep = NULL;
-#if HAVE_LDAP_CLIENT_CACHE
      int tmp;
-#endif
      GList *I;
      struct server_windata *sw = cb_data->sw;
      gboolean save_ok;
@@ -300,6 +301,17 @@ static void server_edit_callback(GtkWidget *this, prefs_callback_data *cb_data)
 	  }
      }
 
+     /* Browse window size */
+     field = sw->browse_window;
+     text = gtk_entry_get_text(GTK_ENTRY(field));
+     ep = NULL;
+     tmp = (int) strtol(text, &ep, 10);
+     if (ep && *ep) {
+	  single_warning_popup(_("Browse window size must be numeric"));
+     } else if (tmp >= 0) {
+	  server->browse_window = tmp;
+     }
+
      /* Hide internal */
      field = sw->hide_internal;
      server->hide_internal = GTK_TOGGLE_BUTTON(field)->active ? 1 : 0;
@@ -308,6 +320,14 @@ static void server_edit_callback(GtkWidget *this, prefs_callback_data *cb_data)
      field = sw->cacheconn;
      server->cacheconn = GTK_TOGGLE_BUTTON(field)->active ? 1 : 0;
 
+     /* Live updates */
+     field = sw->live_updates;
+     server->live_updates = GTK_TOGGLE_BUTTON(field)->active ? 1 : 0;
+
+     /* Warm up */
+     field = sw->warmup;
+     server->warmup = GTK_TOGGLE_BUTTON(field)->active ? 1 : 0;
+
      /* Enable TLS */
      field = sw->enabletls;
      server->enabletls = GTK_TOGGLE_BUTTON(field)->active ? 1 : 0;
@@ -889,6 +909,36 @@ create_edit_server_window(GqServer *server,
 
      gtk_label_set_mnemonic_widget(GTK_LABEL(label), entry);
 
+     /* Browse window size */
+     label = gq_label_new(_("Browse _window size"));
+     gtk_misc_set_alignment(GTK_MISC(label), 0.0, .5);
+     gtk_widget_show(label);
+     gtk_table_attach(GTK_TABLE(table2), label, 0, 1, y, y + 1,
+		      GTK_FILL, GTK_FILL, 0, 0);
+
+     entry = gtk_entry_new();
+     sw->browse_window = entry;
+     g_snprintf(tmp, sizeof(tmp), "%d", server->browse_window);
+     gtk_entry_set_text(GTK_ENTRY(entry), tmp);
+     gtk_widget_show(entry);
+     g_signal_connect(entry, "activate",
+			G_CALLBACK(server_edit_callback), cb_data);
+     gtk_table_attach(GTK_TABLE(table2), entry, 1, 2, y, y + 1,
+		      GTK_EXPAND | GTK_FILL, GTK_EXPAND | GTK_FILL, 0, 0);
+     y++;
+
+     gtk_tooltips_set_tip(tips, entry,
+			  _("The number of children shown per node when "
+			    "browsing large containers."),
+			  Q_("tooltip|If the server supports the server side "
+			     "sorting and virtual list view controls, "
+			     "containers with more children than this are "
+			     "split into sorted windows that are fetched "
+			     "only when opened. 0 disables this.")
+			  );
+
+     gtk_label_set_mnemonic_widget(GTK_LABEL(label), entry);
+
 #if HAVE_LDAP_CLIENT_CACHE
      /* Use local cache */
      label = gq_label_new(_("LDAP cache timeo_ut"));
@@ -987,6 +1037,54 @@ create_edit_server_window(GqServer *server,
 
      z++;
 
+     /* Live updates */
+     button = gq_check_button_new_with_label(_("_Live updates"));
+     sw->live_updates = button;
+     if(server->live_updates)
+	  gtk_toggle_button_set_state(GTK_TOGGLE_BUTTON(button), TRUE);
+#ifdef OLD_FOCUS_HANDLING
+     GTK_WIDGET_UNSET_FLAGS(GTK_CHECK_BUTTON(button), GTK_CAN_FOCUS);
+#endif
+     gtk_widget_show(button);
+     gtk_table_attach(GTK_TABLE(table3), button, 0, 1, z, z + 1,
+		      GTK_EXPAND | GTK_FILL, GTK_EXPAND | GTK_FILL, 0, 0);
+
+     gtk_tooltips_set_tip(tips, button,
+			  _("If set: Show changes made by others below "
+			    "expanded browse nodes as they happen"),
+			  Q_("tooltip|Uses content synchronisation (RFC 4533) "
+			     "or persistent search, whichever the server "
+			     "supports. Every expanded node keeps one "
+			     "search open on the server.")
+			  );
+
+     z++;
+
+     /* Warm up */
+     button = gq_check_button_new_with_label(_("_Warm up at startup"));
+     sw->warmup = button;
+     if(server->warmup)
+	  gtk_toggle_button_set_state(GTK_TOGGLE_BUTTON(button), TRUE);
+#ifdef OLD_FOCUS_HANDLING
+     GTK_WIDGET_UNSET_FLAGS(GTK_CHECK_BUTTON(button), GTK_CAN_FOCUS);
+#endif
+     gtk_widget_show(button);
+     gtk_table_attach(GTK_TABLE(table3), button, 0, 1, z, z + 1,
+		      GTK_EXPAND | GTK_FILL, GTK_EXPAND | GTK_FILL, 0, 0);
+
+     gtk_tooltips_set_tip(tips, button,
+			  _("If set: Connect to the server in the "
+			    "background after startup"),
+			  Q_("tooltip|Only used together with a cached "
+			     "connection. Binds and reads the naming "
+			     "contexts and the schema right away, so the "
+			     "first browse or search does not have to "
+			     "wait for them. Servers that ask for a "
+			     "password are skipped.")
+			  );
+
+     z++;
+
      /* Enable TLS */
      button = gq_check_button_new_with_label(_("Enable _TLS"));
      sw->enabletls = button;
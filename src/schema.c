@@ -41,6 +41,7 @@
 
 #include "common.h"
 #include "configfile.h"
+#include "formfill.h"
 #include "gq-server-list.h"
 #include "schema.h"
 #include "util.h"
@@ -105,14 +106,9 @@ struct server_schema *get_server_schema(int error_context,
      BerElement *berptr;
      LDAP *ld;
      LDAPMessage *res, *e; 
-     LDAPObjectClass *oc;
-     LDAPAttributeType *at;
-     LDAPMatchingRule *mr;
-     LDAPSyntax *s;
      struct server_schema *ss;
-     int i, msg, retcode;
+     int msg;
      char *attr, **vals;
-     const char *errp;
      char *subschema = NULL;
      const char *subschemasubentry[] = { "subschemaSubentry",
 					 NULL };
@@ -213,14 +209,264 @@ struct server_schema *get_server_schema(int error_context,
 	  return(NULL);
      }
 
+     ss = parse_server_schema(ld, res);
+     ldap_msgfree(res);
+
+     if(ss)
+	  server->flags &= ~SERVER_HAS_NO_SCHEMA;
+
+     close_connection(server, FALSE);
+
+     /* cache server schema */
+     server->ss = ss;
+
+     return(ss);
+}
+
+
+/* schema names compare without regard to case */
+static guint strcase_hash(gconstpointer v)
+{
+     const char *p;
+     guint h = 5381;
+
+     for (p = v ; *p ; p++) {
+	  h = (h << 5) + h + g_ascii_tolower(*p);
+     }
+     return h;
+}
+
+static gboolean strcase_equal(gconstpointer a, gconstpointer b)
+{
+     return g_ascii_strcasecmp(a, b) == 0;
+}
+
+/* the first one with a name wins, as when searching the list */
+static void index_name(GHashTable *index, const char *name, gpointer value)
+{
+     if (name && g_hash_table_lookup(index, name) == NULL) {
+	  g_hash_table_insert(index, (gpointer) name, value);
+     }
+}
+
+/* what the schema browser shows for something without a name */
+#define SHOWN_NAME(names, oid)	((names) && (names)[0] ? (names)[0] : (oid))
+
+static void add_names(struct server_schema *ss, enum schema_detail_type type,
+		      char **names, const char *oid, void *object)
+{
+     char *only[2];
+     char **n;
+
+     if (names == NULL || names[0] == NULL) {
+	  if (oid == NULL) return;
+	  only[0] = (char *) oid;
+	  only[1] = NULL;
+	  names = only;
+     }
+
+     for (n = names ; *n ; n++) {
+	  struct schema_name *name = g_new(struct schema_name, 1);
+
+	  name->name = *n;
+	  name->folded = g_ascii_strdown(*n, -1);
+	  name->oid = oid;
+	  name->type = type;
+	  name->object = object;
+	  g_ptr_array_add(ss->names[type], name);
+     }
+}
+
+static gint compare_names(gconstpointer a, gconstpointer b)
+{
+     const struct schema_name *na = *(struct schema_name **) a;
+     const struct schema_name *nb = *(struct schema_name **) b;
+
+     return strcmp(na->folded, nb->folded);
+}
+
+/* prepends name to the list of key, unless the same thing refers to
+   key twice */
+static void add_reference(GHashTable *refs, gconstpointer key,
+			  const char *name)
+{
+     GList *l = g_hash_table_lookup(refs, key);
+
+     if (l && l->data == name) return;
+     g_hash_table_insert(refs, (gpointer) key,
+			 g_list_prepend(l, (gpointer) name));
+}
+
+static void free_reference(gpointer key, GList *l, gpointer unused)
+{
+     g_list_free(l);
+}
+
+static void free_references(GHashTable *refs)
+{
+     if (refs == NULL) return;
+
+     g_hash_table_foreach(refs, (GHFunc) free_reference, NULL);
+     g_hash_table_destroy(refs);
+}
+
+static void add_mr_reference(struct server_schema *ss, const char *mrname,
+			     const char *name)
+{
+     LDAPMatchingRule *mr;
+
+     if (mrname == NULL) return;
+
+     mr = find_mr_by_mr_name(ss, mrname);
+     if (mr) add_reference(ss->ats_by_mr, mr, name);
+}
+
+/* Lookups by name would have to go through the lists otherwise. The
+   references get built walking the lists backwards, so prepending
+   keeps them in the order of the lists. */
+static void index_schema(struct server_schema *ss)
+{
+     GList *l;
+     char **n;
+     int i;
+
+     for (i = 0 ; i < SCHEMA_TYPES ; i++) {
+	  ss->names[i] = g_ptr_array_new();
+     }
+
+     ss->oc_by_name = g_hash_table_new(strcase_hash, strcase_equal);
+     for (l = ss->oc ; l ; l = l->next) {
+	  LDAPObjectClass *oc = l->data;
+
+	  if (oc->oc_names) index_name(ss->oc_by_name, oc->oc_names[0], oc);
+	  index_name(ss->oc_by_name, oc->oc_oid, oc);
+	  add_names(ss, SCHEMA_TYPE_OC, oc->oc_names, oc->oc_oid, oc);
+     }
+
+     ss->at_by_name = g_hash_table_new(strcase_hash, strcase_equal);
+     for (l = ss->at ; l ; l = l->next) {
+	  LDAPAttributeType *at = l->data;
+
+	  for (n = at->at_names ; n && *n ; n++) {
+	       index_name(ss->at_by_name, *n, at);
+	  }
+	  index_name(ss->at_by_name, at->at_oid, at);
+	  add_names(ss, SCHEMA_TYPE_AT, at->at_names, at->at_oid, at);
+     }
+
+     ss->mr_by_name = g_hash_table_new(strcase_hash, strcase_equal);
+     for (l = ss->mr ; l ; l = l->next) {
+	  LDAPMatchingRule *mr = l->data;
+
+	  for (n = mr->mr_names ; n && *n ; n++) {
+	       index_name(ss->mr_by_name, *n, mr);
+	  }
+	  index_name(ss->mr_by_name, mr->mr_oid, mr);
+	  add_names(ss, SCHEMA_TYPE_MR, mr->mr_names, mr->mr_oid, mr);
+     }
+
+     for (l = ss->s ; l ; l = l->next) {
+	  LDAPSyntax *s = l->data;
+	  add_names(ss, SCHEMA_TYPE_S, NULL, s->syn_oid, s);
+     }
+
+     for (i = 0 ; i < SCHEMA_TYPES ; i++) {
+	  g_ptr_array_sort(ss->names[i], compare_names);
+     }
+
+     ss->ocs_by_at = g_hash_table_new(NULL, NULL);
+     for (l = g_list_last(ss->oc) ; l ; l = l->prev) {
+	  LDAPObjectClass *oc = l->data;
+	  const char *name = SHOWN_NAME(oc->oc_names, oc->oc_oid);
+	  LDAPAttributeType *at;
+
+	  for (n = oc->oc_at_oids_must ; n && *n ; n++) {
+	       at = find_canonical_at_by_at(ss, *n);
+	       if (at) add_reference(ss->ocs_by_at, at, name);
+	  }
+	  for (n = oc->oc_at_oids_may ; n && *n ; n++) {
+	       at = find_canonical_at_by_at(ss, *n);
+	       if (at) add_reference(ss->ocs_by_at, at, name);
+	  }
+     }
+
+     ss->ats_by_mr = g_hash_table_new(NULL, NULL);
+     ss->ats_by_s = g_hash_table_new(strcase_hash, strcase_equal);
+     for (l = g_list_last(ss->at) ; l ; l = l->prev) {
+	  LDAPAttributeType *at = l->data;
+	  const char *name = SHOWN_NAME(at->at_names, at->at_oid);
+
+	  add_mr_reference(ss, at->at_equality_oid, name);
+	  add_mr_reference(ss, at->at_ordering_oid, name);
+	  add_mr_reference(ss, at->at_substr_oid, name);
+	  if (at->at_syntax_oid) {
+	       add_reference(ss->ats_by_s, at->at_syntax_oid, name);
+	  }
+     }
+
+     ss->mrs_by_s = g_hash_table_new(strcase_hash, strcase_equal);
+     for (l = g_list_last(ss->mr) ; l ; l = l->prev) {
+	  LDAPMatchingRule *mr = l->data;
+
+	  if (mr->mr_syntax_oid) {
+	       add_reference(ss->mrs_by_s, mr->mr_syntax_oid,
+			     SHOWN_NAME(mr->mr_names, mr->mr_oid));
+	  }
+     }
+}
+
+void free_schema_indexes(struct server_schema *ss)
+{
+     guint i, j;
+
+     if (ss->oc_by_name) g_hash_table_destroy(ss->oc_by_name);
+     if (ss->at_by_name) g_hash_table_destroy(ss->at_by_name);
+     if (ss->mr_by_name) g_hash_table_destroy(ss->mr_by_name);
+     if (ss->attrsets) g_hash_table_destroy(ss->attrsets);
+     ss->oc_by_name = ss->at_by_name = ss->mr_by_name = ss->attrsets = NULL;
+
+     for (i = 0 ; i < SCHEMA_TYPES ; i++) {
+	  if (ss->names[i] == NULL) continue;
+
+	  for (j = 0 ; j < ss->names[i]->len ; j++) {
+	       struct schema_name *name = g_ptr_array_index(ss->names[i], j);
+	       g_free(name->folded);
+	       g_free(name);
+	  }
+	  g_ptr_array_free(ss->names[i], TRUE);
+	  ss->names[i] = NULL;
+     }
+
+     free_references(ss->ocs_by_at);
+     free_references(ss->ats_by_mr);
+     free_references(ss->ats_by_s);
+     free_references(ss->mrs_by_s);
+     ss->ocs_by_at = ss->ats_by_mr = ss->ats_by_s = ss->mrs_by_s = NULL;
+}
+
+/*
+ * builds a server_schema from the result of a search for the
+ * subschema subentry. Returns NULL if there was nothing in it.
+ */
+struct server_schema *parse_server_schema(LDAP *ld, LDAPMessage *res)
+{
+     BerElement *berptr;
+     LDAPMessage *e;
+     LDAPObjectClass *oc;
+     LDAPAttributeType *at;
+     LDAPMatchingRule *mr;
+     LDAPSyntax *s;
+     struct server_schema *ss;
+     int i, retcode;
+     char *attr, **vals;
+     const char *errp;
+
      ss = MALLOC(sizeof(struct server_schema), "struct server_schema");
 
-     if(ss == NULL) {
-	  close_connection(server, FALSE);
+     if(ss == NULL)
 	  return(NULL);
-     }
 
-     ss->oc = ss->at = ss->mr = ss->s = NULL;
+     memset(ss, 0, sizeof(struct server_schema));
 
      for(e = ldap_first_entry(ld, res); e; e = ldap_next_entry(ld, e)) {
 	  for(attr = ldap_first_attribute(ld, res, &berptr); attr;
@@ -263,7 +509,6 @@ struct server_schema *get_server_schema(int error_context,
 	       ber_free(berptr, 0);
 #endif
      }
-     ldap_msgfree(res);
 
      if(ss->oc)
 	  ss->oc = g_list_sort(ss->oc, (GCompareFunc) sort_oc);
@@ -280,14 +525,10 @@ struct server_schema *get_server_schema(int error_context,
      if(!ss->s && !ss->at && !ss->oc && !ss->s) {
 	  FREE(ss, "struct server_schema");
 	  ss = NULL;
+     } else {
+	  index_schema(ss);
      }
-     else
-	  server->flags &= ~SERVER_HAS_NO_SCHEMA;
-
-     close_connection(server, FALSE);
 
-     /* cache server schema */
-     server->ss = ss;
 
      return(ss);
 }
@@ -361,23 +602,84 @@ int sort_s(LDAPSyntax *s1, LDAPSyntax *s2)
  */
 LDAPObjectClass *find_oc_by_oc_name(struct server_schema *ss, char *ocname)
 {
-     GList *list;
-     LDAPObjectClass *oc;
+     if(ss == NULL || ss->oc_by_name == NULL || ocname == NULL)
+	  return(NULL);
+
+     return g_hash_table_lookup(ss->oc_by_name, ocname);
+}
+
 
-     if(ss == NULL || ss->oc == NULL)
+/*
+ * find matching rule by any of its names or its OID
+ */
+LDAPMatchingRule *find_mr_by_mr_name(struct server_schema *ss,
+				     const char *mrname)
+{
+     if(ss == NULL || ss->mr_by_name == NULL || mrname == NULL)
 	  return(NULL);
 
-     oc = NULL;
-     list = ss->oc;
-     while(list) {
-	  oc = (LDAPObjectClass *) list->data;
-	  if( (oc->oc_names && oc->oc_names[0] && !strcasecmp(ocname, oc->oc_names[0]) )
-	      || (oc->oc_oid && !strcasecmp(ocname, oc->oc_oid)) )
-	       break;
-	  list = list->next;
+     return g_hash_table_lookup(ss->mr_by_name, mrname);
+}
+
+
+static gboolean name_matches(const struct schema_name *name,
+			     const char *folded, gboolean anywhere)
+{
+     if (anywhere) {
+	  return strstr(name->folded, folded) != NULL ||
+	       (name->oid && strstr(name->oid, folded) != NULL);
      }
+     return g_str_has_prefix(name->folded, folded) ||
+	  (name->oid && g_str_has_prefix(name->oid, folded));
+}
+
+GPtrArray *schema_find_names(struct server_schema *ss,
+			     enum schema_detail_type type,
+			     const char *text, gboolean anywhere,
+			     GPtrArray *within)
+{
+     GPtrArray *names, *found;
+     char *folded;
+     guint i, lo, hi;
+
+     g_return_val_if_fail(type < SCHEMA_TYPES, NULL);
+
+     found = g_ptr_array_new();
+     names = within ? within : (ss ? ss->names[type] : NULL);
+     if (names == NULL || text == NULL) return found;
+
+     folded = g_ascii_strdown(text, -1);
 
-     return(oc);
+     if (within || anywhere || g_ascii_isdigit(folded[0])) {
+	  for (i = 0 ; i < names->len ; i++) {
+	       struct schema_name *name = g_ptr_array_index(names, i);
+	       if (name_matches(name, folded, anywhere)) {
+		    g_ptr_array_add(found, name);
+	       }
+	  }
+     } else {
+	  /* the first name not before text, then all starting with it */
+	  lo = 0;
+	  hi = names->len;
+	  while (lo < hi) {
+	       guint mid = lo + (hi - lo) / 2;
+	       struct schema_name *name = g_ptr_array_index(names, mid);
+
+	       if (strcmp(name->folded, folded) < 0) {
+		    lo = mid + 1;
+	       } else {
+		    hi = mid;
+	       }
+	  }
+	  for (i = lo ; i < names->len ; i++) {
+	       struct schema_name *name = g_ptr_array_index(names, i);
+	       if (!g_str_has_prefix(name->folded, folded)) break;
+	       g_ptr_array_add(found, name);
+	  }
+     }
+
+     g_free(folded);
+     return found;
 }
 
 
@@ -414,6 +716,126 @@ GList *attrlist_by_oclist(GqServer *server, GList *oclist)
 }
 
 
+/* adds oc after its superiors, unless it has been seen already */
+static GList *add_oc_and_superiors(GList *oc_list, GHashTable *seen,
+				   struct server_schema *ss,
+				   LDAPObjectClass *oc)
+{
+     int i;
+
+     /* marked before the superiors, so a loop among them ends */
+     if (g_hash_table_lookup(seen, oc)) return oc_list;
+     g_hash_table_insert(seen, oc, oc);
+
+     for (i = 0 ; oc->oc_sup_oids && oc->oc_sup_oids[i] ; i++) {
+	  LDAPObjectClass *soc = find_oc_by_oc_name(ss, oc->oc_sup_oids[i]);
+	  if (soc) {
+	       oc_list = add_oc_and_superiors(oc_list, seen, ss, soc);
+	  }
+     }
+
+     /* built in reverse */
+     return g_list_prepend(oc_list, oc);
+}
+
+/* an attribute is the same under all of its names */
+static const char *attr_key(struct server_schema *ss, const char *name,
+			    LDAPAttributeType **at)
+{
+     *at = find_canonical_at_by_at(ss, name);
+     return *at ? (*at)->at_names[0] : name;
+}
+
+static void add_attr(GArray *attrs, GHashTable *seen,
+		     struct server_schema *ss, const char *name, int flags)
+{
+     LDAPAttributeType *at;
+     const char *key = attr_key(ss, name, &at);
+     struct schema_attr attr;
+
+     if (g_hash_table_lookup(seen, key)) return;
+     g_hash_table_insert(seen, (gpointer) key, (gpointer) key);
+
+     attr.name = name;
+     attr.at = at;
+     attr.flags = flags;
+     if (at && at->at_single_value) attr.flags |= FLAG_SINGLE_VALUE;
+     if (at && at->at_no_user_mod) attr.flags |= FLAG_NO_USER_MOD;
+
+     g_array_append_val(attrs, attr);
+}
+
+static void free_attrs(GArray *attrs)
+{
+     g_array_free(attrs, TRUE);
+}
+
+GArray *schema_attrs_by_oclist(struct server_schema *ss, GList *oclist)
+{
+     GString *key;
+     GArray *attrs;
+     GHashTable *seen;
+     GList *ocs = NULL, *l;
+     LDAPObjectClass *oc;
+     LDAPAttributeType *at;
+     const char *name;
+     int i;
+
+     if (ss == NULL || oclist == NULL) return NULL;
+
+     key = g_string_new(NULL);
+     for (l = oclist ; l ; l = l->next) {
+	  g_string_append(key, l->data);
+	  g_string_append_c(key, '\n');
+     }
+
+     if (ss->attrsets == NULL) {
+	  ss->attrsets = g_hash_table_new_full(strcase_hash, strcase_equal,
+					       g_free,
+					       (GDestroyNotify) free_attrs);
+     }
+
+     attrs = g_hash_table_lookup(ss->attrsets, key->str);
+     if (attrs) {
+	  g_string_free(key, TRUE);
+	  return attrs;
+     }
+
+     seen = g_hash_table_new(NULL, NULL);
+     for (l = oclist ; l ; l = l->next) {
+	  oc = find_oc_by_oc_name(ss, l->data);
+	  if (oc) ocs = add_oc_and_superiors(ocs, seen, ss, oc);
+     }
+     g_hash_table_destroy(seen);
+     ocs = g_list_reverse(ocs);
+
+     attrs = g_array_new(FALSE, FALSE, sizeof(struct schema_attr));
+     seen = g_hash_table_new(strcase_hash, strcase_equal);
+
+     /* the caller has that one already */
+     name = attr_key(ss, "objectClass", &at);
+     g_hash_table_insert(seen, (gpointer) name, (gpointer) name);
+
+     for (l = ocs ; l ; l = l->next) {
+	  oc = l->data;
+
+	  for (i = 0 ; oc->oc_at_oids_must && oc->oc_at_oids_must[i] ; i++) {
+	       add_attr(attrs, seen, ss, oc->oc_at_oids_must[i],
+			FLAG_MUST_IN_SCHEMA);
+	  }
+	  for (i = 0 ; oc->oc_at_oids_may && oc->oc_at_oids_may[i] ; i++) {
+	       add_attr(attrs, seen, ss, oc->oc_at_oids_may[i], 0);
+	  }
+     }
+
+     g_hash_table_destroy(seen);
+     g_list_free(ocs);
+
+     g_hash_table_insert(ss->attrsets, g_string_free(key, FALSE), attrs);
+     return attrs;
+}
+
+
 #endif  /* HAVE_LDAP_STR2OBJECTCLASS */
 
 /* 
@@ -35,9 +35,28 @@
 
 #define GQ_SCHEMA_PARSE_FLAG    0x03
 
+enum schema_detail_type {
+     SCHEMA_TYPE_OC,
+     SCHEMA_TYPE_AT,
+     SCHEMA_TYPE_MR,
+     SCHEMA_TYPE_S
+};
+
+#define SCHEMA_TYPES		4
+
+/* a name to look things up in the schema by */
+struct schema_name {
+     const char *name;		/* a name, or the OID of what has none */
+     char *folded;		/* name in lower case */
+     const char *oid;
+     enum schema_detail_type type;
+     void *object;		/* LDAPObjectClass, LDAPAttributeType... */
+};
+
 struct server_schema *get_schema(int error_context, GqServer *server);
 struct server_schema *get_server_schema(int error_context,
 					GqServer *server);
+struct server_schema *parse_server_schema(LDAP *ld, LDAPMessage *res);
 
 int sort_oc(LDAPObjectClass *oc1, LDAPObjectClass *oc2);
 int sort_at(LDAPAttributeType *at1, LDAPAttributeType *at2);
@@ -45,7 +64,37 @@ int sort_mr(LDAPMatchingRule *mr1, LDAPMatchingRule *mr2);
 int sort_s(LDAPSyntax *s1, LDAPSyntax *s2);
 
 LDAPObjectClass *find_oc_by_oc_name(struct server_schema *ss, char *ocname);
+LDAPMatchingRule *find_mr_by_mr_name(struct server_schema *ss,
+				     const char *mrname);
 GList *attrlist_by_oclist(GqServer *server, GList *oclist);
 
+/* an attribute allowed by a set of objectClasses */
+struct schema_attr {
+     const char *name;		/* as the objectClass has it */
+     LDAPAttributeType *at;	/* NULL if not in the schema */
+     int flags;			/* FLAG_MUST_IN_SCHEMA, FLAG_SINGLE_VALUE
+				   and FLAG_NO_USER_MOD */
+};
+
+/* The attributes of the objectClasses in oclist (names) and of all of
+   their superiors, superiors first, each class with its MUST before
+   its MAY attributes. An attribute known by several names comes only
+   once, objectClass not at all. The array belongs to ss and gets
+   computed only once for every list of objectClasses. */
+GArray *schema_attrs_by_oclist(struct server_schema *ss, GList *oclist);
+
+/* The names of type containing text (ignoring case), or only those
+   starting with it unless anywhere is set. Names start with a letter,
+   OIDs with a digit, so text starting with a digit looks for OIDs.
+   within may be the result for a text this one narrows down, to only
+   look through that. The result is sorted by name, the caller frees
+   it with g_ptr_array_free(result, TRUE). */
+GPtrArray *schema_find_names(struct server_schema *ss,
+			     enum schema_detail_type type,
+			     const char *text, gboolean anywhere,
+			     GPtrArray *within);
+
+void free_schema_indexes(struct server_schema *ss);
+
 #endif
 
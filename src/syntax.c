@@ -590,7 +590,13 @@ int show_in_search(int error_context,
      type = GPOINTER_TO_INT(get_dt_handler(sh->displaytype));
      if (!type) return FALSE;
 
-     return G_TYPE_IS_ABSTRACT(type);
+     if (!G_TYPE_IS_ABSTRACT(type)) {
+	  GQTypeDisplayClass *klass = g_type_class_ref(type);
+	  gboolean show = klass->show_in_search_result;
+	  g_type_class_unref(klass);
+	  return show;
+     }
+     return FALSE;
 }
 
 GByteArray *identity(const char *val, int len)
@@ -201,41 +201,14 @@ GList *formfill_from_entry_objectclass(int error_context,
 }
 
 
-static GList *add_oc_and_superiors(GList *oc_list, struct server_schema *ss,
-				   LDAPObjectClass *oc) 
-{
-     /* check if superior(s) has/have been added as well */
-     if (oc->oc_sup_oids) {
-	  int i;
-
-	  for (i = 0 ; oc->oc_sup_oids[i] ; i++) {
-	       LDAPObjectClass *soc = 
-		    find_oc_by_oc_name(ss, oc->oc_sup_oids[i]);
-	       if (soc) {
-		    oc_list = add_oc_and_superiors(oc_list, ss, soc);
-	       }
-	  }
-     }
-
-     /* add oc itself possibly after its superiors... */
-
-     if (oc_list && g_list_find(oc_list, oc)) {
-	  /* already added */
-     } else {
-	  oc_list = g_list_append(oc_list, oc);
-     }
-
-     return oc_list;
-}
-
 GList *add_attrs_by_oc(int error_context, GqServer *server,
 		       GList *oclist)
 {
-     GList *formlist, *ocs_to_add = NULL, *l;
-     LDAPObjectClass *oc;
+     GList *formlist;
+     GArray *attrs;
      struct server_schema *ss;
      struct formfill *form;
-     int i;
+     guint i;
 
 
      if(oclist == NULL)
@@ -255,78 +228,33 @@ GList *add_attrs_by_oc(int error_context, GqServer *server,
      form->flags |= FLAG_MUST_IN_SCHEMA;
      set_displaytype(error_context, server, form);
 
-     formlist = g_list_append(formlist, form);
+     formlist = g_list_prepend(formlist, form);
 
      /* schema functions below need this */
      ss = get_schema(error_context, server);
 
-     for ( l = oclist ; l ; l = l->next ) {
-	  oc = find_oc_by_oc_name(ss, (char *) l->data);
-	  if(oc) {
-	       ocs_to_add = add_oc_and_superiors(ocs_to_add, ss, oc);
-	  }
-     }
+     /* required attributes before the allowed ones of every class,
+	worked out once for these classes */
+     attrs = schema_attrs_by_oclist(ss, oclist);
 
-     for (l = g_list_first(ocs_to_add) ; l ; l = g_list_next(l)) {
-	  oc = (LDAPObjectClass *) l->data;
-	  if(oc) {
-	       LDAPAttributeType *at;
-
-	       /* required attributes */
-	       for(i=0; oc->oc_at_oids_must && oc->oc_at_oids_must[i]; i++) {
-/*	            if (strcasecmp(oc->oc_at_oids_must[i], "objectClass")) { */
-	            if (lookup_attribute_using_schema(formlist,
-						      oc->oc_at_oids_must[i],
-						      ss, &at) == NULL) {
-		         form = new_formfill();
-			 g_assert(form);
-
-			 form->server = g_object_ref(server);
-
-			 g_free(form->attrname);
-			 form->attrname = g_strdup(oc->oc_at_oids_must[i]);
-			 form->flags |= FLAG_MUST_IN_SCHEMA;
-			 if (at && at->at_single_value) {
-			      form->flags |= FLAG_SINGLE_VALUE;
-			 }
-			 if (at && at->at_no_user_mod) {
-			      form->flags |= FLAG_NO_USER_MOD;
-			 }
-			 set_displaytype(error_context, server, form);
-		         formlist = formlist_append(formlist, form);
-		    }
-	       }
+     for (i = 0 ; attrs && i < attrs->len ; i++) {
+	  struct schema_attr *attr = &g_array_index(attrs, struct schema_attr, i);
 
-	       /* allowed attributes */
-	       i = 0;
-	       while(oc->oc_at_oids_may && oc->oc_at_oids_may[i]) {
-/*		    if (strcasecmp(oc->oc_at_oids_may[i], "objectClass")) { */
-	            if (lookup_attribute_using_schema(formlist,
-						      oc->oc_at_oids_may[i],
-						      ss, &at) == NULL) {
-		         form = new_formfill();
-			 g_assert(form);
-
-			 form->server = g_object_ref(server);
-
-			 g_free(form->attrname);
-			 form->attrname = g_strdup(oc->oc_at_oids_may[i]);
-			 set_displaytype(error_context, server, form);
-		         formlist = formlist_append(formlist, form);
-			 if (at && at->at_single_value) {
-			      form->flags |= FLAG_SINGLE_VALUE;
-			 }
-			 if (at && at->at_no_user_mod) {
-			      form->flags |= FLAG_NO_USER_MOD;
-			 }
-		    }
-		    i++;
-	       }
+	  form = new_formfill();
+	  g_assert(form);
 
-	  }
+	  form->server = g_object_ref(server);
+
+	  g_free(form->attrname);
+	  form->attrname = g_strdup(attr->name);
+	  form->flags |= attr->flags;
+	  set_displaytype(error_context, server, form);
+
+	  /* no duplicates in attrs */
+	  formlist = g_list_prepend(formlist, form);
      }
 
-     return(formlist);
+     return(g_list_reverse(formlist));
 }
 
 
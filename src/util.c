@@ -62,6 +62,7 @@
 #include "configfile.h"
 #include "errorchain.h"
 #include "gq-keyring.h"
+#include "gq-progress.h"
 #include "gq-server-list.h"
 #include "util.h"
 #include "template.h"
@@ -73,6 +74,8 @@
 #include "mainwin.h"		/* message_log_append */
 
 #define TRY_VERSION3 1
+/* do not make it the cached connection of the server */
+#define EXTRA_CONNECTION 2
 
 LDAP *open_connection_ex(int open_context,
 			 GqServer *server, int *ldap_errno);
@@ -182,12 +185,14 @@ static int do_ldap_connect(LDAP **ld_out, GqServer *server,
      char *binddn = NULL, *bindpw = NULL;
      int rc = LDAP_SUCCESS;
      int i;
+     gdouble start;
 #ifdef LDAP_OPT_NETWORK_TIMEOUT
      struct timeval nettimeout;
 #endif
 
      *ld_out = NULL;
 
+     start = gq_server_stats_start();
      if (g_utf8_strchr(server->ldaphost, -1, ':') != NULL) {
 #ifdef HAVE_LDAP_INITIALIZE
 	  rc = ldap_initialize(&ld, server->ldaphost);
@@ -265,6 +270,7 @@ static int do_ldap_connect(LDAP **ld_out, GqServer *server,
 			       ldap_err2string(rc));
 		    push_ldap_addl_error(ld, open_context);
 		    ldap_unbind(ld);
+		    gq_server_stats_stop(server, GQ_STAT_CONNECT, start, FALSE);
 
 		    return rc;
 	       }
@@ -289,8 +295,15 @@ static int do_ldap_connect(LDAP **ld_out, GqServer *server,
 #endif
 	  }
 	  
+	  /* ldap_init does not talk to the server, so unless StartTLS
+	     is used most of the connection setup is accounted for as
+	     part of the bind */
+	  gq_server_stats_stop(server, GQ_STAT_CONNECT, start, TRUE);
+
 	  /* perform the auth */
+	  start = gq_server_stats_start();
 	  rc = do_ldap_auth(ld, server, open_context);
+	  gq_server_stats_stop(server, GQ_STAT_BIND, start, rc == LDAP_SUCCESS);
 
 	  if (rc != LDAP_SUCCESS) {
 	       /* Maybe we cannot use LDAPv3 ... try again */
@@ -302,7 +315,7 @@ static int do_ldap_connect(LDAP **ld_out, GqServer *server,
 	       /* might as well clean this up */
 	       ldap_unbind(ld);
 	       ld = NULL;
-	  } else {
+	  } else if (!(flags & EXTRA_CONNECTION)) {
 	       /* always store connection handle, regardless of connection
 		  caching -- call close_connection() after each operation
 		  to do the caching thing or not */
@@ -556,6 +569,14 @@ get_password_from_dialog(GqServer* server) {
 /*
  * open connection to LDAP server, and store connection for caching
  */
+/* the pooled connections go along with the cached one */
+static void close_pool(GqServer *server)
+{
+     g_slist_foreach(server->pool, (GFunc) ldap_unbind, NULL);
+     g_slist_free(server->pool);
+     server->pool = NULL;
+}
+
 LDAP*
 open_connection_ex(int open_context, GqServer *server, int *ldap_errno)
 {
@@ -578,6 +599,7 @@ open_connection_ex(int open_context, GqServer *server, int *ldap_errno)
                 * "rebind" */
 	       ldap_unbind(server->connection);
 	       server->connection = NULL;
+	       close_pool(server);
 	  }
      }
 
@@ -665,9 +687,49 @@ close_connection(GqServer *server, int always)
 		/* definitely close this connection */
 		ldap_unbind(server->connection);
 		server->connection = NULL;
+		close_pool(server);
 	}
 }
 
+/*
+ * An additional connection to server, bound the same way as the cached
+ * one, for running operations side by side with it. The cached
+ * connection stays open while it is in use. Hand it back with
+ * release_pooled_connection(), which keeps it for the next time if
+ * the server's connection gets cached.
+ */
+LDAP *open_pooled_connection(int open_context, GqServer *server)
+{
+     LDAP *ld = NULL;
+
+     /* asks for the password and tells whether the server is there */
+     if (open_connection(open_context, server) == NULL) return NULL;
+
+     if (server->pool) {
+	  ld = server->pool->data;
+	  server->pool = g_slist_delete_link(server->pool, server->pool);
+	  return ld;
+     }
+
+     do_ldap_connect(&ld, server, open_context,
+		     EXTRA_CONNECTION |
+		     (server->version == LDAP_VERSION3 ? TRY_VERSION3 : 0));
+     if (ld == NULL) close_connection(server, FALSE);
+
+     return ld;
+}
+
+void release_pooled_connection(GqServer *server, LDAP *ld)
+{
+     if (server->cacheconn && server->server_down == 0 &&
+	 server->connection) {
+	  server->pool = g_slist_prepend(server->pool, ld);
+     } else {
+	  ldap_unbind(ld);
+     }
+     close_connection(server, FALSE);
+}
+
 
 /*
  * clear cached server schema
@@ -681,6 +743,9 @@ void clear_server_schema(GqServer *server)
      if(server->ss) {
 	  ss = server->ss;
 
+	  /* before the lists, they own the keys */
+	  free_schema_indexes(ss);
+
 	  /* objectclasses */
 	  list = ss->oc;
 	  if(list) {
@@ -744,6 +809,10 @@ gboolean delete_entry_full(int delete_context,
      LDAPControl c;
      LDAPControl *ctrls[2] = { NULL, NULL } ;
      LDAPMessage *res = NULL, *e;
+     gdouble start;
+     /* counts the entries of a whole subtree */
+     static GqProgress *subtree = NULL;
+     gboolean top = FALSE;
 
      c.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
      c.ldctl_value.bv_val	= NULL;
@@ -761,6 +830,11 @@ gboolean delete_entry_full(int delete_context,
 	  return(FALSE);
      }
 
+     if (recursive && subtree == NULL) {
+	  subtree = gq_progress_new(_("Deleting entries"), 0);
+	  top = TRUE;
+     }
+
      if (recursive) {
 	  int something_to_do = 1;
 	  static char* attrs [] = {"dn", NULL};
@@ -807,29 +881,36 @@ gboolean delete_entry_full(int delete_context,
 	  }
      }
 
-     statusbar_msg(_("Deleting: %s"), dn);
+     if (!subtree) statusbar_msg(_("Deleting: %s"), dn);
 
+     start = gq_server_stats_start();
      msg = ldap_delete_ext_s(ld, dn, ctrls, NULL);
 
      if(msg == LDAP_NOT_SUPPORTED) {
 	  msg = ldap_delete_s(ld, dn);
      }
+     gq_server_stats_stop(server, GQ_STAT_DELETE, start, msg == LDAP_SUCCESS);
 
 #if HAVE_LDAP_CLIENT_CACHE
      ldap_uncache_entry(ld, dn);
 #endif
 
      if(msg != LDAP_SUCCESS) {
-	  error_push(delete_context, 
-		     "Error deleting DN '%1$s' on '%2$s': %3$s", 
-		     dn, server->name, ldap_err2string(msg));
+	  error_push_ldap(delete_context, _("Deleting entries"), msg,
+			  _("Error deleting DN '%1$s' on '%2$s': %3$s"), 
+			  dn, server->name, ldap_err2string(msg));
 	  rc = FALSE;
      }
      else {
-	  statusbar_msg(_("Deleted %s"), dn);
+	  if (subtree) gq_progress_add(subtree, 1);
+	  if (!subtree || top) statusbar_msg(_("Deleted %s"), dn);
      }
 
  done:
+     if (top) {
+	  gq_progress_finish(subtree);
+	  subtree = NULL;
+     }
      if (res) ldap_msgfree(res);
      set_normalcursor();
      close_connection(server, FALSE);
@@ -850,17 +931,157 @@ gboolean do_recursive_delete(int delete_context,
      return delete_entry_full(delete_context, server, dn, TRUE);
 }
 
+/* number of delete requests delete_entries() keeps outstanding */
+#define DELETE_WINDOW		32
+
+struct pending_delete {
+     struct dn_on_server *dos;
+     int msgid;
+     gdouble start;
+};
+
+static void delete_failed(int delete_context, GqServer *server,
+			  const char *dn, int err)
+{
+     error_push_ldap(delete_context, _("Deleting entries"), err,
+		     _("Error deleting DN '%1$s' on '%2$s': %3$s"), 
+		     dn, server->name, ldap_err2string(err));
+}
+
+/*
+ * delete many entries of one server. to_delete is a GList of struct
+ * dn_on_server, all of them on server. Instead of waiting for each
+ * delete in turn, up to DELETE_WINDOW requests are kept outstanding
+ * on a single connection. deleted (if non-NULL) gets called for
+ * every entry as soon as the server has confirmed its deletion.
+ * Puts delete_context into bulk mode. Returns the number of entries
+ * deleted.
+ */
+int delete_entries(int delete_context, GqServer *server, GList *to_delete,
+		   void (*deleted)(struct dn_on_server *dos, gpointer data),
+		   gpointer data)
+{
+     LDAP *ld;
+     LDAPControl c;
+     LDAPControl *ctrls[2] = { NULL, NULL } ;
+     LDAPMessage *res = NULL;
+     GQueue *pending;
+     GList *next;
+     struct pending_delete *pd;
+     GqProgress *progress;
+     int rc, err, ok = 0;
+
+     c.ldctl_oid		= LDAP_CONTROL_MANAGEDSAIT;
+     c.ldctl_value.bv_val	= NULL;
+     c.ldctl_value.bv_len	= 0;
+     c.ldctl_iscritical	= 1;
+     
+     ctrls[0] = &c;
+
+     error_set_bulk(delete_context, ERROR_BULK_SAMPLES, TRUE);
+
+     set_busycursor();
+
+     if( (ld = open_connection(delete_context, server) ) == NULL) {
+	  set_normalcursor();
+	  return 0;
+     }
+
+     progress = gq_progress_new(_("Deleting entries"),
+				g_list_length(to_delete));
+     pending = g_queue_new();
+
+     for (next = to_delete ; next || !g_queue_is_empty(pending) ; ) {
+	  /* keep the window full */
+	  while (next && g_queue_get_length(pending) < DELETE_WINDOW) {
+	       pd = g_malloc0(sizeof(struct pending_delete));
+	       pd->dos = next->data;
+	       next = next->next;
+
+	       pd->start = gq_server_stats_start();
+	       rc = ldap_delete_ext(ld, pd->dos->dn, ctrls, NULL, &pd->msgid);
+	       if (rc != LDAP_SUCCESS) {
+		    gq_server_stats_stop(server, GQ_STAT_DELETE,
+					 pd->start, FALSE);
+		    delete_failed(delete_context, server, pd->dos->dn, rc);
+		    gq_progress_add(progress, 1);
+		    g_free(pd);
+		    if (rc == LDAP_SERVER_DOWN) {
+			 server->server_down++;
+			 /* no point in sending the rest */
+			 for ( ; next ; next = next->next) {
+			      delete_failed(delete_context, server,
+					    ((struct dn_on_server *) next->data)->dn,
+					    rc);
+			      gq_progress_add(progress, 1);
+			 }
+		    }
+		    continue;
+	       }
+	       g_queue_push_tail(pending, pd);
+	  }
+
+	  if (g_queue_is_empty(pending)) continue;
+
+	  /* servers answer in order anyway, results for the others get
+	     queued by the library meanwhile */
+	  pd = g_queue_pop_head(pending);
+	  rc = ldap_result(ld, pd->msgid, LDAP_MSG_ALL, NULL, &res);
+	  if (rc == -1 || rc == 0) {
+	       ldap_get_option(ld, LDAP_OPT_ERROR_NUMBER, &err);
+	       if (err == LDAP_SERVER_DOWN) {
+		    server->server_down++;
+	       }
+	  } else {
+	       err = ldap_result2error(ld, res, 1);
+	       res = NULL;
+	  }
+
+	  if (err == LDAP_NOT_SUPPORTED) {
+	       /* no ManageDSAit, do it the old way */
+	       err = ldap_delete_s(ld, pd->dos->dn);
+	  }
+	  gq_server_stats_stop(server, GQ_STAT_DELETE, pd->start,
+			       err == LDAP_SUCCESS);
+
+#if HAVE_LDAP_CLIENT_CACHE
+	  ldap_uncache_entry(ld, pd->dos->dn);
+#endif
+
+	  gq_progress_add(progress, 1);
+	  if (err == LDAP_SUCCESS) {
+	       ok++;
+	       /* may well free pd->dos */
+	       if (deleted) deleted(pd->dos, data);
+	  } else {
+	       delete_failed(delete_context, server, pd->dos->dn, err);
+	  }
+	  g_free(pd);
+     }
+
+     g_queue_free(pending);
+     gq_progress_finish(progress);
+
+     set_normalcursor();
+     close_connection(server, FALSE);
+
+     return ok;
+}
+
 /*
  * display hourglass cursor on mainwin
  */
+static GdkCursor *busycursor = NULL;
+static gboolean busy = FALSE;
+
 void set_busycursor(void)
 {
-     GdkCursor *busycursor;
+     /* called around every operation, often already busy */
+     if (busy || mainwin.mainwin == NULL) return;
 
-     busycursor = gdk_cursor_new(GDK_WATCH);
+     if (busycursor == NULL) busycursor = gdk_cursor_new(GDK_WATCH);
      gdk_window_set_cursor(mainwin.mainwin->window, busycursor);
-     gdk_cursor_destroy(busycursor);
-
+     busy = TRUE;
 }
 
 
@@ -869,9 +1090,10 @@ void set_busycursor(void)
  */
 void set_normalcursor(void)
 {
+     if (!busy) return;
 
      gdk_window_set_cursor(mainwin.mainwin->window, NULL);
-
+     busy = FALSE;
 }
 
 /*
@@ -996,6 +1218,13 @@ void statusbar_msg(const char *fmt, ...)
 	  buf = g_strdup("");
      }
 
+     /* without a main window (batch drivers) only the log is kept */
+     if (mainwin.statusbar == NULL) {
+	  message_log_append(buf);
+	  g_free(buf);
+	  return;
+     }
+
      statusbar_msg_clear();
 
      msgid = gtk_statusbar_push(GTK_STATUSBAR(mainwin.statusbar), 
@@ -1010,6 +1239,8 @@ void statusbar_msg(const char *fmt, ...)
 
 void statusbar_msg_clear()
 {
+     if(mainwin.statusbar == NULL)
+	  return;
      if(!context)
 	  context =
 	       gtk_statusbar_get_context_id(GTK_STATUSBAR(mainwin.statusbar),
@@ -1147,6 +1378,18 @@ gboolean is_ancestor(char *child, char *possible_ancestor)
      return rc;
 }
 
+/* days since 1970-01-01 of a date in the proleptic gregorian calendar */
+gint64 days_from_civil(gint64 y, int m, int d)
+{
+     gint64 era, yoe, doy;
+
+     y -= m <= 2;
+     era = (y >= 0 ? y : y - 399) / 400;
+     yoe = y - era * 400;
+     doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+     return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
 GList *ar2glist(char *ar[])
 {
      GList *tmp;
@@ -1251,180 +1494,69 @@ void single_warning_popup(char *message)
 
 
 #ifdef HAVE_LDAP_STR2OBJECTCLASS
+/* the find_*_by_* functions look up what parse_server_schema()
+   indexed, the lists belong to the schema */
 GList *find_at_by_mr_oid(GqServer *server, const char *oid)
 {
-     GList *list, *srvlist;
-     LDAPAttributeType *at;
+     LDAPMatchingRule *mr;
 
-     list = NULL;
-     srvlist = server->ss->at;
-     while(srvlist) {
-	  at = (LDAPAttributeType *) srvlist->data;
-
-	  if( (at->at_equality_oid && !strcasecmp(oid, at->at_equality_oid)) ||
-	      (at->at_ordering_oid && !strcasecmp(oid, at->at_ordering_oid)) ||
-	      (at->at_substr_oid && !strcasecmp(oid, at->at_substr_oid)) ) {
-	       if(at->at_names && at->at_names[0])
-		    list = g_list_append(list, at->at_names[0]);
-	       else
-		    list = g_list_append(list, at->at_oid);
-	  }
-	  srvlist = srvlist->next;
-     }
+     if (server == NULL || server->ss == NULL) return NULL;
 
-     return(list);
+     mr = find_mr_by_mr_name(server->ss, oid);
+     return mr ? g_hash_table_lookup(server->ss->ats_by_mr, mr) : NULL;
 }
 
 LDAPAttributeType *find_canonical_at_by_at(struct server_schema *schema,
 					   const char *attr)
 {
-     GList *atlist;
-     char **n;
-     
-     if (!schema) return NULL;
-     
-     for ( atlist = schema->at ; atlist ; atlist = atlist->next ) {
-	  LDAPAttributeType *at = (LDAPAttributeType *) atlist->data;
-	  if (!at) continue;
-	  
-	  for (n = at->at_names ; n && *n ; n++) {
-/*  	       printf("%s ", *n); */
-	       if (strcasecmp(*n, attr) == 0) {
-		    /* found! */
-		    return at;
-	       }
-	  }
-     }
-     return NULL;
+     if (!schema || !schema->at_by_name || !attr) return NULL;
+
+     return g_hash_table_lookup(schema->at_by_name, attr);
 }
 
 GList *find_at_by_s_oid(GqServer *server, const char *oid)
 {
-     GList *list, *srvlist;
-     LDAPAttributeType *at;
-
-     list = NULL;
-     srvlist = server->ss->at;
-     while(srvlist) {
-	  at = (LDAPAttributeType *) srvlist->data;
-
-	  if(at->at_syntax_oid && !strcasecmp(oid, at->at_syntax_oid)) {
-	       if(at->at_names && at->at_names[0])
-		    list = g_list_append(list, at->at_names[0]);
-	       else
-		    list = g_list_append(list, at->at_oid);
-	  }
-	  srvlist = srvlist->next;
-     }
+     if (server == NULL || server->ss == NULL || server->ss->ats_by_s == NULL)
+	  return NULL;
 
-     return(list);
+     return g_hash_table_lookup(server->ss->ats_by_s, oid);
 }
 
 
 GList *find_mr_by_s_oid(GqServer *server, const char *oid)
 {
-     GList *list, *srvlist;
-     LDAPMatchingRule *mr;
-
-     list = NULL;
-     srvlist = server->ss->mr;
-     while(srvlist) {
-	  mr = (LDAPMatchingRule *) srvlist->data;
-
-	  if(mr->mr_syntax_oid && !strcasecmp(oid, mr->mr_syntax_oid)) {
-	       if(mr->mr_names && mr->mr_names[0])
-		    list = g_list_append(list, mr->mr_names[0]);
-	       else
-		    list = g_list_append(list, mr->mr_oid);
-	  }
-	  srvlist = srvlist->next;
-     }
+     if (server == NULL || server->ss == NULL || server->ss->mrs_by_s == NULL)
+	  return NULL;
 
-     return(list);
+     return g_hash_table_lookup(server->ss->mrs_by_s, oid);
 }
 
 
 GList *find_oc_by_at(int error_context,
 		     GqServer *server, const char *atname)
 {
-     GList *list, *oclist;
-     LDAPObjectClass *oc;
-     int i, found;
+     LDAPAttributeType *at;
      struct server_schema *ss = NULL;
 
-     list = NULL;
-
      if (server == NULL) return NULL;
      ss = get_schema(error_context, server);
-     if (ss == NULL) return NULL;
-
-     oclist = ss->oc;
-     while(oclist) {
-	  oc = (LDAPObjectClass *) oclist->data;
-
-	  found = 0;
-
-	  if(oc->oc_at_oids_must) {
-	       i = 0;
-	       while(oc->oc_at_oids_must[i] && !found) {
-		    if(!strcasecmp(atname, oc->oc_at_oids_must[i])) {
-			 found = 1;
-			 if(oc->oc_names && oc->oc_names[0])
-			      list = g_list_append(list, oc->oc_names[0]);
-			 else
-			      list = g_list_append(list, oc->oc_oid);
-		    }
-		    i++;
-	       }
-	  }
-
-	  if(oc->oc_at_oids_may) {
-	       i = 0;
-	       while(oc->oc_at_oids_may[i] && !found) {
-		    if(!strcasecmp(atname, oc->oc_at_oids_may[i])) {
-			 found = 1;
-			 if(oc->oc_names && oc->oc_names[0])
-			      list = g_list_append(list, oc->oc_names[0]);
-			 else
-			      list = g_list_append(list, oc->oc_oid);
-		    }
-		    i++;
-	       }
-	  }
+     if (ss == NULL || ss->ocs_by_at == NULL) return NULL;
 
-	  oclist = oclist->next;
-     }
-
-     return(list);
+     at = find_canonical_at_by_at(ss, atname);
+     return at ? g_hash_table_lookup(ss->ocs_by_at, at) : NULL;
 }
 
 const char *find_s_by_at_oid(int error_context, GqServer *server,
 			     const char *oid)
 {
-     GList *srvlist;
      LDAPAttributeType *at;
-     char **c;
      struct server_schema *ss = NULL;
 
      if (server == NULL) return NULL;
      ss = get_schema(error_context, server);
 
-     if(ss == NULL || ss->at == NULL)
-	  return(NULL);
-
-     srvlist = ss->at;
-     while(srvlist) {
-	  at = (LDAPAttributeType *) srvlist->data;
-
-	  for (c = at->at_names ; c && *c ; c++) {
-	      if (!strcasecmp(oid, *c)) {
-		  return at->at_syntax_oid;
-	      }
-	  }
-	  srvlist = srvlist->next;
-     }
-
-     return NULL;
+     at = find_canonical_at_by_at(ss, oid);
+     return at ? at->at_syntax_oid : NULL;
 }
 
 #else /* HAVE_LDAP_STR2OBJECTCLASS */
@@ -1784,6 +1916,13 @@ GList *get_suffixes(int error_context, GqServer *server)
      };
      
      GList *suffixes = NULL;
+
+     /* read in the background already */
+     if (server->prefetched_suffixes) {
+	  suffixes = server->prefetched_suffixes;
+	  server->prefetched_suffixes = NULL;
+	  return suffixes;
+     }
      
      set_busycursor();
      
@@ -1877,6 +2016,94 @@ GList *get_suffixes(int error_context, GqServer *server)
      return g_list_first(suffixes);
 }
 
+/* Takes the supportedControl values of a root DSE search result
+   (res may be NULL if the search failed) into server->flags */
+void set_server_controls(GqServer *server, LDAP *ld, LDAPMessage *res)
+{
+     LDAPMessage *e;
+     char **vals;
+     int i;
+
+     server->flags |= SERVER_CONTROLS_PROBED;
+
+     if (res == NULL) return;
+
+     for (e = ldap_first_entry(ld, res) ; e ;
+	  e = ldap_next_entry(ld, e)) {
+	  vals = ldap_get_values(ld, e, "supportedControl");
+	  if (vals == NULL) continue;
+
+	  for (i = 0 ; vals[i] ; i++) {
+#ifdef LDAP_CONTROL_SORTREQUEST
+	       if (strcmp(vals[i], LDAP_CONTROL_SORTREQUEST) == 0) {
+		    server->flags |= SERVER_HAS_SORT;
+	       }
+#endif
+#ifdef LDAP_CONTROL_VLVREQUEST
+	       if (strcmp(vals[i], LDAP_CONTROL_VLVREQUEST) == 0) {
+		    server->flags |= SERVER_HAS_VLV;
+	       }
+#endif
+	       if (strcmp(vals[i], LDAP_CONTROL_SYNC) == 0) {
+		    server->flags |= SERVER_HAS_SYNC;
+	       } else if (strcmp(vals[i],
+				 LDAP_CONTROL_PERSIST_REQUEST) == 0) {
+		    server->flags |= SERVER_HAS_PSEARCH;
+	       }
+	  }
+	  ldap_value_free(vals);
+     }
+}
+
+/* Reads the supportedControl values of the root DSE into
+   server->flags. The root DSE only gets asked once per server */
+static void probe_server_controls(GqServer *server, LDAP *ld)
+{
+     LDAPMessage *res = NULL;
+     char *attrs[] = { "supportedControl", NULL };
+     int msg;
+
+     if (server->flags & SERVER_CONTROLS_PROBED) return;
+
+     msg = ldap_search_s(ld, "", LDAP_SCOPE_BASE, "(objectClass=*)",
+			 attrs, 0, &res);
+     if (msg == LDAP_SERVER_DOWN) {
+	  server->server_down++;
+	  if (res) ldap_msgfree(res);
+	  /* try again next time */
+	  return;
+     }
+
+     set_server_controls(server, ld, msg == LDAP_SUCCESS ? res : NULL);
+     if (res) ldap_msgfree(res);
+}
+
+/* Checks if the server advertises both the server side sorting
+   (RFC 2891) and the virtual list view controls. */
+gboolean server_supports_vlv(GqServer *server, LDAP *ld)
+{
+#if defined(HAVE_LDAP_CREATE_VLV_CONTROL) && defined(LDAP_CONTROL_VLVREQUEST)
+     probe_server_controls(server, ld);
+
+     return (server->flags & (SERVER_HAS_SORT | SERVER_HAS_VLV)) ==
+	  (SERVER_HAS_SORT | SERVER_HAS_VLV);
+#else
+     return FALSE;
+#endif
+}
+
+/* Returns SERVER_HAS_SYNC if the server can do RFC 4533 content
+   synchronisation, SERVER_HAS_PSEARCH if it only knows about the
+   older persistent search control and 0 if it supports neither. */
+int server_live_update_method(GqServer *server, LDAP *ld)
+{
+     probe_server_controls(server, ld);
+
+     if (server->flags & SERVER_HAS_SYNC) return SERVER_HAS_SYNC;
+     if (server->flags & SERVER_HAS_PSEARCH) return SERVER_HAS_PSEARCH;
+     return 0;
+}
+
 #ifdef HAVE_LDAP_STR2DN
 
 /* OpenLDAP 2.1 both deprecated and broke ldap_explode_dn in one go (I
@@ -41,12 +41,17 @@
 
 LDAP *open_connection(int open_context, GqServer *server);
 void close_connection(GqServer *server, int always);
+LDAP *open_pooled_connection(int open_context, GqServer *server);
+void release_pooled_connection(GqServer *server, LDAP *ld);
 void clear_server_schema(GqServer *server);
 
 gboolean delete_entry_full(int delete_context,
 			   GqServer *server, char *dn,
 			   gboolean recursive);
 gboolean delete_entry(int delete_context, GqServer *server, char *dn);
+int delete_entries(int delete_context, GqServer *server, GList *to_delete,
+		   void (*deleted)(struct dn_on_server *dos, gpointer data),
+		   gpointer data);
 gboolean do_recursive_delete(int delete_context,
 			     GqServer *server, char* dn);
 
@@ -86,9 +91,12 @@ gboolean is_transient_server(const GqServer *server);
 int is_leaf_entry(int error_context, GqServer *server, char *dn);
 gboolean is_direct_parent(char *child, char *possible_parent);
 gboolean is_ancestor(char *child, char *possible_ancestor);
+gint64 days_from_civil(gint64 y, int m, int d);
 GList *ar2glist(char *ar[]);
 void warning_popup(GList *messages);
 void single_warning_popup(char *message);
+/* the names of what refers to oid or atname, the lists belong to the
+   schema of server */
 GList *find_at_by_mr_oid(GqServer *server, const char *oid);
 GList *find_at_by_s_oid(GqServer *server, const char *oid);
 GList *find_mr_by_s_oid(GqServer *server, const char *oid);
@@ -107,6 +115,19 @@ int query_popup(const char *title, gchar **outbuf, gboolean is_password,
 int question_popup(const char *title, const char *question);
 
 GList *get_suffixes(int error_context, GqServer *server);
+void set_server_controls(GqServer *server, LDAP *ld, LDAPMessage *res);
+gboolean server_supports_vlv(GqServer *server, LDAP *ld);
+int server_live_update_method(GqServer *server, LDAP *ld);
+
+/* not every libldap knows about these */
+#ifndef LDAP_CONTROL_SYNC
+#define LDAP_CONTROL_SYNC		"1.3.6.1.4.1.4203.1.9.1.1"
+#define LDAP_CONTROL_SYNC_STATE		"1.3.6.1.4.1.4203.1.9.1.2"
+#endif
+#ifndef LDAP_CONTROL_PERSIST_REQUEST
+#define LDAP_CONTROL_PERSIST_REQUEST	"2.16.840.1.113730.3.4.3"
+#define LDAP_CONTROL_PERSIST_ENTRY_CHANGE_NOTICE "2.16.840.1.113730.3.4.7"
+#endif
 
 #ifndef HAVE_LDAP_STR2DN
 #define gq_ldap_explode_dn ldap_explode_dn
@@ -0,0 +1,313 @@
+/* This file is part of GQ
+ *
+ * Copyright (C) 1998-2003 Bert Vermeulen
+ * Copyright (C) 2002-2003 Peter Stamfest
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+/* Runs one of GQ's directory operations without the GUI, for
+   gq-load-harness.sh: the same code the search tab, the browser, the
+   export dialog and drag and drop go through, minus the widgets they
+   fill. Prints one line with GQ's own figures for it:
+
+     wall[s] round-trips peak-RSS[KiB] notes
+
+   Round trips are the LDAP requests GQ sent (binds, searches,
+   modifications) as far as the per-server statistics record them;
+   some synchronous lookups are not timed there, the count of
+   operations slapd logs has them all. */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <glib.h>
+#include <ldap.h>
+
+#include "browse-export.h"
+#include "configfile.h"
+#include "errorchain.h"
+#include "formfill.h"
+#include "gq-result-store.h"
+#include "gq-search-engine.h"
+#include "gq-server-stats.h"
+#include "ldapops.h"
+#include "syntax.h"
+#include "util.h"
+
+static const GqStatOp round_trips[] = {
+	GQ_STAT_BIND,
+	GQ_STAT_SEARCH,
+	GQ_STAT_MODIFY,
+	GQ_STAT_ADD,
+	GQ_STAT_DELETE,
+	GQ_STAT_RENAME
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+		"usage: gq-load-driver URI BINDDN BINDPW PHASE ARGS...\n"
+		"  search BASE FILTER [ATTR...]  as the search tab does\n"
+		"  expand BASE MAX               browse-expand up to MAX containers\n"
+		"  export BASE FILE [CONNS]      export the subtree as LDIF\n"
+		"  move DN NEWPARENT             move a subtree (drag and drop)\n"
+		"  delete DN                     delete a subtree\n");
+	exit(2);
+}
+
+static guint
+count_round_trips(GqServer *server)
+{
+	guint n = 0, i;
+
+	for (i = 0 ; i < G_N_ELEMENTS(round_trips) ; i++) {
+		n += server->stats.ops[round_trips[i]].count;
+	}
+	return n;
+}
+
+/* search */
+
+static void
+store_entry(GqServer *server, LDAP *ld, LDAPMessage *e,
+	    GqResultStore *store)
+{
+	gq_result_store_add(store, server, ld, e);
+}
+
+static gchar *
+run_search(int ctx, GqServer *server, int argc, char **argv)
+{
+	GqSearchParams params;
+	GqResultStore *store;
+	const char **attrs = NULL;
+	int found;
+
+	if (argc < 2) usage();
+	if (argc > 2) attrs = (const char **) argv + 2;
+
+	/* gq_search_run() carries on past servers it cannot reach */
+	if (open_connection(ctx, server) == NULL) return NULL;
+
+	/* the search tab keeps the entries, whatever gets shown */
+	store = gq_result_store_new(attrs);
+
+	memset(&params, 0, sizeof(params));
+	params.scope = LDAP_SCOPE_SUBTREE;
+	params.chase_ref = TRUE;
+	params.max_depth = 7;
+	params.attrs = attrs;
+	params.entry = (GqSearchEntryFunc) store_entry;
+	params.user_data = store;
+
+	found = gq_search_run(ctx, g_list_append(NULL,
+						 gq_search_base_new(server,
+								    argv[0])),
+			      argv[1], &params);
+	gq_result_store_unref(store);
+	close_connection(server, FALSE);
+
+	return g_strdup_printf("%d hits", found);
+}
+
+/* expand */
+
+static void
+queue_dn(const char *dn, GQueue *queue)
+{
+	g_queue_push_tail(queue, g_strdup(dn));
+}
+
+static void
+ignore_referral(const char *url, gpointer data)
+{
+}
+
+static gchar *
+run_expand(int ctx, GqServer *server, int argc, char **argv)
+{
+	GQueue *queue = g_queue_new();
+	LDAP *ld;
+	int max, expanded = 0, err;
+	gchar *dn;
+
+	if (argc < 2) usage();
+	max = atoi(argv[1]);
+
+	if ((ld = open_connection(ctx, server)) == NULL) return NULL;
+
+	/* breadth first, as someone opening node after node would */
+	g_queue_push_tail(queue, g_strdup(argv[0]));
+	while (expanded < max && (dn = g_queue_pop_head(queue)) != NULL) {
+		if (list_referrals(ctx, ld, dn,
+				   (ListFunc) ignore_referral, NULL) == 0) {
+			list_children(ctx, server, ld, dn,
+				      (ListFunc) queue_dn, queue, &err);
+		}
+		g_free(dn);
+		expanded++;
+	}
+
+	while ((dn = g_queue_pop_head(queue)) != NULL) g_free(dn);
+	g_queue_free(queue);
+	close_connection(server, FALSE);
+
+	return g_strdup_printf("%d containers", expanded);
+}
+
+/* export */
+
+static gchar *
+run_export(int ctx, GqServer *server, int argc, char **argv)
+{
+	GqPartitioning partitioning;
+	GqExportWriter *writer;
+	GqExportFile *file;
+	struct dn_on_server *dos;
+	GList *to_export;
+	int n;
+
+	if (argc < 2) usage();
+
+	memset(&partitioning, 0, sizeof(partitioning));
+	partitioning.mode = GQ_PARTITION_CHILDREN;
+	partitioning.connections = argc > 2 ? atoi(argv[2]) : 1;
+
+	dos = new_dn_on_server(argv[0], server);
+	dos->flags = LDAP_SCOPE_SUBTREE;
+	to_export = g_list_append(NULL, dos);
+
+	writer = gq_export_writer_new(GQ_EXPORT_LDIF, ctx);
+	file = gq_export_file_open(argv[1], GQ_COMPRESS_NONE, ctx);
+	n = file ? dump_subtrees(ctx, to_export, &partitioning, writer, file)
+		: -1;
+	if (file && !gq_export_file_close(file)) n = -1;
+
+	gq_export_writer_free(writer);
+	free_dn_on_server(dos);
+	g_list_free(to_export);
+
+	return n < 0 ? NULL : g_strdup_printf("%d entries", n);
+}
+
+/* move */
+
+static gchar *
+run_move(int ctx, GqServer *server, int argc, char **argv)
+{
+	char *newdn;
+	gchar *notes;
+
+	if (argc < 2) usage();
+
+	/* the flags dropping an entry on another one moves with */
+	newdn = move_entry(argv[0], server, argv[1], server,
+			   MOVE_CROSS_SERVER | MOVE_RECURSIVELY |
+			   MOVE_DELETE_MOVED, NULL, ctx);
+	if (newdn == NULL) return NULL;
+
+	notes = g_strdup(newdn);
+	free(newdn);
+	return notes;
+}
+
+/* delete */
+
+static gchar *
+run_delete(int ctx, GqServer *server, int argc, char **argv)
+{
+	if (argc < 1) usage();
+
+	if (!delete_entry_full(ctx, server, argv[0], TRUE)) return NULL;
+	return g_strdup(argv[0]);
+}
+
+int
+main(int argc, char **argv)
+{
+	GqServer *server;
+	GTimer *timer;
+	struct rusage usage_after;
+	gchar *notes;
+	int ctx;
+
+	if (argc < 5) usage();
+
+	if (!g_thread_supported()) g_thread_init(NULL);
+	g_type_init();
+
+	/* defaults only, whatever the user has configured */
+	config = new_config();
+	init_syntaxes();
+	init_internalAttrs();
+
+	server = gq_server_new();
+	g_free_and_dup(server->name, argv[1]);
+	g_free_and_dup(server->ldaphost, argv[1]);
+	g_free_and_dup(server->binddn, argv[2]);
+	g_free_and_dup(server->bindpw, argv[3]);
+	server->ask_pw = 0;
+	server->quiet = 1;
+	canonicalize_ldapserver(server);
+
+	ctx = error_new_context("gq-load-driver", NULL);
+
+	timer = g_timer_new();
+	if (strcmp(argv[4], "search") == 0) {
+		notes = run_search(ctx, server, argc - 5, argv + 5);
+	} else if (strcmp(argv[4], "expand") == 0) {
+		notes = run_expand(ctx, server, argc - 5, argv + 5);
+	} else if (strcmp(argv[4], "export") == 0) {
+		notes = run_export(ctx, server, argc - 5, argv + 5);
+	} else if (strcmp(argv[4], "move") == 0) {
+		notes = run_move(ctx, server, argc - 5, argv + 5);
+	} else if (strcmp(argv[4], "delete") == 0) {
+		notes = run_delete(ctx, server, argc - 5, argv + 5);
+	} else {
+		usage();
+		notes = NULL;
+	}
+	g_timer_stop(timer);
+
+	/* the connection gets cached, this really closes it */
+	close_connection(server, TRUE);
+
+	getrusage(RUSAGE_SELF, &usage_after);
+	/* errors go to stderr, there is no display */
+	error_flush(ctx);
+
+	printf("%.3f %u %ld %s\n",
+	       g_timer_elapsed(timer, NULL),
+	       count_round_trips(server),
+	       usage_after.ru_maxrss,
+	       notes ? notes : "failed");
+
+	g_timer_destroy(timer);
+	g_object_unref(server);
+
+	if (notes == NULL) return 1;
+	g_free(notes);
+	return 0;
+}
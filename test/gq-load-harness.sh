@@ -0,0 +1,326 @@
+#!/bin/sh
+#
+#    GQ -- a GTK-based LDAP client
+#    Copyright (C) 1998-2003 Bert Vermeulen
+#    Copyright (C) 2002-2003 Peter Stamfest
+#
+#    This program is released under the Gnu General Public License with
+#    the additional exemption that compiling, linking, and/or using
+#    OpenSSL is allowed.
+#
+#    This program is free software; you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation; either version 2 of the License, or
+#    (at your option) any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program; if not, write to the Free Software
+#    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+#    USA
+#
+# $Id$
+#
+# Load harness: starts a throwaway slapd (mdb backend) on a private
+# port, fills it with a synthetic directory and runs GQ's search,
+# browse-expand, export, move and recursive delete code against it
+# through gq-load-driver, which links the same code the GUI uses
+# without opening a window:
+#
+#   search  - gq_search_run(), the searching behind query(): one
+#             subtree search with a substring filter, entries kept in
+#             a result store
+#   expand  - list_referrals() and list_children(), what
+#             dn_browse_entry_expand() does per container, breadth-first
+#   export  - dump_subtrees(), what dump_subtree_ok_callback() does,
+#             writing LDIF
+#   move    - move_entry() as drag and drop calls it
+#   delete  - delete_entry_full(recursive)
+#
+# For every phase it reports GQ's wall time, the round trips GQ's
+# server statistics counted, GQ's peak RSS, the operations slapd
+# logged and slapd's peak RSS. When run by "make check" it uses a
+# small directory; without slapd it skips (exit 77).
+#
+# Usage: gq-load-harness.sh [options]
+#   -n N      number of person entries                (default 10000)
+#   -f N      fan-out: children per container         (default 100)
+#   -g N      number of groups                        (default 10)
+#   -s N      members per group                       (default 100)
+#   -j BYTES  size of the jpegPhoto blob per person   (default 0)
+#   -c BYTES  size of the userCertificate blob        (default 0)
+#   -e N      maximum number of containers to expand  (default 200)
+#   -C N      connections to export over              (default 1)
+#   -p PORT   port to run slapd on                    (default 38989)
+#   -k        keep the working directory afterwards
+#
+# Environment: SLAPD, SLAPADD, SCHEMADIR and MODULEPATH override the
+# auto-detected slapd binaries, schema directory and module path;
+# GQ_LOAD_DRIVER the driver (default: next to this script) and
+# GQ_LOAD_ENTRIES the default for -n.
+
+set -e
+
+ENTRIES=${GQ_LOAD_ENTRIES:-10000}
+FANOUT=100
+NGROUPS=10
+GROUPSIZE=100
+JPEGSIZE=0
+CERTSIZE=0
+EXPANDMAX=200
+CONNECTIONS=1
+PORT=38989
+KEEP=0
+
+while getopts "n:f:g:s:j:c:e:C:p:k" opt ; do
+     case $opt in
+     n) ENTRIES=$OPTARG ;;
+     f) FANOUT=$OPTARG ;;
+     g) NGROUPS=$OPTARG ;;
+     s) GROUPSIZE=$OPTARG ;;
+     j) JPEGSIZE=$OPTARG ;;
+     c) CERTSIZE=$OPTARG ;;
+     e) EXPANDMAX=$OPTARG ;;
+     C) CONNECTIONS=$OPTARG ;;
+     p) PORT=$OPTARG ;;
+     k) KEEP=1 ;;
+     *) sed -n '/^# Usage:/,/^# Environment/p' "$0" | sed 's/^# \{0,1\}//' >&2
+	exit 2 ;;
+     esac
+done
+
+SUFFIX="dc=example,dc=com"
+ROOTDN="cn=Manager,$SUFFIX"
+ROOTPW="secret"
+URI="ldap://127.0.0.1:$PORT"
+
+find_prog() {
+     for p in "$@" ; do
+	  if [ -x "$p" ] ; then echo "$p" ; return 0 ; fi
+	  if command -v "$p" >/dev/null 2>&1 ; then
+	       command -v "$p" ; return 0
+	  fi
+     done
+     return 1
+}
+
+SLAPD=${SLAPD:-`find_prog slapd /usr/sbin/slapd /usr/libexec/slapd /usr/local/libexec/slapd || true`}
+SLAPADD=${SLAPADD:-`find_prog slapadd /usr/sbin/slapadd /usr/local/sbin/slapadd || true`}
+if [ -z "$SCHEMADIR" ] ; then
+     for d in /etc/openldap/schema /etc/ldap/schema /usr/local/etc/openldap/schema ; do
+	  if [ -f "$d/inetorgperson.schema" ] ; then SCHEMADIR=$d ; break ; fi
+     done
+fi
+if [ -z "$MODULEPATH" ] ; then
+     for d in /usr/lib/ldap /usr/lib64/openldap /usr/lib/openldap /usr/libexec/openldap ; do
+	  if [ -d "$d" ] ; then MODULEPATH=$d ; break ; fi
+     done
+fi
+
+for p in "$SLAPD" "$SLAPADD" ; do
+     if [ -z "$p" ] ; then
+	  echo "slapd/slapadd not found - set SLAPD and SLAPADD" >&2
+	  exit 77
+     fi
+done
+DRIVER=${GQ_LOAD_DRIVER:-`dirname "$0"`/gq-load-driver}
+if [ ! -x "$DRIVER" ] ; then
+     echo "$DRIVER not found - run make in test/ or set GQ_LOAD_DRIVER" >&2
+     exit 77
+fi
+if [ -z "$SCHEMADIR" ] ; then
+     echo "no OpenLDAP schema directory found - set SCHEMADIR" >&2
+     exit 77
+fi
+
+WORKDIR=`mktemp -d ${TMPDIR:-/tmp}/gq-load.XXXXXX`
+SLAPD_PID=""
+
+cleanup() {
+     if [ -n "$SLAPD_PID" ] ; then
+	  kill "$SLAPD_PID" 2>/dev/null || true
+	  wait "$SLAPD_PID" 2>/dev/null || true
+     fi
+     if [ $KEEP = 0 ] ; then
+	  rm -rf "$WORKDIR"
+     else
+	  echo "working directory kept in $WORKDIR" >&2
+     fi
+}
+trap cleanup EXIT INT TERM
+
+mkdir -p "$WORKDIR/db"
+
+# --- slapd configuration -------------------------------------------------
+
+{
+     echo "include $SCHEMADIR/core.schema"
+     echo "include $SCHEMADIR/cosine.schema"
+     echo "include $SCHEMADIR/inetorgperson.schema"
+     echo "pidfile $WORKDIR/slapd.pid"
+     echo "sizelimit unlimited"
+     if [ -n "$MODULEPATH" ] && ls "$MODULEPATH"/back_mdb* >/dev/null 2>&1 ; then
+	  echo "modulepath $MODULEPATH"
+	  echo "moduleload back_mdb"
+     fi
+     echo "database mdb"
+     echo "maxsize 4294967296"
+     echo "suffix \"$SUFFIX\""
+     echo "rootdn \"$ROOTDN\""
+     echo "rootpw $ROOTPW"
+     echo "directory $WORKDIR/db"
+     echo "index objectClass eq"
+     echo "index uid,cn,sn eq,sub"
+} > "$WORKDIR/slapd.conf"
+
+# --- synthetic directory -------------------------------------------------
+
+# one random blob each, reused for every entry: the payload size is
+# what matters for transfer and rendering, not its contents
+blob() {
+     if [ "$1" -gt 0 ] ; then
+	  head -c "$1" /dev/urandom | base64 | tr -d '\n'
+     fi
+     echo
+}
+
+generate() {
+     blob $JPEGSIZE > "$WORKDIR/jpeg.b64"
+     blob $CERTSIZE > "$WORKDIR/cert.b64"
+
+     # the blobs are read from files: a single argument is limited to
+     # 128KiB on Linux
+     awk -v n="$ENTRIES" -v f="$FANOUT" -v g="$NGROUPS" -v gs="$GROUPSIZE" \
+	 -v base="$SUFFIX" \
+	 -v jpegfile="$WORKDIR/jpeg.b64" -v certfile="$WORKDIR/cert.b64" '
+     function ceil(x) { return (x == int(x)) ? x : int(x) + 1 }
+     BEGIN {
+	  getline jpeg < jpegfile
+	  getline cert < certfile
+	  printf "dn: %s\nobjectClass: dcObject\nobjectClass: organization\n", base
+	  printf "dc: example\no: Example\n\n"
+	  printf "dn: ou=people,%s\nobjectClass: organizationalUnit\nou: people\n\n", base
+	  printf "dn: ou=groups,%s\nobjectClass: organizationalUnit\nou: groups\n\n", base
+	  printf "dn: ou=target,%s\nobjectClass: organizationalUnit\nou: target\n\n", base
+
+	  # container levels, bottom-up: level 0 holds the persons
+	  levels = 0
+	  count[0] = ceil(n / f)
+	  while (count[levels] > f) {
+	       count[levels + 1] = ceil(count[levels] / f)
+	       levels++
+	  }
+
+	  for (l = levels ; l >= 0 ; l--) {
+	       for (j = 0 ; j < count[l] ; j++) {
+		    parent = (l == levels) ? "ou=people," base : dn[l + 1, int(j / f)]
+		    name = "u" l "-" j
+		    dn[l, j] = "ou=" name "," parent
+		    printf "dn: %s\nobjectClass: organizationalUnit\nou: %s\n\n", dn[l, j], name
+	       }
+	  }
+
+	  for (p = 0 ; p < n ; p++) {
+	       pdn[p] = "uid=user" p "," dn[0, int(p / f)]
+	       printf "dn: %s\nobjectClass: inetOrgPerson\n", pdn[p]
+	       printf "uid: user%d\ncn: User %d\nsn: %d\n", p, p, p
+	       printf "mail: user%d@example.com\n", p
+	       printf "telephoneNumber: +1 555 %07d\n", p
+	       if (jpeg != "") printf "jpegPhoto:: %s\n", jpeg
+	       if (cert != "") printf "userCertificate;binary:: %s\n", cert
+	       printf "\n"
+	  }
+
+	  for (i = 0 ; i < g ; i++) {
+	       printf "dn: cn=group%d,ou=groups,%s\nobjectClass: groupOfNames\n", i, base
+	       printf "cn: group%d\n", i
+	       for (m = 0 ; m < gs && m < n ; m++)
+		    printf "member: %s\n", pdn[(i * gs + m) % n]
+	       if (n == 0) printf "member: %s\n", base
+	       printf "\n"
+	  }
+     }'
+}
+
+now() {
+     date +%s.%N
+}
+
+# number of operations slapd has logged so far
+ops() {
+     grep -c -E ' op=[0-9]+ (BIND|SRCH|ADD|MOD|DEL|MODRDN|UNBIND)( |$)' \
+	  "$WORKDIR/slapd.log" 2>/dev/null || true
+}
+
+slapd_rss() {
+     if [ -r /proc/$SLAPD_PID/status ] ; then
+	  awk '/^VmHWM:/ { print $2 }' /proc/$SLAPD_PID/status
+     else
+	  echo "-"
+     fi
+}
+
+# run one phase through the driver and print its figures next to
+# the ones of slapd
+phase() {
+     name=$1
+     shift
+     o0=`ops`
+     if ! out=`"$DRIVER" "$URI" "$ROOTDN" "$ROOTPW" "$@"` ; then
+	  echo "$name failed: $out" >&2
+	  FAILED=1
+     fi
+     sleep 1	# let slapd flush its log
+     o1=`ops`
+     set -- $out
+     if [ $# -lt 3 ] ; then set -- - - - failed ; fi
+     wall=$1 trips=$2 rss=$3
+     shift 3
+     printf "%-10s %10s %8s %12s %8d %12s  %s\n" "$name" \
+	  "$wall" "$trips" "$rss" `expr $o1 - $o0` "`slapd_rss`" "$*"
+}
+
+# --- run -----------------------------------------------------------------
+
+echo "generating $ENTRIES entries (fan-out $FANOUT, $NGROUPS groups of $GROUPSIZE)" >&2
+T0=`now`
+generate > "$WORKDIR/data.ldif"
+"$SLAPADD" -q -f "$WORKDIR/slapd.conf" -l "$WORKDIR/data.ldif"
+T1=`now`
+echo "loaded `grep -c '^dn:' $WORKDIR/data.ldif` entries in `echo "$T1 - $T0" | bc` s" >&2
+
+"$SLAPD" -f "$WORKDIR/slapd.conf" -h "$URI" -d stats > "$WORKDIR/slapd.log" 2>&1 &
+SLAPD_PID=$!
+
+i=0
+until "$DRIVER" "$URI" "$ROOTDN" "$ROOTPW" search "$SUFFIX" \
+	"(objectClass=organization)" >/dev/null 2>&1 ; do
+     i=`expr $i + 1`
+     if [ $i -gt 50 ] ; then
+	  echo "slapd did not come up, see $WORKDIR/slapd.log" >&2
+	  KEEP=1
+	  exit 1
+     fi
+     sleep 0.2
+done
+
+FAILED=0
+
+printf "%-10s %10s %8s %12s %8s %12s  %s\n" \
+     "phase" "wall[s]" "trips" "gq[KiB]" "ops" "slapd[KiB]" "notes"
+
+phase search search "$SUFFIX" "(cn=*User 1*)" cn mail telephoneNumber
+phase expand expand "ou=people,$SUFFIX" $EXPANDMAX
+phase export export "ou=people,$SUFFIX" "$WORKDIR/export.ldif" $CONNECTIONS
+
+# move one leaf container below ou=target, then delete it there
+LEAF=`grep -m 1 '^dn: ou=u0-' "$WORKDIR/data.ldif" | sed 's/^dn: //'`
+LEAFRDN=`echo "$LEAF" | sed 's/,.*//'`
+phase move move "$LEAF" "ou=target,$SUFFIX"
+phase delete delete "$LEAFRDN,ou=target,$SUFFIX"
+
+exit $FAILED